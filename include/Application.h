@@ -7,6 +7,7 @@
 #include <dxgi1_6.h>
 #include <wrl.h>
 #include <memory>
+#include <functional>
 #include <string>
 #include <thread>
 #include <mutex>
@@ -20,6 +21,14 @@ class CommandQueue;
 #include "BearWindow.h"
 #include "D3D12Renderer.h"
 #include "HighResolutionClock.h"
+#include "FramePacer.h"
+#include "FixedTimestep.h"
+#include "RenderThread.h"
+#include "FrustumCuller.h"
+#include "SceneBvh.h"
+#include "SoftwareOcclusion.h"
+#include "LightClusterer.h"
+#include "ShadowCascades.h"
 
 // The Jolt headers don't include Jolt.h. Always include Jolt.h before including any other Jolt header.
 // You can use Jolt.h in your precompiled header to speed up compilation.
@@ -50,6 +59,13 @@ using namespace JPH;
 
 #include "JoltHelper.h"
 
+// what the fixed-step demo simulation advances; the renderer blends the last two
+struct SimulationState
+{
+	XMVECTOR playerPosition = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+	double time = 0.0; // simulated seconds since the demo started
+};
+
 class Application
 {
 public:
@@ -113,8 +129,88 @@ public:
 	}
 
 	// BearWindow system
+	// game thread: simulates, then hands the frame to the render thread as a packet
 	void RenderBearWindow(std::shared_ptr<BearWindow> window);
 
+	D3D12Renderer* GetRenderer() const
+	{
+		return m_renderer_p;
+	}
+
+	RenderThread* GetRenderThread() const
+	{
+		return m_renderThread_p;
+	}
+
+	// of the last frame packet built
+	FrustumCullStats GetFrustumCullStats() const
+	{
+		return m_frustumCuller.GetStats();
+	}
+
+	SceneBvhStats GetSceneBvhStats() const
+	{
+		return m_sceneBvh.GetStats();
+	}
+
+	// cull through the scene BVH instead of testing every instance
+	bool IsBvhCullingEnabled() const
+	{
+		return m_isBvhCullingEnabled;
+	}
+
+	void SetBvhCullingEnabled(bool p_isEnabled)
+	{
+		m_isBvhCullingEnabled = p_isEnabled;
+	}
+
+	OcclusionStats GetOcclusionStats() const
+	{
+		return m_occlusion.GetStats();
+	}
+
+	// drop instances hidden behind large ones after the frustum test; skipped while the renderer
+	// caches bundles, which draw the hidden ones anyway
+	bool IsOcclusionCullingEnabled() const
+	{
+		return m_isOcclusionCullingEnabled;
+	}
+
+	void SetOcclusionCullingEnabled(bool p_isEnabled)
+	{
+		m_isOcclusionCullingEnabled = p_isEnabled;
+	}
+
+	LightClusterStats GetLightClusterStats() const
+	{
+		return m_lightClusterer.GetStats();
+	}
+
+	ShadowCascadeStats GetShadowCascadeStats() const
+	{
+		return m_shadowCascades.GetStats();
+	}
+
+	// cascaded shadow maps for the first directional light
+	bool IsShadowsEnabled() const
+	{
+		return m_isShadowsEnabled;
+	}
+
+	void SetShadowsEnabled(bool p_isEnabled)
+	{
+		m_isShadowsEnabled = p_isEnabled;
+	}
+
+	// game thread, from the instances of the last frame packet; nullptr if the ray hits no mesh
+	Instance* PickInstance(const XMVECTOR& p_origin, const XMVECTOR& p_direction)
+	{
+		return m_sceneBvh.Pick(p_origin, p_direction);
+	}
+
+	// runs p_function while the render thread is between frames, or right away if it is not running yet
+	void RunWhileRenderIdle(const std::function<void()>& p_function);
+
 	void SwitchToDemoWindow();
 	void SwitchToMainWindow();
 
@@ -137,7 +233,12 @@ public:
 
 	void ResetTimer()
 	{
-		m_windowClock.Reset();
+		m_framePacer_p->Reset();
+	}
+
+	FramePacer* GetFramePacer() const
+	{
+		return m_framePacer_p;
 	}
 
 	JPH::BodyInterface& GetBodyInterface()
@@ -163,7 +264,14 @@ public:
 
 	void ResetGameClock()
 	{
-		m_gameClock.Reset();
+		m_simulationTimestep.Reset();
+		m_previousSimulationState = SimulationState();
+		m_currentSimulationState = SimulationState();
+	}
+
+	FixedTimestep& GetSimulationTimestep()
+	{
+		return m_simulationTimestep;
 	}
 
 	std::vector<XMVECTOR>& GetBezierCurvePoints()
@@ -219,6 +327,32 @@ private:
 	// New BearWindow system
 	std::shared_ptr<BearWindow> m_mainWindow; // this is the main window created at application start, UNLESS OTHERWISE SPECIFIED
 	D3D12Renderer* m_renderer_p; // the renderer
+	RenderThread* m_renderThread_p = nullptr; // the only thread that calls m_renderer_p->Render
+	uint64_t m_gameFrameNumber = 0;
+
+	// game thread, instances outside the camera frustum never reach the packet
+	FrustumCuller m_frustumCuller;
+	struct FrustumSlot
+	{
+		const Instance* instance_p = nullptr; // only compared, the instance may be gone
+		uint64_t revision = 0;
+	};
+	std::vector<FrustumSlot> m_frustumSlots; // whose box each slot of m_frustumCuller holds
+	WorkerPool* m_cullingPool_p = nullptr; // the render thread has its own
+	SceneBvh m_sceneBvh;
+	bool m_isBvhCullingEnabled = false;
+	std::vector<Instance*> m_visibleInstances;
+	SoftwareOcclusion m_occlusion;
+	bool m_isOcclusionCullingEnabled = true;
+	std::vector<std::pair<float, Instance*>> m_occluderCandidates; // screen size, instance
+	LightClusterer m_lightClusterer; // point and spot lights into clusters of the packet's frustum
+	ShadowCascades m_shadowCascades; // of the first directional light, fitted to the packet's frustum
+	bool m_isShadowsEnabled = true;
+	std::vector<Instance*> m_shadowCasterInstances; // renderable instances, as indexed by m_shadowCascades
+	std::vector<uint32_t> m_shadowCasterItems; // per caster, its index in the packet's shadowCasters
+	std::vector<uint32_t> m_shadowCasterSources; // scratch, the caster each unsorted draw item is of
+	std::vector<DrawItem> m_unsortedShadowCasters; // scratch
+	std::vector<uint32_t> m_shadowCasterOrder; // scratch, for sorting the packet's casters
 
 	std::shared_ptr<BearWindow> m_demoWindow; // this window should have physics enabled
 
@@ -230,9 +364,8 @@ private:
 	float m_dpiScale = 1.0f;
 
 	// refresh rate control
-	HighResolutionClock m_windowClock;
+	FramePacer* m_framePacer_p = nullptr; // sleeps between frames, the window loop never spins
 	double m_frameTimeInSeconds = 1.0 / 60.0; // 60 frames per second
-	double m_timeSinceLastTick = 0.0;
 	double m_totalTime = 0.0;
 
 	// Jolt physics system
@@ -258,7 +391,30 @@ private:
 
 	// Game control
 	GameState m_gameState = GameState::EditorScene;
-	HighResolutionClock m_gameClock;
+	FixedTimestep m_simulationTimestep;
+	SimulationState m_previousSimulationState;
+	SimulationState m_currentSimulationState;
+	double m_lastFrameSeconds = 0.0; // from the frame pacer, fed to m_simulationTimestep
 	double m_sectionTimeInSeconds = 5.0;
 	double m_sectionGridSize = 10.0;
+
+	// advances the demo by one fixed step; false once the path has been completed
+	bool _stepSimulation(BearWindow& p_window, float p_stepSeconds);
+
+	// copies everything the render thread needs for this frame out of the scene, the lights and the UI
+	void _buildFramePacket(std::shared_ptr<BearWindow> p_window, FramePacket& out_packet);
+
+	// removes the instances of m_visibleInstances that the largest of them hide
+	void _cullOccludedInstances(const XMFLOAT4X4& p_viewProjection);
+
+	// copies the scene's lights into the packet and bins them into clusters of the camera's frustum,
+	// unless the packet is lit by the tiled lighting
+	void _binLights(const BearWindow& p_window, FramePacket& out_packet);
+
+	// fits the shadow cascades of the packet's first directional light to the camera and copies the
+	// casters they draw out of p_instances; leaves the packet without shadows if there is no such light
+	void _fitShadowCascades(const BearWindow& p_window, const std::vector<Instance*>& p_instances, FramePacket& out_packet);
+
+	// applies a pending switch between the editor and the demo window
+	void _switchWindows();
 };
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "FenceQueue.h"
+
+struct AsyncComputeStats
+{
+	uint64_t lightingSubmissions = 0;
+	uint64_t computeWaits = 0; // GPU waits of the compute queue on the direct queue
+	uint64_t directWaits = 0; // GPU waits of the direct queue on the compute queue
+	uint64_t skippedDirectWaits = 0; // the lighting had finished already, nothing was queued
+	uint64_t cpuWaits = 0; // frame slots waited for on the CPU
+};
+
+// Orders a frame's work across the direct and compute queues.
+// A frame fills its G-buffer on the direct queue; the compute queue lights it once those lists have
+// finished, and the direct queue copies the result into the back buffer of the same frame or, to
+// overlap the two queues, of the next one. Every wait between the queues is on the GPU; the CPU
+// only waits when a frame slot is reused, for the work of the frame that had it on both queues.
+// The call order per frame is:
+//   QueueCompositeWait before the frame's direct submission that reads a lighting output, and
+//   QueueLightingWait, the compute submission and OnLightingSubmitted after the G-buffer submission
+//   if the frame is lit on the compute queue; then OnFrameSubmitted.
+// Uses no device, so it builds and runs on Linux against MockFenceQueue.
+class AsyncComputeScheduler
+{
+public:
+	AsyncComputeScheduler(FenceQueue& p_directQueue, FenceQueue& p_computeQueue, uint32_t p_frameSlotCount);
+
+	// until the last frame that used the slot has finished on both queues
+	void WaitForFrameSlot(uint32_t p_frameSlot);
+	void WaitForAllFrameSlots();
+
+	// The frame's G-buffer lists were submitted to the direct queue, which signalled p_gBufferFence;
+	// the compute queue waits for it before the lighting submitted to it next.
+	void QueueLightingWait(uint64_t p_gBufferFence);
+	void OnLightingSubmitted(uint32_t p_frameSlot, uint64_t p_lightingFence);
+
+	// The direct queue waits for every lighting submitted so far before the work submitted to it next:
+	// the output it copies is complete, and nothing reads the G-buffer set the following frames write.
+	// Queues nothing if the direct queue waits for that lighting already, or it has finished.
+	void QueueCompositeWait();
+
+	// the frame's last direct submission signalled p_directFence
+	void OnFrameSubmitted(uint32_t p_frameSlot, uint64_t p_directFence);
+
+	AsyncComputeStats GetStats() const { return m_stats; }
+
+private:
+	struct SlotFences
+	{
+		uint64_t direct = 0;
+		uint64_t compute = 0;
+	};
+
+	FenceQueue& m_directQueue;
+	FenceQueue& m_computeQueue;
+	std::vector<SlotFences> m_slots;
+
+	uint64_t m_lastLightingFence = 0;
+	uint64_t m_directWaitedFence = 0; // the direct queue waits for the compute fence up to here
+
+	AsyncComputeStats m_stats;
+};
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+#include "CommandRecorder.h"
+
+struct DrawItem;
+
+// The part of FrameRecording that takes no matrices: the draw batches, binding the G-buffer
+// targets and how the G-buffer pass is split over recording lists. Built into BearsEngineCore,
+// so RecordingScalingBench records exactly what the renderer records.
+
+// below this many instanced draws per list, the G-buffer pass is recorded on the calling thread only
+static const size_t MinDrawsPerRecordingList = 512;
+
+// first pass, per instanced draw; SV_InstanceID counts from 0, so the draw passes where its instances start
+struct DrawBatchRootConstants
+{
+	UINT firstInstance;
+};
+
+// Consecutive draw items that share a mesh and a texture. Their constants are copied into the
+// instance buffer in item order, the batch draws them with one call and the vertex shader
+// finds its transforms through firstInstance + SV_InstanceID.
+struct DrawBatch
+{
+	D3D12_GPU_DESCRIPTOR_HANDLE textureHandle = {};
+	D3D12_VERTEX_BUFFER_VIEW positionBufferView = {};
+	D3D12_VERTEX_BUFFER_VIEW attributeBufferView = {};
+	D3D12_INDEX_BUFFER_VIEW indexBufferView = {};
+	UINT indexCount = 0;
+
+	UINT firstInstance = 0; // into the instance buffer bound when the batch is recorded
+	UINT instanceCount = 0;
+
+	DrawBatch() = default;
+	DrawBatch(const DrawItem& p_item, UINT p_firstInstance); // in FramePacket.cpp, DrawItem needs DirectXMath
+
+	// the view-projection matrix and the instance buffer are bound once per list by the caller,
+	// so the recorded commands stay valid when the camera moves and can live in a bundle;
+	// state p_previous_p, the batch recorded right before on the same list, already set is skipped;
+	// the depth prepass binds the positions only and no texture
+	void Record(CommandRecorder& p_recorder, const DrawBatch* p_previous_p = nullptr, bool p_isDepthOnly = false) const;
+};
+
+// everything a G-buffer list binds before its first draw
+struct GBufferPassBindings
+{
+	ID3D12PipelineState* pipelineState_p = nullptr; // the depth EQUAL variant if there is a depth prepass
+	ID3D12PipelineState* depthPrepassPipelineState_p = nullptr; // null without a depth prepass
+	ID3D12RootSignature* rootSignature_p = nullptr; // of both
+	ID3D12DescriptorHeap* srvHeap_p = nullptr;
+	D3D12_VIEWPORT viewport = {};
+	D3D12_RECT scissorRect = {};
+	D3D12_CPU_DESCRIPTOR_HANDLE renderTargets = {}; // renderTargetCount consecutive descriptors
+	UINT renderTargetCount = 0;
+	D3D12_CPU_DESCRIPTOR_HANDLE depthStencil = {};
+	D3D12_GPU_VIRTUAL_ADDRESS instanceData = 0; // this frame's instance buffer, one VertexShaderInput per draw item
+};
+
+// state a freshly reset list needs before it can draw into the G-buffer
+void BindGBufferTargets(CommandRecorder& p_recorder, const GBufferPassBindings& p_bindings);
+
+// batches [p_firstBatch, p_endBatch), each skipping the state its predecessor on the list already set
+void RecordDrawBatches(CommandRecorder& p_recorder, const std::vector<DrawBatch>& p_drawBatches, size_t p_firstBatch, size_t p_endBatch,
+	bool p_isDepthOnly = false);
+
+// lists the G-buffer pass of p_batchCount batches is split over, one per MinDrawsPerRecordingList
+// batches and p_maxListCount at most; the batches go to them in chunks of GetRecordingChunkSize
+size_t GetRecordingListCount(size_t p_batchCount, size_t p_maxListCount);
+size_t GetRecordingChunkSize(size_t p_batchCount, size_t p_listCount);
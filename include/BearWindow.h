@@ -20,6 +20,7 @@ using namespace DirectX;
 
 #include "Helpers.h"
 #include "Camera.h"
+#include "GBufferEncoding.h"
 
 class BearWindow
 {
@@ -48,7 +49,8 @@ public:
 
 	// Pass the resources needed in Application/Editor
 	// physics is not handled here, but the window can decide whether to update physics or not based on the flag
-	void GetCurrentRenderResource(RenderResource& out_RR);
+	// p_gBufferSet picks the G-buffers, depth buffer and lit image, see GBufferSetCount
+	void GetCurrentRenderResource(RenderResource& out_RR, unsigned int p_gBufferSet);
 
 	/**
 	 * Present the swapchain's back buffer to the screen.
@@ -56,6 +58,15 @@ public:
 	 */
 	unsigned int Present();
 
+	// signaled when the swap chain can queue another frame, the frame loop waits on it before rendering
+	HANDLE GetFrameLatencyWaitableObject() const
+	{
+		return m_frameLatencyWaitableObject;
+	}
+
+	// number of presents that may be queued; follows the renderer's frames in flight
+	void SetMaximumFrameLatency(UINT p_maximumFrameLatency);
+
 	// Getters of attributes
 	// Return the current back buffer index.
 	unsigned int GetCurrentBackBufferIndex() const
@@ -119,20 +130,42 @@ public:
 
 	void GetCameraMatrices(XMMATRIX& out_viewProjMatrix, XMMATRIX& out_invPVMatrix) const;
 
+	const Camera& GetCamera() const
+	{
+		return m_camera;
+	}
+
 	LRESULT WindowMessageHandler(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam);
 
-	float HandleYPosition(float deltaSecond);
+	// what the window does with a message apart from DefWindowProc; the session replay calls it with logged input
+	void HandleInput(UINT message, WPARAM wParam, LPARAM lParam);
+
+	// advances the jump from the simulated height p_currentY, returns the new height
+	float HandleYPosition(float p_currentY, float p_deltaSecond);
 
 	// public accessible variables
 	static const unsigned int BufferCount = 3;
-	static const unsigned int FirstPassRTVCount = 3;
-	static const unsigned int TotalOfTwoPassesRTVCount = FirstPassRTVCount + 1; // 3 for first pass, 1 for second pass
-	static const unsigned int TotalRTVCount = BufferCount * TotalOfTwoPassesRTVCount;
-	static const unsigned int RequiredSizeInSRVHeap = BufferCount * FirstPassRTVCount + 1; // 3 SRV for first pass RTVs per frame + 1 SRV for depth buffer
+	static const unsigned int FirstPassRTVCount = GBufferEncoding::TargetCount;
+	// G-buffers, depth buffer and lit image; the compute queue may still light one frame's set while
+	// the next frame fills the other, so consecutive frames alternate between them
+	static const unsigned int GBufferSetCount = 2;
+	static const unsigned int GBufferRTVCount = GBufferSetCount * FirstPassRTVCount;
+	static const unsigned int TotalRTVCount = GBufferRTVCount + BufferCount; // G-buffers first, then back buffers
+	// per set: first pass RTV SRVs, depth buffer SRV, lit image UAV
+	static const unsigned int SRVHeapSizePerSet = FirstPassRTVCount + 2;
+	static const unsigned int RequiredSizeInSRVHeap = GBufferSetCount * SRVHeapSizePerSet;
+	static const DXGI_FORMAT LightingOutputFormat = DXGI_FORMAT_R8G8B8A8_UNORM; // that of the back buffers, copied into them
+	// G-buffer layout, see GBufferEncoding.h; the first pass pipeline state is built from the same list
+	static constexpr DXGI_FORMAT FirstPassRTVFormats[FirstPassRTVCount] = {
+		DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, // albedo, specular in alpha
+		DXGI_FORMAT_R16G16_UNORM // octahedral normal
+	};
 
 private:
-	// Update the RTVs (except back buffers) and DSV
+	// Update the RTVs (except back buffers), DSVs and lit image UAVs, with targets of the current size from GBufferPool
 	void _updateRTVAndDSV();
+	// hands the G-buffers, depth buffers and lit images back to GBufferPool
+	void _releaseTargets();
 
 	// back buffer needs some special handling
 	void _createBackBuffersAndViewport();
@@ -145,10 +178,14 @@ private:
 
 	// per-window resource
 	ComPtr<IDXGISwapChain4> m_dxgiSwapChain;
+	HANDLE m_frameLatencyWaitableObject = nullptr;
+	UINT m_maximumFrameLatency = 2;
 	unsigned int m_currentBackBufferIndex;
 	ComPtr<ID3D12DescriptorHeap> m_rtvHeap;
 	ComPtr<ID3D12DescriptorHeap> m_dsvHeap;
-	ComPtr<ID3D12Resource> m_windowResources[TotalRTVCount + 1]; // one more for depth buffer
+	// after the RTV resources: a depth buffer per set, then a lit image per set
+	ComPtr<ID3D12Resource> m_windowResources[TotalRTVCount + 2 * GBufferSetCount];
+	bool m_areTargetsAcquired = false; // G-buffers, depth buffers and lit images, released while hidden
 	D3D12_VIEWPORT m_viewport;
 	Camera m_camera;
 
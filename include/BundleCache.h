@@ -0,0 +1,121 @@
+#pragma once
+#include <d3d12.h>
+
+#include <wrl.h>
+using namespace Microsoft::WRL;
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "CommandRecorder.h"
+#include "FrustumCuller.h"
+
+struct DrawItem;
+struct VertexShaderInput;
+class Instance;
+class CommandQueue;
+class WorkerPool;
+
+// per frame, shown in the stats overlay
+struct BundleCacheStats
+{
+	unsigned int cachedInstances = 0; // replayed from bundles recorded in an earlier frame
+	unsigned int rerecordedInstances = 0; // in cells that were recorded this frame
+	unsigned int cellCount = 0;
+	unsigned int rerecordedCells = 0;
+	unsigned int culledCells = 0; // outside the view frustum, not executed
+	unsigned int drawCalls = 0; // instanced draws in the executed bundles
+	unsigned int drawnInstances = 0; // in the executed bundles
+};
+
+// Records the G-buffer draws of the scene into one bundle per spatial cell and replays
+// them every frame. Each bundle draws its cell's members as instanced batches, with instance
+// indices relative to the cell; the cell's transforms are copied into the instance buffer
+// every frame, and the list points the buffer at them before executing the bundle. A cell is recorded again only when an instance entered or left it,
+// or when one of its instances was edited, re-textured or removed (see Instance::GetRevision).
+// Cells hold every renderable instance, not only the visible ones, so turning the camera records
+// nothing; culling happens per cell, against the box around its members, when the bundles are executed.
+// Works on the draw items of a frame packet only, so it can run on the render thread.
+class BundleCache
+{
+public:
+	BundleCache(ComPtr<ID3D12Device2> p_device);
+
+	// edge length of a cell in world units
+	static constexpr float CellSize = 16.0f;
+
+	// Sorts the draw items of the whole scene (FramePacket::sceneItems) into cells and re-records the
+	// cells that changed, one task per cell. A changed pipeline state or root signature invalidates every cell.
+	void Update(const std::vector<DrawItem>& p_sceneItems, ComPtr<ID3D12RootSignature> p_rootSignature,
+		ComPtr<ID3D12PipelineState> p_pipelineState, ID3D12DescriptorHeap* p_srvHeap,
+		WorkerPool& p_workerPool, CommandQueue& p_commandQueue);
+
+	// The caller has bound the root signature, descriptor heap, render targets and per-list root constants.
+	// Executes the bundles of the cells inside p_frustumPlanes and copies the constants of their members to
+	// out_instanceData_p, which must hold one per draw item passed to Update(); p_instanceData is the GPU
+	// address of the same memory. Returns the number of constants copied.
+	size_t Execute(CommandRecorder& p_recorder, const FrustumPlanes& p_frustumPlanes, D3D12_GPU_VIRTUAL_ADDRESS p_instanceData,
+		VertexShaderInput* out_instanceData_p);
+
+	// Bundles replaced since the last call may still be in use by frames in flight;
+	// they are reused once this fence value has passed. Call after every frame submission.
+	void OnFrameSubmitted(uint64_t p_fenceValue);
+
+	// retires every cell, e.g. when caching is switched off
+	void Clear();
+
+	BundleCacheStats GetStats() const { return m_stats; }
+
+private:
+	struct BundleEntry
+	{
+		ComPtr<ID3D12CommandAllocator> allocator;
+		ComPtr<ID3D12GraphicsCommandList2> bundle;
+	};
+
+	struct CellMember
+	{
+		const Instance* instance_p;
+		uint64_t revision;
+		const DrawItem* item_p; // into the packet being rendered, only valid until Execute()
+
+		bool operator==(const CellMember& other) const
+		{
+			return instance_p == other.instance_p && revision == other.revision;
+		}
+	};
+
+	struct Cell
+	{
+		BundleEntry entry;
+		std::vector<CellMember> recordedMembers; // what the bundle holds
+		std::vector<CellMember> members; // what is in it this frame
+		BoundingAabb bounds; // around the world bounds of the members, this frame
+		unsigned int drawCount = 0; // batches the bundle draws
+	};
+
+	struct RetiredEntry
+	{
+		BundleEntry entry;
+		uint64_t fenceValue = 0; // 0 until the frame that stopped using it was submitted
+	};
+
+	ComPtr<ID3D12Device2> m_device;
+
+	std::unordered_map<uint64_t, Cell> m_cells;
+	std::vector<BundleEntry> m_freeEntries;
+	std::vector<RetiredEntry> m_retiredEntries;
+
+	// held, so a rebuilt shader cannot get the address of the one the bundles were recorded with
+	ComPtr<ID3D12RootSignature> m_recordedRootSignature;
+	ComPtr<ID3D12PipelineState> m_recordedPipelineState;
+
+	BundleCacheStats m_stats;
+	FrustumCuller m_cellCuller; // one box per cell, in m_cells' order
+
+	static uint64_t _getCellKey(const DrawItem& p_item);
+	void _retire(BundleEntry& p_entry);
+	void _releaseCompleted(CommandQueue& p_commandQueue);
+	void _recordCell(Cell& p_cell, ID3D12DescriptorHeap* p_srvHeap);
+};
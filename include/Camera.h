@@ -27,6 +27,12 @@ public:
 
 	XMMATRIX GetInvPVMatrix() const;
 
+	// not kept, maps store the camera as it is laid out
+	XMMATRIX GetViewMatrix() const;
+
+	// tangents of half the horizontal and vertical field of view, and the clip planes
+	void GetProjection(float& out_tanHalfFovX, float& out_tanHalfFovY, float& out_nearPlane, float& out_farPlane) const;
+
 	XMVECTOR GetFrontDirection() const;
 
 	Camera& operator=(const Camera& other);
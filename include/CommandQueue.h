@@ -1,5 +1,7 @@
 /**
  * Wrapper class for a ID3D12CommandQueue.
+ * Getting and executing command lists and waiting for fence values are thread-safe,
+ * so several threads can record, submit through one queue and wait on it at the same time.
  */
 
 #pragma once
@@ -8,9 +10,13 @@
 #include <wrl.h>    // For Microsoft::WRL::ComPtr
 
 #include <cstdint>  // For uint64_t
+#include <mutex>    // For std::mutex
 #include <queue>    // For std::queue
+#include <vector>   // For std::vector
 
-class CommandQueue
+#include "FenceQueue.h"
+
+class CommandQueue : public FenceQueue
 {
 public:
 	CommandQueue(Microsoft::WRL::ComPtr<ID3D12Device2> device, D3D12_COMMAND_LIST_TYPE type);
@@ -19,19 +25,33 @@ public:
 	// Get an available command list from the command queue.
 	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> GetCommandList();
 
+	// Get a command list recording into an allocator owned by the caller.
+	// The allocator is reset here, so the caller must know the GPU is done with it;
+	// it is not returned to the queue's pool on execution.
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> GetCommandList(Microsoft::WRL::ComPtr<ID3D12CommandAllocator> commandAllocator);
+
+	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CreateCommandAllocator();
+
 	// Execute a command list.
 	// Returns the fence value to wait for for this command list.
 	uint64_t ExecuteCommandList(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList);
 
+	// Execute several command lists in one ExecuteCommandLists call, in the given order.
+	// Returns the single fence value to wait for for all of them.
+	uint64_t ExecuteCommandLists(const std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>>& commandLists);
+
 	uint64_t Signal();
-	bool IsFenceComplete(uint64_t fenceValue);
-	void WaitForFenceValue(uint64_t fenceValue);
+	bool IsFenceComplete(uint64_t fenceValue) override;
+	void WaitForFenceValue(uint64_t fenceValue) override;
 	void Flush();
 
+	// The GPU waits for another queue's fence before running what is submitted here next,
+	// e.g. the compute queue for the direct queue's G-buffer. queue must be a CommandQueue.
+	void WaitForQueue(FenceQueue& queue, uint64_t fenceValue) override;
+
 	Microsoft::WRL::ComPtr<ID3D12CommandQueue> GetD3D12CommandQueue() const;
 protected:
 
-	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CreateCommandAllocator();
 	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> CreateCommandList(Microsoft::WRL::ComPtr<ID3D12CommandAllocator> allocator);
 
 private:
@@ -49,9 +69,11 @@ private:
 	Microsoft::WRL::ComPtr<ID3D12Device2>       m_d3d12Device;
 	Microsoft::WRL::ComPtr<ID3D12CommandQueue>  m_d3d12CommandQueue;
 	Microsoft::WRL::ComPtr<ID3D12Fence>         m_d3d12Fence;
-	HANDLE                                      m_FenceEvent;
 	uint64_t                                    m_FenceValue;
 
 	CommandAllocatorQueue                       m_CommandAllocatorQueue;
 	CommandListQueue                            m_CommandListQueue;
+
+	// guards both pools and the fence value
+	std::mutex                                  m_PoolMutex;
 };
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+#if !defined(_WIN32)
+#include <wsl/winadapter.h> // see Helpers.h
+#endif
+#include <d3d12.h>
+
+// The commands the renderer records, and nothing else. D3D12CommandRecorder forwards them to a
+// command list; NullCommandRecorder only counts and validates them, so frame recording can run
+// without a device, e.g. built on Linux against include/directx and the include/wsl adapter.
+// Arguments are the D3D12 ones; pipeline objects and descriptor heaps are only passed through,
+// a recorder without a device may get any non-null pointer for them.
+class CommandRecorder
+{
+public:
+	virtual ~CommandRecorder() = default;
+
+	virtual void SetPipelineState(ID3D12PipelineState* p_pipelineState_p) = 0;
+	virtual void SetGraphicsRootSignature(ID3D12RootSignature* p_rootSignature_p) = 0;
+	virtual void SetDescriptorHeaps(UINT p_heapCount, ID3D12DescriptorHeap* const* p_heaps_p) = 0;
+
+	virtual void SetGraphicsRootDescriptorTable(UINT p_rootParameter, D3D12_GPU_DESCRIPTOR_HANDLE p_baseDescriptor) = 0;
+	virtual void SetGraphicsRoot32BitConstants(UINT p_rootParameter, UINT p_valueCount, const void* p_data_p, UINT p_destOffset) = 0;
+	virtual void SetGraphicsRootConstantBufferView(UINT p_rootParameter, D3D12_GPU_VIRTUAL_ADDRESS p_bufferLocation) = 0;
+	virtual void SetGraphicsRootShaderResourceView(UINT p_rootParameter, D3D12_GPU_VIRTUAL_ADDRESS p_bufferLocation) = 0;
+
+	virtual void SetComputeRootSignature(ID3D12RootSignature* p_rootSignature_p) = 0;
+	virtual void SetComputeRootDescriptorTable(UINT p_rootParameter, D3D12_GPU_DESCRIPTOR_HANDLE p_baseDescriptor) = 0;
+	virtual void SetComputeRoot32BitConstants(UINT p_rootParameter, UINT p_valueCount, const void* p_data_p, UINT p_destOffset) = 0;
+	virtual void SetComputeRootConstantBufferView(UINT p_rootParameter, D3D12_GPU_VIRTUAL_ADDRESS p_bufferLocation) = 0;
+	virtual void SetComputeRootShaderResourceView(UINT p_rootParameter, D3D12_GPU_VIRTUAL_ADDRESS p_bufferLocation) = 0;
+
+	virtual void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY p_topology) = 0;
+	virtual void IASetVertexBuffers(UINT p_startSlot, UINT p_viewCount, const D3D12_VERTEX_BUFFER_VIEW* p_views_p) = 0;
+	virtual void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* p_view_p) = 0;
+
+	virtual void RSSetViewports(UINT p_viewportCount, const D3D12_VIEWPORT* p_viewports_p) = 0;
+	virtual void RSSetScissorRects(UINT p_rectCount, const D3D12_RECT* p_rects_p) = 0;
+	virtual void OMSetRenderTargets(UINT p_renderTargetCount, const D3D12_CPU_DESCRIPTOR_HANDLE* p_renderTargets_p,
+		BOOL p_isSingleHandleToDescriptorRange, const D3D12_CPU_DESCRIPTOR_HANDLE* p_depthStencil_p) = 0;
+
+	virtual void ClearRenderTargetView(D3D12_CPU_DESCRIPTOR_HANDLE p_renderTarget, const FLOAT p_color[4]) = 0;
+	virtual void ClearDepthStencilView(D3D12_CPU_DESCRIPTOR_HANDLE p_depthStencil, FLOAT p_depth) = 0;
+	virtual void ResourceBarrier(UINT p_barrierCount, const D3D12_RESOURCE_BARRIER* p_barriers_p) = 0;
+	virtual void CopyResource(ID3D12Resource* p_destination_p, ID3D12Resource* p_source_p) = 0;
+
+	virtual void DrawInstanced(UINT p_vertexCountPerInstance, UINT p_instanceCount, UINT p_startVertex, UINT p_startInstance) = 0;
+	virtual void DrawIndexedInstanced(UINT p_indexCountPerInstance, UINT p_instanceCount, UINT p_startIndex,
+		INT p_baseVertex, UINT p_startInstance) = 0;
+	virtual void Dispatch(UINT p_groupCountX, UINT p_groupCountY, UINT p_groupCountZ) = 0;
+
+	// p_bundle_p was recorded through a recorder of the same kind
+	virtual void ExecuteBundle(ID3D12GraphicsCommandList* p_bundle_p) = 0;
+};
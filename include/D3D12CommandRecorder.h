@@ -0,0 +1,150 @@
+#pragma once
+#include "CommandRecorder.h"
+
+// Records straight into a command list or bundle, which the caller keeps alive. Cheap to make,
+// one per list and thread.
+class D3D12CommandRecorder final : public CommandRecorder
+{
+public:
+	explicit D3D12CommandRecorder(ID3D12GraphicsCommandList* p_commandList_p)
+		: m_commandList_p(p_commandList_p)
+	{
+	}
+
+	void SetPipelineState(ID3D12PipelineState* p_pipelineState_p) override
+	{
+		m_commandList_p->SetPipelineState(p_pipelineState_p);
+	}
+
+	void SetGraphicsRootSignature(ID3D12RootSignature* p_rootSignature_p) override
+	{
+		m_commandList_p->SetGraphicsRootSignature(p_rootSignature_p);
+	}
+
+	void SetDescriptorHeaps(UINT p_heapCount, ID3D12DescriptorHeap* const* p_heaps_p) override
+	{
+		m_commandList_p->SetDescriptorHeaps(p_heapCount, p_heaps_p);
+	}
+
+	void SetGraphicsRootDescriptorTable(UINT p_rootParameter, D3D12_GPU_DESCRIPTOR_HANDLE p_baseDescriptor) override
+	{
+		m_commandList_p->SetGraphicsRootDescriptorTable(p_rootParameter, p_baseDescriptor);
+	}
+
+	void SetGraphicsRoot32BitConstants(UINT p_rootParameter, UINT p_valueCount, const void* p_data_p, UINT p_destOffset) override
+	{
+		m_commandList_p->SetGraphicsRoot32BitConstants(p_rootParameter, p_valueCount, p_data_p, p_destOffset);
+	}
+
+	void SetGraphicsRootConstantBufferView(UINT p_rootParameter, D3D12_GPU_VIRTUAL_ADDRESS p_bufferLocation) override
+	{
+		m_commandList_p->SetGraphicsRootConstantBufferView(p_rootParameter, p_bufferLocation);
+	}
+
+	void SetGraphicsRootShaderResourceView(UINT p_rootParameter, D3D12_GPU_VIRTUAL_ADDRESS p_bufferLocation) override
+	{
+		m_commandList_p->SetGraphicsRootShaderResourceView(p_rootParameter, p_bufferLocation);
+	}
+
+	void SetComputeRootSignature(ID3D12RootSignature* p_rootSignature_p) override
+	{
+		m_commandList_p->SetComputeRootSignature(p_rootSignature_p);
+	}
+
+	void SetComputeRootDescriptorTable(UINT p_rootParameter, D3D12_GPU_DESCRIPTOR_HANDLE p_baseDescriptor) override
+	{
+		m_commandList_p->SetComputeRootDescriptorTable(p_rootParameter, p_baseDescriptor);
+	}
+
+	void SetComputeRoot32BitConstants(UINT p_rootParameter, UINT p_valueCount, const void* p_data_p, UINT p_destOffset) override
+	{
+		m_commandList_p->SetComputeRoot32BitConstants(p_rootParameter, p_valueCount, p_data_p, p_destOffset);
+	}
+
+	void SetComputeRootConstantBufferView(UINT p_rootParameter, D3D12_GPU_VIRTUAL_ADDRESS p_bufferLocation) override
+	{
+		m_commandList_p->SetComputeRootConstantBufferView(p_rootParameter, p_bufferLocation);
+	}
+
+	void SetComputeRootShaderResourceView(UINT p_rootParameter, D3D12_GPU_VIRTUAL_ADDRESS p_bufferLocation) override
+	{
+		m_commandList_p->SetComputeRootShaderResourceView(p_rootParameter, p_bufferLocation);
+	}
+
+	void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY p_topology) override
+	{
+		m_commandList_p->IASetPrimitiveTopology(p_topology);
+	}
+
+	void IASetVertexBuffers(UINT p_startSlot, UINT p_viewCount, const D3D12_VERTEX_BUFFER_VIEW* p_views_p) override
+	{
+		m_commandList_p->IASetVertexBuffers(p_startSlot, p_viewCount, p_views_p);
+	}
+
+	void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* p_view_p) override
+	{
+		m_commandList_p->IASetIndexBuffer(p_view_p);
+	}
+
+	void RSSetViewports(UINT p_viewportCount, const D3D12_VIEWPORT* p_viewports_p) override
+	{
+		m_commandList_p->RSSetViewports(p_viewportCount, p_viewports_p);
+	}
+
+	void RSSetScissorRects(UINT p_rectCount, const D3D12_RECT* p_rects_p) override
+	{
+		m_commandList_p->RSSetScissorRects(p_rectCount, p_rects_p);
+	}
+
+	void OMSetRenderTargets(UINT p_renderTargetCount, const D3D12_CPU_DESCRIPTOR_HANDLE* p_renderTargets_p,
+		BOOL p_isSingleHandleToDescriptorRange, const D3D12_CPU_DESCRIPTOR_HANDLE* p_depthStencil_p) override
+	{
+		m_commandList_p->OMSetRenderTargets(p_renderTargetCount, p_renderTargets_p, p_isSingleHandleToDescriptorRange, p_depthStencil_p);
+	}
+
+	void ClearRenderTargetView(D3D12_CPU_DESCRIPTOR_HANDLE p_renderTarget, const FLOAT p_color[4]) override
+	{
+		m_commandList_p->ClearRenderTargetView(p_renderTarget, p_color, 0, nullptr);
+	}
+
+	void ClearDepthStencilView(D3D12_CPU_DESCRIPTOR_HANDLE p_depthStencil, FLOAT p_depth) override
+	{
+		m_commandList_p->ClearDepthStencilView(p_depthStencil, D3D12_CLEAR_FLAG_DEPTH, p_depth, 0, 0, nullptr);
+	}
+
+	void ResourceBarrier(UINT p_barrierCount, const D3D12_RESOURCE_BARRIER* p_barriers_p) override
+	{
+		m_commandList_p->ResourceBarrier(p_barrierCount, p_barriers_p);
+	}
+
+	void CopyResource(ID3D12Resource* p_destination_p, ID3D12Resource* p_source_p) override
+	{
+		m_commandList_p->CopyResource(p_destination_p, p_source_p);
+	}
+
+	void DrawInstanced(UINT p_vertexCountPerInstance, UINT p_instanceCount, UINT p_startVertex, UINT p_startInstance) override
+	{
+		m_commandList_p->DrawInstanced(p_vertexCountPerInstance, p_instanceCount, p_startVertex, p_startInstance);
+	}
+
+	void DrawIndexedInstanced(UINT p_indexCountPerInstance, UINT p_instanceCount, UINT p_startIndex,
+		INT p_baseVertex, UINT p_startInstance) override
+	{
+		m_commandList_p->DrawIndexedInstanced(p_indexCountPerInstance, p_instanceCount, p_startIndex, p_baseVertex, p_startInstance);
+	}
+
+	void Dispatch(UINT p_groupCountX, UINT p_groupCountY, UINT p_groupCountZ) override
+	{
+		m_commandList_p->Dispatch(p_groupCountX, p_groupCountY, p_groupCountZ);
+	}
+
+	void ExecuteBundle(ID3D12GraphicsCommandList* p_bundle_p) override
+	{
+		m_commandList_p->ExecuteBundle(p_bundle_p);
+	}
+
+	ID3D12GraphicsCommandList* GetCommandList() const { return m_commandList_p; }
+
+private:
+	ID3D12GraphicsCommandList* m_commandList_p;
+};
@@ -7,12 +7,44 @@ using namespace DirectX;
 #include <wrl.h>
 using namespace Microsoft::WRL;
 
+#include <atomic>
 #include <vector>
+#include <memory>
+#include <mutex>
 
 #include "Helpers.h"
 #include "Shader.h"
 #include "BearWindow.h"
 #include "EntityInstance.h"
+#include "HighResolutionClock.h"
+#include "WorkerPool.h"
+#include "BundleCache.h"
+#include "FramePacket.h"
+#include "GpuProfiler.h"
+#include "FrameRecording.h"
+#include "RenderQueue.h"
+#include "RenderGraph.h"
+#include "AsyncComputeScheduler.h"
+
+class CommandQueue;
+struct LightBufferAddresses;
+
+// averaged over the last second, per frame
+struct FramePacingStats
+{
+	double frameMilliseconds = 0.0;
+	double cpuWaitMilliseconds = 0.0; // CPU blocked on the fence of an older frame
+	double gpuIdleMilliseconds = 0.0; // gap between two frames on the direct queue timeline
+	unsigned int framesInFlight = 0;
+	double firstPassRecordMilliseconds = 0.0; // wall time to record all G-buffer draws
+	unsigned int firstPassCommandLists = 0; // lists the G-buffer draws were split into, last frame
+	unsigned int firstPassDrawCalls = 0; // instanced draws of the G-buffer pass, last frame
+	unsigned int firstPassInstances = 0; // instances they drew
+	unsigned int depthPrepassDrawCalls = 0; // instanced draws of the depth prepass, 0 without one
+	unsigned int shadowCascadesRendered = 0; // last frame, 0 without shadows
+	unsigned int shadowCascadesKept = 0; // left as an earlier frame drew them
+	unsigned int shadowDrawCalls = 0; // instanced draws into the cascades drawn
+};
 
 class D3D12Renderer
 {
@@ -24,30 +56,245 @@ public:
 	// Taken from Shader class; renderer will handle shaders in the plan
 	D3D12Renderer(const wchar_t* p_1stVsPath, const wchar_t* p_1sPsPath, const wchar_t* p_2ndVsPath, const wchar_t* p_2ndPsPath);
 
-	void Render(BearWindow& window);
+	// records and presents one frame into packet.window; called on the render thread only
+	void Render(const FramePacket& packet);
+
+	// The CPU may record up to this many frames before it waits on the GPU.
+	// Every frame in flight uses its own back buffer, so it cannot exceed BufferCount.
+	static const unsigned int MaxFramesInFlight = BearWindow::BufferCount;
+	static const unsigned int DefaultFramesInFlight = 2;
+
+	// takes effect at the start of the next frame, 1 means CPU and GPU run in lock-step
+	void SetFramesInFlight(unsigned int p_framesInFlight);
+	unsigned int GetFramesInFlight() const { return m_pendingFramesInFlight; }
+
+	// the setters and getters here may be called from the game thread while a frame is rendered
+	FramePacingStats GetFramePacingStats() const
+	{
+		std::lock_guard<std::mutex> lock(m_statsMutex);
+		return m_pacingStats;
+	}
+
+	// When enabled, the G-buffer pass replays per-cell bundles instead of recording every draw. The bundles
+	// draw every member of a cell in view, so the G-buffer pass then neither follows the render queue's order
+	// nor skips instances that per-instance frustum or occlusion culling removed; off by default.
+	void SetBundleCachingEnabled(bool p_isEnabled) { m_isBundleCachingEnabled = p_isEnabled; }
+	bool IsBundleCachingEnabled() const { return m_isBundleCachingEnabled; }
+
+	BundleCacheStats GetBundleCacheStats() const
+	{
+		std::lock_guard<std::mutex> lock(m_statsMutex);
+		return m_bundleCacheStats;
+	}
+
+	// of the last frame
+	RenderQueueStats GetRenderQueueStats() const
+	{
+		std::lock_guard<std::mutex> lock(m_statsMutex);
+		return m_renderQueueStats;
+	}
+
+	// When enabled, the scene is drawn into the depth buffer first, from the position stream alone, and the
+	// G-buffer pass then only shades the pixels whose depth is EQUAL to it. Pays off with a lot of overdraw.
+	void SetDepthPrepassEnabled(bool p_isEnabled) { m_isDepthPrepassEnabled = p_isEnabled; }
+	bool IsDepthPrepassEnabled() const { return m_isDepthPrepassEnabled; }
+
+	// one slice per cascade; 16 bits are plenty for a box fitted around the cascade
+	static const DXGI_FORMAT ShadowMapFormat = DXGI_FORMAT_D16_UNORM;
+
+	// When enabled, a shadow cascade is drawn only when its matrix changed or one of its casters moved,
+	// appeared or went away since the frame that last drew it, see ShadowMapCache.
+	void SetShadowCachingEnabled(bool p_isEnabled) { m_isShadowCachingEnabled = p_isEnabled; }
+	bool IsShadowCachingEnabled() const { return m_isShadowCachingEnabled; }
+
+	// per pass, read back MaxFramesInFlight frames late
+	GpuPassStats GetGpuPassStats() const { return m_gpuProfiler->GetStats(); }
+
+	// of the last frame's render graph
+	RenderGraphStats GetRenderGraphStats() const
+	{
+		std::lock_guard<std::mutex> lock(m_statsMutex);
+		return m_renderGraphStats;
+	}
+
+	// When enabled, the G-buffer is lit by a tiled compute shader on the compute queue, and the back buffer
+	// shows the previous frame's lit image, so that lighting overlaps the next frame's G-buffer pass.
+	// Otherwise the fullscreen quad lights it on the direct queue, within the frame. Taken by the next
+	// packet the game thread builds, which only bins the lights into clusters for the fullscreen quad.
+	void SetAsyncLightingEnabled(bool p_isEnabled) { m_isAsyncLightingEnabled = p_isEnabled; }
+	bool IsAsyncLightingEnabled() const { return m_isAsyncLightingEnabled; }
+
+	// since start
+	AsyncComputeStats GetAsyncComputeStats() const
+	{
+		std::lock_guard<std::mutex> lock(m_statsMutex);
+		return m_asyncComputeStats;
+	}
 
 private:
-	void _transitionResource(ComPtr<ID3D12GraphicsCommandList2> commandList,
-		Microsoft::WRL::ComPtr<ID3D12Resource> resource,
-		D3D12_RESOURCE_STATES beforeState, D3D12_RESOURCE_STATES afterState);
+	// everything a frame owns until its fences on both queues have passed
+	struct FrameContext
+	{
+		ComPtr<ID3D12CommandAllocator> commandAllocator;
+		// one per list the G-buffer pass can be split into, each list is recorded by one thread
+		std::vector<ComPtr<ID3D12CommandAllocator>> recordingAllocators;
+		// lighting pass and UI, recorded after the G-buffer lists when those were split
+		ComPtr<ID3D12CommandAllocator> compositeAllocator;
+		// compute queue, the tiled lighting
+		ComPtr<ID3D12CommandAllocator> computeAllocator;
+		// copy of the lit image into the back buffer and UI, submitted after the tiled lighting
+		ComPtr<ID3D12CommandAllocator> presentAllocator;
+		// closes the timing of the D2D overlay, which is submitted by D3D11on12 in between
+		ComPtr<ID3D12CommandAllocator> overlayAllocator;
+		// transforms of the frame's draw items, read by the G-buffer vertex shader; mapped for good, grown on demand
+		ComPtr<ID3D12Resource> instanceBuffer;
+		VertexShaderInput* instanceData_p = nullptr;
+		size_t instanceCapacity = 0;
+		bool hasTimestamps = false; // start and end of the frame were written to the query heap
+	};
 
-	// Clear a render target view.
-	void _clearRTV(ComPtr<ID3D12GraphicsCommandList2> commandList,
-		D3D12_CPU_DESCRIPTOR_HANDLE rtv, FLOAT* clearColor);
+	// where the frame's passes and resources are in m_renderGraph
+	struct FrameGraph
+	{
+		uint32_t gBufferTargets[BearWindow::FirstPassRTVCount];
+		uint32_t depthBuffer;
+		uint32_t shadowMaps; // of the G-buffer set
+		uint32_t backBuffer;
+		uint32_t lightingOutput; // the lit image copied into the back buffer; RenderGraphInvalidIndex unless lit asynchronously
+		uint32_t shadowPass; // RenderGraphInvalidIndex if every cascade is kept
+		uint32_t gBufferPass;
+		uint32_t lightingHandOffPass; // end of the direct queue's part before the tiled lighting; RenderGraphInvalidIndex unless lit asynchronously
+		uint32_t lightingPass; // the fullscreen quad, or the copy of the lit image
+		uint32_t imGuiPass; // RenderGraphInvalidIndex without the editor UI
+	};
 
-	// Clear the depth of a depth-stencil view.
-	void _clearDepthBuffer(ComPtr<ID3D12GraphicsCommandList2> commandList,
-		D3D12_CPU_DESCRIPTOR_HANDLE dsv, FLOAT depth = 1.0f);
+	// Describes the frame to m_renderGraph and compiles it; the barriers between the passes come from it.
+	// The G-buffers, depth, shadow maps, back buffer and lit image are imported in the states they are left in between frames.
+	// p_compositeSource_p is the lit image the back buffer gets if the frame is lit on the compute queue, nullptr otherwise.
+	void _buildFrameGraph(const RenderResource& currentRR, bool p_hasScene, unsigned int p_gBufferSet, bool p_hasShadowPass,
+		ID3D12Resource* p_compositeSource_p);
+	// one ResourceBarrier call for the batch
+	void _recordGraphBarriers(CommandRecorder& recorder, const RenderGraphBarrier* p_barriers_p, size_t p_count);
 
-	void _renderFirstPass(ComPtr<ID3D12GraphicsCommandList2> commandList, const std::vector<Instance*>& instanceList, const XMMATRIX& vpMatrix);
+	// the G-buffer pass state for the window being rendered
+	void _getGBufferBindings(const RenderResource& currentRR, bool hasDepthPrepass, GBufferPassBindings& out_bindings);
 
-	void _renderSecondPass(ComPtr<ID3D12GraphicsCommandList2> commandList, const XMMATRIX& invSPVMatrix, const RenderResource& currentRR);
+	// Decides which of the packet's cascades are drawn into the G-buffer set's shadow maps this frame,
+	// into m_isShadowCascadeDrawn; returns how many, out_instanceCount the transforms their casters take.
+	unsigned int _selectShadowCascades(const FramePacket& packet, unsigned int gBufferSet, size_t& out_instanceCount);
+
+	// Fills the frame's instance buffer from instanceOffset on with the casters of the cascades selected above
+	// and draws them into the G-buffer set's shadow maps on recorder's list.
+	void _recordShadowMaps(FrameContext& frameContext, CommandRecorder& recorder, const FramePacket& packet,
+		unsigned int gBufferSet, D3D12_GPU_VIRTUAL_ADDRESS instanceData, size_t instanceOffset);
+
+	// the cascades of the G-buffer set's shadow maps, as the lighting reads them
+	D3D12_GPU_DESCRIPTOR_HANDLE _getShadowMapTable(unsigned int gBufferSet) const;
+
+	// makes room for instanceCount transforms in the frame's instance buffer, returns its address;
+	// the slot's previous frame has finished, so the buffer can be replaced
+	D3D12_GPU_VIRTUAL_ADDRESS _reserveInstanceData(FrameContext& frameContext, size_t instanceCount);
+
+	// Fills the frame's instance buffer in item order and builds m_drawBatches from the draw items,
+	// then records their positions into the depth buffer on recorder's list.
+	void _recordDepthPrepass(FrameContext& frameContext, CommandRecorder& recorder,
+		const std::vector<DrawItem>& drawItems, const XMMATRIX& vpMatrix, const GBufferPassBindings& bindings);
+
+	// Fills the frame's instance buffer and, given bundledItems_p, the whole scene, replays the bundle cache
+	// on mainCommandList. Otherwise groups the draw items into instanced batches and splits those across the
+	// recording pool, one command list per chunk; the lists are appended to out_commandLists in draw order.
+	// With few batches everything is recorded into mainCommandList instead and nothing is appended.
+	void _recordFirstPass(FrameContext& frameContext, ComPtr<ID3D12GraphicsCommandList2> mainCommandList,
+		const std::vector<DrawItem>& drawItems, const std::vector<DrawItem>* bundledItems_p, const XMMATRIX& vpMatrix,
+		const GBufferPassBindings& bindings, std::vector<ComPtr<ID3D12GraphicsCommandList2>>& out_commandLists);
+
+	// Records the tiled lighting of currentRR's G-buffer set on the compute queue and submits it
+	// behind a GPU wait for the direct queue's gBufferFenceValue.
+	void _submitTiledLighting(FrameContext& frameContext, UINT frameSlot, const RenderResource& currentRR, unsigned int gBufferSet,
+		const LightBufferAddresses& lightAddresses, const XMMATRIX& invScreenPVMatrix, uint64_t gBufferFenceValue);
 
 	void _prepare2ndPassResources();
+	void _prepareShadowMaps();
+	void _prepareFrameContexts();
+
+	// waits until the frame slot is free again on both queues, returns the slot to record into
+	UINT _beginFrame();
+	void _endFrame(ComPtr<ID3D12GraphicsCommandList2> commandList, UINT frameSlot);
+	double _readGpuIdleMilliseconds(UINT frameSlot);
+	void _accumulateFramePacing(double cpuWaitMilliseconds, double gpuIdleMilliseconds);
+
+	FrameContext m_frameContexts[MaxFramesInFlight];
+	unsigned int m_framesInFlight = DefaultFramesInFlight;
+	std::atomic<unsigned int> m_pendingFramesInFlight = DefaultFramesInFlight;
+	uint64_t m_frameNumber = 0;
+
+	// two timestamps per frame slot: start and end of its command list
+	ComPtr<ID3D12QueryHeap> m_timestampQueryHeap;
+	ComPtr<ID3D12Resource> m_timestampReadbackBuffer;
+	uint64_t m_timestampFrequency = 1;
+	uint64_t m_lastGpuFrameEnd = 0;
+
+	HighResolutionClock m_pacingClock;
+	double m_pacingWindowInSeconds = 0.0;
+	double m_accumulatedCpuWaitMilliseconds = 0.0;
+	double m_accumulatedGpuIdleMilliseconds = 0.0;
+	double m_accumulatedRecordMilliseconds = 0.0;
+	unsigned int m_lastRecordingListCount = 0;
+	unsigned int m_lastDrawCount = 0;
+	unsigned int m_lastInstanceCount = 0;
+	unsigned int m_lastDepthPrepassDrawCount = 0;
+	unsigned int m_lastShadowCascadesRendered = 0;
+	unsigned int m_lastShadowCascadesKept = 0;
+	unsigned int m_lastShadowDrawCount = 0;
+	std::vector<DrawBatch> m_drawBatches; // of the frame being recorded, kept for its capacity
+
+	RenderGraph m_renderGraph;
+	FrameGraph m_frameGraph;
+	std::vector<ID3D12Resource*> m_graphResources; // by render graph resource
+	std::vector<D3D12_RESOURCE_BARRIER> m_graphBarriers; // of the batch being recorded
+	RenderGraphStats m_renderGraphStats; // copied from m_renderGraph every frame
+
+	// fences between the direct and compute queues
+	std::unique_ptr<AsyncComputeScheduler> m_asyncScheduler;
+	AsyncComputeStats m_asyncComputeStats; // copied from m_asyncScheduler every frame
+	// The previous frame's lit image if it was lit asynchronously, and its window; the next frame of the
+	// same window copies it. Held so that a new texture at the same address is not taken for it.
+	ComPtr<ID3D12Resource> m_lastLightingOutput;
+	BearWindow* m_lastLightingWindow_p = nullptr;
+
+	// sorts the packet's draw items; the sorted copy is what the frame records
+	RenderQueue m_renderQueue;
+	std::vector<DrawItem> m_sortedDrawItems;
+	unsigned int m_accumulatedFrames = 0;
+	FramePacingStats m_pacingStats;
+	BundleCacheStats m_bundleCacheStats; // copied from m_bundleCache after every update
+	RenderQueueStats m_renderQueueStats; // copied from m_renderQueue every frame
+	mutable std::mutex m_statsMutex;
 
-	uint64_t m_fenceValues[BearWindow::BufferCount] = {};
 	D3D12_RECT m_scissorRect;
 
+	std::unique_ptr<WorkerPool> m_recordingPool;
+
+	std::unique_ptr<BundleCache> m_bundleCache;
+
+	std::unique_ptr<GpuProfiler> m_gpuProfiler;
+	std::atomic<bool> m_isBundleCachingEnabled = false;
+	std::atomic<bool> m_isAsyncLightingEnabled = true;
+	std::atomic<bool> m_isDepthPrepassEnabled = false;
+	std::atomic<bool> m_isShadowCachingEnabled = true;
+
+	// Per G-buffer set, like the G-buffers: the compute queue may still light a frame with one set's
+	// maps while the next frame draws into the other. A cascade kept in one set may have been drawn
+	// again in the other, so each set remembers its own, see ShadowMapCache.
+	ComPtr<ID3D12Resource> m_shadowMaps[BearWindow::GBufferSetCount];
+	ComPtr<ID3D12DescriptorHeap> m_shadowMapDsvHeap; // by set, then cascade
+	unsigned int m_shadowMapOffsetInSRVHeap = 0; // one array view per set
+	ShadowMapCache m_shadowMapCache{ BearWindow::GBufferSetCount };
+	bool m_isShadowCascadeDrawn[ShadowCascadeCount] = {}; // of the frame being recorded
+	std::vector<uint64_t> m_shadowCasterRevisions; // scratch, of one cascade
+	std::vector<DrawItem> m_shadowCascadeItems; // scratch, of one cascade
+	std::vector<DrawBatch> m_shadowDrawBatches; // scratch, of one cascade
+
 	Shader* m_shader_p;
 
 	ComPtr<ID3D12Resource> m_2ndPassVertexBuffer;
@@ -0,0 +1,29 @@
+#pragma once
+#include <d3d12.h>
+
+#include <wrl.h>
+using namespace Microsoft::WRL;
+
+#include "GpuProfiler.h"
+
+// Timestamp queries in a query heap, resolved into a readback buffer that stays mapped.
+// Command list handles are ID3D12GraphicsCommandList* on the queue the frequency was read from.
+class D3D12TimestampBackend : public GpuTimestampBackend
+{
+public:
+	D3D12TimestampBackend(ComPtr<ID3D12Device2> p_device, ComPtr<ID3D12CommandQueue> p_commandQueue);
+	~D3D12TimestampBackend() override;
+
+	void Initialize(uint32_t p_queryCount) override;
+	void WriteTimestamp(GpuCommandListHandle p_commandList, uint32_t p_query) override;
+	void Resolve(GpuCommandListHandle p_commandList, uint32_t p_firstQuery, uint32_t p_queryCount) override;
+	void ReadResolved(uint32_t p_firstQuery, uint32_t p_queryCount, uint64_t* out_ticks) override;
+	uint64_t GetFrequency() const override { return m_frequency; }
+
+private:
+	ComPtr<ID3D12Device2> m_device;
+	ComPtr<ID3D12QueryHeap> m_queryHeap;
+	ComPtr<ID3D12Resource> m_readbackBuffer;
+	const uint64_t* m_mappedTicks_p = nullptr;
+	uint64_t m_frequency = 1;
+};
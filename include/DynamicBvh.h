@@ -0,0 +1,103 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "FrustumCuller.h"
+
+// Incremental bounding volume hierarchy over boxes that come and go. Leaves are inserted where
+// they grow the tree's surface area the least and removed by splicing in their sibling; both
+// rebalance the ancestors with AVL-style rotations. A leaf whose box changed is refit in place:
+// its ancestors grow or shrink to fit and, on the way up, swap a child with a grandchild when
+// that shrinks the inner node (Kopta et al., tree rotations for animated scenes).
+// Nodes live in one flat array and are addressed by index, a free list recycles them. Each node
+// is one cache line; queries test a node with SSE, four frustum planes or the three ray slabs
+// at a time.
+class DynamicBvh
+{
+public:
+	static const int32_t NullNode = -1;
+
+	// returns the leaf, valid until it is removed
+	int32_t Insert(const BoundingAabb& p_bounds, void* p_userData_p);
+	void Remove(int32_t p_leaf);
+	void Refit(int32_t p_leaf, const BoundingAabb& p_bounds);
+	void Clear();
+
+	void* GetUserData(int32_t p_leaf) const { return m_nodes[p_leaf].userData_p; }
+
+	// the user data of every leaf not entirely outside p_planes; a subtree entirely inside
+	// is taken whole, without testing its nodes
+	void QueryFrustum(const FrustumPlanes& p_planes, std::vector<void*>& out_userData);
+
+	// Walks the leaves whose box the ray p_origin + t * p_direction enters for some t in
+	// [0, p_maxT], nearest node first. p_leafTest gets the user data and the current maxT and
+	// returns the t of its own hit, or maxT if it missed; later leaves are clipped to it.
+	// Returns the nearest t found, p_maxT if nothing was hit.
+	float RayCast(const float* p_origin_p, const float* p_direction_p, float p_maxT,
+		const std::function<float(void*, float)>& p_leafTest);
+
+	int32_t GetHeight() const { return m_root == NullNode ? 0 : m_nodes[m_root].height; }
+	uint32_t GetLeafCount() const { return m_leafCount; }
+	uint32_t GetNodeCount() const { return static_cast<uint32_t>(m_nodes.size()) - m_freeCount; }
+
+	// nodes tested by the last query
+	uint32_t GetLastQueryNodes() const { return m_lastQueryNodes; }
+
+	// rotations applied since the tree was created or cleared
+	uint64_t GetRotationCount() const { return m_rotationCount; }
+
+	// Walks the whole tree: every child links back to its parent, every inner node's box and height
+	// are exactly those of its children, and the leaf and free node counts add up. For tests.
+	bool IsValid() const;
+
+private:
+	struct alignas(64) Node
+	{
+		float minimum[4]; // w unused, so a box is two SSE loads
+		float maximum[4];
+		void* userData_p;
+		int32_t parent; // next free node while the node is free
+		int32_t child1;
+		int32_t child2;
+		int32_t height; // 0 for leaves, -1 while free
+
+		bool IsLeaf() const { return child1 == NullNode; }
+	};
+
+	std::vector<Node> m_nodes;
+	int32_t m_root = NullNode;
+	int32_t m_freeList = NullNode;
+	uint32_t m_freeCount = 0;
+	uint32_t m_leafCount = 0;
+	uint32_t m_lastQueryNodes = 0;
+	uint64_t m_rotationCount = 0;
+
+	struct RayStackEntry
+	{
+		int32_t node;
+		float entryT; // where the ray enters the node's box
+	};
+
+	// traversal, kept between queries
+	std::vector<int32_t> m_stack;
+	std::vector<int32_t> m_leafStack; // subtrees taken whole
+	std::vector<RayStackEntry> m_rayStack;
+
+	int32_t _allocateNode();
+	void _freeNode(int32_t p_node);
+
+	void _insertLeaf(int32_t p_leaf);
+	void _removeLeaf(int32_t p_leaf);
+
+	// AVL rotation of p_node's taller child up; returns the node now in p_node's place
+	int32_t _balance(int32_t p_node);
+
+	// surface area rotation below p_node, whose leaves stay the same
+	void _rotate(int32_t p_node);
+
+	void _fitToChildren(int32_t p_node);
+	void _collectLeaves(int32_t p_node, std::vector<void*>& out_userData);
+	static float _halfArea(const float* p_minimum_p, const float* p_maximum_p);
+	float _unionHalfArea(int32_t p_a, int32_t p_b) const;
+};
@@ -5,6 +5,7 @@ using namespace DirectX;
 #include <string>
 #include <Mesh.h>
 #include <Texture.h>
+#include <FramePacket.h>
 
 #include <Helpers.h>
 #include <JoltHelper.h>
@@ -60,10 +61,23 @@ public:
 
 	void SetTextureByName(const std::string& p_textureName);
 
-	void Render(ComPtr<ID3D12GraphicsCommandList2> p_commandList, const XMMATRIX& p_vpMatrix);
+	// copies what the draw needs into out_item, so it can be recorded on another thread;
+	// false if no mesh is assigned
+	bool FillDrawItem(DrawItem& out_item) const;
+
+	// changes whenever anything that ends up in the recorded commands changes, unique across instances
+	uint64_t GetRevision() const { return m_revision; }
+
+	// the mesh's bounds through the model matrix, kept up to date with the transform and the mesh
+	const BoundingAabb& GetWorldBounds() const { return m_worldBounds; }
+
+	// nearest hit of the world space ray p_origin + t * p_direction on the mesh, for t in [0, p_maxT]
+	bool IntersectRay(const XMVECTOR& p_origin, const XMVECTOR& p_direction, float p_maxT, float& out_t) const;
 
 	bool isRenderable = true;
 
+	int32_t bvhLeaf = -1; // kept by SceneBvh
+
 private:
 	std::string m_name;
 	XMVECTOR m_position = XMVectorZero();
@@ -76,5 +90,11 @@ private:
 	BodyID m_bodyID; // for physics, start with invalid
 	JoltBodyShape m_bodyShape = JoltBodyShape::Empty;
 
+	uint64_t m_revision = 0;
+
+	BoundingAabb m_worldBounds;
+
 	void _updateModelMatrix();
+	void _updateWorldBounds();
+	void _bumpRevision();
 };
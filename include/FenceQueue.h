@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+
+// The fence side of a command queue: every submission signals the queue's fence with the next
+// value, so a fence value stands for "everything submitted up to here". CommandQueue implements it
+// on a D3D12 queue, MockFenceQueue on a timeline of its own, for running the scheduling without a device.
+class FenceQueue
+{
+public:
+	virtual ~FenceQueue() = default;
+
+	// Makes this queue wait, on the GPU, until p_queue's fence reaches p_fenceValue; work submitted
+	// to this queue afterwards starts after that. The CPU does not block.
+	// p_queue is of the same kind as this one.
+	virtual void WaitForQueue(FenceQueue& p_queue, uint64_t p_fenceValue) = 0;
+
+	virtual bool IsFenceComplete(uint64_t p_fenceValue) = 0;
+
+	// blocks the CPU until the fence reaches p_fenceValue
+	virtual void WaitForFenceValue(uint64_t p_fenceValue) = 0;
+};
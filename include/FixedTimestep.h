@@ -0,0 +1,40 @@
+#pragma once
+
+// Accumulates variable frame times and hands them out as fixed simulation steps.
+// The simulation then behaves the same at any frame rate; the renderer blends the
+// last two simulated states with GetAlpha(). At most m_maxStepsPerFrame steps run
+// per frame, the rest of a long frame is dropped, so a slow frame cannot make the
+// next one slower (the "spiral of death").
+class FixedTimestep
+{
+public:
+	FixedTimestep(double p_tickRate = 60.0, unsigned int p_maxStepsPerFrame = 5);
+
+	// steps per second
+	void SetTickRate(double p_tickRate);
+	double GetTickRate() const { return m_tickRate; }
+	double GetStepSeconds() const { return m_stepSeconds; }
+
+	void SetMaxStepsPerFrame(unsigned int p_maxStepsPerFrame);
+	unsigned int GetMaxStepsPerFrame() const { return m_maxStepsPerFrame; }
+
+	// adds the frame time and returns how many steps to simulate now
+	unsigned int Advance(double p_frameSeconds);
+
+	// how far the present is between the last two simulated states, in [0, 1)
+	double GetAlpha() const { return m_accumulatedSeconds / m_stepSeconds; }
+
+	void Reset();
+
+	unsigned int GetLastStepCount() const { return m_lastStepCount; }
+	double GetDroppedSeconds() const { return m_droppedSeconds; } // since the last Reset
+
+private:
+	double m_tickRate;
+	double m_stepSeconds;
+	unsigned int m_maxStepsPerFrame;
+
+	double m_accumulatedSeconds = 0.0;
+	double m_droppedSeconds = 0.0;
+	unsigned int m_lastStepCount = 0;
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+
+// Triple buffer between one producer and one consumer. The producer fills the write slot
+// and publishes it, the consumer takes the newest published slot. Neither side ever waits
+// for the other to finish with a slot: the producer always has a slot of its own, and an
+// unread slot is simply overwritten by the next publish, so only the latest frame is kept.
+template <typename T>
+class FrameMailbox
+{
+public:
+	// producer side, valid until the next Publish()
+	T& GetWriteSlot()
+	{
+		return m_slots[m_writeIndex];
+	}
+
+	// Hands the write slot to the consumer and returns a fresh one. Returns true if
+	// the previously published slot had not been taken yet and was dropped.
+	bool Publish()
+	{
+		bool hasDropped = false;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			std::swap(m_writeIndex, m_readyIndex);
+			hasDropped = m_hasReady;
+			m_hasReady = true;
+		}
+		m_readyCondition.notify_one();
+
+		return hasDropped;
+	}
+
+	// Consumer side: waits up to p_timeout for a published slot. The returned slot stays
+	// valid until the next call; nullptr on timeout or once the mailbox was closed.
+	T* Acquire(std::chrono::milliseconds p_timeout)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_readyCondition.wait_for(lock, p_timeout, [this] { return m_hasReady || m_isClosed; });
+
+		if (!m_hasReady || m_isClosed)
+		{
+			return nullptr;
+		}
+
+		std::swap(m_readIndex, m_readyIndex);
+		m_hasReady = false;
+
+		return &m_slots[m_readIndex];
+	}
+
+	// wakes the consumer, Acquire() returns nullptr from now on
+	void Close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_isClosed = true;
+		}
+		m_readyCondition.notify_all();
+	}
+
+private:
+	T m_slots[3];
+	unsigned int m_writeIndex = 0; // owned by the producer
+	unsigned int m_readyIndex = 1; // published, or free if m_hasReady is false
+	unsigned int m_readIndex = 2; // owned by the consumer
+	bool m_hasReady = false;
+	bool m_isClosed = false;
+
+	std::mutex m_mutex;
+	std::condition_variable m_readyCondition;
+};
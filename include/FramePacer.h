@@ -0,0 +1,96 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+// averaged over the last second
+struct FramePacerStats
+{
+	double frameMilliseconds = 0.0;
+	double jitterMilliseconds = 0.0; // standard deviation of the frame time
+	double latenessMilliseconds = 0.0; // mean time the frame started after its deadline
+	double maxLatenessMilliseconds = 0.0;
+	double cpuUtilization = 0.0; // process CPU time over wall time, 1.0 is one full core
+	double sleepFraction = 0.0; // share of wall time the pacing thread spent asleep
+};
+
+// The platform part of the pacer: how to sleep until an absolute time and how to read
+// the CPU time of the process. All times are std::chrono::steady_clock.
+class FrameWaitBackend
+{
+public:
+	virtual ~FrameWaitBackend() = default;
+
+	// Blocks until p_deadline. Returns false if it woke up early because the
+	// platform has other work for the thread, e.g. window messages.
+	virtual bool SleepUntil(std::chrono::steady_clock::time_point p_deadline) = 0;
+
+	// Blocks until the presentation queue can take another frame; the argument is the
+	// swap chain's frame latency object where the platform has one. Returns immediately otherwise.
+	virtual void WaitForPresentQueue(void*) {}
+
+	virtual double GetProcessCpuSeconds() = 0;
+};
+
+// high-resolution waitable timer and message-aware wait on Windows, clock_nanosleep elsewhere
+std::unique_ptr<FrameWaitBackend> CreateDefaultFrameWaitBackend();
+
+// Schedules frames on fixed deadlines and sleeps in between, instead of polling a clock.
+// The OS sleep stops a little before the deadline and the rest is spun, so waking
+// up late does not add jitter; the spin is short enough to keep the idle CPU low.
+class FramePacer
+{
+public:
+	FramePacer(std::unique_ptr<FrameWaitBackend> p_backend, double p_frameIntervalInSeconds);
+
+	void SetFrameInterval(double p_frameIntervalInSeconds);
+	double GetFrameInterval() const { return m_frameIntervalInSeconds; }
+
+	// Sleeps until the next frame is due and returns true. Returns false if the backend
+	// woke up early; the caller handles whatever woke it and calls again.
+	bool WaitForNextFrame();
+
+	// restarts the schedule from now, e.g. after a window switch
+	void Reset();
+
+	// non-blocking check, for callers that cannot sleep, e.g. inside a modal window loop
+	bool IsFrameDue() const;
+
+	// Starts the frame: moves the deadline one interval on and returns the seconds since
+	// the previous frame. A frame that is more than one interval late resets the schedule
+	// instead of trying to catch up.
+	double BeginFrame();
+
+	// Blocks until the swap chain can take another frame. The only call that may come from
+	// another thread than the pacing one, it touches nothing but the backend.
+	void WaitForPresentQueue(void* p_waitable);
+
+	FramePacerStats GetStats() const { return m_stats; }
+
+	// the OS sleep ends this long before the deadline, the rest is spun
+	static constexpr double SpinMarginInSeconds = 0.0005;
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	std::unique_ptr<FrameWaitBackend> m_backend;
+	double m_frameIntervalInSeconds;
+	Clock::duration m_frameInterval;
+	Clock::time_point m_nextDeadline;
+	Clock::time_point m_lastFrameStart;
+	bool m_hasStarted = false;
+
+	// accumulated over the stats window
+	Clock::time_point m_windowStart;
+	double m_windowCpuSecondsStart = 0.0;
+	double m_sleptSeconds = 0.0;
+	double m_frameSecondsSum = 0.0;
+	double m_frameSecondsSquaredSum = 0.0;
+	double m_latenessSecondsSum = 0.0;
+	double m_maxLatenessSeconds = 0.0;
+	unsigned int m_frameCount = 0;
+
+	FramePacerStats m_stats;
+
+	void _accumulate(double p_frameSeconds, double p_latenessSeconds, Clock::time_point p_now);
+};
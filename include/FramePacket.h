@@ -0,0 +1,102 @@
+#pragma once
+#include <d3d12.h>
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <wrl.h>
+using namespace Microsoft::WRL;
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "imgui.h"
+#include "Helpers.h"
+#include "BatchRecording.h"
+#include "LightClusterer.h"
+#include "ShadowCascades.h"
+
+class BearWindow;
+class Instance;
+
+// Everything one draw of the G-buffer pass needs, copied out of the instance, its mesh and
+// its texture on the game thread. The render thread never touches the Instance itself.
+struct DrawItem
+{
+	const Instance* instance_p = nullptr; // identity only, may already be deleted when the item is recorded
+	uint64_t revision = 0; // Instance::GetRevision() when the item was filled
+
+	D3D12_GPU_DESCRIPTOR_HANDLE textureHandle = {};
+	D3D12_VERTEX_BUFFER_VIEW positionBufferView = {}; // slot 0, see FirstPassVertexAttributes
+	D3D12_VERTEX_BUFFER_VIEW attributeBufferView = {}; // slot 1, of the same mesh
+	D3D12_INDEX_BUFFER_VIEW indexBufferView = {};
+	UINT indexCount = 0;
+	uint32_t meshId = 0; // for the render queue's sort key
+	uint32_t materialId = 0; // the texture's index
+
+	VertexShaderInput constants; // model matrix and its inverse transpose, goes to the instance buffer
+	BoundingAabb worldBounds; // for culling on the render thread, see BundleCache
+
+	// same mesh and texture, so both can be drawn by one instanced call
+	bool IsSameBatch(const DrawItem& p_other) const
+	{
+		return positionBufferView.BufferLocation == p_other.positionBufferView.BufferLocation &&
+			indexBufferView.BufferLocation == p_other.indexBufferView.BufferLocation &&
+			textureHandle.ptr == p_other.textureHandle.ptr;
+	}
+
+	// orders by mesh, then texture, so items of one batch end up next to each other;
+	// independent of the camera, unlike the render queue
+	static bool IsInBatchOrder(const DrawItem& p_left, const DrawItem& p_right);
+};
+
+// ImGui's draw data of one frame, with the draw lists copied out of the ImGui context,
+// so the render thread can draw it while the game thread already builds the next frame.
+struct ImGuiDrawSnapshot
+{
+	ImGuiDrawSnapshot() = default;
+	ImGuiDrawSnapshot(const ImGuiDrawSnapshot&) = delete;
+	ImGuiDrawSnapshot& operator=(const ImGuiDrawSnapshot&) = delete;
+	~ImGuiDrawSnapshot() { Clear(); }
+
+	ImDrawData drawData; // CmdLists point into ownedLists; Textures is null, they were updated when the snapshot was taken
+
+	bool IsValid() const { return drawData.Valid; }
+	void Clear();
+
+	std::vector<ImDrawList*> ownedLists;
+};
+
+// What the game thread hands to the render thread for one frame. Filled once, then only read
+// while it is being rendered; nothing in it points to state the game thread keeps changing.
+struct FramePacket
+{
+	std::shared_ptr<BearWindow> window; // keeps the window alive until the frame was submitted
+	GameState gameState = GameState::EditorScene;
+	uint64_t frameNumber = 0; // game thread frame this packet was built in
+
+	XMMATRIX vpMatrix = XMMatrixIdentity();
+	XMMATRIX invPVMatrix = XMMatrixIdentity();
+
+	// false outside the editor scene and the running demo; the lighting pass is skipped as well then
+	bool hasScene = false;
+	std::vector<DrawItem> drawItems; // visible instances, the render thread sorts them through a RenderQueue
+	// every renderable instance, culled or not, in the instance list's order; only filled while the
+	// renderer caches bundles, whose cells must not depend on what the camera sees
+	std::vector<DrawItem> sceneItems;
+	LightSet lights;
+	// tiled lighting on the compute queue, decided with the packet so the game thread knows whether
+	// to bin the lights; it culls them per tile itself, so lightClusters and lightIndices stay empty then
+	bool isLightingAsync = false;
+	std::vector<LightCluster> lightClusters; // binned on the game thread, see LightClusterer
+	std::vector<uint32_t> lightIndices;
+
+	// Shadow cascades of the first directional light, lights.constants.NumOfShadowCascades of them; their
+	// casters index shadowCasters, which holds every renderable instance one of them draws, in batch order.
+	ShadowCascade shadowCascades[ShadowCascadeCount];
+	std::vector<DrawItem> shadowCasters;
+
+	std::wstring overlayText; // debug overlay of the demo window, empty in release builds
+	ImGuiDrawSnapshot imGuiDrawData; // editor UI, invalid in the demo window
+};
@@ -0,0 +1,94 @@
+#pragma once
+#include <d3d12.h>
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <cstddef>
+#include <vector>
+
+#include "BatchRecording.h"
+
+struct DrawItem;
+
+// The recording half of the G-buffer and lighting passes, without anything that needs a device
+// or a window, so a frame can be recorded into a NullCommandRecorder as well as into a list.
+// The renderer fills the bindings from its shader and the window's render resources; the draw
+// batches and the G-buffer targets are in BatchRecording.h.
+
+struct LightingPassBindings
+{
+	ID3D12PipelineState* pipelineState_p = nullptr;
+	ID3D12RootSignature* rootSignature_p = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS lightConstants = 0; // this frame's copy
+	D3D12_GPU_VIRTUAL_ADDRESS directionalLights = 0; // structured buffers, from the same upload
+	D3D12_GPU_VIRTUAL_ADDRESS pointLights = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS spotLights = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS lightClusters = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS lightIndices = 0;
+	D3D12_GPU_DESCRIPTOR_HANDLE gBufferTable = {};
+	D3D12_GPU_DESCRIPTOR_HANDLE depthTable = {};
+	D3D12_GPU_DESCRIPTOR_HANDLE shadowMapTable = {}; // the cascades of the G-buffer set's shadow maps
+	D3D12_VERTEX_BUFFER_VIEW quadVertexBufferView = {};
+};
+
+// the same lighting as LightingPassBindings, as a compute dispatch writing into an UAV;
+// point and spot lights are culled per tile on the GPU, so the clusters are not read
+struct TiledLightingBindings
+{
+	ID3D12PipelineState* pipelineState_p = nullptr;
+	ID3D12RootSignature* rootSignature_p = nullptr;
+	ID3D12DescriptorHeap* srvHeap_p = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS lightConstants = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS directionalLights = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS pointLights = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS spotLights = 0;
+	D3D12_GPU_DESCRIPTOR_HANDLE gBufferTable = {};
+	D3D12_GPU_DESCRIPTOR_HANDLE depthTable = {};
+	D3D12_GPU_DESCRIPTOR_HANDLE shadowMapTable = {};
+	D3D12_GPU_DESCRIPTOR_HANDLE outputTable = {}; // UAV of the lit image
+	UINT width = 0; // of the G-buffer and the output
+	UINT height = 0;
+};
+
+// one cascade of a shadow map, drawn with the first pass's root signature and the depth prepass's shaders
+struct ShadowPassBindings
+{
+	ID3D12PipelineState* pipelineState_p = nullptr;
+	ID3D12RootSignature* rootSignature_p = nullptr;
+	D3D12_VIEWPORT viewport = {};
+	D3D12_RECT scissorRect = {};
+	D3D12_CPU_DESCRIPTOR_HANDLE depthStencil = {}; // the cascade's slice
+	D3D12_GPU_VIRTUAL_ADDRESS instanceData = 0; // the casters' transforms, in the order of the batches' items
+};
+
+// pixels per side of a tile, one thread group each; must match TILE_SIZE in TiledLightingComputeShader.hlsl
+static const UINT TiledLightingTileSize = 16;
+
+// pipeline state, root signature, the per-list view-projection constants and the instance buffer;
+// bundles executed on the list afterwards inherit them
+void SetGBufferPassState(CommandRecorder& p_recorder, const GBufferPassBindings& p_bindings, const XMMATRIX& p_vpMatrix);
+
+// one batch per run of items that share mesh and texture; firstInstance is the item's index,
+// so the instance buffer holds the items' constants in item order
+void BuildDrawBatches(const std::vector<DrawItem>& p_drawItems, std::vector<DrawBatch>& out_batches);
+
+// SetGBufferPassState, then batches [p_firstBatch, p_endBatch); the targets must be bound already
+void RecordGBufferDraws(CommandRecorder& p_recorder, const GBufferPassBindings& p_bindings, const XMMATRIX& p_vpMatrix,
+	const std::vector<DrawBatch>& p_drawBatches, size_t p_firstBatch, size_t p_endBatch);
+
+// Batches [p_firstBatch, p_endBatch) again, positions only and into the depth buffer alone, on a list
+// BindGBufferTargets was recorded on. The G-buffer targets are bound again afterwards, so the G-buffer
+// draws can follow on the same list; they need the depth of every batch, so record all of them first.
+void RecordDepthPrepass(CommandRecorder& p_recorder, const GBufferPassBindings& p_bindings, const XMMATRIX& p_vpMatrix,
+	const std::vector<DrawBatch>& p_drawBatches, size_t p_firstBatch, size_t p_endBatch);
+
+// Clears the cascade and draws the batches into it, positions only, on a list with no targets bound
+// or whose targets are bound again afterwards.
+void RecordShadowCascade(CommandRecorder& p_recorder, const ShadowPassBindings& p_bindings, const XMMATRIX& p_viewProjection,
+	const std::vector<DrawBatch>& p_drawBatches);
+
+// the fullscreen quad, into whatever render target is bound
+void RecordLightingPass(CommandRecorder& p_recorder, const LightingPassBindings& p_bindings, const XMMATRIX& p_invScreenPVMatrix);
+
+// one thread group per tile of the output, on a direct or compute list
+void RecordTiledLightingPass(CommandRecorder& p_recorder, const TiledLightingBindings& p_bindings, const XMMATRIX& p_invScreenPVMatrix);
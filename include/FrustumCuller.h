@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class WorkerPool;
+
+// axis-aligned box as center and half size, in the space of whoever owns it
+struct BoundingAabb
+{
+	float center[3] = { 0.0f, 0.0f, 0.0f };
+	float extents[3] = { 0.0f, 0.0f, 0.0f };
+};
+
+// a x + b y + c z + d >= 0 inside, not normalized
+struct FrustumPlanes
+{
+	float planes[6][4] = {};
+};
+
+// per frame, shown in the frame pacing panel
+struct FrustumCullStats
+{
+	unsigned int tested = 0;
+	unsigned int visible = 0;
+	unsigned int tasks = 0; // the test was split into this many worker pool tasks
+	bool isAvx2 = false; // 8 boxes per iteration, otherwise one
+	double cullMilliseconds = 0.0;
+};
+
+// Tests world space boxes against the view frustum. The boxes are kept as structure of arrays,
+// one array per center and extent component, so the AVX2 path loads 8 boxes per component with
+// one instruction and tests them against a plane at once. A box is culled when it is entirely
+// outside one of the six planes; boxes that straddle a corner of the frustum are kept.
+class FrustumCuller
+{
+public:
+	// p_viewProjection_p is a row-major 4x4 matrix for row vectors, i.e. clip = position * M,
+	// with D3D clip depth 0 to w
+	static FrustumPlanes ExtractPlanes(const float* p_viewProjection_p);
+
+	// keeps the first min(old, new) boxes
+	void Resize(size_t p_count);
+	size_t GetCount() const { return m_count; }
+
+	void SetBounds(size_t p_index, const BoundingAabb& p_bounds);
+
+	// Tests every box, split across p_workerPool_p once there are enough of them; a null pool
+	// tests on the calling thread. The result stays valid until the next Resize or Cull.
+	void Cull(const FrustumPlanes& p_planes, WorkerPool* p_workerPool_p);
+
+	bool IsVisible(size_t p_index) const
+	{
+		return (m_visibleBits[p_index >> 3] >> (p_index & 7)) & 1;
+	}
+
+	FrustumCullStats GetStats() const { return m_stats; }
+
+	// checked once, the scalar path runs everywhere
+	static bool IsAvx2Supported();
+
+	// off runs the scalar path even where AVX2 is supported, to compare the two
+	void SetAvx2Enabled(bool p_isEnabled) { m_isAvx2Enabled = p_isEnabled; }
+
+	// below this many boxes per task the test runs on fewer threads; a multiple of 512,
+	// so no two tasks write the same cache line of m_visibleBits
+	static const size_t MinBoundsPerCullTask = 16384;
+
+private:
+	size_t m_count = 0;
+	bool m_isAvx2Enabled = true;
+
+	std::vector<float> m_centerX;
+	std::vector<float> m_centerY;
+	std::vector<float> m_centerZ;
+	std::vector<float> m_extentX;
+	std::vector<float> m_extentY;
+	std::vector<float> m_extentZ;
+
+	std::vector<uint8_t> m_visibleBits; // bit i & 7 of byte i >> 3 is box i
+	std::vector<unsigned int> m_taskVisible; // visible boxes counted per task
+
+	FrustumCullStats m_stats;
+
+	// boxes [p_first, p_end), p_first a multiple of 8; returns how many are visible
+	unsigned int _cullScalar(const FrustumPlanes& p_planes, size_t p_first, size_t p_end);
+	unsigned int _cullAvx2(const FrustumPlanes& p_planes, size_t p_first, size_t p_end);
+};
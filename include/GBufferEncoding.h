@@ -0,0 +1,96 @@
+// G-buffer encoding, shared by the shaders and the CPU.
+// The G-buffer is two targets, 8 bytes per pixel before depth:
+//   0: R8G8B8A8_UNORM_SRGB, albedo in rgb and specular in a
+//   1: R16G16_UNORM, the world space normal, octahedral encoded
+// The functions below only use what C++ and HLSL have in common: per component arithmetic,
+// constructors and the small helpers the C++ half defines, so the same text compiles as both.
+// NOTE: included by FirstPassPixelShader.hlsl and SecondPassPixelShader.hlsl
+#ifndef GBUFFER_ENCODING_H
+#define GBUFFER_ENCODING_H
+
+#if defined(__cplusplus)
+#include <cmath>
+#include <cstdint>
+
+namespace GBufferEncoding
+{
+	// the targets above, bound together by the first pass
+	static const unsigned int TargetCount = 2;
+
+	struct float2
+	{
+		float x, y;
+		float2() : x(0.0f), y(0.0f) {}
+		float2(float p_x, float p_y) : x(p_x), y(p_y) {}
+	};
+
+	struct float3
+	{
+		float x, y, z;
+		float3() : x(0.0f), y(0.0f), z(0.0f) {}
+		float3(float p_x, float p_y, float p_z) : x(p_x), y(p_y), z(p_z) {}
+	};
+
+	inline float abs(float p_value) { return std::fabs(p_value); }
+	inline float sqrt(float p_value) { return std::sqrt(p_value); }
+	inline float saturate(float p_value) { return p_value < 0.0f ? 0.0f : (p_value > 1.0f ? 1.0f : p_value); }
+
+	// what an UNORM target of p_bits keeps of p_value in [0, 1]
+	inline float QuantizeUnorm(float p_value, unsigned int p_bits)
+	{
+		const float maximum = static_cast<float>((1u << p_bits) - 1);
+		return std::floor(saturate(p_value) * maximum + 0.5f) / maximum;
+	}
+
+#define GBUFFER_FUNCTION inline
+#else
+#define GBUFFER_FUNCTION
+#endif
+
+	// -1 for negative values, 1 otherwise; sign() is 0 at 0, which would fold the wrong way
+	GBUFFER_FUNCTION float SignNotZero(float p_value)
+	{
+		return p_value >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	// Unit vector to [0, 1]^2: projected onto the octahedron |x| + |y| + |z| = 1, whose lower half
+	// is folded over the upper one. At 16 bits per component the round trip is off by 0.004 degrees at most.
+	GBUFFER_FUNCTION float2 EncodeNormal(float3 p_normal)
+	{
+		float inverseLength = 1.0f / (abs(p_normal.x) + abs(p_normal.y) + abs(p_normal.z));
+		float x = p_normal.x * inverseLength;
+		float y = p_normal.y * inverseLength;
+		if (p_normal.z < 0.0f)
+		{
+			float foldedX = (1.0f - abs(y)) * SignNotZero(x);
+			float foldedY = (1.0f - abs(x)) * SignNotZero(y);
+			x = foldedX;
+			y = foldedY;
+		}
+		return float2(x * 0.5f + 0.5f, y * 0.5f + 0.5f);
+	}
+
+	// the inverse of EncodeNormal, normalized
+	GBUFFER_FUNCTION float3 DecodeNormal(float2 p_encoded)
+	{
+		float x = p_encoded.x * 2.0f - 1.0f;
+		float y = p_encoded.y * 2.0f - 1.0f;
+		float z = 1.0f - abs(x) - abs(y);
+		if (z < 0.0f)
+		{
+			float unfoldedX = (1.0f - abs(y)) * SignNotZero(x);
+			float unfoldedY = (1.0f - abs(x)) * SignNotZero(y);
+			x = unfoldedX;
+			y = unfoldedY;
+		}
+		float inverseLength = 1.0f / sqrt(x * x + y * y + z * z);
+		return float3(x * inverseLength, y * inverseLength, z * inverseLength);
+	}
+
+#if defined(__cplusplus)
+} // namespace GBufferEncoding
+#endif
+
+#undef GBUFFER_FUNCTION
+
+#endif // GBUFFER_ENCODING_H
@@ -0,0 +1,60 @@
+#pragma once
+#include <d3d12.h>
+
+#include <wrl.h>
+using namespace Microsoft::WRL;
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+struct GBufferPoolStats
+{
+	uint32_t targets = 0; // textures the pool holds
+	uint32_t references = 0; // acquisitions of them
+	uint64_t allocatedBytes = 0;
+	uint64_t requestedBytes = 0; // what the acquisitions would take, had each its own texture
+};
+
+// Full screen targets shared by key: size, format, flags and set.
+// Every back buffer of a window, and every window of the same size, gets the same textures. A set is
+// what one frame renders into; the next frame takes the other one, so it can fill its G-buffer while
+// the compute queue still lights the previous frame, see BearWindow::GBufferSetCount.
+// Targets are created in the state the caller keeps them in between frames.
+// A target is freed with its last reference; the caller makes sure the GPU is done with it.
+class GBufferPool
+{
+public:
+	static GBufferPool& Get();
+
+	// p_clearValue_p is the optimized clear value, nullptr for none; it is not part of the key
+	ComPtr<ID3D12Resource> Acquire(UINT p_width, UINT p_height, DXGI_FORMAT p_format, D3D12_RESOURCE_FLAGS p_flags,
+		UINT p_set, D3D12_RESOURCE_STATES p_initialState, const D3D12_CLEAR_VALUE* p_clearValue_p);
+	void Release(ID3D12Resource* p_resource);
+
+	GBufferPoolStats GetStats();
+
+private:
+	GBufferPool() = default;
+	GBufferPool(const GBufferPool&) = delete;
+	GBufferPool& operator=(const GBufferPool&) = delete;
+
+	struct Target
+	{
+		UINT width;
+		UINT height;
+		DXGI_FORMAT format;
+		D3D12_RESOURCE_FLAGS flags;
+		UINT set;
+		ComPtr<ID3D12Resource> resource;
+		uint64_t bytes;
+		uint32_t references;
+	};
+
+	// reports requested minus allocated bytes to the memory tracker
+	void _updateSavedBytes();
+
+	std::vector<Target> m_targets; // a handful, a linear search is enough
+	GBufferPoolStats m_stats;
+	std::mutex m_mutex;
+};
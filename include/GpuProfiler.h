@@ -0,0 +1,110 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+// the passes of a frame that get their own pair of timestamps
+enum GpuPass : uint8_t
+{
+	GPU_PASS_SHADOW_MAPS = 0, // only the cascades that were not kept from an earlier frame
+	GPU_PASS_DEPTH_PREPASS = 1, // only while it is enabled
+	GPU_PASS_GBUFFER = 2,
+	GPU_PASS_LIGHTING = 3,
+	GPU_PASS_IMGUI = 4, // editor window only
+	GPU_PASS_OVERLAY = 5, // D2D overlay of the demo window
+	GPU_PASS_COUNT = 6
+};
+
+const char* GetGpuPassName(GpuPass p_pass);
+
+// ID3D12GraphicsCommandList* for the D3D12 backend; opaque here so the bookkeeping builds without D3D12
+using GpuCommandListHandle = void*;
+
+// The GPU side of the profiler: a set of timestamp queries and a readback slot for each.
+class GpuTimestampBackend
+{
+public:
+	virtual ~GpuTimestampBackend() = default;
+
+	// called once, before anything else; queries and readback slots are indexed [0, p_queryCount)
+	virtual void Initialize(uint32_t p_queryCount) = 0;
+
+	virtual void WriteTimestamp(GpuCommandListHandle p_commandList, uint32_t p_query) = 0;
+
+	// copies the queries into the readback slots of the same index when the list executes
+	virtual void Resolve(GpuCommandListHandle p_commandList, uint32_t p_firstQuery, uint32_t p_queryCount) = 0;
+
+	// reads resolved slots; only called once the list that resolved them has finished on the GPU
+	virtual void ReadResolved(uint32_t p_firstQuery, uint32_t p_queryCount, uint64_t* out_ticks) = 0;
+
+	// timestamp ticks per second
+	virtual uint64_t GetFrequency() const = 0;
+};
+
+// averaged over the last AveragingFrames frames that had results
+struct GpuPassStats
+{
+	double gpuMilliseconds[GPU_PASS_COUNT] = { 0.0 };
+	double cpuMilliseconds[GPU_PASS_COUNT] = { 0.0 }; // time to record the same pass
+	unsigned int latencyFrames = 0; // how many frames later the results are read
+	uint64_t collectedFrames = 0; // since start
+	uint64_t droppedFrames = 0; // a slot was needed again before its frame finished on the GPU
+};
+
+// Times the passes of a frame with GPU timestamps. Every frame writes its queries into one slot
+// of a ring of p_latencyFrames slots and resolves them at its end; a slot is read back when the
+// frame that wrote it is known to be complete, so reading never stalls on the GPU.
+// The profiler itself only does the bookkeeping, the backend talks to the GPU.
+class GpuProfiler
+{
+public:
+	GpuProfiler(std::unique_ptr<GpuTimestampBackend> p_backend, unsigned int p_latencyFrames);
+
+	// p_completedFrames: every frame numbered below it has finished on the GPU
+	void BeginFrame(uint64_t p_frameNumber, uint64_t p_completedFrames);
+
+	// A pass may only be timed once per frame; the two calls may be on different lists
+	// of the same queue, as long as they are submitted in order.
+	void BeginPass(GpuCommandListHandle p_commandList, GpuPass p_pass);
+	void EndPass(GpuCommandListHandle p_commandList, GpuPass p_pass);
+
+	// resolves every pass timed in this frame; on the last list of the frame
+	void EndFrame(GpuCommandListHandle p_commandList);
+
+	// may be called from another thread than the one rendering
+	GpuPassStats GetStats() const;
+
+	static const unsigned int AveragingFrames = 60;
+	static const uint32_t QueriesPerFrame = GPU_PASS_COUNT * 2;
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct FrameSlot
+	{
+		uint64_t frameNumber = 0;
+		bool isPending = false; // resolved, not read back yet
+		uint8_t timedPasses = 0; // bit per GpuPass, both timestamps written
+		uint8_t openPasses = 0; // BeginPass without EndPass yet
+		double cpuMilliseconds[GPU_PASS_COUNT] = { 0.0 };
+		Clock::time_point cpuPassStart[GPU_PASS_COUNT];
+	};
+
+	std::unique_ptr<GpuTimestampBackend> m_backend;
+	std::unique_ptr<FrameSlot[]> m_slots;
+	unsigned int m_latencyFrames;
+	FrameSlot* m_currentSlot_p = nullptr;
+	uint32_t m_currentSlotIndex = 0;
+
+	// accumulated until AveragingFrames frames were collected
+	double m_gpuMillisecondsSum[GPU_PASS_COUNT] = { 0.0 };
+	double m_cpuMillisecondsSum[GPU_PASS_COUNT] = { 0.0 };
+	unsigned int m_passFrameCount[GPU_PASS_COUNT] = { 0 };
+	unsigned int m_accumulatedFrames = 0;
+
+	mutable std::mutex m_statsMutex;
+	GpuPassStats m_stats;
+
+	void _collect(FrameSlot& p_slot, uint32_t p_slotIndex);
+};
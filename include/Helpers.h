@@ -30,6 +30,7 @@
 
 #pragma once
 
+#if defined(_WIN32)
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h> // For HRESULT
 
@@ -38,11 +39,25 @@
 
 #include <d3d11.h>
 #include <d2d1_3.h>
+#else
+// Headless builds (see NullCommandRecorder): D3D12 types from include/directx through the
+// include/wsl adapter, with include/wsl/stubs on the include path. No D3D11 or D2D there,
+// RenderResource only keeps pointers to them.
+#include <wsl/winadapter.h>
+#include <directx/d3d12.h>
+#include <wrl/client.h>
+
+struct ID3D11Resource;
+struct ID2D1Bitmap1;
+#endif
 
 #include <DirectXMath.h>
 using namespace DirectX;
 
 #include <exception>
+#include <vector>
+
+#include "ShadowCascades.h"
 
 // From DXSampleHelper.h
 // Source: https://github.com/Microsoft/DirectX-Graphics-Samples
@@ -59,7 +74,6 @@ inline void ThrowIfFailed(HRESULT hr)
 #define WSTR1(x) L##x
 #define WSTR(x) WSTR1(x)
 #define NAME_D3D12_OBJECT(x) x->SetName( WSTR(__FILE__ "(" STR(__LINE__) "): " L#x) )
-#define MAX_LIGHTS 16
 
 static UINT CalcConstantBufferByteSize(UINT byteSize)
 {
@@ -87,19 +101,36 @@ struct FirstPassVertexData
 	XMFLOAT2 TexCoord;
 };
 
+// The first pass reads the vertices of FirstPassVertexData as two streams: the positions alone in slot 0,
+// all the depth prepass fetches, and the rest in slot 1. Mesh splits them when it uploads.
+// NOTE: must match firstPassInputLayout in Shader.cpp
+struct FirstPassVertexAttributes
+{
+	XMFLOAT3 Normal;
+	XMFLOAT3 Tangent;
+	XMFLOAT2 TexCoord;
+};
+
 struct SecondPassVertexData
 {
 	XMFLOAT3 Position;
 	XMFLOAT2 TexCoord;
 };
 
-// input structure for first pass vertex shader
+// input structure for first pass vertex shader, one element per instance in the per-frame instance buffer
+// NOTE: must match InstanceTransforms in FirstPassVertexShader.hlsl
 struct VertexShaderInput
 {
-	XMMATRIX mvpMatrix;
+	XMMATRIX modelMatrix;
 	XMMATRIX tiModel;
 };
 
+// first pass, set once per command list and shared by all instances
+struct FirstPassRootConstants
+{
+	XMMATRIX vpMatrix;
+};
+
 struct SecondPassRootConstants
 {
 	XMMATRIX invScreenPVMatrix;
@@ -147,6 +178,9 @@ struct SpotLight
 	float Padding[2] = { 0.0f, 0.0f };
 };
 
+// Lighting pass constant buffer, and the head of a MSG_TYPE_MODIFY_LIGHT message with the lights
+// after it. The lights themselves are in structured buffers, so there is no cap on their number.
+// NOTE: must match the structure defined in SecondPassPixelShader.hlsl
 struct LightConstants
 {
 	XMFLOAT4 CameraPosition = XMFLOAT4(0.0f, 0.0f, -10.0f, 0.0f);
@@ -156,9 +190,31 @@ struct LightConstants
 	uint32_t NumOfPointLights = 0;
 	uint32_t NumOfSpotLights = 0;
 
-	DirectionalLight DirectionalLights[MAX_LIGHTS];
-	PointLight PointLights[MAX_LIGHTS];
-	SpotLight SpotLights[MAX_LIGHTS];
+	// clustered lighting, set per frame from the camera, see LightClusterer
+	XMMATRIX ViewMatrix = XMMatrixIdentity();
+	uint32_t ClusterCountX = 1;
+	uint32_t ClusterCountY = 1;
+	uint32_t ClusterCountZ = 1;
+	float DepthSliceScale = 0.0f;
+	float DepthSliceBias = 0.0f;
+	float Padding[3] = { 0.0f, 0.0f, 0.0f };
+
+	// cascaded shadow maps of the first directional light, set per frame, see ShadowCascades;
+	// NumOfShadowCascades is 0 without one, and nothing is shadowed then
+	XMMATRIX ShadowViewProjection[ShadowCascadeCount] = { XMMatrixIdentity(), XMMatrixIdentity(), XMMatrixIdentity(), XMMatrixIdentity() };
+	XMFLOAT4 ShadowSplitDepths = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f); // view depth each cascade reaches to
+	XMFLOAT4 ShadowTexelSizes = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f); // world units per texel of each cascade's map
+	uint32_t NumOfShadowCascades = 0;
+	float ShadowPadding[3] = { 0.0f, 0.0f, 0.0f };
+};
+
+// every light of the scene; the counts in constants are set when the lights are uploaded
+struct LightSet
+{
+	LightConstants constants;
+	std::vector<DirectionalLight> directionalLights;
+	std::vector<PointLight> pointLights; // clustered together with the spot lights, points first
+	std::vector<SpotLight> spotLights;
 };
 
 const static DirectionalLight defaultDL;
@@ -177,10 +233,13 @@ struct RenderResource
 	D3D12_CPU_DESCRIPTOR_HANDLE dsv;
 	D3D12_GPU_DESCRIPTOR_HANDLE secondPassSRV;
 	D3D12_GPU_DESCRIPTOR_HANDLE depthBufferSRV;
+	D3D12_GPU_DESCRIPTOR_HANDLE lightingOutputUAV; // lit image of the tiled lighting pass
 	Microsoft::WRL::ComPtr<ID3D12Resource>* resourceArray;
+	unsigned int gBufferSet = 0; // which of the window's G-buffer sets the fields above point at
 	unsigned int firstPassResourceStartIndex;
 	unsigned int backBufferResourceIndex;
 	unsigned int depthBufferResourceIndex;
+	unsigned int lightingOutputResourceIndex;
 	D3D12_VIEWPORT viewport;
 	ID3D11Resource* d3d11wrappedBackBuffer;
 	ID2D1Bitmap1* d2dRenderTarget;
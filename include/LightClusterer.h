@@ -0,0 +1,100 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class WorkerPool;
+
+// where a light reaches, in world space
+struct LightSphere
+{
+	float center[3] = { 0.0f, 0.0f, 0.0f };
+	float radius = 0.0f;
+};
+
+// NOTE: must match LightCluster in SecondPassPixelShader.hlsl
+struct LightCluster
+{
+	uint32_t offset = 0; // into the light index list
+	uint32_t count = 0;
+};
+
+// per frame, shown in the frame pacing panel
+struct LightClusterStats
+{
+	unsigned int lights = 0;
+	unsigned int lightsInFrustum = 0;
+	unsigned int indices = 0; // light and cluster pairs
+	unsigned int maxPerCluster = 0;
+	unsigned int tasks = 0;
+	double binMilliseconds = 0.0;
+};
+
+// Bins lights into clusters of the view frustum, so the lighting pass only evaluates the lights
+// that can reach a pixel. The frustum is split into ClustersX by ClustersY screen tiles and
+// ClustersZ slices whose depth grows exponentially from the near to the far plane.
+// Every light is a sphere; it is added to a cluster when the sphere touches the cluster's view
+// space box. Slices are binned in parallel, each by one task, and every cluster lists its lights
+// in increasing index order, so the result does not depend on the thread count.
+class LightClusterer
+{
+public:
+	static const unsigned int ClustersX = 16;
+	static const unsigned int ClustersY = 9;
+	static const unsigned int ClustersZ = 24;
+	static const unsigned int ClusterCount = ClustersX * ClustersY * ClustersZ;
+
+	// p_view_p is a row-major 4x4 world to view matrix for row vectors, view space looks down +z;
+	// the tangents are of half the horizontal and vertical field of view
+	void SetFrustum(const float* p_view_p, float p_tanHalfFovX, float p_tanHalfFovY, float p_nearZ, float p_farZ);
+
+	void Resize(size_t p_count);
+	void SetLight(size_t p_index, const LightSphere& p_light);
+
+	// a null pool bins on the calling thread
+	void Bin(WorkerPool* p_workerPool_p);
+
+	// by cluster, x fastest, then y from the top of the screen, then slice from the near plane
+	const std::vector<LightCluster>& GetClusters() const { return m_clusters; }
+	const std::vector<uint32_t>& GetLightIndices() const { return m_lightIndices; }
+
+	// the slice of view depth z is floor(log(z) * scale + bias)
+	float GetDepthSliceScale() const { return m_depthSliceScale; }
+	float GetDepthSliceBias() const { return m_depthSliceBias; }
+
+	LightClusterStats GetStats() const { return m_stats; }
+
+	// below this many lights per task the view space pass runs on fewer threads
+	static const size_t MinLightsPerTask = 1024;
+
+private:
+	// a light in view space, with the slices it may touch
+	struct ViewLight
+	{
+		float center[3];
+		float radius;
+		int32_t firstSlice; // empty if endSlice <= firstSlice, outside the frustum
+		int32_t endSlice;
+	};
+
+	float m_view[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+	float m_tanHalfFovX = 1.0f;
+	float m_tanHalfFovY = 1.0f;
+	float m_nearZ = 0.1f;
+	float m_farZ = 1000.0f;
+	float m_depthSliceScale = 0.0f;
+	float m_depthSliceBias = 0.0f;
+	float m_sliceDepths[ClustersZ + 1] = {};
+
+	std::vector<LightSphere> m_lights;
+	std::vector<ViewLight> m_viewLights;
+	std::vector<std::vector<uint32_t>> m_clusterLights = std::vector<std::vector<uint32_t>>(ClusterCount);
+
+	std::vector<LightCluster> m_clusters = std::vector<LightCluster>(ClusterCount);
+	std::vector<uint32_t> m_lightIndices;
+
+	LightClusterStats m_stats;
+
+	void _toViewSpace(size_t p_first, size_t p_end);
+	void _binSlice(unsigned int p_slice);
+};
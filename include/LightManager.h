@@ -5,6 +5,22 @@
 #include <DirectXMath.h>
 using namespace DirectX;
 
+#include <mutex>
+#include <vector>
+
+#include "LightClusterer.h"
+
+// where the lighting pass finds this frame's lights
+struct LightBufferAddresses
+{
+	D3D12_GPU_VIRTUAL_ADDRESS constants = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS directionalLights = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS pointLights = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS spotLights = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS clusters = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS lightIndices = 0;
+};
+
 class LightManager
 {
 public:
@@ -12,25 +28,36 @@ public:
 
 	~LightManager();
 
-	LightConstants& GetLightConstants();
+	// only updates the CPU copy, it reaches the GPU with the next UploadForFrame
+	void CopyData(const LightSet& p_lights);
 
-	void CopyData(LightConstants* p_lightConstant_p);
+	void UpdateCameraPosition(XMFLOAT4& p_cameraPosition);
 
-	void UpdateCameraPosition(XMFLOAT4& p_cameraPosition)
-	{
-		reinterpret_cast<LightConstants*>(m_mappedData)->CameraPosition = p_cameraPosition;
-	}
+	// Copies the lights and their clusters into the upload buffer owned by p_frameSlot, growing it
+	// if needed, and returns where they are. The GPU may still read the buffers of other frames
+	// in flight, so they are left alone.
+	LightBufferAddresses UploadForFrame(UINT p_frameSlot, const LightSet& p_lights,
+		const std::vector<LightCluster>& p_clusters, const std::vector<uint32_t>& p_lightIndices);
 
-	D3D12_GPU_VIRTUAL_ADDRESS GetLightCBVGPUAddress()
-	{
-		return m_uploadBuffer->GetGPUVirtualAddress();
-	}
+	// a consistent copy of the current lights
+	void CopyLights(LightSet& out_lights);
 
-private:
-	LightConstants m_lightConstants;
+	// MSG_TYPE_MODIFY_LIGHT content: the constants, then the directional, point and spot lights
+	static void SerializeLights(const LightSet& p_lights, std::vector<unsigned char>& out_data);
+	static bool DeserializeLights(const unsigned char* p_data_p, size_t p_size, LightSet& out_lights);
 
-	Microsoft::WRL::ComPtr<ID3D12Resource> m_uploadBuffer;
-	unsigned char* m_mappedData = nullptr;
+private:
+	LightSet m_lights;
+	std::mutex m_lightsMutex; // written by the MeshManager listener thread
 
-	UINT m_lightCBSize = 0;
-};
\ No newline at end of file
+	// one per frame in flight, mapped for their lifetime
+	struct FrameBuffer
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> uploadBuffer;
+		unsigned char* mappedData = nullptr;
+		size_t capacity = 0;
+	};
+	FrameBuffer m_frameBuffers[D3D12Renderer::MaxFramesInFlight];
+
+	void _reserve(FrameBuffer& p_frameBuffer, size_t p_size);
+};
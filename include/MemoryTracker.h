@@ -0,0 +1,142 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+#include <d3d12.h>
+#include <dxgi1_6.h>
+
+#include <wrl.h>
+using namespace Microsoft::WRL;
+
+#include "HighResolutionClock.h"
+
+// CPU byte counters, one per subsystem
+enum MemoryTag : uint8_t
+{
+	MEMORY_TAG_MESH = 0, // CPU-side geometry held by Mesh
+	MEMORY_TAG_TEXTURE = 1, // working set of the texture cooker
+	MEMORY_TAG_MESSAGE = 2, // payloads of messages not yet released
+	MEMORY_TAG_UI = 3, // everything ImGui allocates
+	MEMORY_TAG_JOLT = 4, // everything Jolt allocates through its hooks
+	MEMORY_TAG_COUNT = 5
+};
+
+// GPU byte counters, per kind of resource
+enum GpuMemoryCategory : uint8_t
+{
+	GPU_MEMORY_MESH = 0, // vertex and index buffers
+	GPU_MEMORY_TEXTURE = 1,
+	GPU_MEMORY_RENDER_TARGET = 2, // G-buffers, depth buffers, shadow maps and back buffers
+	GPU_MEMORY_CONSTANT = 3, // upload buffers for constants
+	GPU_MEMORY_COUNT = 4
+};
+
+struct MemoryStats
+{
+	uint64_t cpuBytes[MEMORY_TAG_COUNT] = { 0 };
+	uint64_t cpuPeakBytes[MEMORY_TAG_COUNT] = { 0 };
+	uint64_t cpuAllocations[MEMORY_TAG_COUNT] = { 0 }; // live allocations
+	uint64_t gpuBytes[GPU_MEMORY_COUNT] = { 0 };
+	uint64_t gpuResources[GPU_MEMORY_COUNT] = { 0 };
+	uint64_t gpuSharedBytes[GPU_MEMORY_COUNT] = { 0 }; // saved by sharing resources, on top of gpuBytes
+	uint64_t systemAvailableBytes = 0;
+	uint64_t systemTotalBytes = 0;
+	uint64_t processWorkingSetBytes = 0;
+	uint64_t processPrivateBytes = 0;
+	uint64_t videoMemoryUsageBytes = 0; // whole process, local segment, as reported by DXGI
+	uint64_t videoMemoryBudgetBytes = 0;
+	double sampleTimeInSeconds = 0.0;
+};
+
+// Keeps tagged byte counters for the subsystems and samples them periodically.
+// Counters are updated from any thread; the sampled stats are what the UI reads.
+class MemoryTracker
+{
+public:
+	static MemoryTracker& Get();
+
+	// the device answers allocation info queries, the adapter reports the video memory budget
+	void Initialize(ComPtr<ID3D12Device2> p_device, ComPtr<IDXGIAdapter4> p_adapter);
+
+	void AddCpuBytes(MemoryTag p_tag, size_t p_bytes);
+	void RemoveCpuBytes(MemoryTag p_tag, size_t p_bytes);
+
+	// allocations that remember their own size, for hooks whose free carries no size
+	static void* TaggedAllocate(MemoryTag p_tag, size_t p_size, size_t p_alignment = 16);
+	static void* TaggedReallocate(MemoryTag p_tag, void* p_block, size_t p_newSize);
+	static void TaggedFree(MemoryTag p_tag, void* p_block);
+
+	// replaces JPH::RegisterDefaultAllocator, must run before any Jolt allocation
+	static void RegisterJoltAllocator();
+
+	// size comes from GetResourceAllocationInfo; tracking a resource again replaces its entry
+	void TrackResource(GpuMemoryCategory p_category, ID3D12Resource* p_resource);
+	void UntrackResource(ID3D12Resource* p_resource);
+	// what the owners of shared resources would have allocated on top, reported by the pools
+	void SetGpuSharedBytes(GpuMemoryCategory p_category, uint64_t p_bytes);
+
+	// call once per frame; samples every m_sampleIntervalInSeconds and sends MSG_TYPE_CPU_MEMORY_INFO
+	void Update();
+	void Sample();
+
+	MemoryStats GetStats();
+
+	// writes the last sample, for comparing builds offline
+	bool DumpJSON(const char* p_filePath);
+
+	static const char* GetTagName(MemoryTag p_tag);
+	static const char* GetCategoryName(GpuMemoryCategory p_category);
+
+private:
+	MemoryTracker() = default;
+	MemoryTracker(const MemoryTracker&) = delete;
+	MemoryTracker& operator=(const MemoryTracker&) = delete;
+
+	struct TrackedResource
+	{
+		GpuMemoryCategory category;
+		uint64_t bytes;
+	};
+
+	ComPtr<ID3D12Device2> m_device;
+	ComPtr<IDXGIAdapter4> m_adapter;
+
+	std::atomic<int64_t> m_cpuBytes[MEMORY_TAG_COUNT] = {};
+	std::atomic<int64_t> m_cpuPeakBytes[MEMORY_TAG_COUNT] = {};
+	std::atomic<int64_t> m_cpuAllocations[MEMORY_TAG_COUNT] = {};
+
+	std::unordered_map<ID3D12Resource*, TrackedResource> m_gpuResources;
+	uint64_t m_gpuBytes[GPU_MEMORY_COUNT] = { 0 };
+	uint64_t m_gpuResourceCount[GPU_MEMORY_COUNT] = { 0 };
+	uint64_t m_gpuSharedBytes[GPU_MEMORY_COUNT] = { 0 };
+	std::mutex m_gpuMutex;
+
+	MemoryStats m_lastStats;
+	std::mutex m_statsMutex;
+
+	HighResolutionClock m_sampleClock;
+	double m_sampleIntervalInSeconds = 1.0;
+	double m_lastSampleTime = -1.0;
+};
+
+// charges a tag for the lifetime of a scope, for short-lived working memory
+class ScopedMemoryCharge
+{
+public:
+	ScopedMemoryCharge(MemoryTag p_tag, size_t p_bytes)
+		: m_tag(p_tag), m_bytes(p_bytes)
+	{
+		MemoryTracker::Get().AddCpuBytes(m_tag, m_bytes);
+	}
+
+	~ScopedMemoryCharge()
+	{
+		MemoryTracker::Get().RemoveCpuBytes(m_tag, m_bytes);
+	}
+
+private:
+	MemoryTag m_tag;
+	size_t m_bytes;
+};
@@ -2,6 +2,8 @@
 #include <Shader.h>
 #include <vector>
 #include <Helpers.h>
+#include <FramePacket.h>
+#include <FrustumCuller.h>
 #include <map>
 #include <string>
 
@@ -12,6 +14,9 @@ using namespace DirectX;
 class Mesh
 {
 public:
+	Mesh();
+	~Mesh();
+
 	bool Initialize(const wchar_t* p_objFilePath);
 	void LoadOBJFile(const wchar_t* p_objFilePath);
 	void LoadDataToGPU();
@@ -20,8 +25,18 @@ public:
 	void SetMeshClassName(const std::string& meshClassName);
 	const std::string& GetMeshClassName();
 
-	// Render work
-	void RenderInstance(ComPtr<ID3D12GraphicsCommandList2> p_commandList);
+	// Render work: buffer views and index count of the draw
+	void FillDrawItem(DrawItem& out_item) const;
+
+	// around every vertex in model space, computed when the mesh is loaded
+	const BoundingAabb& GetLocalBounds() const { return m_localBounds; }
+
+	// Nearest triangle hit by p_origin + t * p_direction for t in [0, p_maxT], both in model space.
+	// False if none; the triangles are kept on the CPU for editor picking.
+	bool IntersectRay(const XMVECTOR& p_origin, const XMVECTOR& p_direction, float p_maxT, float& out_t) const;
+
+	// three model space corners per triangle, what occluders are rasterized from
+	const std::vector<XMFLOAT3>& GetCpuTriangles() const { return m_pickTriangles; }
 
 private:
 	std::string m_meshClassName;
@@ -37,9 +52,22 @@ private:
 
 	UINT m_triangleCount = 0;
 
-	// Vertex buffer for the mesh.
-	ComPtr<ID3D12Resource> m_vertexBuffer;
-	D3D12_VERTEX_BUFFER_VIEW m_vertexBufferView;
+	uint32_t m_meshId = 0; // unique per mesh, sorts draws of the same mesh together
+
+	BoundingAabb m_localBounds;
+	void _computeLocalBounds();
+
+	std::vector<XMFLOAT3> m_pickTriangles; // three corners per triangle, for picking and occlusion
+
+	// bytes reported to MemoryTracker, the vectors keep their capacity after clear()
+	size_t m_trackedCpuBytes = 0;
+	void _updateTrackedMemory();
+
+	// Vertex buffers for the mesh, see FirstPassVertexAttributes.
+	ComPtr<ID3D12Resource> m_positionBuffer;
+	D3D12_VERTEX_BUFFER_VIEW m_positionBufferView;
+	ComPtr<ID3D12Resource> m_attributeBuffer;
+	D3D12_VERTEX_BUFFER_VIEW m_attributeBufferView;
 	// Index buffer for the mesh.
 	ComPtr<ID3D12Resource> m_indexBuffer;
 	D3D12_INDEX_BUFFER_VIEW m_indexBufferView;
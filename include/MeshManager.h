@@ -66,14 +66,28 @@ public:
 		return static_cast<int>(m_instanceList.size());
 	}
 
-	D3D12_GPU_VIRTUAL_ADDRESS GetLightCBVGPUAddress()
+	// uploads the given lights and clusters for this frame slot and returns where they are
+	LightBufferAddresses UploadLights(UINT p_frameSlot, const LightSet& p_lights,
+		const std::vector<LightCluster>& p_clusters, const std::vector<uint32_t>& p_lightIndices)
 	{
 		if (m_lightManager_p == nullptr)
 		{
-			return 0;
+			return LightBufferAddresses();
 		}
 
-		return m_lightManager_p->GetLightCBVGPUAddress();
+		return m_lightManager_p->UploadForFrame(p_frameSlot, p_lights, p_clusters, p_lightIndices);
+	}
+
+	// false until the light manager exists, out_lights is left alone then
+	bool CopyLights(LightSet& out_lights)
+	{
+		if (m_lightManager_p == nullptr)
+		{
+			return false;
+		}
+
+		m_lightManager_p->CopyLights(out_lights);
+		return true;
 	}
 
 private:
@@ -3,6 +3,7 @@
 #include <mutex>
 #include <iostream>
 #include <Helpers.h>
+#include <MemoryTracker.h>
 
 #include <Jolt/Jolt.h>
 #include <Jolt/Physics/Body/BodyID.h>
@@ -26,7 +27,7 @@ enum MessageType : uint32_t
 	MSG_TYPE_TEXTURE_SUCCESS = 0xB, // reply from MeshManager to UIManager, content is texture file name
 	MSG_TYPE_TEXTURE_FAILED = 0xC, // reply from MeshManager to UIManager, content is texture file name
 	MSG_TYPE_REMOVE_INSTANCE = 0xD, // request to remove instance, content is instance pointer
-	MSG_TYPE_CPU_MEMORY_INFO = 0xE, // message to report CPU memory usage, content is values of available and total memory in bytes
+	MSG_TYPE_CPU_MEMORY_INFO = 0xE, // sent by MemoryTracker on every sample, content is values of available and total memory in bytes
 	MSG_TYPE_MODIFY_LIGHT = 0xF, // request to modify light parameters, content is light data
 	MSG_TYPE_REBUILD_SHADERS = 0x10 // request to rebuild all shaders, no content
 };
@@ -75,6 +76,10 @@ public:
 
 	size_t SetData(const void* inData, size_t inSize)
 	{
+		if (data)
+		{
+			MemoryTracker::Get().RemoveCpuBytes(MEMORY_TAG_MESSAGE, size);
+		}
 		delete[] data;
 		data = new unsigned char[inSize];
 		if (!data)
@@ -85,6 +90,7 @@ public:
 		}
 		std::memcpy(data, inData, inSize);
 		size = inSize;
+		MemoryTracker::Get().AddCpuBytes(MEMORY_TAG_MESSAGE, size);
 		return size;
 	}
 
@@ -98,6 +104,7 @@ public:
 		if (data)
 		{
 			delete[] data;
+			MemoryTracker::Get().RemoveCpuBytes(MEMORY_TAG_MESSAGE, size);
 		}
 		data = nullptr;
 		size = 0;
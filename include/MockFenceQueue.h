@@ -0,0 +1,135 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "FenceQueue.h"
+
+// Stands in for a command queue, for running AsyncComputeScheduler without a device.
+// Submissions and GPU waits are queued in order and only run when the caller steps the queue:
+// a submission completes and signals the next fence value, a wait holds everything behind it until
+// the other queue's fence has passed its value. Stepping the queues in different orders plays
+// the ways a GPU may interleave them; what completed, and when, is kept for checking afterwards.
+class MockFenceQueue : public FenceQueue
+{
+public:
+	// what completed, in order; p_tick comes from a clock the caller shares between the queues
+	struct Completion
+	{
+		std::string name;
+		uint64_t fenceValue;
+		uint64_t tick;
+	};
+
+	explicit MockFenceQueue(uint64_t* p_clock_p)
+		: m_clock_p(p_clock_p)
+	{
+	}
+
+	// like ExecuteCommandLists; returns the fence value the submission signals
+	uint64_t Submit(const std::string& p_name)
+	{
+		m_items.push_back({ p_name, ++m_submittedValue, nullptr, 0 });
+		return m_submittedValue;
+	}
+
+	void WaitForQueue(FenceQueue& p_queue, uint64_t p_fenceValue) override
+	{
+		m_items.push_back({ std::string(), 0, static_cast<MockFenceQueue*>(&p_queue), p_fenceValue });
+		m_gpuWaits++;
+	}
+
+	bool IsFenceComplete(uint64_t p_fenceValue) override { return m_completedValue >= p_fenceValue; }
+
+	// steps this queue and the connected ones until the value is reached; counts a deadlock if nothing can run
+	void WaitForFenceValue(uint64_t p_fenceValue) override
+	{
+		if (IsFenceComplete(p_fenceValue))
+		{
+			return;
+		}
+
+		m_cpuWaits++;
+		while (!IsFenceComplete(p_fenceValue))
+		{
+			bool hasStepped = Step();
+			for (MockFenceQueue* queue_p : m_connectedQueues)
+			{
+				hasStepped = queue_p->Step() || hasStepped;
+			}
+
+			if (!hasStepped)
+			{
+				m_deadlocks++; // a D3D12 queue would hang here
+				return;
+			}
+		}
+	}
+
+	// the queues a CPU wait on this one may run as well
+	void Connect(MockFenceQueue& p_queue) { m_connectedQueues.push_back(&p_queue); }
+
+	// Runs the next item if it can: a submission completes, a wait passes if the other queue is far enough.
+	// Returns false if the queue is empty or blocked.
+	bool Step()
+	{
+		if (m_items.empty())
+		{
+			return false;
+		}
+
+		Item& item = m_items.front();
+		if (item.waitQueue_p != nullptr)
+		{
+			if (!item.waitQueue_p->IsFenceComplete(item.waitValue))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			m_completedValue = item.fenceValue;
+			m_completions.push_back({ item.name, item.fenceValue, ++*m_clock_p });
+		}
+
+		m_items.pop_front();
+		return true;
+	}
+
+	void RunUntilBlocked()
+	{
+		while (Step())
+		{
+		}
+	}
+
+	bool IsIdle() const { return m_items.empty(); }
+	// the submission at the front is held by a wait
+	bool IsBlocked() const { return !m_items.empty() && m_items.front().waitQueue_p != nullptr; }
+
+	uint64_t GetCompletedValue() const { return m_completedValue; }
+	const std::vector<Completion>& GetCompletions() const { return m_completions; }
+	uint64_t GetGpuWaits() const { return m_gpuWaits; }
+	uint64_t GetCpuWaits() const { return m_cpuWaits; }
+	uint64_t GetDeadlocks() const { return m_deadlocks; }
+
+private:
+	struct Item
+	{
+		std::string name; // submissions only
+		uint64_t fenceValue;
+		MockFenceQueue* waitQueue_p; // waits only
+		uint64_t waitValue;
+	};
+
+	uint64_t* m_clock_p;
+	std::deque<Item> m_items;
+	std::vector<MockFenceQueue*> m_connectedQueues;
+	std::vector<Completion> m_completions;
+	uint64_t m_submittedValue = 0;
+	uint64_t m_completedValue = 0;
+	uint64_t m_gpuWaits = 0;
+	uint64_t m_cpuWaits = 0;
+	uint64_t m_deadlocks = 0;
+};
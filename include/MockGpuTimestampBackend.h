@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "GpuProfiler.h"
+
+// Stands in for the GPU, for running GpuProfiler without a device. Command lists are ignored:
+// a timestamp takes the current value of a counter the caller advances, a resolve is staged
+// and becomes readable once the caller marks the submission as executed.
+class MockGpuTimestampBackend : public GpuTimestampBackend
+{
+public:
+	explicit MockGpuTimestampBackend(uint64_t p_frequency = 1000000)
+		: m_frequency(p_frequency)
+	{
+	}
+
+	void Initialize(uint32_t p_queryCount) override
+	{
+		m_queries.assign(p_queryCount, 0);
+		m_readback.assign(p_queryCount, 0);
+		m_isWritten.assign(p_queryCount, false);
+	}
+
+	void WriteTimestamp(GpuCommandListHandle, uint32_t p_query) override
+	{
+		m_queries.at(p_query) = m_ticks;
+		m_isWritten.at(p_query) = true;
+	}
+
+	void Resolve(GpuCommandListHandle, uint32_t p_firstQuery, uint32_t p_queryCount) override
+	{
+		for (uint32_t query = p_firstQuery; query < p_firstQuery + p_queryCount; query++)
+		{
+			if (!m_isWritten.at(query))
+			{
+				m_invalidResolves++; // the D3D12 debug layer would complain here
+			}
+			m_stagedResolves.push_back({ query, m_queries.at(query) });
+		}
+	}
+
+	void ReadResolved(uint32_t p_firstQuery, uint32_t p_queryCount, uint64_t* out_ticks) override
+	{
+		for (uint32_t i = 0; i < p_queryCount; i++)
+		{
+			out_ticks[i] = m_readback.at(p_firstQuery + i);
+		}
+		m_reads += p_queryCount;
+	}
+
+	uint64_t GetFrequency() const override { return m_frequency; }
+
+	// the GPU clock
+	void AdvanceTicks(uint64_t p_ticks) { m_ticks += p_ticks; }
+
+	// everything resolved so far reaches the readback slots, like a fence passing
+	void ExecuteSubmitted()
+	{
+		for (const StagedResolve& resolve : m_stagedResolves)
+		{
+			m_readback[resolve.query] = resolve.ticks;
+		}
+		m_stagedResolves.clear();
+	}
+
+	uint64_t GetInvalidResolves() const { return m_invalidResolves; }
+	uint64_t GetReads() const { return m_reads; }
+
+private:
+	struct StagedResolve
+	{
+		uint32_t query;
+		uint64_t ticks;
+	};
+
+	uint64_t m_frequency;
+	uint64_t m_ticks = 0;
+	std::vector<uint64_t> m_queries;
+	std::vector<uint64_t> m_readback;
+	std::vector<bool> m_isWritten;
+	std::vector<StagedResolve> m_stagedResolves;
+	uint64_t m_invalidResolves = 0;
+	uint64_t m_reads = 0;
+};
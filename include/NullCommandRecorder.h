@@ -0,0 +1,138 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "CommandRecorder.h"
+
+// one counter per CommandRecorder method
+enum NullCommand : uint8_t
+{
+	NULL_COMMAND_PIPELINE_STATE = 0,
+	NULL_COMMAND_ROOT_SIGNATURE,
+	NULL_COMMAND_DESCRIPTOR_HEAPS,
+	NULL_COMMAND_ROOT_DESCRIPTOR_TABLE,
+	NULL_COMMAND_ROOT_CONSTANTS,
+	NULL_COMMAND_ROOT_CBV,
+	NULL_COMMAND_ROOT_SRV,
+	NULL_COMMAND_COMPUTE_ROOT_SIGNATURE,
+	NULL_COMMAND_COMPUTE_ROOT_DESCRIPTOR_TABLE,
+	NULL_COMMAND_COMPUTE_ROOT_CONSTANTS,
+	NULL_COMMAND_COMPUTE_ROOT_CBV,
+	NULL_COMMAND_COMPUTE_ROOT_SRV,
+	NULL_COMMAND_PRIMITIVE_TOPOLOGY,
+	NULL_COMMAND_VERTEX_BUFFERS,
+	NULL_COMMAND_INDEX_BUFFER,
+	NULL_COMMAND_VIEWPORTS,
+	NULL_COMMAND_SCISSOR_RECTS,
+	NULL_COMMAND_RENDER_TARGETS,
+	NULL_COMMAND_CLEAR_RENDER_TARGET,
+	NULL_COMMAND_CLEAR_DEPTH_STENCIL,
+	NULL_COMMAND_RESOURCE_BARRIER,
+	NULL_COMMAND_COPY_RESOURCE,
+	NULL_COMMAND_DRAW,
+	NULL_COMMAND_DRAW_INDEXED,
+	NULL_COMMAND_DISPATCH,
+	NULL_COMMAND_EXECUTE_BUNDLE,
+	NULL_COMMAND_COUNT
+};
+
+const char* GetNullCommandName(NullCommand p_command);
+
+struct NullCommandStats
+{
+	uint64_t commands[NULL_COMMAND_COUNT] = { 0 };
+	uint64_t instances = 0; // summed over all draws
+	uint64_t vertices = 0; // indices for indexed draws, times the instance count
+	uint64_t rootConstantValues = 0; // 32-bit values set through root constants
+	uint64_t threadGroups = 0; // summed over all dispatches
+	uint64_t invalidCommands = 0;
+};
+
+// Records nothing. Keeps the state a command list would have bound and checks every command
+// against it, the way the debug layer would for the usage this renderer has: root arguments
+// need a root signature, draws need a pipeline, a topology and, outside bundles, targets,
+// a viewport and a scissor rect; indexed draws must stay inside the bound index buffer.
+// Dispatches need a pipeline and a compute root signature; a compute list takes no graphics commands.
+// Not thread-safe, one recorder per recording thread like a command list.
+class NullCommandRecorder final : public CommandRecorder
+{
+public:
+	// p_initialState_p is the pipeline state a list is created or reset with
+	explicit NullCommandRecorder(D3D12_COMMAND_LIST_TYPE p_type = D3D12_COMMAND_LIST_TYPE_DIRECT,
+		ID3D12PipelineState* p_initialState_p = nullptr);
+
+	void SetPipelineState(ID3D12PipelineState* p_pipelineState_p) override;
+	void SetGraphicsRootSignature(ID3D12RootSignature* p_rootSignature_p) override;
+	void SetDescriptorHeaps(UINT p_heapCount, ID3D12DescriptorHeap* const* p_heaps_p) override;
+
+	void SetGraphicsRootDescriptorTable(UINT p_rootParameter, D3D12_GPU_DESCRIPTOR_HANDLE p_baseDescriptor) override;
+	void SetGraphicsRoot32BitConstants(UINT p_rootParameter, UINT p_valueCount, const void* p_data_p, UINT p_destOffset) override;
+	void SetGraphicsRootConstantBufferView(UINT p_rootParameter, D3D12_GPU_VIRTUAL_ADDRESS p_bufferLocation) override;
+	void SetGraphicsRootShaderResourceView(UINT p_rootParameter, D3D12_GPU_VIRTUAL_ADDRESS p_bufferLocation) override;
+
+	void SetComputeRootSignature(ID3D12RootSignature* p_rootSignature_p) override;
+	void SetComputeRootDescriptorTable(UINT p_rootParameter, D3D12_GPU_DESCRIPTOR_HANDLE p_baseDescriptor) override;
+	void SetComputeRoot32BitConstants(UINT p_rootParameter, UINT p_valueCount, const void* p_data_p, UINT p_destOffset) override;
+	void SetComputeRootConstantBufferView(UINT p_rootParameter, D3D12_GPU_VIRTUAL_ADDRESS p_bufferLocation) override;
+	void SetComputeRootShaderResourceView(UINT p_rootParameter, D3D12_GPU_VIRTUAL_ADDRESS p_bufferLocation) override;
+
+	void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY p_topology) override;
+	void IASetVertexBuffers(UINT p_startSlot, UINT p_viewCount, const D3D12_VERTEX_BUFFER_VIEW* p_views_p) override;
+	void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* p_view_p) override;
+
+	void RSSetViewports(UINT p_viewportCount, const D3D12_VIEWPORT* p_viewports_p) override;
+	void RSSetScissorRects(UINT p_rectCount, const D3D12_RECT* p_rects_p) override;
+	void OMSetRenderTargets(UINT p_renderTargetCount, const D3D12_CPU_DESCRIPTOR_HANDLE* p_renderTargets_p,
+		BOOL p_isSingleHandleToDescriptorRange, const D3D12_CPU_DESCRIPTOR_HANDLE* p_depthStencil_p) override;
+
+	void ClearRenderTargetView(D3D12_CPU_DESCRIPTOR_HANDLE p_renderTarget, const FLOAT p_color[4]) override;
+	void ClearDepthStencilView(D3D12_CPU_DESCRIPTOR_HANDLE p_depthStencil, FLOAT p_depth) override;
+	void ResourceBarrier(UINT p_barrierCount, const D3D12_RESOURCE_BARRIER* p_barriers_p) override;
+	void CopyResource(ID3D12Resource* p_destination_p, ID3D12Resource* p_source_p) override;
+
+	void DrawInstanced(UINT p_vertexCountPerInstance, UINT p_instanceCount, UINT p_startVertex, UINT p_startInstance) override;
+	void DrawIndexedInstanced(UINT p_indexCountPerInstance, UINT p_instanceCount, UINT p_startIndex,
+		INT p_baseVertex, UINT p_startInstance) override;
+	void Dispatch(UINT p_groupCountX, UINT p_groupCountY, UINT p_groupCountZ) override;
+
+	void ExecuteBundle(ID3D12GraphicsCommandList* p_bundle_p) override;
+
+	// like resetting a command list: the bound state is forgotten, stats and errors are kept
+	void Reset(ID3D12PipelineState* p_initialState_p = nullptr);
+
+	const NullCommandStats& GetStats() const { return m_stats; }
+
+	// the first MaxKeptErrors, as "<command>: <reason>"; every one is counted in the stats
+	const std::vector<std::string>& GetErrors() const { return m_errors; }
+
+	static const size_t MaxKeptErrors = 32;
+
+	// the root signature limit: 64 DWORDs, so at most 64 parameters and 64 constants in one
+	static const UINT MaxRootValues = 64;
+
+private:
+	D3D12_COMMAND_LIST_TYPE m_type;
+
+	ID3D12PipelineState* m_pipelineState_p = nullptr;
+	ID3D12RootSignature* m_rootSignature_p = nullptr;
+	ID3D12RootSignature* m_computeRootSignature_p = nullptr;
+	bool m_hasDescriptorHeap = false;
+	D3D12_PRIMITIVE_TOPOLOGY m_topology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+	bool m_hasIndexBuffer = false;
+	D3D12_INDEX_BUFFER_VIEW m_indexBufferView = {};
+	UINT m_viewportCount = 0;
+	UINT m_scissorRectCount = 0;
+	bool m_hasRenderTarget = false; // a colour target or a depth-stencil
+
+	NullCommandStats m_stats;
+	std::vector<std::string> m_errors;
+
+	bool _isBundle() const { return m_type == D3D12_COMMAND_LIST_TYPE_BUNDLE; }
+	void _fail(NullCommand p_command, const char* p_reason);
+	void _failInBundle(NullCommand p_command);
+	void _failOnComputeList(NullCommand p_command);
+	// p_rootSignature_p is the graphics or the compute one, whichever the command sets arguments of
+	void _validateRootArgument(NullCommand p_command, UINT p_rootParameter, const ID3D12RootSignature* p_rootSignature_p);
+	void _validateDraw(NullCommand p_command, UINT p_instanceCount);
+};
@@ -0,0 +1,176 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+// One finished zone. Names are string literals, only the pointer is kept.
+struct ProfileEvent
+{
+	const char* name;
+	uint64_t startTicks;
+	uint64_t endTicks;
+	uint32_t depth; // nesting level on its thread, 0 is outermost
+};
+
+// Events of one thread, in a ring of Profiler::EventsPerThread that only the owning thread writes,
+// overwriting the oldest without checking; a capture reads what was written since it began.
+struct ProfileThreadBuffer
+{
+	std::unique_ptr<ProfileEvent[]> events; // allocated once, when the thread registers
+	std::atomic<uint64_t> writtenEvents = 0; // ever, published; the next goes to writtenEvents % EventsPerThread
+	uint64_t captureStartEvents = 0; // writtenEvents when the capture began, under the registry mutex
+	uint32_t depth = 0;
+	uint32_t threadIndex = 0; // tid in the trace
+	std::string name;
+};
+
+// what the last capture held, shown in the UI
+struct ProfilerCaptureStats
+{
+	uint64_t events = 0;
+	uint64_t droppedEvents = 0;
+	unsigned int threads = 0;
+	double seconds = 0.0;
+};
+
+// Hierarchical CPU profiler. Zones are recorded only while a capture runs; outside of one a
+// zone costs one atomic load. Inside one it costs two TSC reads, a thread-local load and a store
+// into the thread's ring, with no call and no branch but the first-zone-of-the-thread one.
+// Ticks are converted to microseconds when the capture is written, at a rate measured once.
+// Captures are written as Chrome trace JSON, which about:tracing and Perfetto open.
+class Profiler
+{
+public:
+	static Profiler& Get();
+
+	// names the calling thread in captures; safe to call before anything else of the profiler
+	static void SetThreadName(const char* p_name);
+
+	void BeginCapture();
+
+	// Stops the capture and writes it to p_path. Returns false if the file cannot be written.
+	bool EndCapture(const std::string& p_path);
+
+	bool IsCapturing() const { return m_isRecording.load(std::memory_order_acquire); }
+
+	ProfilerCaptureStats GetLastCaptureStats() const;
+
+	// events each thread keeps, a power of two; older events of a capture are overwritten and counted as dropped
+	static const uint32_t EventsPerThread = 1 << 15;
+
+	// zones still open when a capture ends may write this many events after it, over the oldest
+	// ones of the ring, so a capture reads at most EventsPerThread - MaxLateEvents per thread
+	static const uint32_t MaxLateEvents = 256;
+
+	// TSC ticks per microsecond, measured on the first call
+	static double GetTicksPerMicrosecond();
+
+	// hot path, used by ProfileZone
+	static bool IsRecording() { return m_isRecording.load(std::memory_order_acquire); }
+
+	static ProfileThreadBuffer& GetThreadBuffer()
+	{
+		ProfileThreadBuffer* buffer_p = m_threadBuffer_p;
+		if (buffer_p == nullptr)
+		{
+			// first zone of this thread
+			buffer_p = &Get()._registerThread();
+		}
+		return *buffer_p;
+	}
+
+	static void Append(ProfileThreadBuffer& p_buffer, const char* p_name, uint64_t p_startTicks, uint64_t p_endTicks, uint32_t p_depth)
+	{
+		// only this thread writes the count, a plain store publishes the event
+		const uint64_t index = p_buffer.writtenEvents.load(std::memory_order_relaxed);
+		p_buffer.events[index & (EventsPerThread - 1)] = { p_name, p_startTicks, p_endTicks, p_depth };
+		p_buffer.writtenEvents.store(index + 1, std::memory_order_release);
+	}
+
+	static uint64_t ReadTicks()
+	{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+	}
+
+private:
+	Profiler() = default;
+
+	// sets m_threadBuffer_p of the calling thread
+	ProfileThreadBuffer& _registerThread();
+
+	inline static std::atomic<bool> m_isRecording = false;
+	// constant initialized, so reading it is one load, without a guard or a call
+	inline static thread_local ProfileThreadBuffer* m_threadBuffer_p = nullptr;
+
+	// buffers outlive their threads, a capture may still read them
+	mutable std::mutex m_registryMutex;
+	std::vector<std::unique_ptr<ProfileThreadBuffer>> m_threadBuffers;
+
+	uint64_t m_captureStartTicks = 0;
+	double m_captureStartSeconds = 0.0;
+	ProfilerCaptureStats m_lastCaptureStats;
+};
+
+// records the time between construction and destruction as one event
+class ProfileZone
+{
+public:
+	explicit ProfileZone(const char* p_name)
+		: m_name(p_name)
+	{
+		if (Profiler::IsRecording())
+		{
+			m_buffer_p = &Profiler::GetThreadBuffer();
+			m_depth = m_buffer_p->depth++;
+			m_startTicks = Profiler::ReadTicks();
+		}
+	}
+
+	~ProfileZone()
+	{
+		if (m_buffer_p != nullptr)
+		{
+			uint64_t endTicks = Profiler::ReadTicks();
+			m_buffer_p->depth--;
+			Profiler::Append(*m_buffer_p, m_name, m_startTicks, endTicks, m_depth);
+		}
+	}
+
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+	const char* m_name;
+	ProfileThreadBuffer* m_buffer_p = nullptr;
+	uint64_t m_startTicks = 0;
+	uint32_t m_depth = 0;
+};
+
+// BEAR_PROFILE_ENABLED is set in the project for Debug and Release; a shipping build leaves it
+// out and every zone compiles to nothing.
+#if defined(BEAR_PROFILE_ENABLED)
+#define BEAR_PROFILE_CONCAT_INNER(a, b) a##b
+#define BEAR_PROFILE_CONCAT(a, b) BEAR_PROFILE_CONCAT_INNER(a, b)
+#define BEAR_PROFILE_ZONE(name) ProfileZone BEAR_PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define BEAR_PROFILE_FUNCTION() BEAR_PROFILE_ZONE(__FUNCTION__)
+#define BEAR_PROFILE_THREAD(name) Profiler::SetThreadName(name)
+#else
+#define BEAR_PROFILE_ZONE(name) ((void)0)
+#define BEAR_PROFILE_FUNCTION() ((void)0)
+#define BEAR_PROFILE_THREAD(name) ((void)0)
+#endif
@@ -0,0 +1,176 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Resource states a pass may ask for; bit flags, so reads can be combined.
+// D3D12Renderer maps them to D3D12_RESOURCE_STATES.
+enum RenderGraphState : uint32_t
+{
+	RENDER_GRAPH_STATE_COMMON = 0,
+	RENDER_GRAPH_STATE_RENDER_TARGET = 1 << 0,
+	RENDER_GRAPH_STATE_DEPTH_WRITE = 1 << 1,
+	RENDER_GRAPH_STATE_UNORDERED_ACCESS = 1 << 2,
+	RENDER_GRAPH_STATE_COPY_DEST = 1 << 3,
+	RENDER_GRAPH_STATE_DEPTH_READ = 1 << 4,
+	RENDER_GRAPH_STATE_PIXEL_SHADER_RESOURCE = 1 << 5,
+	RENDER_GRAPH_STATE_NON_PIXEL_SHADER_RESOURCE = 1 << 6,
+	RENDER_GRAPH_STATE_COPY_SOURCE = 1 << 7,
+	RENDER_GRAPH_STATE_PRESENT = 1 << 8
+};
+
+// a pass writing in one of these states uses the resource alone
+static const uint32_t RENDER_GRAPH_WRITE_STATES = RENDER_GRAPH_STATE_RENDER_TARGET | RENDER_GRAPH_STATE_DEPTH_WRITE |
+	RENDER_GRAPH_STATE_UNORDERED_ACCESS | RENDER_GRAPH_STATE_COPY_DEST;
+
+enum RenderGraphPassFlags : uint32_t
+{
+	RENDER_GRAPH_PASS_NONE = 0,
+	RENDER_GRAPH_PASS_SIDE_EFFECTS = 1 << 0, // never culled, even if nothing reads what it writes
+	RENDER_GRAPH_PASS_OWN_COMMAND_LISTS = 1 << 1 // records on lists of its own, no split barrier spans it
+};
+
+enum RenderGraphBarrierType : uint8_t
+{
+	RENDER_GRAPH_BARRIER_TRANSITION = 0,
+	RENDER_GRAPH_BARRIER_ALIASING = 1 // resource takes over heap memory from resourceBefore
+};
+
+enum RenderGraphBarrierSplit : uint8_t
+{
+	RENDER_GRAPH_SPLIT_NONE = 0,
+	RENDER_GRAPH_SPLIT_BEGIN = 1,
+	RENDER_GRAPH_SPLIT_END = 2
+};
+
+static const uint32_t RenderGraphInvalidIndex = UINT32_MAX;
+
+struct RenderGraphBarrier
+{
+	RenderGraphBarrierType type = RENDER_GRAPH_BARRIER_TRANSITION;
+	RenderGraphBarrierSplit split = RENDER_GRAPH_SPLIT_NONE;
+	uint32_t resource = RenderGraphInvalidIndex;
+	uint32_t resourceBefore = RenderGraphInvalidIndex; // aliasing only; invalid if several resources used the memory
+	uint32_t stateBefore = RENDER_GRAPH_STATE_COMMON;
+	uint32_t stateAfter = RENDER_GRAPH_STATE_COMMON;
+};
+
+struct RenderGraphStats
+{
+	unsigned int passes = 0;
+	unsigned int culledPasses = 0;
+	unsigned int barriers = 0; // a split barrier counts once
+	unsigned int splitBarriers = 0;
+	unsigned int aliasingBarriers = 0;
+	unsigned int barrierBatches = 0; // non-empty, one ResourceBarrier call each
+	uint64_t transientBytes = 0; // of all transient resources
+	uint64_t transientHeapBytes = 0; // what they take after aliasing
+};
+
+// A frame described as passes that read and write resources, compiled into what the command lists
+// need around every pass: one batch of barriers before it, split where the transition can start
+// passes earlier, placement of transient resources in a heap they share when their lifetimes do not
+// overlap, and which passes can be skipped because nothing uses their output.
+// Passes run in the order they are added. Imported resources live outside the graph, start in
+// a given state and are handed back in another; transient ones exist only between their first and
+// last use, start in the state of their first use and are returned to it right after the last.
+// Uses no device, so it builds and runs on Linux; D3D12Renderer turns the result into D3D12 barriers.
+class RenderGraph
+{
+public:
+	// forgets every pass and resource, keeps the memory
+	void Reset();
+
+	// p_isOutput: read after the graph, so its writers are never culled
+	uint32_t ImportResource(const char* p_name, uint32_t p_initialState, uint32_t p_finalState, bool p_isOutput);
+	// size and alignment are what the device reports for the resource's description
+	uint32_t CreateTransient(const char* p_name, uint64_t p_sizeInBytes, uint64_t p_alignment);
+
+	uint32_t AddPass(const char* p_name, uint32_t p_flags = RENDER_GRAPH_PASS_NONE);
+	void Read(uint32_t p_pass, uint32_t p_resource, uint32_t p_state);
+	void Write(uint32_t p_pass, uint32_t p_resource, uint32_t p_state);
+
+	// false if a transient resource is read before it is written, or a state is invalid;
+	// the results below are only valid after a successful compile
+	bool Compile();
+
+	bool IsPassCulled(uint32_t p_pass) const { return m_passes[p_pass].isCulled; }
+	// barriers to record before the pass; empty for culled passes
+	const RenderGraphBarrier* GetBarriersBefore(uint32_t p_pass, size_t& out_count) const;
+	// barriers to record after the last pass, imports to their final state
+	const RenderGraphBarrier* GetFinalBarriers(size_t& out_count) const;
+
+	uint64_t GetTransientHeapSize() const { return m_stats.transientHeapBytes; }
+	uint64_t GetTransientOffset(uint32_t p_resource) const { return m_resources[p_resource].heapOffset; }
+	// the state the transient resource is created in, that of its first use
+	uint32_t GetTransientInitialState(uint32_t p_resource) const { return m_resources[p_resource].initialState; }
+
+	const char* GetPassName(uint32_t p_pass) const { return m_passes[p_pass].name; }
+	const char* GetResourceName(uint32_t p_resource) const { return m_resources[p_resource].name; }
+	size_t GetPassCount() const { return m_passes.size(); }
+	size_t GetResourceCount() const { return m_resources.size(); }
+
+	RenderGraphStats GetStats() const { return m_stats; }
+
+private:
+	struct Resource
+	{
+		const char* name;
+		bool isTransient;
+		bool isOutput;
+		uint32_t initialState;
+		uint32_t finalState;
+		uint64_t sizeInBytes;
+		uint64_t alignment;
+		uint64_t heapOffset;
+		// among the passes that are not culled
+		uint32_t firstUse;
+		uint32_t lastUse;
+	};
+
+	struct Access
+	{
+		uint32_t pass;
+		uint32_t resource;
+		uint32_t state;
+		bool isWrite;
+	};
+
+	struct Pass
+	{
+		const char* name;
+		uint32_t flags;
+		bool isCulled;
+		// ranges in m_barriers, filled by Compile
+		uint32_t firstBarrier;
+		uint32_t barrierCount;
+	};
+
+	std::vector<Resource> m_resources;
+	std::vector<Pass> m_passes;
+	std::vector<Access> m_accesses; // sorted by pass while compiling, a pass's accesses merged per resource
+	std::vector<uint32_t> m_passAccessStart; // per pass, into m_accesses; one more entry for the end
+
+	// per pass batch, built in m_batches while compiling, then flattened into m_barriers
+	std::vector<std::vector<RenderGraphBarrier>> m_batches;
+	std::vector<RenderGraphBarrier> m_barriers;
+	uint32_t m_firstFinalBarrier = 0;
+
+	std::vector<uint8_t> m_isResourceNeeded;
+
+	RenderGraphStats m_stats;
+
+	// sorts the accesses by pass and merges those of a pass to the same resource
+	bool _mergeAccesses();
+	void _cullPasses();
+	bool _findLifetimes();
+	void _placeTransients();
+	void _buildBarriers();
+	// index into m_batches of the batch right before the first pass after p_pass that is not culled,
+	// m_passes.size() for the final batch; RenderGraphInvalidIndex for p_pass means the start of the graph
+	uint32_t _batchAfter(uint32_t p_pass) const;
+	// whether a transition can begin in one batch and end in a later one
+	bool _canSplit(uint32_t p_beginBatch, uint32_t p_endBatch) const;
+	// the read states the resource is in from p_pass on, up to the next pass that writes it
+	uint32_t _readStatesFrom(uint32_t p_pass, uint32_t p_resource) const;
+};
@@ -0,0 +1,73 @@
+#pragma once
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <cstdint>
+#include <vector>
+
+struct DrawItem;
+class WorkerPool;
+
+// per frame, shown in the frame pacing panel
+struct RenderQueueStats
+{
+	unsigned int items = 0;
+	unsigned int stateChangesUnsorted = 0; // texture or mesh switches in the order the packet had
+	unsigned int stateChangesSorted = 0; // the same, in queue order
+	unsigned int radixPasses = 0; // bytes sorted on, the others were equal in every key
+	double sortMilliseconds = 0.0; // keys and sort
+};
+
+// Orders the draws of a frame by a 64-bit key, most significant first:
+//   pass (2 bits) | pipeline (6) | material (16) | mesh (16) | view depth (24)
+// so state changes are grouped and, within one mesh and material, opaque draws go front to
+// back for early-Z. Keys are sorted with a stable LSD radix sort, 8 bits per pass, with the
+// histogram and scatter of each pass split across a worker pool.
+// Material and mesh ids are cut to 16 bits; a collision only costs a state change.
+class RenderQueue
+{
+public:
+	enum Pass : uint8_t
+	{
+		PASS_GBUFFER = 0
+	};
+
+	// p_viewDepth is clip w, i.e. the view space depth of a perspective projection
+	static uint64_t MakeSortKey(Pass p_pass, uint32_t p_pipeline, uint32_t p_material, uint32_t p_mesh, float p_viewDepth);
+
+	// keys every item by its origin as seen through p_vpMatrix, then sorts
+	void Build(const std::vector<DrawItem>& p_drawItems, const XMMATRIX& p_vpMatrix, WorkerPool& p_workerPool);
+
+	// the items of the last Build in queue order
+	void Gather(const std::vector<DrawItem>& p_drawItems, std::vector<DrawItem>& out_sortedItems) const;
+
+	RenderQueueStats GetStats() const { return m_stats; }
+
+	// below this many items per task the sort runs on fewer threads
+	static const size_t MinItemsPerSortTask = 4096;
+
+private:
+	struct Entry
+	{
+		uint64_t key;
+		uint32_t index; // into the draw items
+	};
+
+	std::vector<Entry> m_entries;
+	std::vector<Entry> m_scratch; // the other half of every scatter
+
+	// a bit set in some keys but not in all of them, a byte without one needs no pass
+	struct KeyBits
+	{
+		uint64_t setInAny = 0;
+		uint64_t setInAll = ~0ull;
+	};
+
+	std::vector<uint32_t> m_bucketOffsets; // 256 per task
+	std::vector<KeyBits> m_keyBits; // per task
+
+	RenderQueueStats m_stats;
+
+	void _sort(WorkerPool& p_workerPool, unsigned int p_taskCount, uint64_t p_differingBits);
+	static unsigned int _countStateChanges(const std::vector<DrawItem>& p_drawItems, const std::vector<Entry>* p_order_p);
+};
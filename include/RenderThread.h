@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "FrameMailbox.h"
+#include "FramePacket.h"
+
+class D3D12Renderer;
+class FramePacer;
+
+// Records and presents frames on a thread of its own. The game thread fills a FramePacket,
+// publishes it and goes on with the next frame while this one is submitted; if the render
+// thread falls behind, it skips to the newest packet instead of queueing them up.
+class RenderThread
+{
+public:
+	RenderThread(D3D12Renderer* p_renderer_p, FramePacer* p_framePacer_p);
+	~RenderThread();
+
+	RenderThread(const RenderThread&) = delete;
+	RenderThread& operator=(const RenderThread&) = delete;
+
+	// game thread: fill the returned packet, then publish it; never blocks
+	FramePacket& BeginPacket();
+	void PublishPacket();
+
+	// Runs p_function on the calling thread while no frame is being recorded or presented,
+	// for anything that changes a window's swap chain, e.g. a resize or a window switch.
+	// May nest, showing a window inside a switch sends WM_SIZE right away.
+	void RunWhileIdle(const std::function<void()>& p_function);
+
+	// finishes the frame being rendered and joins the thread
+	void Stop();
+
+	uint64_t GetRenderedFrames() const { return m_renderedFrames; }
+	uint64_t GetDroppedPackets() const { return m_droppedPackets; } // published but replaced before they were rendered
+
+private:
+	void _renderLoop();
+
+	D3D12Renderer* m_renderer_p;
+	FramePacer* m_framePacer_p;
+
+	FrameMailbox<FramePacket> m_mailbox;
+
+	std::thread m_thread;
+	std::recursive_mutex m_renderMutex; // held while a packet is rendered
+	std::atomic<bool> m_isQuitting = false;
+
+	std::atomic<uint64_t> m_renderedFrames = 0;
+	std::atomic<uint64_t> m_droppedPackets = 0;
+};
@@ -0,0 +1,60 @@
+#pragma once
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#include <cstdint>
+#include <vector>
+
+#include "DynamicBvh.h"
+
+class Instance;
+
+// per frame, shown in the frame pacing panel
+struct SceneBvhStats
+{
+	unsigned int leaves = 0;
+	int height = 0;
+	unsigned int inserted = 0; // by the last Sync
+	unsigned int removed = 0;
+	unsigned int refit = 0;
+	double syncMilliseconds = 0.0;
+	unsigned int cullNodes = 0; // tested by the last CullFrustum
+	unsigned int visible = 0;
+	double cullMilliseconds = 0.0;
+	unsigned int pickNodes = 0; // tested by the last Pick
+	uint64_t rotations = 0;
+};
+
+// A DynamicBvh with one leaf per scene instance, for hierarchical culling and editor picking.
+// Instances are created, edited and removed without notifying anyone, so Sync walks the
+// instance list of every frame: instances without a leaf are inserted, those whose revision
+// changed are refit, and leaves whose instance was not in the list are removed. Game thread only.
+class SceneBvh
+{
+public:
+	void Sync(const std::vector<Instance*>& p_instances);
+
+	// instances whose bounds are not entirely outside p_planes, in no particular order
+	void CullFrustum(const FrustumPlanes& p_planes, std::vector<Instance*>& out_visible);
+
+	// The instance whose mesh the world space ray p_origin + t * p_direction hits first for t in
+	// [0, 1], tested triangle by triangle; nullptr if none.
+	Instance* Pick(const XMVECTOR& p_origin, const XMVECTOR& p_direction);
+
+	SceneBvhStats GetStats() const { return m_stats; }
+
+private:
+	struct LeafState
+	{
+		Instance* instance_p = nullptr; // only compared, the instance may be gone
+		uint64_t revision = 0;
+		uint64_t seenInSync = 0;
+	};
+
+	DynamicBvh m_tree;
+	std::vector<LeafState> m_leafStates; // by leaf
+	uint64_t m_syncCount = 0;
+	std::vector<void*> m_queryResult;
+
+	SceneBvhStats m_stats;
+};
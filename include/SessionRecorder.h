@@ -0,0 +1,148 @@
+#pragma once
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class BearWindow;
+class Message;
+
+// the two message queues a session is driven through
+enum SessionQueue : uint8_t
+{
+	SESSION_QUEUE_MESH = 0, // MeshManager
+	SESSION_QUEUE_UI = 1, // UIManager
+	SESSION_QUEUE_COUNT = 2
+};
+
+// of the replay in progress, or of the last one once it has finished
+struct SessionReplayStats
+{
+	uint64_t frames = 0; // replayed so far
+	uint64_t totalFrames = 0; // in the log
+	uint64_t inputEvents = 0;
+	uint64_t injectedMessages = 0; // fed from the log, their live source is muted
+	uint64_t matchedMessages = 0; // sent again by the session and equal to the logged one
+	uint64_t divergentMessages = 0; // sent again but different, or more than were logged
+	int64_t firstDivergentFrame = -1;
+	bool isFinished = false;
+};
+
+// Records what drives a session into a binary log: the clock delta of every frame, window input
+// and every message pushed to the MeshManager and UIManager queues. A replay feeds the log back
+// frame by frame: each frame gets its recorded delta instead of the wall clock, and the input
+// logged before it is handed to the window, while live input is ignored.
+// Messages the session sends itself, e.g. UI requests caused by replayed clicks and the manager's
+// replies, are sent again and only compared against the log, so a replay that goes its own way
+// shows up as divergent messages. Messages from sources that do not follow the frame, the
+// memory sampler, are muted and injected from the log instead.
+// After a replay the wall time of every frame is written next to the log as <log>.frames.csv,
+// to compare the same workload across builds.
+class SessionRecorder
+{
+public:
+	static SessionRecorder& Get();
+
+	// Starts an empty log; it is written to p_path when the recording stops.
+	// False if a replay is running or the file cannot be created.
+	bool StartRecording(const std::string& p_path);
+	bool StopRecording(); // false if the log could not be written
+	bool IsRecording() const { return m_mode == MODE_RECORDING; }
+	uint64_t GetRecordedBytes() const;
+
+	// False if the log cannot be read or is not a session log. With p_shouldQuitWhenDone the
+	// application quits after the last frame, for running a benchmark from the command line.
+	bool StartReplay(const std::string& p_path, bool p_shouldQuitWhenDone);
+	void StopReplay();
+	bool IsReplaying() const { return m_mode == MODE_REPLAYING; }
+	SessionReplayStats GetReplayStats() const;
+
+	// Game thread, at the start of every frame, before anything uses the delta. Records the delta,
+	// or during a replay feeds the frame's input to p_window_p and returns the recorded delta.
+	double BeginFrame(double p_deltaSeconds, BearWindow* p_window_p);
+
+	// the delta BeginFrame returned last, for ImGui during a replay
+	double GetFrameDeltaSeconds() const { return m_frameDeltaSeconds; }
+
+	// the window messages a session log keeps
+	static bool IsInputMessage(UINT p_message);
+
+	// Game thread, for every input message a window receives. False during a replay,
+	// where the window only gets the logged input.
+	bool OnInput(bool p_isDemoWindow, UINT p_message, WPARAM p_wParam, LPARAM p_lParam);
+
+	// Any thread, before p_message is pushed to the queue. False if the caller should drop it,
+	// the replay injects the logged copy instead.
+	bool OnMessage(SessionQueue p_queue, Message& p_message);
+
+	static const uint32_t LogVersion = 1;
+
+private:
+	SessionRecorder() = default;
+
+	enum Mode : uint8_t
+	{
+		MODE_IDLE = 0,
+		MODE_RECORDING = 1,
+		MODE_REPLAYING = 2
+	};
+
+	enum EventKind : uint8_t
+	{
+		EVENT_FRAME = 0,
+		EVENT_INPUT = 1,
+		EVENT_MESSAGE = 2
+	};
+
+	struct ReplayEvent
+	{
+		EventKind kind;
+		bool isDemoWindow;
+		uint8_t queue;
+		uint32_t value; // window message, or message type
+		uint64_t wParam;
+		int64_t lParam;
+		double deltaSeconds;
+		size_t payloadOffset; // into m_replayPayloads
+		uint32_t payloadSize;
+	};
+
+	using Clock = std::chrono::steady_clock;
+
+	std::atomic<Mode> m_mode = MODE_IDLE; // only changed on the game thread, read on any
+	mutable std::mutex m_mutex; // log and replay cursor, messages arrive on any thread
+
+	// recording
+	std::string m_path;
+	std::vector<uint8_t> m_log;
+
+	// replay
+	std::vector<ReplayEvent> m_replayEvents;
+	std::vector<uint8_t> m_replayPayloads;
+	size_t m_replayCursor = 0;
+	std::vector<size_t> m_expectedMessages[SESSION_QUEUE_COUNT]; // into m_replayEvents, in logged order
+	size_t m_matchedCount[SESSION_QUEUE_COUNT] = { 0 };
+	SessionReplayStats m_replayStats;
+	bool m_shouldQuitWhenDone = false;
+	std::vector<double> m_recordedMilliseconds;
+	std::vector<double> m_replayedMilliseconds;
+	Clock::time_point m_lastFrameStart;
+
+	double m_frameDeltaSeconds = 0.0;
+	std::atomic<uint64_t> m_frameNumber = 0; // frames begun since the recording or replay started
+
+	static bool _isSuppliedByLog(uint32_t p_messageType);
+	static bool _hasComparablePayload(uint32_t p_messageType);
+
+	void _append(const void* p_data_p, size_t p_size);
+	bool _loadLog(const std::string& p_path);
+	double _replayFrame(BearWindow* p_window_p);
+	void _injectMessage(const ReplayEvent& p_event);
+	void _finishReplay();
+	bool _writeFrameTimes() const;
+};
@@ -17,7 +17,8 @@ using namespace Microsoft::WRL;
 class Shader
 {
 public:
-	Shader(const wchar_t* p_1stVsPath, const wchar_t* p_1sPsPath, const wchar_t* p_2ndVsPath, const wchar_t* p_2ndPsPath);
+	Shader(const wchar_t* p_1stVsPath, const wchar_t* p_1sPsPath, const wchar_t* p_2ndVsPath, const wchar_t* p_2ndPsPath,
+		const wchar_t* p_lightingCsPath, const wchar_t* p_depthPrepassVsPath);
 	~Shader();
 
 	void GetRSAndPSO_1stPass(ComPtr<ID3D12RootSignature>& rootSignature, ComPtr<ID3D12PipelineState>& pipelineState)
@@ -26,12 +27,41 @@ public:
 		pipelineState = m_1stPassPipelineState;
 	}
 
+	// the first pass after a depth prepass: depth is tested for EQUAL and not written, so every pixel
+	// runs the pixel shader once, for the surface the prepass kept
+	void GetRSAndPSO_1stPassDepthEqual(ComPtr<ID3D12RootSignature>& rootSignature, ComPtr<ID3D12PipelineState>& pipelineState)
+	{
+		rootSignature = m_1stPassRootSignature;
+		pipelineState = m_1stPassDepthEqualPipelineState;
+	}
+
+	// depth only, from the position stream; shares the first pass's root signature
+	void GetRSAndPSO_DepthPrepass(ComPtr<ID3D12RootSignature>& rootSignature, ComPtr<ID3D12PipelineState>& pipelineState)
+	{
+		rootSignature = m_1stPassRootSignature;
+		pipelineState = m_depthPrepassPipelineState;
+	}
+
+	// the depth prepass's shaders into a shadow cascade, see D3D12Renderer::ShadowMapFormat
+	void GetRSAndPSO_ShadowMap(ComPtr<ID3D12RootSignature>& rootSignature, ComPtr<ID3D12PipelineState>& pipelineState)
+	{
+		rootSignature = m_1stPassRootSignature;
+		pipelineState = m_shadowMapPipelineState;
+	}
+
 	void GetRSAndPSO_2ndPass(ComPtr<ID3D12RootSignature>& rootSignature, ComPtr<ID3D12PipelineState>& pipelineState)
 	{
 		rootSignature = m_2ndPassRootSignature;
 		pipelineState = m_2ndPassPipelineState;
 	}
 
+	// second pass as a compute shader, lighting the G-buffer per tile; see RecordTiledLightingPass
+	void GetRSAndPSO_TiledLighting(ComPtr<ID3D12RootSignature>& rootSignature, ComPtr<ID3D12PipelineState>& pipelineState)
+	{
+		rootSignature = m_tiledLightingRootSignature;
+		pipelineState = m_tiledLightingPipelineState;
+	}
+
 	void RebuildShaders();
 
 private:
@@ -39,20 +69,30 @@ private:
 	ComPtr<ID3DBlob> m_1stPassPixelShaderBlob;
 	ComPtr<ID3DBlob> m_2ndPassVertexShaderBlob;
 	ComPtr<ID3DBlob> m_2ndPassPixelShaderBlob;
+	ComPtr<ID3DBlob> m_tiledLightingComputeShaderBlob;
+	ComPtr<ID3DBlob> m_depthPrepassVertexShaderBlob;
 
 	// Root signature
 	ComPtr<ID3D12RootSignature> m_1stPassRootSignature;
 	ComPtr<ID3D12RootSignature> m_2ndPassRootSignature;
+	ComPtr<ID3D12RootSignature> m_tiledLightingRootSignature;
 	// Pipeline state object.
 	ComPtr<ID3D12PipelineState> m_1stPassPipelineState;
+	ComPtr<ID3D12PipelineState> m_1stPassDepthEqualPipelineState;
+	ComPtr<ID3D12PipelineState> m_depthPrepassPipelineState;
+	ComPtr<ID3D12PipelineState> m_shadowMapPipelineState;
 	ComPtr<ID3D12PipelineState> m_2ndPassPipelineState;
+	ComPtr<ID3D12PipelineState> m_tiledLightingPipelineState;
 
 	std::wstring m_1stVsPath;
 	std::wstring m_1stPsPath;
 	std::wstring m_2ndVsPath;
 	std::wstring m_2ndPsPath;
+	std::wstring m_lightingCsPath;
+	std::wstring m_depthPrepassVsPath;
 
 	void _createRSAndPSO();
 	void _create1st();
 	void _create2nd();
+	void _createTiledLighting();
 };
\ No newline at end of file
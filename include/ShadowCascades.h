@@ -0,0 +1,134 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "FrustumCuller.h"
+
+class WorkerPool;
+
+// NOTE: must match SHADOW_CASCADE_COUNT in Lighting.hlsli
+static const unsigned int ShadowCascadeCount = 4;
+
+// one slice of the camera frustum and the shadow map that covers it
+struct ShadowCascade
+{
+	// world to shadow map, row-major for row vectors like FrustumCuller's input, D3D depth 0 to 1
+	float viewProjection[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+	float splitDepth = 0.0f; // view depth the cascade reaches to, it starts where the previous one ends
+	float texelSize = 0.0f; // world units per shadow map texel
+	std::vector<uint32_t> casters; // indices of the casters that may throw a shadow into it, increasing
+};
+
+// per frame, shown in the frame pacing panel
+struct ShadowCascadeStats
+{
+	unsigned int casters = 0;
+	unsigned int casterIndices = 0; // caster and cascade pairs
+	unsigned int refitCascades = 0; // cascades whose map moved this frame
+	double cullMilliseconds = 0.0;
+};
+
+// Fits the shadow maps of a directional light to slices of the camera frustum and finds the casters
+// each of them has to draw.
+// A cascade covers the bounding sphere of its slice, whose radius does not change when the camera
+// turns, with a margin around it. Its map stays where it is until the sphere leaves that margin, and
+// is then centered again on a whole texel, so a static caster lands on the same texels for as long as
+// the light does not change, and the map can be kept from one frame to the next.
+// A caster is kept for a cascade when its box overlaps the map's square and does not lie entirely
+// behind its far plane; casters between the light and the near plane are kept too and flattened
+// onto it by the rasterizer. Casters are tested in parallel, one task per cascade.
+class ShadowCascades
+{
+public:
+	static const unsigned int CascadeCount = ShadowCascadeCount;
+	// texels per side of each cascade's map
+	static const unsigned int Resolution = 2048;
+	// half the map's side is the sphere's radius times 1 + this
+	static constexpr float Margin = 0.25f;
+
+	// p_view_p is a row-major 4x4 world to view matrix for row vectors, view space looks down +z;
+	// the tangents are of half the horizontal and vertical field of view
+	void SetCamera(const float* p_view_p, float p_tanHalfFovX, float p_tanHalfFovY, float p_nearZ, float p_farZ);
+
+	// the direction the light travels in, in world space; need not be normalized
+	void SetLightDirection(const float* p_direction_p);
+
+	// shadows end this far from the camera, or at its far plane if that is closer; p_lambda blends the
+	// splits between uniform, 0, and logarithmic, 1
+	void SetShadowDistance(float p_distance, float p_lambda = 0.9f);
+
+	// places every cascade for the camera and light set above; moves a map only when it has to
+	void Fit();
+
+	void Resize(size_t p_count);
+	void SetCaster(size_t p_index, const BoundingAabb& p_bounds);
+
+	// after Fit; a null pool culls on the calling thread
+	void Cull(WorkerPool* p_workerPool_p);
+
+	const ShadowCascade& GetCascade(unsigned int p_cascade) const { return m_cascades[p_cascade]; }
+
+	ShadowCascadeStats GetStats() const { return m_stats; }
+
+private:
+	// where a cascade's map is, in light space
+	struct Placement
+	{
+		float center[3] = { 0.0f, 0.0f, 0.0f }; // on the texel grid
+		float halfSize = 0.0f; // 0 until the first fit
+	};
+
+	float m_view[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+	float m_tanHalfFovX = 1.0f;
+	float m_tanHalfFovY = 1.0f;
+	float m_nearZ = 0.1f;
+	float m_farZ = 1000.0f;
+	float m_shadowDistance = 200.0f;
+	float m_lambda = 0.9f;
+
+	// light space axes in world space, x and y across the map, z along the light
+	float m_lightAxes[3][3] = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } };
+	bool m_hasLightChanged = true;
+
+	Placement m_placements[CascadeCount];
+	ShadowCascade m_cascades[CascadeCount];
+
+	std::vector<BoundingAabb> m_casters;
+	std::vector<BoundingAabb> m_lightSpaceCasters;
+
+	ShadowCascadeStats m_stats;
+
+	void _toLightSpace(const float* p_world_p, float* out_light_p) const;
+	void _buildViewProjection(unsigned int p_cascade);
+	void _cullCascade(unsigned int p_cascade);
+};
+
+// Remembers what each cascade of every set of shadow maps was last rendered with, so a cascade is
+// rendered again only when its matrix changed or a caster entered, left, moved or was edited.
+// Casters are told apart by Instance::GetRevision, which is never shared by two instances or two
+// states of one. Works on the frame packet's data alone, so it runs on the render thread, which
+// sees only the packets it renders.
+class ShadowMapCache
+{
+public:
+	explicit ShadowMapCache(unsigned int p_setCount);
+
+	// True if the cascade of the set has to be rendered for this matrix and these casters, in any order;
+	// they are remembered as rendered then.
+	bool Update(unsigned int p_set, unsigned int p_cascade, const float* p_viewProjection_p, const std::vector<uint64_t>& p_casterRevisions);
+
+	// every cascade is rendered again, e.g. after the maps were recreated
+	void Invalidate();
+
+private:
+	struct Entry
+	{
+		bool isValid = false;
+		float viewProjection[16] = {};
+		std::vector<uint64_t> casterRevisions; // sorted
+	};
+
+	std::vector<Entry> m_entries; // by set, then cascade
+	std::vector<uint64_t> m_sortedRevisions; // scratch
+};
@@ -0,0 +1,118 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "FrustumCuller.h"
+
+class WorkerPool;
+
+// per frame, shown in the frame pacing panel
+struct OcclusionStats
+{
+	unsigned int occluders = 0;
+	unsigned int occluderTriangles = 0; // set up for rasterization, the rest crossed the near plane or were off screen
+	unsigned int tested = 0;
+	unsigned int occluded = 0; // draws that were culled
+	unsigned int tasks = 0;
+	bool isAvx2 = false; // 8 pixels per iteration, otherwise one
+	double rasterMilliseconds = 0.0;
+	double testMilliseconds = 0.0;
+};
+
+// Culls boxes hidden behind a few large occluders, on the CPU, before the draw list is built.
+// The occluders' triangles are rasterized into a small depth buffer, keeping the nearest depth
+// per pixel; every 8x8 tile then keeps the farthest depth of its pixels. A box is occluded when
+// its nearest corner is farther than that in every tile its screen rectangle touches.
+// Rasterization is split into bands of tile rows, one task each, so every pixel is written by
+// one task only and the result does not depend on the thread count.
+// Triangles that cross the near plane are dropped, which only makes occluders smaller; a box
+// that crosses it is always visible. Coverage is sampled at pixel centers of the low resolution
+// buffer, so an occluder can hide a sliver less than a pixel wide next to its silhouette.
+class SoftwareOcclusion
+{
+public:
+	static const unsigned int Width = 320;
+	static const unsigned int Height = 192;
+	static const unsigned int TileSize = 8;
+	static const unsigned int TilesX = Width / TileSize;
+	static const unsigned int TilesY = Height / TileSize;
+
+	// occluder selection, see Application::_cullOccludedInstances
+	static const size_t MaxOccluders = 32;
+	static const size_t MaxOccluderTriangles = 4096; // per occluder
+	static constexpr float MinOccluderScreenSize = 0.1f; // bounding radius over view depth
+
+	// Starts a frame seen through p_viewProjection_p, a row-major 4x4 matrix for row vectors
+	// with D3D clip depth 0 to w, and forgets the occluders of the last one.
+	void Begin(const float* p_viewProjection_p);
+
+	// p_corners_p holds three xyz corners per triangle in model space and must stay valid until
+	// Rasterize returns; p_modelToClip_p is laid out like the view projection.
+	void AddOccluder(const float* p_modelToClip_p, const float* p_corners_p, size_t p_triangleCount);
+
+	void Rasterize(WorkerPool* p_workerPool_p);
+
+	// the boxes to test, in world space, like FrustumCuller
+	void Resize(size_t p_count);
+	void SetBounds(size_t p_index, const BoundingAabb& p_bounds);
+
+	// after Rasterize; a null pool tests on the calling thread
+	void Cull(WorkerPool* p_workerPool_p);
+	bool IsVisible(size_t p_index) const { return m_visible[p_index] != 0; }
+
+	OcclusionStats GetStats() const { return m_stats; }
+
+	// row by row, 1 where no occluder was rasterized
+	const std::vector<float>& GetDepth() const { return m_depth; }
+	const std::vector<float>& GetTileMaxDepth() const { return m_tileMaxDepth; }
+
+	// below this many boxes per task the test runs on fewer threads
+	static const size_t MinBoundsPerTestTask = 1024;
+
+	// off rasterizes with the scalar path even where AVX2 is supported, to compare the two
+	void SetAvx2Enabled(bool p_isEnabled) { m_isAvx2Enabled = p_isEnabled; }
+
+private:
+	struct Occluder
+	{
+		float modelToClip[16];
+		const float* corners_p;
+		size_t triangleCount;
+		size_t firstTriangle; // into m_triangles
+	};
+
+	// edge functions and depth as planes over the screen, a x + b y + c at pixel centers
+	struct ScreenTriangle
+	{
+		float edgeA[3];
+		float edgeB[3];
+		float edgeC[3];
+		float depthA;
+		float depthB;
+		float depthC;
+		int32_t minX; // pixels whose centers may be covered, empty if maxX < minX
+		int32_t maxX;
+		int32_t minY;
+		int32_t maxY;
+	};
+
+	float m_viewProjection[16] = {};
+	bool m_isAvx2Enabled = true;
+	std::vector<Occluder> m_occluders;
+	std::vector<ScreenTriangle> m_triangles;
+	std::vector<float> m_depth = std::vector<float>(Width * Height, 1.0f);
+	std::vector<float> m_tileMaxDepth = std::vector<float>(TilesX * TilesY, 1.0f);
+
+	std::vector<BoundingAabb> m_bounds;
+	std::vector<uint8_t> m_visible;
+	std::vector<unsigned int> m_taskOccluded;
+
+	OcclusionStats m_stats;
+
+	void _setUpTriangles(const Occluder& p_occluder);
+	void _rasterizeBand(unsigned int p_firstTileRow, unsigned int p_endTileRow, bool p_isAvx2);
+	void _rasterizeScalar(const ScreenTriangle& p_triangle, int32_t p_firstRow, int32_t p_endRow);
+	void _rasterizeAvx2(const ScreenTriangle& p_triangle, int32_t p_firstRow, int32_t p_endRow);
+	bool _isBoundsVisible(const BoundingAabb& p_bounds) const;
+};
@@ -13,9 +13,8 @@ using namespace Microsoft::WRL;
 enum ResourceIndex
 {
 	DIFFUSE = 0,
-	NORMAL = 1,
-	SPECULAR = 2,
-	MAX_NO = 3
+	MATERIAL = 1, // RG: normal XY, B: specular, A: spare
+	MAX_NO = 2
 };
 
 class Texture
@@ -30,17 +29,18 @@ public:
 		_initialize();
 	}
 
-	~Texture()
-	{
-	}
+	~Texture();
 
 	const std::string& GetName() const { return m_name; }
 
+	// unique among loaded textures, used as the material in render queue sort keys
+	unsigned int GetTextureIndex() const { return m_textureIndex; }
+
 	D3D12_GPU_DESCRIPTOR_HANDLE GetSrvHeapStart();
 
 private:
 	std::string m_name;
-	ComPtr<ID3D12Resource> m_resources[ResourceIndex::MAX_NO]; //one for each RTV-mapped SRV
+	ComPtr<ID3D12Resource> m_resources[ResourceIndex::MAX_NO]; //one for each SRV in the material table
 
 	unsigned int m_textureIndex = 0; // to calculate the offset in SRV heap
 	unsigned int m_srvHeapOffset = 1; // default value
@@ -49,6 +49,12 @@ private:
 	void _loadTexture(unsigned int p_internalResourceIndex);
 
 	void _loadDDSTexture(const wchar_t* p_fullpath, unsigned int p_internalResourceIndex);
+	// cook the source into a mipmapped DDS if needed, then load that
+	bool _loadCookedTexture(const wchar_t* p_sourcePath, unsigned int p_internalResourceIndex);
+	// pack <name>_normal.jpg and <name>_specular.jpg into the MATERIAL slot
+	bool _loadCookedMaterial();
+	// a 1x1 MATERIAL texture with a flat normal and no specular, for when there is nothing to pack
+	void _createDefaultMaterial();
 	void _loadWICTexture(const wchar_t* p_fullpath, unsigned int p_internalResourceIndex, bool p_createMissingMipmap = false);
 
 	void _createSRV(unsigned int p_internalResourceIndex);
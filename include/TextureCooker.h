@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <DirectXMath.h>
+using namespace DirectX;
+
+// Downsampling kernel used to build the mip chain
+enum MipFilter : uint8_t
+{
+	MIP_FILTER_BOX = 0, // 2x2 average, cheap and soft
+	MIP_FILTER_KAISER = 1 // windowed sinc, keeps detail and avoids most aliasing
+};
+
+// How the texels of a source image are interpreted while filtering
+enum CookUsage : uint8_t
+{
+	COOK_USAGE_COLOR = 0, // sRGB encoded, filtered in linear space
+	COOK_USAGE_NORMAL = 1, // tangent-space normal, renormalized per mip
+	COOK_USAGE_LINEAR = 2 // plain data, e.g. specular
+};
+
+// Cooks a source image (jpg, png, ...) into a DDS with a full mip chain, so that
+// the runtime only uploads ready-made data and never generates mips on the GPU.
+// The SHA256 of the source is stored in the DDS header; a cooked file is rebuilt
+// only when the source changes, similar to the mesh .bin cache.
+class TextureCooker
+{
+public:
+	TextureCooker(MipFilter p_filter = MIP_FILTER_KAISER);
+
+	// Returns false if the source cannot be decoded or the output cannot be written.
+	bool Cook(const wchar_t* p_sourcePath, const wchar_t* p_cookedPath, CookUsage p_usage);
+
+	// Packs a normal map and a specular map into one RGBA8 texture:
+	// R, G = normal XY in [0, 1], B = specular, A = spare (1.0).
+	// Normal Z is reconstructed in the pixel shader. A missing source is replaced
+	// by a neutral value (flat normal, no specular); the specular map is resampled
+	// to the size of the normal map if they differ.
+	bool CookPackedMaterial(const wchar_t* p_normalPath, const wchar_t* p_specularPath, const wchar_t* p_cookedPath);
+
+	// True if the cooked file exists and was produced from the current sources.
+	static bool IsUpToDate(const std::vector<std::wstring>& p_sourcePaths, const wchar_t* p_cookedPath);
+
+	// bump when the cooked layout or filtering changes, to invalidate old files
+	static const uint32_t CookVersion = 2;
+
+private:
+	struct MipLevel
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<XMVECTOR> texels; // RGBA, linear space
+	};
+
+	MipFilter m_filter;
+
+	// separable 1D kernel for 2:1 decimation, replicated to all four lanes
+	std::vector<XMVECTOR> m_weights;
+	int m_firstTapOffset = 0;
+
+	void _buildKernel();
+	bool _decode(const wchar_t* p_sourcePath, CookUsage p_usage, MipLevel& out_level);
+	void _buildMipChain(CookUsage p_usage, std::vector<MipLevel>& p_mipChain);
+	void _downsample(const MipLevel& p_source, MipLevel& out_level);
+	void _resample(const MipLevel& p_source, uint32_t p_width, uint32_t p_height, MipLevel& out_level);
+	void _postProcess(MipLevel& p_level, CookUsage p_usage);
+	void _encode(const MipLevel& p_level, CookUsage p_usage, std::vector<uint8_t>& out_bytes);
+	bool _writeDDS(const wchar_t* p_cookedPath, const std::vector<MipLevel>& p_mipChain, CookUsage p_usage, const unsigned char* p_sourceHash);
+
+	// reported to MemoryTracker while a cook is in progress
+	static size_t _getChainBytes(const std::vector<MipLevel>& p_mipChain);
+
+	// hash over all sources; a missing source hashes differently from an empty one
+	static void _hashFiles(const std::vector<std::wstring>& p_paths, unsigned char* out_hash);
+};
@@ -13,6 +13,7 @@ using namespace Microsoft::WRL;
 #include <EntityInstance.h>
 #include <map>
 #include <Helpers.h>
+#include <FramePacket.h>
 
 #include <d3d11.h>
 #include <d3d11on12.h>
@@ -82,9 +83,16 @@ public:
 
 	void CreateImGuiWindowContent();
 
-	void Draw(ComPtr<ID3D12GraphicsCommandList2> commandList);
+	// game thread, after CreateImGuiWindowContent: uploads changed ImGui textures and copies the draw data
+	void SnapshotDrawData(ImGuiDrawSnapshot& out_snapshot);
 
-	void DrawD2DContent(RenderResource& currentRR, GameState p_gameState);
+	// render thread, draws a snapshot taken with SnapshotDrawData
+	void Draw(ComPtr<ID3D12GraphicsCommandList2> commandList, const ImGuiDrawSnapshot& p_snapshot);
+
+	void DrawD2DContent(RenderResource& currentRR, GameState p_gameState, const std::wstring& p_overlayText);
+
+	// debug text of the demo window overlay, built on the game thread
+	void GenerateOverlayDebugInfo(std::wstring& out_text);
 
 	void SetMainCamera(Camera* cam);
 
@@ -113,17 +121,21 @@ private:
 	bool errorMessage = false; // to trigger error message popup
 	char errorMessageBuffer[256] = { 0 };
 	uint64_t m_memInfo[2] = { 0 }; // used and total memory info
-	LightConstants m_lightConstants;
+	LightSet m_lights; // edited here, sent to the MeshManager with "Update Lighting"
 	// debug, hit result
 	float m_hitResult[3] = { 0.0f, 0.0f, 0.0f };
 
 	// For DEBUG purposes
 	static const int MAX_DEBUG_INFO_LENGTH = 4096;
-	int GenerateOverlayDebugInfo();
 	wchar_t m_debugInfoBuffer[MAX_DEBUG_INFO_LENGTH] = { 0 };
 
 	void _listen();
 	void _processMessage(Message& msg);
+	void _createMemoryStatsContent();
+	void _createFramePacingContent();
+	void _createProfilerContent();
+	void _createSessionContent();
+	void _pickInstanceUnderMouse(); // selects the instance clicked on in the scene
 	void _saveMap();
 	bool _loadMap();
 	void _clampRotation(float* rotation_p);
@@ -0,0 +1,50 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads that run the tasks of one Dispatch() at a time.
+// The calling thread works on the tasks too and returns once all of them are done,
+// so a pool with N threads runs up to N + 1 tasks in parallel.
+class WorkerPool
+{
+public:
+	// 0 threads is valid, every task then runs on the calling thread
+	WorkerPool(unsigned int p_threadCount);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	// runs p_task(0) ... p_task(p_taskCount - 1), blocks until all returned
+	void Dispatch(unsigned int p_taskCount, const std::function<void(unsigned int)>& p_task);
+
+	unsigned int GetThreadCount() const { return static_cast<unsigned int>(m_threads.size()); }
+
+	// hardware threads minus the calling one, at least 1
+	static unsigned int GetDefaultThreadCount();
+
+private:
+	void _workerLoop();
+	void _runTasks();
+
+	std::vector<std::thread> m_threads;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wakeCondition;
+	std::condition_variable m_doneCondition;
+	uint64_t m_generation = 0; // bumped for every Dispatch, wakes the workers
+	bool m_isQuitting = false;
+
+	// valid while a Dispatch is running
+	const std::function<void(unsigned int)>* m_task_p = nullptr;
+	std::atomic<unsigned int> m_taskCount = 0;
+	// the Dispatch's generation in the high 32 bits, the next task in the low ones; a worker still
+	// running tasks of an earlier Dispatch cannot claim one of the next through a stale value
+	std::atomic<uint64_t> m_nextTask = 0;
+	std::atomic<unsigned int> m_finishedTasks = 0;
+};
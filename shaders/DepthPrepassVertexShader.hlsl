@@ -0,0 +1,14 @@
+#include "FirstPass.hlsli"
+
+// the positions alone, slot 0 of the first pass's vertex streams
+struct DepthPrepassVS_IN
+{
+    float3 Position : POSITION;
+    uint InstanceID : SV_InstanceID;
+};
+
+// no pixel shader follows, the rasterizer only writes depth
+float4 main(DepthPrepassVS_IN DPVS_IN) : SV_Position
+{
+    return ToClipSpace(GetInstance(DPVS_IN.InstanceID), DPVS_IN.Position);
+}
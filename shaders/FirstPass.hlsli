@@ -0,0 +1,50 @@
+// Instance transforms and the clip space position, shared by the passes that draw the scene's meshes:
+// FirstPassVertexShader.hlsl into the G-buffer, DepthPrepassVertexShader.hlsl into the depth buffer alone.
+#ifndef FIRST_PASS_HLSLI
+#define FIRST_PASS_HLSLI
+
+struct InstanceTransforms
+{
+    // Model matrix and transpose of inverse model matrix,
+    // per instance and independent of the camera
+    matrix Model;
+    matrix tiModel;
+};
+
+struct DrawBatch
+{
+    // set per instanced draw, where its instances start in the instance buffer
+    uint FirstInstance;
+};
+
+struct ViewProjection
+{
+    // set once per command list
+    matrix VP;
+};
+
+ConstantBuffer<DrawBatch> DrawBatchCB : register(b0);
+ConstantBuffer<ViewProjection> ViewProjectionCB : register(b1);
+StructuredBuffer<InstanceTransforms> Instances : register(t0, space1); // per frame
+
+InstanceTransforms GetInstance(uint instanceID)
+{
+    return Instances[DrawBatchCB.FirstInstance + instanceID];
+}
+
+// After a depth prepass the G-buffer pass tests for EQUAL depth, so both passes must get the same
+// bits out of here; precise keeps the compiler from fusing or reordering the math differently in each.
+float4 ToClipSpace(InstanceTransforms instance, float3 position)
+{
+    // mul(matrix, vector) will assume the matrix is column-major and vector is column vector
+    // HLSL is default to use column-major to load matrices
+    // When loading MVP matrix into constant buffer, it will write by rows; but HLSL will interpret them
+    // as columns here, which is effectively, transpose.
+    // (MA * MB)^T = MB^T * MA^T
+    // No additional transpose is needed.
+    precise float4 worldPosition = mul(instance.Model, float4(position, 1.0f));
+    precise float4 clipPosition = mul(ViewProjectionCB.VP, worldPosition);
+    return clipPosition;
+}
+
+#endif
@@ -1,19 +1,20 @@
+#include "../include/GBufferEncoding.h"
+
 struct FPPS_IN
 {
     float2 TexCoord : TEXCOORD;
     float3x3 tbnMatrix : TBNMATRIX;
 };
 
+// NOTE: must match BearWindow::FirstPassRTVFormats
 struct FPPS_OUT
 {
-    float4 albedo : SV_TARGET0;
-    float specgloss : SV_TARGET1;
-    float4 normal : SV_TARGET2;
+    float4 albedoSpecular : SV_TARGET0; // rgb: albedo, a: specular
+    float2 normal : SV_TARGET1; // octahedral encoded
 };
 
 Texture2D diffuseTexture : register(t0);
-Texture2D normalTexture : register(t1);
-Texture2D specularTexture : register(t2);
+Texture2D materialTexture : register(t1); // RG: normal XY, B: specular, A: spare
 
 SamplerState Sampler : register(s0);
 
@@ -22,12 +23,13 @@ FPPS_OUT main(FPPS_IN IN)
     FPPS_OUT OUT;
    
     // * is component-wise multiplication, dot is inner product
-    OUT.albedo = diffuseTexture.Sample(Sampler, IN.TexCoord);
-    OUT.specgloss = specularTexture.Sample(Sampler, IN.TexCoord).x;
+    float4 material = materialTexture.Sample(Sampler, IN.TexCoord);
+    OUT.albedoSpecular = float4(diffuseTexture.Sample(Sampler, IN.TexCoord).rgb, material.z);
     
-    float3 n_sample = normalTexture.Sample(Sampler, IN.TexCoord).xyz;
-    n_sample = n_sample * 2.0f - 1.0f;
-    OUT.normal = float4(normalize(mul(IN.tbnMatrix, n_sample)), 0.0f);
+    // tangent-space normals always face +Z, so Z follows from XY
+    float2 n_xy = material.xy * 2.0f - 1.0f;
+    float3 n_sample = float3(n_xy, sqrt(saturate(1.0f - dot(n_xy, n_xy))));
+    OUT.normal = EncodeNormal(normalize(mul(IN.tbnMatrix, n_sample)));
     
     return OUT;
 }
\ No newline at end of file
@@ -1,17 +1,13 @@
-struct ModelViewProjection
-{
-    // Combined Model-View-Projection matrix
-    // and transpose of inverse model matrix
-    matrix MVP;
-    matrix tiModel;
-};
+#include "FirstPass.hlsli"
 
+// positions from slot 0, the rest from slot 1
 struct FirstPassVS_IN
 {
     float3 Position : POSITION;
     float3 Normal : NORMAL;
     float3 Tangent : TANGENT;
     float2 TexCoord : TEXCOORD;
+    uint InstanceID : SV_InstanceID;
 };
 
 struct FirstPassVS_OUT
@@ -21,24 +17,17 @@ struct FirstPassVS_OUT
     float4 Position : SV_Position;
 };
 
-ConstantBuffer<ModelViewProjection> ModelViewProjectionCB : register(b0);
-
-
 FirstPassVS_OUT main(FirstPassVS_IN FPVS_IN)
 {
     FirstPassVS_OUT OUT;
     
+    InstanceTransforms instance = GetInstance(FPVS_IN.InstanceID);
+
     OUT.TexCoord = FPVS_IN.TexCoord;
-    // mul(matrix, vector) will assume the matrix is column-major and vector is column vector
-    // HLSL is default to use column-major to load matrices
-    // When loading MVP matrix into constant buffer, it will write by rows; but HLSL will interpret them
-    // as columns here, which is effectively, transpose.
-    // (MA * MB)^T = MB^T * MA^T
-    // No additional transpose is needed.
-    OUT.Position = mul(ModelViewProjectionCB.MVP, float4(FPVS_IN.Position, 1.0f));
+    OUT.Position = ToClipSpace(instance, FPVS_IN.Position);
     
     // construct tbn matrix
-    float3x3 tiM = (float3x3) ModelViewProjectionCB.tiModel;
+    float3x3 tiM = (float3x3) instance.tiModel;
     
     float3 N = normalize(mul(tiM, FPVS_IN.Normal));
     float3 T = normalize(mul(tiM, FPVS_IN.Tangent));
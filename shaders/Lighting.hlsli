@@ -0,0 +1,217 @@
+// Lights and the lighting equation, shared by the lighting passes:
+// SecondPassPixelShader.hlsl per pixel, TiledLightingComputeShader.hlsl per tile.
+#ifndef LIGHTING_HLSLI
+#define LIGHTING_HLSLI
+
+// NOTE: must match ShadowCascadeCount and ShadowCascades::Resolution in ShadowCascades.h
+#define SHADOW_CASCADE_COUNT 4
+#define SHADOW_MAP_SIZE 2048
+
+struct DirectionalLight
+{
+    float Strength;
+    float3 Direction;
+    
+    float4 Color;
+};
+
+struct PointLight
+{
+    float Strength;
+    float3 Position;
+    
+    float4 Color;
+    
+    float2 Falloff; // start, end
+    float2 Padding;
+};
+
+struct SpotLight
+{
+    float Strength;
+    float3 Position;
+    
+    float4 Color;
+    
+    float3 Direction;
+    float SpotPower;
+    
+    float2 Falloff; // start, end
+    
+    float2 Padding;
+};
+
+// NOTE: must match LightConstants in Helpers.h
+struct LightConstants
+{
+    float4 CameraPosition;
+    float4 AmbientLightColor;
+    float AmbientLightStrength;
+    uint NumOfDirectionalLights;
+    uint NumOfPointLights;
+    uint NumOfSpotLights;
+    
+    // clustered lighting, see LightClusterer
+    matrix ViewMatrix;
+    uint ClusterCountX;
+    uint ClusterCountY;
+    uint ClusterCountZ;
+    float DepthSliceScale;
+    float DepthSliceBias;
+    float3 Padding;
+    
+    // cascaded shadow maps of the first directional light, see ShadowCascades
+    matrix ShadowViewProjection[SHADOW_CASCADE_COUNT];
+    float4 ShadowSplitDepths;
+    float4 ShadowTexelSizes;
+    uint NumOfShadowCascades;
+    float3 ShadowPadding;
+};
+
+struct SecondPassRootConstants
+{
+    matrix invSPV; // screen * inv(P) * inv(V)
+};
+
+// Move light calculations to vertex shader for performance optimization
+float CalcAttenuation(float d, float2 falloff)
+{
+    // Linear falloff.
+    return saturate((falloff.y - d) / (falloff.y - falloff.x));
+}
+
+float3 BlinnPhong(float3 lightStrength, float3 lightVec, float3 normal, float3 toEye, float4 materialVec)
+{
+    
+    const float m = (1.0f - materialVec.w) * 256.0f;
+    float3 halfVec = normalize(toEye + lightVec);
+
+    float roughnessFactor = (m + 8.0f) * pow(max(dot(halfVec, normal), 0.0f), m) / 8.0f;
+
+    // Our spec formula goes outside [0,1] range, but we are 
+    // doing LDR rendering.  So scale it down a bit.
+    roughnessFactor = roughnessFactor / (roughnessFactor + 1.0f);
+
+    return (materialVec.rgb + roughnessFactor) * lightStrength;
+}
+
+//---------------------------------------------------------------------------------------
+// Evaluates the lighting equation for directional lights.
+//---------------------------------------------------------------------------------------
+float3 ComputeDirectionalLight(DirectionalLight L, float3 normal, float3 toEye, float4 materialVec)
+{
+    // The light vector aims opposite the direction the light rays travel.
+    float3 lightVec = normalize(-L.Direction);
+
+    // Scale light down by Lambert's cosine law.
+    float ndotl = max(dot(lightVec, normal), 0.0f);
+    float3 lightStrength = L.Strength * ndotl;
+
+    return BlinnPhong(lightStrength, lightVec, normal, toEye, materialVec) * L.Color.rgb;
+}
+
+//---------------------------------------------------------------------------------------
+// How much of the first directional light reaches pos, 0 to 1, from the cascade its view depth falls in.
+// shadowMaps holds one slice per cascade, shadowSampler compares with LESS_EQUAL and filters bilinearly;
+// the rest comes from the shadow fields of LightConstants.
+//---------------------------------------------------------------------------------------
+float ComputeShadowFactor(Texture2DArray shadowMaps, SamplerComparisonState shadowSampler,
+                          matrix shadowViewProjection[SHADOW_CASCADE_COUNT], float4 splitDepths, float4 texelSizes,
+                          uint cascadeCount, float3 pos, float3 normal, float viewDepth)
+{
+    if (cascadeCount == 0 || viewDepth > splitDepths[cascadeCount - 1])
+    {
+        return 1.0f;
+    }
+
+    uint cascade = 0;
+    [unroll]
+    for (uint i = 0; i < SHADOW_CASCADE_COUNT - 1; i++)
+    {
+        cascade += viewDepth > splitDepths[i] ? 1 : 0;
+    }
+
+    // pushed off the surface by a texel or so, against acne where the light grazes it
+    float3 offsetPos = pos + normal * (texelSizes[cascade] * 1.5f);
+    float4 shadowPos = mul(shadowViewProjection[cascade], float4(offsetPos, 1.0f));
+    float2 uv = shadowPos.xy * float2(0.5f, -0.5f) + 0.5f;
+
+    // 3x3 taps, each one bilinear in the comparison sampler
+    float lit = 0.0f;
+    [unroll]
+    for (int y = -1; y <= 1; y++)
+    {
+        [unroll]
+        for (int x = -1; x <= 1; x++)
+        {
+            float2 tapUv = uv + float2(x, y) / SHADOW_MAP_SIZE;
+            lit += shadowMaps.SampleCmpLevelZero(shadowSampler, float3(tapUv, cascade), shadowPos.z);
+        }
+    }
+    return lit / 9.0f;
+}
+
+//---------------------------------------------------------------------------------------
+// Evaluates the lighting equation for point lights.
+//---------------------------------------------------------------------------------------
+float3 ComputePointLight(PointLight L, float3 pos, float3 normal, float3 toEye, float4 materialVec)
+{
+    // The vector from the surface to the light.
+    float3 lightVec = L.Position - pos;
+
+    // The distance from surface to light.
+    float d = length(lightVec);
+
+    // Range test.
+    if (d > L.Falloff.y)
+        return 0.0f;
+
+    // Normalize the light vector.
+    lightVec /= d;
+
+    // Scale light down by Lambert's cosine law.
+    float ndotl = max(dot(lightVec, normal), 0.0f);
+    float3 lightStrength = L.Strength * ndotl;
+
+    // Attenuate light by distance.
+    float att = CalcAttenuation(d, L.Falloff);
+    lightStrength *= att;
+
+    return BlinnPhong(lightStrength, lightVec, normal, toEye, materialVec) * L.Color.rgb;
+}
+
+//---------------------------------------------------------------------------------------
+// Evaluates the lighting equation for spot lights.
+//---------------------------------------------------------------------------------------
+float3 ComputeSpotLight(SpotLight L, float3 pos, float3 normal, float3 toEye, float4 materialVec)
+{
+    // The vector from the surface to the light.
+    float3 lightVec = L.Position - pos;
+
+    // The distance from surface to light.
+    float d = length(lightVec);
+
+    // Range test.
+    if (d > L.Falloff.y)
+        return 0.0f;
+
+    // Normalize the light vector.
+    lightVec /= d;
+
+    // Scale light down by Lambert's cosine law.
+    float ndotl = max(dot(lightVec, normal), 0.0f);
+    float3 lightStrength = L.Strength * ndotl;
+
+    // Attenuate light by distance.
+    float att = CalcAttenuation(d, L.Falloff);
+    lightStrength *= att;
+
+    // Scale by spotlight
+    float3 lightDirection = normalize(L.Direction);
+    float spotFactor = pow(max(dot(-lightVec, lightDirection), 0.0f), L.SpotPower);
+    lightStrength *= spotFactor;
+
+    return BlinnPhong(lightStrength, lightVec, normal, toEye, materialVec) * L.Color.rgb;
+}
+
+#endif // LIGHTING_HLSLI
@@ -1,191 +1,74 @@
-#define MAX_LIGHTS 16
+#include "../include/GBufferEncoding.h"
+#include "Lighting.hlsli"
 
 struct FPPS_IN
 {
     float2 TexCoord : TEXCOORD;
 };
 
-struct DirectionalLight
+// NOTE: must match LightCluster in LightClusterer.h
+struct LightCluster
 {
-    float Strength;
-    float3 Direction;
-    
-    float4 Color;
-};
-
-struct PointLight
-{
-    float Strength;
-    float3 Position;
-    
-    float4 Color;
-    
-    float2 Falloff; // start, end
-    float2 Padding;
-};
-
-struct SpotLight
-{
-    float Strength;
-    float3 Position;
-    
-    float4 Color;
-    
-    float3 Direction;
-    float SpotPower;
-    
-    float2 Falloff; // start, end
-    
-    float2 Padding;
-};
-
-struct LightConstants
-{
-    float4 CameraPosition;
-    float4 AmbientLightColor;
-    float AmbientLightStrength;
-    uint NumOfDirectionalLights;
-    uint NumOfPointLights;
-    uint NumOfSpotLights;
-    
-    DirectionalLight DirectionalLights[MAX_LIGHTS];
-    PointLight PointLights[MAX_LIGHTS];
-    SpotLight SpotLights[MAX_LIGHTS];
-};
-
-struct SecondPassRootConstants
-{
-    matrix invSPV; // screen * inv(P) * inv(V)
+    uint Offset; // into LightIndices
+    uint Count;
 };
 
 ConstantBuffer<LightConstants> LightCB : register(b0);
 ConstantBuffer<SecondPassRootConstants> SPRC : register(b1);
 
-Texture2D gAlbedoTexture : register(t0);
-Texture2D gSpecularTexture : register(t1);
-Texture2D gNormalTexture : register(t2);
+// G-buffer, see GBufferEncoding.h
+Texture2D gAlbedoSpecularTexture : register(t0);
+Texture2D gNormalTexture : register(t1);
 Texture2D gDepth : register(t3);
 
-SamplerState Sampler : register(s0);
-
-// Move light calculations to vertex shader for performance optimization
-float CalcAttenuation(float d, float2 falloff)
-{
-    // Linear falloff.
-    return saturate((falloff.y - d) / (falloff.y - falloff.x));
-}
-
-float3 BlinnPhong(float3 lightStrength, float3 lightVec, float3 normal, float3 toEye, float4 materialVec)
-{
-    
-    const float m = (1.0f - materialVec.w) * 256.0f;
-    float3 halfVec = normalize(toEye + lightVec);
-
-    float roughnessFactor = (m + 8.0f) * pow(max(dot(halfVec, normal), 0.0f), m) / 8.0f;
+// no fixed number of lights; point and spot lights are only read through the pixel's cluster,
+// whose indices count the point lights first and the spot lights after them
+StructuredBuffer<DirectionalLight> DirectionalLights : register(t4);
+StructuredBuffer<PointLight> PointLights : register(t5);
+StructuredBuffer<SpotLight> SpotLights : register(t6);
+StructuredBuffer<LightCluster> LightClusters : register(t7);
+StructuredBuffer<uint> LightIndices : register(t8);
 
-    // Our spec formula goes outside [0,1] range, but we are 
-    // doing LDR rendering.  So scale it down a bit.
-    roughnessFactor = roughnessFactor / (roughnessFactor + 1.0f);
+// one slice per shadow cascade of the first directional light
+Texture2DArray ShadowMaps : register(t9);
 
-    return (materialVec.rgb + roughnessFactor) * lightStrength;
-}
-
-//---------------------------------------------------------------------------------------
-// Evaluates the lighting equation for directional lights.
-//---------------------------------------------------------------------------------------
-float3 ComputeDirectionalLight(DirectionalLight L, float3 normal, float3 toEye, float4 materialVec)
-{
-    // The light vector aims opposite the direction the light rays travel.
-    float3 lightVec = normalize(-L.Direction);
-
-    // Scale light down by Lambert's cosine law.
-    float ndotl = max(dot(lightVec, normal), 0.0f);
-    float3 lightStrength = L.Strength * ndotl;
-
-    return BlinnPhong(lightStrength, lightVec, normal, toEye, materialVec) * L.Color.rgb;
-}
-
-//---------------------------------------------------------------------------------------
-// Evaluates the lighting equation for point lights.
-//---------------------------------------------------------------------------------------
-float3 ComputePointLight(PointLight L, float3 pos, float3 normal, float3 toEye, float4 materialVec)
-{
-    // The vector from the surface to the light.
-    float3 lightVec = L.Position - pos;
-
-    // The distance from surface to light.
-    float d = length(lightVec);
-
-    // Range test.
-    if (d > L.Falloff.y)
-        return 0.0f;
-
-    // Normalize the light vector.
-    lightVec /= d;
-
-    // Scale light down by Lambert's cosine law.
-    float ndotl = max(dot(lightVec, normal), 0.0f);
-    float3 lightStrength = L.Strength * ndotl;
-
-    // Attenuate light by distance.
-    float att = CalcAttenuation(d, L.Falloff);
-    lightStrength *= att;
-
-    return BlinnPhong(lightStrength, lightVec, normal, toEye, materialVec) * L.Color.rgb;
-}
+SamplerState Sampler : register(s0);
+SamplerComparisonState ShadowSampler : register(s1);
 
-//---------------------------------------------------------------------------------------
-// Evaluates the lighting equation for spot lights.
-//---------------------------------------------------------------------------------------
-float3 ComputeSpotLight(SpotLight L, float3 pos, float3 normal, float3 toEye, float4 materialVec)
+uint FindCluster(float2 texCoord, float viewDepth)
 {
-    // The vector from the surface to the light.
-    float3 lightVec = L.Position - pos;
-
-    // The distance from surface to light.
-    float d = length(lightVec);
-
-    // Range test.
-    if (d > L.Falloff.y)
-        return 0.0f;
-
-    // Normalize the light vector.
-    lightVec /= d;
-
-    // Scale light down by Lambert's cosine law.
-    float ndotl = max(dot(lightVec, normal), 0.0f);
-    float3 lightStrength = L.Strength * ndotl;
-
-    // Attenuate light by distance.
-    float att = CalcAttenuation(d, L.Falloff);
-    lightStrength *= att;
-
-    // Scale by spotlight
-    float3 lightDirection = normalize(L.Direction);
-    float spotFactor = pow(max(dot(-lightVec, lightDirection), 0.0f), L.SpotPower);
-    lightStrength *= spotFactor;
-
-    return BlinnPhong(lightStrength, lightVec, normal, toEye, materialVec) * L.Color.rgb;
+    // tiles count from the top left of the screen like the texture coordinates, slices from the near plane
+    uint x = min(uint(texCoord.x * LightCB.ClusterCountX), LightCB.ClusterCountX - 1);
+    uint y = min(uint(texCoord.y * LightCB.ClusterCountY), LightCB.ClusterCountY - 1);
+    viewDepth = max(viewDepth, 1e-6f);
+    uint z = uint(clamp(floor(log(viewDepth) * LightCB.DepthSliceScale + LightCB.DepthSliceBias), 0.0f, float(LightCB.ClusterCountZ - 1)));
+    
+    return (z * LightCB.ClusterCountY + y) * LightCB.ClusterCountX + x;
 }
 
 float4 ComputeLighting(float3 pos, float4 materialVec, float3 normal, float3 toEye,
-                       float3 shadowFactor)
+                       float3 shadowFactor, uint clusterIndex)
 {
     float3 result = 0.0f;
     
     for (uint i = 0; i < LightCB.NumOfDirectionalLights; i++)
     {
-        result += shadowFactor[i] * ComputeDirectionalLight(LightCB.DirectionalLights[i], normal, toEye, materialVec);
+        // only the first directional light has shadow maps
+        result += (i == 0 ? shadowFactor[0] : 1.0f) * ComputeDirectionalLight(DirectionalLights[i], normal, toEye, materialVec);
     }
     
-    for (uint i = 0; i < LightCB.NumOfPointLights; i++)
+    LightCluster cluster = LightClusters[clusterIndex];
+    for (uint j = 0; j < cluster.Count; j++)
     {
-        result += shadowFactor[i] * ComputePointLight(LightCB.PointLights[i], pos, normal, toEye, materialVec);
-    }
-    
-    for (uint i = 0; i < LightCB.NumOfSpotLights; i++)
-    {
-        result += shadowFactor[i] * ComputeSpotLight(LightCB.SpotLights[i], pos, normal, toEye, materialVec);
+        uint lightIndex = LightIndices[cluster.Offset + j];
+        if (lightIndex < LightCB.NumOfPointLights)
+        {
+            result += shadowFactor[1] * ComputePointLight(PointLights[lightIndex], pos, normal, toEye, materialVec);
+        }
+        else
+        {
+            result += shadowFactor[2] * ComputeSpotLight(SpotLights[lightIndex - LightCB.NumOfPointLights], pos, normal, toEye, materialVec);
+        }
     }
 
     return float4(result, 0.0f);
@@ -194,7 +77,8 @@ float4 ComputeLighting(float3 pos, float4 materialVec, float3 normal, float3 toE
 
 float4 main(FPPS_IN IN) : SV_TARGET
 {
-    float4 albedo = gAlbedoTexture.Sample(Sampler, IN.TexCoord); // final color
+    float4 albedoSpecular = gAlbedoSpecularTexture.Sample(Sampler, IN.TexCoord);
+    float4 albedo = float4(albedoSpecular.rgb, 1.0f); // final color
     
     // reconstruct world position from depth
     float z = gDepth.Sample(Sampler, IN.TexCoord).x;
@@ -202,12 +86,11 @@ float4 main(FPPS_IN IN) : SV_TARGET
     float4 worldPosition = mul(SPRC.invSPV, projectedPosition);
     worldPosition /= worldPosition.w;
     
-    // normal mapping
-    // the texture has value of [0, 1] and now it has to converted to [-1, 1]
-    float3 normal = normalize(gNormalTexture.Sample(Sampler, IN.TexCoord).xyz * 2.0f - 1.0f);
+    // world space normal, stored octahedral encoded
+    float3 normal = DecodeNormal(gNormalTexture.Sample(Sampler, IN.TexCoord).xy);
     
     // specular value
-    float specular = gSpecularTexture.Sample(Sampler, IN.TexCoord).x;
+    float specular = albedoSpecular.a;
     
     float3 toEye = normalize(LightCB.CameraPosition.xyz - worldPosition.xyz);
     
@@ -216,11 +99,16 @@ float4 main(FPPS_IN IN) : SV_TARGET
     // rgb/xyz is diffuse albedo, w/a is specular
     float4 materialVec = float4(albedo.xyz, specular);
     
+    float viewDepth = mul(LightCB.ViewMatrix, float4(worldPosition.xyz, 1.0f)).z;
+    float shadow = ComputeShadowFactor(ShadowMaps, ShadowSampler, LightCB.ShadowViewProjection, LightCB.ShadowSplitDepths,
+                                       LightCB.ShadowTexelSizes, LightCB.NumOfShadowCascades, worldPosition.xyz, normal, viewDepth);
+    
     float4 lighting = ComputeLighting(worldPosition.xyz,
                                       materialVec,
                                       normal,
                                       toEye,
-                                      float3(1.0f, 1.0f, 1.0f)); // No shadows for now
+                                      float3(shadow, 1.0f, 1.0f), // point and spot lights cast no shadows
+                                      FindCluster(IN.TexCoord, viewDepth));
     
     float4 LightColor = (lighting + ambientLight) * albedo;
     
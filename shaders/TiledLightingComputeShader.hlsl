@@ -0,0 +1,170 @@
+#include "../include/GBufferEncoding.h"
+#include "Lighting.hlsli"
+
+// NOTE: must match TiledLightingTileSize in FrameRecording.h
+#define TILE_SIZE 16
+#define TILE_THREADS (TILE_SIZE * TILE_SIZE)
+// lights past this many in one tile are dropped
+#define MAX_TILE_LIGHTS 512
+
+ConstantBuffer<LightConstants> LightCB : register(b0);
+ConstantBuffer<SecondPassRootConstants> SPRC : register(b1);
+
+// G-buffer, see GBufferEncoding.h
+Texture2D gAlbedoSpecularTexture : register(t0);
+Texture2D gNormalTexture : register(t1);
+Texture2D gDepth : register(t3);
+
+StructuredBuffer<DirectionalLight> DirectionalLights : register(t4);
+StructuredBuffer<PointLight> PointLights : register(t5);
+StructuredBuffer<SpotLight> SpotLights : register(t6);
+
+// one slice per shadow cascade of the first directional light
+Texture2DArray ShadowMaps : register(t9);
+SamplerComparisonState ShadowSampler : register(s1);
+
+RWTexture2D<float4> gOutput : register(u0);
+
+// depths as uint so they can be compared atomically; positive floats order like their bits
+groupshared uint TileMinDepth;
+groupshared uint TileMaxDepth;
+// point lights first, spot lights after them, like the cluster indices of the pixel shader
+groupshared uint TileLightCount;
+groupshared uint TileLightIndices[MAX_TILE_LIGHTS];
+
+float3 ToWorld(float2 texCoord, float z)
+{
+    float4 worldPosition = mul(SPRC.invSPV, float4(texCoord, z, 1.0f));
+    return worldPosition.xyz / worldPosition.w;
+}
+
+float3 ToView(float3 pos)
+{
+    return mul(LightCB.ViewMatrix, float4(pos, 1.0f)).xyz;
+}
+
+bool SphereIntersectsBox(float3 center, float radius, float3 boxMin, float3 boxMax)
+{
+    float3 closest = clamp(center, boxMin, boxMax);
+    float3 d = center - closest;
+    return dot(d, d) <= radius * radius;
+}
+
+[numthreads(TILE_SIZE, TILE_SIZE, 1)]
+void main(uint3 groupId : SV_GroupID, uint3 dispatchThreadId : SV_DispatchThreadID, uint groupIndex : SV_GroupIndex)
+{
+    uint width, height;
+    gDepth.GetDimensions(width, height);
+
+    // threads past the edge of the screen still take part in the culling, on the last pixel
+    uint2 pixel = min(dispatchThreadId.xy, uint2(width - 1, height - 1));
+    bool isInside = all(dispatchThreadId.xy < uint2(width, height));
+    float z = gDepth.Load(int3(pixel, 0)).x;
+
+    if (groupIndex == 0)
+    {
+        TileMinDepth = asuint(1.0f);
+        TileMaxDepth = 0;
+        TileLightCount = 0;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    // the cleared depth is the background, which no point or spot light reaches
+    if (z < 1.0f)
+    {
+        InterlockedMin(TileMinDepth, asuint(z));
+        InterlockedMax(TileMaxDepth, asuint(z));
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    float minDepth = asfloat(TileMinDepth);
+    float maxDepth = asfloat(TileMaxDepth);
+
+    if (minDepth <= maxDepth)
+    {
+        // view space box around the tile's frustum between its depth bounds
+        float2 tileMin = float2(groupId.xy * TILE_SIZE) / float2(width, height);
+        float2 tileMax = float2((groupId.xy + 1) * TILE_SIZE) / float2(width, height);
+
+        float3 boxMin = float3(1e30f, 1e30f, 1e30f);
+        float3 boxMax = -boxMin;
+        for (uint corner = 0; corner < 8; corner++)
+        {
+            float2 texCoord = float2((corner & 1) ? tileMax.x : tileMin.x, (corner & 2) ? tileMax.y : tileMin.y);
+            float3 viewCorner = ToView(ToWorld(texCoord, (corner & 4) ? maxDepth : minDepth));
+            boxMin = min(boxMin, viewCorner);
+            boxMax = max(boxMax, viewCorner);
+        }
+
+        uint lightCount = LightCB.NumOfPointLights + LightCB.NumOfSpotLights;
+        for (uint i = groupIndex; i < lightCount; i += TILE_THREADS)
+        {
+            float3 position;
+            float radius;
+            if (i < LightCB.NumOfPointLights)
+            {
+                position = PointLights[i].Position;
+                radius = PointLights[i].Falloff.y;
+            }
+            else
+            {
+                position = SpotLights[i - LightCB.NumOfPointLights].Position;
+                radius = SpotLights[i - LightCB.NumOfPointLights].Falloff.y;
+            }
+
+            if (SphereIntersectsBox(ToView(position), radius, boxMin, boxMax))
+            {
+                uint slot;
+                InterlockedAdd(TileLightCount, 1, slot);
+                if (slot < MAX_TILE_LIGHTS)
+                {
+                    TileLightIndices[slot] = i;
+                }
+            }
+        }
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    if (!isInside)
+    {
+        return;
+    }
+
+    // the same shading as SecondPassPixelShader, with the tile's lights instead of the cluster's
+    float4 albedoSpecular = gAlbedoSpecularTexture.Load(int3(pixel, 0));
+    float4 albedo = float4(albedoSpecular.rgb, 1.0f);
+
+    float2 texCoord = (float2(pixel) + 0.5f) / float2(width, height);
+    float3 pos = ToWorld(texCoord, z);
+    float3 normal = DecodeNormal(gNormalTexture.Load(int3(pixel, 0)).xy);
+    float3 toEye = normalize(LightCB.CameraPosition.xyz - pos);
+
+    float4 ambientLight = LightCB.AmbientLightStrength * LightCB.AmbientLightColor * dot(normal, normal);
+    float4 materialVec = float4(albedo.xyz, albedoSpecular.a);
+
+    // only the first directional light has shadow maps
+    float shadow = ComputeShadowFactor(ShadowMaps, ShadowSampler, LightCB.ShadowViewProjection, LightCB.ShadowSplitDepths,
+                                       LightCB.ShadowTexelSizes, LightCB.NumOfShadowCascades, pos, normal, ToView(pos).z);
+
+    float3 lighting = 0.0f;
+    for (uint j = 0; j < LightCB.NumOfDirectionalLights; j++)
+    {
+        lighting += (j == 0 ? shadow : 1.0f) * ComputeDirectionalLight(DirectionalLights[j], normal, toEye, materialVec);
+    }
+
+    uint tileLightCount = min(TileLightCount, MAX_TILE_LIGHTS);
+    for (uint k = 0; k < tileLightCount; k++)
+    {
+        uint lightIndex = TileLightIndices[k];
+        if (lightIndex < LightCB.NumOfPointLights)
+        {
+            lighting += ComputePointLight(PointLights[lightIndex], pos, normal, toEye, materialVec);
+        }
+        else
+        {
+            lighting += ComputeSpotLight(SpotLights[lightIndex - LightCB.NumOfPointLights], pos, normal, toEye, materialVec);
+        }
+    }
+
+    gOutput[pixel] = (float4(lighting, 0.0f) + ambientLight) * albedo;
+}
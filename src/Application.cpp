@@ -4,9 +4,13 @@
 #include <UIManager.h>
 #include <MeshManager.h>
 #include <MessageQueue.h>
+#include <MemoryTracker.h>
+#include <Profiler.h>
+#include <SessionRecorder.h>
 
 #include <CommandQueue.h>
 
+#include <algorithm>
 #include <string>
 #include <fstream>
 
@@ -36,6 +40,8 @@ Application::Application(HINSTANCE hInst)
 	m_dpiScale = static_cast<float>(m_dpi) / 96.0f;
 
 	m_frameTimeInSeconds = 1.0 / static_cast<double>(std::min<int>(GetDeviceCaps(desktopDc, VREFRESH), 60));
+	m_framePacer_p = new FramePacer(CreateDefaultFrameWaitBackend(), m_frameTimeInSeconds);
+	m_cullingPool_p = new WorkerPool(WorkerPool::GetDefaultThreadCount());
 
 #if defined(_DEBUG)
 	// Always enable the debug layer before doing anything DX12 related
@@ -84,6 +90,8 @@ Application::Application(HINSTANCE hInst)
 		m_srvHeap = CreateDescriptorHeap(MAX_SIZE_IN_SRV_HEAP, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE);
 		sizeOfSrvHeapOffset = GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
+		MemoryTracker::Get().Initialize(m_d3d12Device, m_dxgiAdapter);
+
 		InitializeJoltPhysics();
 	}
 }
@@ -116,7 +124,11 @@ void Application::Destroy()
 
 Application::~Application()
 {
+	delete m_renderThread_p;
 	Flush();
+
+	delete m_framePacer_p;
+	delete m_cullingPool_p;
 }
 
 Microsoft::WRL::ComPtr<IDXGIAdapter4> Application::GetAdapter(bool bUseWarp)
@@ -303,6 +315,10 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM l
 		{
 		case WM_PAINT:
 		{
+			// validate, otherwise Windows keeps sending WM_PAINT and the loop spins again;
+			// the window loop invalidates the window whenever the next frame is due
+			ValidateRect(hwnd, nullptr);
+
 			float frameTime = 0.0f;
 			Application& app = Application::Get();
 			if (app.Tick(frameTime))
@@ -326,15 +342,21 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM l
 
 			int width = ((int)(short)LOWORD(lParam));
 			int height = ((int)(short)HIWORD(lParam));
-			gs_activeWindow->OnResize(width, height);
+			Application::Get().RunWhileRenderIdle([width, height]()
+				{
+					gs_activeWindow->OnResize(width, height);
+				});
 		}
 		break;
 		case WM_DESTROY:
 		{
 			// If a window is being destroyed, remove it from the
 			// window maps.
-			gs_activeWindow->Destroy();
-			gs_activeWindow = nullptr;
+			Application::Get().RunWhileRenderIdle([]()
+				{
+					gs_activeWindow->Destroy();
+					gs_activeWindow = nullptr;
+				});
 			PostQuitMessage(0);
 		}
 		break;
@@ -397,6 +419,7 @@ D3D12_GPU_DESCRIPTOR_HANDLE Application::GetSRVHeapGPUHandle(unsigned int offset
 int Application::RunWithBearWindow(const std::wstring& p_windowName, int p_width, int p_height)
 {
 	// This assumes Create() has successfully completed and the application singleton has been created.
+	BEAR_PROFILE_THREAD("Game");
 
 	auto device = GetDevice();
 	auto commandQueue = GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT)->GetD3D12CommandQueue();
@@ -423,10 +446,15 @@ int Application::RunWithBearWindow(const std::wstring& p_windowName, int p_width
 	UIManager::Get().StartListeningThread();
 	MeshManager::Get().StartListeningThread();
 
+	// everything the renderer needs exists now
+	m_renderThread_p = new RenderThread(m_renderer_p, m_framePacer_p);
+
 	gs_activeWindow = m_mainWindow;
-	m_windowClock.Reset();
+	m_framePacer_p->Reset();
 
 	// Window loop
+	// Messages are handled as they arrive; in between, the pacer sleeps until the next frame.
+	// Rendering stays in WM_PAINT, so it also runs inside modal size/move loops.
 	MSG msg = { 0 };
 	while (msg.message != WM_QUIT)
 	{
@@ -434,9 +462,40 @@ int Application::RunWithBearWindow(const std::wstring& p_windowName, int p_width
 		{
 			TranslateMessage(&msg);
 			DispatchMessage(&msg);
+			continue;
+		}
+
+		if (gs_activeWindow == nullptr)
+		{
+			WaitMessage();
+		}
+		else if (m_framePacer_p->WaitForNextFrame())
+		{
+			HWND hwnd = gs_activeWindow->GetHWND();
+			if (IsIconic(hwnd) || !IsWindowVisible(hwnd))
+			{
+				// no WM_PAINT will come, skip the frame instead of waking up again right away
+				m_framePacer_p->BeginFrame();
+			}
+			else
+			{
+				InvalidateRect(hwnd, nullptr, FALSE);
+			}
 		}
 	}
 
+	// a session still running is cut off at the last frame
+	SessionRecorder& sessionRecorder = SessionRecorder::Get();
+	if (sessionRecorder.IsRecording())
+	{
+		sessionRecorder.StopRecording();
+	}
+	sessionRecorder.StopReplay();
+
+	// finish the frame in progress, nothing is recorded after this
+	delete m_renderThread_p;
+	m_renderThread_p = nullptr;
+
 	// Flush any commands in the commands queues before quiting.
 	Flush();
 
@@ -448,66 +507,35 @@ int Application::RunWithBearWindow(const std::wstring& p_windowName, int p_width
 
 void Application::RenderBearWindow(std::shared_ptr<BearWindow> window)
 {
+	BEAR_PROFILE_FUNCTION();
+
 	static UIManager& uiManager = UIManager::Get();
 	static MeshManager& meshManager = MeshManager::Get();
 
+	MemoryTracker::Get().Update();
+
 	if (m_gameState == GameState::DemoRunning)
 	{
-		// new location of cam/player
-		m_gameClock.Tick();
-		double totalSeconds = m_gameClock.GetTotalSeconds();
-		double currentSection = std::floor(totalSeconds / m_sectionTimeInSeconds);
-		float currentT = static_cast<float>(totalSeconds / m_sectionTimeInSeconds - currentSection);
-		float oneMinusT = 1.0f - currentT;
-
-		XMVECTOR newPosition = XMVectorZero();
-
-		if (currentSection > m_numOfCurveSections)
+		// simulate in fixed steps, independent of the frame rate
+		unsigned int stepCount = m_simulationTimestep.Advance(m_lastFrameSeconds);
+		for (unsigned int i = 0; i < stepCount; i++)
 		{
-			// game should end
-			SetGameState(GameState::DemoWin);
-			return;
+			m_previousSimulationState = m_currentSimulationState;
+			if (!_stepSimulation(*window, static_cast<float>(m_simulationTimestep.GetStepSeconds())))
+			{
+				// game should end
+				SetGameState(GameState::DemoWin);
+				return;
+			}
 		}
-		else
-		{
-			const XMVECTOR& p1 = m_bezierCurvePoints[static_cast<size_t>(currentSection) * 2];
-			const XMVECTOR& p2 = m_bezierCurvePoints[static_cast<size_t>(currentSection) * 2 + 1];
 
-			static XMVECTOR sectionEnd = XMVectorSet(10.0f, 0.0f, 10.0f, 1.0f);
-
-			newPosition = 
-				// starting point is always (0, 0, 0), so we can skip that part
-				3.0f * std::powf(oneMinusT, 2.0f) * currentT * p1 +
-				3.0f * oneMinusT * std::powf(currentT, 2.0f) * p2 +
-				std::powf(currentT, 3.0f) * sectionEnd +
-				sectionEnd * static_cast<float>(currentSection);
-
-			newPosition.m128_f32[3] = 1.0f; // make sure w is 1 for correct transformation
-			
-			// calculate Y posotion
-			float deltaSecond = (float)m_gameClock.GetDeltaSeconds();
-			//float yPosition
-			float yPos = window->HandleYPosition(deltaSecond);
-			newPosition.m128_f32[1] = yPos;
-
-			window->SetCameraLocation(newPosition);
-		}
+		// render between the last two simulated states
+		XMVECTOR renderPosition = XMVectorLerp(m_previousSimulationState.playerPosition,
+			m_currentSimulationState.playerPosition, static_cast<float>(m_simulationTimestep.GetAlpha()));
+		window->SetCameraLocation(renderPosition);
 
 		static BodyInterface& bodyInterface = m_physicsSystem.GetBodyInterface();
 
-		// TODO: update camera/player location and handle collision
-		//static float constantDeltaTime = 1.0f / 60.0f;
-	    //m_physicsSystem.Update(constantDeltaTime, 1, m_tempAllocator_p, m_jobSystem_p);
-
-		//bodyInterface.SetPosition(m_camPlayerBodyId, JPH::Vec3(newPosition.m128_f32[0], 0.0f, newPosition.m128_f32[2]), EActivation::Activate);
-		const JPH::BroadPhaseQuery& broadPhaseQuery = m_physicsSystem.GetBroadPhaseQuery();
-		broadPhaseQuery.CollideSphere(
-			JPH::Vec3(newPosition.m128_f32[0], newPosition.m128_f32[1], newPosition.m128_f32[2]),
-			0.5f,
-			m_sphereCollisionCollector,
-			m_broadPhaseLayerFilter,
-			m_defaultObjectLayerFilter);
-
 		// update physics
 		JPH::Vec3 raycastStart;
 		JPH::Vec3 raycastDirection;
@@ -542,7 +570,429 @@ void Application::RenderBearWindow(std::shared_ptr<BearWindow> window)
 		}
 	}
 
-	m_renderer_p->Render(*window);
+	// recorded and presented on the render thread, while this thread goes on with the next frame
+	FramePacket& packet = m_renderThread_p->BeginPacket();
+	_buildFramePacket(window, packet);
+	m_renderThread_p->PublishPacket();
+}
+
+void Application::RunWhileRenderIdle(const std::function<void()>& p_function)
+{
+	if (m_renderThread_p != nullptr)
+	{
+		m_renderThread_p->RunWhileIdle(p_function);
+	}
+	else
+	{
+		p_function();
+	}
+}
+
+void Application::_buildFramePacket(std::shared_ptr<BearWindow> p_window, FramePacket& out_packet)
+{
+	BEAR_PROFILE_FUNCTION();
+
+	out_packet.window = p_window;
+	out_packet.gameState = m_gameState;
+	out_packet.frameNumber = m_gameFrameNumber++;
+	p_window->GetCameraMatrices(out_packet.vpMatrix, out_packet.invPVMatrix);
+
+	// Get entity list, on copy
+	std::vector<Instance*> instanceList = MeshManager::Get().GetInstanceList();
+
+	// every instance, the editor picks from the tree as well
+	m_sceneBvh.Sync(instanceList);
+
+	if (m_gameState != GameState::EditorScene &&
+		m_gameState != GameState::DemoRunning)
+	{
+		instanceList.clear(); // only render instances in editor scene and demo running state
+	}
+
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, out_packet.vpMatrix);
+	const FrustumPlanes frustumPlanes = FrustumCuller::ExtractPlanes(&viewProjection.m[0][0]);
+
+	// cull against the frustum the packet is rendered with, the boxes are kept up to date by the instances
+	m_visibleInstances.clear();
+	if (m_isBvhCullingEnabled)
+	{
+		if (!instanceList.empty())
+		{
+			m_sceneBvh.CullFrustum(frustumPlanes, m_visibleInstances);
+		}
+	}
+	else
+	{
+		// slot i holds instance i of the list; only boxes of moved or replaced instances are copied again
+		m_frustumCuller.Resize(instanceList.size());
+		m_frustumSlots.resize(instanceList.size());
+		for (size_t i = 0; i < instanceList.size(); i++)
+		{
+			const Instance* instance_p = instanceList[i];
+			FrustumSlot& slot = m_frustumSlots[i];
+			if (slot.instance_p != instance_p || slot.revision != instance_p->GetRevision())
+			{
+				m_frustumCuller.SetBounds(i, instance_p->GetWorldBounds());
+				slot.instance_p = instance_p;
+				slot.revision = instance_p->GetRevision();
+			}
+		}
+
+		m_frustumCuller.Cull(frustumPlanes, m_cullingPool_p);
+
+		for (size_t i = 0; i < instanceList.size(); i++)
+		{
+			if (m_frustumCuller.IsVisible(i))
+			{
+				m_visibleInstances.push_back(instanceList[i]);
+			}
+		}
+	}
+
+	// bundles draw whole cells, occluded members included, so the test would save nothing
+	const bool isBundleCaching = m_renderer_p->IsBundleCachingEnabled();
+	if (m_isOcclusionCullingEnabled && !isBundleCaching && !m_visibleInstances.empty())
+	{
+		_cullOccludedInstances(viewProjection);
+	}
+
+	// filter here, so the split across recording threads is even
+	out_packet.hasScene = instanceList.size() > 0;
+	out_packet.isLightingAsync = m_renderer_p->IsAsyncLightingEnabled();
+	out_packet.drawItems.clear();
+	out_packet.drawItems.reserve(m_visibleInstances.size());
+	DrawItem drawItem;
+	for (Instance* instance_p : m_visibleInstances)
+	{
+		if (instance_p->isRenderable && instance_p->FillDrawItem(drawItem))
+		{
+			out_packet.drawItems.push_back(drawItem);
+		}
+	}
+
+	// the bundle cache keeps its cells across camera moves and culls them itself
+	out_packet.sceneItems.clear();
+	if (isBundleCaching)
+	{
+		out_packet.sceneItems.reserve(instanceList.size());
+		for (Instance* instance_p : instanceList)
+		{
+			if (instance_p->isRenderable && instance_p->FillDrawItem(drawItem))
+			{
+				out_packet.sceneItems.push_back(drawItem);
+			}
+		}
+	}
+
+	_binLights(*p_window, out_packet);
+	_fitShadowCascades(*p_window, instanceList, out_packet);
+
+	out_packet.overlayText.clear();
+	if (p_window->IsPhysicsEnabled() == false)
+	{
+		// the editor UI is built here, the render thread only draws the copy
+		UIManager::Get().CreateImGuiWindowContent();
+		UIManager::Get().SnapshotDrawData(out_packet.imGuiDrawData);
+	}
+	else
+	{
+		out_packet.imGuiDrawData.Clear();
+#if defined(_DEBUG)
+		UIManager::Get().GenerateOverlayDebugInfo(out_packet.overlayText);
+#endif
+	}
+}
+
+void Application::_cullOccludedInstances(const XMFLOAT4X4& p_viewProjection)
+{
+	BEAR_PROFILE_FUNCTION();
+
+	const XMMATRIX viewProjection = XMLoadFloat4x4(&p_viewProjection);
+
+	// the largest on screen, with few enough triangles, hide the rest
+	m_occluderCandidates.clear();
+	for (Instance* instance_p : m_visibleInstances)
+	{
+		Mesh* mesh_p = instance_p->GetMeshClassPointer();
+		if (!instance_p->isRenderable || mesh_p == nullptr || mesh_p->GetCpuTriangles().empty() ||
+			mesh_p->GetCpuTriangles().size() / 3 > SoftwareOcclusion::MaxOccluderTriangles)
+		{
+			continue;
+		}
+
+		const BoundingAabb& bounds = instance_p->GetWorldBounds();
+		XMVECTOR center = XMVectorSet(bounds.center[0], bounds.center[1], bounds.center[2], 1.0f);
+		float viewDepth = XMVectorGetW(XMVector4Transform(center, viewProjection));
+		float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(bounds.extents))));
+		if (viewDepth <= 0.0f || radius < viewDepth * SoftwareOcclusion::MinOccluderScreenSize)
+		{
+			continue;
+		}
+
+		m_occluderCandidates.emplace_back(radius / viewDepth, instance_p);
+	}
+
+	// stable, so equal sizes keep the order of the instance list
+	std::stable_sort(m_occluderCandidates.begin(), m_occluderCandidates.end(),
+		[](const std::pair<float, Instance*>& a, const std::pair<float, Instance*>& b)
+		{
+			return a.first > b.first;
+		});
+	m_occluderCandidates.resize(std::min<size_t>(m_occluderCandidates.size(), SoftwareOcclusion::MaxOccluders));
+
+	m_occlusion.Begin(&p_viewProjection.m[0][0]);
+	for (const std::pair<float, Instance*>& candidate : m_occluderCandidates)
+	{
+		const std::vector<XMFLOAT3>& corners = candidate.second->GetMeshClassPointer()->GetCpuTriangles();
+		XMFLOAT4X4 modelToClip;
+		XMStoreFloat4x4(&modelToClip, XMMatrixMultiply(candidate.second->GetModelMatrix(), viewProjection));
+		m_occlusion.AddOccluder(&modelToClip.m[0][0], &corners[0].x, corners.size() / 3);
+	}
+	m_occlusion.Rasterize(m_cullingPool_p);
+
+	m_occlusion.Resize(m_visibleInstances.size());
+	for (size_t i = 0; i < m_visibleInstances.size(); i++)
+	{
+		m_occlusion.SetBounds(i, m_visibleInstances[i]->GetWorldBounds());
+	}
+	m_occlusion.Cull(m_cullingPool_p);
+
+	// an occluder is never hidden by itself, its box is in front of its own triangles
+	size_t visibleCount = 0;
+	for (size_t i = 0; i < m_visibleInstances.size(); i++)
+	{
+		if (m_occlusion.IsVisible(i))
+		{
+			m_visibleInstances[visibleCount++] = m_visibleInstances[i];
+		}
+	}
+	m_visibleInstances.resize(visibleCount);
+}
+
+void Application::_binLights(const BearWindow& p_window, FramePacket& out_packet)
+{
+	BEAR_PROFILE_FUNCTION();
+
+	MeshManager::Get().CopyLights(out_packet.lights);
+
+	const Camera& camera = p_window.GetCamera();
+	const XMMATRIX viewMatrix = camera.GetViewMatrix();
+	LightConstants& constants = out_packet.lights.constants;
+	constants.ViewMatrix = viewMatrix;
+
+	// the tiled lighting culls the lights per tile on the GPU and never reads the clusters
+	out_packet.lightClusters.clear();
+	out_packet.lightIndices.clear();
+	if (out_packet.isLightingAsync)
+	{
+		return;
+	}
+
+	XMFLOAT4X4 view;
+	XMStoreFloat4x4(&view, viewMatrix);
+	float tanHalfFovX, tanHalfFovY, nearPlane, farPlane;
+	camera.GetProjection(tanHalfFovX, tanHalfFovY, nearPlane, farPlane);
+	m_lightClusterer.SetFrustum(&view.m[0][0], tanHalfFovX, tanHalfFovY, nearPlane, farPlane);
+
+	// spot lights as the sphere of their range, after the point lights
+	const std::vector<PointLight>& pointLights = out_packet.lights.pointLights;
+	const std::vector<SpotLight>& spotLights = out_packet.lights.spotLights;
+	m_lightClusterer.Resize(pointLights.size() + spotLights.size());
+	LightSphere sphere;
+	for (size_t i = 0; i < pointLights.size(); i++)
+	{
+		sphere.center[0] = pointLights[i].Position.x;
+		sphere.center[1] = pointLights[i].Position.y;
+		sphere.center[2] = pointLights[i].Position.z;
+		sphere.radius = pointLights[i].Falloff.y;
+		m_lightClusterer.SetLight(i, sphere);
+	}
+	for (size_t i = 0; i < spotLights.size(); i++)
+	{
+		sphere.center[0] = spotLights[i].Position.x;
+		sphere.center[1] = spotLights[i].Position.y;
+		sphere.center[2] = spotLights[i].Position.z;
+		sphere.radius = spotLights[i].Falloff.y;
+		m_lightClusterer.SetLight(pointLights.size() + i, sphere);
+	}
+
+	m_lightClusterer.Bin(m_cullingPool_p);
+
+	out_packet.lightClusters = m_lightClusterer.GetClusters();
+	out_packet.lightIndices = m_lightClusterer.GetLightIndices();
+
+	constants.ClusterCountX = LightClusterer::ClustersX;
+	constants.ClusterCountY = LightClusterer::ClustersY;
+	constants.ClusterCountZ = LightClusterer::ClustersZ;
+	constants.DepthSliceScale = m_lightClusterer.GetDepthSliceScale();
+	constants.DepthSliceBias = m_lightClusterer.GetDepthSliceBias();
+}
+
+void Application::_fitShadowCascades(const BearWindow& p_window, const std::vector<Instance*>& p_instances, FramePacket& out_packet)
+{
+	BEAR_PROFILE_FUNCTION();
+
+	LightConstants& constants = out_packet.lights.constants;
+	constants.NumOfShadowCascades = 0;
+	out_packet.shadowCasters.clear();
+	for (ShadowCascade& cascade : out_packet.shadowCascades)
+	{
+		cascade.casters.clear();
+	}
+
+	if (!m_isShadowsEnabled || !out_packet.hasScene || out_packet.lights.directionalLights.empty())
+	{
+		return;
+	}
+
+	const Camera& camera = p_window.GetCamera();
+	XMFLOAT4X4 view;
+	XMStoreFloat4x4(&view, camera.GetViewMatrix());
+	float tanHalfFovX, tanHalfFovY, nearPlane, farPlane;
+	camera.GetProjection(tanHalfFovX, tanHalfFovY, nearPlane, farPlane);
+	m_shadowCascades.SetCamera(&view.m[0][0], tanHalfFovX, tanHalfFovY, nearPlane, farPlane);
+	m_shadowCascades.SetLightDirection(&out_packet.lights.directionalLights[0].Direction.x);
+	m_shadowCascades.Fit();
+
+	// outside the camera's frustum or not, every renderable instance may throw a shadow into it
+	m_shadowCasterInstances.clear();
+	for (Instance* instance_p : p_instances)
+	{
+		if (instance_p->isRenderable)
+		{
+			m_shadowCasterInstances.push_back(instance_p);
+		}
+	}
+
+	m_shadowCascades.Resize(m_shadowCasterInstances.size());
+	for (size_t i = 0; i < m_shadowCasterInstances.size(); i++)
+	{
+		m_shadowCascades.SetCaster(i, m_shadowCasterInstances[i]->GetWorldBounds());
+	}
+	m_shadowCascades.Cull(m_cullingPool_p);
+
+	// one draw item per caster that any cascade draws
+	static const uint32_t NotCopied = UINT32_MAX;
+	static const uint32_t NoMesh = UINT32_MAX - 1;
+	m_shadowCasterItems.assign(m_shadowCasterInstances.size(), NotCopied);
+	m_shadowCasterSources.clear();
+	m_unsortedShadowCasters.clear();
+	DrawItem drawItem;
+	for (unsigned int cascade = 0; cascade < ShadowCascades::CascadeCount; cascade++)
+	{
+		for (uint32_t caster : m_shadowCascades.GetCascade(cascade).casters)
+		{
+			if (m_shadowCasterItems[caster] == NotCopied)
+			{
+				m_shadowCasterItems[caster] = NoMesh;
+				if (m_shadowCasterInstances[caster]->FillDrawItem(drawItem))
+				{
+					m_shadowCasterSources.push_back(caster);
+					m_unsortedShadowCasters.push_back(drawItem);
+				}
+			}
+		}
+	}
+
+	// in batch order, so the casters of every cascade, taken in increasing index, run in batches too
+	std::vector<uint32_t>& order = m_shadowCasterOrder;
+	order.resize(m_unsortedShadowCasters.size());
+	for (uint32_t i = 0; i < order.size(); i++)
+	{
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+		{
+			return DrawItem::IsInBatchOrder(m_unsortedShadowCasters[a], m_unsortedShadowCasters[b]);
+		});
+
+	out_packet.shadowCasters.resize(order.size());
+	for (uint32_t i = 0; i < order.size(); i++)
+	{
+		out_packet.shadowCasters[i] = m_unsortedShadowCasters[order[i]];
+		m_shadowCasterItems[m_shadowCasterSources[order[i]]] = i;
+	}
+
+	XMFLOAT4 splitDepths;
+	XMFLOAT4 texelSizes;
+	float* splitDepths_p = &splitDepths.x;
+	float* texelSizes_p = &texelSizes.x;
+	for (unsigned int cascade = 0; cascade < ShadowCascades::CascadeCount; cascade++)
+	{
+		const ShadowCascade& fitted = m_shadowCascades.GetCascade(cascade);
+		ShadowCascade& packetCascade = out_packet.shadowCascades[cascade];
+		memcpy(packetCascade.viewProjection, fitted.viewProjection, sizeof(packetCascade.viewProjection));
+		packetCascade.splitDepth = fitted.splitDepth;
+		packetCascade.texelSize = fitted.texelSize;
+		for (uint32_t caster : fitted.casters)
+		{
+			if (m_shadowCasterItems[caster] < NoMesh)
+			{
+				packetCascade.casters.push_back(m_shadowCasterItems[caster]);
+			}
+		}
+		std::sort(packetCascade.casters.begin(), packetCascade.casters.end());
+
+		const XMFLOAT4X4 viewProjection(fitted.viewProjection);
+		constants.ShadowViewProjection[cascade] = XMLoadFloat4x4(&viewProjection);
+		splitDepths_p[cascade] = fitted.splitDepth;
+		texelSizes_p[cascade] = fitted.texelSize;
+	}
+	constants.ShadowSplitDepths = splitDepths;
+	constants.ShadowTexelSizes = texelSizes;
+	constants.NumOfShadowCascades = ShadowCascades::CascadeCount;
+}
+
+bool Application::_stepSimulation(BearWindow& p_window, float p_stepSeconds)
+{
+	BEAR_PROFILE_FUNCTION();
+
+	SimulationState& state = m_currentSimulationState;
+	state.time += p_stepSeconds;
+
+	// new location of cam/player
+	double currentSection = std::floor(state.time / m_sectionTimeInSeconds);
+	float currentT = static_cast<float>(state.time / m_sectionTimeInSeconds - currentSection);
+	float oneMinusT = 1.0f - currentT;
+
+	if (currentSection > m_numOfCurveSections)
+	{
+		return false;
+	}
+
+	const XMVECTOR& p1 = m_bezierCurvePoints[static_cast<size_t>(currentSection) * 2];
+	const XMVECTOR& p2 = m_bezierCurvePoints[static_cast<size_t>(currentSection) * 2 + 1];
+
+	static XMVECTOR sectionEnd = XMVectorSet(10.0f, 0.0f, 10.0f, 1.0f);
+
+	XMVECTOR newPosition = 
+		// starting point is always (0, 0, 0), so we can skip that part
+		3.0f * std::powf(oneMinusT, 2.0f) * currentT * p1 +
+		3.0f * oneMinusT * std::powf(currentT, 2.0f) * p2 +
+		std::powf(currentT, 3.0f) * sectionEnd +
+		sectionEnd * static_cast<float>(currentSection);
+
+	newPosition.m128_f32[3] = 1.0f; // make sure w is 1 for correct transformation
+
+	// calculate Y posotion from the simulated one, the camera holds the interpolated position
+	newPosition.m128_f32[1] = p_window.HandleYPosition(state.playerPosition.m128_f32[1], p_stepSeconds);
+
+	state.playerPosition = newPosition;
+
+	// one Jolt step per simulation step
+	m_physicsSystem.Update(p_stepSeconds, 1, m_tempAllocator_p, m_jobSystem_p);
+
+	//bodyInterface.SetPosition(m_camPlayerBodyId, JPH::Vec3(newPosition.m128_f32[0], 0.0f, newPosition.m128_f32[2]), EActivation::Activate);
+	const JPH::BroadPhaseQuery& broadPhaseQuery = m_physicsSystem.GetBroadPhaseQuery();
+	broadPhaseQuery.CollideSphere(
+		JPH::Vec3(newPosition.m128_f32[0], newPosition.m128_f32[1], newPosition.m128_f32[2]),
+		0.5f,
+		m_sphereCollisionCollector,
+		m_broadPhaseLayerFilter,
+		m_defaultObjectLayerFilter);
+
+	return true;
 }
 
 void Application::SwitchToDemoWindow()
@@ -556,6 +1006,23 @@ void Application::SwitchToMainWindow()
 }
 
 bool Application::PendingWindowSwitchCheck()
+{
+	if (!m_pendingSwitchToMainWindow && !m_pendingSwitchToDemoWindow)
+	{
+		// render should continue
+		return true;
+	}
+
+	// windows are shown, hidden and created here, none of them may be presented meanwhile
+	RunWhileRenderIdle([this]()
+		{
+			_switchWindows();
+		});
+
+	return false;
+}
+
+void Application::_switchWindows()
 {
 	if (m_pendingSwitchToMainWindow)
 	{
@@ -574,8 +1041,6 @@ bool Application::PendingWindowSwitchCheck()
 		m_mainWindow->Show();
 		ClipCursor(nullptr);
 		m_gameState = GameState::EditorScene;
-
-		return false;
 	}
 	else if (m_pendingSwitchToDemoWindow)
 	{
@@ -601,17 +1066,13 @@ bool Application::PendingWindowSwitchCheck()
 		m_demoWindow->Show();
 		int returnValue = ShowCursor(false);
 		m_gameState = GameState::DemoStart;
-
-		return false;
 	}
-
-	// render should continue
-	return true;
 }
 
 void Application::InitializeJoltPhysics()
 {
-	RegisterDefaultAllocator();
+	// same as the default allocator, but every byte is counted under MEMORY_TAG_JOLT
+	MemoryTracker::RegisterJoltAllocator();
 
 	// Install trace and assert callbacks
 	Trace = TraceImpl;
@@ -654,20 +1115,20 @@ bool Application::Tick(float& out_frameTime)
 	// false means no
 	// out_frameTime is only valid when return value is true
 
-	m_windowClock.Tick();
-
-	double deltaSeconds = m_windowClock.GetDeltaSeconds();
-	m_totalTime += deltaSeconds;
-	m_timeSinceLastTick += deltaSeconds;
-
-	if (m_timeSinceLastTick > m_frameTimeInSeconds)
+	// the window loop sleeps until the frame is due, this only checks and starts the frame
+	if (!m_framePacer_p->IsFrameDue())
 	{
-		out_frameTime = static_cast<float>(m_timeSinceLastTick);
-		m_timeSinceLastTick = 0.0;
-		return true;
+		return false;
 	}
 
-	return false;
+	double deltaSeconds = m_framePacer_p->BeginFrame();
+	// recorded, or during a replay replaced by the logged delta
+	deltaSeconds = SessionRecorder::Get().BeginFrame(deltaSeconds, gs_activeWindow.get());
+	m_totalTime += deltaSeconds;
+	m_lastFrameSeconds = deltaSeconds;
+	out_frameTime = static_cast<float>(deltaSeconds);
+
+	return true;
 }
 
 void Application::AddPhysicsBodies()
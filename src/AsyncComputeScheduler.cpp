@@ -0,0 +1,63 @@
+#include "AsyncComputeScheduler.h"
+
+AsyncComputeScheduler::AsyncComputeScheduler(FenceQueue& p_directQueue, FenceQueue& p_computeQueue, uint32_t p_frameSlotCount)
+	: m_directQueue(p_directQueue)
+	, m_computeQueue(p_computeQueue)
+	, m_slots(p_frameSlotCount)
+{
+}
+
+void AsyncComputeScheduler::WaitForFrameSlot(uint32_t p_frameSlot)
+{
+	const SlotFences& slot = m_slots[p_frameSlot];
+
+	// the lighting may finish after the direct queue's part of the frame when it was composited a frame later
+	m_directQueue.WaitForFenceValue(slot.direct);
+	m_computeQueue.WaitForFenceValue(slot.compute);
+	m_stats.cpuWaits++;
+}
+
+void AsyncComputeScheduler::WaitForAllFrameSlots()
+{
+	for (uint32_t frameSlot = 0; frameSlot < m_slots.size(); frameSlot++)
+	{
+		WaitForFrameSlot(frameSlot);
+	}
+}
+
+void AsyncComputeScheduler::QueueLightingWait(uint64_t p_gBufferFence)
+{
+	m_computeQueue.WaitForQueue(m_directQueue, p_gBufferFence);
+	m_stats.computeWaits++;
+}
+
+void AsyncComputeScheduler::OnLightingSubmitted(uint32_t p_frameSlot, uint64_t p_lightingFence)
+{
+	m_slots[p_frameSlot].compute = p_lightingFence;
+	m_lastLightingFence = p_lightingFence;
+	m_stats.lightingSubmissions++;
+}
+
+void AsyncComputeScheduler::QueueCompositeWait()
+{
+	if (m_lastLightingFence <= m_directWaitedFence)
+	{
+		return; // nothing new since the last wait, or no lighting at all
+	}
+
+	if (m_computeQueue.IsFenceComplete(m_lastLightingFence))
+	{
+		m_stats.skippedDirectWaits++;
+	}
+	else
+	{
+		m_directQueue.WaitForQueue(m_computeQueue, m_lastLightingFence);
+		m_stats.directWaits++;
+	}
+	m_directWaitedFence = m_lastLightingFence;
+}
+
+void AsyncComputeScheduler::OnFrameSubmitted(uint32_t p_frameSlot, uint64_t p_directFence)
+{
+	m_slots[p_frameSlot].direct = p_directFence;
+}
@@ -0,0 +1,68 @@
+#include "BatchRecording.h"
+
+#include <algorithm>
+
+void DrawBatch::Record(CommandRecorder& p_recorder, const DrawBatch* p_previous_p, bool p_isDepthOnly) const
+{
+	if (!p_isDepthOnly && (p_previous_p == nullptr || p_previous_p->textureHandle.ptr != textureHandle.ptr))
+	{
+		p_recorder.SetGraphicsRootDescriptorTable(0, textureHandle);
+	}
+
+	// sizeof() / 4 because we are setting 32 bit constants
+	DrawBatchRootConstants dbrc = {};
+	dbrc.firstInstance = firstInstance;
+	p_recorder.SetGraphicsRoot32BitConstants(1, sizeof(dbrc) / 4, &dbrc, 0);
+
+	if (p_previous_p == nullptr)
+	{
+		p_recorder.IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	}
+	// both streams belong to the same mesh, so they change together
+	if (p_previous_p == nullptr || p_previous_p->positionBufferView.BufferLocation != positionBufferView.BufferLocation)
+	{
+		if (p_isDepthOnly)
+		{
+			p_recorder.IASetVertexBuffers(0, 1, &positionBufferView);
+		}
+		else
+		{
+			D3D12_VERTEX_BUFFER_VIEW vertexBufferViews[2] = { positionBufferView, attributeBufferView };
+			p_recorder.IASetVertexBuffers(0, 2, vertexBufferViews);
+		}
+	}
+	if (p_previous_p == nullptr || p_previous_p->indexBufferView.BufferLocation != indexBufferView.BufferLocation)
+	{
+		p_recorder.IASetIndexBuffer(&indexBufferView);
+	}
+	p_recorder.DrawIndexedInstanced(indexCount, instanceCount, 0, 0, 0);
+}
+
+void BindGBufferTargets(CommandRecorder& p_recorder, const GBufferPassBindings& p_bindings)
+{
+	p_recorder.RSSetViewports(1, &p_bindings.viewport);
+	p_recorder.RSSetScissorRects(1, &p_bindings.scissorRect);
+
+	p_recorder.SetDescriptorHeaps(1, &p_bindings.srvHeap_p);
+
+	p_recorder.OMSetRenderTargets(p_bindings.renderTargetCount, &p_bindings.renderTargets, TRUE, &p_bindings.depthStencil);
+}
+
+void RecordDrawBatches(CommandRecorder& p_recorder, const std::vector<DrawBatch>& p_drawBatches, size_t p_firstBatch, size_t p_endBatch,
+	bool p_isDepthOnly)
+{
+	for (size_t i = p_firstBatch; i < p_endBatch; i++)
+	{
+		p_drawBatches[i].Record(p_recorder, i > p_firstBatch ? &p_drawBatches[i - 1] : nullptr, p_isDepthOnly);
+	}
+}
+
+size_t GetRecordingListCount(size_t p_batchCount, size_t p_maxListCount)
+{
+	return std::clamp<size_t>(p_batchCount / MinDrawsPerRecordingList, 1, std::max<size_t>(p_maxListCount, 1));
+}
+
+size_t GetRecordingChunkSize(size_t p_batchCount, size_t p_listCount)
+{
+	return (p_batchCount + p_listCount - 1) / p_listCount;
+}
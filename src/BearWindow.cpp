@@ -4,6 +4,9 @@
 #include <CommandQueue.h>
 #include <UIManager.h>
 #include <MeshManager.h>
+#include <MemoryTracker.h>
+#include <GBufferPool.h>
+#include <SessionRecorder.h>
 
 #include <d3dx12.h>
 #include <WinUser.h>
@@ -66,7 +69,7 @@ bool BearWindow::Initialize(const wchar_t* p_windowClassName, HINSTANCE p_hInsta
 	m_rtvHeap = app.CreateDescriptorHeap(TotalRTVCount, D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
 	m_rtvDescriptorSize = app.GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
 
-	m_dsvHeap = app.CreateDescriptorHeap(1, D3D12_DESCRIPTOR_HEAP_TYPE_DSV, D3D12_DESCRIPTOR_HEAP_FLAG_NONE);
+	m_dsvHeap = app.CreateDescriptorHeap(GBufferSetCount, D3D12_DESCRIPTOR_HEAP_TYPE_DSV, D3D12_DESCRIPTOR_HEAP_FLAG_NONE);
 
 	m_offsetInSRVHeap = app.AllocateInSRVHeap(RequiredSizeInSRVHeap);
 
@@ -109,13 +112,9 @@ bool BearWindow::Initialize(const wchar_t* p_windowClassName, HINSTANCE p_hInsta
 
 void BearWindow::UpdateRenderResource()
 {
-	std::wstring debugStr;
 	D3D12_CPU_DESCRIPTOR_HANDLE rtvStartHandle = m_rtvHeap->GetCPUDescriptorHandleForHeapStart();
-	D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle = m_dsvHeap->GetCPUDescriptorHandleForHeapStart();
-
-	D3D12_GPU_DESCRIPTOR_HANDLE srvStartHandle = Application::Get().GetSRVHeapGPUHandle(m_offsetInSRVHeap);
-	static const unsigned int srvIncrementSize = Application::Get().GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
+	// the G-buffer set is picked per frame, in GetCurrentRenderResource
 	for (unsigned int i = 0; i < BufferCount; ++i)
 	{
 		RenderResource& renderResource = m_renderResources[i];
@@ -124,19 +123,11 @@ void BearWindow::UpdateRenderResource()
 		// unchanged values between frames
 		renderResource.resourceArray = m_windowResources;
 		renderResource.isPhysicsEnabled = m_isPhysicsEnabled;
-		renderResource.depthBufferResourceIndex = TotalRTVCount; // the last one is for depth buffer
-		renderResource.dsv = dsvHandle;
-		// the SRV for depth buffer is right after all the SRVs for first pass RTVs, which is 9+1
-		renderResource.depthBufferSRV = CD3DX12_GPU_DESCRIPTOR_HANDLE(srvStartHandle, BufferCount * FirstPassRTVCount, srvIncrementSize);
 
 		// these values will change between frames
-		renderResource.firstPassResourceStartIndex = i * FirstPassRTVCount;
-		renderResource.backBufferResourceIndex = BufferCount * FirstPassRTVCount + i;
-		renderResource.firstPassRTV = CD3DX12_CPU_DESCRIPTOR_HANDLE(rtvStartHandle, renderResource.firstPassResourceStartIndex, m_rtvDescriptorSize);
+		renderResource.backBufferResourceIndex = GBufferRTVCount + i;
 		renderResource.secondPassRTV = CD3DX12_CPU_DESCRIPTOR_HANDLE(rtvStartHandle, renderResource.backBufferResourceIndex, m_rtvDescriptorSize);
 
-		renderResource.secondPassSRV = CD3DX12_GPU_DESCRIPTOR_HANDLE(srvStartHandle, renderResource.firstPassResourceStartIndex, srvIncrementSize);
-
 		// Done already; keep for a reference
 		//renderResource.d3d11wrappedBackBuffer = m_wrappedBackBuffers[i].Get();
 		//renderResource.d2dRenderTarget = m_d2dRenderTargets[i].Get();
@@ -150,80 +141,56 @@ void BearWindow::_updateRTVAndDSV()
 
 	CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart());
 
-	DXGI_FORMAT mRtvFormat[3] = {
-		DXGI_FORMAT_R32G32B32A32_FLOAT, // diffuse
-		DXGI_FORMAT_R32_FLOAT, // specular
-		DXGI_FORMAT_R32G32B32A32_FLOAT // normal
-	};
-
-	CD3DX12_HEAP_PROPERTIES heapProperty(D3D12_HEAP_TYPE_DEFAULT);
-	D3D12_RESOURCE_DESC resourceDesc;
-	ZeroMemory(&resourceDesc, sizeof(resourceDesc));
-	resourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-	resourceDesc.Alignment = 0;
-	resourceDesc.SampleDesc.Count = 1;
-	resourceDesc.SampleDesc.Quality = 0;
-	resourceDesc.MipLevels = 1;
-
-	resourceDesc.DepthOrArraySize = 1;
-	resourceDesc.Width = (UINT)m_width;
-	resourceDesc.Height = (UINT)m_height;
-	resourceDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
-	resourceDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
-
-	// first pass at front
-	for (int i = 0; i < BufferCount; ++i)
+	// G-buffers and depth buffers from before a resize go back to the pool first,
+	// so a target of the old size is freed if this window was its last user
+	_releaseTargets();
+
+	GBufferPool& pool = GBufferPool::Get();
+
+	D3D12_CLEAR_VALUE optimizedClearValue = {};
+	optimizedClearValue.Format = DXGI_FORMAT_D32_FLOAT;
+	optimizedClearValue.DepthStencil = { 1.0f, 0 };
+
+	// Between frames the G-buffers and depth buffers wait in the state the compute queue reads them in,
+	// which the direct queue can transition out of; the lit images stay unordered access.
+	for (UINT set = 0; set < GBufferSetCount; ++set)
 	{
 		// first pass render targets
 		for (UINT j = 0; j < FirstPassRTVCount; ++j)
 		{
-			// Create a texture to be used as the first pass render target.
-			resourceDesc.Format = mRtvFormat[j];
-
-			ThrowIfFailed(
-				device->CreateCommittedResource(
-					&heapProperty,
-					D3D12_HEAP_FLAG_NONE,
-					&resourceDesc,
-					D3D12_RESOURCE_STATE_RENDER_TARGET,
-					nullptr,
-					IID_PPV_ARGS(&m_windowResources[i * FirstPassRTVCount + j])));
+			m_windowResources[set * FirstPassRTVCount + j] = pool.Acquire((UINT)m_width, (UINT)m_height, FirstPassRTVFormats[j],
+				D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET, set, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr);
 
 			// Create the render target view for the first pass render target.
-			device->CreateRenderTargetView(m_windowResources[i * FirstPassRTVCount + j].Get(), nullptr, rtvHandle);
+			device->CreateRenderTargetView(m_windowResources[set * FirstPassRTVCount + j].Get(), nullptr, rtvHandle);
 			rtvHandle.Offset(1, m_rtvDescriptorSize);
 		}
-	}
-
-	// and depth buffer
-	// Create a depth buffer.
-	D3D12_CLEAR_VALUE optimizedClearValue = {};
-	optimizedClearValue.Format = DXGI_FORMAT_D32_FLOAT;
-	optimizedClearValue.DepthStencil = { 1.0f, 0 };
 
-	CD3DX12_RESOURCE_DESC tex2d = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_D32_FLOAT, m_width, m_height,
-		1, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
+		// and depth buffer
+		m_windowResources[TotalRTVCount + set] = pool.Acquire((UINT)m_width, (UINT)m_height, DXGI_FORMAT_D32_FLOAT,
+			D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL, set, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, &optimizedClearValue);
 
-	ThrowIfFailed(device->CreateCommittedResource(
-		&heapProperty,
-		D3D12_HEAP_FLAG_NONE,
-		&tex2d,
-		D3D12_RESOURCE_STATE_DEPTH_WRITE,
-		&optimizedClearValue,
-		IID_PPV_ARGS(&m_windowResources[TotalRTVCount]) // the last is for depth buffer resource
-	));
+		m_windowResources[TotalRTVCount + GBufferSetCount + set] = pool.Acquire((UINT)m_width, (UINT)m_height, LightingOutputFormat,
+			D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, set, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr);
+	}
+	m_areTargetsAcquired = true;
 
-	// Update the depth-stencil view.
+	// Update the depth-stencil views.
 	D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
 	dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
 	dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
 	dsvDesc.Texture2D.MipSlice = 0;
 	dsvDesc.Flags = D3D12_DSV_FLAG_NONE;
 
-	device->CreateDepthStencilView(m_windowResources[TotalRTVCount].Get(), &dsvDesc,
-		m_dsvHeap->GetCPUDescriptorHandleForHeapStart());
+	static const unsigned int dsvIncrementSize = app.GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
+	CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle(m_dsvHeap->GetCPUDescriptorHandleForHeapStart());
+	for (UINT set = 0; set < GBufferSetCount; ++set)
+	{
+		device->CreateDepthStencilView(m_windowResources[TotalRTVCount + set].Get(), &dsvDesc, dsvHandle);
+		dsvHandle.Offset(1, dsvIncrementSize);
+	}
 
-	// update SRVs for the first pass RTVs and depth buffer
+	// update SRVs for the first pass RTVs and depth buffer, and the UAV of the lit image, set by set
 	CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(Application::Get().GetSRVHeapCPUHandle(m_offsetInSRVHeap));
 	static const unsigned int incrementSize = Application::Get().GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
@@ -234,23 +201,31 @@ void BearWindow::_updateRTVAndDSV()
 	descSRV.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
 	descSRV.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 
-	for (UINT i = 0; i < BufferCount; i++) {
+	D3D12_UNORDERED_ACCESS_VIEW_DESC descUAV = {};
+	descUAV.Format = LightingOutputFormat;
+	descUAV.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+
+	for (UINT set = 0; set < GBufferSetCount; set++) {
 		for (UINT j = 0; j < FirstPassRTVCount; j++) {
-			descSRV.Format = mRtvFormat[j];
-			device->CreateShaderResourceView(m_windowResources[i * 3 + j].Get(), &descSRV, srvHandle);
+			descSRV.Format = FirstPassRTVFormats[j];
+			device->CreateShaderResourceView(m_windowResources[set * FirstPassRTVCount + j].Get(), &descSRV, srvHandle);
 			srvHandle.Offset(1, incrementSize);
 		}
-	}
 
-	// depth buffer SRV
-	descSRV.Format = DXGI_FORMAT_R32_FLOAT;
-	device->CreateShaderResourceView(m_windowResources[TotalRTVCount].Get(), &descSRV, srvHandle);
+		// depth buffer SRV
+		descSRV.Format = DXGI_FORMAT_R32_FLOAT;
+		device->CreateShaderResourceView(m_windowResources[TotalRTVCount + set].Get(), &descSRV, srvHandle);
+		srvHandle.Offset(1, incrementSize);
+
+		device->CreateUnorderedAccessView(m_windowResources[TotalRTVCount + GBufferSetCount + set].Get(), nullptr, &descUAV, srvHandle);
+		srvHandle.Offset(1, incrementSize);
+	}
 }
 
 void BearWindow::_createBackBuffersAndViewport()
 {
 	static ComPtr<ID3D12Device2> device = Application::Get().GetDevice();
-	CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), BufferCount * FirstPassRTVCount, m_rtvDescriptorSize);
+	CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), GBufferRTVCount, m_rtvDescriptorSize);
 
 	// then back buffers
 	for (int i = 0; i < BufferCount; ++i)
@@ -261,7 +236,8 @@ void BearWindow::_createBackBuffersAndViewport()
 
 		device->CreateRenderTargetView(backBuffer.Get(), nullptr, rtvHandle);
 
-		m_windowResources[BufferCount * FirstPassRTVCount + i] = backBuffer;
+		m_windowResources[GBufferRTVCount + i] = backBuffer;
+		MemoryTracker::Get().TrackResource(GPU_MEMORY_RENDER_TARGET, backBuffer.Get());
 
 		rtvHandle.Offset(1, m_rtvDescriptorSize);
 	}
@@ -289,7 +265,8 @@ void BearWindow::_resizeBackBuffersAndViewport()
 
 	for (int i = 0; i < BufferCount; ++i)
 	{
-		m_windowResources[BufferCount * FirstPassRTVCount + i].Reset();
+		MemoryTracker::Get().UntrackResource(m_windowResources[GBufferRTVCount + i].Get());
+		m_windowResources[GBufferRTVCount + i].Reset();
 	}
 
 	DXGI_SWAP_CHAIN_DESC swapChainDesc = {};
@@ -304,11 +281,43 @@ void BearWindow::_resizeBackBuffersAndViewport()
 	{
 		_createD3D11on12Resources();
 	}
-	_updateRTVAndDSV();
+
+	// a hidden window takes its targets at the new size when it is shown
+	if (m_areTargetsAcquired)
+	{
+		_updateRTVAndDSV();
+	}
+}
+
+void BearWindow::_releaseTargets()
+{
+	if (!m_areTargetsAcquired)
+	{
+		return;
+	}
+
+	GBufferPool& pool = GBufferPool::Get();
+	for (UINT i = 0; i < GBufferRTVCount; ++i)
+	{
+		pool.Release(m_windowResources[i].Get());
+		m_windowResources[i].Reset();
+	}
+	for (UINT i = TotalRTVCount; i < TotalRTVCount + 2 * GBufferSetCount; ++i)
+	{
+		pool.Release(m_windowResources[i].Get());
+		m_windowResources[i].Reset();
+	}
+
+	m_areTargetsAcquired = false;
 }
 
 void BearWindow::Show()
 {
+	if (!m_areTargetsAcquired)
+	{
+		_updateRTVAndDSV();
+	}
+
 	if (m_isFullscreen)
 	{
 		CenterCursor();
@@ -325,10 +334,20 @@ void BearWindow::Show()
 void BearWindow::Hide()
 {
 	::ShowWindow(m_hWnd, SW_HIDE);
+
+	// nothing renders to a hidden window, its targets go back to the pool once the GPU is done with them
+	Application::Get().Flush();
+	_releaseTargets();
 }
 
 void BearWindow::Destroy()
 {
+	if (m_frameLatencyWaitableObject)
+	{
+		CloseHandle(m_frameLatencyWaitableObject);
+		m_frameLatencyWaitableObject = nullptr;
+	}
+
 	if (m_hWnd)
 	{
 		DestroyWindow(m_hWnd);
@@ -378,6 +397,7 @@ ComPtr<IDXGISwapChain4> BearWindow::CreateSwapChain()
 	swapChainDesc.AlphaMode = DXGI_ALPHA_MODE_UNSPECIFIED;
 	// It is recommended to always allow tearing if tearing support is available.
 	swapChainDesc.Flags = m_isTearingSupported ? DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING : 0;
+	swapChainDesc.Flags |= DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
 	ID3D12CommandQueue* pCommandQueue = app.GetCommandQueue()->GetD3D12CommandQueue().Get();
 
 	ComPtr<IDXGISwapChain1> swapChain1;
@@ -395,11 +415,24 @@ ComPtr<IDXGISwapChain4> BearWindow::CreateSwapChain()
 
 	ThrowIfFailed(swapChain1.As(&dxgiSwapChain4));
 
+	// ResizeBuffers keeps the flags, so the object stays valid for the lifetime of the swap chain
+	ThrowIfFailed(dxgiSwapChain4->SetMaximumFrameLatency(m_maximumFrameLatency));
+	m_frameLatencyWaitableObject = dxgiSwapChain4->GetFrameLatencyWaitableObject();
+
 	m_currentBackBufferIndex = dxgiSwapChain4->GetCurrentBackBufferIndex();
 
 	return dxgiSwapChain4;
 }
 
+void BearWindow::SetMaximumFrameLatency(UINT p_maximumFrameLatency)
+{
+	if (p_maximumFrameLatency != m_maximumFrameLatency)
+	{
+		m_maximumFrameLatency = p_maximumFrameLatency;
+		ThrowIfFailed(m_dxgiSwapChain->SetMaximumFrameLatency(m_maximumFrameLatency));
+	}
+}
+
 unsigned int BearWindow::Present()
 {
 	UINT presentFlags = m_isTearingSupported ? DXGI_PRESENT_ALLOW_TEARING : 0;
@@ -409,12 +442,27 @@ unsigned int BearWindow::Present()
 	return m_currentBackBufferIndex;
 }
 
-void BearWindow::GetCurrentRenderResource(RenderResource& out_RR)
+void BearWindow::GetCurrentRenderResource(RenderResource& out_RR, unsigned int p_gBufferSet)
 {
 	out_RR = m_renderResources[m_currentBackBufferIndex];
 
 	// only viewport may change between frames, so we update them here
 	out_RR.viewport = m_viewport;
+
+	static const unsigned int dsvIncrementSize = Application::Get().GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
+	static const unsigned int srvIncrementSize = Application::Get().GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	const unsigned int firstSRV = p_gBufferSet * SRVHeapSizePerSet;
+	D3D12_GPU_DESCRIPTOR_HANDLE srvStartHandle = Application::Get().GetSRVHeapGPUHandle(m_offsetInSRVHeap);
+
+	out_RR.gBufferSet = p_gBufferSet;
+	out_RR.firstPassResourceStartIndex = p_gBufferSet * FirstPassRTVCount;
+	out_RR.depthBufferResourceIndex = TotalRTVCount + p_gBufferSet;
+	out_RR.lightingOutputResourceIndex = TotalRTVCount + GBufferSetCount + p_gBufferSet;
+	out_RR.firstPassRTV = CD3DX12_CPU_DESCRIPTOR_HANDLE(m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), out_RR.firstPassResourceStartIndex, m_rtvDescriptorSize);
+	out_RR.dsv = CD3DX12_CPU_DESCRIPTOR_HANDLE(m_dsvHeap->GetCPUDescriptorHandleForHeapStart(), p_gBufferSet, dsvIncrementSize);
+	out_RR.secondPassSRV = CD3DX12_GPU_DESCRIPTOR_HANDLE(srvStartHandle, firstSRV, srvIncrementSize);
+	out_RR.depthBufferSRV = CD3DX12_GPU_DESCRIPTOR_HANDLE(srvStartHandle, firstSRV + FirstPassRTVCount, srvIncrementSize);
+	out_RR.lightingOutputUAV = CD3DX12_GPU_DESCRIPTOR_HANDLE(srvStartHandle, firstSRV + FirstPassRTVCount + 1, srvIncrementSize);
 }
 
 // Forward declare message handler from imgui_impl_win32.cpp
@@ -424,11 +472,23 @@ LRESULT BearWindow::WindowMessageHandler(HWND hwnd, UINT message, WPARAM wParam,
 {
 	// return value decides if the message processing should pass on
 	// assume this function is called first
+	// during a replay the session recorder drops live input and hands the logged one to HandleInput
+	if (!SessionRecorder::IsInputMessage(message) ||
+		SessionRecorder::Get().OnInput(m_isPhysicsEnabled, message, wParam, lParam))
+	{
+		HandleInput(message, wParam, lParam);
+	}
+
+	return DefWindowProcW(hwnd, message, wParam, lParam);
+}
+
+void BearWindow::HandleInput(UINT message, WPARAM wParam, LPARAM lParam)
+{
 	const GameState currentState = Application::Get().GetGameState();
 
 	if (m_isPhysicsEnabled == false)
 	{
-		ImGui_ImplWin32_WndProcHandler(hwnd, message, wParam, lParam);
+		ImGui_ImplWin32_WndProcHandler(m_hWnd, message, wParam, lParam);
 	}
 	else
 	{
@@ -523,8 +583,6 @@ LRESULT BearWindow::WindowMessageHandler(HWND hwnd, UINT message, WPARAM wParam,
 			}
 		}
 	}
-
-	return DefWindowProcW(hwnd, message, wParam, lParam);
 }
 
 void BearWindow::GetCameraMatrices(XMMATRIX& out_viewProjMatrix, XMMATRIX& out_invPVMatrix) const
@@ -558,7 +616,7 @@ void BearWindow::_createD3D11on12Resources()
 	for (UINT i = 0; i < BufferCount; ++i)
 	{
 		ThrowIfFailed(d3d11On12Device->CreateWrappedResource(
-			m_windowResources[BufferCount * FirstPassRTVCount + i].Get(),
+			m_windowResources[GBufferRTVCount + i].Get(),
 			&d3d11Flags,
 			D3D12_RESOURCE_STATE_RENDER_TARGET,
 			D3D12_RESOURCE_STATE_PRESENT,
@@ -578,12 +636,12 @@ void BearWindow::_createD3D11on12Resources()
 	}
 }
 
-float BearWindow::HandleYPosition(float p_deltaSecond)
+float BearWindow::HandleYPosition(float p_currentY, float p_deltaSecond)
 {
 	if (m_isJumped)
 	{
 		m_verticalVelocity += m_gravity * p_deltaSecond; // apply gravity (negative)
-		float yPosition = m_camera.GetPosition().m128_f32[1] + m_verticalVelocity * p_deltaSecond;
+		float yPosition = p_currentY + m_verticalVelocity * p_deltaSecond;
 		if (yPosition <= 0.0f) // assuming ground level is at Y=0
 		{
 			yPosition = 0.0f; // reset to ground level
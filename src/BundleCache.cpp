@@ -0,0 +1,280 @@
+#include "BundleCache.h"
+#include "CommandQueue.h"
+#include "D3D12CommandRecorder.h"
+#include "FramePacket.h"
+#include "Profiler.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+BundleCache::BundleCache(ComPtr<ID3D12Device2> p_device)
+	: m_device(p_device)
+{
+}
+
+void BundleCache::Update(const std::vector<DrawItem>& p_sceneItems, ComPtr<ID3D12RootSignature> p_rootSignature,
+	ComPtr<ID3D12PipelineState> p_pipelineState, ID3D12DescriptorHeap* p_srvHeap,
+	WorkerPool& p_workerPool, CommandQueue& p_commandQueue)
+{
+	BEAR_PROFILE_FUNCTION();
+
+	_releaseCompleted(p_commandQueue);
+
+	if (m_recordedRootSignature != p_rootSignature || m_recordedPipelineState != p_pipelineState)
+	{
+		// shaders were rebuilt
+		Clear();
+		m_recordedRootSignature = p_rootSignature;
+		m_recordedPipelineState = p_pipelineState;
+	}
+
+	for (auto& cellPair : m_cells)
+	{
+		cellPair.second.members.clear();
+	}
+
+	for (const DrawItem& item : p_sceneItems)
+	{
+		m_cells[_getCellKey(item)].members.push_back({ item.instance_p, item.revision, &item });
+	}
+
+	// A bundle cannot follow the camera, so cells ignore the queue's depth order and keep
+	// their members by batch and instance. Unchanged cells then compare equal below.
+	for (auto& cellPair : m_cells)
+	{
+		std::vector<CellMember>& members = cellPair.second.members;
+		if (members.empty())
+		{
+			continue;
+		}
+		std::sort(members.begin(), members.end(), [](const CellMember& p_left, const CellMember& p_right)
+			{
+				if (DrawItem::IsInBatchOrder(*p_left.item_p, *p_right.item_p))
+				{
+					return true;
+				}
+				if (DrawItem::IsInBatchOrder(*p_right.item_p, *p_left.item_p))
+				{
+					return false;
+				}
+				return p_left.instance_p < p_right.instance_p;
+			});
+
+		// members reach out of the cell by their own size, so the box is not the cell's
+		float minimum[3];
+		float maximum[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const BoundingAabb& bounds = members[0].item_p->worldBounds;
+			minimum[axis] = bounds.center[axis] - bounds.extents[axis];
+			maximum[axis] = bounds.center[axis] + bounds.extents[axis];
+		}
+		for (const CellMember& member : members)
+		{
+			const BoundingAabb& bounds = member.item_p->worldBounds;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				minimum[axis] = std::min<float>(minimum[axis], bounds.center[axis] - bounds.extents[axis]);
+				maximum[axis] = std::max<float>(maximum[axis], bounds.center[axis] + bounds.extents[axis]);
+			}
+		}
+		for (int axis = 0; axis < 3; axis++)
+		{
+			cellPair.second.bounds.center[axis] = (minimum[axis] + maximum[axis]) * 0.5f;
+			cellPair.second.bounds.extents[axis] = (maximum[axis] - minimum[axis]) * 0.5f;
+		}
+	}
+
+	m_stats = BundleCacheStats();
+	std::vector<Cell*> dirtyCells;
+
+	for (auto it = m_cells.begin(); it != m_cells.end();)
+	{
+		Cell& cell = it->second;
+
+		if (cell.members.empty())
+		{
+			// everything in it was removed or moved elsewhere
+			_retire(cell.entry);
+			it = m_cells.erase(it);
+			continue;
+		}
+
+		if (cell.entry.bundle == nullptr || cell.members != cell.recordedMembers)
+		{
+			// the GPU may still replay the old bundle, record into a different one
+			_retire(cell.entry);
+
+			if (!m_freeEntries.empty())
+			{
+				cell.entry = m_freeEntries.back();
+				m_freeEntries.pop_back();
+			}
+
+			dirtyCells.push_back(&cell);
+			m_stats.rerecordedInstances += static_cast<unsigned int>(cell.members.size());
+		}
+		else
+		{
+			m_stats.cachedInstances += static_cast<unsigned int>(cell.members.size());
+		}
+
+		++it;
+	}
+
+	m_stats.cellCount = static_cast<unsigned int>(m_cells.size());
+	m_stats.rerecordedCells = static_cast<unsigned int>(dirtyCells.size());
+
+	p_workerPool.Dispatch(static_cast<unsigned int>(dirtyCells.size()), [&](unsigned int cellIndex)
+		{
+			_recordCell(*dirtyCells[cellIndex], p_srvHeap);
+		});
+}
+
+size_t BundleCache::Execute(CommandRecorder& p_recorder, const FrustumPlanes& p_frustumPlanes, D3D12_GPU_VIRTUAL_ADDRESS p_instanceData,
+	VertexShaderInput* out_instanceData_p)
+{
+	BEAR_PROFILE_FUNCTION();
+
+	// cells are few next to instances, the calling thread tests them
+	m_cellCuller.Resize(m_cells.size());
+	size_t cellIndex = 0;
+	for (auto& cellPair : m_cells)
+	{
+		m_cellCuller.SetBounds(cellIndex++, cellPair.second.bounds);
+	}
+	m_cellCuller.Cull(p_frustumPlanes, nullptr);
+
+	m_stats.culledCells = 0;
+	m_stats.drawCalls = 0;
+	size_t instanceOffset = 0;
+	cellIndex = 0;
+	for (auto& cellPair : m_cells)
+	{
+		const Cell& cell = cellPair.second;
+		if (!m_cellCuller.IsVisible(cellIndex++))
+		{
+			m_stats.culledCells++;
+			continue;
+		}
+
+		// the bundle counts instances from the start of its cell
+		p_recorder.SetGraphicsRootShaderResourceView(3, p_instanceData + instanceOffset * sizeof(VertexShaderInput));
+		for (const CellMember& member : cell.members)
+		{
+			out_instanceData_p[instanceOffset++] = member.item_p->constants;
+		}
+
+		p_recorder.ExecuteBundle(cell.entry.bundle.Get());
+		m_stats.drawCalls += cell.drawCount;
+	}
+
+	m_stats.drawnInstances = static_cast<unsigned int>(instanceOffset);
+	return instanceOffset;
+}
+
+void BundleCache::OnFrameSubmitted(uint64_t p_fenceValue)
+{
+	for (RetiredEntry& retiredEntry : m_retiredEntries)
+	{
+		if (retiredEntry.fenceValue == 0)
+		{
+			retiredEntry.fenceValue = p_fenceValue;
+		}
+	}
+}
+
+void BundleCache::Clear()
+{
+	for (auto& cellPair : m_cells)
+	{
+		_retire(cellPair.second.entry);
+	}
+	m_cells.clear();
+}
+
+uint64_t BundleCache::_getCellKey(const DrawItem& p_item)
+{
+	// translation row of the model matrix
+	XMFLOAT3 position;
+	XMStoreFloat3(&position, p_item.constants.modelMatrix.r[3]);
+
+	// 21 bits per axis, biased so negative cells pack too
+	auto cellCoordinate = [](float p_value) -> uint64_t
+		{
+			int64_t cell = static_cast<int64_t>(std::floor(p_value / CellSize)) + (1 << 20);
+			return static_cast<uint64_t>(cell) & 0x1FFFFF;
+		};
+
+	return cellCoordinate(position.x) | (cellCoordinate(position.y) << 21) | (cellCoordinate(position.z) << 42);
+}
+
+void BundleCache::_retire(BundleEntry& p_entry)
+{
+	if (p_entry.bundle != nullptr)
+	{
+		m_retiredEntries.push_back({ p_entry, 0 });
+	}
+	p_entry = BundleEntry();
+}
+
+void BundleCache::_releaseCompleted(CommandQueue& p_commandQueue)
+{
+	for (auto it = m_retiredEntries.begin(); it != m_retiredEntries.end();)
+	{
+		if (it->fenceValue != 0 && p_commandQueue.IsFenceComplete(it->fenceValue))
+		{
+			m_freeEntries.push_back(it->entry);
+			it = m_retiredEntries.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+void BundleCache::_recordCell(Cell& p_cell, ID3D12DescriptorHeap* p_srvHeap)
+{
+	BundleEntry& entry = p_cell.entry;
+
+	if (entry.allocator == nullptr)
+	{
+		ThrowIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_BUNDLE, IID_PPV_ARGS(&entry.allocator)));
+		ThrowIfFailed(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_BUNDLE, entry.allocator.Get(),
+			m_recordedPipelineState.Get(), IID_PPV_ARGS(&entry.bundle)));
+	}
+	else
+	{
+		ThrowIfFailed(entry.allocator->Reset());
+		ThrowIfFailed(entry.bundle->Reset(entry.allocator.Get(), m_recordedPipelineState.Get()));
+	}
+
+	// same root signature and heap as the calling list, so the per-list VP constants are inherited
+	D3D12CommandRecorder recorder(entry.bundle.Get());
+	recorder.SetGraphicsRootSignature(m_recordedRootSignature.Get());
+	recorder.SetDescriptorHeaps(1, &p_srvHeap);
+
+	// members are in batch order, so a batch is a run of them
+	std::vector<DrawBatch> batches;
+	for (size_t i = 0; i < p_cell.members.size(); i++)
+	{
+		const DrawItem& item = *p_cell.members[i].item_p;
+		if (!batches.empty() && p_cell.members[i - 1].item_p->IsSameBatch(item))
+		{
+			batches.back().instanceCount++;
+		}
+		else
+		{
+			batches.push_back(DrawBatch(item, static_cast<UINT>(i)));
+		}
+	}
+
+	RecordDrawBatches(recorder, batches, 0, batches.size());
+
+	ThrowIfFailed(entry.bundle->Close());
+	p_cell.drawCount = static_cast<unsigned int>(batches.size());
+
+	p_cell.recordedMembers = p_cell.members;
+}
@@ -1,5 +1,7 @@
 #include <Camera.h>
 
+#include <cmath>
+
 Camera::Camera()
 	:m_rotation(XMVectorZero())
 	, m_fov(90.0f)
@@ -112,6 +114,20 @@ XMMATRIX Camera::GetInvPVMatrix() const
 	return m_invPVMatrix;
 }
 
+XMMATRIX Camera::GetViewMatrix() const
+{
+	return XMMatrixLookToLH(m_position, m_frontDirection, m_upDirection);
+}
+
+void Camera::GetProjection(float& out_tanHalfFovX, float& out_tanHalfFovY, float& out_nearPlane, float& out_farPlane) const
+{
+	// m_fov is vertical, as XMMatrixPerspectiveFovLH takes it
+	out_tanHalfFovY = std::tanf(XMConvertToRadians(m_fov) * 0.5f);
+	out_tanHalfFovX = out_tanHalfFovY * m_aspectRatio;
+	out_nearPlane = m_nearPlane;
+	out_farPlane = m_farPlane;
+}
+
 Camera& Camera::operator=(const Camera& other)
 {
 	if (this != &other)
@@ -15,9 +15,6 @@ CommandQueue::CommandQueue(Microsoft::WRL::ComPtr<ID3D12Device2> device, D3D12_C
 
 	ThrowIfFailed(m_d3d12Device->CreateCommandQueue(&desc, IID_PPV_ARGS(&m_d3d12CommandQueue)));
 	ThrowIfFailed(m_d3d12Device->CreateFence(m_FenceValue, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_d3d12Fence)));
-
-	m_FenceEvent = ::CreateEvent(NULL, FALSE, FALSE, NULL);
-	assert(m_FenceEvent && "Failed to create fence event handle.");
 }
 
 CommandQueue::~CommandQueue()
@@ -26,6 +23,8 @@ CommandQueue::~CommandQueue()
 
 uint64_t CommandQueue::Signal()
 {
+	std::lock_guard<std::mutex> lock(m_PoolMutex);
+
 	uint64_t fenceValue = ++m_FenceValue;
 	m_d3d12CommandQueue->Signal(m_d3d12Fence.Get(), fenceValue);
 	return fenceValue;
@@ -38,13 +37,23 @@ bool CommandQueue::IsFenceComplete(uint64_t fenceValue)
 
 void CommandQueue::WaitForFenceValue(uint64_t fenceValue)
 {
+	// several threads wait on this queue, e.g. recording threads for their allocators, so there is
+	// no shared event: without one, SetEventOnCompletion blocks the calling thread until the value is reached
 	if (!IsFenceComplete(fenceValue))
 	{
-		m_d3d12Fence->SetEventOnCompletion(fenceValue, m_FenceEvent);
-		::WaitForSingleObject(m_FenceEvent, DWORD_MAX);
+		ThrowIfFailed(m_d3d12Fence->SetEventOnCompletion(fenceValue, nullptr));
 	}
 }
 
+void CommandQueue::WaitForQueue(FenceQueue& queue, uint64_t fenceValue)
+{
+	CommandQueue& otherQueue = static_cast<CommandQueue&>(queue);
+
+	// queued like a submission, so it lands between the lists submitted before and after it
+	std::lock_guard<std::mutex> lock(m_PoolMutex);
+	ThrowIfFailed(m_d3d12CommandQueue->Wait(otherQueue.m_d3d12Fence.Get(), fenceValue));
+}
+
 void CommandQueue::Flush()
 {
 	WaitForFenceValue(Signal());
@@ -71,11 +80,25 @@ Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> CommandQueue::GetCommandList(
 	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> commandAllocator;
 	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList;
 
-	if (!m_CommandAllocatorQueue.empty() && IsFenceComplete(m_CommandAllocatorQueue.front().fenceValue))
+	// only the pops are guarded, resetting and creating run outside the lock
 	{
-		commandAllocator = m_CommandAllocatorQueue.front().commandAllocator;
-		m_CommandAllocatorQueue.pop();
+		std::lock_guard<std::mutex> lock(m_PoolMutex);
+
+		if (!m_CommandAllocatorQueue.empty() && IsFenceComplete(m_CommandAllocatorQueue.front().fenceValue))
+		{
+			commandAllocator = m_CommandAllocatorQueue.front().commandAllocator;
+			m_CommandAllocatorQueue.pop();
+		}
+
+		if (!m_CommandListQueue.empty())
+		{
+			commandList = m_CommandListQueue.front();
+			m_CommandListQueue.pop();
+		}
+	}
 
+	if (commandAllocator)
+	{
 		ThrowIfFailed(commandAllocator->Reset());
 	}
 	else
@@ -83,11 +106,8 @@ Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> CommandQueue::GetCommandList(
 		commandAllocator = CreateCommandAllocator();
 	}
 
-	if (!m_CommandListQueue.empty())
+	if (commandList)
 	{
-		commandList = m_CommandListQueue.front();
-		m_CommandListQueue.pop();
-
 		ThrowIfFailed(commandList->Reset(commandAllocator.Get(), nullptr));
 	}
 	else
@@ -102,30 +122,88 @@ Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> CommandQueue::GetCommandList(
 	return commandList;
 }
 
+Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> CommandQueue::GetCommandList(Microsoft::WRL::ComPtr<ID3D12CommandAllocator> commandAllocator)
+{
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList;
+
+	ThrowIfFailed(commandAllocator->Reset());
+
+	{
+		std::lock_guard<std::mutex> lock(m_PoolMutex);
+
+		if (!m_CommandListQueue.empty())
+		{
+			commandList = m_CommandListQueue.front();
+			m_CommandListQueue.pop();
+		}
+	}
+
+	if (commandList)
+	{
+		ThrowIfFailed(commandList->Reset(commandAllocator.Get(), nullptr));
+	}
+	else
+	{
+		commandList = CreateCommandList(commandAllocator);
+	}
+
+	// A recycled list may still point at a pooled allocator; drop that association
+	// so ExecuteCommandList does not hand the caller's allocator to the pool.
+	ThrowIfFailed(commandList->SetPrivateData(__uuidof(ID3D12CommandAllocator), 0, nullptr));
+
+	return commandList;
+}
+
 // Execute a command list.
 // Returns the fence value to wait for for this command list.
 uint64_t CommandQueue::ExecuteCommandList(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList)
 {
-	commandList->Close();
+	return ExecuteCommandLists({ commandList });
+}
 
-	ID3D12CommandAllocator* commandAllocator;
-	UINT dataSize = sizeof(commandAllocator);
-	ThrowIfFailed(commandList->GetPrivateData(__uuidof(ID3D12CommandAllocator), &dataSize, &commandAllocator));
+uint64_t CommandQueue::ExecuteCommandLists(const std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>>& commandLists)
+{
+	std::vector<ID3D12CommandList*> ppCommandLists;
+	std::vector<ID3D12CommandAllocator*> pooledAllocators;
+	ppCommandLists.reserve(commandLists.size());
+	pooledAllocators.reserve(commandLists.size());
 
-	ID3D12CommandList* const ppCommandLists[] = {
-		commandList.Get()
-	};
+	for (const auto& commandList : commandLists)
+	{
+		commandList->Close();
 
-	m_d3d12CommandQueue->ExecuteCommandLists(1, ppCommandLists);
-	uint64_t fenceValue = Signal();
+		ID3D12CommandAllocator* commandAllocator = nullptr;
+		UINT dataSize = sizeof(commandAllocator);
+		if (SUCCEEDED(commandList->GetPrivateData(__uuidof(ID3D12CommandAllocator), &dataSize, &commandAllocator)) &&
+			commandAllocator != nullptr)
+		{
+			pooledAllocators.push_back(commandAllocator);
+		}
 
-	m_CommandAllocatorQueue.emplace(CommandAllocatorEntry{ fenceValue, commandAllocator });
-	m_CommandListQueue.push(commandList);
+		ppCommandLists.push_back(commandList.Get());
+	}
 
-	// The ownership of the command allocator has been transferred to the ComPtr
-	// in the command allocator queue. It is safe to release the reference
-	// in this temporary COM pointer here.
-	commandAllocator->Release();
+	// submit and signal under the lock, so fence values follow submission order across threads
+	std::lock_guard<std::mutex> lock(m_PoolMutex);
+
+	m_d3d12CommandQueue->ExecuteCommandLists(static_cast<UINT>(ppCommandLists.size()), ppCommandLists.data());
+	uint64_t fenceValue = ++m_FenceValue;
+	m_d3d12CommandQueue->Signal(m_d3d12Fence.Get(), fenceValue);
+
+	for (const auto& commandList : commandLists)
+	{
+		m_CommandListQueue.push(commandList);
+	}
+
+	for (ID3D12CommandAllocator* commandAllocator : pooledAllocators)
+	{
+		m_CommandAllocatorQueue.emplace(CommandAllocatorEntry{ fenceValue, commandAllocator });
+
+		// The ownership of the command allocator has been transferred to the ComPtr
+		// in the command allocator queue. It is safe to release the reference
+		// in this temporary COM pointer here.
+		commandAllocator->Release();
+	}
 
 	return fenceValue;
 }
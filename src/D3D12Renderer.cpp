@@ -4,70 +4,150 @@
 #include "UIManager.h"
 #include "MeshManager.h"
 #include "EntityInstance.h"
+#include "Profiler.h"
+#include "D3D12TimestampBackend.h"
+#include "D3D12CommandRecorder.h"
+#include "FrameRecording.h"
+#include "MemoryTracker.h"
 
 #include <DirectXMath.h>
 using namespace DirectX;
 
+#include <algorithm>
+#include <chrono>
 #include <functional>
 #include <vector>
 
 D3D12Renderer::D3D12Renderer(const wchar_t* p_1stVsPath, const wchar_t* p_1sPsPath, const wchar_t* p_2ndVsPath, const wchar_t* p_2ndPsPath)
 {
 	m_shader_p = new Shader(L"FirstPassVertexShader", L"FirstPassPixelShader",
-		L"SecondPassVertexShader", L"SecondPassPixelShader");
+		L"SecondPassVertexShader", L"SecondPassPixelShader", L"TiledLightingComputeShader", L"DepthPrepassVertexShader");
 
 	m_scissorRect = CD3DX12_RECT(0, 0, LONG_MAX, LONG_MAX);
 
+	// the render thread records too, so it is not counted here
+	m_recordingPool = std::make_unique<WorkerPool>(WorkerPool::GetDefaultThreadCount());
+	m_bundleCache = std::make_unique<BundleCache>(Application::Get().GetDevice());
+
 	_prepare2ndPassResources();
+	_prepareShadowMaps();
+	_prepareFrameContexts();
 }
 
-void D3D12Renderer::Render(BearWindow& window)
+void D3D12Renderer::SetFramesInFlight(unsigned int p_framesInFlight)
 {
+	m_pendingFramesInFlight = std::clamp<unsigned int>(p_framesInFlight, 1, MaxFramesInFlight);
+}
+
+void D3D12Renderer::Render(const FramePacket& packet)
+{
+	BEAR_PROFILE_FUNCTION();
+
+	BearWindow& window = *packet.window;
+
+	// consecutive frames take turns with the G-buffer sets, so one can be lit while the next frame fills the other
+	const unsigned int gBufferSet = static_cast<unsigned int>(m_frameNumber % BearWindow::GBufferSetCount);
+
 	// acquire render resources, read-only
 	RenderResource currentRR;
-	window.GetCurrentRenderResource(currentRR);
+	window.GetCurrentRenderResource(currentRR, gBufferSet);
 
-	unsigned int currentBackBufferIndex = currentRR.currentBackBufferIndex;
-	static ID3D12DescriptorHeap* srvHeap = Application::Get().GetSRVHeap();
-
-	const GameState gameState = Application::Get().GetGameState();
+	// filtered and copied on the game thread, so the split across recording threads is even;
+	// sorted by state, then front to back
+	m_renderQueue.Build(packet.drawItems, packet.vpMatrix, *m_recordingPool);
+	m_renderQueue.Gather(packet.drawItems, m_sortedDrawItems);
+	{
+		std::lock_guard<std::mutex> lock(m_statsMutex);
+		m_renderQueueStats = m_renderQueue.GetStats();
+	}
+	const std::vector<DrawItem>& drawItems = m_sortedDrawItems;
 
-	// Get entity list, on copy
-	std::vector<Instance*> instanceList = MeshManager::Get().GetInstanceList();
-	if (gameState != GameState::EditorScene &&
-		gameState != GameState::DemoRunning)
+	// Lit on the compute queue, the back buffer shows the previous frame's lit image if that frame was
+	// of this window and lit the same way; then this frame's lighting can run alongside the next frame.
+	// Otherwise it waits for its own.
+	const bool isLightingAsync = packet.isLightingAsync && packet.hasScene;
+	bool isCompositingPreviousFrame = false;
+	ID3D12Resource* compositeSource_p = nullptr;
+	if (isLightingAsync)
 	{
-		instanceList.clear(); // only render instances in editor scene and demo running state
+		RenderResource previousRR;
+		window.GetCurrentRenderResource(previousRR, (gBufferSet + BearWindow::GBufferSetCount - 1) % BearWindow::GBufferSetCount);
+		ID3D12Resource* previousOutput_p = previousRR.resourceArray[previousRR.lightingOutputResourceIndex].Get();
+
+		isCompositingPreviousFrame = m_lastLightingWindow_p == &window && m_lastLightingOutput.Get() == previousOutput_p;
+		compositeSource_p = isCompositingPreviousFrame ? previousOutput_p : currentRR.resourceArray[currentRR.lightingOutputResourceIndex].Get();
 	}
 
+	// only the cascades that changed since this G-buffer set's maps were last drawn
+	size_t shadowInstanceCount = 0;
+	const unsigned int shadowCascadesDrawn = _selectShadowCascades(packet, gBufferSet, shadowInstanceCount);
+
+	// the passes of the frame and what they read and write; the barriers between them come from here
+	_buildFrameGraph(currentRR, packet.hasScene, gBufferSet, shadowCascadesDrawn > 0, compositeSource_p);
+	size_t barrierCount = 0;
+	const RenderGraphBarrier* barriers_p = nullptr;
+	// nothing reads the G-buffers without a scene, so they are not even cleared
+	const bool isGBufferPassCulled = m_renderGraph.IsPassCulled(m_frameGraph.gBufferPass);
+
 	// first pass: render to G-buffer
 	auto commandQueue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT);
-	auto commandList = commandQueue->GetCommandList();
+	const UINT frameSlot = _beginFrame();
+	window.SetMaximumFrameLatency(m_framesInFlight);
+	FrameContext& frameContext = m_frameContexts[frameSlot];
+	auto commandList = commandQueue->GetCommandList(frameContext.commandAllocator);
+	commandList->EndQuery(m_timestampQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, frameSlot * 2);
+	D3D12CommandRecorder recorder(commandList.Get());
 	static UINT descriptorSize = Application::Get().GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
-	commandList->RSSetViewports(1, &currentRR.viewport);
-	commandList->RSSetScissorRects(1, &m_scissorRect);
+	// read once, the game thread may flip it while the frame is recorded
+	const bool hasDepthPrepass = m_isDepthPrepassEnabled && drawItems.size() > 0 && !isGBufferPassCulled;
+	// the packet has the whole scene only if caching was on when it was built
+	const std::vector<DrawItem>* bundledItems_p = m_isBundleCachingEnabled && !packet.sceneItems.empty() ? &packet.sceneItems : nullptr;
 
-	FLOAT clearColor[] = { 0.0f, 0.0f, 0.0f, 1.0f };
-	CD3DX12_CPU_DESCRIPTOR_HANDLE firstPassRtvHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(currentRR.firstPassRTV);
-	for (UINT i = 0; i < BearWindow::FirstPassRTVCount; i++)
+	// the G-buffer pass's transforms first, with bundles the depth prepass needs a copy of them in its own
+	// order, see _recordDepthPrepass, and the bundles may draw every instance of the scene; the shadow casters' behind them
+	const size_t gBufferInstanceCount = (hasDepthPrepass ? drawItems.size() : 0) +
+		(bundledItems_p != nullptr ? bundledItems_p->size() : drawItems.size());
+	const D3D12_GPU_VIRTUAL_ADDRESS instanceData = _reserveInstanceData(frameContext, gBufferInstanceCount + shadowInstanceCount);
+
+	if (m_frameGraph.shadowPass != RenderGraphInvalidIndex)
 	{
-		_clearRTV(commandList, firstPassRtvHandle, clearColor);
-		firstPassRtvHandle.Offset(1, descriptorSize);
+		barriers_p = m_renderGraph.GetBarriersBefore(m_frameGraph.shadowPass, barrierCount);
+		_recordGraphBarriers(recorder, barriers_p, barrierCount);
+
+		m_gpuProfiler->BeginPass(commandList.Get(), GPU_PASS_SHADOW_MAPS);
+		_recordShadowMaps(frameContext, recorder, packet, gBufferSet, instanceData, gBufferInstanceCount);
+		m_gpuProfiler->EndPass(commandList.Get(), GPU_PASS_SHADOW_MAPS);
+	}
+	else
+	{
+		m_lastShadowDrawCount = 0;
 	}
 
-	_clearDepthBuffer(commandList, currentRR.dsv);
+	barriers_p = m_renderGraph.GetBarriersBefore(m_frameGraph.gBufferPass, barrierCount);
+	_recordGraphBarriers(recorder, barriers_p, barrierCount);
 
-	// set SRV heap
-	ID3D12DescriptorHeap* ppHeaps[] = { srvHeap };
-	commandList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
+	FLOAT clearColor[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	if (!isGBufferPassCulled)
+	{
+		CD3DX12_CPU_DESCRIPTOR_HANDLE firstPassRtvHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(currentRR.firstPassRTV);
+		for (UINT i = 0; i < BearWindow::FirstPassRTVCount; i++)
+		{
+			recorder.ClearRenderTargetView(firstPassRtvHandle, clearColor);
+			firstPassRtvHandle.Offset(1, descriptorSize);
+		}
+
+		recorder.ClearDepthStencilView(currentRR.dsv, 1.0f);
+	}
 
-	// bind render targets
-	commandList->OMSetRenderTargets(BearWindow::FirstPassRTVCount, &currentRR.firstPassRTV, TRUE, &currentRR.dsv);
+	GBufferPassBindings gBufferBindings;
+	_getGBufferBindings(currentRR, hasDepthPrepass, gBufferBindings);
+	gBufferBindings.instanceData = instanceData;
+	BindGBufferTargets(recorder, gBufferBindings);
 
-	// Camera information needed from BearWindow
-	XMMATRIX vpMatrix, invPVMatrix;
-	window.GetCameraMatrices(vpMatrix, invPVMatrix);
+	// camera of the frame the packet was built in
+	const XMMATRIX& vpMatrix = packet.vpMatrix;
+	const XMMATRIX& invPVMatrix = packet.invPVMatrix;
 
 	// treat the texture coord:
 	// (screen space) x = 2u - 1, y = 1 - 2v
@@ -80,148 +160,764 @@ void D3D12Renderer::Render(BearWindow& window)
 
 	XMMATRIX invScreenPVMatrix = XMMatrixMultiply(matS, invPVMatrix);
 
-	if (instanceList.size() > 0)
+	// Submitted together in this order: clears, G-buffer lists, then the rest of the frame.
+	// If the G-buffer pass was not split, the whole frame stays on the first list.
+	std::vector<ComPtr<ID3D12GraphicsCommandList2>> commandLists = { commandList };
+	if (hasDepthPrepass)
 	{
-		_renderFirstPass(commandList, instanceList, vpMatrix);
+		m_gpuProfiler->BeginPass(commandList.Get(), GPU_PASS_DEPTH_PREPASS);
+		_recordDepthPrepass(frameContext, recorder, drawItems, vpMatrix, gBufferBindings);
+		m_gpuProfiler->EndPass(commandList.Get(), GPU_PASS_DEPTH_PREPASS);
 	}
-
-	// second pass: render to back buffer
-	for (UINT i = 0; i < BearWindow::FirstPassRTVCount; i++)
+	else
 	{
-		_transitionResource(commandList,
-			currentRR.resourceArray[currentBackBufferIndex * BearWindow::FirstPassRTVCount + i],
-			D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_GENERIC_READ);
+		m_lastDepthPrepassDrawCount = 0;
 	}
 
-	_transitionResource(commandList,
-		currentRR.resourceArray[currentRR.depthBufferResourceIndex],
-		D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_GENERIC_READ);
-
-	_transitionResource(commandList, currentRR.resourceArray[currentRR.backBufferResourceIndex],
-		D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
-
-	_clearRTV(commandList, currentRR.secondPassRTV, clearColor);
-	commandList->OMSetRenderTargets(1, &currentRR.secondPassRTV, FALSE, nullptr);
+	m_gpuProfiler->BeginPass(commandList.Get(), GPU_PASS_GBUFFER);
+	if (drawItems.size() > 0 && !isGBufferPassCulled)
+	{
+		_recordFirstPass(frameContext, commandList, drawItems, bundledItems_p, vpMatrix, gBufferBindings, commandLists);
+	}
+	else
+	{
+		m_lastRecordingListCount = 0;
+		m_lastDrawCount = 0;
+		m_lastInstanceCount = 0;
+	}
 
-	if (instanceList.size() > 0)
+	if (commandLists.size() > 1)
 	{
-		_renderSecondPass(commandList, invScreenPVMatrix, currentRR);
+		commandList = commandQueue->GetCommandList(frameContext.compositeAllocator);
+		recorder = D3D12CommandRecorder(commandList.Get());
+		BindGBufferTargets(recorder, gBufferBindings);
+		commandLists.push_back(commandList);
 	}
+	m_gpuProfiler->EndPass(commandList.Get(), GPU_PASS_GBUFFER);
 
-	// clean-up for next run, resource transition back to original states
-	for (UINT i = 0; i < BearWindow::FirstPassRTVCount; i++)
+	if (isLightingAsync)
 	{
-		_transitionResource(commandList,
-			currentRR.resourceArray[currentBackBufferIndex * BearWindow::FirstPassRTVCount + i],
-			D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_RENDER_TARGET);
+		// the G-buffer lists end with the transitions to the state the compute queue reads in
+		barriers_p = m_renderGraph.GetBarriersBefore(m_frameGraph.lightingHandOffPass, barrierCount);
+		_recordGraphBarriers(recorder, barriers_p, barrierCount);
+		const uint64_t gBufferFenceValue = commandQueue->ExecuteCommandLists(commandLists);
+
+		if (isCompositingPreviousFrame)
+		{
+			m_asyncScheduler->QueueCompositeWait();
+		}
+
+		// each frame in flight reads its own copy, taken from the packet
+		LightBufferAddresses lightAddresses = MeshManager::Get().UploadLights(frameSlot, packet.lights, packet.lightClusters, packet.lightIndices);
+		_submitTiledLighting(frameContext, frameSlot, currentRR, gBufferSet, lightAddresses, invScreenPVMatrix, gBufferFenceValue);
+
+		if (!isCompositingPreviousFrame)
+		{
+			m_asyncScheduler->QueueCompositeWait();
+		}
+		m_lastLightingOutput = currentRR.resourceArray[currentRR.lightingOutputResourceIndex];
+		m_lastLightingWindow_p = &window;
+
+		// second pass: the lit image into the back buffer
+		commandList = commandQueue->GetCommandList(frameContext.presentAllocator);
+		recorder = D3D12CommandRecorder(commandList.Get());
+		commandLists = { commandList };
+
+		barriers_p = m_renderGraph.GetBarriersBefore(m_frameGraph.lightingPass, barrierCount);
+		_recordGraphBarriers(recorder, barriers_p, barrierCount);
+
+		recorder.CopyResource(currentRR.resourceArray[currentRR.backBufferResourceIndex].Get(), compositeSource_p);
+		recorder.OMSetRenderTargets(1, &currentRR.secondPassRTV, FALSE, nullptr);
 	}
+	else
+	{
+		// the compute queue may still read the G-buffer set the next frame writes
+		m_asyncScheduler->QueueCompositeWait();
+		m_lastLightingOutput.Reset();
+		m_lastLightingWindow_p = nullptr;
+
+		// second pass: render to back buffer
+		barriers_p = m_renderGraph.GetBarriersBefore(m_frameGraph.lightingPass, barrierCount);
+		_recordGraphBarriers(recorder, barriers_p, barrierCount);
+
+		recorder.ClearRenderTargetView(currentRR.secondPassRTV, clearColor);
+		recorder.OMSetRenderTargets(1, &currentRR.secondPassRTV, FALSE, nullptr);
+
+		if (packet.hasScene)
+		{
+			ComPtr<ID3D12RootSignature> rootSignature;
+			ComPtr<ID3D12PipelineState> pipelineState;
+			m_shader_p->GetRSAndPSO_2ndPass(rootSignature, pipelineState);
+
+			LightingPassBindings lightingBindings;
+			lightingBindings.pipelineState_p = pipelineState.Get();
+			lightingBindings.rootSignature_p = rootSignature.Get();
+			// each frame in flight reads its own copy, taken from the packet
+			LightBufferAddresses lightAddresses = MeshManager::Get().UploadLights(frameSlot, packet.lights, packet.lightClusters, packet.lightIndices);
+			lightingBindings.lightConstants = lightAddresses.constants;
+			lightingBindings.directionalLights = lightAddresses.directionalLights;
+			lightingBindings.pointLights = lightAddresses.pointLights;
+			lightingBindings.spotLights = lightAddresses.spotLights;
+			lightingBindings.lightClusters = lightAddresses.clusters;
+			lightingBindings.lightIndices = lightAddresses.lightIndices;
+			lightingBindings.gBufferTable = currentRR.secondPassSRV;
+			lightingBindings.depthTable = currentRR.depthBufferSRV;
+			lightingBindings.shadowMapTable = _getShadowMapTable(gBufferSet);
+			lightingBindings.quadVertexBufferView = m_2ndPassVertexBufferView;
 
-	// clean-up depth buffer state
-	_transitionResource(commandList,
-		currentRR.resourceArray[currentRR.depthBufferResourceIndex],
-		D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+			m_gpuProfiler->BeginPass(commandList.Get(), GPU_PASS_LIGHTING);
+			RecordLightingPass(recorder, lightingBindings, invScreenPVMatrix);
+			m_gpuProfiler->EndPass(commandList.Get(), GPU_PASS_LIGHTING);
+		}
+	}
 
 	if (currentRR.isPhysicsEnabled == false)
 	{
-		UIManager::Get().CreateImGuiWindowContent();
-		UIManager::Get().Draw(commandList);
+		barriers_p = m_renderGraph.GetBarriersBefore(m_frameGraph.imGuiPass, barrierCount);
+		_recordGraphBarriers(recorder, barriers_p, barrierCount);
+
+		// built on the game thread, only the draw data is recorded here
+		m_gpuProfiler->BeginPass(commandList.Get(), GPU_PASS_IMGUI);
+		UIManager::Get().Draw(commandList, packet.imGuiDrawData);
+		m_gpuProfiler->EndPass(commandList.Get(), GPU_PASS_IMGUI);
 
-		_transitionResource(commandList, currentRR.resourceArray[currentRR.backBufferResourceIndex],
-			D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
+		// G-buffers and depth back to the states they wait in between frames, the back buffer to present
+		barriers_p = m_renderGraph.GetFinalBarriers(barrierCount);
+		_recordGraphBarriers(recorder, barriers_p, barrierCount);
 
 		// send command list to commandQueue
-		m_fenceValues[currentBackBufferIndex] = commandQueue->ExecuteCommandList(commandList);
+		_endFrame(commandList, frameSlot);
+		m_gpuProfiler->EndFrame(commandList.Get());
+		const uint64_t fenceValue = commandQueue->ExecuteCommandLists(commandLists);
+		m_asyncScheduler->OnFrameSubmitted(frameSlot, fenceValue);
+		m_bundleCache->OnFrameSubmitted(fenceValue);
 
 		//UIManager::Get().DrawD2DContent(currentRR);
 	}
 	else
 	{
 		// render D2D content to back buffer
-		// DO NOT TRANSIT RESOURCE TO PRESENT STATE, D2D needs it to be in render target state
-		m_fenceValues[currentBackBufferIndex] = commandQueue->ExecuteCommandList(commandList);
+		// DO NOT TRANSIT RESOURCE TO PRESENT STATE, D2D needs it to be in render target state;
+		// the graph hands the back buffer back as a render target
+		barriers_p = m_renderGraph.GetFinalBarriers(barrierCount);
+		_recordGraphBarriers(recorder, barriers_p, barrierCount);
+		_endFrame(commandList, frameSlot);
+		m_gpuProfiler->BeginPass(commandList.Get(), GPU_PASS_OVERLAY);
+		const uint64_t fenceValue = commandQueue->ExecuteCommandLists(commandLists);
+		m_bundleCache->OnFrameSubmitted(fenceValue);
+
+		UIManager::Get().DrawD2DContent(currentRR, packet.gameState, packet.overlayText);
+
+		// D3D11on12 has submitted the overlay to the same queue, so this list runs after it
+		auto overlayList = commandQueue->GetCommandList(frameContext.overlayAllocator);
+		m_gpuProfiler->EndPass(overlayList.Get(), GPU_PASS_OVERLAY);
+		m_gpuProfiler->EndFrame(overlayList.Get());
+		m_asyncScheduler->OnFrameSubmitted(frameSlot, commandQueue->ExecuteCommandList(overlayList));
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_statsMutex);
+		m_asyncComputeStats = m_asyncScheduler->GetStats();
+	}
+
+	// no wait here, the next frame waits in _beginFrame only if it is too far ahead
+	{
+		BEAR_PROFILE_ZONE("Present");
+		window.Present();
+	}
+	m_frameNumber++;
+}
+
+UINT D3D12Renderer::_beginFrame()
+{
+	BEAR_PROFILE_FUNCTION();
+
+	auto waitStart = std::chrono::high_resolution_clock::now();
+
+	bool hasWaitedForAllFrames = false;
+	if (m_pendingFramesInFlight != m_framesInFlight)
+	{
+		// slots are remapped below, let every frame in flight finish first
+		m_asyncScheduler->WaitForAllFrameSlots();
+		for (FrameContext& frameContext : m_frameContexts)
+		{
+			frameContext.hasTimestamps = false;
+		}
+		m_framesInFlight = m_pendingFramesInFlight;
+		m_lastGpuFrameEnd = 0;
+		hasWaitedForAllFrames = true;
+	}
+
+	const UINT frameSlot = static_cast<UINT>(m_frameNumber % m_framesInFlight);
+	FrameContext& frameContext = m_frameContexts[frameSlot];
+
+	// the frame that used this slot was m_framesInFlight frames ago; this is the only CPU wait on the GPU
+	m_asyncScheduler->WaitForFrameSlot(frameSlot);
+
+	double cpuWaitMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - waitStart).count();
+	double gpuIdleMilliseconds = frameContext.hasTimestamps ? _readGpuIdleMilliseconds(frameSlot) : 0.0;
+	_accumulateFramePacing(cpuWaitMilliseconds, gpuIdleMilliseconds);
 
-		UIManager::Get().DrawD2DContent(currentRR, gameState);
+	// after the wait above, every frame up to m_framesInFlight - 1 frames ago has finished
+	uint64_t completedFrames = m_frameNumber;
+	if (!hasWaitedForAllFrames)
+	{
+		completedFrames = m_frameNumber + 1 >= m_framesInFlight ? m_frameNumber + 1 - m_framesInFlight : 0;
 	}
+	m_gpuProfiler->BeginFrame(m_frameNumber, completedFrames);
+
+	return frameSlot;
+}
+
+void D3D12Renderer::_endFrame(ComPtr<ID3D12GraphicsCommandList2> commandList, UINT frameSlot)
+{
+	commandList->EndQuery(m_timestampQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, frameSlot * 2 + 1);
+	commandList->ResolveQueryData(m_timestampQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP,
+		frameSlot * 2, 2, m_timestampReadbackBuffer.Get(), frameSlot * 2 * sizeof(uint64_t));
+
+	m_frameContexts[frameSlot].hasTimestamps = true;
+}
+
+double D3D12Renderer::_readGpuIdleMilliseconds(UINT frameSlot)
+{
+	D3D12_RANGE readRange = { frameSlot * 2 * sizeof(uint64_t), (frameSlot * 2 + 2) * sizeof(uint64_t) };
+	D3D12_RANGE writeRange = { 0, 0 };
+
+	uint64_t* timestamps_p = nullptr;
+	ThrowIfFailed(m_timestampReadbackBuffer->Map(0, &readRange, reinterpret_cast<void**>(&timestamps_p)));
+	uint64_t frameStart = timestamps_p[frameSlot * 2];
+	uint64_t frameEnd = timestamps_p[frameSlot * 2 + 1];
+	m_timestampReadbackBuffer->Unmap(0, &writeRange);
+
+	// slots are read in frame order, so the previous read is the previous frame
+	double idleMilliseconds = 0.0;
+	if (m_lastGpuFrameEnd != 0 && frameStart > m_lastGpuFrameEnd)
+	{
+		idleMilliseconds = static_cast<double>(frameStart - m_lastGpuFrameEnd) * 1000.0 / static_cast<double>(m_timestampFrequency);
+	}
+	m_lastGpuFrameEnd = frameEnd;
+
+	return idleMilliseconds;
+}
+
+void D3D12Renderer::_accumulateFramePacing(double cpuWaitMilliseconds, double gpuIdleMilliseconds)
+{
+	m_pacingClock.Tick();
+	m_pacingWindowInSeconds += m_pacingClock.GetDeltaSeconds();
+	m_accumulatedCpuWaitMilliseconds += cpuWaitMilliseconds;
+	m_accumulatedGpuIdleMilliseconds += gpuIdleMilliseconds;
+	m_accumulatedFrames++;
+
+	if (m_pacingWindowInSeconds < 1.0)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_statsMutex);
+	m_pacingStats.frameMilliseconds = m_pacingWindowInSeconds * 1000.0 / m_accumulatedFrames;
+	m_pacingStats.cpuWaitMilliseconds = m_accumulatedCpuWaitMilliseconds / m_accumulatedFrames;
+	m_pacingStats.gpuIdleMilliseconds = m_accumulatedGpuIdleMilliseconds / m_accumulatedFrames;
+	m_pacingStats.framesInFlight = m_framesInFlight;
+	m_pacingStats.firstPassRecordMilliseconds = m_accumulatedRecordMilliseconds / m_accumulatedFrames;
+	m_pacingStats.firstPassCommandLists = m_lastRecordingListCount;
+	m_pacingStats.firstPassDrawCalls = m_lastDrawCount;
+	m_pacingStats.firstPassInstances = m_lastInstanceCount;
+	m_pacingStats.depthPrepassDrawCalls = m_lastDepthPrepassDrawCount;
+	m_pacingStats.shadowCascadesRendered = m_lastShadowCascadesRendered;
+	m_pacingStats.shadowCascadesKept = m_lastShadowCascadesKept;
+	m_pacingStats.shadowDrawCalls = m_lastShadowDrawCount;
+
+	m_pacingWindowInSeconds = 0.0;
+	m_accumulatedCpuWaitMilliseconds = 0.0;
+	m_accumulatedGpuIdleMilliseconds = 0.0;
+	m_accumulatedRecordMilliseconds = 0.0;
+	m_accumulatedFrames = 0;
+}
+
+void D3D12Renderer::_buildFrameGraph(const RenderResource& currentRR, bool p_hasScene, unsigned int p_gBufferSet, bool p_hasShadowPass,
+	ID3D12Resource* p_compositeSource_p)
+{
+	static const char* gBufferTargetNames[BearWindow::FirstPassRTVCount] = { "albedo and specular", "normal" };
+
+	m_renderGraph.Reset();
+	m_graphResources.clear();
+
+	// between frames in the state the compute queue reads them in, see BearWindow::_updateRTVAndDSV
+	for (UINT i = 0; i < BearWindow::FirstPassRTVCount; i++)
+	{
+		m_frameGraph.gBufferTargets[i] = m_renderGraph.ImportResource(gBufferTargetNames[i],
+			RENDER_GRAPH_STATE_NON_PIXEL_SHADER_RESOURCE, RENDER_GRAPH_STATE_NON_PIXEL_SHADER_RESOURCE, false);
+		m_graphResources.push_back(currentRR.resourceArray[currentRR.firstPassResourceStartIndex + i].Get());
+	}
+
+	m_frameGraph.depthBuffer = m_renderGraph.ImportResource("depth",
+		RENDER_GRAPH_STATE_NON_PIXEL_SHADER_RESOURCE, RENDER_GRAPH_STATE_NON_PIXEL_SHADER_RESOURCE, false);
+	m_graphResources.push_back(currentRR.resourceArray[currentRR.depthBufferResourceIndex].Get());
+
+	// the lighting reads the cascades whether this frame drew them or an earlier one did
+	m_frameGraph.shadowMaps = m_renderGraph.ImportResource("shadow maps",
+		RENDER_GRAPH_STATE_NON_PIXEL_SHADER_RESOURCE, RENDER_GRAPH_STATE_NON_PIXEL_SHADER_RESOURCE, false);
+	m_graphResources.push_back(m_shadowMaps[p_gBufferSet].Get());
 
-	currentBackBufferIndex = window.Present(); // it has moved to next buffer
-	commandQueue->WaitForFenceValue(m_fenceValues[currentBackBufferIndex]);
+	// the D2D overlay of the demo window draws after the frame and presents by itself
+	const uint32_t backBufferFinalState = currentRR.isPhysicsEnabled ? RENDER_GRAPH_STATE_RENDER_TARGET : RENDER_GRAPH_STATE_PRESENT;
+	m_frameGraph.backBuffer = m_renderGraph.ImportResource("back buffer", RENDER_GRAPH_STATE_PRESENT, backBufferFinalState, true);
+	m_graphResources.push_back(currentRR.resourceArray[currentRR.backBufferResourceIndex].Get());
+
+	m_frameGraph.shadowPass = RenderGraphInvalidIndex;
+	if (p_hasShadowPass)
+	{
+		m_frameGraph.shadowPass = m_renderGraph.AddPass("shadow maps");
+		m_renderGraph.Write(m_frameGraph.shadowPass, m_frameGraph.shadowMaps, RENDER_GRAPH_STATE_DEPTH_WRITE);
+	}
+
+	// may be split across the recording pool
+	m_frameGraph.gBufferPass = m_renderGraph.AddPass("G-buffer", RENDER_GRAPH_PASS_OWN_COMMAND_LISTS);
+	for (UINT i = 0; i < BearWindow::FirstPassRTVCount; i++)
+	{
+		m_renderGraph.Write(m_frameGraph.gBufferPass, m_frameGraph.gBufferTargets[i], RENDER_GRAPH_STATE_RENDER_TARGET);
+	}
+	m_renderGraph.Write(m_frameGraph.gBufferPass, m_frameGraph.depthBuffer, RENDER_GRAPH_STATE_DEPTH_WRITE);
+
+	m_frameGraph.lightingOutput = RenderGraphInvalidIndex;
+	m_frameGraph.lightingHandOffPass = RenderGraphInvalidIndex;
+	if (p_compositeSource_p != nullptr)
+	{
+		// The compute queue lights the G-buffer once the direct queue's lists up to here have run;
+		// nothing is recorded for it on the direct queue but the transitions to what it reads.
+		m_frameGraph.lightingHandOffPass = m_renderGraph.AddPass("lighting hand-off",
+			RENDER_GRAPH_PASS_OWN_COMMAND_LISTS | RENDER_GRAPH_PASS_SIDE_EFFECTS);
+		for (UINT i = 0; i < BearWindow::FirstPassRTVCount; i++)
+		{
+			m_renderGraph.Read(m_frameGraph.lightingHandOffPass, m_frameGraph.gBufferTargets[i], RENDER_GRAPH_STATE_NON_PIXEL_SHADER_RESOURCE);
+		}
+		m_renderGraph.Read(m_frameGraph.lightingHandOffPass, m_frameGraph.depthBuffer, RENDER_GRAPH_STATE_NON_PIXEL_SHADER_RESOURCE);
+		m_renderGraph.Read(m_frameGraph.lightingHandOffPass, m_frameGraph.shadowMaps, RENDER_GRAPH_STATE_NON_PIXEL_SHADER_RESOURCE);
+
+		// written by the compute queue, which leaves it as an unordered access view
+		m_frameGraph.lightingOutput = m_renderGraph.ImportResource("lit image",
+			RENDER_GRAPH_STATE_UNORDERED_ACCESS, RENDER_GRAPH_STATE_UNORDERED_ACCESS, false);
+		m_graphResources.push_back(p_compositeSource_p);
+
+		m_frameGraph.lightingPass = m_renderGraph.AddPass("composite");
+		m_renderGraph.Read(m_frameGraph.lightingPass, m_frameGraph.lightingOutput, RENDER_GRAPH_STATE_COPY_SOURCE);
+		m_renderGraph.Write(m_frameGraph.lightingPass, m_frameGraph.backBuffer, RENDER_GRAPH_STATE_COPY_DEST);
+	}
+	else
+	{
+		// clears the back buffer, and lights the scene if there is one
+		m_frameGraph.lightingPass = m_renderGraph.AddPass("lighting");
+		if (p_hasScene)
+		{
+			for (UINT i = 0; i < BearWindow::FirstPassRTVCount; i++)
+			{
+				m_renderGraph.Read(m_frameGraph.lightingPass, m_frameGraph.gBufferTargets[i], RENDER_GRAPH_STATE_PIXEL_SHADER_RESOURCE);
+			}
+			m_renderGraph.Read(m_frameGraph.lightingPass, m_frameGraph.depthBuffer, RENDER_GRAPH_STATE_PIXEL_SHADER_RESOURCE);
+			m_renderGraph.Read(m_frameGraph.lightingPass, m_frameGraph.shadowMaps, RENDER_GRAPH_STATE_PIXEL_SHADER_RESOURCE);
+		}
+		m_renderGraph.Write(m_frameGraph.lightingPass, m_frameGraph.backBuffer, RENDER_GRAPH_STATE_RENDER_TARGET);
+	}
+
+	m_frameGraph.imGuiPass = RenderGraphInvalidIndex;
+	if (currentRR.isPhysicsEnabled == false)
+	{
+		m_frameGraph.imGuiPass = m_renderGraph.AddPass("ImGui");
+		m_renderGraph.Write(m_frameGraph.imGuiPass, m_frameGraph.backBuffer, RENDER_GRAPH_STATE_RENDER_TARGET);
+	}
+
+	// the description above is the same every frame, so this only fails if it is wrong
+	if (!m_renderGraph.Compile())
+	{
+		ThrowIfFailed(E_FAIL);
+	}
+
+	std::lock_guard<std::mutex> lock(m_statsMutex);
+	m_renderGraphStats = m_renderGraph.GetStats();
+}
+
+static D3D12_RESOURCE_STATES _toResourceStates(uint32_t p_state)
+{
+	static const struct
+	{
+		uint32_t graphState;
+		D3D12_RESOURCE_STATES resourceState;
+	} stateMap[] =
+	{
+		{ RENDER_GRAPH_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_RENDER_TARGET },
+		{ RENDER_GRAPH_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_DEPTH_WRITE },
+		{ RENDER_GRAPH_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS },
+		{ RENDER_GRAPH_STATE_COPY_DEST, D3D12_RESOURCE_STATE_COPY_DEST },
+		{ RENDER_GRAPH_STATE_DEPTH_READ, D3D12_RESOURCE_STATE_DEPTH_READ },
+		{ RENDER_GRAPH_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE },
+		{ RENDER_GRAPH_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE },
+		{ RENDER_GRAPH_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_COPY_SOURCE }
+	};
+
+	// present is common in D3D12
+	D3D12_RESOURCE_STATES resourceState = D3D12_RESOURCE_STATE_COMMON;
+	for (const auto& entry : stateMap)
+	{
+		if ((p_state & entry.graphState) != 0)
+		{
+			resourceState |= entry.resourceState;
+		}
+	}
+	return resourceState;
 }
 
-void D3D12Renderer::_transitionResource(
-	ComPtr<ID3D12GraphicsCommandList2> commandList,
-	ComPtr<ID3D12Resource> resource,
-	D3D12_RESOURCE_STATES beforeState,
-	D3D12_RESOURCE_STATES afterState)
+void D3D12Renderer::_recordGraphBarriers(CommandRecorder& recorder, const RenderGraphBarrier* p_barriers_p, size_t p_count)
 {
-	CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-		resource.Get(),
-		beforeState, afterState);
+	if (p_count == 0)
+	{
+		return;
+	}
+
+	m_graphBarriers.clear();
+	for (size_t i = 0; i < p_count; i++)
+	{
+		const RenderGraphBarrier& barrier = p_barriers_p[i];
+		if (barrier.type == RENDER_GRAPH_BARRIER_ALIASING)
+		{
+			ID3D12Resource* resourceBefore_p = barrier.resourceBefore != RenderGraphInvalidIndex ? m_graphResources[barrier.resourceBefore] : nullptr;
+			m_graphBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(resourceBefore_p, m_graphResources[barrier.resource]));
+			continue;
+		}
 
-	commandList->ResourceBarrier(1, &barrier);
+		D3D12_RESOURCE_BARRIER_FLAGS flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+		if (barrier.split == RENDER_GRAPH_SPLIT_BEGIN)
+		{
+			flags = D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY;
+		}
+		else if (barrier.split == RENDER_GRAPH_SPLIT_END)
+		{
+			flags = D3D12_RESOURCE_BARRIER_FLAG_END_ONLY;
+		}
+
+		m_graphBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(m_graphResources[barrier.resource],
+			_toResourceStates(barrier.stateBefore), _toResourceStates(barrier.stateAfter),
+			D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, flags));
+	}
+
+	recorder.ResourceBarrier(static_cast<UINT>(m_graphBarriers.size()), m_graphBarriers.data());
 }
 
-// Clear a render target view.
-void D3D12Renderer::_clearRTV(
-	ComPtr<ID3D12GraphicsCommandList2> commandList,
-	D3D12_CPU_DESCRIPTOR_HANDLE rtv,
-	FLOAT* clearColor)
+void D3D12Renderer::_submitTiledLighting(FrameContext& frameContext, UINT frameSlot, const RenderResource& currentRR, unsigned int gBufferSet,
+	const LightBufferAddresses& lightAddresses, const XMMATRIX& invScreenPVMatrix, uint64_t gBufferFenceValue)
 {
-	commandList->ClearRenderTargetView(rtv, clearColor, 0, nullptr);
+	BEAR_PROFILE_FUNCTION();
+
+	static ID3D12DescriptorHeap* srvHeap = Application::Get().GetSRVHeap();
+	auto computeQueue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COMPUTE);
+
+	ComPtr<ID3D12RootSignature> rootSignature;
+	ComPtr<ID3D12PipelineState> pipelineState;
+	m_shader_p->GetRSAndPSO_TiledLighting(rootSignature, pipelineState);
+
+	const D3D12_RESOURCE_DESC outputDesc = currentRR.resourceArray[currentRR.lightingOutputResourceIndex]->GetDesc();
+
+	TiledLightingBindings bindings;
+	bindings.pipelineState_p = pipelineState.Get();
+	bindings.rootSignature_p = rootSignature.Get();
+	bindings.srvHeap_p = srvHeap;
+	bindings.lightConstants = lightAddresses.constants;
+	bindings.directionalLights = lightAddresses.directionalLights;
+	bindings.pointLights = lightAddresses.pointLights;
+	bindings.spotLights = lightAddresses.spotLights;
+	bindings.gBufferTable = currentRR.secondPassSRV;
+	bindings.depthTable = currentRR.depthBufferSRV;
+	bindings.shadowMapTable = _getShadowMapTable(gBufferSet);
+	bindings.outputTable = currentRR.lightingOutputUAV;
+	bindings.width = static_cast<UINT>(outputDesc.Width);
+	bindings.height = outputDesc.Height;
+
+	auto computeList = computeQueue->GetCommandList(frameContext.computeAllocator);
+	D3D12CommandRecorder recorder(computeList.Get());
+	RecordTiledLightingPass(recorder, bindings, invScreenPVMatrix);
+
+	// GPU timestamps are per queue, so the lighting is not timed by m_gpuProfiler here
+	m_asyncScheduler->QueueLightingWait(gBufferFenceValue);
+	m_asyncScheduler->OnLightingSubmitted(frameSlot, computeQueue->ExecuteCommandList(computeList));
 }
 
-// Clear the depth of a depth-stencil view.
-void D3D12Renderer::_clearDepthBuffer(
-	ComPtr<ID3D12GraphicsCommandList2> commandList,
-	D3D12_CPU_DESCRIPTOR_HANDLE dsv,
-	FLOAT depth)
+unsigned int D3D12Renderer::_selectShadowCascades(const FramePacket& packet, unsigned int gBufferSet, size_t& out_instanceCount)
 {
-	commandList->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH, depth, 0, 0, nullptr);
+	BEAR_PROFILE_FUNCTION();
+
+	// read once, the game thread may flip it while the frame is recorded;
+	// while it is off every cascade is drawn, and nothing drawn before is trusted afterwards
+	if (!m_isShadowCachingEnabled)
+	{
+		m_shadowMapCache.Invalidate();
+	}
+
+	const unsigned int cascadeCount = packet.lights.constants.NumOfShadowCascades;
+	unsigned int drawnCount = 0;
+	out_instanceCount = 0;
+	for (unsigned int cascade = 0; cascade < ShadowCascadeCount; cascade++)
+	{
+		m_isShadowCascadeDrawn[cascade] = false;
+		if (cascade >= cascadeCount)
+		{
+			continue;
+		}
+
+		const ShadowCascade& shadowCascade = packet.shadowCascades[cascade];
+		m_shadowCasterRevisions.clear();
+		for (uint32_t caster : shadowCascade.casters)
+		{
+			m_shadowCasterRevisions.push_back(packet.shadowCasters[caster].revision);
+		}
+
+		if (m_shadowMapCache.Update(gBufferSet, cascade, shadowCascade.viewProjection, m_shadowCasterRevisions))
+		{
+			m_isShadowCascadeDrawn[cascade] = true;
+			out_instanceCount += shadowCascade.casters.size();
+			drawnCount++;
+		}
+	}
+
+	m_lastShadowCascadesRendered = drawnCount;
+	m_lastShadowCascadesKept = cascadeCount - drawnCount;
+	return drawnCount;
 }
 
-void D3D12Renderer::_renderFirstPass(ComPtr<ID3D12GraphicsCommandList2> commandList, const std::vector<Instance*>& instanceList, const XMMATRIX& vpMatrix)
+void D3D12Renderer::_recordShadowMaps(FrameContext& frameContext, CommandRecorder& recorder, const FramePacket& packet,
+	unsigned int gBufferSet, D3D12_GPU_VIRTUAL_ADDRESS instanceData, size_t instanceOffset)
 {
+	BEAR_PROFILE_FUNCTION();
+
+	static const unsigned int dsvIncrementSize = Application::Get().GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
+
 	ComPtr<ID3D12RootSignature> rootSignature;
 	ComPtr<ID3D12PipelineState> pipelineState;
-	m_shader_p->GetRSAndPSO_1stPass(rootSignature, pipelineState);
+	m_shader_p->GetRSAndPSO_ShadowMap(rootSignature, pipelineState);
 
-	commandList->SetPipelineState(pipelineState.Get());
-	commandList->SetGraphicsRootSignature(rootSignature.Get());
+	ShadowPassBindings bindings;
+	bindings.pipelineState_p = pipelineState.Get();
+	bindings.rootSignature_p = rootSignature.Get();
+	bindings.viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, static_cast<float>(ShadowCascades::Resolution), static_cast<float>(ShadowCascades::Resolution));
+	bindings.scissorRect = m_scissorRect;
 
-	for (Instance* instance_p : instanceList)
+	m_lastShadowDrawCount = 0;
+	for (unsigned int cascade = 0; cascade < ShadowCascadeCount; cascade++)
 	{
-		// call mesh class to render it
-		if (instance_p->isRenderable)
+		if (!m_isShadowCascadeDrawn[cascade])
 		{
-			instance_p->Render(commandList, vpMatrix);
+			continue;
 		}
+
+		// the packet's casters are in batch order, and a cascade's indices increase, so its casters are too
+		const ShadowCascade& shadowCascade = packet.shadowCascades[cascade];
+		m_shadowCascadeItems.clear();
+		for (uint32_t caster : shadowCascade.casters)
+		{
+			frameContext.instanceData_p[instanceOffset + m_shadowCascadeItems.size()] = packet.shadowCasters[caster].constants;
+			m_shadowCascadeItems.push_back(packet.shadowCasters[caster]);
+		}
+		BuildDrawBatches(m_shadowCascadeItems, m_shadowDrawBatches);
+
+		bindings.depthStencil = CD3DX12_CPU_DESCRIPTOR_HANDLE(m_shadowMapDsvHeap->GetCPUDescriptorHandleForHeapStart(),
+			gBufferSet * ShadowCascadeCount + cascade, dsvIncrementSize);
+		bindings.instanceData = instanceData + instanceOffset * sizeof(VertexShaderInput);
+
+		// a cascade without casters is still cleared, one may have left it
+		const XMFLOAT4X4 viewProjection(shadowCascade.viewProjection);
+		RecordShadowCascade(recorder, bindings, XMLoadFloat4x4(&viewProjection), m_shadowDrawBatches);
+
+		instanceOffset += m_shadowCascadeItems.size();
+		m_lastShadowDrawCount += static_cast<unsigned int>(m_shadowDrawBatches.size());
 	}
 }
 
-void D3D12Renderer::_renderSecondPass(ComPtr<ID3D12GraphicsCommandList2> commandList, const XMMATRIX& invSPVMatrix, const RenderResource& currentRR)
+D3D12_GPU_DESCRIPTOR_HANDLE D3D12Renderer::_getShadowMapTable(unsigned int gBufferSet) const
 {
+	return Application::Get().GetSRVHeapGPUHandle(m_shadowMapOffsetInSRVHeap + gBufferSet);
+}
+
+void D3D12Renderer::_getGBufferBindings(const RenderResource& currentRR, bool hasDepthPrepass, GBufferPassBindings& out_bindings)
+{
+	static ID3D12DescriptorHeap* srvHeap = Application::Get().GetSRVHeap();
+
 	ComPtr<ID3D12RootSignature> rootSignature;
 	ComPtr<ID3D12PipelineState> pipelineState;
-	m_shader_p->GetRSAndPSO_2ndPass(rootSignature, pipelineState);
+	ComPtr<ID3D12PipelineState> depthPrepassPipelineState;
+	if (hasDepthPrepass)
+	{
+		m_shader_p->GetRSAndPSO_1stPassDepthEqual(rootSignature, pipelineState);
+		m_shader_p->GetRSAndPSO_DepthPrepass(rootSignature, depthPrepassPipelineState);
+	}
+	else
+	{
+		m_shader_p->GetRSAndPSO_1stPass(rootSignature, pipelineState);
+	}
+
+	// the shader keeps them alive until it is rebuilt, which only happens while no frame is rendered
+	out_bindings.pipelineState_p = pipelineState.Get();
+	out_bindings.depthPrepassPipelineState_p = depthPrepassPipelineState.Get();
+	out_bindings.rootSignature_p = rootSignature.Get();
+	out_bindings.srvHeap_p = srvHeap;
+	out_bindings.viewport = currentRR.viewport;
+	out_bindings.scissorRect = m_scissorRect;
+	out_bindings.renderTargets = currentRR.firstPassRTV;
+	out_bindings.renderTargetCount = BearWindow::FirstPassRTVCount;
+	out_bindings.depthStencil = currentRR.dsv;
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS D3D12Renderer::_reserveInstanceData(FrameContext& frameContext, size_t instanceCount)
+{
+	if (instanceCount > frameContext.instanceCapacity)
+	{
+		auto device = Application::Get().GetDevice();
+
+		if (frameContext.instanceBuffer)
+		{
+			frameContext.instanceBuffer->Unmap(0, nullptr);
+			MemoryTracker::Get().UntrackResource(frameContext.instanceBuffer.Get());
+			frameContext.instanceBuffer.Reset();
+		}
+
+		// grow geometrically, so a scene that keeps growing does not reallocate every frame
+		frameContext.instanceCapacity = std::max<size_t>(std::max<size_t>(instanceCount, frameContext.instanceCapacity * 2), 256);
+
+		CD3DX12_HEAP_PROPERTIES heapUpload = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+		CD3DX12_RESOURCE_DESC bufferUpload = CD3DX12_RESOURCE_DESC::Buffer(frameContext.instanceCapacity * sizeof(VertexShaderInput));
+		ThrowIfFailed(device->CreateCommittedResource(
+			&heapUpload,
+			D3D12_HEAP_FLAG_NONE,
+			&bufferUpload,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(&frameContext.instanceBuffer)));
+
+		// written only, never read back
+		D3D12_RANGE readRange = { 0, 0 };
+		ThrowIfFailed(frameContext.instanceBuffer->Map(0, &readRange, reinterpret_cast<void**>(&frameContext.instanceData_p)));
+		MemoryTracker::Get().TrackResource(GPU_MEMORY_CONSTANT, frameContext.instanceBuffer.Get());
+	}
+
+	return frameContext.instanceBuffer ? frameContext.instanceBuffer->GetGPUVirtualAddress() : 0;
+}
+
+void D3D12Renderer::_recordDepthPrepass(FrameContext& frameContext, CommandRecorder& recorder,
+	const std::vector<DrawItem>& drawItems, const XMMATRIX& vpMatrix, const GBufferPassBindings& bindings)
+{
+	BEAR_PROFILE_FUNCTION();
 
-	commandList->SetPipelineState(pipelineState.Get());
-	// sharing the same root signature for both passes
-	commandList->SetGraphicsRootSignature(rootSignature.Get());
+	// in the render queue's order, front to back, which is what rejects the most in the prepass;
+	// bundles lay their transforms out per cell, _recordFirstPass puts them behind these
+	for (size_t i = 0; i < drawItems.size(); i++)
+	{
+		frameContext.instanceData_p[i] = drawItems[i].constants;
+	}
+	BuildDrawBatches(drawItems, m_drawBatches);
+
+	// on one list, before any G-buffer list of the frame: those test against the final depth
+	RecordDepthPrepass(recorder, bindings, vpMatrix, m_drawBatches, 0, m_drawBatches.size());
+	m_lastDepthPrepassDrawCount = static_cast<unsigned int>(m_drawBatches.size());
+}
+
+void D3D12Renderer::_recordFirstPass(FrameContext& frameContext, ComPtr<ID3D12GraphicsCommandList2> mainCommandList,
+	const std::vector<DrawItem>& drawItems, const std::vector<DrawItem>* bundledItems_p, const XMMATRIX& vpMatrix,
+	const GBufferPassBindings& bindings, std::vector<ComPtr<ID3D12GraphicsCommandList2>>& out_commandLists)
+{
+	BEAR_PROFILE_FUNCTION();
+
+	auto recordStart = std::chrono::high_resolution_clock::now();
 
-	// set light info here;
-	commandList->SetGraphicsRootConstantBufferView(0, MeshManager::Get().GetLightCBVGPUAddress());
+	D3D12CommandRecorder mainRecorder(mainCommandList.Get());
 
-	SecondPassRootConstants sprc = {};
-	sprc.invScreenPVMatrix = invSPVMatrix;
-	commandList->SetGraphicsRoot32BitConstants(3, sizeof(sprc) / 4, &sprc, 0);
+	if (bundledItems_p != nullptr)
+	{
+		auto commandQueue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT);
 
-	commandList->SetGraphicsRootDescriptorTable(1, currentRR.secondPassSRV);
+		// the bundles bind the pipeline state they were recorded with, so switching the depth prepass records them again
+		ComPtr<ID3D12RootSignature> rootSignature;
+		ComPtr<ID3D12PipelineState> pipelineState;
+		if (bindings.depthPrepassPipelineState_p != nullptr)
+		{
+			m_shader_p->GetRSAndPSO_1stPassDepthEqual(rootSignature, pipelineState);
+		}
+		else
+		{
+			m_shader_p->GetRSAndPSO_1stPass(rootSignature, pipelineState);
+		}
+
+		m_bundleCache->Update(*bundledItems_p, rootSignature, pipelineState, bindings.srvHeap_p, *m_recordingPool, *commandQueue);
+
+		// the cells are culled as a whole: bundles of cells in view draw all their members
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection, vpMatrix);
+		const FrustumPlanes frustumPlanes = FrustumCuller::ExtractPlanes(&viewProjection.m[0][0]);
+
+		// the depth prepass holds the first drawItems.size() transforms
+		const size_t instanceOffset = bindings.depthPrepassPipelineState_p != nullptr ? drawItems.size() : 0;
+		SetGBufferPassState(mainRecorder, bindings, vpMatrix);
+		const size_t drawnInstances = m_bundleCache->Execute(mainRecorder, frustumPlanes,
+			bindings.instanceData + instanceOffset * sizeof(VertexShaderInput), frameContext.instanceData_p + instanceOffset);
+		{
+			std::lock_guard<std::mutex> lock(m_statsMutex);
+			m_bundleCacheStats = m_bundleCache->GetStats();
+		}
+
+		m_accumulatedRecordMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count();
+		m_lastRecordingListCount = 1;
+		m_lastDrawCount = m_bundleCache->GetStats().drawCalls;
+		m_lastInstanceCount = static_cast<unsigned int>(drawnInstances);
+		return;
+	}
 
-	// Depth
-	commandList->SetGraphicsRootDescriptorTable(2, currentRR.depthBufferSRV);
+	// bundles may still be in flight, they are released through OnFrameSubmitted
+	m_bundleCache->Clear();
+	{
+		std::lock_guard<std::mutex> lock(m_statsMutex);
+		m_bundleCacheStats = BundleCacheStats();
+	}
+
+	// a batch finds its instances at firstInstance, which is the index of its first item;
+	// the depth prepass has filled both the same way already
+	if (bindings.depthPrepassPipelineState_p == nullptr)
+	{
+		for (size_t i = 0; i < drawItems.size(); i++)
+		{
+			frameContext.instanceData_p[i] = drawItems[i].constants;
+		}
+		BuildDrawBatches(drawItems, m_drawBatches);
+	}
+
+	const size_t batchCount = m_drawBatches.size();
+	const UINT listCount = static_cast<UINT>(GetRecordingListCount(batchCount, frameContext.recordingAllocators.size()));
+
+	if (listCount == 1)
+	{
+		RecordGBufferDraws(mainRecorder, bindings, vpMatrix, m_drawBatches, 0, batchCount);
+	}
+	else
+	{
+		auto commandQueue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT);
+		const size_t chunkSize = GetRecordingChunkSize(batchCount, listCount);
+		std::vector<ComPtr<ID3D12GraphicsCommandList2>> recordingLists(listCount);
+
+		// every list starts from a clean state, so each one binds the targets again
+		m_recordingPool->Dispatch(listCount, [&](unsigned int listIndex)
+			{
+				auto commandList = commandQueue->GetCommandList(frameContext.recordingAllocators[listIndex]);
+				D3D12CommandRecorder recorder(commandList.Get());
+				BindGBufferTargets(recorder, bindings);
+
+				size_t firstBatch = listIndex * chunkSize;
+				size_t endBatch = std::min<size_t>(firstBatch + chunkSize, batchCount);
+				RecordGBufferDraws(recorder, bindings, vpMatrix, m_drawBatches, firstBatch, endBatch);
+
+				recordingLists[listIndex] = commandList;
+			});
+
+		out_commandLists.insert(out_commandLists.end(), recordingLists.begin(), recordingLists.end());
+	}
 
-	commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-	commandList->IASetVertexBuffers(0, 1, &m_2ndPassVertexBufferView);
-	commandList->DrawInstanced(4, 1, 0, 0);
+	m_accumulatedRecordMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count();
+	m_lastRecordingListCount = listCount;
+	m_lastDrawCount = static_cast<unsigned int>(batchCount);
+	m_lastInstanceCount = static_cast<unsigned int>(drawItems.size());
 }
 
 void D3D12Renderer::_prepare2ndPassResources()
@@ -261,4 +957,108 @@ void D3D12Renderer::_prepare2ndPassResources()
 	m_2ndPassVertexBufferView.BufferLocation = m_2ndPassVertexBuffer->GetGPUVirtualAddress();
 	m_2ndPassVertexBufferView.StrideInBytes = sizeof(SecondPassVertexData);
 	m_2ndPassVertexBufferView.SizeInBytes = sizeof(quadVertices);
+}
+
+void D3D12Renderer::_prepareShadowMaps()
+{
+	Application& app = Application::Get();
+	auto device = app.GetDevice();
+
+	// typeless, so the lighting can read the depth through an R16_UNORM view
+	CD3DX12_HEAP_PROPERTIES heapDefault = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+	CD3DX12_RESOURCE_DESC shadowMapDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R16_TYPELESS,
+		ShadowCascades::Resolution, ShadowCascades::Resolution, ShadowCascadeCount, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
+
+	D3D12_CLEAR_VALUE optimizedClearValue = {};
+	optimizedClearValue.Format = ShadowMapFormat;
+	optimizedClearValue.DepthStencil = { 1.0f, 0 };
+
+	D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+	dsvDesc.Format = ShadowMapFormat;
+	dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2DARRAY;
+	dsvDesc.Texture2DArray.ArraySize = 1;
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = DXGI_FORMAT_R16_UNORM;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Texture2DArray.MipLevels = 1;
+	srvDesc.Texture2DArray.ArraySize = ShadowCascadeCount;
+
+	m_shadowMapDsvHeap = app.CreateDescriptorHeap(BearWindow::GBufferSetCount * ShadowCascadeCount, D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
+	m_shadowMapOffsetInSRVHeap = app.AllocateInSRVHeap(BearWindow::GBufferSetCount);
+
+	static const unsigned int dsvIncrementSize = app.GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
+	CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle(m_shadowMapDsvHeap->GetCPUDescriptorHandleForHeapStart());
+
+	// between frames in the state the compute queue reads them in, like the G-buffers;
+	// every cascade of a set is drawn before the lighting first reads it, see ShadowMapCache
+	for (UINT set = 0; set < BearWindow::GBufferSetCount; set++)
+	{
+		ThrowIfFailed(device->CreateCommittedResource(
+			&heapDefault,
+			D3D12_HEAP_FLAG_NONE,
+			&shadowMapDesc,
+			D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+			&optimizedClearValue,
+			IID_PPV_ARGS(&m_shadowMaps[set])));
+		MemoryTracker::Get().TrackResource(GPU_MEMORY_RENDER_TARGET, m_shadowMaps[set].Get());
+
+		for (UINT cascade = 0; cascade < ShadowCascadeCount; cascade++)
+		{
+			dsvDesc.Texture2DArray.FirstArraySlice = cascade;
+			device->CreateDepthStencilView(m_shadowMaps[set].Get(), &dsvDesc, dsvHandle);
+			dsvHandle.Offset(1, dsvIncrementSize);
+		}
+
+		device->CreateShaderResourceView(m_shadowMaps[set].Get(), &srvDesc, app.GetSRVHeapCPUHandle(m_shadowMapOffsetInSRVHeap + set));
+	}
+}
+
+void D3D12Renderer::_prepareFrameContexts()
+{
+	auto device = Application::Get().GetDevice();
+	auto commandQueue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT);
+	auto computeQueue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COMPUTE);
+
+	for (FrameContext& frameContext : m_frameContexts)
+	{
+		frameContext.commandAllocator = commandQueue->CreateCommandAllocator();
+		frameContext.compositeAllocator = commandQueue->CreateCommandAllocator();
+		frameContext.computeAllocator = computeQueue->CreateCommandAllocator();
+		frameContext.presentAllocator = commandQueue->CreateCommandAllocator();
+		frameContext.overlayAllocator = commandQueue->CreateCommandAllocator();
+
+		frameContext.recordingAllocators.resize(m_recordingPool->GetThreadCount() + 1);
+		for (auto& recordingAllocator : frameContext.recordingAllocators)
+		{
+			recordingAllocator = commandQueue->CreateCommandAllocator();
+		}
+	}
+
+	D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+	queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+	queryHeapDesc.Count = MaxFramesInFlight * 2;
+	ThrowIfFailed(device->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&m_timestampQueryHeap)));
+
+	CD3DX12_HEAP_PROPERTIES heapReadback = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+	CD3DX12_RESOURCE_DESC bufferReadback = CD3DX12_RESOURCE_DESC::Buffer(MaxFramesInFlight * 2 * sizeof(uint64_t));
+	ThrowIfFailed(device->CreateCommittedResource(
+		&heapReadback,
+		D3D12_HEAP_FLAG_NONE,
+		&bufferReadback,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(&m_timestampReadbackBuffer)));
+
+	ThrowIfFailed(commandQueue->GetD3D12CommandQueue()->GetTimestampFrequency(&m_timestampFrequency));
+
+	// a frame slot is only reused once its frame has finished, so the ring never drops results
+	m_gpuProfiler = std::make_unique<GpuProfiler>(
+		std::make_unique<D3D12TimestampBackend>(device, commandQueue->GetD3D12CommandQueue()), MaxFramesInFlight);
+
+	// the queues are owned by Application and outlive the renderer
+	m_asyncScheduler = std::make_unique<AsyncComputeScheduler>(*commandQueue, *computeQueue, MaxFramesInFlight);
+
+	m_pacingClock.Reset();
 }
\ No newline at end of file
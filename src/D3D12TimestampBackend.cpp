@@ -0,0 +1,61 @@
+#include "D3D12TimestampBackend.h"
+#include "Helpers.h"
+
+#include <d3dx12.h>
+
+#include <cstring>
+
+D3D12TimestampBackend::D3D12TimestampBackend(ComPtr<ID3D12Device2> p_device, ComPtr<ID3D12CommandQueue> p_commandQueue)
+	: m_device(p_device)
+{
+	ThrowIfFailed(p_commandQueue->GetTimestampFrequency(&m_frequency));
+}
+
+D3D12TimestampBackend::~D3D12TimestampBackend()
+{
+	if (m_readbackBuffer)
+	{
+		D3D12_RANGE writeRange = { 0, 0 };
+		m_readbackBuffer->Unmap(0, &writeRange);
+		m_mappedTicks_p = nullptr;
+	}
+}
+
+void D3D12TimestampBackend::Initialize(uint32_t p_queryCount)
+{
+	D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+	queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+	queryHeapDesc.Count = p_queryCount;
+	ThrowIfFailed(m_device->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&m_queryHeap)));
+
+	CD3DX12_HEAP_PROPERTIES heapReadback = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+	CD3DX12_RESOURCE_DESC bufferReadback = CD3DX12_RESOURCE_DESC::Buffer(p_queryCount * sizeof(uint64_t));
+	ThrowIfFailed(m_device->CreateCommittedResource(
+		&heapReadback,
+		D3D12_HEAP_FLAG_NONE,
+		&bufferReadback,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(&m_readbackBuffer)));
+
+	// readback heaps may stay mapped; the profiler only reads slots of finished frames
+	void* mapped_p = nullptr;
+	ThrowIfFailed(m_readbackBuffer->Map(0, nullptr, &mapped_p));
+	m_mappedTicks_p = static_cast<const uint64_t*>(mapped_p);
+}
+
+void D3D12TimestampBackend::WriteTimestamp(GpuCommandListHandle p_commandList, uint32_t p_query)
+{
+	static_cast<ID3D12GraphicsCommandList*>(p_commandList)->EndQuery(m_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, p_query);
+}
+
+void D3D12TimestampBackend::Resolve(GpuCommandListHandle p_commandList, uint32_t p_firstQuery, uint32_t p_queryCount)
+{
+	static_cast<ID3D12GraphicsCommandList*>(p_commandList)->ResolveQueryData(m_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP,
+		p_firstQuery, p_queryCount, m_readbackBuffer.Get(), p_firstQuery * sizeof(uint64_t));
+}
+
+void D3D12TimestampBackend::ReadResolved(uint32_t p_firstQuery, uint32_t p_queryCount, uint64_t* out_ticks)
+{
+	memcpy(out_ticks, m_mappedTicks_p + p_firstQuery, p_queryCount * sizeof(uint64_t));
+}
@@ -0,0 +1,766 @@
+#include "DynamicBvh.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BEAR_DYNAMIC_BVH_SSE
+#include <xmmintrin.h>
+#endif
+
+enum FrustumOverlap : uint8_t
+{
+	FRUSTUM_OUTSIDE = 0,
+	FRUSTUM_INTERSECTING = 1,
+	FRUSTUM_INSIDE = 2
+};
+
+#if defined(BEAR_DYNAMIC_BVH_SSE)
+
+// six planes in two groups of four, the last two always pass
+struct PlaneGroups
+{
+	__m128 x[2], y[2], z[2], d[2];
+	__m128 absX[2], absY[2], absZ[2];
+
+	PlaneGroups(const FrustumPlanes& p_planes)
+	{
+		float padded[8][4];
+		for (unsigned int plane = 0; plane < 8; plane++)
+		{
+			for (unsigned int i = 0; i < 4; i++)
+			{
+				padded[plane][i] = plane < 6 ? p_planes.planes[plane][i] : (i == 3 ? 1.0f : 0.0f);
+			}
+		}
+
+		for (unsigned int group = 0; group < 2; group++)
+		{
+			const float(*coefficients_p)[4] = &padded[group * 4];
+			x[group] = _mm_setr_ps(coefficients_p[0][0], coefficients_p[1][0], coefficients_p[2][0], coefficients_p[3][0]);
+			y[group] = _mm_setr_ps(coefficients_p[0][1], coefficients_p[1][1], coefficients_p[2][1], coefficients_p[3][1]);
+			z[group] = _mm_setr_ps(coefficients_p[0][2], coefficients_p[1][2], coefficients_p[2][2], coefficients_p[3][2]);
+			d[group] = _mm_setr_ps(coefficients_p[0][3], coefficients_p[1][3], coefficients_p[2][3], coefficients_p[3][3]);
+
+			const __m128 signMask = _mm_set1_ps(-0.0f);
+			absX[group] = _mm_andnot_ps(signMask, x[group]);
+			absY[group] = _mm_andnot_ps(signMask, y[group]);
+			absZ[group] = _mm_andnot_ps(signMask, z[group]);
+		}
+	}
+
+	FrustumOverlap Test(const float* p_minimum_p, const float* p_maximum_p) const
+	{
+		const __m128 half = _mm_set1_ps(0.5f);
+		__m128 minimum = _mm_loadu_ps(p_minimum_p);
+		__m128 maximum = _mm_loadu_ps(p_maximum_p);
+		__m128 center = _mm_mul_ps(_mm_add_ps(minimum, maximum), half);
+		__m128 extents = _mm_mul_ps(_mm_sub_ps(maximum, minimum), half);
+
+		__m128 centerX = _mm_shuffle_ps(center, center, _MM_SHUFFLE(0, 0, 0, 0));
+		__m128 centerY = _mm_shuffle_ps(center, center, _MM_SHUFFLE(1, 1, 1, 1));
+		__m128 centerZ = _mm_shuffle_ps(center, center, _MM_SHUFFLE(2, 2, 2, 2));
+		__m128 extentX = _mm_shuffle_ps(extents, extents, _MM_SHUFFLE(0, 0, 0, 0));
+		__m128 extentY = _mm_shuffle_ps(extents, extents, _MM_SHUFFLE(1, 1, 1, 1));
+		__m128 extentZ = _mm_shuffle_ps(extents, extents, _MM_SHUFFLE(2, 2, 2, 2));
+
+		const __m128 zero = _mm_setzero_ps();
+		__m128 outside = zero;
+		__m128 intersecting = zero;
+		for (unsigned int group = 0; group < 2; group++)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x[group], centerX), _mm_mul_ps(y[group], centerY)),
+				_mm_add_ps(_mm_mul_ps(z[group], centerZ), d[group]));
+			__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX[group], extentX), _mm_mul_ps(absY[group], extentY)),
+				_mm_mul_ps(absZ[group], extentZ));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+			intersecting = _mm_or_ps(intersecting, _mm_cmplt_ps(_mm_sub_ps(distance, radius), zero));
+		}
+
+		if (_mm_movemask_ps(outside) != 0)
+		{
+			return FRUSTUM_OUTSIDE;
+		}
+		return _mm_movemask_ps(intersecting) != 0 ? FRUSTUM_INTERSECTING : FRUSTUM_INSIDE;
+	}
+};
+
+// slab test of x, y and z at once
+struct RaySlabs
+{
+	__m128 origin;
+	__m128 inverseDirection;
+
+	RaySlabs(const float* p_origin_p, const float* p_direction_p)
+	{
+		// an axis the ray is parallel to gets a huge but finite inverse, so no slab turns into NaN
+		float inverse[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			float direction = std::fabs(p_direction_p[i]) < 1e-20f ? std::copysign(1e-20f, p_direction_p[i]) : p_direction_p[i];
+			inverse[i] = 1.0f / direction;
+		}
+		origin = _mm_setr_ps(p_origin_p[0], p_origin_p[1], p_origin_p[2], 0.0f);
+		inverseDirection = _mm_loadu_ps(inverse);
+	}
+
+	// false if the ray misses the box or only meets it outside [0, p_maxT]
+	bool Enter(const float* p_minimum_p, const float* p_maximum_p, float p_maxT, float& out_entryT) const
+	{
+		__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(p_minimum_p), origin), inverseDirection);
+		__m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(p_maximum_p), origin), inverseDirection);
+		__m128 nearT = _mm_min_ps(t1, t2);
+		__m128 farT = _mm_max_ps(t1, t2);
+
+		__m128 entry = _mm_max_ss(_mm_max_ss(nearT, _mm_shuffle_ps(nearT, nearT, _MM_SHUFFLE(1, 1, 1, 1))),
+			_mm_max_ss(_mm_shuffle_ps(nearT, nearT, _MM_SHUFFLE(2, 2, 2, 2)), _mm_setzero_ps()));
+		__m128 exit = _mm_min_ss(_mm_min_ss(farT, _mm_shuffle_ps(farT, farT, _MM_SHUFFLE(1, 1, 1, 1))),
+			_mm_min_ss(_mm_shuffle_ps(farT, farT, _MM_SHUFFLE(2, 2, 2, 2)), _mm_set_ss(p_maxT)));
+
+		out_entryT = _mm_cvtss_f32(entry);
+		return _mm_comile_ss(entry, exit) != 0;
+	}
+};
+
+#else
+
+struct PlaneGroups
+{
+	FrustumPlanes planes;
+
+	PlaneGroups(const FrustumPlanes& p_planes)
+		: planes(p_planes)
+	{
+	}
+
+	FrustumOverlap Test(const float* p_minimum_p, const float* p_maximum_p) const
+	{
+		FrustumOverlap overlap = FRUSTUM_INSIDE;
+		for (unsigned int plane = 0; plane < 6; plane++)
+		{
+			const float* coefficients_p = planes.planes[plane];
+			float distance = coefficients_p[3];
+			float radius = 0.0f;
+			for (unsigned int i = 0; i < 3; i++)
+			{
+				distance += coefficients_p[i] * (p_minimum_p[i] + p_maximum_p[i]) * 0.5f;
+				radius += std::fabs(coefficients_p[i]) * (p_maximum_p[i] - p_minimum_p[i]) * 0.5f;
+			}
+
+			if (distance + radius < 0.0f)
+			{
+				return FRUSTUM_OUTSIDE;
+			}
+			if (distance - radius < 0.0f)
+			{
+				overlap = FRUSTUM_INTERSECTING;
+			}
+		}
+		return overlap;
+	}
+};
+
+struct RaySlabs
+{
+	float origin[3];
+	float inverseDirection[3];
+
+	RaySlabs(const float* p_origin_p, const float* p_direction_p)
+	{
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			float direction = std::fabs(p_direction_p[i]) < 1e-20f ? std::copysign(1e-20f, p_direction_p[i]) : p_direction_p[i];
+			origin[i] = p_origin_p[i];
+			inverseDirection[i] = 1.0f / direction;
+		}
+	}
+
+	bool Enter(const float* p_minimum_p, const float* p_maximum_p, float p_maxT, float& out_entryT) const
+	{
+		float entry = 0.0f;
+		float exit = p_maxT;
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			float t1 = (p_minimum_p[i] - origin[i]) * inverseDirection[i];
+			float t2 = (p_maximum_p[i] - origin[i]) * inverseDirection[i];
+			entry = std::max<float>(entry, std::min<float>(t1, t2));
+			exit = std::min<float>(exit, std::max<float>(t1, t2));
+		}
+
+		out_entryT = entry;
+		return entry <= exit;
+	}
+};
+
+#endif
+
+int32_t DynamicBvh::Insert(const BoundingAabb& p_bounds, void* p_userData_p)
+{
+	int32_t leaf = _allocateNode();
+	Node& node = m_nodes[leaf];
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		node.minimum[i] = p_bounds.center[i] - p_bounds.extents[i];
+		node.maximum[i] = p_bounds.center[i] + p_bounds.extents[i];
+	}
+	node.userData_p = p_userData_p;
+
+	_insertLeaf(leaf);
+	m_leafCount++;
+	return leaf;
+}
+
+void DynamicBvh::Remove(int32_t p_leaf)
+{
+	_removeLeaf(p_leaf);
+	_freeNode(p_leaf);
+	m_leafCount--;
+}
+
+void DynamicBvh::Refit(int32_t p_leaf, const BoundingAabb& p_bounds)
+{
+	Node& leaf = m_nodes[p_leaf];
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		leaf.minimum[i] = p_bounds.center[i] - p_bounds.extents[i];
+		leaf.maximum[i] = p_bounds.center[i] + p_bounds.extents[i];
+	}
+
+	int32_t index = leaf.parent;
+	while (index != NullNode)
+	{
+		Node& node = m_nodes[index];
+		float oldMinimum[3] = { node.minimum[0], node.minimum[1], node.minimum[2] };
+		float oldMaximum[3] = { node.maximum[0], node.maximum[1], node.maximum[2] };
+		int32_t oldHeight = node.height;
+
+		_fitToChildren(index);
+		_rotate(index);
+
+		// a rotation keeps the node's leaves, so an unchanged box and height leave every ancestor as it was
+		bool isUnchanged = node.height == oldHeight;
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			isUnchanged = isUnchanged && node.minimum[i] == oldMinimum[i] && node.maximum[i] == oldMaximum[i];
+		}
+		if (isUnchanged)
+		{
+			break;
+		}
+
+		index = node.parent;
+	}
+}
+
+void DynamicBvh::Clear()
+{
+	m_nodes.clear();
+	m_root = NullNode;
+	m_freeList = NullNode;
+	m_freeCount = 0;
+	m_leafCount = 0;
+	m_rotationCount = 0;
+}
+
+void DynamicBvh::QueryFrustum(const FrustumPlanes& p_planes, std::vector<void*>& out_userData)
+{
+	BEAR_PROFILE_FUNCTION();
+
+	out_userData.clear();
+	m_lastQueryNodes = 0;
+	if (m_root == NullNode)
+	{
+		return;
+	}
+
+	const PlaneGroups planeGroups(p_planes);
+
+	m_stack.clear();
+	m_stack.push_back(m_root);
+	while (!m_stack.empty())
+	{
+		int32_t index = m_stack.back();
+		m_stack.pop_back();
+
+		const Node& node = m_nodes[index];
+		m_lastQueryNodes++;
+
+		FrustumOverlap overlap = planeGroups.Test(node.minimum, node.maximum);
+		if (overlap == FRUSTUM_OUTSIDE)
+		{
+			continue;
+		}
+
+		if (overlap == FRUSTUM_INSIDE)
+		{
+			_collectLeaves(index, out_userData);
+		}
+		else if (node.IsLeaf())
+		{
+			out_userData.push_back(node.userData_p);
+		}
+		else
+		{
+			m_stack.push_back(node.child1);
+			m_stack.push_back(node.child2);
+		}
+	}
+}
+
+float DynamicBvh::RayCast(const float* p_origin_p, const float* p_direction_p, float p_maxT,
+	const std::function<float(void*, float)>& p_leafTest)
+{
+	m_lastQueryNodes = 0;
+	if (m_root == NullNode)
+	{
+		return p_maxT;
+	}
+
+	const RaySlabs ray(p_origin_p, p_direction_p);
+	float maxT = p_maxT;
+
+	float entryT = 0.0f;
+	m_lastQueryNodes++;
+	m_rayStack.clear();
+	if (ray.Enter(m_nodes[m_root].minimum, m_nodes[m_root].maximum, maxT, entryT))
+	{
+		m_rayStack.push_back({ m_root, entryT });
+	}
+
+	while (!m_rayStack.empty())
+	{
+		RayStackEntry entry = m_rayStack.back();
+		m_rayStack.pop_back();
+
+		// a nearer hit was found since the node was pushed
+		if (entry.entryT > maxT)
+		{
+			continue;
+		}
+
+		const Node& node = m_nodes[entry.node];
+		if (node.IsLeaf())
+		{
+			maxT = std::min<float>(maxT, p_leafTest(node.userData_p, maxT));
+			continue;
+		}
+
+		const Node& child1 = m_nodes[node.child1];
+		const Node& child2 = m_nodes[node.child2];
+		float entryT1 = 0.0f;
+		float entryT2 = 0.0f;
+		bool isHit1 = ray.Enter(child1.minimum, child1.maximum, maxT, entryT1);
+		bool isHit2 = ray.Enter(child2.minimum, child2.maximum, maxT, entryT2);
+		m_lastQueryNodes += 2;
+
+		// the nearer child is popped first
+		if (isHit1 && isHit2)
+		{
+			if (entryT1 <= entryT2)
+			{
+				m_rayStack.push_back({ node.child2, entryT2 });
+				m_rayStack.push_back({ node.child1, entryT1 });
+			}
+			else
+			{
+				m_rayStack.push_back({ node.child1, entryT1 });
+				m_rayStack.push_back({ node.child2, entryT2 });
+			}
+		}
+		else if (isHit1)
+		{
+			m_rayStack.push_back({ node.child1, entryT1 });
+		}
+		else if (isHit2)
+		{
+			m_rayStack.push_back({ node.child2, entryT2 });
+		}
+	}
+
+	return maxT;
+}
+
+bool DynamicBvh::IsValid() const
+{
+	uint32_t freeCount = 0;
+	for (int32_t index = m_freeList; index != NullNode; index = m_nodes[index].parent)
+	{
+		if (m_nodes[index].height != -1 || ++freeCount > m_nodes.size())
+		{
+			return false;
+		}
+	}
+	if (freeCount != m_freeCount)
+	{
+		return false;
+	}
+
+	if (m_root == NullNode)
+	{
+		return m_leafCount == 0 && m_freeCount == m_nodes.size();
+	}
+	if (m_nodes[m_root].parent != NullNode)
+	{
+		return false;
+	}
+
+	uint32_t leafCount = 0;
+	uint32_t nodeCount = 0;
+	std::vector<int32_t> stack(1, m_root);
+	while (!stack.empty())
+	{
+		const int32_t index = stack.back();
+		stack.pop_back();
+
+		const Node& node = m_nodes[index];
+		if (++nodeCount > m_nodes.size() - m_freeCount)
+		{
+			return false; // a cycle, or a free node linked in
+		}
+
+		if (node.IsLeaf())
+		{
+			if (node.child2 != NullNode || node.height != 0)
+			{
+				return false;
+			}
+			leafCount++;
+			continue;
+		}
+
+		const Node& child1 = m_nodes[node.child1];
+		const Node& child2 = m_nodes[node.child2];
+		if (child1.parent != index || child2.parent != index || node.height != 1 + std::max<int32_t>(child1.height, child2.height))
+		{
+			return false;
+		}
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			if (node.minimum[i] != std::min<float>(child1.minimum[i], child2.minimum[i]) ||
+				node.maximum[i] != std::max<float>(child1.maximum[i], child2.maximum[i]))
+			{
+				return false;
+			}
+		}
+
+		stack.push_back(node.child1);
+		stack.push_back(node.child2);
+	}
+
+	// a tree of n leaves has n - 1 inner nodes
+	return leafCount == m_leafCount && nodeCount == 2 * m_leafCount - 1 && nodeCount == m_nodes.size() - m_freeCount;
+}
+
+int32_t DynamicBvh::_allocateNode()
+{
+	int32_t index;
+	if (m_freeList != NullNode)
+	{
+		index = m_freeList;
+		m_freeList = m_nodes[index].parent;
+		m_freeCount--;
+	}
+	else
+	{
+		index = static_cast<int32_t>(m_nodes.size());
+		m_nodes.emplace_back();
+	}
+
+	Node& node = m_nodes[index];
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		node.minimum[i] = 0.0f;
+		node.maximum[i] = 0.0f;
+	}
+	node.userData_p = nullptr;
+	node.parent = NullNode;
+	node.child1 = NullNode;
+	node.child2 = NullNode;
+	node.height = 0;
+	return index;
+}
+
+void DynamicBvh::_freeNode(int32_t p_node)
+{
+	Node& node = m_nodes[p_node];
+	node.parent = m_freeList;
+	node.height = -1;
+	node.userData_p = nullptr;
+	m_freeList = p_node;
+	m_freeCount++;
+}
+
+void DynamicBvh::_insertLeaf(int32_t p_leaf)
+{
+	if (m_root == NullNode)
+	{
+		m_root = p_leaf;
+		m_nodes[p_leaf].parent = NullNode;
+		return;
+	}
+
+	// descend towards the sibling that grows the tree's surface area the least
+	int32_t index = m_root;
+	while (!m_nodes[index].IsLeaf())
+	{
+		const Node& node = m_nodes[index];
+		float area = _halfArea(node.minimum, node.maximum);
+		float combinedArea = _unionHalfArea(index, p_leaf);
+
+		// a new parent for this node and the leaf, against pushing the leaf further down,
+		// where every node on the way grows by the same amount
+		float cost = 2.0f * combinedArea;
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		auto descendCost = [&](int32_t child)
+			{
+				const Node& childNode = m_nodes[child];
+				float childCost = _unionHalfArea(child, p_leaf) + inheritanceCost;
+				return childNode.IsLeaf() ? childCost : childCost - _halfArea(childNode.minimum, childNode.maximum);
+			};
+
+		float cost1 = descendCost(node.child1);
+		float cost2 = descendCost(node.child2);
+		if (cost < cost1 && cost < cost2)
+		{
+			break;
+		}
+
+		index = cost1 < cost2 ? node.child1 : node.child2;
+	}
+
+	const int32_t sibling = index;
+	const int32_t newParent = _allocateNode(); // may move m_nodes, no references above this
+	const int32_t oldParent = m_nodes[sibling].parent;
+
+	Node& parentNode = m_nodes[newParent];
+	parentNode.parent = oldParent;
+	parentNode.child1 = sibling;
+	parentNode.child2 = p_leaf;
+	m_nodes[sibling].parent = newParent;
+	m_nodes[p_leaf].parent = newParent;
+	_fitToChildren(newParent);
+
+	if (oldParent != NullNode)
+	{
+		Node& oldParentNode = m_nodes[oldParent];
+		(oldParentNode.child1 == sibling ? oldParentNode.child1 : oldParentNode.child2) = newParent;
+	}
+	else
+	{
+		m_root = newParent;
+	}
+
+	// grow and rebalance the ancestors
+	index = m_nodes[p_leaf].parent;
+	while (index != NullNode)
+	{
+		index = _balance(index);
+		_fitToChildren(index);
+		index = m_nodes[index].parent;
+	}
+}
+
+void DynamicBvh::_removeLeaf(int32_t p_leaf)
+{
+	if (p_leaf == m_root)
+	{
+		m_root = NullNode;
+		return;
+	}
+
+	const int32_t parent = m_nodes[p_leaf].parent;
+	const int32_t grandParent = m_nodes[parent].parent;
+	const int32_t sibling = m_nodes[parent].child1 == p_leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+	_freeNode(parent);
+
+	if (grandParent == NullNode)
+	{
+		m_root = sibling;
+		m_nodes[sibling].parent = NullNode;
+		return;
+	}
+
+	// the sibling takes the parent's place
+	Node& grandParentNode = m_nodes[grandParent];
+	(grandParentNode.child1 == parent ? grandParentNode.child1 : grandParentNode.child2) = sibling;
+	m_nodes[sibling].parent = grandParent;
+
+	int32_t index = grandParent;
+	while (index != NullNode)
+	{
+		index = _balance(index);
+		_fitToChildren(index);
+		index = m_nodes[index].parent;
+	}
+}
+
+int32_t DynamicBvh::_balance(int32_t p_node)
+{
+	const int32_t a = p_node;
+	Node& nodeA = m_nodes[a];
+	if (nodeA.IsLeaf() || nodeA.height < 2)
+	{
+		return a;
+	}
+
+	const int32_t b = nodeA.child1;
+	const int32_t c = nodeA.child2;
+	const int32_t balance = m_nodes[c].height - m_nodes[b].height;
+	if (balance >= -1 && balance <= 1)
+	{
+		return a;
+	}
+
+	// the taller child takes a's place, a keeps the other child and the shorter grandchild
+	const bool isRightHeavy = balance > 1;
+	const int32_t up = isRightHeavy ? c : b;
+	Node& upNode = m_nodes[up];
+	const int32_t grandChild1 = upNode.child1;
+	const int32_t grandChild2 = upNode.child2;
+
+	upNode.child1 = a;
+	upNode.parent = nodeA.parent;
+	nodeA.parent = up;
+
+	if (upNode.parent != NullNode)
+	{
+		Node& parentNode = m_nodes[upNode.parent];
+		(parentNode.child1 == a ? parentNode.child1 : parentNode.child2) = up;
+	}
+	else
+	{
+		m_root = up;
+	}
+
+	const bool isFirstTaller = m_nodes[grandChild1].height > m_nodes[grandChild2].height;
+	const int32_t taller = isFirstTaller ? grandChild1 : grandChild2;
+	const int32_t shorter = isFirstTaller ? grandChild2 : grandChild1;
+
+	upNode.child2 = taller;
+	(isRightHeavy ? nodeA.child2 : nodeA.child1) = shorter;
+	m_nodes[shorter].parent = a;
+
+	_fitToChildren(a);
+	_fitToChildren(up);
+	m_rotationCount++;
+	return up;
+}
+
+void DynamicBvh::_rotate(int32_t p_node)
+{
+	const Node& node = m_nodes[p_node];
+	if (node.height < 2)
+	{
+		return;
+	}
+
+	// swap a child of p_node with a child of its other child, if that shrinks the other child
+	int32_t bestChild = NullNode;
+	int32_t bestGrandChild = NullNode;
+	float bestReduction = 0.0f;
+
+	auto consider = [&](int32_t child, int32_t other)
+		{
+			const Node& otherNode = m_nodes[other];
+			if (otherNode.IsLeaf())
+			{
+				return;
+			}
+
+			float area = _halfArea(otherNode.minimum, otherNode.maximum);
+			float reduction1 = area - _unionHalfArea(child, otherNode.child2); // child takes child1's place
+			float reduction2 = area - _unionHalfArea(child, otherNode.child1);
+			if (reduction1 > bestReduction)
+			{
+				bestReduction = reduction1;
+				bestChild = child;
+				bestGrandChild = otherNode.child1;
+			}
+			if (reduction2 > bestReduction)
+			{
+				bestReduction = reduction2;
+				bestChild = child;
+				bestGrandChild = otherNode.child2;
+			}
+		};
+
+	consider(node.child1, node.child2);
+	consider(node.child2, node.child1);
+
+	if (bestChild == NullNode)
+	{
+		return;
+	}
+
+	const int32_t other = m_nodes[bestGrandChild].parent;
+	Node& parentNode = m_nodes[p_node];
+	Node& otherNode = m_nodes[other];
+
+	(parentNode.child1 == bestChild ? parentNode.child1 : parentNode.child2) = bestGrandChild;
+	(otherNode.child1 == bestGrandChild ? otherNode.child1 : otherNode.child2) = bestChild;
+	m_nodes[bestGrandChild].parent = p_node;
+	m_nodes[bestChild].parent = other;
+
+	_fitToChildren(other);
+	_fitToChildren(p_node);
+	m_rotationCount++;
+}
+
+void DynamicBvh::_fitToChildren(int32_t p_node)
+{
+	Node& node = m_nodes[p_node];
+	const Node& child1 = m_nodes[node.child1];
+	const Node& child2 = m_nodes[node.child2];
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		node.minimum[i] = std::min<float>(child1.minimum[i], child2.minimum[i]);
+		node.maximum[i] = std::max<float>(child1.maximum[i], child2.maximum[i]);
+	}
+	node.height = 1 + std::max<int32_t>(child1.height, child2.height);
+}
+
+void DynamicBvh::_collectLeaves(int32_t p_node, std::vector<void*>& out_userData)
+{
+	m_leafStack.clear();
+	m_leafStack.push_back(p_node);
+	while (!m_leafStack.empty())
+	{
+		const Node& node = m_nodes[m_leafStack.back()];
+		m_leafStack.pop_back();
+
+		if (node.IsLeaf())
+		{
+			out_userData.push_back(node.userData_p);
+		}
+		else
+		{
+			m_leafStack.push_back(node.child1);
+			m_leafStack.push_back(node.child2);
+		}
+	}
+}
+
+float DynamicBvh::_halfArea(const float* p_minimum_p, const float* p_maximum_p)
+{
+	float x = p_maximum_p[0] - p_minimum_p[0];
+	float y = p_maximum_p[1] - p_minimum_p[1];
+	float z = p_maximum_p[2] - p_minimum_p[2];
+	return x * y + y * z + z * x;
+}
+
+float DynamicBvh::_unionHalfArea(int32_t p_a, int32_t p_b) const
+{
+	const Node& a = m_nodes[p_a];
+	const Node& b = m_nodes[p_b];
+	float minimum[3];
+	float maximum[3];
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		minimum[i] = std::min<float>(a.minimum[i], b.minimum[i]);
+		maximum[i] = std::max<float>(a.maximum[i], b.maximum[i]);
+	}
+	return _halfArea(minimum, maximum);
+}
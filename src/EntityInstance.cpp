@@ -2,11 +2,18 @@
 #include <Application.h>
 #include <MeshManager.h>
 
+#include <atomic>
+
+// shared by all instances, so a new instance never reuses the revision of a deleted one at the same address
+static std::atomic<uint64_t> gs_instanceRevisionCounter = 0;
+
 Instance::Instance(std::string& p_name, Texture* p_texture_p, Mesh* p_mesh)
 {
 	m_name = p_name;
 	m_mesh_p = p_mesh;
 	m_texture_p = p_texture_p;
+	_updateWorldBounds();
+	_bumpRevision();
 }
 
 const std::string& Instance::GetName()
@@ -27,6 +34,8 @@ Mesh* Instance::GetMeshClassPointer()
 void Instance::SetMeshClassPointer(Mesh* mesh_p)
 {
 	m_mesh_p = mesh_p;
+	_updateWorldBounds();
+	_bumpRevision();
 }
 
 XMVECTOR Instance::GetPosition() const
@@ -111,6 +120,7 @@ const std::string& Instance::GetMeshName()
 void Instance::SetTexture(Texture* p_texture_p)
 {
 	m_texture_p = p_texture_p;
+	_bumpRevision();
 }
 
 JoltBodyShape Instance::GetBodyShape()
@@ -126,29 +136,70 @@ void Instance::SetBodyShape(JoltBodyShape bodyShape)
 void Instance::_updateModelMatrix()
 {
 	m_modelMatrix = XMMatrixScalingFromVector(m_scale) * XMMatrixRotationRollPitchYawFromVector(m_rotation) * XMMatrixTranslationFromVector(m_position);
+	_updateWorldBounds();
+	_bumpRevision();
 }
 
-void Instance::Render(ComPtr<ID3D12GraphicsCommandList2> p_commandList, const XMMATRIX& p_vpMatrix)
+void Instance::_updateWorldBounds()
 {
 	if (m_mesh_p == nullptr)
 	{
-		// allow to have an instance without a mesh assigned
+		m_worldBounds = BoundingAabb();
 		return;
 	}
 
-	auto textureHandle = m_texture_p->GetSrvHeapStart();
+	const BoundingAabb& localBounds = m_mesh_p->GetLocalBounds();
+	XMVECTOR center = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(localBounds.center));
+	XMVECTOR extents = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(localBounds.extents));
+
+	// each world axis gets the absolute share of every rotated and scaled local axis
+	XMVECTOR worldExtents = XMVectorAbs(m_modelMatrix.r[0]) * XMVectorSplatX(extents) +
+		XMVectorAbs(m_modelMatrix.r[1]) * XMVectorSplatY(extents) +
+		XMVectorAbs(m_modelMatrix.r[2]) * XMVectorSplatZ(extents);
+
+	XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(m_worldBounds.center), XMVector3TransformCoord(center, m_modelMatrix));
+	XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(m_worldBounds.extents), worldExtents);
+}
+
+void Instance::_bumpRevision()
+{
+	m_revision = ++gs_instanceRevisionCounter;
+}
+
+bool Instance::FillDrawItem(DrawItem& out_item) const
+{
+	if (m_mesh_p == nullptr)
+	{
+		// allow to have an instance without a mesh assigned
+		return false;
+	}
+
+	out_item.instance_p = this;
+	out_item.revision = m_revision;
+	out_item.textureHandle = m_texture_p->GetSrvHeapStart();
+	out_item.materialId = m_texture_p->GetTextureIndex();
 
-	p_commandList->SetGraphicsRootDescriptorTable(0, textureHandle);
+	// vertex shader input, i.e. model matrix and its inverse transpose
+	out_item.constants.modelMatrix = m_modelMatrix;
+	out_item.constants.tiModel = XMMatrixTranspose(XMMatrixInverse(nullptr, m_modelMatrix));
+	out_item.worldBounds = m_worldBounds;
 
-	// set vertex shader input, i.e. model matrix and its inverse transpose
-	// sizeof() / 4 because we are setting 32 bit constants
-	VertexShaderInput vsi = {};
-	vsi.mvpMatrix = m_modelMatrix * p_vpMatrix;
-	vsi.tiModel = XMMatrixTranspose(XMMatrixInverse(nullptr, m_modelMatrix));
+	m_mesh_p->FillDrawItem(out_item);
 
-	p_commandList->SetGraphicsRoot32BitConstants(1, sizeof(vsi) / 4, &vsi, 0);
+	return true;
+}
+
+bool Instance::IntersectRay(const XMVECTOR& p_origin, const XMVECTOR& p_direction, float p_maxT, float& out_t) const
+{
+	if (m_mesh_p == nullptr)
+	{
+		return false;
+	}
 
-	m_mesh_p->RenderInstance(p_commandList);
+	// the direction is not normalized on the way, so t is the same in model and world space
+	XMMATRIX inverseModel = XMMatrixInverse(nullptr, m_modelMatrix);
+	return m_mesh_p->IntersectRay(XMVector3TransformCoord(p_origin, inverseModel),
+		XMVector3TransformNormal(p_direction, inverseModel), p_maxT, out_t);
 }
 
 void Instance::SetMeshByName(const std::string& p_meshName)
@@ -163,6 +214,8 @@ void Instance::SetMeshByName(const std::string& p_meshName)
 	{
 		m_mesh_p = nullptr;
 	}
+	_updateWorldBounds();
+	_bumpRevision();
 
 	static std::string sphereString = "sphere";
 	static std::string cubeString = "cube";
@@ -187,5 +240,6 @@ void Instance::SetTextureByName(const std::string& p_textureName)
 	if (texture_p)
 	{
 		m_texture_p = texture_p;
+		_bumpRevision();
 	}
 }
\ No newline at end of file
@@ -0,0 +1,50 @@
+#include "FixedTimestep.h"
+
+#include <algorithm>
+
+FixedTimestep::FixedTimestep(double p_tickRate, unsigned int p_maxStepsPerFrame)
+{
+	SetTickRate(p_tickRate);
+	SetMaxStepsPerFrame(p_maxStepsPerFrame);
+}
+
+void FixedTimestep::SetTickRate(double p_tickRate)
+{
+	m_tickRate = std::max<double>(p_tickRate, 1.0);
+	m_stepSeconds = 1.0 / m_tickRate;
+
+	// keep the blend factor in range when the step gets shorter
+	m_accumulatedSeconds = std::min<double>(m_accumulatedSeconds, m_stepSeconds);
+}
+
+void FixedTimestep::SetMaxStepsPerFrame(unsigned int p_maxStepsPerFrame)
+{
+	m_maxStepsPerFrame = std::max<unsigned int>(p_maxStepsPerFrame, 1);
+}
+
+unsigned int FixedTimestep::Advance(double p_frameSeconds)
+{
+	m_accumulatedSeconds += std::max<double>(p_frameSeconds, 0.0);
+
+	unsigned int stepCount = static_cast<unsigned int>(m_accumulatedSeconds / m_stepSeconds);
+	if (stepCount > m_maxStepsPerFrame)
+	{
+		// drop what cannot be caught up, but keep the fraction so alpha stays continuous
+		double droppedSeconds = (stepCount - m_maxStepsPerFrame) * m_stepSeconds;
+		m_accumulatedSeconds -= droppedSeconds;
+		m_droppedSeconds += droppedSeconds;
+		stepCount = m_maxStepsPerFrame;
+	}
+
+	m_accumulatedSeconds -= stepCount * m_stepSeconds;
+	m_lastStepCount = stepCount;
+
+	return stepCount;
+}
+
+void FixedTimestep::Reset()
+{
+	m_accumulatedSeconds = 0.0;
+	m_droppedSeconds = 0.0;
+	m_lastStepCount = 0;
+}
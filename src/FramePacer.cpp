@@ -0,0 +1,261 @@
+#include "FramePacer.h"
+
+#include <cmath>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <timeapi.h>
+#pragma comment(lib, "winmm.lib")
+#else
+#include <cerrno>
+#include <time.h>
+#endif
+
+#if defined(_WIN32)
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+// Waits on a high-resolution waitable timer together with the message queue,
+// so input is handled while asleep and the frame deadline is still met.
+class Win32FrameWaitBackend : public FrameWaitBackend
+{
+public:
+	Win32FrameWaitBackend()
+	{
+		m_timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+		if (m_timer == nullptr)
+		{
+			// before Windows 10 1803; a 1 ms scheduler period keeps the plain timer close enough
+			m_timer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+			timeBeginPeriod(1);
+			m_hasRaisedTimerResolution = true;
+		}
+	}
+
+	~Win32FrameWaitBackend() override
+	{
+		if (m_hasRaisedTimerResolution)
+		{
+			timeEndPeriod(1);
+		}
+		CloseHandle(m_timer);
+	}
+
+	bool SleepUntil(std::chrono::steady_clock::time_point p_deadline) override
+	{
+		auto remaining = p_deadline - std::chrono::steady_clock::now();
+		if (remaining <= std::chrono::steady_clock::duration::zero())
+		{
+			return true;
+		}
+
+		// negative means relative, in 100 ns units
+		LARGE_INTEGER dueTime;
+		dueTime.QuadPart = -static_cast<LONGLONG>(std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count() / 100);
+		SetWaitableTimerEx(m_timer, &dueTime, 0, nullptr, nullptr, nullptr, 0);
+
+		DWORD result = MsgWaitForMultipleObjectsEx(1, &m_timer, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+		return result == WAIT_OBJECT_0;
+	}
+
+	void WaitForPresentQueue(void* p_waitable) override
+	{
+		if (p_waitable != nullptr)
+		{
+			// bounded, a lost present must not hang the application
+			WaitForSingleObjectEx(static_cast<HANDLE>(p_waitable), 1000, TRUE);
+		}
+	}
+
+	double GetProcessCpuSeconds() override
+	{
+		FILETIME creationTime, exitTime, kernelTime, userTime;
+		if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime))
+		{
+			return 0.0;
+		}
+
+		auto toTicks = [](const FILETIME& p_time) -> uint64_t
+			{
+				return (static_cast<uint64_t>(p_time.dwHighDateTime) << 32) | p_time.dwLowDateTime;
+			};
+
+		// 100 ns units
+		return static_cast<double>(toTicks(kernelTime) + toTicks(userTime)) * 1e-7;
+	}
+
+private:
+	HANDLE m_timer = nullptr;
+	bool m_hasRaisedTimerResolution = false;
+};
+
+std::unique_ptr<FrameWaitBackend> CreateDefaultFrameWaitBackend()
+{
+	return std::make_unique<Win32FrameWaitBackend>();
+}
+
+#else
+
+// For headless runs: absolute sleeps on CLOCK_MONOTONIC, which is what steady_clock uses.
+class PosixFrameWaitBackend : public FrameWaitBackend
+{
+public:
+	bool SleepUntil(std::chrono::steady_clock::time_point p_deadline) override
+	{
+		auto sinceEpoch = std::chrono::duration_cast<std::chrono::nanoseconds>(p_deadline.time_since_epoch()).count();
+
+		timespec deadline;
+		deadline.tv_sec = static_cast<time_t>(sinceEpoch / 1000000000);
+		deadline.tv_nsec = static_cast<long>(sinceEpoch % 1000000000);
+
+		// absolute time, so a signal only costs a retry and never shifts the deadline
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR)
+		{
+		}
+
+		return true;
+	}
+
+	double GetProcessCpuSeconds() override
+	{
+		timespec cpuTime;
+		if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpuTime) != 0)
+		{
+			return 0.0;
+		}
+		return static_cast<double>(cpuTime.tv_sec) + static_cast<double>(cpuTime.tv_nsec) * 1e-9;
+	}
+};
+
+std::unique_ptr<FrameWaitBackend> CreateDefaultFrameWaitBackend()
+{
+	return std::make_unique<PosixFrameWaitBackend>();
+}
+
+#endif
+
+FramePacer::FramePacer(std::unique_ptr<FrameWaitBackend> p_backend, double p_frameIntervalInSeconds)
+	: m_backend(std::move(p_backend))
+{
+	SetFrameInterval(p_frameIntervalInSeconds);
+
+	m_windowStart = Clock::now();
+	m_windowCpuSecondsStart = m_backend->GetProcessCpuSeconds();
+	m_nextDeadline = m_windowStart;
+	m_lastFrameStart = m_windowStart;
+}
+
+void FramePacer::SetFrameInterval(double p_frameIntervalInSeconds)
+{
+	m_frameIntervalInSeconds = p_frameIntervalInSeconds;
+	m_frameInterval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(p_frameIntervalInSeconds));
+}
+
+bool FramePacer::WaitForNextFrame()
+{
+	const auto spinMargin = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(SpinMarginInSeconds));
+
+	Clock::time_point sleepStart = Clock::now();
+	if (m_nextDeadline - sleepStart > spinMargin)
+	{
+		bool hasReachedDeadline = m_backend->SleepUntil(m_nextDeadline - spinMargin);
+		m_sleptSeconds += std::chrono::duration<double>(Clock::now() - sleepStart).count();
+
+		if (!hasReachedDeadline)
+		{
+			return false;
+		}
+	}
+
+	while (Clock::now() < m_nextDeadline)
+	{
+		// spin the last fraction of a millisecond
+	}
+
+	return true;
+}
+
+void FramePacer::Reset()
+{
+	m_nextDeadline = Clock::now();
+	m_hasStarted = false;
+}
+
+bool FramePacer::IsFrameDue() const
+{
+	return Clock::now() >= m_nextDeadline;
+}
+
+double FramePacer::BeginFrame()
+{
+	Clock::time_point now = Clock::now();
+
+	double frameSeconds = std::chrono::duration<double>(now - m_lastFrameStart).count();
+	double latenessSeconds = std::chrono::duration<double>(now - m_nextDeadline).count();
+
+	if (!m_hasStarted)
+	{
+		frameSeconds = m_frameIntervalInSeconds;
+		latenessSeconds = 0.0;
+		m_hasStarted = true;
+	}
+
+	m_lastFrameStart = now;
+	m_nextDeadline += m_frameInterval;
+	if (now - m_nextDeadline > m_frameInterval)
+	{
+		// too far behind, e.g. after a modal loop or a breakpoint
+		m_nextDeadline = now + m_frameInterval;
+	}
+
+	_accumulate(frameSeconds, latenessSeconds, now);
+
+	return frameSeconds;
+}
+
+void FramePacer::WaitForPresentQueue(void* p_waitable)
+{
+	// not counted in the stats, this runs on the render thread
+	m_backend->WaitForPresentQueue(p_waitable);
+}
+
+void FramePacer::_accumulate(double p_frameSeconds, double p_latenessSeconds, Clock::time_point p_now)
+{
+	m_frameSecondsSum += p_frameSeconds;
+	m_frameSecondsSquaredSum += p_frameSeconds * p_frameSeconds;
+	m_latenessSecondsSum += p_latenessSeconds;
+	if (p_latenessSeconds > m_maxLatenessSeconds)
+	{
+		m_maxLatenessSeconds = p_latenessSeconds;
+	}
+	m_frameCount++;
+
+	double windowSeconds = std::chrono::duration<double>(p_now - m_windowStart).count();
+	if (windowSeconds < 1.0)
+	{
+		return;
+	}
+
+	double meanFrameSeconds = m_frameSecondsSum / m_frameCount;
+	double variance = m_frameSecondsSquaredSum / m_frameCount - meanFrameSeconds * meanFrameSeconds;
+	double cpuSeconds = m_backend->GetProcessCpuSeconds();
+
+	m_stats.frameMilliseconds = meanFrameSeconds * 1000.0;
+	m_stats.jitterMilliseconds = std::sqrt(variance > 0.0 ? variance : 0.0) * 1000.0;
+	m_stats.latenessMilliseconds = m_latenessSecondsSum / m_frameCount * 1000.0;
+	m_stats.maxLatenessMilliseconds = m_maxLatenessSeconds * 1000.0;
+	m_stats.cpuUtilization = (cpuSeconds - m_windowCpuSecondsStart) / windowSeconds;
+	m_stats.sleepFraction = m_sleptSeconds / windowSeconds;
+
+	m_windowStart = p_now;
+	m_windowCpuSecondsStart = cpuSeconds;
+	m_sleptSeconds = 0.0;
+	m_frameSecondsSum = 0.0;
+	m_frameSecondsSquaredSum = 0.0;
+	m_latenessSecondsSum = 0.0;
+	m_maxLatenessSeconds = 0.0;
+	m_frameCount = 0;
+}
@@ -0,0 +1,35 @@
+#include "FramePacket.h"
+
+bool DrawItem::IsInBatchOrder(const DrawItem& p_left, const DrawItem& p_right)
+{
+	if (p_left.positionBufferView.BufferLocation != p_right.positionBufferView.BufferLocation)
+	{
+		return p_left.positionBufferView.BufferLocation < p_right.positionBufferView.BufferLocation;
+	}
+	if (p_left.indexBufferView.BufferLocation != p_right.indexBufferView.BufferLocation)
+	{
+		return p_left.indexBufferView.BufferLocation < p_right.indexBufferView.BufferLocation;
+	}
+	return p_left.textureHandle.ptr < p_right.textureHandle.ptr;
+}
+
+DrawBatch::DrawBatch(const DrawItem& p_item, UINT p_firstInstance)
+	: textureHandle(p_item.textureHandle)
+	, positionBufferView(p_item.positionBufferView)
+	, attributeBufferView(p_item.attributeBufferView)
+	, indexBufferView(p_item.indexBufferView)
+	, indexCount(p_item.indexCount)
+	, firstInstance(p_firstInstance)
+	, instanceCount(1)
+{
+}
+
+void ImGuiDrawSnapshot::Clear()
+{
+	for (ImDrawList* drawList_p : ownedLists)
+	{
+		IM_DELETE(drawList_p);
+	}
+	ownedLists.clear();
+	drawData.Clear();
+}
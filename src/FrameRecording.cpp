@@ -0,0 +1,141 @@
+#include "FrameRecording.h"
+#include "FramePacket.h"
+#include "Profiler.h"
+
+// everything of SetGBufferPassState but the pipeline state, which the depth prepass has its own of
+static void _setFirstPassRootArguments(CommandRecorder& p_recorder, const GBufferPassBindings& p_bindings, const XMMATRIX& p_vpMatrix)
+{
+	p_recorder.SetGraphicsRootSignature(p_bindings.rootSignature_p);
+
+	FirstPassRootConstants fprc = {};
+	fprc.vpMatrix = p_vpMatrix;
+	p_recorder.SetGraphicsRoot32BitConstants(2, sizeof(fprc) / 4, &fprc, 0);
+
+	p_recorder.SetGraphicsRootShaderResourceView(3, p_bindings.instanceData);
+}
+
+void SetGBufferPassState(CommandRecorder& p_recorder, const GBufferPassBindings& p_bindings, const XMMATRIX& p_vpMatrix)
+{
+	p_recorder.SetPipelineState(p_bindings.pipelineState_p);
+	_setFirstPassRootArguments(p_recorder, p_bindings, p_vpMatrix);
+}
+
+void BuildDrawBatches(const std::vector<DrawItem>& p_drawItems, std::vector<DrawBatch>& out_batches)
+{
+	out_batches.clear();
+	for (size_t i = 0; i < p_drawItems.size(); i++)
+	{
+		if (!out_batches.empty() && p_drawItems[i - 1].IsSameBatch(p_drawItems[i]))
+		{
+			out_batches.back().instanceCount++;
+		}
+		else
+		{
+			out_batches.push_back(DrawBatch(p_drawItems[i], static_cast<UINT>(i)));
+		}
+	}
+}
+
+void RecordGBufferDraws(CommandRecorder& p_recorder, const GBufferPassBindings& p_bindings, const XMMATRIX& p_vpMatrix,
+	const std::vector<DrawBatch>& p_drawBatches, size_t p_firstBatch, size_t p_endBatch)
+{
+	BEAR_PROFILE_FUNCTION();
+
+	SetGBufferPassState(p_recorder, p_bindings, p_vpMatrix);
+
+	RecordDrawBatches(p_recorder, p_drawBatches, p_firstBatch, p_endBatch);
+}
+
+void RecordDepthPrepass(CommandRecorder& p_recorder, const GBufferPassBindings& p_bindings, const XMMATRIX& p_vpMatrix,
+	const std::vector<DrawBatch>& p_drawBatches, size_t p_firstBatch, size_t p_endBatch)
+{
+	BEAR_PROFILE_FUNCTION();
+
+	p_recorder.OMSetRenderTargets(0, nullptr, FALSE, &p_bindings.depthStencil);
+	p_recorder.SetPipelineState(p_bindings.depthPrepassPipelineState_p);
+	_setFirstPassRootArguments(p_recorder, p_bindings, p_vpMatrix);
+
+	RecordDrawBatches(p_recorder, p_drawBatches, p_firstBatch, p_endBatch, true);
+
+	p_recorder.OMSetRenderTargets(p_bindings.renderTargetCount, &p_bindings.renderTargets, TRUE, &p_bindings.depthStencil);
+}
+
+void RecordShadowCascade(CommandRecorder& p_recorder, const ShadowPassBindings& p_bindings, const XMMATRIX& p_viewProjection,
+	const std::vector<DrawBatch>& p_drawBatches)
+{
+	BEAR_PROFILE_FUNCTION();
+
+	p_recorder.RSSetViewports(1, &p_bindings.viewport);
+	p_recorder.RSSetScissorRects(1, &p_bindings.scissorRect);
+	p_recorder.OMSetRenderTargets(0, nullptr, FALSE, &p_bindings.depthStencil);
+	p_recorder.ClearDepthStencilView(p_bindings.depthStencil, 1.0f);
+
+	p_recorder.SetPipelineState(p_bindings.pipelineState_p);
+	p_recorder.SetGraphicsRootSignature(p_bindings.rootSignature_p);
+
+	FirstPassRootConstants fprc = {};
+	fprc.vpMatrix = p_viewProjection;
+	p_recorder.SetGraphicsRoot32BitConstants(2, sizeof(fprc) / 4, &fprc, 0);
+
+	p_recorder.SetGraphicsRootShaderResourceView(3, p_bindings.instanceData);
+
+	RecordDrawBatches(p_recorder, p_drawBatches, 0, p_drawBatches.size(), true);
+}
+
+void RecordLightingPass(CommandRecorder& p_recorder, const LightingPassBindings& p_bindings, const XMMATRIX& p_invScreenPVMatrix)
+{
+	BEAR_PROFILE_FUNCTION();
+
+	p_recorder.SetPipelineState(p_bindings.pipelineState_p);
+	// sharing the same root signature for both passes
+	p_recorder.SetGraphicsRootSignature(p_bindings.rootSignature_p);
+
+	p_recorder.SetGraphicsRootConstantBufferView(0, p_bindings.lightConstants);
+	p_recorder.SetGraphicsRootShaderResourceView(4, p_bindings.directionalLights);
+	p_recorder.SetGraphicsRootShaderResourceView(5, p_bindings.pointLights);
+	p_recorder.SetGraphicsRootShaderResourceView(6, p_bindings.spotLights);
+	p_recorder.SetGraphicsRootShaderResourceView(7, p_bindings.lightClusters);
+	p_recorder.SetGraphicsRootShaderResourceView(8, p_bindings.lightIndices);
+
+	SecondPassRootConstants sprc = {};
+	sprc.invScreenPVMatrix = p_invScreenPVMatrix;
+	p_recorder.SetGraphicsRoot32BitConstants(3, sizeof(sprc) / 4, &sprc, 0);
+
+	p_recorder.SetGraphicsRootDescriptorTable(1, p_bindings.gBufferTable);
+
+	// Depth
+	p_recorder.SetGraphicsRootDescriptorTable(2, p_bindings.depthTable);
+
+	p_recorder.SetGraphicsRootDescriptorTable(9, p_bindings.shadowMapTable);
+
+	p_recorder.IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+	p_recorder.IASetVertexBuffers(0, 1, &p_bindings.quadVertexBufferView);
+	p_recorder.DrawInstanced(4, 1, 0, 0);
+}
+
+void RecordTiledLightingPass(CommandRecorder& p_recorder, const TiledLightingBindings& p_bindings, const XMMATRIX& p_invScreenPVMatrix)
+{
+	BEAR_PROFILE_FUNCTION();
+
+	p_recorder.SetDescriptorHeaps(1, &p_bindings.srvHeap_p);
+	p_recorder.SetPipelineState(p_bindings.pipelineState_p);
+	p_recorder.SetComputeRootSignature(p_bindings.rootSignature_p);
+
+	p_recorder.SetComputeRootConstantBufferView(0, p_bindings.lightConstants);
+	p_recorder.SetComputeRootDescriptorTable(1, p_bindings.gBufferTable);
+	p_recorder.SetComputeRootDescriptorTable(2, p_bindings.depthTable);
+
+	SecondPassRootConstants sprc = {};
+	sprc.invScreenPVMatrix = p_invScreenPVMatrix;
+	p_recorder.SetComputeRoot32BitConstants(3, sizeof(sprc) / 4, &sprc, 0);
+
+	p_recorder.SetComputeRootDescriptorTable(4, p_bindings.outputTable);
+	p_recorder.SetComputeRootShaderResourceView(5, p_bindings.directionalLights);
+	p_recorder.SetComputeRootShaderResourceView(6, p_bindings.pointLights);
+	p_recorder.SetComputeRootShaderResourceView(7, p_bindings.spotLights);
+	p_recorder.SetComputeRootDescriptorTable(8, p_bindings.shadowMapTable);
+
+	// partial tiles at the right and bottom edges skip the pixels outside
+	p_recorder.Dispatch((p_bindings.width + TiledLightingTileSize - 1) / TiledLightingTileSize,
+		(p_bindings.height + TiledLightingTileSize - 1) / TiledLightingTileSize, 1);
+}
@@ -0,0 +1,245 @@
+#include "FrustumCuller.h"
+#include "Profiler.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BEAR_FRUSTUM_CULLER_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+// MSVC emits any intrinsic regardless of /arch, the CPU check guards the call
+#define BEAR_TARGET_AVX2
+#else
+#define BEAR_TARGET_AVX2 __attribute__((target("avx2,fma,popcnt")))
+#endif
+#endif
+
+static const unsigned int PLANE_COUNT = 6;
+
+FrustumPlanes FrustumCuller::ExtractPlanes(const float* p_viewProjection_p)
+{
+	// clip = position * M, so each clip component is a column of M
+	auto column = [p_viewProjection_p](unsigned int index, float* out_column_p)
+		{
+			for (unsigned int row = 0; row < 4; row++)
+			{
+				out_column_p[row] = p_viewProjection_p[row * 4 + index];
+			}
+		};
+
+	float x[4], y[4], z[4], w[4];
+	column(0, x);
+	column(1, y);
+	column(2, z);
+	column(3, w);
+
+	FrustumPlanes frustum;
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		frustum.planes[0][i] = w[i] + x[i]; // left, -w <= x
+		frustum.planes[1][i] = w[i] - x[i]; // right, x <= w
+		frustum.planes[2][i] = w[i] + y[i]; // bottom
+		frustum.planes[3][i] = w[i] - y[i]; // top
+		frustum.planes[4][i] = z[i]; // near, 0 <= z
+		frustum.planes[5][i] = w[i] - z[i]; // far, z <= w
+	}
+	return frustum;
+}
+
+void FrustumCuller::Resize(size_t p_count)
+{
+	m_count = p_count;
+	m_centerX.resize(p_count);
+	m_centerY.resize(p_count);
+	m_centerZ.resize(p_count);
+	m_extentX.resize(p_count);
+	m_extentY.resize(p_count);
+	m_extentZ.resize(p_count);
+	m_visibleBits.resize((p_count + 7) / 8);
+}
+
+void FrustumCuller::SetBounds(size_t p_index, const BoundingAabb& p_bounds)
+{
+	m_centerX[p_index] = p_bounds.center[0];
+	m_centerY[p_index] = p_bounds.center[1];
+	m_centerZ[p_index] = p_bounds.center[2];
+	m_extentX[p_index] = p_bounds.extents[0];
+	m_extentY[p_index] = p_bounds.extents[1];
+	m_extentZ[p_index] = p_bounds.extents[2];
+}
+
+void FrustumCuller::Cull(const FrustumPlanes& p_planes, WorkerPool* p_workerPool_p)
+{
+	BEAR_PROFILE_FUNCTION();
+
+	auto cullStart = std::chrono::high_resolution_clock::now();
+
+	const bool isAvx2 = m_isAvx2Enabled && IsAvx2Supported();
+	const unsigned int maxTasks = p_workerPool_p != nullptr ? p_workerPool_p->GetThreadCount() + 1 : 1;
+	const unsigned int taskCount = static_cast<unsigned int>(std::clamp<size_t>(m_count / MinBoundsPerCullTask, 1, maxTasks));
+
+	// whole cache lines of m_visibleBits per task
+	const size_t chunkSize = ((m_count + taskCount - 1) / taskCount + 511) & ~static_cast<size_t>(511);
+
+	m_taskVisible.assign(taskCount, 0);
+
+	auto cullTask = [&](unsigned int taskIndex)
+		{
+			size_t first = std::min<size_t>(taskIndex * chunkSize, m_count);
+			size_t end = std::min<size_t>(first + chunkSize, m_count);
+			m_taskVisible[taskIndex] = isAvx2 ? _cullAvx2(p_planes, first, end) : _cullScalar(p_planes, first, end);
+		};
+
+	if (taskCount > 1)
+	{
+		p_workerPool_p->Dispatch(taskCount, cullTask);
+	}
+	else
+	{
+		cullTask(0);
+	}
+
+	m_stats.tested = static_cast<unsigned int>(m_count);
+	m_stats.visible = 0;
+	for (unsigned int visible : m_taskVisible)
+	{
+		m_stats.visible += visible;
+	}
+	m_stats.tasks = taskCount;
+	m_stats.isAvx2 = isAvx2;
+	m_stats.cullMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - cullStart).count();
+}
+
+unsigned int FrustumCuller::_cullScalar(const FrustumPlanes& p_planes, size_t p_first, size_t p_end)
+{
+	if (p_first >= p_end)
+	{
+		return 0;
+	}
+
+	memset(&m_visibleBits[p_first >> 3], 0, ((p_end - p_first) + 7) >> 3);
+
+	unsigned int visibleCount = 0;
+	for (size_t i = p_first; i < p_end; i++)
+	{
+		bool isVisible = true;
+		for (unsigned int plane = 0; plane < PLANE_COUNT && isVisible; plane++)
+		{
+			const float* coefficients_p = p_planes.planes[plane];
+
+			// distance of the center, against how far the box reaches towards the plane
+			float distance = coefficients_p[0] * m_centerX[i] + coefficients_p[1] * m_centerY[i] + coefficients_p[2] * m_centerZ[i] + coefficients_p[3];
+			float radius = std::fabs(coefficients_p[0]) * m_extentX[i] + std::fabs(coefficients_p[1]) * m_extentY[i] + std::fabs(coefficients_p[2]) * m_extentZ[i];
+			isVisible = distance + radius >= 0.0f;
+		}
+
+		if (isVisible)
+		{
+			m_visibleBits[i >> 3] |= static_cast<uint8_t>(1 << (i & 7));
+			visibleCount++;
+		}
+	}
+	return visibleCount;
+}
+
+#if defined(BEAR_FRUSTUM_CULLER_X86)
+
+BEAR_TARGET_AVX2 unsigned int FrustumCuller::_cullAvx2(const FrustumPlanes& p_planes, size_t p_first, size_t p_end)
+{
+	// broadcast once, the same planes go against every 8 boxes
+	__m256 planeX[PLANE_COUNT], planeY[PLANE_COUNT], planeZ[PLANE_COUNT], planeD[PLANE_COUNT];
+	__m256 absX[PLANE_COUNT], absY[PLANE_COUNT], absZ[PLANE_COUNT];
+	for (unsigned int plane = 0; plane < PLANE_COUNT; plane++)
+	{
+		const float* coefficients_p = p_planes.planes[plane];
+		planeX[plane] = _mm256_set1_ps(coefficients_p[0]);
+		planeY[plane] = _mm256_set1_ps(coefficients_p[1]);
+		planeZ[plane] = _mm256_set1_ps(coefficients_p[2]);
+		planeD[plane] = _mm256_set1_ps(coefficients_p[3]);
+		absX[plane] = _mm256_set1_ps(std::fabs(coefficients_p[0]));
+		absY[plane] = _mm256_set1_ps(std::fabs(coefficients_p[1]));
+		absZ[plane] = _mm256_set1_ps(std::fabs(coefficients_p[2]));
+	}
+
+	const __m256 zero = _mm256_setzero_ps();
+	unsigned int visibleCount = 0;
+
+	size_t i = p_first;
+	for (; i + 8 <= p_end; i += 8)
+	{
+		__m256 centerX = _mm256_loadu_ps(&m_centerX[i]);
+		__m256 centerY = _mm256_loadu_ps(&m_centerY[i]);
+		__m256 centerZ = _mm256_loadu_ps(&m_centerZ[i]);
+		__m256 extentX = _mm256_loadu_ps(&m_extentX[i]);
+		__m256 extentY = _mm256_loadu_ps(&m_extentY[i]);
+		__m256 extentZ = _mm256_loadu_ps(&m_extentZ[i]);
+
+		__m256 outside = zero;
+		for (unsigned int plane = 0; plane < PLANE_COUNT; plane++)
+		{
+			__m256 distance = _mm256_fmadd_ps(planeX[plane], centerX,
+				_mm256_fmadd_ps(planeY[plane], centerY, _mm256_fmadd_ps(planeZ[plane], centerZ, planeD[plane])));
+			__m256 reach = _mm256_fmadd_ps(absX[plane], extentX,
+				_mm256_fmadd_ps(absY[plane], extentY, _mm256_fmadd_ps(absZ[plane], extentZ, distance)));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(reach, zero, _CMP_LT_OQ));
+		}
+
+		unsigned int visibleMask = ~static_cast<unsigned int>(_mm256_movemask_ps(outside)) & 0xFF;
+		m_visibleBits[i >> 3] = static_cast<uint8_t>(visibleMask);
+		visibleCount += static_cast<unsigned int>(_mm_popcnt_u32(visibleMask));
+	}
+
+	// fewer than 8 left, only at the end of the last task
+	return visibleCount + _cullScalar(p_planes, i, p_end);
+}
+
+bool FrustumCuller::IsAvx2Supported()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	static const bool isSupported = []()
+		{
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] < 7)
+			{
+				return false;
+			}
+
+			// FMA, POPCNT and OSXSAVE in leaf 1, and the OS saves the YMM registers
+			__cpuid(info, 1);
+			const bool hasFma = (info[2] & (1 << 12)) != 0;
+			const bool hasPopcnt = (info[2] & (1 << 23)) != 0;
+			const bool hasOsXSave = (info[2] & (1 << 27)) != 0;
+			if (!hasFma || !hasPopcnt || !hasOsXSave || (_xgetbv(0) & 0x6) != 0x6)
+			{
+				return false;
+			}
+
+			__cpuidex(info, 7, 0);
+			return (info[1] & (1 << 5)) != 0;
+		}();
+#else
+	static const bool isSupported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+		__builtin_cpu_supports("popcnt");
+#endif
+	return isSupported;
+}
+
+#else
+
+unsigned int FrustumCuller::_cullAvx2(const FrustumPlanes& p_planes, size_t p_first, size_t p_end)
+{
+	return _cullScalar(p_planes, p_first, p_end);
+}
+
+bool FrustumCuller::IsAvx2Supported()
+{
+	return false;
+}
+
+#endif
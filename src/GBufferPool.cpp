@@ -0,0 +1,112 @@
+#include <GBufferPool.h>
+#include <Application.h>
+#include <Helpers.h>
+#include <MemoryTracker.h>
+
+#include <d3dx12.h>
+
+static GBufferPool* gs_pSingleton = nullptr;
+
+GBufferPool& GBufferPool::Get()
+{
+	if (gs_pSingleton == nullptr)
+	{
+		gs_pSingleton = new GBufferPool();
+	}
+	return *gs_pSingleton;
+}
+
+ComPtr<ID3D12Resource> GBufferPool::Acquire(UINT p_width, UINT p_height, DXGI_FORMAT p_format, D3D12_RESOURCE_FLAGS p_flags,
+	UINT p_set, D3D12_RESOURCE_STATES p_initialState, const D3D12_CLEAR_VALUE* p_clearValue_p)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (Target& target : m_targets)
+	{
+		if (target.width == p_width && target.height == p_height && target.format == p_format && target.flags == p_flags &&
+			target.set == p_set)
+		{
+			target.references++;
+			m_stats.references++;
+			m_stats.requestedBytes += target.bytes;
+			_updateSavedBytes();
+			return target.resource;
+		}
+	}
+
+	auto device = Application::Get().GetDevice();
+
+	CD3DX12_HEAP_PROPERTIES heapProperty(D3D12_HEAP_TYPE_DEFAULT);
+	CD3DX12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Tex2D(p_format, p_width, p_height, 1, 1, 1, 0, p_flags);
+
+	Target target;
+	target.width = p_width;
+	target.height = p_height;
+	target.format = p_format;
+	target.flags = p_flags;
+	target.set = p_set;
+	target.bytes = device->GetResourceAllocationInfo(0, 1, &resourceDesc).SizeInBytes;
+	target.references = 1;
+
+	ThrowIfFailed(device->CreateCommittedResource(
+		&heapProperty,
+		D3D12_HEAP_FLAG_NONE,
+		&resourceDesc,
+		p_initialState,
+		p_clearValue_p,
+		IID_PPV_ARGS(&target.resource)));
+	MemoryTracker::Get().TrackResource(GPU_MEMORY_RENDER_TARGET, target.resource.Get());
+
+	m_targets.push_back(target);
+	m_stats.targets++;
+	m_stats.references++;
+	m_stats.allocatedBytes += target.bytes;
+	m_stats.requestedBytes += target.bytes;
+	_updateSavedBytes();
+	return target.resource;
+}
+
+void GBufferPool::Release(ID3D12Resource* p_resource)
+{
+	if (p_resource == nullptr)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (size_t i = 0; i < m_targets.size(); i++)
+	{
+		Target& target = m_targets[i];
+		if (target.resource.Get() != p_resource)
+		{
+			continue;
+		}
+
+		target.references--;
+		m_stats.references--;
+		m_stats.requestedBytes -= target.bytes;
+
+		if (target.references == 0)
+		{
+			MemoryTracker::Get().UntrackResource(target.resource.Get());
+			m_stats.targets--;
+			m_stats.allocatedBytes -= target.bytes;
+			m_targets.erase(m_targets.begin() + i);
+		}
+
+		_updateSavedBytes();
+		return;
+	}
+}
+
+GBufferPoolStats GBufferPool::GetStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void GBufferPool::_updateSavedBytes()
+{
+	MemoryTracker::Get().SetGpuSharedBytes(GPU_MEMORY_RENDER_TARGET, m_stats.requestedBytes - m_stats.allocatedBytes);
+}
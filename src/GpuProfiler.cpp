@@ -0,0 +1,155 @@
+#include "GpuProfiler.h"
+
+#include <algorithm>
+
+const char* GetGpuPassName(GpuPass p_pass)
+{
+	switch (p_pass)
+	{
+	case GPU_PASS_SHADOW_MAPS:
+		return "Shadow maps";
+	case GPU_PASS_DEPTH_PREPASS:
+		return "Depth prepass";
+	case GPU_PASS_GBUFFER:
+		return "G-buffer";
+	case GPU_PASS_LIGHTING:
+		return "Lighting";
+	case GPU_PASS_IMGUI:
+		return "ImGui";
+	case GPU_PASS_OVERLAY:
+		return "Overlay";
+	default:
+		return "Unknown";
+	}
+}
+
+GpuProfiler::GpuProfiler(std::unique_ptr<GpuTimestampBackend> p_backend, unsigned int p_latencyFrames)
+	: m_backend(std::move(p_backend))
+	, m_latencyFrames(std::max<unsigned int>(p_latencyFrames, 1))
+{
+	m_slots = std::make_unique<FrameSlot[]>(m_latencyFrames);
+	m_backend->Initialize(m_latencyFrames * QueriesPerFrame);
+	m_stats.latencyFrames = m_latencyFrames;
+}
+
+void GpuProfiler::BeginFrame(uint64_t p_frameNumber, uint64_t p_completedFrames)
+{
+	// oldest first, so the averages follow frame order
+	for (unsigned int i = 0; i < m_latencyFrames; i++)
+	{
+		uint32_t slotIndex = static_cast<uint32_t>((p_frameNumber + 1 + i) % m_latencyFrames);
+		FrameSlot& slot = m_slots[slotIndex];
+		if (slot.isPending && slot.frameNumber < p_completedFrames)
+		{
+			_collect(slot, slotIndex);
+		}
+	}
+
+	m_currentSlotIndex = static_cast<uint32_t>(p_frameNumber % m_latencyFrames);
+	m_currentSlot_p = &m_slots[m_currentSlotIndex];
+
+	if (m_currentSlot_p->isPending)
+	{
+		// the GPU has not finished that frame yet, its results are given up for the new one
+		std::lock_guard<std::mutex> lock(m_statsMutex);
+		m_stats.droppedFrames++;
+	}
+
+	*m_currentSlot_p = FrameSlot();
+	m_currentSlot_p->frameNumber = p_frameNumber;
+}
+
+void GpuProfiler::BeginPass(GpuCommandListHandle p_commandList, GpuPass p_pass)
+{
+	if (m_currentSlot_p == nullptr)
+	{
+		return;
+	}
+
+	m_backend->WriteTimestamp(p_commandList, m_currentSlotIndex * QueriesPerFrame + p_pass * 2);
+	m_currentSlot_p->openPasses |= 1 << p_pass;
+	m_currentSlot_p->cpuPassStart[p_pass] = Clock::now();
+}
+
+void GpuProfiler::EndPass(GpuCommandListHandle p_commandList, GpuPass p_pass)
+{
+	if (m_currentSlot_p == nullptr || (m_currentSlot_p->openPasses & (1 << p_pass)) == 0)
+	{
+		return;
+	}
+
+	m_backend->WriteTimestamp(p_commandList, m_currentSlotIndex * QueriesPerFrame + p_pass * 2 + 1);
+	m_currentSlot_p->openPasses &= ~(1 << p_pass);
+	m_currentSlot_p->timedPasses |= 1 << p_pass;
+	m_currentSlot_p->cpuMilliseconds[p_pass] = std::chrono::duration<double, std::milli>(Clock::now() - m_currentSlot_p->cpuPassStart[p_pass]).count();
+}
+
+void GpuProfiler::EndFrame(GpuCommandListHandle p_commandList)
+{
+	if (m_currentSlot_p == nullptr)
+	{
+		return;
+	}
+
+	// only what was written, resolving a query that never ended is invalid
+	for (uint32_t pass = 0; pass < GPU_PASS_COUNT; pass++)
+	{
+		if (m_currentSlot_p->timedPasses & (1 << pass))
+		{
+			m_backend->Resolve(p_commandList, m_currentSlotIndex * QueriesPerFrame + pass * 2, 2);
+		}
+	}
+
+	m_currentSlot_p->isPending = m_currentSlot_p->timedPasses != 0;
+	m_currentSlot_p = nullptr;
+}
+
+GpuPassStats GpuProfiler::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_statsMutex);
+	return m_stats;
+}
+
+void GpuProfiler::_collect(FrameSlot& p_slot, uint32_t p_slotIndex)
+{
+	const double millisecondsPerTick = 1000.0 / static_cast<double>(std::max<uint64_t>(m_backend->GetFrequency(), 1));
+
+	for (uint32_t pass = 0; pass < GPU_PASS_COUNT; pass++)
+	{
+		if ((p_slot.timedPasses & (1 << pass)) == 0)
+		{
+			continue;
+		}
+
+		uint64_t ticks[2] = { 0, 0 };
+		m_backend->ReadResolved(p_slotIndex * QueriesPerFrame + pass * 2, 2, ticks);
+
+		m_gpuMillisecondsSum[pass] += ticks[1] > ticks[0] ? static_cast<double>(ticks[1] - ticks[0]) * millisecondsPerTick : 0.0;
+		m_cpuMillisecondsSum[pass] += p_slot.cpuMilliseconds[pass];
+		m_passFrameCount[pass]++;
+	}
+
+	p_slot.isPending = false;
+	m_accumulatedFrames++;
+
+	std::lock_guard<std::mutex> lock(m_statsMutex);
+	m_stats.collectedFrames++;
+
+	if (m_accumulatedFrames < AveragingFrames)
+	{
+		return;
+	}
+
+	// a pass missing from every frame of the window, e.g. ImGui in the demo window, reads 0
+	for (uint32_t pass = 0; pass < GPU_PASS_COUNT; pass++)
+	{
+		unsigned int frameCount = std::max<unsigned int>(m_passFrameCount[pass], 1);
+		m_stats.gpuMilliseconds[pass] = m_gpuMillisecondsSum[pass] / frameCount;
+		m_stats.cpuMilliseconds[pass] = m_cpuMillisecondsSum[pass] / frameCount;
+
+		m_gpuMillisecondsSum[pass] = 0.0;
+		m_cpuMillisecondsSum[pass] = 0.0;
+		m_passFrameCount[pass] = 0;
+	}
+	m_accumulatedFrames = 0;
+}
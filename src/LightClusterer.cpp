@@ -0,0 +1,227 @@
+#include "LightClusterer.h"
+#include "Profiler.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+void LightClusterer::SetFrustum(const float* p_view_p, float p_tanHalfFovX, float p_tanHalfFovY, float p_nearZ, float p_farZ)
+{
+	memcpy(m_view, p_view_p, sizeof(m_view));
+	m_tanHalfFovX = p_tanHalfFovX;
+	m_tanHalfFovY = p_tanHalfFovY;
+	m_nearZ = p_nearZ;
+	m_farZ = p_farZ;
+
+	const float logDepthRange = std::log(m_farZ / m_nearZ);
+	m_depthSliceScale = ClustersZ / logDepthRange;
+	m_depthSliceBias = -(ClustersZ * std::log(m_nearZ)) / logDepthRange;
+
+	for (unsigned int slice = 0; slice <= ClustersZ; slice++)
+	{
+		m_sliceDepths[slice] = m_nearZ * std::pow(m_farZ / m_nearZ, static_cast<float>(slice) / ClustersZ);
+	}
+	m_sliceDepths[ClustersZ] = m_farZ;
+}
+
+void LightClusterer::Resize(size_t p_count)
+{
+	m_lights.resize(p_count);
+	m_viewLights.resize(p_count);
+}
+
+void LightClusterer::SetLight(size_t p_index, const LightSphere& p_light)
+{
+	m_lights[p_index] = p_light;
+}
+
+void LightClusterer::Bin(WorkerPool* p_workerPool_p)
+{
+	BEAR_PROFILE_FUNCTION();
+
+	auto binStart = std::chrono::high_resolution_clock::now();
+
+	const size_t count = m_lights.size();
+	const unsigned int maxTasks = p_workerPool_p != nullptr ? p_workerPool_p->GetThreadCount() + 1 : 1;
+	const unsigned int viewTaskCount = static_cast<unsigned int>(std::clamp<size_t>(count / MinLightsPerTask, 1, maxTasks));
+	const size_t chunkSize = (count + viewTaskCount - 1) / viewTaskCount;
+
+	auto viewTask = [&](unsigned int taskIndex)
+		{
+			size_t first = std::min<size_t>(taskIndex * chunkSize, count);
+			_toViewSpace(first, std::min<size_t>(first + chunkSize, count));
+		};
+
+	auto sliceTask = [&](unsigned int slice)
+		{
+			_binSlice(slice);
+		};
+
+	if (maxTasks > 1)
+	{
+		p_workerPool_p->Dispatch(viewTaskCount, viewTask);
+		p_workerPool_p->Dispatch(ClustersZ, sliceTask);
+	}
+	else
+	{
+		viewTask(0);
+		for (unsigned int slice = 0; slice < ClustersZ; slice++)
+		{
+			sliceTask(slice);
+		}
+	}
+
+	// one list, cluster after cluster
+	uint32_t offset = 0;
+	m_stats.maxPerCluster = 0;
+	for (unsigned int cluster = 0; cluster < ClusterCount; cluster++)
+	{
+		const uint32_t clusterCount = static_cast<uint32_t>(m_clusterLights[cluster].size());
+		m_clusters[cluster].offset = offset;
+		m_clusters[cluster].count = clusterCount;
+		offset += clusterCount;
+		m_stats.maxPerCluster = std::max<unsigned int>(m_stats.maxPerCluster, clusterCount);
+	}
+
+	m_lightIndices.resize(offset);
+	for (unsigned int cluster = 0; cluster < ClusterCount; cluster++)
+	{
+		std::copy(m_clusterLights[cluster].begin(), m_clusterLights[cluster].end(), m_lightIndices.begin() + m_clusters[cluster].offset);
+	}
+
+	m_stats.lights = static_cast<unsigned int>(count);
+	m_stats.lightsInFrustum = 0;
+	for (const ViewLight& light : m_viewLights)
+	{
+		m_stats.lightsInFrustum += light.firstSlice < light.endSlice ? 1 : 0;
+	}
+	m_stats.indices = offset;
+	m_stats.tasks = maxTasks > 1 ? std::min<unsigned int>(maxTasks, ClustersZ) : 1;
+	m_stats.binMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - binStart).count();
+}
+
+void LightClusterer::_toViewSpace(size_t p_first, size_t p_end)
+{
+	// distance to a side plane through the eye is (x - tan z) / sqrt(1 + tan^2)
+	const float sideScaleX = 1.0f / std::sqrt(1.0f + m_tanHalfFovX * m_tanHalfFovX);
+	const float sideScaleY = 1.0f / std::sqrt(1.0f + m_tanHalfFovY * m_tanHalfFovY);
+
+	for (size_t i = p_first; i < p_end; i++)
+	{
+		const LightSphere& light = m_lights[i];
+		ViewLight& viewLight = m_viewLights[i];
+
+		for (unsigned int column = 0; column < 3; column++)
+		{
+			viewLight.center[column] = light.center[0] * m_view[column] + light.center[1] * m_view[4 + column] +
+				light.center[2] * m_view[8 + column] + m_view[12 + column];
+		}
+		viewLight.radius = light.radius;
+		viewLight.firstSlice = 0;
+		viewLight.endSlice = 0;
+
+		const float x = viewLight.center[0];
+		const float y = viewLight.center[1];
+		const float z = viewLight.center[2];
+		const float radius = light.radius;
+		if (radius <= 0.0f || z + radius < m_nearZ || z - radius > m_farZ ||
+			(x - m_tanHalfFovX * z) * sideScaleX > radius || (-x - m_tanHalfFovX * z) * sideScaleX > radius ||
+			(y - m_tanHalfFovY * z) * sideScaleY > radius || (-y - m_tanHalfFovY * z) * sideScaleY > radius)
+		{
+			continue;
+		}
+
+		// the slice formula, clamped to the frustum; one more on each side, the boxes decide
+		auto sliceOf = [&](float depth)
+			{
+				depth = std::clamp<float>(depth, m_nearZ, m_farZ);
+				return std::clamp<int32_t>(static_cast<int32_t>(std::floor(std::log(depth) * m_depthSliceScale + m_depthSliceBias)), 0, ClustersZ - 1);
+			};
+		viewLight.firstSlice = std::max<int32_t>(sliceOf(z - radius) - 1, 0);
+		viewLight.endSlice = std::min<int32_t>(sliceOf(z + radius) + 2, ClustersZ);
+	}
+}
+
+void LightClusterer::_binSlice(unsigned int p_slice)
+{
+	for (unsigned int cluster = p_slice * ClustersX * ClustersY; cluster < (p_slice + 1) * ClustersX * ClustersY; cluster++)
+	{
+		m_clusterLights[cluster].clear();
+	}
+
+	const float sliceNear = m_sliceDepths[p_slice];
+	const float sliceFar = m_sliceDepths[p_slice + 1];
+
+	for (size_t i = 0; i < m_viewLights.size(); i++)
+	{
+		const ViewLight& light = m_viewLights[i];
+		if (static_cast<int32_t>(p_slice) < light.firstSlice || static_cast<int32_t>(p_slice) >= light.endSlice)
+		{
+			continue;
+		}
+
+		// the light's box within the slice, then the tiles it covers on screen
+		const float nearZ = std::max<float>(sliceNear, light.center[2] - light.radius);
+		const float farZ = std::min<float>(sliceFar, light.center[2] + light.radius);
+		if (farZ < nearZ)
+		{
+			continue;
+		}
+
+		// x / z over the box is smallest and largest at its corners
+		auto projectedRange = [&](float center, float tanHalfFov, float& out_minimum, float& out_maximum)
+			{
+				float minimum = center - light.radius;
+				float maximum = center + light.radius;
+				out_minimum = minimum / ((minimum >= 0.0f ? farZ : nearZ) * tanHalfFov);
+				out_maximum = maximum / ((maximum >= 0.0f ? nearZ : farZ) * tanHalfFov);
+			};
+
+		float minX, maxX, minY, maxY;
+		projectedRange(light.center[0], m_tanHalfFovX, minX, maxX);
+		projectedRange(light.center[1], m_tanHalfFovY, minY, maxY);
+		if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+		{
+			continue;
+		}
+
+		// rows count from the top of the screen
+		auto tileOf = [](float position, unsigned int tileCount)
+			{
+				return std::clamp<int32_t>(static_cast<int32_t>(std::floor(position * tileCount)), 0, tileCount - 1);
+			};
+		const int32_t firstTileX = tileOf(minX * 0.5f + 0.5f, ClustersX);
+		const int32_t lastTileX = tileOf(maxX * 0.5f + 0.5f, ClustersX);
+		const int32_t firstTileY = tileOf(0.5f - maxY * 0.5f, ClustersY);
+		const int32_t lastTileY = tileOf(0.5f - minY * 0.5f, ClustersY);
+
+		const float radiusSquared = light.radius * light.radius;
+		for (int32_t tileY = firstTileY; tileY <= lastTileY; tileY++)
+		{
+			// the tile's edges in NDC, y up
+			const float top = (1.0f - 2.0f * tileY / ClustersY) * m_tanHalfFovY;
+			const float bottom = (1.0f - 2.0f * (tileY + 1) / ClustersY) * m_tanHalfFovY;
+			const float boxMinY = std::min<float>(bottom * sliceNear, bottom * sliceFar);
+			const float boxMaxY = std::max<float>(top * sliceNear, top * sliceFar);
+			const float distanceY = std::max<float>({ boxMinY - light.center[1], 0.0f, light.center[1] - boxMaxY });
+
+			for (int32_t tileX = firstTileX; tileX <= lastTileX; tileX++)
+			{
+				const float left = (2.0f * tileX / ClustersX - 1.0f) * m_tanHalfFovX;
+				const float right = (2.0f * (tileX + 1) / ClustersX - 1.0f) * m_tanHalfFovX;
+				const float boxMinX = std::min<float>(left * sliceNear, left * sliceFar);
+				const float boxMaxX = std::max<float>(right * sliceNear, right * sliceFar);
+				const float distanceX = std::max<float>({ boxMinX - light.center[0], 0.0f, light.center[0] - boxMaxX });
+				const float distanceZ = std::max<float>({ sliceNear - light.center[2], 0.0f, light.center[2] - sliceFar });
+
+				// the sphere against the view space box around the cluster
+				if (distanceX * distanceX + distanceY * distanceY + distanceZ * distanceZ <= radiusSquared)
+				{
+					m_clusterLights[(p_slice * ClustersY + tileY) * ClustersX + tileX].push_back(static_cast<uint32_t>(i));
+				}
+			}
+		}
+	}
+}
@@ -1,41 +1,202 @@
 #include <LightManager.h>
+#include <MemoryTracker.h>
+
+#include <algorithm>
+
+// every section of a frame buffer starts on this, and takes at least a light's worth of bytes so
+// even an empty one has an address inside the buffer
+static const size_t LightSectionAlignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+static const size_t LightSectionMinimumSize = 64;
+
+static size_t _alignSection(size_t p_size)
+{
+	return (std::max<size_t>(p_size, LightSectionMinimumSize) + LightSectionAlignment - 1) & ~(LightSectionAlignment - 1);
+}
 
 LightManager::LightManager(XMFLOAT4& p_cameraPosition)
 {
-	m_lightCBSize = CalcConstantBufferByteSize(sizeof(LightConstants));
-	auto device = Application::Get().GetDevice();
-	static CD3DX12_HEAP_PROPERTIES heap_upload = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-	static CD3DX12_RESOURCE_DESC buffer_upload = CD3DX12_RESOURCE_DESC::Buffer(m_lightCBSize);
+	m_lights.constants.CameraPosition = p_cameraPosition;
+}
 
-	// upload and map
-	ThrowIfFailed(device->CreateCommittedResource(
-		&heap_upload,
-		D3D12_HEAP_FLAG_NONE,
-		&buffer_upload,
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		nullptr,
-		IID_PPV_ARGS(&m_uploadBuffer)));
-	ThrowIfFailed(m_uploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&m_mappedData)));
+LightManager::~LightManager()
+{
+	for (FrameBuffer& frameBuffer : m_frameBuffers)
+	{
+		if (frameBuffer.uploadBuffer)
+		{
+			frameBuffer.uploadBuffer->Unmap(0, nullptr);
+			frameBuffer.mappedData = nullptr;
+			MemoryTracker::Get().UntrackResource(frameBuffer.uploadBuffer.Get());
+		}
+	}
+}
 
-	// initialize the data
-	CopyData(&m_lightConstants);
+void LightManager::CopyData(const LightSet& p_lights)
+{
+	std::lock_guard<std::mutex> lock(m_lightsMutex);
+	XMFLOAT4 cameraPosition = m_lights.constants.CameraPosition;
+	m_lights = p_lights;
+	m_lights.constants.CameraPosition = cameraPosition;
 }
 
-LightManager::~LightManager()
+void LightManager::UpdateCameraPosition(XMFLOAT4& p_cameraPosition)
+{
+	std::lock_guard<std::mutex> lock(m_lightsMutex);
+	m_lights.constants.CameraPosition = p_cameraPosition;
+}
+
+LightBufferAddresses LightManager::UploadForFrame(UINT p_frameSlot, const LightSet& p_lights,
+	const std::vector<LightCluster>& p_clusters, const std::vector<uint32_t>& p_lightIndices)
 {
-	if (m_uploadBuffer)
+	const size_t sectionSizes[6] =
+	{
+		sizeof(LightConstants),
+		sizeof(DirectionalLight) * p_lights.directionalLights.size(),
+		sizeof(PointLight) * p_lights.pointLights.size(),
+		sizeof(SpotLight) * p_lights.spotLights.size(),
+		sizeof(LightCluster) * p_clusters.size(),
+		sizeof(uint32_t) * p_lightIndices.size()
+	};
+	const void* sectionData[6] =
+	{
+		&p_lights.constants,
+		p_lights.directionalLights.data(),
+		p_lights.pointLights.data(),
+		p_lights.spotLights.data(),
+		p_clusters.data(),
+		p_lightIndices.data()
+	};
+
+	size_t totalSize = 0;
+	for (size_t sectionSize : sectionSizes)
+	{
+		totalSize += _alignSection(sectionSize);
+	}
+
+	FrameBuffer& frameBuffer = m_frameBuffers[p_frameSlot];
+	_reserve(frameBuffer, totalSize);
+
+	D3D12_GPU_VIRTUAL_ADDRESS sectionAddresses[6] = {};
+	size_t offset = 0;
+	for (unsigned int section = 0; section < 6; section++)
 	{
-		m_uploadBuffer->Unmap(0, nullptr);
-		m_mappedData = nullptr;
+		if (sectionSizes[section] > 0)
+		{
+			memcpy(frameBuffer.mappedData + offset, sectionData[section], sectionSizes[section]);
+		}
+		sectionAddresses[section] = frameBuffer.uploadBuffer->GetGPUVirtualAddress() + offset;
+		offset += _alignSection(sectionSizes[section]);
 	}
+
+	// the counts follow the arrays, whatever the caller left in the constants
+	LightConstants* constants_p = reinterpret_cast<LightConstants*>(frameBuffer.mappedData);
+	constants_p->NumOfDirectionalLights = static_cast<uint32_t>(p_lights.directionalLights.size());
+	constants_p->NumOfPointLights = static_cast<uint32_t>(p_lights.pointLights.size());
+	constants_p->NumOfSpotLights = static_cast<uint32_t>(p_lights.spotLights.size());
+
+	LightBufferAddresses addresses;
+	addresses.constants = sectionAddresses[0];
+	addresses.directionalLights = sectionAddresses[1];
+	addresses.pointLights = sectionAddresses[2];
+	addresses.spotLights = sectionAddresses[3];
+	addresses.clusters = sectionAddresses[4];
+	addresses.lightIndices = sectionAddresses[5];
+	return addresses;
 }
 
-LightConstants& LightManager::GetLightConstants()
+void LightManager::CopyLights(LightSet& out_lights)
 {
-	return m_lightConstants;
+	std::lock_guard<std::mutex> lock(m_lightsMutex);
+	out_lights = m_lights;
 }
 
-void LightManager::CopyData(LightConstants* p_lightConstant_p)
+void LightManager::SerializeLights(const LightSet& p_lights, std::vector<unsigned char>& out_data)
 {
-	memcpy(m_mappedData, p_lightConstant_p, sizeof(LightConstants));
-}
\ No newline at end of file
+	LightConstants constants = p_lights.constants;
+	constants.NumOfDirectionalLights = static_cast<uint32_t>(p_lights.directionalLights.size());
+	constants.NumOfPointLights = static_cast<uint32_t>(p_lights.pointLights.size());
+	constants.NumOfSpotLights = static_cast<uint32_t>(p_lights.spotLights.size());
+
+	out_data.resize(sizeof(LightConstants) +
+		sizeof(DirectionalLight) * p_lights.directionalLights.size() +
+		sizeof(PointLight) * p_lights.pointLights.size() +
+		sizeof(SpotLight) * p_lights.spotLights.size());
+
+	unsigned char* data_p = out_data.data();
+	memcpy(data_p, &constants, sizeof(LightConstants));
+	data_p += sizeof(LightConstants);
+	memcpy(data_p, p_lights.directionalLights.data(), sizeof(DirectionalLight) * p_lights.directionalLights.size());
+	data_p += sizeof(DirectionalLight) * p_lights.directionalLights.size();
+	memcpy(data_p, p_lights.pointLights.data(), sizeof(PointLight) * p_lights.pointLights.size());
+	data_p += sizeof(PointLight) * p_lights.pointLights.size();
+	memcpy(data_p, p_lights.spotLights.data(), sizeof(SpotLight) * p_lights.spotLights.size());
+}
+
+bool LightManager::DeserializeLights(const unsigned char* p_data_p, size_t p_size, LightSet& out_lights)
+{
+	if (p_size < sizeof(LightConstants))
+	{
+		return false;
+	}
+
+	LightConstants constants;
+	memcpy(&constants, p_data_p, sizeof(LightConstants));
+
+	const size_t expectedSize = sizeof(LightConstants) +
+		sizeof(DirectionalLight) * static_cast<size_t>(constants.NumOfDirectionalLights) +
+		sizeof(PointLight) * static_cast<size_t>(constants.NumOfPointLights) +
+		sizeof(SpotLight) * static_cast<size_t>(constants.NumOfSpotLights);
+	if (p_size != expectedSize)
+	{
+		return false;
+	}
+
+	out_lights.constants = constants;
+	out_lights.directionalLights.resize(constants.NumOfDirectionalLights);
+	out_lights.pointLights.resize(constants.NumOfPointLights);
+	out_lights.spotLights.resize(constants.NumOfSpotLights);
+
+	const unsigned char* data_p = p_data_p + sizeof(LightConstants);
+	memcpy(out_lights.directionalLights.data(), data_p, sizeof(DirectionalLight) * out_lights.directionalLights.size());
+	data_p += sizeof(DirectionalLight) * out_lights.directionalLights.size();
+	memcpy(out_lights.pointLights.data(), data_p, sizeof(PointLight) * out_lights.pointLights.size());
+	data_p += sizeof(PointLight) * out_lights.pointLights.size();
+	memcpy(out_lights.spotLights.data(), data_p, sizeof(SpotLight) * out_lights.spotLights.size());
+	return true;
+}
+
+void LightManager::_reserve(FrameBuffer& p_frameBuffer, size_t p_size)
+{
+	if (p_frameBuffer.capacity >= p_size)
+	{
+		return;
+	}
+
+	// the frame that used this slot last has finished, its buffer can go
+	if (p_frameBuffer.uploadBuffer)
+	{
+		p_frameBuffer.uploadBuffer->Unmap(0, nullptr);
+		MemoryTracker::Get().UntrackResource(p_frameBuffer.uploadBuffer.Get());
+		p_frameBuffer.uploadBuffer.Reset();
+	}
+
+	// grow by half again, so a slowly growing light count does not reallocate every frame
+	const size_t capacity = _alignSection(std::max<size_t>(p_size, p_frameBuffer.capacity + p_frameBuffer.capacity / 2));
+
+	auto device = Application::Get().GetDevice();
+	CD3DX12_HEAP_PROPERTIES heapUpload(D3D12_HEAP_TYPE_UPLOAD);
+	CD3DX12_RESOURCE_DESC bufferUpload = CD3DX12_RESOURCE_DESC::Buffer(capacity);
+
+	// upload and map
+	ThrowIfFailed(device->CreateCommittedResource(
+		&heapUpload,
+		D3D12_HEAP_FLAG_NONE,
+		&bufferUpload,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&p_frameBuffer.uploadBuffer)));
+	ThrowIfFailed(p_frameBuffer.uploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&p_frameBuffer.mappedData)));
+	MemoryTracker::Get().TrackResource(GPU_MEMORY_CONSTANT, p_frameBuffer.uploadBuffer.Get());
+
+	p_frameBuffer.capacity = capacity;
+}
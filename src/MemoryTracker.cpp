@@ -0,0 +1,304 @@
+#include <MemoryTracker.h>
+#include <Helpers.h>
+#include <MessageQueue.h>
+#include <UIManager.h>
+#include <MeshManager.h>
+
+#include <psapi.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <Jolt/Jolt.h>
+
+static const char* MEMORY_TAG_NAMES[MEMORY_TAG_COUNT] = { "mesh", "texture", "message", "ui", "jolt" };
+static const char* GPU_MEMORY_CATEGORY_NAMES[GPU_MEMORY_COUNT] = { "mesh", "texture", "render_target", "constant" };
+
+// Tagged blocks carry a header in front of the returned pointer:
+// [.. padding ..][header size: uint64][block size: uint64][user data ...]
+// The header is at least 16 bytes and a multiple of the alignment, so the user data keeps it.
+static const size_t TAGGED_HEADER_MIN_SIZE = 16;
+
+MemoryTracker& MemoryTracker::Get()
+{
+	// created on the first call from any thread, e.g. Jolt's first allocation on a job thread;
+	// never destroyed, tagged blocks may still be freed while statics are torn down
+	static MemoryTracker* const tracker_p = new MemoryTracker();
+	return *tracker_p;
+}
+
+void MemoryTracker::Initialize(ComPtr<ID3D12Device2> p_device, ComPtr<IDXGIAdapter4> p_adapter)
+{
+	m_device = p_device;
+	m_adapter = p_adapter;
+	m_sampleClock.Reset();
+}
+
+void MemoryTracker::AddCpuBytes(MemoryTag p_tag, size_t p_bytes)
+{
+	int64_t current = m_cpuBytes[p_tag].fetch_add(static_cast<int64_t>(p_bytes), std::memory_order_relaxed) + static_cast<int64_t>(p_bytes);
+
+	int64_t peak = m_cpuPeakBytes[p_tag].load(std::memory_order_relaxed);
+	while (current > peak && !m_cpuPeakBytes[p_tag].compare_exchange_weak(peak, current, std::memory_order_relaxed))
+	{
+	}
+}
+
+void MemoryTracker::RemoveCpuBytes(MemoryTag p_tag, size_t p_bytes)
+{
+	m_cpuBytes[p_tag].fetch_sub(static_cast<int64_t>(p_bytes), std::memory_order_relaxed);
+}
+
+void* MemoryTracker::TaggedAllocate(MemoryTag p_tag, size_t p_size, size_t p_alignment)
+{
+	const size_t alignment = std::max<size_t>(p_alignment, TAGGED_HEADER_MIN_SIZE);
+	const size_t headerSize = alignment; // alignment is a power of two >= 16
+
+	unsigned char* base_p = static_cast<unsigned char*>(_aligned_malloc(p_size + headerSize, alignment));
+	if (base_p == nullptr)
+	{
+		return nullptr;
+	}
+
+	unsigned char* block_p = base_p + headerSize;
+	reinterpret_cast<uint64_t*>(block_p)[-1] = p_size;
+	reinterpret_cast<uint64_t*>(block_p)[-2] = headerSize;
+
+	MemoryTracker& tracker = Get();
+	tracker.AddCpuBytes(p_tag, p_size);
+	tracker.m_cpuAllocations[p_tag].fetch_add(1, std::memory_order_relaxed);
+
+	return block_p;
+}
+
+void* MemoryTracker::TaggedReallocate(MemoryTag p_tag, void* p_block, size_t p_newSize)
+{
+	void* newBlock_p = TaggedAllocate(p_tag, p_newSize);
+	if (p_block != nullptr && newBlock_p != nullptr)
+	{
+		uint64_t oldSize = reinterpret_cast<uint64_t*>(p_block)[-1];
+		memcpy(newBlock_p, p_block, static_cast<size_t>(std::min<uint64_t>(oldSize, p_newSize)));
+	}
+	TaggedFree(p_tag, p_block);
+	return newBlock_p;
+}
+
+void MemoryTracker::TaggedFree(MemoryTag p_tag, void* p_block)
+{
+	if (p_block == nullptr)
+	{
+		return;
+	}
+
+	unsigned char* block_p = static_cast<unsigned char*>(p_block);
+	uint64_t size = reinterpret_cast<uint64_t*>(block_p)[-1];
+	uint64_t headerSize = reinterpret_cast<uint64_t*>(block_p)[-2];
+
+	MemoryTracker& tracker = Get();
+	tracker.RemoveCpuBytes(p_tag, static_cast<size_t>(size));
+	tracker.m_cpuAllocations[p_tag].fetch_sub(1, std::memory_order_relaxed);
+
+	_aligned_free(block_p - headerSize);
+}
+
+void MemoryTracker::RegisterJoltAllocator()
+{
+	JPH::Allocate = [](size_t inSize) { return TaggedAllocate(MEMORY_TAG_JOLT, inSize); };
+	// the block knows its own size
+	JPH::Reallocate = [](void* inBlock, size_t, size_t inNewSize) { return TaggedReallocate(MEMORY_TAG_JOLT, inBlock, inNewSize); };
+	JPH::Free = [](void* inBlock) { TaggedFree(MEMORY_TAG_JOLT, inBlock); };
+	JPH::AlignedAllocate = [](size_t inSize, size_t inAlignment) { return TaggedAllocate(MEMORY_TAG_JOLT, inSize, inAlignment); };
+	JPH::AlignedFree = [](void* inBlock) { TaggedFree(MEMORY_TAG_JOLT, inBlock); };
+}
+
+void MemoryTracker::TrackResource(GpuMemoryCategory p_category, ID3D12Resource* p_resource)
+{
+	if (p_resource == nullptr || !m_device)
+	{
+		return;
+	}
+
+	D3D12_RESOURCE_DESC desc = p_resource->GetDesc();
+	D3D12_RESOURCE_ALLOCATION_INFO allocationInfo = m_device->GetResourceAllocationInfo(0, 1, &desc);
+
+	std::lock_guard<std::mutex> lock(m_gpuMutex);
+
+	auto iter = m_gpuResources.find(p_resource);
+	if (iter != m_gpuResources.end())
+	{
+		m_gpuBytes[iter->second.category] -= iter->second.bytes;
+		m_gpuResourceCount[iter->second.category] -= 1;
+	}
+
+	m_gpuResources[p_resource] = { p_category, allocationInfo.SizeInBytes };
+	m_gpuBytes[p_category] += allocationInfo.SizeInBytes;
+	m_gpuResourceCount[p_category] += 1;
+}
+
+void MemoryTracker::UntrackResource(ID3D12Resource* p_resource)
+{
+	if (p_resource == nullptr)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_gpuMutex);
+
+	auto iter = m_gpuResources.find(p_resource);
+	if (iter == m_gpuResources.end())
+	{
+		return;
+	}
+
+	m_gpuBytes[iter->second.category] -= iter->second.bytes;
+	m_gpuResourceCount[iter->second.category] -= 1;
+	m_gpuResources.erase(iter);
+}
+
+void MemoryTracker::SetGpuSharedBytes(GpuMemoryCategory p_category, uint64_t p_bytes)
+{
+	std::lock_guard<std::mutex> lock(m_gpuMutex);
+	m_gpuSharedBytes[p_category] = p_bytes;
+}
+
+void MemoryTracker::Update()
+{
+	m_sampleClock.Tick();
+	double now = m_sampleClock.GetTotalSeconds();
+
+	if (m_lastSampleTime >= 0.0 && now - m_lastSampleTime < m_sampleIntervalInSeconds)
+	{
+		return;
+	}
+
+	m_lastSampleTime = now;
+	Sample();
+}
+
+void MemoryTracker::Sample()
+{
+	MemoryStats stats;
+	stats.sampleTimeInSeconds = m_sampleClock.GetTotalSeconds();
+
+	for (int i = 0; i < MEMORY_TAG_COUNT; i++)
+	{
+		// counters may briefly dip below zero while another thread is between free and alloc
+		stats.cpuBytes[i] = static_cast<uint64_t>(std::max<int64_t>(0, m_cpuBytes[i].load(std::memory_order_relaxed)));
+		stats.cpuPeakBytes[i] = static_cast<uint64_t>(std::max<int64_t>(0, m_cpuPeakBytes[i].load(std::memory_order_relaxed)));
+		stats.cpuAllocations[i] = static_cast<uint64_t>(std::max<int64_t>(0, m_cpuAllocations[i].load(std::memory_order_relaxed)));
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_gpuMutex);
+		memcpy(stats.gpuBytes, m_gpuBytes, sizeof(m_gpuBytes));
+		memcpy(stats.gpuResources, m_gpuResourceCount, sizeof(m_gpuResourceCount));
+		memcpy(stats.gpuSharedBytes, m_gpuSharedBytes, sizeof(m_gpuSharedBytes));
+	}
+
+	MEMORYSTATUSEX memoryStatus = {};
+	memoryStatus.dwLength = sizeof(MEMORYSTATUSEX);
+	if (GlobalMemoryStatusEx(&memoryStatus))
+	{
+		stats.systemAvailableBytes = memoryStatus.ullAvailPhys;
+		stats.systemTotalBytes = memoryStatus.ullTotalPhys;
+	}
+
+	PROCESS_MEMORY_COUNTERS_EX processCounters = {};
+	if (GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&processCounters), sizeof(processCounters)))
+	{
+		stats.processWorkingSetBytes = processCounters.WorkingSetSize;
+		stats.processPrivateBytes = processCounters.PrivateUsage;
+	}
+
+	if (m_adapter)
+	{
+		DXGI_QUERY_VIDEO_MEMORY_INFO videoMemoryInfo = {};
+		if (SUCCEEDED(m_adapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &videoMemoryInfo)))
+		{
+			stats.videoMemoryUsageBytes = videoMemoryInfo.CurrentUsage;
+			stats.videoMemoryBudgetBytes = videoMemoryInfo.Budget;
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_statsMutex);
+		m_lastStats = stats;
+	}
+
+	// both managers keep the system numbers, content is available and total bytes
+	uint64_t memInfo[2] = { stats.systemAvailableBytes, stats.systemTotalBytes };
+
+	Message* uiMessage = new Message();
+	uiMessage->type = MSG_TYPE_CPU_MEMORY_INFO;
+	uiMessage->SetData(memInfo, sizeof(memInfo));
+	UIManager::Get().ReceiveMessage(uiMessage);
+
+	Message* meshMessage = new Message();
+	meshMessage->type = MSG_TYPE_CPU_MEMORY_INFO;
+	meshMessage->SetData(memInfo, sizeof(memInfo));
+	MeshManager::Get().ReceiveMessage(meshMessage);
+}
+
+MemoryStats MemoryTracker::GetStats()
+{
+	std::lock_guard<std::mutex> lock(m_statsMutex);
+	return m_lastStats;
+}
+
+bool MemoryTracker::DumpJSON(const char* p_filePath)
+{
+	MemoryStats stats = GetStats();
+
+	FILE* file_p = nullptr;
+	if (fopen_s(&file_p, p_filePath, "w") != 0 || file_p == nullptr)
+	{
+		return false;
+	}
+
+#if defined(_DEBUG)
+	const char* configuration = "Debug";
+#else
+	const char* configuration = "Release";
+#endif
+
+	fprintf(file_p, "{\n");
+	fprintf(file_p, "\t\"build\": { \"configuration\": \"%s\", \"date\": \"%s %s\" },\n", configuration, __DATE__, __TIME__);
+	fprintf(file_p, "\t\"sampleTimeInSeconds\": %.3f,\n", stats.sampleTimeInSeconds);
+	fprintf(file_p, "\t\"system\": { \"availableBytes\": %llu, \"totalBytes\": %llu },\n", stats.systemAvailableBytes, stats.systemTotalBytes);
+	fprintf(file_p, "\t\"process\": { \"workingSetBytes\": %llu, \"privateBytes\": %llu },\n", stats.processWorkingSetBytes, stats.processPrivateBytes);
+	fprintf(file_p, "\t\"videoMemory\": { \"usageBytes\": %llu, \"budgetBytes\": %llu },\n", stats.videoMemoryUsageBytes, stats.videoMemoryBudgetBytes);
+
+	fprintf(file_p, "\t\"cpu\": {\n");
+	for (int i = 0; i < MEMORY_TAG_COUNT; i++)
+	{
+		fprintf(file_p, "\t\t\"%s\": { \"bytes\": %llu, \"peakBytes\": %llu, \"allocations\": %llu }%s\n",
+			MEMORY_TAG_NAMES[i], stats.cpuBytes[i], stats.cpuPeakBytes[i], stats.cpuAllocations[i],
+			i + 1 < MEMORY_TAG_COUNT ? "," : "");
+	}
+	fprintf(file_p, "\t},\n");
+
+	fprintf(file_p, "\t\"gpu\": {\n");
+	for (int i = 0; i < GPU_MEMORY_COUNT; i++)
+	{
+		fprintf(file_p, "\t\t\"%s\": { \"bytes\": %llu, \"resources\": %llu, \"sharedBytes\": %llu }%s\n",
+			GPU_MEMORY_CATEGORY_NAMES[i], stats.gpuBytes[i], stats.gpuResources[i], stats.gpuSharedBytes[i],
+			i + 1 < GPU_MEMORY_COUNT ? "," : "");
+	}
+	fprintf(file_p, "\t}\n");
+	fprintf(file_p, "}\n");
+
+	bool isSuccess = ferror(file_p) == 0;
+	fclose(file_p);
+	return isSuccess;
+}
+
+const char* MemoryTracker::GetTagName(MemoryTag p_tag)
+{
+	return p_tag < MEMORY_TAG_COUNT ? MEMORY_TAG_NAMES[p_tag] : "unknown";
+}
+
+const char* MemoryTracker::GetCategoryName(GpuMemoryCategory p_category)
+{
+	return p_category < GPU_MEMORY_COUNT ? GPU_MEMORY_CATEGORY_NAMES[p_category] : "unknown";
+}
@@ -2,6 +2,8 @@
 #include <Application.h>
 #include <Helpers.h>
 #include <CommandQueue.h>
+#include <MemoryTracker.h>
+#include <Profiler.h>
 #include <regex>
 #include <openssl/sha.h>
 #include <fstream>
@@ -12,8 +14,27 @@
 #include <DirectXMath.h>
 using namespace DirectX;
 
+#include <atomic>
+#include <cmath>
 #include <sstream>
 
+// meshes are loaded on the MeshManager listener thread
+static std::atomic<uint32_t> gs_meshIdCounter = 0;
+
+Mesh::Mesh()
+	: m_meshId(++gs_meshIdCounter)
+{
+}
+
+Mesh::~Mesh()
+{
+	MemoryTracker& memoryTracker = MemoryTracker::Get();
+	memoryTracker.RemoveCpuBytes(MEMORY_TAG_MESH, m_trackedCpuBytes);
+	memoryTracker.UntrackResource(m_positionBuffer.Get());
+	memoryTracker.UntrackResource(m_attributeBuffer.Get());
+	memoryTracker.UntrackResource(m_indexBuffer.Get());
+}
+
 bool Mesh::Initialize(const wchar_t* p_objFilePath)
 {
 	// check if file exists
@@ -42,6 +63,8 @@ const std::string& Mesh::GetMeshClassName()
 
 void Mesh::LoadOBJFile(const wchar_t* p_objFilePath)
 {
+	BEAR_PROFILE_FUNCTION();
+
 	std::ifstream objFile(p_objFilePath);
 
 	if (!objFile.is_open())
@@ -272,21 +295,50 @@ void Mesh::LoadOBJFile(const wchar_t* p_objFilePath)
 
 void Mesh::LoadDataToGPU()
 {
+	// the vertices are released below, whether they came from the obj or the binary file
+	_computeLocalBounds();
+
 	// prepare upload
 	auto device = Application::Get().GetDevice();
 	auto commandQueue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COPY);
 	auto commandList = commandQueue->GetCommandList();
 
+	// a reload replaces the buffers below
+	MemoryTracker& memoryTracker = MemoryTracker::Get();
+	memoryTracker.UntrackResource(m_positionBuffer.Get());
+	memoryTracker.UntrackResource(m_attributeBuffer.Get());
+	memoryTracker.UntrackResource(m_indexBuffer.Get());
+
+	// the loader and the binary file keep the vertices interleaved; the GPU gets them as two streams,
+	// so the depth prepass fetches 12 bytes per vertex instead of all of FirstPassVertexData
+	std::vector<XMFLOAT3> positions(combinedBuffer.size());
+	std::vector<FirstPassVertexAttributes> attributes(combinedBuffer.size());
+	for (size_t i = 0; i < combinedBuffer.size(); i++)
+	{
+		const FirstPassVertexData& vertex = combinedBuffer[i];
+		positions[i] = vertex.Position;
+		attributes[i] = { vertex.Normal, vertex.Tangent, vertex.TexCoord };
+	}
+
 	// Upload vertex buffer data.
-	ComPtr<ID3D12Resource> intermediateVertexBuffer;
+	ComPtr<ID3D12Resource> intermediatePositionBuffer;
 	UpdateBufferResource(commandList,
-		&m_vertexBuffer, &intermediateVertexBuffer,
-		combinedBuffer.size(), sizeof(FirstPassVertexData), combinedBuffer.data());
+		&m_positionBuffer, &intermediatePositionBuffer,
+		positions.size(), sizeof(XMFLOAT3), positions.data());
 
-	// Create the vertex buffer view.
-	m_vertexBufferView.BufferLocation = m_vertexBuffer->GetGPUVirtualAddress();
-	m_vertexBufferView.SizeInBytes = combinedBuffer.size() * sizeof(FirstPassVertexData);
-	m_vertexBufferView.StrideInBytes = sizeof(FirstPassVertexData);
+	ComPtr<ID3D12Resource> intermediateAttributeBuffer;
+	UpdateBufferResource(commandList,
+		&m_attributeBuffer, &intermediateAttributeBuffer,
+		attributes.size(), sizeof(FirstPassVertexAttributes), attributes.data());
+
+	// Create the vertex buffer views.
+	m_positionBufferView.BufferLocation = m_positionBuffer->GetGPUVirtualAddress();
+	m_positionBufferView.SizeInBytes = static_cast<UINT>(positions.size() * sizeof(XMFLOAT3));
+	m_positionBufferView.StrideInBytes = sizeof(XMFLOAT3);
+
+	m_attributeBufferView.BufferLocation = m_attributeBuffer->GetGPUVirtualAddress();
+	m_attributeBufferView.SizeInBytes = static_cast<UINT>(attributes.size() * sizeof(FirstPassVertexAttributes));
+	m_attributeBufferView.StrideInBytes = sizeof(FirstPassVertexAttributes);
 
 	// Upload index buffer data.
 	ComPtr<ID3D12Resource> intermediateIndexBuffer;
@@ -307,10 +359,105 @@ void Mesh::LoadDataToGPU()
 	// record number of triangles before release
 	m_triangleCount = static_cast<UINT>(m_triangles.size());
 
+	m_pickTriangles.resize(m_triangles.size());
+	for (size_t i = 0; i < m_triangles.size(); i++)
+	{
+		m_pickTriangles[i] = positions[m_triangles[i]];
+	}
+
 	// release on CPU memory
 	m_triangles.clear();
 	combinedBuffer.clear();
 	//stbi_image_free(data);
+
+	memoryTracker.TrackResource(GPU_MEMORY_MESH, m_positionBuffer.Get());
+	memoryTracker.TrackResource(GPU_MEMORY_MESH, m_attributeBuffer.Get());
+	memoryTracker.TrackResource(GPU_MEMORY_MESH, m_indexBuffer.Get());
+	_updateTrackedMemory();
+}
+
+void Mesh::_computeLocalBounds()
+{
+	if (combinedBuffer.empty())
+	{
+		m_localBounds = BoundingAabb();
+		return;
+	}
+
+	XMVECTOR minimum = XMLoadFloat3(&combinedBuffer[0].Position);
+	XMVECTOR maximum = minimum;
+	for (const FirstPassVertexData& vertex : combinedBuffer)
+	{
+		XMVECTOR position = XMLoadFloat3(&vertex.Position);
+		minimum = XMVectorMin(minimum, position);
+		maximum = XMVectorMax(maximum, position);
+	}
+
+	XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(m_localBounds.center), (minimum + maximum) * 0.5f);
+	XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(m_localBounds.extents), (maximum - minimum) * 0.5f);
+}
+
+bool Mesh::IntersectRay(const XMVECTOR& p_origin, const XMVECTOR& p_direction, float p_maxT, float& out_t) const
+{
+	// Moller-Trumbore, both faces
+	bool isHit = false;
+	float nearestT = p_maxT;
+	for (size_t i = 0; i + 2 < m_pickTriangles.size(); i += 3)
+	{
+		XMVECTOR corner0 = XMLoadFloat3(&m_pickTriangles[i]);
+		XMVECTOR edge1 = XMLoadFloat3(&m_pickTriangles[i + 1]) - corner0;
+		XMVECTOR edge2 = XMLoadFloat3(&m_pickTriangles[i + 2]) - corner0;
+
+		XMVECTOR p = XMVector3Cross(p_direction, edge2);
+		float determinant = XMVectorGetX(XMVector3Dot(edge1, p));
+		if (std::fabs(determinant) < 1e-12f)
+		{
+			// parallel to the triangle
+			continue;
+		}
+
+		float inverseDeterminant = 1.0f / determinant;
+		XMVECTOR s = p_origin - corner0;
+		float u = XMVectorGetX(XMVector3Dot(s, p)) * inverseDeterminant;
+		if (u < 0.0f || u > 1.0f)
+		{
+			continue;
+		}
+
+		XMVECTOR q = XMVector3Cross(s, edge1);
+		float v = XMVectorGetX(XMVector3Dot(p_direction, q)) * inverseDeterminant;
+		if (v < 0.0f || u + v > 1.0f)
+		{
+			continue;
+		}
+
+		float t = XMVectorGetX(XMVector3Dot(edge2, q)) * inverseDeterminant;
+		if (t >= 0.0f && t < nearestT)
+		{
+			nearestT = t;
+			isHit = true;
+		}
+	}
+
+	out_t = nearestT;
+	return isHit;
+}
+
+void Mesh::_updateTrackedMemory()
+{
+	size_t cpuBytes = m_vertices.capacity() * sizeof(float) +
+		m_normals.capacity() * sizeof(float) +
+		m_texcoords.capacity() * sizeof(float) +
+		m_triangles.capacity() * sizeof(uint32_t) +
+		m_triangleNormalIndex.capacity() * sizeof(uint32_t) +
+		m_triangleTexcoordIndex.capacity() * sizeof(uint32_t) +
+		combinedBuffer.capacity() * sizeof(FirstPassVertexData) +
+		m_pickTriangles.capacity() * sizeof(XMFLOAT3);
+
+	MemoryTracker& memoryTracker = MemoryTracker::Get();
+	memoryTracker.RemoveCpuBytes(MEMORY_TAG_MESH, m_trackedCpuBytes);
+	memoryTracker.AddCpuBytes(MEMORY_TAG_MESH, cpuBytes);
+	m_trackedCpuBytes = cpuBytes;
 }
 
 void Mesh::UpdateBufferResource(
@@ -422,10 +569,11 @@ void Mesh::WriteToBinaryFile(const wchar_t* p_binFilePath, char* p_hashTowrite)
 	binFile.close();
 }
 
-void Mesh::RenderInstance(ComPtr<ID3D12GraphicsCommandList2> p_commandList)
+void Mesh::FillDrawItem(DrawItem& out_item) const
 {
-	p_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	p_commandList->IASetVertexBuffers(0, 1, &m_vertexBufferView);
-	p_commandList->IASetIndexBuffer(&m_indexBufferView);
-	p_commandList->DrawIndexedInstanced(m_triangleCount, 1, 0, 0, 0);
+	out_item.positionBufferView = m_positionBufferView;
+	out_item.attributeBufferView = m_attributeBufferView;
+	out_item.indexBufferView = m_indexBufferView;
+	out_item.indexCount = m_triangleCount;
+	out_item.meshId = m_meshId;
 }
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include <UIManager.h>
 #include <Application.h>
 #include <CommandQueue.h>
+#include <Profiler.h>
+#include <SessionRecorder.h>
 
 #include <Jolt/Jolt.h>
 #include <Jolt/Physics/Body/BodyID.h>
@@ -95,6 +97,8 @@ void MeshManager::ClearMeshes()
 
 void MeshManager::Listen()
 {
+	BEAR_PROFILE_THREAD("Mesh listener");
+
 	while (true)
 	{
 		Message msg;
@@ -110,6 +114,8 @@ void MeshManager::Listen()
 
 void MeshManager::_processMessage(Message& msg)
 {
+	BEAR_PROFILE_FUNCTION();
+
 	// message data is mesh name in char*
 	size_t dataSize = msg.GetSize();
 	Application& app = Application::Get();
@@ -282,14 +288,14 @@ void MeshManager::_processMessage(Message& msg)
 	}
 	case MSG_TYPE_MODIFY_LIGHT:
 	{
-		// data is LightData struct
-		if (dataSize != sizeof(LightConstants))
+		// data is LightConstants followed by the lights, see LightManager::SerializeLights
+		LightSet lights;
+		if (!LightManager::DeserializeLights((const unsigned char*)msg.GetData(), dataSize, lights))
 		{
 			// invalid data size
 			break;
 		}
-		LightConstants* lightData = (LightConstants*)(msg.GetData());
-		m_lightManager_p->CopyData(lightData);
+		m_lightManager_p->CopyData(lights);
 		break;
 	}
 	default:
@@ -302,6 +308,14 @@ void MeshManager::_processMessage(Message& msg)
 // Receive message from other systems
 void MeshManager::ReceiveMessage(Message* msg)
 {
+	if (!SessionRecorder::Get().OnMessage(SESSION_QUEUE_MESH, *msg))
+	{
+		// a replay feeds this one from the log
+		msg->Release();
+		delete msg;
+		return;
+	}
+
 	m_messageQueue.PushMessage(msg);
 }
 
@@ -0,0 +1,566 @@
+#include "NullCommandRecorder.h"
+
+const char* GetNullCommandName(NullCommand p_command)
+{
+	switch (p_command)
+	{
+	case NULL_COMMAND_PIPELINE_STATE:
+		return "SetPipelineState";
+	case NULL_COMMAND_ROOT_SIGNATURE:
+		return "SetGraphicsRootSignature";
+	case NULL_COMMAND_DESCRIPTOR_HEAPS:
+		return "SetDescriptorHeaps";
+	case NULL_COMMAND_ROOT_DESCRIPTOR_TABLE:
+		return "SetGraphicsRootDescriptorTable";
+	case NULL_COMMAND_ROOT_CONSTANTS:
+		return "SetGraphicsRoot32BitConstants";
+	case NULL_COMMAND_ROOT_CBV:
+		return "SetGraphicsRootConstantBufferView";
+	case NULL_COMMAND_ROOT_SRV:
+		return "SetGraphicsRootShaderResourceView";
+	case NULL_COMMAND_COMPUTE_ROOT_SIGNATURE:
+		return "SetComputeRootSignature";
+	case NULL_COMMAND_COMPUTE_ROOT_DESCRIPTOR_TABLE:
+		return "SetComputeRootDescriptorTable";
+	case NULL_COMMAND_COMPUTE_ROOT_CONSTANTS:
+		return "SetComputeRoot32BitConstants";
+	case NULL_COMMAND_COMPUTE_ROOT_CBV:
+		return "SetComputeRootConstantBufferView";
+	case NULL_COMMAND_COMPUTE_ROOT_SRV:
+		return "SetComputeRootShaderResourceView";
+	case NULL_COMMAND_PRIMITIVE_TOPOLOGY:
+		return "IASetPrimitiveTopology";
+	case NULL_COMMAND_VERTEX_BUFFERS:
+		return "IASetVertexBuffers";
+	case NULL_COMMAND_INDEX_BUFFER:
+		return "IASetIndexBuffer";
+	case NULL_COMMAND_VIEWPORTS:
+		return "RSSetViewports";
+	case NULL_COMMAND_SCISSOR_RECTS:
+		return "RSSetScissorRects";
+	case NULL_COMMAND_RENDER_TARGETS:
+		return "OMSetRenderTargets";
+	case NULL_COMMAND_CLEAR_RENDER_TARGET:
+		return "ClearRenderTargetView";
+	case NULL_COMMAND_CLEAR_DEPTH_STENCIL:
+		return "ClearDepthStencilView";
+	case NULL_COMMAND_RESOURCE_BARRIER:
+		return "ResourceBarrier";
+	case NULL_COMMAND_COPY_RESOURCE:
+		return "CopyResource";
+	case NULL_COMMAND_DRAW:
+		return "DrawInstanced";
+	case NULL_COMMAND_DRAW_INDEXED:
+		return "DrawIndexedInstanced";
+	case NULL_COMMAND_DISPATCH:
+		return "Dispatch";
+	case NULL_COMMAND_EXECUTE_BUNDLE:
+		return "ExecuteBundle";
+	default:
+		return "Unknown";
+	}
+}
+
+NullCommandRecorder::NullCommandRecorder(D3D12_COMMAND_LIST_TYPE p_type, ID3D12PipelineState* p_initialState_p)
+	: m_type(p_type)
+	, m_pipelineState_p(p_initialState_p)
+{
+}
+
+void NullCommandRecorder::SetPipelineState(ID3D12PipelineState* p_pipelineState_p)
+{
+	m_stats.commands[NULL_COMMAND_PIPELINE_STATE]++;
+	if (p_pipelineState_p == nullptr)
+	{
+		_fail(NULL_COMMAND_PIPELINE_STATE, "null pipeline state");
+	}
+	m_pipelineState_p = p_pipelineState_p;
+}
+
+void NullCommandRecorder::SetGraphicsRootSignature(ID3D12RootSignature* p_rootSignature_p)
+{
+	m_stats.commands[NULL_COMMAND_ROOT_SIGNATURE]++;
+	_failOnComputeList(NULL_COMMAND_ROOT_SIGNATURE);
+	if (p_rootSignature_p == nullptr)
+	{
+		_fail(NULL_COMMAND_ROOT_SIGNATURE, "null root signature");
+	}
+	m_rootSignature_p = p_rootSignature_p;
+}
+
+void NullCommandRecorder::SetDescriptorHeaps(UINT p_heapCount, ID3D12DescriptorHeap* const* p_heaps_p)
+{
+	m_stats.commands[NULL_COMMAND_DESCRIPTOR_HEAPS]++;
+	if (p_heapCount == 0 || p_heaps_p == nullptr)
+	{
+		_fail(NULL_COMMAND_DESCRIPTOR_HEAPS, "no heaps");
+		return;
+	}
+
+	// at most one CBV/SRV/UAV and one sampler heap
+	if (p_heapCount > 2)
+	{
+		_fail(NULL_COMMAND_DESCRIPTOR_HEAPS, "more than two heaps");
+	}
+
+	m_hasDescriptorHeap = true;
+	for (UINT i = 0; i < p_heapCount; i++)
+	{
+		if (p_heaps_p[i] == nullptr)
+		{
+			_fail(NULL_COMMAND_DESCRIPTOR_HEAPS, "null heap");
+			m_hasDescriptorHeap = false;
+		}
+	}
+}
+
+void NullCommandRecorder::SetGraphicsRootDescriptorTable(UINT p_rootParameter, D3D12_GPU_DESCRIPTOR_HANDLE p_baseDescriptor)
+{
+	m_stats.commands[NULL_COMMAND_ROOT_DESCRIPTOR_TABLE]++;
+	_validateRootArgument(NULL_COMMAND_ROOT_DESCRIPTOR_TABLE, p_rootParameter, m_rootSignature_p);
+
+	if (p_baseDescriptor.ptr == 0)
+	{
+		_fail(NULL_COMMAND_ROOT_DESCRIPTOR_TABLE, "null descriptor handle");
+	}
+	if (!m_hasDescriptorHeap)
+	{
+		_fail(NULL_COMMAND_ROOT_DESCRIPTOR_TABLE, "no descriptor heap set");
+	}
+}
+
+void NullCommandRecorder::SetGraphicsRoot32BitConstants(UINT p_rootParameter, UINT p_valueCount, const void* p_data_p, UINT p_destOffset)
+{
+	m_stats.commands[NULL_COMMAND_ROOT_CONSTANTS]++;
+	m_stats.rootConstantValues += p_valueCount;
+	_validateRootArgument(NULL_COMMAND_ROOT_CONSTANTS, p_rootParameter, m_rootSignature_p);
+
+	if (p_data_p == nullptr)
+	{
+		_fail(NULL_COMMAND_ROOT_CONSTANTS, "null data");
+	}
+	if (p_valueCount == 0 || p_destOffset + p_valueCount > MaxRootValues)
+	{
+		_fail(NULL_COMMAND_ROOT_CONSTANTS, "constants outside the root signature limit");
+	}
+}
+
+void NullCommandRecorder::SetGraphicsRootConstantBufferView(UINT p_rootParameter, D3D12_GPU_VIRTUAL_ADDRESS p_bufferLocation)
+{
+	m_stats.commands[NULL_COMMAND_ROOT_CBV]++;
+	_validateRootArgument(NULL_COMMAND_ROOT_CBV, p_rootParameter, m_rootSignature_p);
+
+	if (p_bufferLocation == 0)
+	{
+		_fail(NULL_COMMAND_ROOT_CBV, "null buffer location");
+	}
+}
+
+void NullCommandRecorder::SetGraphicsRootShaderResourceView(UINT p_rootParameter, D3D12_GPU_VIRTUAL_ADDRESS p_bufferLocation)
+{
+	m_stats.commands[NULL_COMMAND_ROOT_SRV]++;
+	_validateRootArgument(NULL_COMMAND_ROOT_SRV, p_rootParameter, m_rootSignature_p);
+
+	if (p_bufferLocation == 0)
+	{
+		_fail(NULL_COMMAND_ROOT_SRV, "null buffer location");
+	}
+	else if (p_bufferLocation % 4 != 0)
+	{
+		_fail(NULL_COMMAND_ROOT_SRV, "buffer location not 4-byte aligned");
+	}
+}
+
+void NullCommandRecorder::SetComputeRootSignature(ID3D12RootSignature* p_rootSignature_p)
+{
+	m_stats.commands[NULL_COMMAND_COMPUTE_ROOT_SIGNATURE]++;
+	if (p_rootSignature_p == nullptr)
+	{
+		_fail(NULL_COMMAND_COMPUTE_ROOT_SIGNATURE, "null root signature");
+	}
+	m_computeRootSignature_p = p_rootSignature_p;
+}
+
+void NullCommandRecorder::SetComputeRootDescriptorTable(UINT p_rootParameter, D3D12_GPU_DESCRIPTOR_HANDLE p_baseDescriptor)
+{
+	m_stats.commands[NULL_COMMAND_COMPUTE_ROOT_DESCRIPTOR_TABLE]++;
+	_validateRootArgument(NULL_COMMAND_COMPUTE_ROOT_DESCRIPTOR_TABLE, p_rootParameter, m_computeRootSignature_p);
+
+	if (p_baseDescriptor.ptr == 0)
+	{
+		_fail(NULL_COMMAND_COMPUTE_ROOT_DESCRIPTOR_TABLE, "null descriptor handle");
+	}
+	if (!m_hasDescriptorHeap)
+	{
+		_fail(NULL_COMMAND_COMPUTE_ROOT_DESCRIPTOR_TABLE, "no descriptor heap set");
+	}
+}
+
+void NullCommandRecorder::SetComputeRoot32BitConstants(UINT p_rootParameter, UINT p_valueCount, const void* p_data_p, UINT p_destOffset)
+{
+	m_stats.commands[NULL_COMMAND_COMPUTE_ROOT_CONSTANTS]++;
+	m_stats.rootConstantValues += p_valueCount;
+	_validateRootArgument(NULL_COMMAND_COMPUTE_ROOT_CONSTANTS, p_rootParameter, m_computeRootSignature_p);
+
+	if (p_data_p == nullptr)
+	{
+		_fail(NULL_COMMAND_COMPUTE_ROOT_CONSTANTS, "null data");
+	}
+	if (p_valueCount == 0 || p_destOffset + p_valueCount > MaxRootValues)
+	{
+		_fail(NULL_COMMAND_COMPUTE_ROOT_CONSTANTS, "constants outside the root signature limit");
+	}
+}
+
+void NullCommandRecorder::SetComputeRootConstantBufferView(UINT p_rootParameter, D3D12_GPU_VIRTUAL_ADDRESS p_bufferLocation)
+{
+	m_stats.commands[NULL_COMMAND_COMPUTE_ROOT_CBV]++;
+	_validateRootArgument(NULL_COMMAND_COMPUTE_ROOT_CBV, p_rootParameter, m_computeRootSignature_p);
+
+	if (p_bufferLocation == 0)
+	{
+		_fail(NULL_COMMAND_COMPUTE_ROOT_CBV, "null buffer location");
+	}
+}
+
+void NullCommandRecorder::SetComputeRootShaderResourceView(UINT p_rootParameter, D3D12_GPU_VIRTUAL_ADDRESS p_bufferLocation)
+{
+	m_stats.commands[NULL_COMMAND_COMPUTE_ROOT_SRV]++;
+	_validateRootArgument(NULL_COMMAND_COMPUTE_ROOT_SRV, p_rootParameter, m_computeRootSignature_p);
+
+	if (p_bufferLocation == 0)
+	{
+		_fail(NULL_COMMAND_COMPUTE_ROOT_SRV, "null buffer location");
+	}
+	else if (p_bufferLocation % 4 != 0)
+	{
+		_fail(NULL_COMMAND_COMPUTE_ROOT_SRV, "buffer location not 4-byte aligned");
+	}
+}
+
+void NullCommandRecorder::IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY p_topology)
+{
+	m_stats.commands[NULL_COMMAND_PRIMITIVE_TOPOLOGY]++;
+	_failOnComputeList(NULL_COMMAND_PRIMITIVE_TOPOLOGY);
+	if (p_topology == D3D_PRIMITIVE_TOPOLOGY_UNDEFINED)
+	{
+		_fail(NULL_COMMAND_PRIMITIVE_TOPOLOGY, "undefined topology");
+	}
+	m_topology = p_topology;
+}
+
+void NullCommandRecorder::IASetVertexBuffers(UINT p_startSlot, UINT p_viewCount, const D3D12_VERTEX_BUFFER_VIEW* p_views_p)
+{
+	m_stats.commands[NULL_COMMAND_VERTEX_BUFFERS]++;
+	_failOnComputeList(NULL_COMMAND_VERTEX_BUFFERS);
+	if (p_startSlot + p_viewCount > D3D12_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT)
+	{
+		_fail(NULL_COMMAND_VERTEX_BUFFERS, "slot out of range");
+	}
+	if (p_views_p == nullptr)
+	{
+		return; // unbinds
+	}
+
+	for (UINT i = 0; i < p_viewCount; i++)
+	{
+		if (p_views_p[i].BufferLocation == 0 || p_views_p[i].StrideInBytes == 0)
+		{
+			_fail(NULL_COMMAND_VERTEX_BUFFERS, "empty view");
+		}
+	}
+}
+
+void NullCommandRecorder::IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* p_view_p)
+{
+	m_stats.commands[NULL_COMMAND_INDEX_BUFFER]++;
+	_failOnComputeList(NULL_COMMAND_INDEX_BUFFER);
+	m_hasIndexBuffer = false;
+	if (p_view_p == nullptr)
+	{
+		return; // unbinds
+	}
+
+	if (p_view_p->Format != DXGI_FORMAT_R16_UINT && p_view_p->Format != DXGI_FORMAT_R32_UINT)
+	{
+		_fail(NULL_COMMAND_INDEX_BUFFER, "format is not R16_UINT or R32_UINT");
+		return;
+	}
+	if (p_view_p->BufferLocation == 0)
+	{
+		_fail(NULL_COMMAND_INDEX_BUFFER, "null buffer location");
+		return;
+	}
+
+	m_indexBufferView = *p_view_p;
+	m_hasIndexBuffer = true;
+}
+
+void NullCommandRecorder::RSSetViewports(UINT p_viewportCount, const D3D12_VIEWPORT* p_viewports_p)
+{
+	m_stats.commands[NULL_COMMAND_VIEWPORTS]++;
+	_failOnComputeList(NULL_COMMAND_VIEWPORTS);
+	_failInBundle(NULL_COMMAND_VIEWPORTS);
+	if (p_viewports_p == nullptr || p_viewportCount > D3D12_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE)
+	{
+		_fail(NULL_COMMAND_VIEWPORTS, "invalid viewport count");
+		return;
+	}
+	m_viewportCount = p_viewportCount;
+}
+
+void NullCommandRecorder::RSSetScissorRects(UINT p_rectCount, const D3D12_RECT* p_rects_p)
+{
+	m_stats.commands[NULL_COMMAND_SCISSOR_RECTS]++;
+	_failOnComputeList(NULL_COMMAND_SCISSOR_RECTS);
+	_failInBundle(NULL_COMMAND_SCISSOR_RECTS);
+	if (p_rects_p == nullptr || p_rectCount > D3D12_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE)
+	{
+		_fail(NULL_COMMAND_SCISSOR_RECTS, "invalid rect count");
+		return;
+	}
+	m_scissorRectCount = p_rectCount;
+}
+
+void NullCommandRecorder::OMSetRenderTargets(UINT p_renderTargetCount, const D3D12_CPU_DESCRIPTOR_HANDLE* p_renderTargets_p,
+	BOOL, const D3D12_CPU_DESCRIPTOR_HANDLE* p_depthStencil_p)
+{
+	m_stats.commands[NULL_COMMAND_RENDER_TARGETS]++;
+	_failOnComputeList(NULL_COMMAND_RENDER_TARGETS);
+	_failInBundle(NULL_COMMAND_RENDER_TARGETS);
+	if (p_renderTargetCount > D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT)
+	{
+		_fail(NULL_COMMAND_RENDER_TARGETS, "too many render targets");
+	}
+	if (p_renderTargetCount > 0 && (p_renderTargets_p == nullptr || p_renderTargets_p[0].ptr == 0))
+	{
+		_fail(NULL_COMMAND_RENDER_TARGETS, "null render target handle");
+	}
+	if (p_depthStencil_p != nullptr && p_depthStencil_p->ptr == 0)
+	{
+		_fail(NULL_COMMAND_RENDER_TARGETS, "null depth-stencil handle");
+	}
+
+	m_hasRenderTarget = p_renderTargetCount > 0 || p_depthStencil_p != nullptr;
+}
+
+void NullCommandRecorder::ClearRenderTargetView(D3D12_CPU_DESCRIPTOR_HANDLE p_renderTarget, const FLOAT p_color[4])
+{
+	m_stats.commands[NULL_COMMAND_CLEAR_RENDER_TARGET]++;
+	_failOnComputeList(NULL_COMMAND_CLEAR_RENDER_TARGET);
+	_failInBundle(NULL_COMMAND_CLEAR_RENDER_TARGET);
+	if (p_renderTarget.ptr == 0 || p_color == nullptr)
+	{
+		_fail(NULL_COMMAND_CLEAR_RENDER_TARGET, "null handle or colour");
+	}
+}
+
+void NullCommandRecorder::ClearDepthStencilView(D3D12_CPU_DESCRIPTOR_HANDLE p_depthStencil, FLOAT p_depth)
+{
+	m_stats.commands[NULL_COMMAND_CLEAR_DEPTH_STENCIL]++;
+	_failOnComputeList(NULL_COMMAND_CLEAR_DEPTH_STENCIL);
+	_failInBundle(NULL_COMMAND_CLEAR_DEPTH_STENCIL);
+	if (p_depthStencil.ptr == 0)
+	{
+		_fail(NULL_COMMAND_CLEAR_DEPTH_STENCIL, "null handle");
+	}
+	if (p_depth < 0.0f || p_depth > 1.0f)
+	{
+		_fail(NULL_COMMAND_CLEAR_DEPTH_STENCIL, "depth outside [0, 1]");
+	}
+}
+
+void NullCommandRecorder::ResourceBarrier(UINT p_barrierCount, const D3D12_RESOURCE_BARRIER* p_barriers_p)
+{
+	m_stats.commands[NULL_COMMAND_RESOURCE_BARRIER]++;
+	_failInBundle(NULL_COMMAND_RESOURCE_BARRIER);
+	if (p_barrierCount == 0 || p_barriers_p == nullptr)
+	{
+		_fail(NULL_COMMAND_RESOURCE_BARRIER, "no barriers");
+		return;
+	}
+
+	for (UINT i = 0; i < p_barrierCount; i++)
+	{
+		const D3D12_RESOURCE_BARRIER& barrier = p_barriers_p[i];
+		if (barrier.Type != D3D12_RESOURCE_BARRIER_TYPE_TRANSITION)
+		{
+			continue;
+		}
+
+		if (barrier.Transition.pResource == nullptr)
+		{
+			_fail(NULL_COMMAND_RESOURCE_BARRIER, "transition of a null resource");
+		}
+		else if (barrier.Transition.StateBefore == barrier.Transition.StateAfter)
+		{
+			_fail(NULL_COMMAND_RESOURCE_BARRIER, "transition to the same state");
+		}
+	}
+}
+
+void NullCommandRecorder::CopyResource(ID3D12Resource* p_destination_p, ID3D12Resource* p_source_p)
+{
+	m_stats.commands[NULL_COMMAND_COPY_RESOURCE]++;
+	_failInBundle(NULL_COMMAND_COPY_RESOURCE);
+	if (p_destination_p == nullptr || p_source_p == nullptr)
+	{
+		_fail(NULL_COMMAND_COPY_RESOURCE, "null resource");
+	}
+	else if (p_destination_p == p_source_p)
+	{
+		_fail(NULL_COMMAND_COPY_RESOURCE, "copy onto itself");
+	}
+}
+
+void NullCommandRecorder::DrawInstanced(UINT p_vertexCountPerInstance, UINT p_instanceCount, UINT, UINT)
+{
+	m_stats.commands[NULL_COMMAND_DRAW]++;
+	m_stats.instances += p_instanceCount;
+	m_stats.vertices += static_cast<uint64_t>(p_vertexCountPerInstance) * p_instanceCount;
+	_validateDraw(NULL_COMMAND_DRAW, p_instanceCount);
+}
+
+void NullCommandRecorder::DrawIndexedInstanced(UINT p_indexCountPerInstance, UINT p_instanceCount, UINT p_startIndex,
+	INT, UINT)
+{
+	m_stats.commands[NULL_COMMAND_DRAW_INDEXED]++;
+	m_stats.instances += p_instanceCount;
+	m_stats.vertices += static_cast<uint64_t>(p_indexCountPerInstance) * p_instanceCount;
+	_validateDraw(NULL_COMMAND_DRAW_INDEXED, p_instanceCount);
+
+	if (!m_hasIndexBuffer)
+	{
+		_fail(NULL_COMMAND_DRAW_INDEXED, "no index buffer bound");
+		return;
+	}
+
+	const uint64_t indexSize = m_indexBufferView.Format == DXGI_FORMAT_R16_UINT ? 2 : 4;
+	if (static_cast<uint64_t>(p_startIndex) + p_indexCountPerInstance > m_indexBufferView.SizeInBytes / indexSize)
+	{
+		_fail(NULL_COMMAND_DRAW_INDEXED, "indices past the end of the index buffer");
+	}
+}
+
+void NullCommandRecorder::Dispatch(UINT p_groupCountX, UINT p_groupCountY, UINT p_groupCountZ)
+{
+	m_stats.commands[NULL_COMMAND_DISPATCH]++;
+	m_stats.threadGroups += static_cast<uint64_t>(p_groupCountX) * p_groupCountY * p_groupCountZ;
+
+	if (m_pipelineState_p == nullptr)
+	{
+		_fail(NULL_COMMAND_DISPATCH, "no pipeline state set");
+	}
+	if (m_computeRootSignature_p == nullptr)
+	{
+		_fail(NULL_COMMAND_DISPATCH, "no compute root signature set");
+	}
+	if (p_groupCountX == 0 || p_groupCountY == 0 || p_groupCountZ == 0)
+	{
+		_fail(NULL_COMMAND_DISPATCH, "zero thread groups");
+	}
+
+	const UINT maxGroups = D3D12_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION;
+	if (p_groupCountX > maxGroups || p_groupCountY > maxGroups || p_groupCountZ > maxGroups)
+	{
+		_fail(NULL_COMMAND_DISPATCH, "too many thread groups");
+	}
+}
+
+void NullCommandRecorder::ExecuteBundle(ID3D12GraphicsCommandList* p_bundle_p)
+{
+	m_stats.commands[NULL_COMMAND_EXECUTE_BUNDLE]++;
+	if (m_type != D3D12_COMMAND_LIST_TYPE_DIRECT)
+	{
+		_fail(NULL_COMMAND_EXECUTE_BUNDLE, "only direct lists execute bundles");
+	}
+	if (p_bundle_p == nullptr)
+	{
+		_fail(NULL_COMMAND_EXECUTE_BUNDLE, "null bundle");
+	}
+}
+
+void NullCommandRecorder::Reset(ID3D12PipelineState* p_initialState_p)
+{
+	m_pipelineState_p = p_initialState_p;
+	m_rootSignature_p = nullptr;
+	m_computeRootSignature_p = nullptr;
+	m_hasDescriptorHeap = false;
+	m_topology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+	m_hasIndexBuffer = false;
+	m_indexBufferView = {};
+	m_viewportCount = 0;
+	m_scissorRectCount = 0;
+	m_hasRenderTarget = false;
+}
+
+void NullCommandRecorder::_fail(NullCommand p_command, const char* p_reason)
+{
+	m_stats.invalidCommands++;
+	if (m_errors.size() < MaxKeptErrors)
+	{
+		m_errors.push_back(std::string(GetNullCommandName(p_command)) + ": " + p_reason);
+	}
+}
+
+void NullCommandRecorder::_failInBundle(NullCommand p_command)
+{
+	if (_isBundle())
+	{
+		_fail(p_command, "not allowed in a bundle");
+	}
+}
+
+void NullCommandRecorder::_failOnComputeList(NullCommand p_command)
+{
+	if (m_type == D3D12_COMMAND_LIST_TYPE_COMPUTE)
+	{
+		_fail(p_command, "not allowed on a compute list");
+	}
+}
+
+void NullCommandRecorder::_validateRootArgument(NullCommand p_command, UINT p_rootParameter, const ID3D12RootSignature* p_rootSignature_p)
+{
+	if (p_rootSignature_p == nullptr)
+	{
+		_fail(p_command, "no root signature set");
+	}
+	if (p_rootParameter >= MaxRootValues)
+	{
+		_fail(p_command, "root parameter out of range");
+	}
+}
+
+void NullCommandRecorder::_validateDraw(NullCommand p_command, UINT p_instanceCount)
+{
+	_failOnComputeList(p_command);
+	if (m_pipelineState_p == nullptr)
+	{
+		_fail(p_command, "no pipeline state set");
+	}
+	if (m_rootSignature_p == nullptr)
+	{
+		_fail(p_command, "no root signature set");
+	}
+	if (m_topology == D3D_PRIMITIVE_TOPOLOGY_UNDEFINED)
+	{
+		_fail(p_command, "no primitive topology set");
+	}
+	if (p_instanceCount == 0)
+	{
+		_fail(p_command, "zero instances");
+	}
+
+	// a bundle draws into whatever the executing list has bound
+	if (!_isBundle())
+	{
+		if (!m_hasRenderTarget)
+		{
+			_fail(p_command, "no render target bound");
+		}
+		if (m_viewportCount == 0 || m_scissorRectCount == 0)
+		{
+			_fail(p_command, "no viewport or scissor rect set");
+		}
+	}
+}
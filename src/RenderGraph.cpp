@@ -0,0 +1,481 @@
+#include <RenderGraph.h>
+
+#include <algorithm>
+
+static const uint64_t NotPlaced = UINT64_MAX;
+
+static bool _isWriteState(uint32_t p_state)
+{
+	return (p_state & RENDER_GRAPH_WRITE_STATES) != 0;
+}
+
+void RenderGraph::Reset()
+{
+	m_resources.clear();
+	m_passes.clear();
+	m_accesses.clear();
+	m_passAccessStart.clear();
+	for (std::vector<RenderGraphBarrier>& batch : m_batches)
+	{
+		batch.clear();
+	}
+	m_barriers.clear();
+	m_firstFinalBarrier = 0;
+	m_stats = RenderGraphStats();
+}
+
+uint32_t RenderGraph::ImportResource(const char* p_name, uint32_t p_initialState, uint32_t p_finalState, bool p_isOutput)
+{
+	Resource resource = {};
+	resource.name = p_name;
+	resource.isTransient = false;
+	resource.isOutput = p_isOutput;
+	resource.initialState = p_initialState;
+	resource.finalState = p_finalState;
+	resource.heapOffset = NotPlaced;
+	m_resources.push_back(resource);
+	return static_cast<uint32_t>(m_resources.size() - 1);
+}
+
+uint32_t RenderGraph::CreateTransient(const char* p_name, uint64_t p_sizeInBytes, uint64_t p_alignment)
+{
+	Resource resource = {};
+	resource.name = p_name;
+	resource.isTransient = true;
+	resource.isOutput = false;
+	resource.sizeInBytes = p_sizeInBytes;
+	resource.alignment = std::max<uint64_t>(p_alignment, 1);
+	resource.heapOffset = NotPlaced;
+	m_resources.push_back(resource);
+	return static_cast<uint32_t>(m_resources.size() - 1);
+}
+
+uint32_t RenderGraph::AddPass(const char* p_name, uint32_t p_flags)
+{
+	Pass pass = {};
+	pass.name = p_name;
+	pass.flags = p_flags;
+	m_passes.push_back(pass);
+	return static_cast<uint32_t>(m_passes.size() - 1);
+}
+
+void RenderGraph::Read(uint32_t p_pass, uint32_t p_resource, uint32_t p_state)
+{
+	m_accesses.push_back({ p_pass, p_resource, p_state, false });
+}
+
+void RenderGraph::Write(uint32_t p_pass, uint32_t p_resource, uint32_t p_state)
+{
+	m_accesses.push_back({ p_pass, p_resource, p_state, true });
+}
+
+bool RenderGraph::Compile()
+{
+	m_stats = RenderGraphStats();
+	m_stats.passes = static_cast<unsigned int>(m_passes.size());
+
+	if (!_mergeAccesses())
+	{
+		return false;
+	}
+
+	_cullPasses();
+
+	if (!_findLifetimes())
+	{
+		return false;
+	}
+
+	_placeTransients();
+	_buildBarriers();
+	return true;
+}
+
+const RenderGraphBarrier* RenderGraph::GetBarriersBefore(uint32_t p_pass, size_t& out_count) const
+{
+	const Pass& pass = m_passes[p_pass];
+	out_count = pass.barrierCount;
+	return pass.barrierCount > 0 ? &m_barriers[pass.firstBarrier] : nullptr;
+}
+
+const RenderGraphBarrier* RenderGraph::GetFinalBarriers(size_t& out_count) const
+{
+	out_count = m_barriers.size() - m_firstFinalBarrier;
+	return out_count > 0 ? &m_barriers[m_firstFinalBarrier] : nullptr;
+}
+
+bool RenderGraph::_mergeAccesses()
+{
+	std::stable_sort(m_accesses.begin(), m_accesses.end(), [](const Access& p_a, const Access& p_b)
+		{
+			return p_a.pass != p_b.pass ? p_a.pass < p_b.pass : p_a.resource < p_b.resource;
+		});
+
+	// a pass may read a resource in several states at once, but a write excludes anything else
+	size_t mergedCount = 0;
+	for (size_t i = 0; i < m_accesses.size(); i++)
+	{
+		const Access& access = m_accesses[i];
+		if (access.pass >= m_passes.size() || access.resource >= m_resources.size() || access.state == RENDER_GRAPH_STATE_COMMON)
+		{
+			return false;
+		}
+		if (access.isWrite != _isWriteState(access.state) || (access.isWrite && (access.state & ~RENDER_GRAPH_WRITE_STATES) != 0))
+		{
+			return false;
+		}
+
+		if (mergedCount > 0 && m_accesses[mergedCount - 1].pass == access.pass && m_accesses[mergedCount - 1].resource == access.resource)
+		{
+			Access& merged = m_accesses[mergedCount - 1];
+			if ((merged.isWrite || access.isWrite) && merged.state != access.state)
+			{
+				return false;
+			}
+			merged.state |= access.state;
+			continue;
+		}
+
+		m_accesses[mergedCount++] = access;
+	}
+	m_accesses.resize(mergedCount);
+
+	m_passAccessStart.assign(m_passes.size() + 1, 0);
+	for (const Access& access : m_accesses)
+	{
+		m_passAccessStart[access.pass + 1]++;
+	}
+	for (size_t pass = 0; pass < m_passes.size(); pass++)
+	{
+		m_passAccessStart[pass + 1] += m_passAccessStart[pass];
+	}
+	return true;
+}
+
+void RenderGraph::_cullPasses()
+{
+	m_isResourceNeeded.assign(m_resources.size(), 0);
+	for (size_t resource = 0; resource < m_resources.size(); resource++)
+	{
+		m_isResourceNeeded[resource] = m_resources[resource].isOutput ? 1 : 0;
+	}
+
+	// from the last pass back: a pass is needed if it writes something a later pass or the caller
+	// reads, and then so is everything it reads; writes are not assumed to cover the whole resource,
+	// so every earlier writer of a needed resource stays
+	for (size_t pass = m_passes.size(); pass-- > 0;)
+	{
+		bool isNeeded = (m_passes[pass].flags & RENDER_GRAPH_PASS_SIDE_EFFECTS) != 0;
+		for (uint32_t i = m_passAccessStart[pass]; i < m_passAccessStart[pass + 1] && !isNeeded; i++)
+		{
+			isNeeded = m_accesses[i].isWrite && m_isResourceNeeded[m_accesses[i].resource];
+		}
+
+		m_passes[pass].isCulled = !isNeeded;
+		if (!isNeeded)
+		{
+			m_stats.culledPasses++;
+			continue;
+		}
+
+		for (uint32_t i = m_passAccessStart[pass]; i < m_passAccessStart[pass + 1]; i++)
+		{
+			m_isResourceNeeded[m_accesses[i].resource] = 1;
+		}
+	}
+}
+
+bool RenderGraph::_findLifetimes()
+{
+	for (Resource& resource : m_resources)
+	{
+		resource.firstUse = RenderGraphInvalidIndex;
+		resource.lastUse = RenderGraphInvalidIndex;
+		resource.heapOffset = NotPlaced;
+	}
+
+	for (uint32_t pass = 0; pass < m_passes.size(); pass++)
+	{
+		if (m_passes[pass].isCulled)
+		{
+			continue;
+		}
+
+		for (uint32_t i = m_passAccessStart[pass]; i < m_passAccessStart[pass + 1]; i++)
+		{
+			Resource& resource = m_resources[m_accesses[i].resource];
+			if (resource.firstUse == RenderGraphInvalidIndex)
+			{
+				// a transient resource has no content before its first write
+				if (resource.isTransient && !m_accesses[i].isWrite)
+				{
+					return false;
+				}
+
+				resource.firstUse = pass;
+				if (resource.isTransient)
+				{
+					resource.initialState = m_accesses[i].state;
+					resource.finalState = m_accesses[i].state;
+				}
+			}
+			resource.lastUse = pass;
+		}
+	}
+	return true;
+}
+
+void RenderGraph::_placeTransients()
+{
+	std::vector<uint32_t> order;
+	for (uint32_t resource = 0; resource < m_resources.size(); resource++)
+	{
+		if (m_resources[resource].isTransient && m_resources[resource].firstUse != RenderGraphInvalidIndex)
+		{
+			order.push_back(resource);
+			m_stats.transientBytes += m_resources[resource].sizeInBytes;
+		}
+	}
+	std::stable_sort(order.begin(), order.end(), [this](uint32_t p_a, uint32_t p_b)
+		{
+			return m_resources[p_a].firstUse < m_resources[p_b].firstUse;
+		});
+
+	// first fit: the lowest offset that no resource alive at the same time overlaps;
+	// candidates are the start of the heap and the ends of the live resources
+	std::vector<uint32_t> placed;
+	for (uint32_t resourceIndex : order)
+	{
+		Resource& resource = m_resources[resourceIndex];
+
+		uint64_t bestOffset = NotPlaced;
+		for (size_t candidate = 0; candidate <= placed.size(); candidate++)
+		{
+			uint64_t offset = 0;
+			if (candidate > 0)
+			{
+				const Resource& other = m_resources[placed[candidate - 1]];
+				if (other.lastUse < resource.firstUse)
+				{
+					continue;
+				}
+				offset = other.heapOffset + other.sizeInBytes;
+			}
+			offset = (offset + resource.alignment - 1) / resource.alignment * resource.alignment;
+			if (offset >= bestOffset)
+			{
+				continue;
+			}
+
+			bool isFree = true;
+			for (uint32_t otherIndex : placed)
+			{
+				const Resource& other = m_resources[otherIndex];
+				if (other.lastUse >= resource.firstUse &&
+					offset < other.heapOffset + other.sizeInBytes && other.heapOffset < offset + resource.sizeInBytes)
+				{
+					isFree = false;
+					break;
+				}
+			}
+			if (isFree)
+			{
+				bestOffset = offset;
+			}
+		}
+
+		resource.heapOffset = bestOffset;
+		placed.push_back(resourceIndex);
+		m_stats.transientHeapBytes = std::max<uint64_t>(m_stats.transientHeapBytes, bestOffset + resource.sizeInBytes);
+	}
+}
+
+void RenderGraph::_buildBarriers()
+{
+	const uint32_t passCount = static_cast<uint32_t>(m_passes.size());
+	if (m_batches.size() < passCount + 1)
+	{
+		m_batches.resize(passCount + 1);
+	}
+	for (uint32_t batch = 0; batch <= passCount; batch++)
+	{
+		m_batches[batch].clear();
+	}
+
+	std::vector<uint32_t> currentStates(m_resources.size());
+	std::vector<uint32_t> lastUses(m_resources.size(), RenderGraphInvalidIndex); // of the current state
+	for (size_t resource = 0; resource < m_resources.size(); resource++)
+	{
+		currentStates[resource] = m_resources[resource].initialState;
+	}
+
+	auto addTransition = [&](uint32_t p_resource, uint32_t p_stateAfter, uint32_t p_endBatch)
+		{
+			RenderGraphBarrier barrier;
+			barrier.type = RENDER_GRAPH_BARRIER_TRANSITION;
+			barrier.resource = p_resource;
+			barrier.stateBefore = currentStates[p_resource];
+			barrier.stateAfter = p_stateAfter;
+
+			const uint32_t beginBatch = _batchAfter(lastUses[p_resource]);
+			if (_canSplit(beginBatch, p_endBatch))
+			{
+				barrier.split = RENDER_GRAPH_SPLIT_BEGIN;
+				m_batches[beginBatch].push_back(barrier);
+				barrier.split = RENDER_GRAPH_SPLIT_END;
+				m_stats.splitBarriers++;
+			}
+			m_batches[p_endBatch].push_back(barrier);
+			m_stats.barriers++;
+
+			currentStates[p_resource] = p_stateAfter;
+		};
+
+	for (uint32_t pass = 0; pass < passCount; pass++)
+	{
+		if (m_passes[pass].isCulled)
+		{
+			continue;
+		}
+
+		for (uint32_t i = m_passAccessStart[pass]; i < m_passAccessStart[pass + 1]; i++)
+		{
+			const Access& access = m_accesses[i];
+			const Resource& resource = m_resources[access.resource];
+
+			if (resource.isTransient && resource.firstUse == pass)
+			{
+				// takes over the memory of the resources placed there before, in the state of this use
+				uint32_t resourceBefore = RenderGraphInvalidIndex;
+				unsigned int overlapCount = 0;
+				for (uint32_t other = 0; other < m_resources.size(); other++)
+				{
+					const Resource& otherResource = m_resources[other];
+					if (other != access.resource && otherResource.heapOffset != NotPlaced && otherResource.lastUse < pass &&
+						resource.heapOffset < otherResource.heapOffset + otherResource.sizeInBytes &&
+						otherResource.heapOffset < resource.heapOffset + resource.sizeInBytes)
+					{
+						resourceBefore = other;
+						overlapCount++;
+					}
+				}
+
+				if (overlapCount > 0)
+				{
+					RenderGraphBarrier barrier;
+					barrier.type = RENDER_GRAPH_BARRIER_ALIASING;
+					barrier.resource = access.resource;
+					barrier.resourceBefore = overlapCount == 1 ? resourceBefore : RenderGraphInvalidIndex;
+					m_batches[pass].push_back(barrier);
+					m_stats.barriers++;
+					m_stats.aliasingBarriers++;
+				}
+			}
+			else if (access.isWrite)
+			{
+				if (access.state != currentStates[access.resource])
+				{
+					addTransition(access.resource, access.state, pass);
+				}
+			}
+			else if (_isWriteState(currentStates[access.resource]) || (access.state & ~currentStates[access.resource]) != 0)
+			{
+				// a read goes straight to every read state up to the next write, so later readers need no barrier
+				addTransition(access.resource, _readStatesFrom(pass, access.resource), pass);
+			}
+
+			lastUses[access.resource] = pass;
+		}
+
+		// a transient goes back to the state it starts the next frame in right after its last use,
+		// before the batch in which another resource may take over its memory
+		for (uint32_t i = m_passAccessStart[pass]; i < m_passAccessStart[pass + 1]; i++)
+		{
+			const uint32_t resource = m_accesses[i].resource;
+			if (m_resources[resource].isTransient && m_resources[resource].lastUse == pass &&
+				currentStates[resource] != m_resources[resource].initialState)
+			{
+				addTransition(resource, m_resources[resource].initialState, _batchAfter(pass));
+			}
+		}
+	}
+
+	// imports go back to where the caller expects them
+	for (uint32_t resource = 0; resource < m_resources.size(); resource++)
+	{
+		if (m_resources[resource].isTransient)
+		{
+			continue;
+		}
+		if (currentStates[resource] != m_resources[resource].finalState)
+		{
+			addTransition(resource, m_resources[resource].finalState, passCount);
+		}
+	}
+
+	m_barriers.clear();
+	for (uint32_t pass = 0; pass < passCount; pass++)
+	{
+		m_passes[pass].firstBarrier = static_cast<uint32_t>(m_barriers.size());
+		m_passes[pass].barrierCount = static_cast<uint32_t>(m_batches[pass].size());
+		m_barriers.insert(m_barriers.end(), m_batches[pass].begin(), m_batches[pass].end());
+		m_stats.barrierBatches += m_batches[pass].empty() ? 0 : 1;
+	}
+	m_firstFinalBarrier = static_cast<uint32_t>(m_barriers.size());
+	m_barriers.insert(m_barriers.end(), m_batches[passCount].begin(), m_batches[passCount].end());
+	m_stats.barrierBatches += m_batches[passCount].empty() ? 0 : 1;
+}
+
+uint32_t RenderGraph::_batchAfter(uint32_t p_pass) const
+{
+	uint32_t batch = p_pass == RenderGraphInvalidIndex ? 0 : p_pass + 1;
+	while (batch < m_passes.size() && m_passes[batch].isCulled)
+	{
+		batch++;
+	}
+	return batch;
+}
+
+bool RenderGraph::_canSplit(uint32_t p_beginBatch, uint32_t p_endBatch) const
+{
+	if (p_beginBatch >= p_endBatch)
+	{
+		return false;
+	}
+
+	// both halves have to be on the same command list
+	for (uint32_t pass = p_beginBatch; pass < p_endBatch; pass++)
+	{
+		if (!m_passes[pass].isCulled && (m_passes[pass].flags & RENDER_GRAPH_PASS_OWN_COMMAND_LISTS) != 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+uint32_t RenderGraph::_readStatesFrom(uint32_t p_pass, uint32_t p_resource) const
+{
+	uint32_t states = 0;
+	for (uint32_t pass = p_pass; pass < m_passes.size(); pass++)
+	{
+		if (m_passes[pass].isCulled)
+		{
+			continue;
+		}
+
+		for (uint32_t i = m_passAccessStart[pass]; i < m_passAccessStart[pass + 1]; i++)
+		{
+			if (m_accesses[i].resource != p_resource)
+			{
+				continue;
+			}
+			if (m_accesses[i].isWrite)
+			{
+				return states;
+			}
+			states |= m_accesses[i].state;
+		}
+	}
+	return states;
+}
@@ -0,0 +1,180 @@
+#include "RenderQueue.h"
+#include "FramePacket.h"
+#include "Profiler.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+static const unsigned int RADIX_BUCKETS = 256;
+static const unsigned int KEY_BYTES = 8;
+
+uint64_t RenderQueue::MakeSortKey(Pass p_pass, uint32_t p_pipeline, uint32_t p_material, uint32_t p_mesh, float p_viewDepth)
+{
+	// the bits of a positive float sort like its value; behind the camera counts as nearest
+	uint32_t depthBits = 0;
+	if (p_viewDepth > 0.0f)
+	{
+		memcpy(&depthBits, &p_viewDepth, sizeof(depthBits));
+	}
+
+	return (static_cast<uint64_t>(p_pass & 0x3) << 62) |
+		(static_cast<uint64_t>(p_pipeline & 0x3F) << 56) |
+		(static_cast<uint64_t>(p_material & 0xFFFF) << 40) |
+		(static_cast<uint64_t>(p_mesh & 0xFFFF) << 24) |
+		static_cast<uint64_t>(depthBits >> 8);
+}
+
+void RenderQueue::Build(const std::vector<DrawItem>& p_drawItems, const XMMATRIX& p_vpMatrix, WorkerPool& p_workerPool)
+{
+	BEAR_PROFILE_FUNCTION();
+
+	auto sortStart = std::chrono::high_resolution_clock::now();
+
+	const size_t itemCount = p_drawItems.size();
+	const unsigned int taskCount = static_cast<unsigned int>(std::clamp<size_t>(itemCount / MinItemsPerSortTask,
+		1, p_workerPool.GetThreadCount() + 1));
+	const size_t chunkSize = (itemCount + taskCount - 1) / taskCount;
+
+	m_entries.resize(itemCount);
+	m_keyBits.assign(taskCount, KeyBits());
+
+	if (itemCount > 0)
+	{
+		p_workerPool.Dispatch(taskCount, [&](unsigned int taskIndex)
+			{
+				size_t firstItem = taskIndex * chunkSize;
+				size_t endItem = std::min<size_t>(firstItem + chunkSize, itemCount);
+				KeyBits& keyBits = m_keyBits[taskIndex];
+
+				for (size_t i = firstItem; i < endItem; i++)
+				{
+					const DrawItem& item = p_drawItems[i];
+
+					// translation row of the model matrix, w of its clip position is the view depth
+					float viewDepth = XMVectorGetW(XMVector4Transform(item.constants.modelMatrix.r[3], p_vpMatrix));
+
+					Entry& entry = m_entries[i];
+					entry.key = MakeSortKey(PASS_GBUFFER, 0, item.materialId, item.meshId, viewDepth);
+					entry.index = static_cast<uint32_t>(i);
+					keyBits.setInAny |= entry.key;
+					keyBits.setInAll &= entry.key;
+				}
+			});
+	}
+
+	KeyBits keyBits;
+	for (const KeyBits& taskBits : m_keyBits)
+	{
+		keyBits.setInAny |= taskBits.setInAny;
+		keyBits.setInAll &= taskBits.setInAll;
+	}
+
+	_sort(p_workerPool, taskCount, keyBits.setInAny ^ keyBits.setInAll);
+
+	m_stats.items = static_cast<unsigned int>(itemCount);
+	m_stats.sortMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - sortStart).count();
+	m_stats.stateChangesUnsorted = _countStateChanges(p_drawItems, nullptr);
+	m_stats.stateChangesSorted = _countStateChanges(p_drawItems, &m_entries);
+}
+
+void RenderQueue::Gather(const std::vector<DrawItem>& p_drawItems, std::vector<DrawItem>& out_sortedItems) const
+{
+	out_sortedItems.resize(m_entries.size());
+	for (size_t i = 0; i < m_entries.size(); i++)
+	{
+		out_sortedItems[i] = p_drawItems[m_entries[i].index];
+	}
+}
+
+void RenderQueue::_sort(WorkerPool& p_workerPool, unsigned int p_taskCount, uint64_t p_differingBits)
+{
+	const size_t itemCount = m_entries.size();
+	const size_t chunkSize = (itemCount + p_taskCount - 1) / p_taskCount;
+
+	m_scratch.resize(itemCount);
+	m_bucketOffsets.resize(p_taskCount * RADIX_BUCKETS);
+	m_stats.radixPasses = 0;
+
+	Entry* source_p = m_entries.data();
+	Entry* destination_p = m_scratch.data();
+
+	for (unsigned int byteIndex = 0; byteIndex < KEY_BYTES; byteIndex++)
+	{
+		const unsigned int shift = byteIndex * 8;
+		if (((p_differingBits >> shift) & 0xFF) == 0)
+		{
+			// the same byte in every key, the pass would not move anything
+			continue;
+		}
+
+		p_workerPool.Dispatch(p_taskCount, [&](unsigned int taskIndex)
+			{
+				uint32_t* counts_p = &m_bucketOffsets[taskIndex * RADIX_BUCKETS];
+				std::fill(counts_p, counts_p + RADIX_BUCKETS, 0);
+
+				size_t firstItem = taskIndex * chunkSize;
+				size_t endItem = std::min<size_t>(firstItem + chunkSize, itemCount);
+				for (size_t i = firstItem; i < endItem; i++)
+				{
+					counts_p[(source_p[i].key >> shift) & 0xFF]++;
+				}
+			});
+
+		// bucket by bucket, and within a bucket chunk by chunk, so the pass stays stable
+		uint32_t offset = 0;
+		for (unsigned int bucket = 0; bucket < RADIX_BUCKETS; bucket++)
+		{
+			for (unsigned int taskIndex = 0; taskIndex < p_taskCount; taskIndex++)
+			{
+				uint32_t& bucketOffset = m_bucketOffsets[taskIndex * RADIX_BUCKETS + bucket];
+				uint32_t count = bucketOffset;
+				bucketOffset = offset;
+				offset += count;
+			}
+		}
+
+		p_workerPool.Dispatch(p_taskCount, [&](unsigned int taskIndex)
+			{
+				uint32_t* offsets_p = &m_bucketOffsets[taskIndex * RADIX_BUCKETS];
+
+				size_t firstItem = taskIndex * chunkSize;
+				size_t endItem = std::min<size_t>(firstItem + chunkSize, itemCount);
+				for (size_t i = firstItem; i < endItem; i++)
+				{
+					const Entry& entry = source_p[i];
+					destination_p[offsets_p[(entry.key >> shift) & 0xFF]++] = entry;
+				}
+			});
+
+		std::swap(source_p, destination_p);
+		m_stats.radixPasses++;
+	}
+
+	if (source_p != m_entries.data())
+	{
+		m_entries.swap(m_scratch);
+	}
+}
+
+unsigned int RenderQueue::_countStateChanges(const std::vector<DrawItem>& p_drawItems, const std::vector<Entry>* p_order_p)
+{
+	// what a recorder that skips redundant sets still has to bind, the first draw binds everything
+	unsigned int stateChanges = 0;
+	const DrawItem* previous_p = nullptr;
+	for (size_t i = 0; i < p_drawItems.size(); i++)
+	{
+		const DrawItem& item = p_drawItems[p_order_p != nullptr ? (*p_order_p)[i].index : i];
+		if (previous_p == nullptr || previous_p->textureHandle.ptr != item.textureHandle.ptr)
+		{
+			stateChanges++;
+		}
+		if (previous_p == nullptr || previous_p->positionBufferView.BufferLocation != item.positionBufferView.BufferLocation)
+		{
+			stateChanges++;
+		}
+		previous_p = &item;
+	}
+	return stateChanges;
+}
@@ -0,0 +1,81 @@
+#include "RenderThread.h"
+#include "BearWindow.h"
+#include "D3D12Renderer.h"
+#include "FramePacer.h"
+#include "Profiler.h"
+
+RenderThread::RenderThread(D3D12Renderer* p_renderer_p, FramePacer* p_framePacer_p)
+	: m_renderer_p(p_renderer_p), m_framePacer_p(p_framePacer_p)
+{
+	m_thread = std::thread(&RenderThread::_renderLoop, this);
+}
+
+RenderThread::~RenderThread()
+{
+	Stop();
+}
+
+FramePacket& RenderThread::BeginPacket()
+{
+	return m_mailbox.GetWriteSlot();
+}
+
+void RenderThread::PublishPacket()
+{
+	if (m_mailbox.Publish())
+	{
+		m_droppedPackets++;
+	}
+}
+
+void RenderThread::RunWhileIdle(const std::function<void()>& p_function)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_renderMutex);
+	p_function();
+}
+
+void RenderThread::Stop()
+{
+	if (!m_thread.joinable())
+	{
+		return;
+	}
+
+	m_isQuitting = true;
+	m_mailbox.Close();
+	m_thread.join();
+}
+
+void RenderThread::_renderLoop()
+{
+	BEAR_PROFILE_THREAD("Render");
+
+	while (!m_isQuitting)
+	{
+		// a timeout, so a quit request is seen even if no packet ever comes
+		FramePacket* packet_p = m_mailbox.Acquire(std::chrono::milliseconds(100));
+		if (packet_p == nullptr)
+		{
+			continue;
+		}
+
+		std::lock_guard<std::recursive_mutex> lock(m_renderMutex);
+
+		// block here rather than in Present, the game thread keeps simulating meanwhile
+		{
+			BEAR_PROFILE_ZONE("WaitForPresentQueue");
+			m_framePacer_p->WaitForPresentQueue(packet_p->window->GetFrameLatencyWaitableObject());
+		}
+
+		// a newer packet may have come in while waiting, render that one instead
+		FramePacket* newerPacket_p = m_mailbox.Acquire(std::chrono::milliseconds(0));
+		if (newerPacket_p != nullptr)
+		{
+			packet_p = newerPacket_p;
+			m_droppedPackets++;
+		}
+
+		m_renderer_p->Render(*packet_p);
+		m_renderedFrames++;
+	}
+}
@@ -0,0 +1,106 @@
+#include "SceneBvh.h"
+#include "EntityInstance.h"
+#include "Profiler.h"
+
+#include <chrono>
+
+void SceneBvh::Sync(const std::vector<Instance*>& p_instances)
+{
+	BEAR_PROFILE_FUNCTION();
+
+	auto syncStart = std::chrono::high_resolution_clock::now();
+
+	m_syncCount++;
+	m_stats.inserted = 0;
+	m_stats.removed = 0;
+	m_stats.refit = 0;
+
+	for (Instance* instance_p : p_instances)
+	{
+		int32_t leaf = instance_p->bvhLeaf;
+
+		// a new instance, possibly at the address of a removed one
+		if (leaf < 0 || leaf >= static_cast<int32_t>(m_leafStates.size()) || m_leafStates[leaf].instance_p != instance_p)
+		{
+			leaf = m_tree.Insert(instance_p->GetWorldBounds(), instance_p);
+			if (leaf >= static_cast<int32_t>(m_leafStates.size()))
+			{
+				m_leafStates.resize(leaf + 1);
+			}
+
+			instance_p->bvhLeaf = leaf;
+			m_leafStates[leaf].instance_p = instance_p;
+			m_leafStates[leaf].revision = instance_p->GetRevision();
+			m_stats.inserted++;
+		}
+		else if (m_leafStates[leaf].revision != instance_p->GetRevision())
+		{
+			m_tree.Refit(leaf, instance_p->GetWorldBounds());
+			m_leafStates[leaf].revision = instance_p->GetRevision();
+			m_stats.refit++;
+		}
+
+		m_leafStates[leaf].seenInSync = m_syncCount;
+	}
+
+	// the rest were deleted since the last frame
+	for (size_t leaf = 0; leaf < m_leafStates.size(); leaf++)
+	{
+		LeafState& state = m_leafStates[leaf];
+		if (state.instance_p != nullptr && state.seenInSync != m_syncCount)
+		{
+			m_tree.Remove(static_cast<int32_t>(leaf));
+			state = LeafState();
+			m_stats.removed++;
+		}
+	}
+
+	m_stats.leaves = m_tree.GetLeafCount();
+	m_stats.height = m_tree.GetHeight();
+	m_stats.rotations = m_tree.GetRotationCount();
+	m_stats.syncMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - syncStart).count();
+}
+
+void SceneBvh::CullFrustum(const FrustumPlanes& p_planes, std::vector<Instance*>& out_visible)
+{
+	auto cullStart = std::chrono::high_resolution_clock::now();
+
+	m_tree.QueryFrustum(p_planes, m_queryResult);
+
+	out_visible.resize(m_queryResult.size());
+	for (size_t i = 0; i < m_queryResult.size(); i++)
+	{
+		out_visible[i] = static_cast<Instance*>(m_queryResult[i]);
+	}
+
+	m_stats.cullNodes = m_tree.GetLastQueryNodes();
+	m_stats.visible = static_cast<unsigned int>(out_visible.size());
+	m_stats.cullMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - cullStart).count();
+}
+
+Instance* SceneBvh::Pick(const XMVECTOR& p_origin, const XMVECTOR& p_direction)
+{
+	BEAR_PROFILE_FUNCTION();
+
+	XMFLOAT3 origin;
+	XMFLOAT3 direction;
+	XMStoreFloat3(&origin, p_origin);
+	XMStoreFloat3(&direction, p_direction);
+
+	// the boxes only narrow it down, the mesh decides
+	Instance* nearest_p = nullptr;
+	m_tree.RayCast(&origin.x, &direction.x, 1.0f, [&](void* userData_p, float maxT)
+		{
+			Instance* instance_p = static_cast<Instance*>(userData_p);
+			float t = maxT;
+			if (instance_p->IntersectRay(p_origin, p_direction, maxT, t) && t < maxT)
+			{
+				nearest_p = instance_p;
+				return t;
+			}
+			return maxT;
+		});
+
+	m_stats.pickNodes = m_tree.GetLastQueryNodes();
+	return nearest_p;
+}
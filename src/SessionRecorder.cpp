@@ -0,0 +1,510 @@
+#include "SessionRecorder.h"
+#include "Application.h"
+#include "BearWindow.h"
+#include "MeshManager.h"
+#include "MessageQueue.h"
+#include "UIManager.h"
+
+#include <cstdio>
+#include <cstring>
+
+static SessionRecorder* gs_pSingleton = nullptr;
+
+// set while the replay pushes a logged message, so OnMessage lets it through
+static thread_local bool tl_isInjecting = false;
+
+static const char LOG_MAGIC[8] = { 'B', 'E', 'A', 'R', 'S', 'E', 'S', 'S' };
+
+SessionRecorder& SessionRecorder::Get()
+{
+	if (gs_pSingleton == nullptr)
+	{
+		gs_pSingleton = new SessionRecorder();
+	}
+	return *gs_pSingleton;
+}
+
+bool SessionRecorder::StartRecording(const std::string& p_path)
+{
+	if (m_mode != MODE_IDLE)
+	{
+		return false;
+	}
+
+	// fail now rather than after the session
+	FILE* file_p = nullptr;
+	if (fopen_s(&file_p, p_path.c_str(), "wb") != 0 || file_p == nullptr)
+	{
+		return false;
+	}
+	fclose(file_p);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_path = p_path;
+	m_log.clear();
+	m_frameNumber = 0;
+	m_mode = MODE_RECORDING;
+	return true;
+}
+
+bool SessionRecorder::StopRecording()
+{
+	if (m_mode != MODE_RECORDING)
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_mode = MODE_IDLE;
+
+	FILE* file_p = nullptr;
+	if (fopen_s(&file_p, m_path.c_str(), "wb") != 0 || file_p == nullptr)
+	{
+		return false;
+	}
+
+	const uint32_t version = LogVersion;
+	bool isWritten = fwrite(LOG_MAGIC, sizeof(LOG_MAGIC), 1, file_p) == 1 &&
+		fwrite(&version, sizeof(version), 1, file_p) == 1 &&
+		(m_log.empty() || fwrite(m_log.data(), m_log.size(), 1, file_p) == 1);
+	isWritten = fclose(file_p) == 0 && isWritten;
+
+	m_log.clear();
+	m_log.shrink_to_fit();
+	return isWritten;
+}
+
+uint64_t SessionRecorder::GetRecordedBytes() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_log.size();
+}
+
+bool SessionRecorder::StartReplay(const std::string& p_path, bool p_shouldQuitWhenDone)
+{
+	if (m_mode != MODE_IDLE)
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!_loadLog(p_path))
+	{
+		return false;
+	}
+
+	m_path = p_path;
+	m_replayCursor = 0;
+	m_replayStats = SessionReplayStats();
+	for (unsigned int queue = 0; queue < SESSION_QUEUE_COUNT; queue++)
+	{
+		m_expectedMessages[queue].clear();
+		m_matchedCount[queue] = 0;
+	}
+
+	for (size_t i = 0; i < m_replayEvents.size(); i++)
+	{
+		const ReplayEvent& event = m_replayEvents[i];
+		if (event.kind == EVENT_FRAME)
+		{
+			m_replayStats.totalFrames++;
+		}
+		else if (event.kind == EVENT_MESSAGE && !_isSuppliedByLog(event.value))
+		{
+			m_expectedMessages[event.queue].push_back(i);
+		}
+	}
+
+	m_shouldQuitWhenDone = p_shouldQuitWhenDone;
+	m_recordedMilliseconds.clear();
+	m_replayedMilliseconds.clear();
+	m_recordedMilliseconds.reserve(m_replayStats.totalFrames);
+	m_replayedMilliseconds.reserve(m_replayStats.totalFrames);
+	m_lastFrameStart = Clock::now();
+	m_frameNumber = 0;
+	m_mode = MODE_REPLAYING;
+	return true;
+}
+
+void SessionRecorder::StopReplay()
+{
+	if (m_mode == MODE_REPLAYING)
+	{
+		_finishReplay();
+	}
+}
+
+SessionReplayStats SessionRecorder::GetReplayStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_replayStats;
+}
+
+double SessionRecorder::BeginFrame(double p_deltaSeconds, BearWindow* p_window_p)
+{
+	m_frameDeltaSeconds = p_deltaSeconds;
+
+	if (m_mode == MODE_RECORDING)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const EventKind kind = EVENT_FRAME;
+		_append(&kind, sizeof(kind));
+		_append(&p_deltaSeconds, sizeof(p_deltaSeconds));
+		m_frameNumber++;
+	}
+	else if (m_mode == MODE_REPLAYING)
+	{
+		m_frameDeltaSeconds = _replayFrame(p_window_p);
+	}
+
+	return m_frameDeltaSeconds;
+}
+
+bool SessionRecorder::IsInputMessage(UINT p_message)
+{
+	switch (p_message)
+	{
+	case WM_KEYDOWN:
+	case WM_KEYUP:
+	case WM_SYSKEYDOWN:
+	case WM_SYSKEYUP:
+	case WM_CHAR:
+	case WM_MOUSEMOVE:
+	case WM_MOUSELEAVE:
+	case WM_LBUTTONDOWN:
+	case WM_LBUTTONUP:
+	case WM_LBUTTONDBLCLK:
+	case WM_RBUTTONDOWN:
+	case WM_RBUTTONUP:
+	case WM_RBUTTONDBLCLK:
+	case WM_MBUTTONDOWN:
+	case WM_MBUTTONUP:
+	case WM_MBUTTONDBLCLK:
+	case WM_MOUSEWHEEL:
+	case WM_MOUSEHWHEEL:
+	case WM_SETFOCUS:
+	case WM_KILLFOCUS:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool SessionRecorder::OnInput(bool p_isDemoWindow, UINT p_message, WPARAM p_wParam, LPARAM p_lParam)
+{
+	if (m_mode == MODE_REPLAYING)
+	{
+		return false;
+	}
+
+	if (m_mode == MODE_RECORDING)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const EventKind kind = EVENT_INPUT;
+		const uint8_t isDemoWindow = p_isDemoWindow ? 1 : 0;
+		const uint32_t message = p_message;
+		const uint64_t wParam = static_cast<uint64_t>(p_wParam);
+		const int64_t lParam = static_cast<int64_t>(p_lParam);
+		_append(&kind, sizeof(kind));
+		_append(&isDemoWindow, sizeof(isDemoWindow));
+		_append(&message, sizeof(message));
+		_append(&wParam, sizeof(wParam));
+		_append(&lParam, sizeof(lParam));
+	}
+
+	return true;
+}
+
+bool SessionRecorder::OnMessage(SessionQueue p_queue, Message& p_message)
+{
+	if (m_mode == MODE_IDLE || tl_isInjecting)
+	{
+		return true;
+	}
+
+	const uint32_t type = p_message.type;
+	const uint32_t size = static_cast<uint32_t>(p_message.GetSize());
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_mode == MODE_IDLE)
+	{
+		// stopped while waiting for the lock
+		return true;
+	}
+
+	if (m_mode == MODE_RECORDING)
+	{
+		const EventKind kind = EVENT_MESSAGE;
+		const uint8_t queue = p_queue;
+		_append(&kind, sizeof(kind));
+		_append(&queue, sizeof(queue));
+		_append(&type, sizeof(type));
+		_append(&size, sizeof(size));
+		_append(p_message.GetData(), size);
+		return true;
+	}
+
+	if (_isSuppliedByLog(type))
+	{
+		return false;
+	}
+
+	// the listener threads answer asynchronously, so messages are matched by order, not by frame
+	bool isMatching = false;
+	size_t& matchedCount = m_matchedCount[p_queue];
+	if (matchedCount < m_expectedMessages[p_queue].size())
+	{
+		const ReplayEvent& expected = m_replayEvents[m_expectedMessages[p_queue][matchedCount]];
+		isMatching = expected.value == type && expected.payloadSize == size &&
+			(!_hasComparablePayload(type) || size == 0 ||
+				memcmp(m_replayPayloads.data() + expected.payloadOffset, p_message.GetData(), size) == 0);
+		matchedCount++;
+	}
+
+	if (isMatching)
+	{
+		m_replayStats.matchedMessages++;
+	}
+	else
+	{
+		m_replayStats.divergentMessages++;
+		if (m_replayStats.firstDivergentFrame < 0)
+		{
+			m_replayStats.firstDivergentFrame = static_cast<int64_t>(m_frameNumber.load());
+		}
+	}
+	return true;
+}
+
+bool SessionRecorder::_isSuppliedByLog(uint32_t p_messageType)
+{
+	// sampled on a timer, a replay running at another speed would see different values
+	return p_messageType == MSG_TYPE_CPU_MEMORY_INFO;
+}
+
+bool SessionRecorder::_hasComparablePayload(uint32_t p_messageType)
+{
+	// these carry Instance pointers, which differ from run to run
+	return p_messageType != MSG_TYPE_INSTANCE_REPLY && p_messageType != MSG_TYPE_REMOVE_INSTANCE;
+}
+
+void SessionRecorder::_append(const void* p_data_p, size_t p_size)
+{
+	const uint8_t* bytes_p = static_cast<const uint8_t*>(p_data_p);
+	m_log.insert(m_log.end(), bytes_p, bytes_p + p_size);
+}
+
+bool SessionRecorder::_loadLog(const std::string& p_path)
+{
+	FILE* file_p = nullptr;
+	if (fopen_s(&file_p, p_path.c_str(), "rb") != 0 || file_p == nullptr)
+	{
+		return false;
+	}
+
+	std::vector<uint8_t> bytes;
+	uint8_t chunk[4096];
+	size_t readSize = 0;
+	while ((readSize = fread(chunk, 1, sizeof(chunk), file_p)) > 0)
+	{
+		bytes.insert(bytes.end(), chunk, chunk + readSize);
+	}
+	fclose(file_p);
+
+	size_t offset = 0;
+	auto read = [&](void* out_p, size_t p_size) -> bool
+		{
+			if (offset + p_size > bytes.size())
+			{
+				return false;
+			}
+			memcpy(out_p, bytes.data() + offset, p_size);
+			offset += p_size;
+			return true;
+		};
+
+	char magic[sizeof(LOG_MAGIC)];
+	uint32_t version = 0;
+	if (!read(magic, sizeof(magic)) || memcmp(magic, LOG_MAGIC, sizeof(magic)) != 0 ||
+		!read(&version, sizeof(version)) || version != LogVersion)
+	{
+		return false;
+	}
+
+	m_replayEvents.clear();
+	m_replayPayloads.clear();
+
+	while (offset < bytes.size())
+	{
+		ReplayEvent event = {};
+		uint8_t kind = 0;
+		read(&kind, sizeof(kind));
+		event.kind = static_cast<EventKind>(kind);
+
+		bool isValid = false;
+		switch (event.kind)
+		{
+		case EVENT_FRAME:
+			isValid = read(&event.deltaSeconds, sizeof(event.deltaSeconds));
+			break;
+		case EVENT_INPUT:
+		{
+			uint8_t isDemoWindow = 0;
+			isValid = read(&isDemoWindow, sizeof(isDemoWindow)) && read(&event.value, sizeof(event.value)) &&
+				read(&event.wParam, sizeof(event.wParam)) && read(&event.lParam, sizeof(event.lParam));
+			event.isDemoWindow = isDemoWindow != 0;
+			break;
+		}
+		case EVENT_MESSAGE:
+			isValid = read(&event.queue, sizeof(event.queue)) && read(&event.value, sizeof(event.value)) &&
+				read(&event.payloadSize, sizeof(event.payloadSize)) && event.queue < SESSION_QUEUE_COUNT &&
+				offset + event.payloadSize <= bytes.size();
+			if (isValid)
+			{
+				event.payloadOffset = m_replayPayloads.size();
+				m_replayPayloads.insert(m_replayPayloads.end(), bytes.begin() + offset, bytes.begin() + offset + event.payloadSize);
+				offset += event.payloadSize;
+			}
+			break;
+		default:
+			break;
+		}
+
+		if (!isValid)
+		{
+			// truncated or corrupt from here on, e.g. the recording process was killed
+			break;
+		}
+		m_replayEvents.push_back(event);
+	}
+
+	return true;
+}
+
+double SessionRecorder::_replayFrame(BearWindow* p_window_p)
+{
+	// wall time since the previous frame began, like the recorded delta; the first one counts from StartReplay
+	Clock::time_point now = Clock::now();
+	double replayedMilliseconds = std::chrono::duration<double, std::milli>(now - m_lastFrameStart).count();
+	m_lastFrameStart = now;
+
+	// everything logged between the previous frame and this one, dispatched without the lock,
+	// the window and the managers may send messages in turn
+	std::vector<ReplayEvent> pendingEvents;
+	double deltaSeconds = 0.0;
+	bool isFinished = false;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		while (m_replayCursor < m_replayEvents.size() && m_replayEvents[m_replayCursor].kind != EVENT_FRAME)
+		{
+			pendingEvents.push_back(m_replayEvents[m_replayCursor++]);
+		}
+
+		if (m_replayCursor < m_replayEvents.size())
+		{
+			deltaSeconds = m_replayEvents[m_replayCursor++].deltaSeconds;
+			m_recordedMilliseconds.push_back(deltaSeconds * 1000.0);
+			m_replayedMilliseconds.push_back(replayedMilliseconds);
+			m_replayStats.frames++;
+		}
+		else
+		{
+			isFinished = true;
+		}
+	}
+
+	for (const ReplayEvent& event : pendingEvents)
+	{
+		if (event.kind == EVENT_INPUT)
+		{
+			// the log switched windows at the same point, unless the session already diverged
+			if (p_window_p != nullptr && p_window_p->IsPhysicsEnabled() == event.isDemoWindow)
+			{
+				p_window_p->HandleInput(event.value, static_cast<WPARAM>(event.wParam), static_cast<LPARAM>(event.lParam));
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_replayStats.inputEvents++;
+			}
+		}
+		else if (event.kind == EVENT_MESSAGE && _isSuppliedByLog(event.value))
+		{
+			_injectMessage(event);
+		}
+	}
+
+	if (isFinished)
+	{
+		_finishReplay();
+		return m_frameDeltaSeconds;
+	}
+
+	m_frameNumber++;
+	return deltaSeconds;
+}
+
+void SessionRecorder::_injectMessage(const ReplayEvent& p_event)
+{
+	Message* message_p = new Message();
+	message_p->type = static_cast<MessageType>(p_event.value);
+	if (p_event.payloadSize > 0)
+	{
+		message_p->SetData(m_replayPayloads.data() + p_event.payloadOffset, p_event.payloadSize);
+	}
+
+	tl_isInjecting = true;
+	if (p_event.queue == SESSION_QUEUE_MESH)
+	{
+		MeshManager::Get().ReceiveMessage(message_p);
+	}
+	else
+	{
+		UIManager::Get().ReceiveMessage(message_p);
+	}
+	tl_isInjecting = false;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_replayStats.injectedMessages++;
+}
+
+void SessionRecorder::_finishReplay()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_mode = MODE_IDLE;
+		m_replayStats.isFinished = true;
+
+		// a listener thread may still be waiting for the lock in OnMessage
+		m_replayEvents.clear();
+		m_replayPayloads.clear();
+		for (unsigned int queue = 0; queue < SESSION_QUEUE_COUNT; queue++)
+		{
+			m_expectedMessages[queue].clear();
+		}
+	}
+
+	_writeFrameTimes();
+
+	if (m_shouldQuitWhenDone)
+	{
+		Application::Get().Quit(0);
+	}
+}
+
+bool SessionRecorder::_writeFrameTimes() const
+{
+	FILE* file_p = nullptr;
+	std::string csvPath = m_path + ".frames.csv";
+	if (fopen_s(&file_p, csvPath.c_str(), "w") != 0 || file_p == nullptr)
+	{
+		return false;
+	}
+
+	// recorded: frame time of the session that was logged; replayed: this run
+	fprintf(file_p, "frame,recorded_ms,replayed_ms\n");
+	for (size_t i = 0; i < m_recordedMilliseconds.size(); i++)
+	{
+		fprintf(file_p, "%zu,%.4f,%.4f\n", i, m_recordedMilliseconds[i], m_replayedMilliseconds[i]);
+	}
+
+	return fclose(file_p) == 0;
+}
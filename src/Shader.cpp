@@ -1,22 +1,32 @@
 #include <Shader.h>
 #include <Helpers.h>
+#include <BatchRecording.h>
 #include <cstring>
 #include <DirectXMath.h>
 #include <CommandQueue.h>
 using namespace DirectX;
 
 #include <Application.h>
+#include <Texture.h>
+#include <BearWindow.h>
 
-// POSITION: float3, NORMAL: float3, TEXCOORD: float2
+// POSITION: float3 in slot 0; NORMAL: float3, TANGENT: float3, TEXCOORD: float2 in slot 1, see FirstPassVertexAttributes
 static D3D12_INPUT_ELEMENT_DESC firstPassInputLayout[] = {
 		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-		{ "TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 36, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 1, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 1, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 1, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 };
 
 static UINT firstPassInputLayoutCount = sizeof(firstPassInputLayout) / sizeof(D3D12_INPUT_ELEMENT_DESC);
 
+// the depth prepass reads slot 0 only
+static D3D12_INPUT_ELEMENT_DESC depthPrepassInputLayout[] = {
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+};
+
+static UINT depthPrepassInputLayoutCount = sizeof(depthPrepassInputLayout) / sizeof(D3D12_INPUT_ELEMENT_DESC);
+
 // Deferred rendering is second pass
 static D3D12_INPUT_ELEMENT_DESC secondPassInputLayout[] = {
 	{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
@@ -25,12 +35,35 @@ static D3D12_INPUT_ELEMENT_DESC secondPassInputLayout[] = {
 
 static UINT secondPassInputLayoutCount = sizeof(secondPassInputLayout) / sizeof(D3D12_INPUT_ELEMENT_DESC);
 
-Shader::Shader(const wchar_t* p_1stVsPath, const wchar_t* p_1stPsPath, const wchar_t* p_2ndVsPath, const wchar_t* p_2ndPsPath)
+// s1 of both lighting passes: 2x2 depth comparisons, blended bilinearly; outside the map is lit
+static D3D12_STATIC_SAMPLER_DESC _getShadowSamplerDesc(D3D12_SHADER_VISIBILITY p_visibility)
+{
+	D3D12_STATIC_SAMPLER_DESC sampler = {};
+	sampler.Filter = D3D12_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
+	sampler.AddressU = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
+	sampler.AddressV = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
+	sampler.AddressW = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+	sampler.MipLODBias = 0;
+	sampler.MaxAnisotropy = 1;
+	sampler.ComparisonFunc = D3D12_COMPARISON_FUNC_LESS_EQUAL;
+	sampler.BorderColor = D3D12_STATIC_BORDER_COLOR_OPAQUE_WHITE;
+	sampler.MinLOD = 0.0f;
+	sampler.MaxLOD = 0.0f;
+	sampler.ShaderRegister = 1;
+	sampler.RegisterSpace = 0;
+	sampler.ShaderVisibility = p_visibility;
+	return sampler;
+}
+
+Shader::Shader(const wchar_t* p_1stVsPath, const wchar_t* p_1stPsPath, const wchar_t* p_2ndVsPath, const wchar_t* p_2ndPsPath,
+	const wchar_t* p_lightingCsPath, const wchar_t* p_depthPrepassVsPath)
 {
 	m_1stVsPath = p_1stVsPath;
 	m_1stPsPath = p_1stPsPath;
 	m_2ndVsPath = p_2ndVsPath;
 	m_2ndPsPath = p_2ndPsPath;
+	m_lightingCsPath = p_lightingCsPath;
+	m_depthPrepassVsPath = p_depthPrepassVsPath;
 
 	_createRSAndPSO();
 }
@@ -45,27 +78,37 @@ void Shader::_createRSAndPSO()
 	ThrowIfFailed(D3DReadFileToBlob((L"shaders\\" + m_1stPsPath + L".cso").c_str(), &m_1stPassPixelShaderBlob));
 	ThrowIfFailed(D3DReadFileToBlob((L"shaders\\" + m_2ndVsPath + L".cso").c_str(), &m_2ndPassVertexShaderBlob));
 	ThrowIfFailed(D3DReadFileToBlob((L"shaders\\" + m_2ndPsPath + L".cso").c_str(), &m_2ndPassPixelShaderBlob));
+	ThrowIfFailed(D3DReadFileToBlob((L"shaders\\" + m_lightingCsPath + L".cso").c_str(), &m_tiledLightingComputeShaderBlob));
+	ThrowIfFailed(D3DReadFileToBlob((L"shaders\\" + m_depthPrepassVsPath + L".cso").c_str(), &m_depthPrepassVertexShaderBlob));
 
 	_create1st();
 	_create2nd();
+	_createTiledLighting();
 }
 
 void Shader::RebuildShaders()
 {
-	ThrowIfFailed(D3DCompileFromFile((L"shaders\\" + m_1stVsPath + L".hlsl").c_str(), nullptr, nullptr,
+	ThrowIfFailed(D3DCompileFromFile((L"shaders\\" + m_1stVsPath + L".hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE,
 		"main", "vs_5_1", 0, 0, &m_1stPassVertexShaderBlob, nullptr));
 
-	ThrowIfFailed(D3DCompileFromFile((L"shaders\\" + m_1stPsPath + L".hlsl").c_str(), nullptr, nullptr,
+	ThrowIfFailed(D3DCompileFromFile((L"shaders\\" + m_1stPsPath + L".hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE,
 		"main", "ps_5_1", 0, 0, &m_1stPassPixelShaderBlob, nullptr));
 
-	ThrowIfFailed(D3DCompileFromFile((L"shaders\\" + m_2ndVsPath + L".hlsl").c_str(), nullptr, nullptr,
+	ThrowIfFailed(D3DCompileFromFile((L"shaders\\" + m_2ndVsPath + L".hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE,
 		"main", "vs_5_1", 0, 0, &m_2ndPassVertexShaderBlob, nullptr));
 
-	ThrowIfFailed(D3DCompileFromFile((L"shaders\\" + m_2ndPsPath + L".hlsl").c_str(), nullptr, nullptr,
+	ThrowIfFailed(D3DCompileFromFile((L"shaders\\" + m_2ndPsPath + L".hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE,
 		"main", "ps_5_1", 0, 0, &m_2ndPassPixelShaderBlob, nullptr));
 
+	ThrowIfFailed(D3DCompileFromFile((L"shaders\\" + m_lightingCsPath + L".hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE,
+		"main", "cs_5_1", 0, 0, &m_tiledLightingComputeShaderBlob, nullptr));
+
+	ThrowIfFailed(D3DCompileFromFile((L"shaders\\" + m_depthPrepassVsPath + L".hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE,
+		"main", "vs_5_1", 0, 0, &m_depthPrepassVertexShaderBlob, nullptr));
+
 	_create1st();
 	_create2nd();
+	_createTiledLighting();
 }
 
 void Shader::_create1st()
@@ -89,10 +132,13 @@ void Shader::_create1st()
 
 	// A single 32-bit constant root parameter that is used by the vertex shader.
 	// first pass don't handle lights, only textures is enough
-	CD3DX12_ROOT_PARAMETER1 rootParameters[2];
-	CD3DX12_DESCRIPTOR_RANGE1 descriptorRange = CD3DX12_DESCRIPTOR_RANGE1(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 3, 0);
+	CD3DX12_ROOT_PARAMETER1 rootParameters[4];
+	CD3DX12_DESCRIPTOR_RANGE1 descriptorRange = CD3DX12_DESCRIPTOR_RANGE1(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, ResourceIndex::MAX_NO, 0); // diffuse, packed material
 	rootParameters[0].InitAsDescriptorTable(1, &descriptorRange, D3D12_SHADER_VISIBILITY_PIXEL); // texture
-	rootParameters[1].InitAsConstants(sizeof(VertexShaderInput) / 4, 0, 0, D3D12_SHADER_VISIBILITY_VERTEX); // MVP matrix
+	rootParameters[1].InitAsConstants(sizeof(DrawBatchRootConstants) / 4, 0, 0, D3D12_SHADER_VISIBILITY_VERTEX); // first instance, per draw
+	rootParameters[2].InitAsConstants(sizeof(FirstPassRootConstants) / 4, 1, 0, D3D12_SHADER_VISIBILITY_VERTEX); // VP matrix, per list
+	// model matrices of every instance, per frame; written by the CPU right before submission
+	rootParameters[3].InitAsShaderResourceView(0, 1, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE, D3D12_SHADER_VISIBILITY_VERTEX);
 
 	D3D12_STATIC_SAMPLER_DESC sampler = {};
 	sampler.Filter = D3D12_FILTER_ANISOTROPIC;
@@ -110,7 +156,7 @@ void Shader::_create1st()
 	sampler.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
 
 	CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDescription;
-	rootSignatureDescription.Init_1_1(2, rootParameters, 1, &sampler, rootSignatureFlags);
+	rootSignatureDescription.Init_1_1(4, rootParameters, 1, &sampler, rootSignatureFlags);
 
 	// Serialize the root signature.
 	ComPtr<ID3DBlob> rootSignatureBlob;
@@ -121,11 +167,13 @@ void Shader::_create1st()
 	ThrowIfFailed(device->CreateRootSignature(0, rootSignatureBlob->GetBufferPointer(),
 		rootSignatureBlob->GetBufferSize(), IID_PPV_ARGS(&m_1stPassRootSignature)));
 
+	// albedo plus specular, octahedral normal; see GBufferEncoding.h
 	D3D12_RT_FORMAT_ARRAY rtvFormats = {};
-	rtvFormats.NumRenderTargets = 3;
-	rtvFormats.RTFormats[0] = DXGI_FORMAT_R32G32B32A32_FLOAT; // diffuse
-	rtvFormats.RTFormats[1] = DXGI_FORMAT_R32_FLOAT; // specular
-	rtvFormats.RTFormats[2] = DXGI_FORMAT_R32G32B32A32_FLOAT; // normal
+	rtvFormats.NumRenderTargets = BearWindow::FirstPassRTVCount;
+	for (UINT i = 0; i < BearWindow::FirstPassRTVCount; i++)
+	{
+		rtvFormats.RTFormats[i] = BearWindow::FirstPassRTVFormats[i];
+	}
 
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC graphicsPipelineState;
 	memset(&graphicsPipelineState, 0, sizeof(D3D12_GRAPHICS_PIPELINE_STATE_DESC));
@@ -144,13 +192,40 @@ void Shader::_create1st()
 	graphicsPipelineState.SampleMask = UINT_MAX;
 	graphicsPipelineState.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
 	graphicsPipelineState.NumRenderTargets = rtvFormats.NumRenderTargets;
-	graphicsPipelineState.RTVFormats[0] = rtvFormats.RTFormats[0];
-	graphicsPipelineState.RTVFormats[1] = rtvFormats.RTFormats[1];
-	graphicsPipelineState.RTVFormats[2] = rtvFormats.RTFormats[2];
+	for (UINT i = 0; i < rtvFormats.NumRenderTargets; i++)
+	{
+		graphicsPipelineState.RTVFormats[i] = rtvFormats.RTFormats[i];
+	}
 	graphicsPipelineState.SampleDesc.Count = 1;
 	graphicsPipelineState.SampleDesc.Quality = 0;
 	graphicsPipelineState.DSVFormat = DXGI_FORMAT_D32_FLOAT;
 	ThrowIfFailed(device->CreateGraphicsPipelineState(&graphicsPipelineState, IID_PPV_ARGS(&m_1stPassPipelineState)));
+
+	// after the depth prepass: only the surface the prepass kept passes, and the depth is final already
+	graphicsPipelineState.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_EQUAL;
+	graphicsPipelineState.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+	ThrowIfFailed(device->CreateGraphicsPipelineState(&graphicsPipelineState, IID_PPV_ARGS(&m_1stPassDepthEqualPipelineState)));
+
+	// the depth prepass: same root signature, positions only, no pixel shader and no render targets
+	graphicsPipelineState.InputLayout = { depthPrepassInputLayout, static_cast<UINT>(depthPrepassInputLayoutCount) };
+	graphicsPipelineState.VS = CD3DX12_SHADER_BYTECODE(m_depthPrepassVertexShaderBlob.Get());
+	graphicsPipelineState.PS = {};
+	graphicsPipelineState.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+	graphicsPipelineState.NumRenderTargets = 0;
+	for (UINT i = 0; i < rtvFormats.NumRenderTargets; i++)
+	{
+		graphicsPipelineState.RTVFormats[i] = DXGI_FORMAT_UNKNOWN;
+	}
+	ThrowIfFailed(device->CreateGraphicsPipelineState(&graphicsPipelineState, IID_PPV_ARGS(&m_depthPrepassPipelineState)));
+
+	// the shadow maps: the same, from the light, biased against acne; both faces, so open meshes cast too,
+	// and casters between the light and the near plane are flattened onto it instead of clipped
+	graphicsPipelineState.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+	graphicsPipelineState.RasterizerState.DepthClipEnable = FALSE;
+	graphicsPipelineState.RasterizerState.DepthBias = 64; // steps of the D16 format, 64 / 65536 of the cascade's depth range
+	graphicsPipelineState.RasterizerState.SlopeScaledDepthBias = 2.0f;
+	graphicsPipelineState.DSVFormat = D3D12Renderer::ShadowMapFormat;
+	ThrowIfFailed(device->CreateGraphicsPipelineState(&graphicsPipelineState, IID_PPV_ARGS(&m_shadowMapPipelineState)));
 }
 
 void Shader::_create2nd()
@@ -173,15 +248,23 @@ void Shader::_create2nd()
 		D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS;
 
 	// A single 32-bit constant root parameter that is used by the vertex shader.
-	CD3DX12_ROOT_PARAMETER1 rootParameters[4];
-	CD3DX12_DESCRIPTOR_RANGE1 descriptorRange1 = CD3DX12_DESCRIPTOR_RANGE1(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 3, 0);
+	CD3DX12_ROOT_PARAMETER1 rootParameters[10];
+	CD3DX12_DESCRIPTOR_RANGE1 descriptorRange1 = CD3DX12_DESCRIPTOR_RANGE1(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, BearWindow::FirstPassRTVCount, 0);
 	CD3DX12_DESCRIPTOR_RANGE1 descriptorRange2 = CD3DX12_DESCRIPTOR_RANGE1(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 3);
+	CD3DX12_DESCRIPTOR_RANGE1 descriptorRange3 = CD3DX12_DESCRIPTOR_RANGE1(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 9);
 	rootParameters[0].InitAsConstantBufferView(0); // Light CB
 	rootParameters[1].InitAsDescriptorTable(1, &descriptorRange1, D3D12_SHADER_VISIBILITY_PIXEL); // G-buffer inputs
 	rootParameters[2].InitAsDescriptorTable(1, &descriptorRange2, D3D12_SHADER_VISIBILITY_PIXEL); // G-buffer inputs, depth
 	rootParameters[3].InitAsConstants(sizeof(SecondPassRootConstants) / 4, 1, 0, D3D12_SHADER_VISIBILITY_PIXEL); // MVP matrix
+	// lights and their clusters, structured buffers in the light manager's upload buffer
+	for (UINT i = 0; i < 5; i++)
+	{
+		rootParameters[4 + i].InitAsShaderResourceView(4 + i, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE, D3D12_SHADER_VISIBILITY_PIXEL);
+	}
+	rootParameters[9].InitAsDescriptorTable(1, &descriptorRange3, D3D12_SHADER_VISIBILITY_PIXEL); // shadow maps
 
-	D3D12_STATIC_SAMPLER_DESC sampler = {};
+	D3D12_STATIC_SAMPLER_DESC samplers[2] = {};
+	D3D12_STATIC_SAMPLER_DESC& sampler = samplers[0];
 	sampler.Filter = D3D12_FILTER_ANISOTROPIC;
 	sampler.AddressU = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
 	sampler.AddressV = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
@@ -195,9 +278,10 @@ void Shader::_create2nd()
 	sampler.ShaderRegister = 0;
 	sampler.RegisterSpace = 0;
 	sampler.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+	samplers[1] = _getShadowSamplerDesc(D3D12_SHADER_VISIBILITY_PIXEL);
 
 	CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDescription;
-	rootSignatureDescription.Init_1_1(4, rootParameters, 1, &sampler, rootSignatureFlags);
+	rootSignatureDescription.Init_1_1(10, rootParameters, 2, samplers, rootSignatureFlags);
 
 	// Serialize the root signature.
 	ComPtr<ID3DBlob> rootSignatureBlob;
@@ -231,4 +315,54 @@ void Shader::_create2nd()
 	graphicsPipelineState.SampleDesc.Count = 1;
 	graphicsPipelineState.SampleDesc.Quality = 0;
 	ThrowIfFailed(device->CreateGraphicsPipelineState(&graphicsPipelineState, IID_PPV_ARGS(&m_2ndPassPipelineState)));
+}
+
+void Shader::_createTiledLighting()
+{
+	auto device = Application::Get().GetDevice();
+
+	// Create a root signature.
+	D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData = {};
+	featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_1;
+	if ((((HRESULT)(device->CheckFeatureSupport(D3D12_FEATURE_ROOT_SIGNATURE, &featureData, sizeof(featureData)))) < 0))
+	{
+		featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
+	}
+
+	// the same inputs as the second pass, less the clusters, and the lit image as output
+	CD3DX12_ROOT_PARAMETER1 rootParameters[9];
+	CD3DX12_DESCRIPTOR_RANGE1 descriptorRange1 = CD3DX12_DESCRIPTOR_RANGE1(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, BearWindow::FirstPassRTVCount, 0);
+	CD3DX12_DESCRIPTOR_RANGE1 descriptorRange2 = CD3DX12_DESCRIPTOR_RANGE1(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 3);
+	CD3DX12_DESCRIPTOR_RANGE1 descriptorRange3 = CD3DX12_DESCRIPTOR_RANGE1(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0);
+	CD3DX12_DESCRIPTOR_RANGE1 descriptorRange4 = CD3DX12_DESCRIPTOR_RANGE1(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 9);
+	rootParameters[0].InitAsConstantBufferView(0); // Light CB
+	rootParameters[1].InitAsDescriptorTable(1, &descriptorRange1); // G-buffer inputs
+	rootParameters[2].InitAsDescriptorTable(1, &descriptorRange2); // G-buffer inputs, depth
+	rootParameters[3].InitAsConstants(sizeof(SecondPassRootConstants) / 4, 1, 0); // inverse screen VP matrix
+	rootParameters[4].InitAsDescriptorTable(1, &descriptorRange3); // lit image
+	// directional, point and spot lights
+	for (UINT i = 0; i < 3; i++)
+	{
+		rootParameters[5 + i].InitAsShaderResourceView(4 + i, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE);
+	}
+	rootParameters[8].InitAsDescriptorTable(1, &descriptorRange4); // shadow maps
+
+	D3D12_STATIC_SAMPLER_DESC shadowSampler = _getShadowSamplerDesc(D3D12_SHADER_VISIBILITY_ALL);
+
+	CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDescription;
+	rootSignatureDescription.Init_1_1(9, rootParameters, 1, &shadowSampler, D3D12_ROOT_SIGNATURE_FLAG_NONE);
+
+	// Serialize the root signature.
+	ComPtr<ID3DBlob> rootSignatureBlob;
+	ComPtr<ID3DBlob> errorBlob;
+	ThrowIfFailed(D3DX12SerializeVersionedRootSignature(&rootSignatureDescription,
+		featureData.HighestVersion, &rootSignatureBlob, &errorBlob));
+	// Create the root signature.
+	ThrowIfFailed(device->CreateRootSignature(0, rootSignatureBlob->GetBufferPointer(),
+		rootSignatureBlob->GetBufferSize(), IID_PPV_ARGS(&m_tiledLightingRootSignature)));
+
+	D3D12_COMPUTE_PIPELINE_STATE_DESC computePipelineState = {};
+	computePipelineState.pRootSignature = m_tiledLightingRootSignature.Get();
+	computePipelineState.CS = CD3DX12_SHADER_BYTECODE(m_tiledLightingComputeShaderBlob.Get());
+	ThrowIfFailed(device->CreateComputePipelineState(&computePipelineState, IID_PPV_ARGS(&m_tiledLightingPipelineState)));
 }
\ No newline at end of file
@@ -0,0 +1,287 @@
+#include "ShadowCascades.h"
+#include "Profiler.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+// below this many casters per task the light space pass runs on fewer threads
+static const size_t MinCastersPerTask = 4096;
+
+void ShadowCascades::SetCamera(const float* p_view_p, float p_tanHalfFovX, float p_tanHalfFovY, float p_nearZ, float p_farZ)
+{
+	memcpy(m_view, p_view_p, sizeof(m_view));
+	m_tanHalfFovX = p_tanHalfFovX;
+	m_tanHalfFovY = p_tanHalfFovY;
+	m_nearZ = p_nearZ;
+	m_farZ = p_farZ;
+}
+
+void ShadowCascades::SetLightDirection(const float* p_direction_p)
+{
+	float axes[3][3];
+
+	// z along the light; a light without a direction shines straight down
+	const float length = std::sqrt(p_direction_p[0] * p_direction_p[0] + p_direction_p[1] * p_direction_p[1] + p_direction_p[2] * p_direction_p[2]);
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		axes[2][i] = length > 1e-6f ? p_direction_p[i] / length : (i == 1 ? -1.0f : 0.0f);
+	}
+
+	// a fixed up vector, so the map does not spin with the camera; world z if the light is close to vertical
+	const float up[3] = { 0.0f, std::fabs(axes[2][1]) > 0.99f ? 0.0f : 1.0f, std::fabs(axes[2][1]) > 0.99f ? 1.0f : 0.0f };
+
+	// x = normalize(up cross z), y = z cross x, as XMMatrixLookToLH builds them
+	axes[0][0] = up[1] * axes[2][2] - up[2] * axes[2][1];
+	axes[0][1] = up[2] * axes[2][0] - up[0] * axes[2][2];
+	axes[0][2] = up[0] * axes[2][1] - up[1] * axes[2][0];
+	const float xLength = std::sqrt(axes[0][0] * axes[0][0] + axes[0][1] * axes[0][1] + axes[0][2] * axes[0][2]);
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		axes[0][i] /= xLength;
+	}
+	axes[1][0] = axes[2][1] * axes[0][2] - axes[2][2] * axes[0][1];
+	axes[1][1] = axes[2][2] * axes[0][0] - axes[2][0] * axes[0][2];
+	axes[1][2] = axes[2][0] * axes[0][1] - axes[2][1] * axes[0][0];
+
+	if (memcmp(axes, m_lightAxes, sizeof(axes)) != 0)
+	{
+		memcpy(m_lightAxes, axes, sizeof(axes));
+		m_hasLightChanged = true;
+	}
+}
+
+void ShadowCascades::SetShadowDistance(float p_distance, float p_lambda)
+{
+	m_shadowDistance = p_distance;
+	m_lambda = std::clamp<float>(p_lambda, 0.0f, 1.0f);
+}
+
+void ShadowCascades::Fit()
+{
+	const float nearZ = m_nearZ;
+	const float farZ = std::max<float>(std::min<float>(m_farZ, m_shadowDistance), nearZ * 1.001f);
+	const float tanSquared = m_tanHalfFovX * m_tanHalfFovX + m_tanHalfFovY * m_tanHalfFovY;
+
+	// the eye and the view direction in world space, from the rows of the view matrix's rotation
+	float eye[3];
+	float forward[3];
+	for (unsigned int j = 0; j < 3; j++)
+	{
+		eye[j] = -(m_view[12] * m_view[j * 4] + m_view[13] * m_view[j * 4 + 1] + m_view[14] * m_view[j * 4 + 2]);
+		forward[j] = m_view[j * 4 + 2];
+	}
+
+	m_stats.refitCascades = 0;
+	float sliceNear = nearZ;
+	for (unsigned int cascade = 0; cascade < CascadeCount; cascade++)
+	{
+		const float t = static_cast<float>(cascade + 1) / CascadeCount;
+		float sliceFar = m_lambda * nearZ * std::pow(farZ / nearZ, t) + (1.0f - m_lambda) * (nearZ + (farZ - nearZ) * t);
+		if (cascade == CascadeCount - 1)
+		{
+			sliceFar = farZ;
+		}
+
+		// The smallest sphere around the slice's corners is centered on the view axis; its radius only
+		// depends on the projection, so turning the camera cannot change the size of the map.
+		float centerDepth = (sliceNear + sliceFar) * (1.0f + tanSquared) * 0.5f;
+		float radius;
+		if (centerDepth >= sliceFar)
+		{
+			centerDepth = sliceFar;
+			radius = std::sqrt(tanSquared) * sliceFar;
+		}
+		else
+		{
+			radius = std::sqrt(tanSquared * sliceNear * sliceNear + (centerDepth - sliceNear) * (centerDepth - sliceNear));
+		}
+		const float halfSize = radius * (1.0f + Margin);
+
+		float worldCenter[3];
+		for (unsigned int j = 0; j < 3; j++)
+		{
+			worldCenter[j] = eye[j] + forward[j] * centerDepth;
+		}
+		float center[3];
+		_toLightSpace(worldCenter, center);
+
+		// kept while the sphere is inside the map's box, depth included
+		Placement& placement = m_placements[cascade];
+		bool isInside = !m_hasLightChanged && placement.halfSize == halfSize;
+		for (unsigned int axis = 0; axis < 3 && isInside; axis++)
+		{
+			isInside = std::fabs(center[axis] - placement.center[axis]) + radius <= halfSize;
+		}
+
+		const float texelSize = 2.0f * halfSize / Resolution;
+		if (!isInside)
+		{
+			for (unsigned int axis = 0; axis < 3; axis++)
+			{
+				placement.center[axis] = std::floor(center[axis] / texelSize + 0.5f) * texelSize;
+			}
+			placement.halfSize = halfSize;
+			m_stats.refitCascades++;
+		}
+
+		m_cascades[cascade].splitDepth = sliceFar;
+		m_cascades[cascade].texelSize = texelSize;
+		_buildViewProjection(cascade);
+
+		sliceNear = sliceFar;
+	}
+
+	m_hasLightChanged = false;
+}
+
+void ShadowCascades::Resize(size_t p_count)
+{
+	m_casters.resize(p_count);
+	m_lightSpaceCasters.resize(p_count);
+}
+
+void ShadowCascades::SetCaster(size_t p_index, const BoundingAabb& p_bounds)
+{
+	m_casters[p_index] = p_bounds;
+}
+
+void ShadowCascades::Cull(WorkerPool* p_workerPool_p)
+{
+	BEAR_PROFILE_FUNCTION();
+
+	auto cullStart = std::chrono::high_resolution_clock::now();
+
+	const size_t count = m_casters.size();
+	const unsigned int maxTasks = p_workerPool_p != nullptr ? p_workerPool_p->GetThreadCount() + 1 : 1;
+	const unsigned int lightTaskCount = static_cast<unsigned int>(std::clamp<size_t>(count / MinCastersPerTask, 1, maxTasks));
+	const size_t chunkSize = (count + lightTaskCount - 1) / lightTaskCount;
+
+	// the box around the rotated box: the extents project onto every light axis
+	auto lightTask = [&](unsigned int taskIndex)
+		{
+			const size_t first = std::min<size_t>(taskIndex * chunkSize, count);
+			const size_t end = std::min<size_t>(first + chunkSize, count);
+			for (size_t i = first; i < end; i++)
+			{
+				const BoundingAabb& caster = m_casters[i];
+				BoundingAabb& lightCaster = m_lightSpaceCasters[i];
+				_toLightSpace(caster.center, lightCaster.center);
+				for (unsigned int axis = 0; axis < 3; axis++)
+				{
+					lightCaster.extents[axis] = std::fabs(m_lightAxes[axis][0]) * caster.extents[0] +
+						std::fabs(m_lightAxes[axis][1]) * caster.extents[1] + std::fabs(m_lightAxes[axis][2]) * caster.extents[2];
+				}
+			}
+		};
+
+	auto cascadeTask = [&](unsigned int cascade)
+		{
+			_cullCascade(cascade);
+		};
+
+	if (maxTasks > 1)
+	{
+		p_workerPool_p->Dispatch(lightTaskCount, lightTask);
+		p_workerPool_p->Dispatch(CascadeCount, cascadeTask);
+	}
+	else
+	{
+		lightTask(0);
+		for (unsigned int cascade = 0; cascade < CascadeCount; cascade++)
+		{
+			cascadeTask(cascade);
+		}
+	}
+
+	m_stats.casters = static_cast<unsigned int>(count);
+	m_stats.casterIndices = 0;
+	for (const ShadowCascade& cascade : m_cascades)
+	{
+		m_stats.casterIndices += static_cast<unsigned int>(cascade.casters.size());
+	}
+	m_stats.cullMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - cullStart).count();
+}
+
+void ShadowCascades::_toLightSpace(const float* p_world_p, float* out_light_p) const
+{
+	for (unsigned int axis = 0; axis < 3; axis++)
+	{
+		out_light_p[axis] = p_world_p[0] * m_lightAxes[axis][0] + p_world_p[1] * m_lightAxes[axis][1] + p_world_p[2] * m_lightAxes[axis][2];
+	}
+}
+
+void ShadowCascades::_buildViewProjection(unsigned int p_cascade)
+{
+	// light space rotation, then the map's box to x, y in [-1, 1] and z in [0, 1]
+	const Placement& placement = m_placements[p_cascade];
+	const float halfSize = placement.halfSize;
+	float* matrix_p = m_cascades[p_cascade].viewProjection;
+
+	for (unsigned int row = 0; row < 3; row++)
+	{
+		matrix_p[row * 4] = m_lightAxes[0][row] / halfSize;
+		matrix_p[row * 4 + 1] = m_lightAxes[1][row] / halfSize;
+		matrix_p[row * 4 + 2] = m_lightAxes[2][row] / (2.0f * halfSize);
+		matrix_p[row * 4 + 3] = 0.0f;
+	}
+	matrix_p[12] = -placement.center[0] / halfSize;
+	matrix_p[13] = -placement.center[1] / halfSize;
+	matrix_p[14] = (halfSize - placement.center[2]) / (2.0f * halfSize);
+	matrix_p[15] = 1.0f;
+}
+
+void ShadowCascades::_cullCascade(unsigned int p_cascade)
+{
+	// Against the whole square, not just the slice's sphere: the map is kept while the sphere moves
+	// inside it, so it has to hold every caster that can reach any part of it.
+	const Placement& placement = m_placements[p_cascade];
+	const float halfSize = placement.halfSize;
+	std::vector<uint32_t>& casters = m_cascades[p_cascade].casters;
+
+	casters.clear();
+	for (size_t i = 0; i < m_lightSpaceCasters.size(); i++)
+	{
+		const BoundingAabb& caster = m_lightSpaceCasters[i];
+		if (std::fabs(caster.center[0] - placement.center[0]) <= halfSize + caster.extents[0] &&
+			std::fabs(caster.center[1] - placement.center[1]) <= halfSize + caster.extents[1] &&
+			caster.center[2] - caster.extents[2] <= placement.center[2] + halfSize)
+		{
+			casters.push_back(static_cast<uint32_t>(i));
+		}
+	}
+}
+
+ShadowMapCache::ShadowMapCache(unsigned int p_setCount)
+	: m_entries(p_setCount * ShadowCascades::CascadeCount)
+{
+}
+
+bool ShadowMapCache::Update(unsigned int p_set, unsigned int p_cascade, const float* p_viewProjection_p, const std::vector<uint64_t>& p_casterRevisions)
+{
+	Entry& entry = m_entries[p_set * ShadowCascades::CascadeCount + p_cascade];
+
+	m_sortedRevisions.assign(p_casterRevisions.begin(), p_casterRevisions.end());
+	std::sort(m_sortedRevisions.begin(), m_sortedRevisions.end());
+
+	if (entry.isValid && memcmp(entry.viewProjection, p_viewProjection_p, sizeof(entry.viewProjection)) == 0 &&
+		entry.casterRevisions == m_sortedRevisions)
+	{
+		return false;
+	}
+
+	entry.isValid = true;
+	memcpy(entry.viewProjection, p_viewProjection_p, sizeof(entry.viewProjection));
+	entry.casterRevisions.swap(m_sortedRevisions);
+	return true;
+}
+
+void ShadowMapCache::Invalidate()
+{
+	for (Entry& entry : m_entries)
+	{
+		entry.isValid = false;
+	}
+}
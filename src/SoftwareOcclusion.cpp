@@ -0,0 +1,435 @@
+#include "SoftwareOcclusion.h"
+#include "Profiler.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BEAR_SOFTWARE_OCCLUSION_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#define BEAR_TARGET_AVX2
+#else
+#define BEAR_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+// clip = position * M for a row-major M
+static void TransformPoint(const float* p_matrix_p, float p_x, float p_y, float p_z, float* out_clip_p)
+{
+	for (unsigned int column = 0; column < 4; column++)
+	{
+		out_clip_p[column] = p_x * p_matrix_p[column] + p_y * p_matrix_p[4 + column] +
+			p_z * p_matrix_p[8 + column] + p_matrix_p[12 + column];
+	}
+}
+
+void SoftwareOcclusion::Begin(const float* p_viewProjection_p)
+{
+	memcpy(m_viewProjection, p_viewProjection_p, sizeof(m_viewProjection));
+	m_occluders.clear();
+}
+
+void SoftwareOcclusion::AddOccluder(const float* p_modelToClip_p, const float* p_corners_p, size_t p_triangleCount)
+{
+	Occluder occluder;
+	memcpy(occluder.modelToClip, p_modelToClip_p, sizeof(occluder.modelToClip));
+	occluder.corners_p = p_corners_p;
+	occluder.triangleCount = p_triangleCount;
+	occluder.firstTriangle = 0;
+	m_occluders.push_back(occluder);
+}
+
+void SoftwareOcclusion::Rasterize(WorkerPool* p_workerPool_p)
+{
+	BEAR_PROFILE_FUNCTION();
+
+	auto rasterStart = std::chrono::high_resolution_clock::now();
+
+	size_t triangleCount = 0;
+	for (Occluder& occluder : m_occluders)
+	{
+		occluder.firstTriangle = triangleCount;
+		triangleCount += occluder.triangleCount;
+	}
+	m_triangles.resize(triangleCount);
+
+	const bool isAvx2 = m_isAvx2Enabled && FrustumCuller::IsAvx2Supported();
+	const unsigned int maxTasks = p_workerPool_p != nullptr ? p_workerPool_p->GetThreadCount() + 1 : 1;
+
+	// every occluder writes its own range of m_triangles
+	auto setUpTask = [&](unsigned int occluderIndex)
+		{
+			_setUpTriangles(m_occluders[occluderIndex]);
+		};
+
+	const unsigned int occluderCount = static_cast<unsigned int>(m_occluders.size());
+	if (maxTasks > 1 && occluderCount > 1)
+	{
+		p_workerPool_p->Dispatch(occluderCount, setUpTask);
+	}
+	else
+	{
+		for (unsigned int i = 0; i < occluderCount; i++)
+		{
+			setUpTask(i);
+		}
+	}
+
+	// every band owns its rows of pixels and tiles
+	const unsigned int bandCount = std::min<unsigned int>(maxTasks, TilesY);
+	const unsigned int tileRowsPerBand = (TilesY + bandCount - 1) / bandCount;
+	auto bandTask = [&](unsigned int bandIndex)
+		{
+			unsigned int firstTileRow = std::min<unsigned int>(bandIndex * tileRowsPerBand, TilesY);
+			unsigned int endTileRow = std::min<unsigned int>(firstTileRow + tileRowsPerBand, TilesY);
+			_rasterizeBand(firstTileRow, endTileRow, isAvx2);
+		};
+
+	if (bandCount > 1)
+	{
+		p_workerPool_p->Dispatch(bandCount, bandTask);
+	}
+	else
+	{
+		bandTask(0);
+	}
+
+	m_stats.occluders = occluderCount;
+	m_stats.occluderTriangles = 0;
+	for (const ScreenTriangle& triangle : m_triangles)
+	{
+		m_stats.occluderTriangles += triangle.maxX >= triangle.minX ? 1 : 0;
+	}
+	m_stats.tasks = bandCount;
+	m_stats.isAvx2 = isAvx2;
+	m_stats.rasterMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - rasterStart).count();
+}
+
+void SoftwareOcclusion::Resize(size_t p_count)
+{
+	m_bounds.resize(p_count);
+	m_visible.resize(p_count);
+}
+
+void SoftwareOcclusion::SetBounds(size_t p_index, const BoundingAabb& p_bounds)
+{
+	m_bounds[p_index] = p_bounds;
+}
+
+void SoftwareOcclusion::Cull(WorkerPool* p_workerPool_p)
+{
+	BEAR_PROFILE_FUNCTION();
+
+	auto testStart = std::chrono::high_resolution_clock::now();
+
+	const size_t count = m_bounds.size();
+	const unsigned int maxTasks = p_workerPool_p != nullptr ? p_workerPool_p->GetThreadCount() + 1 : 1;
+	const unsigned int taskCount = static_cast<unsigned int>(std::clamp<size_t>(count / MinBoundsPerTestTask, 1, maxTasks));
+	const size_t chunkSize = (count + taskCount - 1) / taskCount;
+
+	m_taskOccluded.assign(taskCount, 0);
+
+	auto testTask = [&](unsigned int taskIndex)
+		{
+			size_t first = std::min<size_t>(taskIndex * chunkSize, count);
+			size_t end = std::min<size_t>(first + chunkSize, count);
+			for (size_t i = first; i < end; i++)
+			{
+				bool isVisible = _isBoundsVisible(m_bounds[i]);
+				m_visible[i] = isVisible ? 1 : 0;
+				m_taskOccluded[taskIndex] += isVisible ? 0 : 1;
+			}
+		};
+
+	if (taskCount > 1)
+	{
+		p_workerPool_p->Dispatch(taskCount, testTask);
+	}
+	else
+	{
+		testTask(0);
+	}
+
+	m_stats.tested = static_cast<unsigned int>(count);
+	m_stats.occluded = 0;
+	for (unsigned int occluded : m_taskOccluded)
+	{
+		m_stats.occluded += occluded;
+	}
+	m_stats.testMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - testStart).count();
+}
+
+void SoftwareOcclusion::_setUpTriangles(const Occluder& p_occluder)
+{
+	for (size_t t = 0; t < p_occluder.triangleCount; t++)
+	{
+		ScreenTriangle& triangle = m_triangles[p_occluder.firstTriangle + t];
+		triangle.minX = 0;
+		triangle.maxX = -1;
+
+		float x[3], y[3], z[3];
+		bool isInFront = true;
+		bool isBeyondFar = true;
+		for (unsigned int corner = 0; corner < 3; corner++)
+		{
+			const float* position_p = p_occluder.corners_p + (t * 3 + corner) * 3;
+			float clip[4];
+			TransformPoint(p_occluder.modelToClip, position_p[0], position_p[1], position_p[2], clip);
+
+			// in front of the near plane, or behind the camera
+			if (clip[2] < 0.0f || clip[3] <= 0.0f)
+			{
+				isInFront = false;
+				break;
+			}
+
+			float inverseW = 1.0f / clip[3];
+			x[corner] = (clip[0] * inverseW * 0.5f + 0.5f) * Width;
+			y[corner] = (0.5f - clip[1] * inverseW * 0.5f) * Height;
+			z[corner] = clip[2] * inverseW;
+			isBeyondFar = isBeyondFar && z[corner] > 1.0f;
+		}
+
+		if (!isInFront || isBeyondFar)
+		{
+			continue;
+		}
+
+		// both faces occlude, so turn every triangle the same way
+		float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+		if (std::fabs(area) < 1e-8f)
+		{
+			continue;
+		}
+		if (area < 0.0f)
+		{
+			std::swap(x[1], x[2]);
+			std::swap(y[1], y[2]);
+			std::swap(z[1], z[2]);
+			area = -area;
+		}
+
+		// edge k runs from corner k to the next one and is >= 0 inside
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			unsigned int next = (k + 1) % 3;
+			triangle.edgeA[k] = y[k] - y[next];
+			triangle.edgeB[k] = x[next] - x[k];
+			triangle.edgeC[k] = (y[next] - y[k]) * x[k] - (x[next] - x[k]) * y[k];
+		}
+
+		// each corner weighted by the edge opposite to it
+		float inverseArea = 1.0f / area;
+		triangle.depthA = (triangle.edgeA[1] * z[0] + triangle.edgeA[2] * z[1] + triangle.edgeA[0] * z[2]) * inverseArea;
+		triangle.depthB = (triangle.edgeB[1] * z[0] + triangle.edgeB[2] * z[1] + triangle.edgeB[0] * z[2]) * inverseArea;
+		triangle.depthC = (triangle.edgeC[1] * z[0] + triangle.edgeC[2] * z[1] + triangle.edgeC[0] * z[2]) * inverseArea;
+
+		// pixels whose centers lie within the corners' extent
+		auto firstPixel = [](float minimum, unsigned int size)
+			{
+				return static_cast<int32_t>(std::ceil(std::clamp<float>(minimum - 0.5f, -1.0f, static_cast<float>(size))));
+			};
+		auto lastPixel = [](float maximum, unsigned int size)
+			{
+				return static_cast<int32_t>(std::floor(std::clamp<float>(maximum - 0.5f, -1.0f, static_cast<float>(size))));
+			};
+
+		int32_t minX = std::max<int32_t>(firstPixel(std::min<float>({ x[0], x[1], x[2] }), Width), 0);
+		int32_t maxX = std::min<int32_t>(lastPixel(std::max<float>({ x[0], x[1], x[2] }), Width), Width - 1);
+		int32_t minY = std::max<int32_t>(firstPixel(std::min<float>({ y[0], y[1], y[2] }), Height), 0);
+		int32_t maxY = std::min<int32_t>(lastPixel(std::max<float>({ y[0], y[1], y[2] }), Height), Height - 1);
+		if (maxX < minX || maxY < minY)
+		{
+			continue;
+		}
+
+		triangle.minX = minX;
+		triangle.maxX = maxX;
+		triangle.minY = minY;
+		triangle.maxY = maxY;
+	}
+}
+
+void SoftwareOcclusion::_rasterizeBand(unsigned int p_firstTileRow, unsigned int p_endTileRow, bool p_isAvx2)
+{
+	const int32_t firstRow = static_cast<int32_t>(p_firstTileRow * TileSize);
+	const int32_t endRow = static_cast<int32_t>(p_endTileRow * TileSize);
+	if (firstRow >= endRow)
+	{
+		return;
+	}
+
+	std::fill(m_depth.begin() + firstRow * Width, m_depth.begin() + endRow * Width, 1.0f);
+
+	for (const ScreenTriangle& triangle : m_triangles)
+	{
+		if (triangle.maxX < triangle.minX || triangle.maxY < firstRow || triangle.minY >= endRow)
+		{
+			continue;
+		}
+
+		int32_t triangleFirstRow = std::max<int32_t>(triangle.minY, firstRow);
+		int32_t triangleEndRow = std::min<int32_t>(triangle.maxY + 1, endRow);
+		if (p_isAvx2)
+		{
+			_rasterizeAvx2(triangle, triangleFirstRow, triangleEndRow);
+		}
+		else
+		{
+			_rasterizeScalar(triangle, triangleFirstRow, triangleEndRow);
+		}
+	}
+
+	// the farthest depth of every tile, what a box has to be behind
+	for (unsigned int tileY = p_firstTileRow; tileY < p_endTileRow; tileY++)
+	{
+		for (unsigned int tileX = 0; tileX < TilesX; tileX++)
+		{
+			float maxDepth = 0.0f;
+			for (unsigned int y = tileY * TileSize; y < (tileY + 1) * TileSize; y++)
+			{
+				const float* row_p = &m_depth[y * Width + tileX * TileSize];
+				for (unsigned int x = 0; x < TileSize; x++)
+				{
+					maxDepth = std::max<float>(maxDepth, row_p[x]);
+				}
+			}
+			m_tileMaxDepth[tileY * TilesX + tileX] = maxDepth;
+		}
+	}
+}
+
+void SoftwareOcclusion::_rasterizeScalar(const ScreenTriangle& p_triangle, int32_t p_firstRow, int32_t p_endRow)
+{
+	for (int32_t y = p_firstRow; y < p_endRow; y++)
+	{
+		const float pixelY = static_cast<float>(y) + 0.5f;
+		const float rowEdge0 = p_triangle.edgeB[0] * pixelY + p_triangle.edgeC[0];
+		const float rowEdge1 = p_triangle.edgeB[1] * pixelY + p_triangle.edgeC[1];
+		const float rowEdge2 = p_triangle.edgeB[2] * pixelY + p_triangle.edgeC[2];
+		const float rowDepth = p_triangle.depthB * pixelY + p_triangle.depthC;
+		float* row_p = &m_depth[y * Width];
+
+		for (int32_t x = p_triangle.minX; x <= p_triangle.maxX; x++)
+		{
+			const float pixelX = static_cast<float>(x) + 0.5f;
+			if (p_triangle.edgeA[0] * pixelX + rowEdge0 >= 0.0f &&
+				p_triangle.edgeA[1] * pixelX + rowEdge1 >= 0.0f &&
+				p_triangle.edgeA[2] * pixelX + rowEdge2 >= 0.0f)
+			{
+				row_p[x] = std::min<float>(row_p[x], p_triangle.depthA * pixelX + rowDepth);
+			}
+		}
+	}
+}
+
+#if defined(BEAR_SOFTWARE_OCCLUSION_X86)
+
+BEAR_TARGET_AVX2 void SoftwareOcclusion::_rasterizeAvx2(const ScreenTriangle& p_triangle, int32_t p_firstRow, int32_t p_endRow)
+{
+	const __m256 laneCenters = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+	const __m256 edgeA0 = _mm256_set1_ps(p_triangle.edgeA[0]);
+	const __m256 edgeA1 = _mm256_set1_ps(p_triangle.edgeA[1]);
+	const __m256 edgeA2 = _mm256_set1_ps(p_triangle.edgeA[2]);
+	const __m256 depthA = _mm256_set1_ps(p_triangle.depthA);
+	const __m256 zero = _mm256_setzero_ps();
+
+	// Width is a multiple of 8, so a block never runs past the row
+	const int32_t firstBlock = p_triangle.minX & ~7;
+
+	for (int32_t y = p_firstRow; y < p_endRow; y++)
+	{
+		const float pixelY = static_cast<float>(y) + 0.5f;
+		const __m256 rowEdge0 = _mm256_set1_ps(p_triangle.edgeB[0] * pixelY + p_triangle.edgeC[0]);
+		const __m256 rowEdge1 = _mm256_set1_ps(p_triangle.edgeB[1] * pixelY + p_triangle.edgeC[1]);
+		const __m256 rowEdge2 = _mm256_set1_ps(p_triangle.edgeB[2] * pixelY + p_triangle.edgeC[2]);
+		const __m256 rowDepth = _mm256_set1_ps(p_triangle.depthB * pixelY + p_triangle.depthC);
+		float* row_p = &m_depth[y * Width];
+
+		for (int32_t x = firstBlock; x <= p_triangle.maxX; x += 8)
+		{
+			const __m256 pixelX = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), laneCenters);
+			__m256 inside = _mm256_and_ps(
+				_mm256_cmp_ps(_mm256_fmadd_ps(edgeA0, pixelX, rowEdge0), zero, _CMP_GE_OQ),
+				_mm256_cmp_ps(_mm256_fmadd_ps(edgeA1, pixelX, rowEdge1), zero, _CMP_GE_OQ));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_fmadd_ps(edgeA2, pixelX, rowEdge2), zero, _CMP_GE_OQ));
+			if (_mm256_movemask_ps(inside) == 0)
+			{
+				continue;
+			}
+
+			__m256 current = _mm256_loadu_ps(row_p + x);
+			__m256 nearest = _mm256_min_ps(current, _mm256_fmadd_ps(depthA, pixelX, rowDepth));
+			_mm256_storeu_ps(row_p + x, _mm256_blendv_ps(current, nearest, inside));
+		}
+	}
+}
+
+#else
+
+void SoftwareOcclusion::_rasterizeAvx2(const ScreenTriangle& p_triangle, int32_t p_firstRow, int32_t p_endRow)
+{
+	_rasterizeScalar(p_triangle, p_firstRow, p_endRow);
+}
+
+#endif
+
+bool SoftwareOcclusion::_isBoundsVisible(const BoundingAabb& p_bounds) const
+{
+	float minX = static_cast<float>(Width);
+	float maxX = 0.0f;
+	float minY = static_cast<float>(Height);
+	float maxY = 0.0f;
+	float minDepth = 1.0f;
+
+	for (unsigned int corner = 0; corner < 8; corner++)
+	{
+		float clip[4];
+		TransformPoint(m_viewProjection,
+			p_bounds.center[0] + ((corner & 1) ? p_bounds.extents[0] : -p_bounds.extents[0]),
+			p_bounds.center[1] + ((corner & 2) ? p_bounds.extents[1] : -p_bounds.extents[1]),
+			p_bounds.center[2] + ((corner & 4) ? p_bounds.extents[2] : -p_bounds.extents[2]), clip);
+
+		// reaches past the near plane, nothing can be in front of it
+		if (clip[2] < 0.0f || clip[3] <= 0.0f)
+		{
+			return true;
+		}
+
+		float inverseW = 1.0f / clip[3];
+		float x = (clip[0] * inverseW * 0.5f + 0.5f) * Width;
+		float y = (0.5f - clip[1] * inverseW * 0.5f) * Height;
+		minX = std::min<float>(minX, x);
+		maxX = std::max<float>(maxX, x);
+		minY = std::min<float>(minY, y);
+		maxY = std::max<float>(maxY, y);
+		minDepth = std::min<float>(minDepth, clip[2] * inverseW);
+	}
+
+	if (maxX < 0.0f || minX >= Width || maxY < 0.0f || minY >= Height)
+	{
+		// off screen, the frustum test decides
+		return true;
+	}
+
+	const int32_t firstTileX = static_cast<int32_t>(std::max<float>(minX, 0.0f)) / TileSize;
+	const int32_t lastTileX = static_cast<int32_t>(std::min<float>(maxX, Width - 1.0f)) / TileSize;
+	const int32_t firstTileY = static_cast<int32_t>(std::max<float>(minY, 0.0f)) / TileSize;
+	const int32_t lastTileY = static_cast<int32_t>(std::min<float>(maxY, Height - 1.0f)) / TileSize;
+
+	for (int32_t tileY = firstTileY; tileY <= lastTileY; tileY++)
+	{
+		for (int32_t tileX = firstTileX; tileX <= lastTileX; tileX++)
+		{
+			if (minDepth <= m_tileMaxDepth[tileY * TilesX + tileX])
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
@@ -6,12 +6,18 @@
 #include "DDSTextureLoader.h"
 #include "WICTextureLoader.h"
 #include "ResourceUploadBatch.h"
+#include "TextureCooker.h"
+#include "MemoryTracker.h"
+
+// cooked DDS files (with full mip chains) are kept apart from the authored sources
+static const wchar_t* COOKED_TEXTURE_DIRECTORY = L"textures\\cooked";
+static const wchar_t* TEXTURE_SLOT_NAMES[ResourceIndex::MAX_NO] = { L"diffuse", L"material" };
 
 void Texture::_initialize()
 {
 	// first in this SRV heap is for imgui
-	// after that, each Texture has 3 textures: diffuse, normal, specular
-	m_srvHeapOffset = Application::Get().AllocateInSRVHeap(3);
+	// after that, each Texture has 2 textures: diffuse, and normal XY + specular packed together
+	m_srvHeapOffset = Application::Get().AllocateInSRVHeap(ResourceIndex::MAX_NO);
 
 	for (unsigned int i = 0; i < ResourceIndex::MAX_NO; i++)
 	{
@@ -19,6 +25,14 @@ void Texture::_initialize()
 	}
 }
 
+Texture::~Texture()
+{
+	for (unsigned int i = 0; i < ResourceIndex::MAX_NO; i++)
+	{
+		MemoryTracker::Get().UntrackResource(m_resources[i].Get());
+	}
+}
+
 void Texture::_loadTexture(unsigned int p_internalResourceIndex)
 {
 	wchar_t filename[256] = L"";
@@ -27,24 +41,55 @@ void Texture::_loadTexture(unsigned int p_internalResourceIndex)
 	size_t convertedChar = 0;
 	mbstowcs_s(&convertedChar, filename, 255, m_name.c_str(), 511);
 
+	if (p_internalResourceIndex >= ResourceIndex::MAX_NO)
+	{
+		return;
+	}
+
+	const wchar_t* slotName = TEXTURE_SLOT_NAMES[p_internalResourceIndex];
+
 	switch (p_internalResourceIndex)
 	{
 	case ResourceIndex::DIFFUSE:
-		swprintf_s(fullpath, 511, L"textures\\%s_diffuse.dds", filename);
-		_loadDDSTexture(fullpath, p_internalResourceIndex);
-		break;
-	case ResourceIndex::NORMAL:
-		swprintf_s(fullpath, 511, L"textures\\%s_normal.jpg", filename);
-		_loadWICTexture(fullpath, p_internalResourceIndex);
+		// an authored DDS already carries its own mips (and block compression); prefer it
+		swprintf_s(fullpath, 511, L"textures\\%s_%s.dds", filename, slotName);
+		if (GetFileAttributesW(fullpath) != INVALID_FILE_ATTRIBUTES)
+		{
+			_loadDDSTexture(fullpath, p_internalResourceIndex);
+			break;
+		}
+
+		swprintf_s(fullpath, 511, L"textures\\%s_%s.jpg", filename, slotName);
+		if (!_loadCookedTexture(fullpath, p_internalResourceIndex))
+		{
+			// cooking failed, upload the source as-is (single mip)
+			_loadWICTexture(fullpath, p_internalResourceIndex);
+		}
 		break;
-	case ResourceIndex::SPECULAR:
-		swprintf_s(fullpath, 511, L"textures\\%s_specular.jpg", filename);
-		_loadWICTexture(fullpath, p_internalResourceIndex);
+	case ResourceIndex::MATERIAL:
+		// a shipped packed texture wins, otherwise pack normal + specular sources at load time
+		swprintf_s(fullpath, 511, L"textures\\%s_%s.dds", filename, slotName);
+		if (GetFileAttributesW(fullpath) != INVALID_FILE_ATTRIBUTES)
+		{
+			_loadDDSTexture(fullpath, p_internalResourceIndex);
+			break;
+		}
+
+		if (!_loadCookedMaterial())
+		{
+			// there is no single-file layout to fall back to, the shader expects the packed one;
+			// a neutral material keeps the texture usable with its diffuse map
+			wchar_t message[512] = L"";
+			swprintf_s(message, 511, L"Cannot cook the material of %s, using a flat normal without specular\n", filename);
+			OutputDebugStringW(message);
+			_createDefaultMaterial();
+		}
 		break;
 	default:
 		return;
 	}
 
+	MemoryTracker::Get().TrackResource(GPU_MEMORY_TEXTURE, m_resources[p_internalResourceIndex].Get());
 	_createSRV(p_internalResourceIndex);
 }
 
@@ -63,6 +108,86 @@ void Texture::_loadDDSTexture(const wchar_t* p_fullpath, unsigned int p_internal
 	uploadFinished.wait();
 }
 
+bool Texture::_loadCookedTexture(const wchar_t* p_sourcePath, unsigned int p_internalResourceIndex)
+{
+	wchar_t filename[256] = L"";
+	wchar_t cookedPath[512] = L"";
+
+	size_t convertedChar = 0;
+	mbstowcs_s(&convertedChar, filename, 255, m_name.c_str(), 511);
+	swprintf_s(cookedPath, 511, L"%s\\%s_%s.dds", COOKED_TEXTURE_DIRECTORY, filename, TEXTURE_SLOT_NAMES[p_internalResourceIndex]);
+
+	if (!TextureCooker::IsUpToDate({ p_sourcePath }, cookedPath))
+	{
+		CreateDirectoryW(COOKED_TEXTURE_DIRECTORY, nullptr); // fails harmlessly if it exists
+
+		TextureCooker cooker;
+		if (!cooker.Cook(p_sourcePath, cookedPath, COOK_USAGE_COLOR))
+		{
+			return false;
+		}
+	}
+
+	_loadDDSTexture(cookedPath, p_internalResourceIndex);
+	return true;
+}
+
+bool Texture::_loadCookedMaterial()
+{
+	wchar_t filename[256] = L"";
+	wchar_t normalPath[512] = L"";
+	wchar_t specularPath[512] = L"";
+	wchar_t cookedPath[512] = L"";
+
+	size_t convertedChar = 0;
+	mbstowcs_s(&convertedChar, filename, 255, m_name.c_str(), 511);
+	swprintf_s(normalPath, 511, L"textures\\%s_normal.jpg", filename);
+	swprintf_s(specularPath, 511, L"textures\\%s_specular.jpg", filename);
+	swprintf_s(cookedPath, 511, L"%s\\%s_%s.dds", COOKED_TEXTURE_DIRECTORY, filename, TEXTURE_SLOT_NAMES[ResourceIndex::MATERIAL]);
+
+	if (!TextureCooker::IsUpToDate({ normalPath, specularPath }, cookedPath))
+	{
+		CreateDirectoryW(COOKED_TEXTURE_DIRECTORY, nullptr);
+
+		TextureCooker cooker;
+		if (!cooker.CookPackedMaterial(normalPath, specularPath, cookedPath))
+		{
+			return false;
+		}
+	}
+
+	_loadDDSTexture(cookedPath, ResourceIndex::MATERIAL);
+	return true;
+}
+
+void Texture::_createDefaultMaterial()
+{
+	static ID3D12Device2* device = Application::Get().GetDevice().Get();
+	static auto copyCommandQueue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COPY)->GetD3D12CommandQueue().Get();
+	static ResourceUploadBatch& rub = Application::Get().GetRUB();
+
+	// what TextureCooker::CookPackedMaterial writes for missing sources: normal XY 0 (RG 0.5), specular 0, spare 1
+	static const uint8_t defaultMaterial[4] = { 128, 128, 0, 255 };
+
+	CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
+	CD3DX12_RESOURCE_DESC textureDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, 1, 1, 1, 1);
+	ThrowIfFailed(device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &textureDesc,
+		D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m_resources[ResourceIndex::MATERIAL])));
+
+	D3D12_SUBRESOURCE_DATA subresource = {};
+	subresource.pData = defaultMaterial;
+	subresource.RowPitch = sizeof(defaultMaterial);
+	subresource.SlicePitch = sizeof(defaultMaterial);
+
+	rub.Begin(D3D12_COMMAND_LIST_TYPE_COPY);
+	rub.Upload(m_resources[ResourceIndex::MATERIAL].Get(), 0, &subresource, 1);
+	rub.Transition(m_resources[ResourceIndex::MATERIAL].Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+
+	auto uploadFinished = rub.End(copyCommandQueue);
+
+	uploadFinished.wait();
+}
+
 void Texture::_loadWICTexture(const wchar_t* p_fullpath, unsigned int p_internalResourceIndex, bool p_createMissingMipmap)
 {
 	static ID3D12Device2* device = Application::Get().GetDevice().Get();
@@ -0,0 +1,572 @@
+#include <TextureCooker.h>
+#include <Helpers.h>
+#include <MemoryTracker.h>
+
+#include <wincodec.h>
+#include <openssl/sha.h>
+
+#include <fstream>
+#include <cmath>
+#include <algorithm>
+
+#include <DirectXPackedVector.h>
+using namespace DirectX::PackedVector;
+
+#include <wrl.h>
+using namespace Microsoft::WRL;
+
+// DDS on-disk layout, only the legacy uncompressed RGBA8 subset is written
+namespace
+{
+	const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+
+	const uint32_t DDSD_CAPS = 0x1;
+	const uint32_t DDSD_HEIGHT = 0x2;
+	const uint32_t DDSD_WIDTH = 0x4;
+	const uint32_t DDSD_PITCH = 0x8;
+	const uint32_t DDSD_PIXELFORMAT = 0x1000;
+	const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+
+	const uint32_t DDPF_ALPHAPIXELS = 0x1;
+	const uint32_t DDPF_RGB = 0x40;
+
+	const uint32_t DDSCAPS_COMPLEX = 0x8;
+	const uint32_t DDSCAPS_TEXTURE = 0x1000;
+	const uint32_t DDSCAPS_MIPMAP = 0x400000;
+
+	struct DDSPixelFormat
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t fourCC;
+		uint32_t RGBBitCount;
+		uint32_t RBitMask;
+		uint32_t GBitMask;
+		uint32_t BBitMask;
+		uint32_t ABitMask;
+	};
+
+	struct DDSHeader
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t height;
+		uint32_t width;
+		uint32_t pitchOrLinearSize;
+		uint32_t depth;
+		uint32_t mipMapCount;
+		uint32_t reserved1[11]; // [0..7] source SHA256, [8] cook version
+		DDSPixelFormat ddspf;
+		uint32_t caps;
+		uint32_t caps2;
+		uint32_t caps3;
+		uint32_t caps4;
+		uint32_t reserved2;
+	};
+
+	static_assert(sizeof(DDSHeader) == 124, "DDS header size mismatch");
+
+	const int KAISER_RADIUS = 3; // in destination-space half-texels, gives 6 source taps
+	const float KAISER_ALPHA = 4.0f;
+
+	// zeroth-order modified Bessel function of the first kind, series expansion
+	float _besselI0(float x)
+	{
+		float sum = 1.0f;
+		float term = 1.0f;
+		float halfX = x * 0.5f;
+		for (int k = 1; k < 16; k++)
+		{
+			term *= (halfX / k) * (halfX / k);
+			sum += term;
+		}
+		return sum;
+	}
+
+	float _sinc(float x)
+	{
+		if (std::fabs(x) < 1e-5f)
+		{
+			return 1.0f;
+		}
+		const float pix = XM_PI * x;
+		return std::sin(pix) / pix;
+	}
+}
+
+TextureCooker::TextureCooker(MipFilter p_filter)
+	: m_filter(p_filter)
+{
+	_buildKernel();
+}
+
+void TextureCooker::_buildKernel()
+{
+	m_weights.clear();
+
+	if (m_filter == MIP_FILTER_BOX)
+	{
+		// destination texel x covers source texels 2x and 2x+1
+		m_firstTapOffset = 0;
+		m_weights.push_back(XMVectorReplicate(0.5f));
+		m_weights.push_back(XMVectorReplicate(0.5f));
+		return;
+	}
+
+	// Kaiser-windowed sinc at half the source frequency.
+	// Source texel centres sit at -2.5, -1.5, ..., 2.5 around the destination centre.
+	m_firstTapOffset = -(KAISER_RADIUS - 1);
+	const int tapCount = KAISER_RADIUS * 2;
+	const float windowNorm = _besselI0(KAISER_ALPHA);
+
+	float weights[KAISER_RADIUS * 2];
+	float total = 0.0f;
+	for (int t = 0; t < tapCount; t++)
+	{
+		float d = (t - KAISER_RADIUS) + 0.5f; // distance in source texels
+		float r = d / KAISER_RADIUS;
+		float window = _besselI0(KAISER_ALPHA * std::sqrt(std::max<float>(0.0f, 1.0f - r * r))) / windowNorm;
+		weights[t] = _sinc(d * 0.5f) * window;
+		total += weights[t];
+	}
+
+	for (int t = 0; t < tapCount; t++)
+	{
+		m_weights.push_back(XMVectorReplicate(weights[t] / total));
+	}
+}
+
+bool TextureCooker::Cook(const wchar_t* p_sourcePath, const wchar_t* p_cookedPath, CookUsage p_usage)
+{
+	std::vector<MipLevel> mipChain(1);
+	if (!_decode(p_sourcePath, p_usage, mipChain[0]))
+	{
+		return false;
+	}
+
+	_buildMipChain(p_usage, mipChain);
+	ScopedMemoryCharge workingSet(MEMORY_TAG_TEXTURE, _getChainBytes(mipChain));
+
+	unsigned char sourceHash[SHA256_DIGEST_LENGTH];
+	_hashFiles({ p_sourcePath }, sourceHash);
+
+	return _writeDDS(p_cookedPath, mipChain, p_usage, sourceHash);
+}
+
+bool TextureCooker::CookPackedMaterial(const wchar_t* p_normalPath, const wchar_t* p_specularPath, const wchar_t* p_cookedPath)
+{
+	const bool hasNormal = GetFileAttributesW(p_normalPath) != INVALID_FILE_ATTRIBUTES;
+	const bool hasSpecular = GetFileAttributesW(p_specularPath) != INVALID_FILE_ATTRIBUTES;
+
+	std::vector<MipLevel> normalChain(1);
+	std::vector<MipLevel> specularChain(1);
+
+	if (hasNormal && !_decode(p_normalPath, COOK_USAGE_NORMAL, normalChain[0]))
+	{
+		return false;
+	}
+	if (hasSpecular && !_decode(p_specularPath, COOK_USAGE_LINEAR, specularChain[0]))
+	{
+		return false;
+	}
+
+	// both chains must line up level by level; the normal map decides the size
+	uint32_t width = hasNormal ? normalChain[0].width : (hasSpecular ? specularChain[0].width : 1);
+	uint32_t height = hasNormal ? normalChain[0].height : (hasSpecular ? specularChain[0].height : 1);
+
+	if (!hasNormal)
+	{
+		normalChain[0].width = width;
+		normalChain[0].height = height;
+		normalChain[0].texels.assign(static_cast<size_t>(width) * height, XMVectorSet(0.0f, 0.0f, 1.0f, 1.0f));
+	}
+
+	if (!hasSpecular)
+	{
+		specularChain[0].width = width;
+		specularChain[0].height = height;
+		specularChain[0].texels.assign(static_cast<size_t>(width) * height, XMVectorZero());
+	}
+	else if (specularChain[0].width != width || specularChain[0].height != height)
+	{
+		MipLevel resampled;
+		_resample(specularChain[0], width, height, resampled);
+		specularChain[0] = std::move(resampled);
+	}
+
+	_buildMipChain(COOK_USAGE_NORMAL, normalChain);
+	_buildMipChain(COOK_USAGE_LINEAR, specularChain);
+
+	// normal XY to [0, 1] in RG, specular in B, A left at 1 for later use
+	static const XMVECTOR half = XMVectorReplicate(0.5f);
+	static const XMVECTOR spare = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+
+	std::vector<MipLevel> packedChain(normalChain.size());
+	for (size_t level = 0; level < normalChain.size(); level++)
+	{
+		const MipLevel& normalLevel = normalChain[level];
+		const MipLevel& specularLevel = specularChain[level];
+		MipLevel& packedLevel = packedChain[level];
+
+		packedLevel.width = normalLevel.width;
+		packedLevel.height = normalLevel.height;
+		packedLevel.texels.resize(normalLevel.texels.size());
+
+		for (size_t i = 0; i < normalLevel.texels.size(); i++)
+		{
+			XMVECTOR normalXY = XMVectorMultiplyAdd(normalLevel.texels[i], half, half);
+			XMVECTOR specular = XMVectorSplatX(specularLevel.texels[i]);
+			XMVECTOR texel = XMVectorSelect(spare, specular, g_XMSelect0010);
+			packedLevel.texels[i] = XMVectorSelect(texel, normalXY, g_XMSelect1100);
+		}
+	}
+
+	ScopedMemoryCharge workingSet(MEMORY_TAG_TEXTURE,
+		_getChainBytes(normalChain) + _getChainBytes(specularChain) + _getChainBytes(packedChain));
+
+	unsigned char sourceHash[SHA256_DIGEST_LENGTH];
+	_hashFiles({ p_normalPath, p_specularPath }, sourceHash);
+
+	return _writeDDS(p_cookedPath, packedChain, COOK_USAGE_LINEAR, sourceHash);
+}
+
+void TextureCooker::_buildMipChain(CookUsage p_usage, std::vector<MipLevel>& p_mipChain)
+{
+	// p_mipChain holds the decoded top level on entry
+	_postProcess(p_mipChain[0], p_usage);
+
+	while (p_mipChain.back().width > 1 || p_mipChain.back().height > 1)
+	{
+		MipLevel nextLevel;
+		_downsample(p_mipChain.back(), nextLevel);
+		_postProcess(nextLevel, p_usage);
+		p_mipChain.push_back(std::move(nextLevel));
+	}
+}
+
+bool TextureCooker::_decode(const wchar_t* p_sourcePath, CookUsage p_usage, MipLevel& out_level)
+{
+	// the cooker may run on the MeshManager listener thread
+	HRESULT comResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+	bool isSuccess = false;
+	{
+		ComPtr<IWICImagingFactory> factory;
+		ComPtr<IWICBitmapDecoder> decoder;
+		ComPtr<IWICBitmapFrameDecode> frame;
+		ComPtr<IWICFormatConverter> converter;
+		UINT width = 0;
+		UINT height = 0;
+
+		if (SUCCEEDED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory))) &&
+			SUCCEEDED(factory->CreateDecoderFromFilename(p_sourcePath, nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder)) &&
+			SUCCEEDED(decoder->GetFrame(0, &frame)) &&
+			SUCCEEDED(frame->GetSize(&width, &height)) &&
+			SUCCEEDED(factory->CreateFormatConverter(&converter)) &&
+			SUCCEEDED(converter->Initialize(frame.Get(), GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom)))
+		{
+			std::vector<uint8_t> rgba(static_cast<size_t>(width) * height * 4);
+			if (SUCCEEDED(converter->CopyPixels(nullptr, width * 4, static_cast<UINT>(rgba.size()), rgba.data())))
+			{
+				out_level.width = width;
+				out_level.height = height;
+				out_level.texels.resize(static_cast<size_t>(width) * height);
+
+				const XMUBYTEN4* source_p = reinterpret_cast<const XMUBYTEN4*>(rgba.data());
+				static const XMVECTOR two = XMVectorReplicate(2.0f);
+				static const XMVECTOR minusOne = XMVectorReplicate(-1.0f);
+
+				for (size_t i = 0; i < out_level.texels.size(); i++)
+				{
+					XMVECTOR texel = XMLoadUByteN4(&source_p[i]);
+					switch (p_usage)
+					{
+					case COOK_USAGE_COLOR:
+						// filter in linear space; alpha is not gamma encoded
+						texel = XMColorSRGBToRGB(texel);
+						break;
+					case COOK_USAGE_NORMAL:
+						// unpack to [-1, 1] so that averaging and renormalizing is meaningful
+						texel = XMVectorMultiplyAdd(texel, two, minusOne);
+						break;
+					default:
+						break;
+					}
+					out_level.texels[i] = texel;
+				}
+
+				isSuccess = true;
+			}
+		}
+	}
+
+	if (SUCCEEDED(comResult))
+	{
+		CoUninitialize();
+	}
+
+	return isSuccess;
+}
+
+void TextureCooker::_downsample(const MipLevel& p_source, MipLevel& out_level)
+{
+	const uint32_t srcWidth = p_source.width;
+	const uint32_t srcHeight = p_source.height;
+	const uint32_t dstWidth = std::max<uint32_t>(1, srcWidth / 2);
+	const uint32_t dstHeight = std::max<uint32_t>(1, srcHeight / 2);
+	const int tapCount = static_cast<int>(m_weights.size());
+
+	// an axis that is already 1 texel wide is copied instead of filtered
+	const bool filterX = srcWidth > 1;
+	const bool filterY = srcHeight > 1;
+
+	// horizontal pass: srcWidth x srcHeight -> dstWidth x srcHeight
+	std::vector<XMVECTOR> horizontal(static_cast<size_t>(dstWidth) * srcHeight);
+	for (uint32_t y = 0; y < srcHeight; y++)
+	{
+		const XMVECTOR* srcRow_p = &p_source.texels[static_cast<size_t>(y) * srcWidth];
+		XMVECTOR* dstRow_p = &horizontal[static_cast<size_t>(y) * dstWidth];
+
+		for (uint32_t x = 0; x < dstWidth; x++)
+		{
+			if (!filterX)
+			{
+				dstRow_p[x] = srcRow_p[0];
+				continue;
+			}
+
+			XMVECTOR acc = XMVectorZero();
+			const int base = static_cast<int>(x * 2) + m_firstTapOffset;
+			for (int t = 0; t < tapCount; t++)
+			{
+				int sx = std::clamp(base + t, 0, static_cast<int>(srcWidth) - 1);
+				acc = XMVectorMultiplyAdd(srcRow_p[sx], m_weights[t], acc);
+			}
+			dstRow_p[x] = acc;
+		}
+	}
+
+	// vertical pass: whole rows at a time so the inner loop walks contiguous memory
+	out_level.width = dstWidth;
+	out_level.height = dstHeight;
+	out_level.texels.assign(static_cast<size_t>(dstWidth) * dstHeight, XMVectorZero());
+
+	for (uint32_t y = 0; y < dstHeight; y++)
+	{
+		XMVECTOR* dstRow_p = &out_level.texels[static_cast<size_t>(y) * dstWidth];
+
+		if (!filterY)
+		{
+			memcpy(dstRow_p, &horizontal[0], sizeof(XMVECTOR) * dstWidth);
+			continue;
+		}
+
+		const int base = static_cast<int>(y * 2) + m_firstTapOffset;
+		for (int t = 0; t < tapCount; t++)
+		{
+			int sy = std::clamp(base + t, 0, static_cast<int>(srcHeight) - 1);
+			const XMVECTOR* srcRow_p = &horizontal[static_cast<size_t>(sy) * dstWidth];
+			const XMVECTOR weight = m_weights[t];
+			for (uint32_t x = 0; x < dstWidth; x++)
+			{
+				dstRow_p[x] = XMVectorMultiplyAdd(srcRow_p[x], weight, dstRow_p[x]);
+			}
+		}
+	}
+}
+
+void TextureCooker::_resample(const MipLevel& p_source, uint32_t p_width, uint32_t p_height, MipLevel& out_level)
+{
+	// bilinear, texel centres aligned; only used to match sizes before the mip chain is built
+	out_level.width = p_width;
+	out_level.height = p_height;
+	out_level.texels.resize(static_cast<size_t>(p_width) * p_height);
+
+	const float scaleX = static_cast<float>(p_source.width) / p_width;
+	const float scaleY = static_cast<float>(p_source.height) / p_height;
+	const int maxX = static_cast<int>(p_source.width) - 1;
+	const int maxY = static_cast<int>(p_source.height) - 1;
+
+	for (uint32_t y = 0; y < p_height; y++)
+	{
+		float sy = std::max<float>(0.0f, (y + 0.5f) * scaleY - 0.5f);
+		int y0 = std::min<int>(static_cast<int>(sy), maxY);
+		int y1 = std::min<int>(y0 + 1, maxY);
+		XMVECTOR fy = XMVectorReplicate(sy - y0);
+
+		const XMVECTOR* row0_p = &p_source.texels[static_cast<size_t>(y0) * p_source.width];
+		const XMVECTOR* row1_p = &p_source.texels[static_cast<size_t>(y1) * p_source.width];
+		XMVECTOR* dstRow_p = &out_level.texels[static_cast<size_t>(y) * p_width];
+
+		for (uint32_t x = 0; x < p_width; x++)
+		{
+			float sx = std::max<float>(0.0f, (x + 0.5f) * scaleX - 0.5f);
+			int x0 = std::min<int>(static_cast<int>(sx), maxX);
+			int x1 = std::min<int>(x0 + 1, maxX);
+			XMVECTOR fx = XMVectorReplicate(sx - x0);
+
+			XMVECTOR top = XMVectorLerpV(row0_p[x0], row0_p[x1], fx);
+			XMVECTOR bottom = XMVectorLerpV(row1_p[x0], row1_p[x1], fx);
+			dstRow_p[x] = XMVectorLerpV(top, bottom, fy);
+		}
+	}
+}
+
+void TextureCooker::_postProcess(MipLevel& p_level, CookUsage p_usage)
+{
+	if (p_usage != COOK_USAGE_NORMAL)
+	{
+		return;
+	}
+
+	// averaged unit vectors get shorter; bring them back to unit length
+	static const XMVECTOR fallbackNormal = XMVectorSet(0.0f, 0.0f, 1.0f, 1.0f);
+	for (XMVECTOR& texel : p_level.texels)
+	{
+		if (XMVectorGetX(XMVector3LengthSq(texel)) < 1e-8f)
+		{
+			texel = fallbackNormal;
+			continue;
+		}
+		texel = XMVectorSelect(texel, XMVector3Normalize(texel), g_XMSelect1110);
+	}
+}
+
+void TextureCooker::_encode(const MipLevel& p_level, CookUsage p_usage, std::vector<uint8_t>& out_bytes)
+{
+	out_bytes.resize(p_level.texels.size() * 4);
+	XMUBYTEN4* dest_p = reinterpret_cast<XMUBYTEN4*>(out_bytes.data());
+
+	static const XMVECTOR half = XMVectorReplicate(0.5f);
+
+	for (size_t i = 0; i < p_level.texels.size(); i++)
+	{
+		XMVECTOR texel = p_level.texels[i];
+		switch (p_usage)
+		{
+		case COOK_USAGE_COLOR:
+			// store gamma-encoded bytes in a UNORM format, so shaders see the same values as before
+			texel = XMColorRGBToSRGB(XMVectorSaturate(texel));
+			break;
+		case COOK_USAGE_NORMAL:
+			texel = XMVectorMultiplyAdd(texel, half, half);
+			break;
+		default:
+			break;
+		}
+		XMStoreUByteN4(&dest_p[i], XMVectorSaturate(texel));
+	}
+}
+
+bool TextureCooker::_writeDDS(const wchar_t* p_cookedPath, const std::vector<MipLevel>& p_mipChain, CookUsage p_usage, const unsigned char* p_sourceHash)
+{
+	std::ofstream ddsFile(p_cookedPath, std::ios::binary);
+	if (!ddsFile.is_open())
+	{
+		return false;
+	}
+
+	DDSHeader header = {};
+	header.size = sizeof(DDSHeader);
+	header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PITCH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT;
+	header.width = p_mipChain[0].width;
+	header.height = p_mipChain[0].height;
+	header.pitchOrLinearSize = p_mipChain[0].width * 4;
+	header.mipMapCount = static_cast<uint32_t>(p_mipChain.size());
+	memcpy(header.reserved1, p_sourceHash, SHA256_DIGEST_LENGTH);
+	header.reserved1[8] = CookVersion;
+
+	// RGBA8 in memory order, maps to DXGI_FORMAT_R8G8B8A8_UNORM
+	header.ddspf.size = sizeof(DDSPixelFormat);
+	header.ddspf.flags = DDPF_RGB | DDPF_ALPHAPIXELS;
+	header.ddspf.RGBBitCount = 32;
+	header.ddspf.RBitMask = 0x000000ff;
+	header.ddspf.GBitMask = 0x0000ff00;
+	header.ddspf.BBitMask = 0x00ff0000;
+	header.ddspf.ABitMask = 0xff000000;
+
+	header.caps = DDSCAPS_TEXTURE | DDSCAPS_MIPMAP | DDSCAPS_COMPLEX;
+
+	ddsFile.write(reinterpret_cast<const char*>(&DDS_MAGIC), sizeof(uint32_t));
+	ddsFile.write(reinterpret_cast<const char*>(&header), sizeof(DDSHeader));
+
+	std::vector<uint8_t> levelBytes;
+	for (const MipLevel& level : p_mipChain)
+	{
+		_encode(level, p_usage, levelBytes);
+		ddsFile.write(reinterpret_cast<const char*>(levelBytes.data()), levelBytes.size());
+	}
+
+	bool isSuccess = ddsFile.good();
+	ddsFile.close();
+	return isSuccess;
+}
+
+bool TextureCooker::IsUpToDate(const std::vector<std::wstring>& p_sourcePaths, const wchar_t* p_cookedPath)
+{
+	std::ifstream ddsFile(p_cookedPath, std::ios::binary);
+	if (!ddsFile.is_open())
+	{
+		return false;
+	}
+
+	uint32_t magic = 0;
+	DDSHeader header = {};
+	ddsFile.read(reinterpret_cast<char*>(&magic), sizeof(uint32_t));
+	ddsFile.read(reinterpret_cast<char*>(&header), sizeof(DDSHeader));
+	ddsFile.close();
+
+	if (magic != DDS_MAGIC || header.reserved1[8] != CookVersion)
+	{
+		return false;
+	}
+
+	unsigned char sourceHash[SHA256_DIGEST_LENGTH];
+	_hashFiles(p_sourcePaths, sourceHash);
+
+	return memcmp(header.reserved1, sourceHash, SHA256_DIGEST_LENGTH) == 0;
+}
+
+size_t TextureCooker::_getChainBytes(const std::vector<MipLevel>& p_mipChain)
+{
+	size_t bytes = 0;
+	for (const MipLevel& level : p_mipChain)
+	{
+		bytes += level.texels.capacity() * sizeof(XMVECTOR);
+	}
+	return bytes;
+}
+
+void TextureCooker::_hashFiles(const std::vector<std::wstring>& p_paths, unsigned char* out_hash)
+{
+	// every source contributes its size followed by its bytes, a missing one only a marker
+	std::vector<char> hashInput;
+
+	for (const std::wstring& path : p_paths)
+	{
+		uint64_t size = UINT64_MAX;
+		std::vector<char> sourceData;
+
+		std::ifstream sourceFile(path, std::ios::binary | std::ios::ate);
+		if (sourceFile.is_open())
+		{
+			std::streamsize fileSize = sourceFile.tellg();
+			sourceFile.seekg(0, std::ios::beg);
+			sourceData.resize(static_cast<size_t>(fileSize));
+			if (sourceFile.read(sourceData.data(), fileSize))
+			{
+				size = static_cast<uint64_t>(fileSize);
+			}
+			else
+			{
+				sourceData.clear();
+			}
+		}
+
+		const char* size_p = reinterpret_cast<const char*>(&size);
+		hashInput.insert(hashInput.end(), size_p, size_p + sizeof(uint64_t));
+		hashInput.insert(hashInput.end(), sourceData.begin(), sourceData.end());
+	}
+
+	SHA256(reinterpret_cast<const unsigned char*>(hashInput.data()), hashInput.size(), out_hash);
+}
@@ -3,9 +3,14 @@
 #include <vector>
 #include <MeshManager.h>
 #include <CommandQueue.h>
+#include <MemoryTracker.h>
+#include <GBufferPool.h>
+#include <Profiler.h>
+#include <SessionRecorder.h>
 
 #include <iostream>
 #include <fstream>
+#include <ctime>
 
 #include <dwrite_3.h>
 #include <d3d11on12.h>
@@ -48,8 +53,6 @@ static char mapNameToLoad[128] = "default";
 
 static char instanceNameBuffer[128] = "";
 
-static inline bool _checkNumOfLights(LightConstants& p_lightConstant);
-
 UIManager::~UIManager()
 {
 	// Cleanup ImGui
@@ -79,6 +82,10 @@ void UIManager::InitializeWindow(HWND hWnd)
 	float main_scale = ImGui_ImplWin32_GetDpiScaleForMonitor(::MonitorFromPoint(POINT{ 0, 0 }, MONITOR_DEFAULTTOPRIMARY));
 
 	IMGUI_CHECKVERSION();
+	// count ImGui allocations under MEMORY_TAG_UI; must be set before the context exists
+	ImGui::SetAllocatorFunctions(
+		[](size_t size, void*) { return MemoryTracker::TaggedAllocate(MEMORY_TAG_UI, size); },
+		[](void* ptr, void*) { MemoryTracker::TaggedFree(MEMORY_TAG_UI, ptr); });
 	ImGui::CreateContext();
 	ImGuiIO& io = ImGui::GetIO(); (void)io;
 	io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;     // Enable Keyboard Controls
@@ -171,7 +178,23 @@ void UIManager::InitializeD3D11On12(ComPtr<ID3D12Device> p_d3d12device, ComPtr<I
 void UIManager::NewFrame()
 {
 	ImGui_ImplDX12_NewFrame();
-	ImGui_ImplWin32_NewFrame();
+
+	SessionRecorder& sessionRecorder = SessionRecorder::Get();
+	if (!sessionRecorder.IsReplaying())
+	{
+		ImGui_ImplWin32_NewFrame();
+	}
+	else
+	{
+		// the win32 backend reads the wall clock and the live mouse position,
+		// during a replay ImGui only gets the logged delta and the logged input
+		ImGuiIO& io = ImGui::GetIO();
+		RECT clientRect = { 0, 0, 0, 0 };
+		GetClientRect(static_cast<HWND>(ImGui::GetMainViewport()->PlatformHandleRaw), &clientRect);
+		io.DisplaySize = ImVec2(static_cast<float>(clientRect.right - clientRect.left), static_cast<float>(clientRect.bottom - clientRect.top));
+		io.DeltaTime = std::max<float>(static_cast<float>(sessionRecorder.GetFrameDeltaSeconds()), 1e-6f);
+	}
+
 	ImGui::NewFrame();
 
 	//ImGui::ShowDemoWindow();
@@ -179,8 +202,12 @@ void UIManager::NewFrame()
 
 void UIManager::CreateImGuiWindowContent()
 {
+	BEAR_PROFILE_FUNCTION();
+
 	NewFrame();
 
+	_pickInstanceUnderMouse();
+
 	ImGuiWindowFlags window_flags = ImGuiWindowFlags_None;
 	window_flags |= ImGuiWindowFlags_NoCollapse;
 
@@ -515,9 +542,11 @@ void UIManager::CreateImGuiWindowContent()
 		if (ImGui::Button("Update Lighting"))
 		{
 			// send message to mesh manager for light modification
+			std::vector<unsigned char> lightData;
+			LightManager::SerializeLights(m_lights, lightData);
 			Message* msg = new Message();
 			msg->type = MSG_TYPE_MODIFY_LIGHT;
-			msg->SetData((unsigned char*)&m_lightConstants, sizeof(LightConstants));
+			msg->SetData(lightData.data(), lightData.size());
 			MeshManager::Get().ReceiveMessage(msg);
 		}
 
@@ -525,99 +554,81 @@ void UIManager::CreateImGuiWindowContent()
 
 		// Lighting editor
 		ImGui::Text("Ambient lighting strength");
-		ImGui::SliderFloat("##ambientStrength", &m_lightConstants.AmbientLightStrength, 0.0f, 10.0f, "%.3f");
+		ImGui::SliderFloat("##ambientStrength", &m_lights.constants.AmbientLightStrength, 0.0f, 10.0f, "%.3f");
 		ImGui::Text("Ambient lighting color");
-		ImGui::ColorEdit3("##ambientColor", (float*)&m_lightConstants.AmbientLightColor);
+		ImGui::ColorEdit3("##ambientColor", (float*)&m_lights.constants.AmbientLightColor);
 
 		ImGui::Separator();
 
-		if (m_lightConstants.NumOfDirectionalLights < MAX_LIGHTS)
+		if (ImGui::Button("Add directional light"))
 		{
-			if (ImGui::Button("Add directional light"))
-			{
-				// Reset the slot
-				m_lightConstants.DirectionalLights[m_lightConstants.NumOfDirectionalLights] = defaultDL;
-				m_lightConstants.NumOfDirectionalLights += 1;
-			}
+			m_lights.directionalLights.push_back(defaultDL);
 		}
 
-		if (m_lightConstants.NumOfPointLights < MAX_LIGHTS)
+		if (ImGui::Button("Add point light"))
 		{
-			if (ImGui::Button("Add point light"))
-			{
-				// Reset
-				m_lightConstants.PointLights[m_lightConstants.NumOfPointLights] = defaultPL;
-				m_lightConstants.NumOfPointLights += 1;
-			}
+			m_lights.pointLights.push_back(defaultPL);
 		}
 
-		if (m_lightConstants.NumOfSpotLights < MAX_LIGHTS)
+		if (ImGui::Button("Add spot light"))
 		{
-			if (ImGui::Button("Add spot light"))
-			{
-				m_lightConstants.SpotLights[m_lightConstants.NumOfSpotLights] = defaultSL;
-				m_lightConstants.NumOfSpotLights += 1;
-			}
+			m_lights.spotLights.push_back(defaultSL);
 		}
 
 		ImGui::Separator();
 
-		if (m_lightConstants.NumOfDirectionalLights > 0)
+		if (!m_lights.directionalLights.empty())
 		{
 			const static std::string dLStrengthLabel = "##dlS_";
 			const static std::string dlDirectionLabel = "##dlD_";
 			const static std::string dlColorLabel = "##dlC_";
 			const static std::string dlRemoveButtonLabel = "Remove directional light #";
-			for (uint32_t i = 0; i < m_lightConstants.NumOfDirectionalLights; i++)
+			for (uint32_t i = 0; i < m_lights.directionalLights.size(); i++)
 			{
 				ImGui::Text("Directional Light #%lu", i);
 				ImGui::Text("Strength");
-				ImGui::SliderFloat((dLStrengthLabel + std::to_string(i)).c_str(), &m_lightConstants.DirectionalLights[i].Strength, 0.0f, 10.0f, "%.3f");
+				ImGui::SliderFloat((dLStrengthLabel + std::to_string(i)).c_str(), &m_lights.directionalLights[i].Strength, 0.0f, 10.0f, "%.3f");
 				ImGui::Text("Direction");
-				ImGui::InputFloat3((dlDirectionLabel + std::to_string(i)).c_str(), (float*)&m_lightConstants.DirectionalLights[i].Direction);
+				ImGui::InputFloat3((dlDirectionLabel + std::to_string(i)).c_str(), (float*)&m_lights.directionalLights[i].Direction);
 				ImGui::Text("Color");
-				ImGui::ColorEdit3((dlColorLabel + std::to_string(i)).c_str(), (float*)&m_lightConstants.DirectionalLights[i].Color);
+				ImGui::ColorEdit3((dlColorLabel + std::to_string(i)).c_str(), (float*)&m_lights.directionalLights[i].Color);
 				if (ImGui::Button((dlRemoveButtonLabel + std::to_string(i)).c_str()))
 				{
-					// Remove light by memcpy
-					size_t bytesToMove = sizeof(DirectionalLight) * (m_lightConstants.NumOfDirectionalLights - i - 1);
-					memcpy_s(&m_lightConstants.DirectionalLights[i], bytesToMove, &m_lightConstants.DirectionalLights[i + 1], bytesToMove);
-					m_lightConstants.NumOfDirectionalLights -= 1;
+					m_lights.directionalLights.erase(m_lights.directionalLights.begin() + i);
+					break;
 				}
 				ImGui::Separator();
 			}
 		}
 
-		if (m_lightConstants.NumOfPointLights > 0)
+		if (!m_lights.pointLights.empty())
 		{
 			const static std::string pLStrengthLabel = "##plS_";
 			const static std::string plPositionLabel = "##plD_";
 			const static std::string plColorLabel = "##plC_";
 			const static std::string plFalloffLabel = "##plF_";
 			const static std::string plRemoveButtonLabel = "Remove point light #";
-			for (uint32_t i = 0; i < m_lightConstants.NumOfPointLights; i++)
+			for (uint32_t i = 0; i < m_lights.pointLights.size(); i++)
 			{
 				ImGui::Text("Point Light #%lu", i);
 				ImGui::Text("Strength");
-				ImGui::SliderFloat((pLStrengthLabel + std::to_string(i)).c_str(), &m_lightConstants.PointLights[i].Strength, 0.0f, 10.0f, "%.3f");
+				ImGui::SliderFloat((pLStrengthLabel + std::to_string(i)).c_str(), &m_lights.pointLights[i].Strength, 0.0f, 10.0f, "%.3f");
 				ImGui::Text("Position");
-				ImGui::InputFloat3((plPositionLabel + std::to_string(i)).c_str(), (float*)&m_lightConstants.PointLights[i].Position);
+				ImGui::InputFloat3((plPositionLabel + std::to_string(i)).c_str(), (float*)&m_lights.pointLights[i].Position);
 				ImGui::Text("Color");
-				ImGui::ColorEdit3((plColorLabel + std::to_string(i)).c_str(), (float*)&m_lightConstants.PointLights[i].Color);
+				ImGui::ColorEdit3((plColorLabel + std::to_string(i)).c_str(), (float*)&m_lights.pointLights[i].Color);
 				ImGui::Text("Falloff distance, start/end");
-				ImGui::InputFloat2((plFalloffLabel + std::to_string(i)).c_str(), (float*)&m_lightConstants.PointLights[i].Falloff);
+				ImGui::InputFloat2((plFalloffLabel + std::to_string(i)).c_str(), (float*)&m_lights.pointLights[i].Falloff);
 				if (ImGui::Button((plRemoveButtonLabel + std::to_string(i)).c_str()))
 				{
-					// Remove light by memcpy
-					size_t bytesToMove = sizeof(PointLight) * (m_lightConstants.NumOfPointLights - i - 1);
-					memcpy_s(&m_lightConstants.PointLights[i], bytesToMove, &m_lightConstants.PointLights[i + 1], bytesToMove);
-					m_lightConstants.NumOfPointLights -= 1;
+					m_lights.pointLights.erase(m_lights.pointLights.begin() + i);
+					break;
 				}
 				ImGui::Separator();
 			}
 		}
 
-		if (m_lightConstants.NumOfSpotLights > 0)
+		if (!m_lights.spotLights.empty())
 		{
 			const static std::string sLStrengthLabel = "##slS_";
 			const static std::string slDirectionLabel = "##slD_";
@@ -626,27 +637,25 @@ void UIManager::CreateImGuiWindowContent()
 			const static std::string slFalloffLabel = "##slF_";
 			const static std::string slSpotPowerLabel = "##slSP_";
 			const static std::string slRemoveButtonLabel = "Remove spot light #";
-			for (uint32_t i = 0; i < m_lightConstants.NumOfSpotLights; i++)
+			for (uint32_t i = 0; i < m_lights.spotLights.size(); i++)
 			{
 				ImGui::Text("Spot Light #%lu", i);
 				ImGui::Text("Strength");
-				ImGui::SliderFloat((sLStrengthLabel + std::to_string(i)).c_str(), &m_lightConstants.SpotLights[i].Strength, 0.0f, 10.0f, "%.3f");
+				ImGui::SliderFloat((sLStrengthLabel + std::to_string(i)).c_str(), &m_lights.spotLights[i].Strength, 0.0f, 10.0f, "%.3f");
 				ImGui::Text("Position");
-				ImGui::InputFloat3((slPositionLabel + std::to_string(i)).c_str(), (float*)&m_lightConstants.SpotLights[i].Position);
+				ImGui::InputFloat3((slPositionLabel + std::to_string(i)).c_str(), (float*)&m_lights.spotLights[i].Position);
 				ImGui::Text("Direction");
-				ImGui::InputFloat3((slDirectionLabel + std::to_string(i)).c_str(), (float*)&m_lightConstants.SpotLights[i].Direction);
+				ImGui::InputFloat3((slDirectionLabel + std::to_string(i)).c_str(), (float*)&m_lights.spotLights[i].Direction);
 				ImGui::Text("Falloff distance, start/end");
-				ImGui::InputFloat2((slFalloffLabel + std::to_string(i)).c_str(), (float*)&m_lightConstants.SpotLights[i].Falloff);
+				ImGui::InputFloat2((slFalloffLabel + std::to_string(i)).c_str(), (float*)&m_lights.spotLights[i].Falloff);
 				ImGui::Text("Spot power");
-				ImGui::SliderFloat((slSpotPowerLabel + std::to_string(i)).c_str(), &m_lightConstants.SpotLights[i].SpotPower, 0.0f, 1.0f, "%.3f");
+				ImGui::SliderFloat((slSpotPowerLabel + std::to_string(i)).c_str(), &m_lights.spotLights[i].SpotPower, 0.0f, 1.0f, "%.3f");
 				ImGui::Text("Color");
-				ImGui::ColorEdit3((slColorLabel + std::to_string(i)).c_str(), (float*)&m_lightConstants.SpotLights[i].Color);
+				ImGui::ColorEdit3((slColorLabel + std::to_string(i)).c_str(), (float*)&m_lights.spotLights[i].Color);
 				if (ImGui::Button((slRemoveButtonLabel + std::to_string(i)).c_str()))
 				{
-					// Remove light by memcpy
-					size_t bytesToMove = sizeof(SpotLight) * (m_lightConstants.NumOfSpotLights - i - 1);
-					memcpy_s(&m_lightConstants.SpotLights[i], bytesToMove, &m_lightConstants.SpotLights[i + 1], bytesToMove);
-					m_lightConstants.NumOfSpotLights -= 1;
+					m_lights.spotLights.erase(m_lights.spotLights.begin() + i);
+					break;
 				}
 				ImGui::Separator();
 			}
@@ -660,6 +669,10 @@ void UIManager::CreateImGuiWindowContent()
 	// show memory info
 	ImGui::Separator();
 	ImGui::Text("CPU Memory, avail: %llu MB / total: %llu MB", m_memInfo[0] >> 20, m_memInfo[1] >> 20);
+	_createMemoryStatsContent();
+	_createFramePacingContent();
+	_createProfilerContent();
+	_createSessionContent();
 
 	ImGui::End();
 
@@ -667,9 +680,56 @@ void UIManager::CreateImGuiWindowContent()
 	ImGui::Render();
 }
 
-void UIManager::Draw(ComPtr<ID3D12GraphicsCommandList2> commandList)
+void UIManager::SnapshotDrawData(ImGuiDrawSnapshot& out_snapshot)
+{
+	BEAR_PROFILE_FUNCTION();
+
+	out_snapshot.Clear();
+
+	ImDrawData* drawData_p = ImGui::GetDrawData();
+	if (drawData_p == nullptr || !drawData_p->Valid)
+	{
+		return;
+	}
+
+	// Textures are updated here rather than in RenderDrawData; the backend uploads them through
+	// its own command list, and the font atlas is only ever touched on this thread that way.
+	if (drawData_p->Textures != nullptr)
+	{
+		for (ImTextureData* texture_p : *drawData_p->Textures)
+		{
+			if (texture_p->Status != ImTextureStatus_OK)
+			{
+				ImGui_ImplDX12_UpdateTexture(texture_p);
+			}
+		}
+	}
+
+	ImDrawData& snapshot = out_snapshot.drawData;
+	snapshot.Valid = true;
+	snapshot.DisplayPos = drawData_p->DisplayPos;
+	snapshot.DisplaySize = drawData_p->DisplaySize;
+	snapshot.FramebufferScale = drawData_p->FramebufferScale;
+	snapshot.Textures = nullptr;
+
+	// the context reuses its draw lists in the next frame, keep copies
+	for (ImDrawList* drawList_p : drawData_p->CmdLists)
+	{
+		ImDrawList* copy_p = drawList_p->CloneOutput();
+		out_snapshot.ownedLists.push_back(copy_p);
+		snapshot.AddDrawList(copy_p);
+	}
+}
+
+void UIManager::Draw(ComPtr<ID3D12GraphicsCommandList2> commandList, const ImGuiDrawSnapshot& p_snapshot)
 {
-	ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), commandList.Get());
+	if (!p_snapshot.IsValid())
+	{
+		return;
+	}
+
+	// RenderDrawData does not change the data when Textures is null
+	ImGui_ImplDX12_RenderDrawData(const_cast<ImDrawData*>(&p_snapshot.drawData), commandList.Get());
 }
 
 void UIManager::StartListeningThread()
@@ -680,11 +740,21 @@ void UIManager::StartListeningThread()
 
 void UIManager::ReceiveMessage(Message* msg)
 {
+	if (!SessionRecorder::Get().OnMessage(SESSION_QUEUE_UI, *msg))
+	{
+		// a replay feeds this one from the log
+		msg->Release();
+		delete msg;
+		return;
+	}
+
 	m_messageQueue.PushMessage(msg);
 }
 
 void UIManager::_listen()
 {
+	BEAR_PROFILE_THREAD("UI listener");
+
 	while (true)
 	{
 		Message msg;
@@ -804,6 +874,417 @@ void UIManager::_processMessage(Message& msg)
 	msg.Release();
 }
 
+void UIManager::_createFramePacingContent()
+{
+	D3D12Renderer* renderer_p = Application::Get().GetRenderer();
+	if (renderer_p == nullptr || !ImGui::CollapsingHeader("Frame pacing"))
+	{
+		return;
+	}
+
+	// 1 is the old lock-step behaviour, useful to compare the idle times against
+	int framesInFlight = static_cast<int>(renderer_p->GetFramesInFlight());
+	if (ImGui::SliderInt("Frames in flight", &framesInFlight, 1, D3D12Renderer::MaxFramesInFlight))
+	{
+		renderer_p->SetFramesInFlight(static_cast<unsigned int>(framesInFlight));
+	}
+
+	FramePacingStats stats = renderer_p->GetFramePacingStats();
+	ImGui::Text("Frame: %.2f ms, with %u frames in flight", stats.frameMilliseconds, stats.framesInFlight);
+	ImGui::Text("CPU idle (waiting on GPU): %.2f ms/frame", stats.cpuWaitMilliseconds);
+	ImGui::Text("GPU idle (between frames): %.2f ms/frame", stats.gpuIdleMilliseconds);
+
+	FramePacerStats pacerStats = Application::Get().GetFramePacer()->GetStats();
+	ImGui::Text("Pacer: jitter %.3f ms, late by %.3f ms (max %.3f ms)",
+		pacerStats.jitterMilliseconds, pacerStats.latenessMilliseconds, pacerStats.maxLatenessMilliseconds);
+	ImGui::Text("CPU: %.1f%% of a core, asleep %.0f%% of the time",
+		pacerStats.cpuUtilization * 100.0, pacerStats.sleepFraction * 100.0);
+
+	// the game thread only builds packets, recording and presenting happen on the render thread
+	RenderThread* renderThread_p = Application::Get().GetRenderThread();
+	if (renderThread_p != nullptr)
+	{
+		ImGui::Text("Render thread: %llu frames, %llu packets skipped",
+			renderThread_p->GetRenderedFrames(), renderThread_p->GetDroppedPackets());
+	}
+
+	// demo simulation, runs in fixed steps regardless of the frame rate
+	FixedTimestep& simulationTimestep = Application::Get().GetSimulationTimestep();
+	int tickRate = static_cast<int>(simulationTimestep.GetTickRate());
+	if (ImGui::SliderInt("Simulation tick rate", &tickRate, 10, 240))
+	{
+		simulationTimestep.SetTickRate(static_cast<double>(tickRate));
+	}
+
+	int maxStepsPerFrame = static_cast<int>(simulationTimestep.GetMaxStepsPerFrame());
+	if (ImGui::SliderInt("Max catch-up steps", &maxStepsPerFrame, 1, 16))
+	{
+		simulationTimestep.SetMaxStepsPerFrame(static_cast<unsigned int>(maxStepsPerFrame));
+	}
+
+	ImGui::Text("Simulation: %u steps last frame, %.1f ms dropped",
+		simulationTimestep.GetLastStepCount(), simulationTimestep.GetDroppedSeconds() * 1000.0);
+	ImGui::Text("G-buffer recording: %.2f ms/frame on %u command lists", stats.firstPassRecordMilliseconds, stats.firstPassCommandLists);
+	ImGui::Text("G-buffer draws: %u instanced draws for %u instances", stats.firstPassDrawCalls, stats.firstPassInstances);
+
+	Application& application = Application::Get();
+	bool isBvhCullingEnabled = application.IsBvhCullingEnabled();
+	if (ImGui::Checkbox("Cull through the scene BVH", &isBvhCullingEnabled))
+	{
+		application.SetBvhCullingEnabled(isBvhCullingEnabled);
+	}
+
+	SceneBvhStats bvhStats = application.GetSceneBvhStats();
+	if (isBvhCullingEnabled)
+	{
+		ImGui::Text("Frustum culling: %u of %u instances visible, %.3f ms for %u nodes", bvhStats.visible, bvhStats.leaves,
+			bvhStats.cullMilliseconds, bvhStats.cullNodes);
+	}
+	else
+	{
+		FrustumCullStats cullStats = application.GetFrustumCullStats();
+		ImGui::Text("Frustum culling: %u of %u instances visible, %.3f ms on %u tasks (%s)", cullStats.visible, cullStats.tested,
+			cullStats.cullMilliseconds, cullStats.tasks, cullStats.isAvx2 ? "AVX2" : "scalar");
+	}
+	ImGui::Text("Scene BVH: height %d, %.3f ms to sync %u inserted, %u removed, %u refit", bvhStats.height,
+		bvhStats.syncMilliseconds, bvhStats.inserted, bvhStats.removed, bvhStats.refit);
+	ImGui::Text("Last pick: %u nodes, %llu rotations so far", bvhStats.pickNodes, bvhStats.rotations);
+
+	bool isOcclusionCullingEnabled = application.IsOcclusionCullingEnabled();
+	if (ImGui::Checkbox("Software occlusion culling", &isOcclusionCullingEnabled))
+	{
+		application.SetOcclusionCullingEnabled(isOcclusionCullingEnabled);
+	}
+
+	if (isOcclusionCullingEnabled && renderer_p->IsBundleCachingEnabled())
+	{
+		ImGui::TextUnformatted("Occlusion: off while G-buffer draws are cached in bundles");
+	}
+	else if (isOcclusionCullingEnabled)
+	{
+		OcclusionStats occlusionStats = application.GetOcclusionStats();
+		ImGui::Text("Occlusion: %u of %u draws culled by %u occluders (%u triangles)", occlusionStats.occluded, occlusionStats.tested,
+			occlusionStats.occluders, occlusionStats.occluderTriangles);
+		ImGui::Text("Occlusion: %.3f ms to rasterize on %u tasks (%s), %.3f ms to test", occlusionStats.rasterMilliseconds,
+			occlusionStats.tasks, occlusionStats.isAvx2 ? "AVX2" : "scalar", occlusionStats.testMilliseconds);
+	}
+
+	if (renderer_p->IsAsyncLightingEnabled())
+	{
+		ImGui::TextUnformatted("Light clusters: not binned, the tiled lighting culls the lights per tile");
+	}
+	else
+	{
+		LightClusterStats clusterStats = application.GetLightClusterStats();
+		ImGui::Text("Light clusters: %u of %u lights in the frustum, %u in clusters, at most %u in one", clusterStats.lightsInFrustum,
+			clusterStats.lights, clusterStats.indices, clusterStats.maxPerCluster);
+		ImGui::Text("Light binning: %.3f ms on %u tasks", clusterStats.binMilliseconds, clusterStats.tasks);
+	}
+
+	RenderQueueStats queueStats = renderer_p->GetRenderQueueStats();
+	ImGui::Text("Render queue: %.3f ms to sort %u draws, %u radix passes", queueStats.sortMilliseconds, queueStats.items, queueStats.radixPasses);
+	ImGui::Text("State changes: %u unsorted, %u sorted", queueStats.stateChangesUnsorted, queueStats.stateChangesSorted);
+
+	RenderGraphStats graphStats = renderer_p->GetRenderGraphStats();
+	ImGui::Text("Render graph: %u passes, %u culled", graphStats.passes, graphStats.culledPasses);
+	ImGui::Text("Barriers: %u in %u batches, %u split, %u aliasing", graphStats.barriers, graphStats.barrierBatches,
+		graphStats.splitBarriers, graphStats.aliasingBarriers);
+
+	bool isAsyncLightingEnabled = renderer_p->IsAsyncLightingEnabled();
+	if (ImGui::Checkbox("Tiled lighting on the compute queue", &isAsyncLightingEnabled))
+	{
+		renderer_p->SetAsyncLightingEnabled(isAsyncLightingEnabled);
+	}
+
+	if (isAsyncLightingEnabled)
+	{
+		// the lighting pass below is not timed then, timestamps are per queue
+		AsyncComputeStats asyncStats = renderer_p->GetAsyncComputeStats();
+		ImGui::Text("Async lighting: %llu dispatches, %llu GPU waits on the compute queue, %llu skipped", asyncStats.lightingSubmissions,
+			asyncStats.directWaits, asyncStats.skippedDirectWaits);
+	}
+
+	bool isBundleCachingEnabled = renderer_p->IsBundleCachingEnabled();
+	if (ImGui::Checkbox("Cache G-buffer draws in bundles", &isBundleCachingEnabled))
+	{
+		renderer_p->SetBundleCachingEnabled(isBundleCachingEnabled);
+	}
+
+	if (isBundleCachingEnabled)
+	{
+		BundleCacheStats bundleStats = renderer_p->GetBundleCacheStats();
+		ImGui::Text("Bundles: %u cells, %u re-recorded, %u culled", bundleStats.cellCount, bundleStats.rerecordedCells, bundleStats.culledCells);
+		ImGui::Text("Instances: %u cached, %u re-recorded, %u drawn", bundleStats.cachedInstances, bundleStats.rerecordedInstances,
+			bundleStats.drawnInstances);
+		ImGui::TextUnformatted("Whole cells are drawn, without per-instance culling or the render queue's order");
+	}
+
+	// the table below times the prepass and the G-buffer pass apart, to weigh one against the other per scene
+	bool isDepthPrepassEnabled = renderer_p->IsDepthPrepassEnabled();
+	if (ImGui::Checkbox("Depth prepass, positions only", &isDepthPrepassEnabled))
+	{
+		renderer_p->SetDepthPrepassEnabled(isDepthPrepassEnabled);
+	}
+
+	if (isDepthPrepassEnabled)
+	{
+		ImGui::Text("Depth prepass: %u instanced draws", stats.depthPrepassDrawCalls);
+	}
+
+	bool isShadowsEnabled = application.IsShadowsEnabled();
+	if (ImGui::Checkbox("Cascaded shadow maps", &isShadowsEnabled))
+	{
+		application.SetShadowsEnabled(isShadowsEnabled);
+	}
+
+	if (isShadowsEnabled)
+	{
+		ShadowCascadeStats shadowStats = application.GetShadowCascadeStats();
+		ImGui::Text("Shadow casters: %u in %u cascade pairs, %.3f ms to cull, %u cascades moved", shadowStats.casters,
+			shadowStats.casterIndices, shadowStats.cullMilliseconds, shadowStats.refitCascades);
+
+		// a cascade is drawn again only when a caster in it or the light changed
+		bool isShadowCachingEnabled = renderer_p->IsShadowCachingEnabled();
+		if (ImGui::Checkbox("Keep the cascades of static casters", &isShadowCachingEnabled))
+		{
+			renderer_p->SetShadowCachingEnabled(isShadowCachingEnabled);
+		}
+		ImGui::Text("Shadow maps: %u cascades drawn, %u kept, %u instanced draws", stats.shadowCascadesRendered,
+			stats.shadowCascadesKept, stats.shadowDrawCalls);
+	}
+
+	// GPU time from timestamps around each pass, CPU time to record the same pass
+	GpuPassStats gpuStats = renderer_p->GetGpuPassStats();
+	ImGui::Text("GPU passes, %u frames late, %llu dropped:", gpuStats.latencyFrames, gpuStats.droppedFrames);
+	if (ImGui::BeginTable("GPU passes", 3, ImGuiTableFlags_Borders))
+	{
+		ImGui::TableSetupColumn("Pass");
+		ImGui::TableSetupColumn("GPU ms");
+		ImGui::TableSetupColumn("CPU ms");
+		ImGui::TableHeadersRow();
+		for (int i = 0; i < GPU_PASS_COUNT; i++)
+		{
+			ImGui::TableNextRow();
+			ImGui::TableSetColumnIndex(0);
+			ImGui::TextUnformatted(GetGpuPassName(static_cast<GpuPass>(i)));
+			ImGui::TableSetColumnIndex(1);
+			ImGui::Text("%.3f", gpuStats.gpuMilliseconds[i]);
+			ImGui::TableSetColumnIndex(2);
+			ImGui::Text("%.3f", gpuStats.cpuMilliseconds[i]);
+		}
+		ImGui::EndTable();
+	}
+}
+
+void UIManager::_createProfilerContent()
+{
+#if defined(BEAR_PROFILE_ENABLED)
+	if (!ImGui::CollapsingHeader("CPU profiler"))
+	{
+		return;
+	}
+
+	static char tracePath[256] = "bear_trace.json";
+	static bool hasWriteFailed = false;
+	Profiler& profiler = Profiler::Get();
+
+	ImGui::InputText("Trace file", tracePath, sizeof(tracePath));
+	if (!profiler.IsCapturing())
+	{
+		if (ImGui::Button("Start capture"))
+		{
+			profiler.BeginCapture();
+		}
+	}
+	else if (ImGui::Button("Stop and save"))
+	{
+		hasWriteFailed = !profiler.EndCapture(tracePath);
+	}
+
+	// open the file in chrome://tracing or ui.perfetto.dev
+	ProfilerCaptureStats stats = profiler.GetLastCaptureStats();
+	ImGui::Text("Last capture: %.2f s, %llu zones on %u threads, %llu dropped",
+		stats.seconds, stats.events, stats.threads, stats.droppedEvents);
+	if (hasWriteFailed)
+	{
+		ImGui::Text("Could not write %s", tracePath);
+	}
+#endif
+}
+
+void UIManager::_pickInstanceUnderMouse()
+{
+	ImGuiIO& io = ImGui::GetIO();
+	if (m_mainCamRef == nullptr || io.WantCaptureMouse || !ImGui::IsMouseClicked(ImGuiMouseButton_Left) ||
+		io.DisplaySize.x <= 0.0f || io.DisplaySize.y <= 0.0f)
+	{
+		// the click went to a window, or there was none
+		return;
+	}
+
+	// from the cursor on the near plane to the cursor on the far plane
+	float ndcX = io.MousePos.x / io.DisplaySize.x * 2.0f - 1.0f;
+	float ndcY = 1.0f - io.MousePos.y / io.DisplaySize.y * 2.0f;
+	XMMATRIX invPVMatrix = m_mainCamRef->GetInvPVMatrix();
+	XMVECTOR nearPoint = XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 0.0f, 1.0f), invPVMatrix);
+	XMVECTOR farPoint = XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 1.0f, 1.0f), invPVMatrix);
+
+	// a click on empty space clears the selection
+	Instance* picked_p = Application::Get().PickInstance(nearPoint, farPoint - nearPoint);
+	selectedInstanceIndex = -1;
+	for (size_t i = 0; picked_p != nullptr && i < listOfInstances.size(); i++)
+	{
+		if (listOfInstances[i] == picked_p)
+		{
+			selectedInstanceIndex = static_cast<int>(i);
+			break;
+		}
+	}
+}
+
+void UIManager::_createSessionContent()
+{
+	if (!ImGui::CollapsingHeader("Session recording"))
+	{
+		return;
+	}
+
+	static char sessionPath[256] = "bear_session.log";
+	static bool hasFailed = false;
+	SessionRecorder& sessionRecorder = SessionRecorder::Get();
+
+	ImGui::InputText("Session file", sessionPath, sizeof(sessionPath));
+	if (sessionRecorder.IsRecording())
+	{
+		if (ImGui::Button("Stop recording"))
+		{
+			hasFailed = !sessionRecorder.StopRecording();
+		}
+		ImGui::Text("Recording, %llu KB", sessionRecorder.GetRecordedBytes() >> 10);
+		return;
+	}
+
+	if (sessionRecorder.IsReplaying())
+	{
+		if (ImGui::Button("Stop replay"))
+		{
+			sessionRecorder.StopReplay();
+		}
+	}
+	else
+	{
+		if (ImGui::Button("Record"))
+		{
+			hasFailed = !sessionRecorder.StartRecording(sessionPath);
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Replay"))
+		{
+			hasFailed = !sessionRecorder.StartReplay(sessionPath, false);
+		}
+	}
+
+	if (hasFailed)
+	{
+		ImGui::Text("Could not use %s", sessionPath);
+	}
+
+	// frame times of a finished replay are in <session file>.frames.csv
+	SessionReplayStats stats = sessionRecorder.GetReplayStats();
+	if (stats.totalFrames > 0)
+	{
+		ImGui::Text("Replay: frame %llu / %llu%s", stats.frames, stats.totalFrames, stats.isFinished ? ", finished" : "");
+		ImGui::Text("Input events: %llu, injected messages: %llu", stats.inputEvents, stats.injectedMessages);
+		ImGui::Text("Messages matched: %llu, divergent: %llu", stats.matchedMessages, stats.divergentMessages);
+		if (stats.firstDivergentFrame >= 0)
+		{
+			ImGui::Text("First divergence at frame %lld", stats.firstDivergentFrame);
+		}
+	}
+}
+
+void UIManager::_createMemoryStatsContent()
+{
+	if (!ImGui::CollapsingHeader("Memory accounting"))
+	{
+		return;
+	}
+
+	static MemoryTracker& memoryTracker = MemoryTracker::Get();
+	MemoryStats stats = memoryTracker.GetStats();
+
+	ImGui::Text("Process, working set: %llu MB, private: %llu MB", stats.processWorkingSetBytes >> 20, stats.processPrivateBytes >> 20);
+	ImGui::Text("Video memory, usage: %llu MB / budget: %llu MB", stats.videoMemoryUsageBytes >> 20, stats.videoMemoryBudgetBytes >> 20);
+
+	if (ImGui::BeginTable("MemoryCPU", 4, flags))
+	{
+		ImGui::TableSetupColumn("CPU");
+		ImGui::TableSetupColumn("KB");
+		ImGui::TableSetupColumn("Peak KB");
+		ImGui::TableSetupColumn("Allocations");
+		ImGui::TableHeadersRow();
+
+		for (int i = 0; i < MEMORY_TAG_COUNT; i++)
+		{
+			ImGui::TableNextRow();
+			ImGui::TableSetColumnIndex(0);
+			ImGui::TextUnformatted(MemoryTracker::GetTagName(static_cast<MemoryTag>(i)));
+			ImGui::TableSetColumnIndex(1);
+			ImGui::Text("%llu", stats.cpuBytes[i] >> 10);
+			ImGui::TableSetColumnIndex(2);
+			ImGui::Text("%llu", stats.cpuPeakBytes[i] >> 10);
+			ImGui::TableSetColumnIndex(3);
+			ImGui::Text("%llu", stats.cpuAllocations[i]);
+		}
+		ImGui::EndTable();
+	}
+
+	if (ImGui::BeginTable("MemoryGPU", 4, flags))
+	{
+		ImGui::TableSetupColumn("GPU");
+		ImGui::TableSetupColumn("KB");
+		ImGui::TableSetupColumn("Resources");
+		ImGui::TableSetupColumn("Saved KB");
+		ImGui::TableHeadersRow();
+
+		for (int i = 0; i < GPU_MEMORY_COUNT; i++)
+		{
+			ImGui::TableNextRow();
+			ImGui::TableSetColumnIndex(0);
+			ImGui::TextUnformatted(MemoryTracker::GetCategoryName(static_cast<GpuMemoryCategory>(i)));
+			ImGui::TableSetColumnIndex(1);
+			ImGui::Text("%llu", stats.gpuBytes[i] >> 10);
+			ImGui::TableSetColumnIndex(2);
+			ImGui::Text("%llu", stats.gpuResources[i]);
+			ImGui::TableSetColumnIndex(3);
+			ImGui::Text("%llu", stats.gpuSharedBytes[i] >> 10);
+		}
+		ImGui::EndTable();
+	}
+
+	GBufferPoolStats poolStats = GBufferPool::Get().GetStats();
+	ImGui::Text("G-buffer pool: %u targets for %u references, %llu MB saved", poolStats.targets, poolStats.references,
+		(poolStats.requestedBytes - poolStats.allocatedBytes) >> 20);
+
+	if (ImGui::Button("Dump memory stats"))
+	{
+		char timeString[32];
+		char reportFileName[256];
+		time_t now = time(nullptr);
+		tm localTime;
+		localtime_s(&localTime, &now);
+		strftime(timeString, sizeof(timeString), "%Y%m%d_%H%M%S", &localTime);
+		sprintf_s(reportFileName, 256, "memory_reports\\memory_%s.json", timeString);
+
+		CreateDirectoryA("memory_reports", nullptr); // fails harmlessly if it exists
+		if (!memoryTracker.DumpJSON(reportFileName))
+		{
+			sprintf_s(errorMessageBuffer, 256, "Failed to write memory report: %s", reportFileName);
+			errorMessage = true;
+		}
+	}
+}
+
 void UIManager::_saveMap()
 {
 	char mapFileName[256];
@@ -835,8 +1316,12 @@ void UIManager::_saveMap()
 	mapFile.write(textureData, textureNameDataSize);
 	delete[] textureData;
 
-	// write light info
-	mapFile.write(reinterpret_cast<char*>(&m_lightConstants), sizeof(LightConstants));
+	// write light info, its size first since the number of lights varies
+	std::vector<unsigned char> lightData;
+	LightManager::SerializeLights(m_lights, lightData);
+	uint32_t lightDataSize = static_cast<uint32_t>(lightData.size());
+	mapFile.write(reinterpret_cast<char*>(&lightDataSize), sizeof(uint32_t));
+	mapFile.write(reinterpret_cast<char*>(lightData.data()), lightDataSize);
 
 	// write bezier control points
 	std::vector<XMVECTOR>& controlPoints = Application::Get().GetBezierCurvePoints();
@@ -1000,23 +1485,28 @@ bool UIManager::_loadMap()
 		}
 	}
 
-	if (offset + sizeof(LightConstants) > size)
+	uint32_t lightDataSize = 0;
+	if (offset + sizeof(uint32_t) <= size)
 	{
-		std::cerr << "Map file too small to contain light constants." << std::endl;
+		lightDataSize = *(uint32_t*)(mapData + offset);
+	}
+
+	if (offset + sizeof(uint32_t) + lightDataSize > size ||
+		!LightManager::DeserializeLights((unsigned char*)mapData + offset + sizeof(uint32_t), lightDataSize, m_lights))
+	{
+		std::cerr << "Map file too small to contain lights." << std::endl;
 		delete[] mapData;
 		return false;
 	}
 	else
 	{
-		memcpy_s(&m_lightConstants, sizeof(LightConstants), mapData + offset, sizeof(LightConstants));
-
 		// send message to mesh manager for light modification
 		Message* msg = new Message();
 		msg->type = MSG_TYPE_MODIFY_LIGHT;
-		msg->SetData((unsigned char*)&m_lightConstants, sizeof(LightConstants));
+		msg->SetData((unsigned char*)mapData + offset + sizeof(uint32_t), lightDataSize);
 		MeshManager::Get().ReceiveMessage(msg);
 
-		offset += sizeof(LightConstants);
+		offset += sizeof(uint32_t) + lightDataSize;
 	}
 
 	// read bezier control points
@@ -1102,15 +1592,10 @@ void UIManager::_clampScale(float* rotation_p)
 void UIManager::SetMainCamera(Camera* cam)
 {
 	m_mainCamRef = cam;
-	m_lightConstants.CameraPosition = XMFLOAT4(0.0f, 0.0f, -10.0f, 0.0f);
-}
-
-static inline bool _checkNumOfLights(LightConstants& p_lightConstant)
-{
-	return (p_lightConstant.NumOfDirectionalLights + p_lightConstant.NumOfPointLights + p_lightConstant.NumOfSpotLights) < MAX_LIGHTS;
+	m_lights.constants.CameraPosition = XMFLOAT4(0.0f, 0.0f, -10.0f, 0.0f);
 }
 
-void UIManager::DrawD2DContent(RenderResource& currentRR, GameState p_gameState)
+void UIManager::DrawD2DContent(RenderResource& currentRR, GameState p_gameState, const std::wstring& p_overlayText)
 {
 	D2D1_SIZE_F rtSize = currentRR.d2dRenderTarget->GetSize();
 	D2D1_RECT_F textRect = D2D1::RectF(0, 0, rtSize.width, rtSize.height);
@@ -1135,12 +1620,11 @@ void UIManager::DrawD2DContent(RenderResource& currentRR, GameState p_gameState)
 	static const wchar_t pauseText[] = L"Game paused.\n\nPress PAUSE again to resume, ESC to exit.";
 
 #if defined(_DEBUG)
-	int writeSize = GenerateOverlayDebugInfo();
 	ThrowIfFailed(m_textFormat->SetTextAlignment(DWRITE_TEXT_ALIGNMENT_LEADING));
 	ThrowIfFailed(m_textFormat->SetParagraphAlignment(DWRITE_PARAGRAPH_ALIGNMENT_FAR));
 	m_d2dDeviceContext->DrawText(
-		m_debugInfoBuffer,
-		writeSize - 1,
+		p_overlayText.c_str(),
+		static_cast<UINT32>(p_overlayText.size()),
 		m_textFormat.Get(),
 		&textRect,
 		m_whiteBrush.Get()
@@ -1235,12 +1719,48 @@ void UIManager::CleanD3D11DeviceContextForResize()
 	m_d3d11DeviceContext->Flush();
 }
 
-int UIManager::GenerateOverlayDebugInfo()
+void UIManager::GenerateOverlayDebugInfo(std::wstring& out_text)
 {
-	// return value is write size
-	wchar_t formattedString[] = L"Instance number: %ld\n";
+	wchar_t formattedString[] = L"Instance number: %ld\nCPU tracked: %llu MB, GPU tracked: %llu MB\nBundled instances: %u cached, %u re-recorded\n";
 	int numOfInstances = MeshManager::Get().GetInstanceNumber_DEBUG();
-	return swprintf_s(m_debugInfoBuffer, MAX_DEBUG_INFO_LENGTH, formattedString, numOfInstances);
+
+	MemoryStats stats = MemoryTracker::Get().GetStats();
+	uint64_t cpuBytes = 0;
+	uint64_t gpuBytes = 0;
+	for (int i = 0; i < MEMORY_TAG_COUNT; i++)
+	{
+		cpuBytes += stats.cpuBytes[i];
+	}
+	for (int i = 0; i < GPU_MEMORY_COUNT; i++)
+	{
+		gpuBytes += stats.gpuBytes[i];
+	}
+
+	BundleCacheStats bundleStats;
+	D3D12Renderer* renderer_p = Application::Get().GetRenderer();
+	if (renderer_p != nullptr)
+	{
+		bundleStats = renderer_p->GetBundleCacheStats();
+	}
+
+	int writeSize = swprintf_s(m_debugInfoBuffer, MAX_DEBUG_INFO_LENGTH, formattedString, numOfInstances, cpuBytes >> 20, gpuBytes >> 20,
+		bundleStats.cachedInstances, bundleStats.rerecordedInstances);
+
+	// the ImGui pass is editor only, the overlay shows the rest
+	if (renderer_p != nullptr && writeSize > 0)
+	{
+		GpuPassStats gpuStats = renderer_p->GetGpuPassStats();
+		const GpuPass overlayPasses[] = { GPU_PASS_SHADOW_MAPS, GPU_PASS_DEPTH_PREPASS, GPU_PASS_GBUFFER, GPU_PASS_LIGHTING, GPU_PASS_OVERLAY };
+		for (GpuPass pass : overlayPasses)
+		{
+			int passSize = swprintf_s(m_debugInfoBuffer + writeSize, MAX_DEBUG_INFO_LENGTH - writeSize, L"%hs: GPU %.2f ms, CPU %.2f ms\n",
+				GetGpuPassName(pass), gpuStats.gpuMilliseconds[pass], gpuStats.cpuMilliseconds[pass]);
+			writeSize += passSize > 0 ? passSize : 0;
+		}
+	}
+
+	// without the last line break
+	out_text.assign(m_debugInfoBuffer, writeSize > 0 ? writeSize - 1 : 0);
 }
 
 void UIManager::SetHitResult(float* p_result)
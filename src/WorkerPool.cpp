@@ -0,0 +1,118 @@
+#include "WorkerPool.h"
+#include "Profiler.h"
+
+WorkerPool::WorkerPool(unsigned int p_threadCount)
+{
+	m_threads.reserve(p_threadCount);
+	for (unsigned int i = 0; i < p_threadCount; i++)
+	{
+		m_threads.emplace_back(&WorkerPool::_workerLoop, this);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isQuitting = true;
+	}
+	m_wakeCondition.notify_all();
+
+	for (std::thread& thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+unsigned int WorkerPool::GetDefaultThreadCount()
+{
+	unsigned int hardwareThreads = std::thread::hardware_concurrency();
+	return hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+}
+
+void WorkerPool::Dispatch(unsigned int p_taskCount, const std::function<void(unsigned int)>& p_task)
+{
+	if (p_taskCount == 0)
+	{
+		return;
+	}
+
+	if (p_taskCount == 1 || m_threads.empty())
+	{
+		for (unsigned int i = 0; i < p_taskCount; i++)
+		{
+			p_task(i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_generation++;
+		// workers of the last Dispatch may still be in _runTasks without the lock:
+		// everything a claimed task needs is in place before the tasks can be claimed
+		m_task_p = &p_task;
+		m_taskCount = p_taskCount;
+		m_finishedTasks = 0;
+		m_nextTask = m_generation << 32;
+	}
+	m_wakeCondition.notify_all();
+
+	_runTasks();
+
+	// workers may still be inside a task they picked up before we ran out of tasks
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [this]() { return m_finishedTasks.load() == m_taskCount.load(); });
+	m_task_p = nullptr;
+}
+
+void WorkerPool::_workerLoop()
+{
+	BEAR_PROFILE_THREAD("Worker");
+
+	uint64_t seenGeneration = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeCondition.wait(lock, [this, seenGeneration]() { return m_isQuitting || m_generation != seenGeneration; });
+
+			if (m_isQuitting)
+			{
+				return;
+			}
+
+			seenGeneration = m_generation;
+		}
+
+		_runTasks();
+	}
+}
+
+void WorkerPool::_runTasks()
+{
+	while (true)
+	{
+		// only claims a task if no other Dispatch started since the count was read
+		uint64_t nextTask = m_nextTask.load();
+		unsigned int taskIndex = static_cast<unsigned int>(nextTask & 0xFFFFFFFF);
+		if (taskIndex >= m_taskCount)
+		{
+			return;
+		}
+		if (!m_nextTask.compare_exchange_weak(nextTask, nextTask + 1))
+		{
+			continue;
+		}
+
+		(*m_task_p)(taskIndex);
+
+		if (m_finishedTasks.fetch_add(1) + 1 == m_taskCount)
+		{
+			// take the lock so the notify cannot slip in between the check and the wait in Dispatch
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_doneCondition.notify_one();
+		}
+	}
+}
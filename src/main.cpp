@@ -1,12 +1,15 @@
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 #include <Shlwapi.h>
+#include <shellapi.h>
 
 #include "Application.h"
 #include "Helpers.h"
 #include "MeshManager.h"
+#include "SessionRecorder.h"
 
 #include <dxgidebug.h>
+#include <filesystem>
 
 void ReportLiveObjects()
 {
@@ -41,6 +44,26 @@ int CALLBACK wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR lpCmdL
 
 	Application::Create(hInstance);
 
+	// --record <file> logs the session, --replay <file> plays one back and quits after its last frame
+	int argCount = 0;
+	LPWSTR* args_p = CommandLineToArgvW(GetCommandLineW(), &argCount);
+	if (args_p != nullptr)
+	{
+		for (int i = 1; i + 1 < argCount; i++)
+		{
+			std::string sessionPath = std::filesystem::path(args_p[i + 1]).string();
+			if (wcscmp(args_p[i], L"--record") == 0)
+			{
+				SessionRecorder::Get().StartRecording(sessionPath);
+			}
+			else if (wcscmp(args_p[i], L"--replay") == 0)
+			{
+				SessionRecorder::Get().StartReplay(sessionPath, true);
+			}
+		}
+		LocalFree(args_p);
+	}
+
 	retCode = Application::Get().RunWithBearWindow(L"BearWindow Editor", 1280, 720);
 
 	Application::Destroy();
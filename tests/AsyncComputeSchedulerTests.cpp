@@ -0,0 +1,308 @@
+#include "AsyncComputeScheduler.h"
+#include "MockFenceQueue.h"
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+// what a submission reads or writes, and the frame the data belongs to
+struct ResourceAccess
+{
+	std::string resource;
+	bool isWrite;
+	uint64_t frame;
+};
+
+struct Simulation
+{
+	uint64_t clock = 0;
+	MockFenceQueue directQueue{ &clock };
+	MockFenceQueue computeQueue{ &clock };
+	AsyncComputeScheduler scheduler;
+	std::mt19937 random;
+	std::map<std::string, std::vector<ResourceAccess>> accesses; // by submission name
+	bool hasPendingLighting = false;
+
+	Simulation(uint32_t p_frameSlotCount, unsigned int p_seed)
+		: scheduler(directQueue, computeQueue, p_frameSlotCount)
+		, random(p_seed)
+	{
+		directQueue.Connect(computeQueue);
+		computeQueue.Connect(directQueue);
+	}
+
+	// the GPU gets a little further on either queue
+	void StepRandomly()
+	{
+		const unsigned int steps = random() % 6;
+		for (unsigned int i = 0; i < steps; i++)
+		{
+			if (random() % 2 == 0)
+			{
+				directQueue.Step();
+			}
+			else
+			{
+				computeQueue.Step();
+			}
+		}
+	}
+};
+
+static std::string _name(const char* p_kind, uint64_t p_frame)
+{
+	return std::string(p_kind) + " " + std::to_string(p_frame);
+}
+
+// one frame in the order D3D12Renderer::Render submits it, with two G-buffer and lighting output sets;
+// a frame lit on the compute queue composites the previous frame's lighting when there is one
+static void _runFrame(Simulation& p_simulation, uint64_t p_frame, uint32_t p_frameSlotCount, bool p_isAsync, bool p_hasScene, bool p_hasResized)
+{
+	const uint32_t frameSlot = static_cast<uint32_t>(p_frame % p_frameSlotCount);
+	const std::string gBuffer = "G-buffer " + std::to_string(p_frame % 2);
+	const std::string lighting = "lighting output " + std::to_string(p_frame % 2);
+	const std::string previousLighting = "lighting output " + std::to_string(1 - p_frame % 2);
+
+	p_simulation.scheduler.WaitForFrameSlot(frameSlot);
+	p_simulation.StepRandomly();
+
+	if (p_isAsync && p_hasScene)
+	{
+		const bool isCompositingPrevious = p_simulation.hasPendingLighting && !p_hasResized;
+
+		const std::string gBufferName = _name("G-buffer", p_frame);
+		p_simulation.accesses[gBufferName] = { { gBuffer, true, p_frame } };
+		const uint64_t gBufferFence = p_simulation.directQueue.Submit(gBufferName);
+		p_simulation.StepRandomly();
+		if (isCompositingPrevious)
+		{
+			p_simulation.scheduler.QueueCompositeWait();
+		}
+
+		p_simulation.scheduler.QueueLightingWait(gBufferFence);
+		const std::string lightingName = _name("lighting", p_frame);
+		p_simulation.accesses[lightingName] = { { gBuffer, false, p_frame }, { lighting, true, p_frame } };
+		p_simulation.scheduler.OnLightingSubmitted(frameSlot, p_simulation.computeQueue.Submit(lightingName));
+		p_simulation.StepRandomly();
+		if (!isCompositingPrevious)
+		{
+			p_simulation.scheduler.QueueCompositeWait();
+		}
+
+		const std::string compositeName = _name("composite", p_frame);
+		p_simulation.accesses[compositeName] = { isCompositingPrevious ? ResourceAccess{ previousLighting, false, p_frame - 1 } :
+			ResourceAccess{ lighting, false, p_frame } };
+		p_simulation.scheduler.OnFrameSubmitted(frameSlot, p_simulation.directQueue.Submit(compositeName));
+		p_simulation.hasPendingLighting = true;
+	}
+	else
+	{
+		// lit on the direct queue, into the G-buffer set the compute queue may still read
+		p_simulation.scheduler.QueueCompositeWait();
+		const std::string name = _name("pixel lighting", p_frame);
+		p_simulation.accesses[name] = { { gBuffer, true, p_frame } };
+		p_simulation.scheduler.OnFrameSubmitted(frameSlot, p_simulation.directQueue.Submit(name));
+		p_simulation.hasPendingLighting = false;
+	}
+	p_simulation.StepRandomly();
+}
+
+// in the order the GPU completed them, every resource is written in frame order and read with the
+// data of the frame the reader expects
+static bool _hasNoHazards(const Simulation& p_simulation)
+{
+	std::vector<MockFenceQueue::Completion> completions = p_simulation.directQueue.GetCompletions();
+	completions.insert(completions.end(), p_simulation.computeQueue.GetCompletions().begin(), p_simulation.computeQueue.GetCompletions().end());
+	std::sort(completions.begin(), completions.end(), [](const MockFenceQueue::Completion& p_a, const MockFenceQueue::Completion& p_b)
+		{
+			return p_a.tick < p_b.tick;
+		});
+
+	std::map<std::string, uint64_t> writtenFrames;
+	for (const MockFenceQueue::Completion& completion : completions)
+	{
+		for (const ResourceAccess& access : p_simulation.accesses.at(completion.name))
+		{
+			auto written = writtenFrames.find(access.resource);
+			if (access.isWrite)
+			{
+				if (written != writtenFrames.end() && written->second >= access.frame)
+				{
+					return false;
+				}
+				writtenFrames[access.resource] = access.frame;
+			}
+			else if (written == writtenFrames.end() || written->second != access.frame)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// random GPU interleavings of both queues, with 1 to 3 frames in flight, switching between compute and
+// pixel lighting and resizing on the way: no hazard, no deadlock, and both queues drain
+static void TestRandomInterleavings()
+{
+	uint64_t directWaits = 0;
+	uint64_t skippedDirectWaits = 0;
+	for (unsigned int seed = 0; seed < 1000; seed++)
+	{
+		const uint32_t frameSlotCount = 1 + seed % 3;
+		Simulation simulation(frameSlotCount, seed);
+		std::mt19937 pattern(seed * 7 + 1);
+		for (uint64_t frame = 0; frame < 40; frame++)
+		{
+			const bool isAsync = pattern() % 8 != 0;
+			const bool hasScene = pattern() % 10 != 0;
+			const bool hasResized = pattern() % 15 == 0;
+			_runFrame(simulation, frame, frameSlotCount, isAsync, hasScene, hasResized);
+		}
+		simulation.scheduler.WaitForAllFrameSlots();
+
+		BEAR_CHECK(simulation.directQueue.IsIdle() && simulation.computeQueue.IsIdle());
+		BEAR_CHECK(simulation.directQueue.GetDeadlocks() == 0 && simulation.computeQueue.GetDeadlocks() == 0);
+		BEAR_CHECK(_hasNoHazards(simulation));
+		directWaits += simulation.scheduler.GetStats().directWaits;
+		skippedDirectWaits += simulation.scheduler.GetStats().skippedDirectWaits;
+	}
+	// both ways of QueueCompositeWait came up
+	BEAR_CHECK(directWaits > 0);
+	BEAR_CHECK(skippedDirectWaits > 0);
+}
+
+// the compute queue waits for the frame's G-buffer, and the direct queue for the lighting it
+// composites, which lets it run the next frame's G-buffer while the compute queue is still lighting
+static void TestCrossQueueWaitOrder()
+{
+	uint64_t clock = 0;
+	MockFenceQueue directQueue(&clock);
+	MockFenceQueue computeQueue(&clock);
+	AsyncComputeScheduler scheduler(directQueue, computeQueue, 3);
+
+	// frame 0 has no earlier lighting and composites its own, the next frames the one before
+	const uint64_t gBuffer0 = directQueue.Submit("G-buffer 0");
+	scheduler.QueueLightingWait(gBuffer0);
+	scheduler.OnLightingSubmitted(0, computeQueue.Submit("lighting 0"));
+	scheduler.QueueCompositeWait();
+	scheduler.OnFrameSubmitted(0, directQueue.Submit("composite 0"));
+	for (uint32_t frame = 1; frame < 3; frame++)
+	{
+		const uint64_t gBufferFence = directQueue.Submit(_name("G-buffer", frame));
+		scheduler.QueueCompositeWait();
+		scheduler.QueueLightingWait(gBufferFence);
+		scheduler.OnLightingSubmitted(frame, computeQueue.Submit(_name("lighting", frame)));
+		scheduler.OnFrameSubmitted(frame, directQueue.Submit(_name("composite", frame)));
+	}
+
+	// the lighting cannot start before its G-buffer
+	BEAR_CHECK(!computeQueue.Step());
+	BEAR_CHECK(computeQueue.IsBlocked());
+
+	// and frame 0's composite not before the lighting
+	directQueue.RunUntilBlocked();
+	BEAR_CHECK(directQueue.GetCompletedValue() == gBuffer0);
+	BEAR_CHECK(directQueue.IsBlocked());
+
+	computeQueue.Step();
+	computeQueue.Step();
+	BEAR_CHECK(computeQueue.GetCompletedValue() == 1);
+
+	// with lighting 1 not run, the direct queue gets through frame 2's G-buffer: the two queues overlap
+	directQueue.RunUntilBlocked();
+	BEAR_CHECK(directQueue.GetCompletions().back().name == "G-buffer 2");
+	BEAR_CHECK(!computeQueue.IsFenceComplete(2));
+
+	computeQueue.RunUntilBlocked();
+	directQueue.RunUntilBlocked();
+	BEAR_CHECK(directQueue.IsIdle() && computeQueue.IsIdle());
+
+	// every composite completed after the lighting it reads
+	const std::vector<MockFenceQueue::Completion>& direct = directQueue.GetCompletions();
+	const std::vector<MockFenceQueue::Completion>& compute = computeQueue.GetCompletions();
+	BEAR_CHECK(direct[1].name == "composite 0" && direct[1].tick > compute[0].tick);
+	BEAR_CHECK(direct[3].name == "composite 1" && direct[3].tick > compute[0].tick);
+	BEAR_CHECK(direct[5].name == "composite 2" && direct[5].tick > compute[1].tick);
+
+	// frame 1 composites lighting 0, which the direct queue waits for already
+	const AsyncComputeStats stats = scheduler.GetStats();
+	BEAR_CHECK(stats.lightingSubmissions == 3);
+	BEAR_CHECK(stats.computeWaits == 3);
+	BEAR_CHECK(stats.directWaits == 2);
+	BEAR_CHECK(directQueue.GetGpuWaits() == 2);
+}
+
+// a finished lighting needs no GPU wait, and one lighting is waited for once
+static void TestCompositeWaitSkipped()
+{
+	uint64_t clock = 0;
+	MockFenceQueue directQueue(&clock);
+	MockFenceQueue computeQueue(&clock);
+	AsyncComputeScheduler scheduler(directQueue, computeQueue, 2);
+
+	scheduler.QueueCompositeWait();
+	BEAR_CHECK(scheduler.GetStats().skippedDirectWaits == 0);
+
+	scheduler.QueueLightingWait(directQueue.Submit("G-buffer 0"));
+	scheduler.OnLightingSubmitted(0, computeQueue.Submit("lighting 0"));
+	directQueue.RunUntilBlocked();
+	computeQueue.RunUntilBlocked();
+	scheduler.QueueCompositeWait();
+	scheduler.QueueCompositeWait();
+	BEAR_CHECK(scheduler.GetStats().skippedDirectWaits == 1);
+	BEAR_CHECK(scheduler.GetStats().directWaits == 0);
+	BEAR_CHECK(directQueue.GetGpuWaits() == 0);
+}
+
+// reusing a slot waits for that slot's frame on both queues, and for nothing of the frames after it
+static void TestFrameSlotReuseWaits()
+{
+	uint64_t clock = 0;
+	MockFenceQueue directQueue(&clock);
+	MockFenceQueue computeQueue(&clock);
+	AsyncComputeScheduler scheduler(directQueue, computeQueue, 2);
+
+	// frame 0's direct work does not wait for its lighting: only the slot wait covers it
+	scheduler.QueueLightingWait(directQueue.Submit("G-buffer 0"));
+	scheduler.OnLightingSubmitted(0, computeQueue.Submit("lighting 0"));
+	scheduler.OnFrameSubmitted(0, directQueue.Submit("clear 0"));
+	directQueue.RunUntilBlocked();
+	BEAR_CHECK(directQueue.IsIdle());
+	BEAR_CHECK(!computeQueue.IsFenceComplete(1));
+
+	directQueue.Connect(computeQueue);
+	computeQueue.Connect(directQueue);
+	scheduler.WaitForFrameSlot(0);
+	BEAR_CHECK(computeQueue.IsFenceComplete(1));
+	BEAR_CHECK(computeQueue.GetCpuWaits() == 1);
+
+	// frame 1 in the other slot stays queued while slot 0 is reused
+	const uint64_t gBuffer1 = directQueue.Submit("G-buffer 1");
+	scheduler.QueueCompositeWait();
+	scheduler.QueueLightingWait(gBuffer1);
+	scheduler.OnLightingSubmitted(1, computeQueue.Submit("lighting 1"));
+	scheduler.OnFrameSubmitted(1, directQueue.Submit("composite 1"));
+
+	const uint64_t cpuWaits = directQueue.GetCpuWaits() + computeQueue.GetCpuWaits();
+	scheduler.WaitForFrameSlot(0);
+	BEAR_CHECK(directQueue.GetCpuWaits() + computeQueue.GetCpuWaits() == cpuWaits);
+	BEAR_CHECK(!directQueue.IsIdle() && !computeQueue.IsIdle());
+
+	scheduler.WaitForFrameSlot(1);
+	BEAR_CHECK(directQueue.IsIdle() && computeQueue.IsIdle());
+	BEAR_CHECK(directQueue.GetDeadlocks() == 0 && computeQueue.GetDeadlocks() == 0);
+	BEAR_CHECK(scheduler.GetStats().cpuWaits == 3);
+}
+
+int main()
+{
+	BEAR_RUN_TEST(TestRandomInterleavings);
+	BEAR_RUN_TEST(TestCrossQueueWaitOrder);
+	BEAR_RUN_TEST(TestCompositeWaitSkipped);
+	BEAR_RUN_TEST(TestFrameSlotReuseWaits);
+	return BEAR_TEST_RESULT();
+}
@@ -0,0 +1,106 @@
+#include "DynamicBvh.h"
+#include "FrustumCuller.h"
+#include "TestCheck.h"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Builds a tree of 10k to 1M boxes spread through a 1000 unit cube, then times a frustum query
+// against testing every box with FrustumCuller, a narrow frustum, moving 1% of the boxes, and
+// 1000 ray casts; prints the fastest of 10 runs.
+int main()
+{
+	const float nearZ = 0.1f;
+	const float farZ = 1000.0f;
+	const float depthScale = farZ / (farZ - nearZ);
+	const float depthBias = -nearZ * farZ / (farZ - nearZ);
+	// 90 degrees, and about 11 degrees
+	const float wideViewProjection[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, depthScale, 1.0f, 0.0f, 0.0f, depthBias, 0.0f };
+	const float narrowViewProjection[16] = { 10.0f, 0.0f, 0.0f, 0.0f, 0.0f, 10.0f, 0.0f, 0.0f, 0.0f, 0.0f, depthScale, 1.0f, 0.0f, 0.0f, depthBias, 0.0f };
+	const FrustumPlanes widePlanes = FrustumCuller::ExtractPlanes(wideViewProjection);
+	const FrustumPlanes narrowPlanes = FrustumCuller::ExtractPlanes(narrowViewProjection);
+
+	for (size_t count : { 10000, 100000, 1000000 })
+	{
+		std::mt19937 random(7);
+		std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+		std::uniform_real_distribution<float> extent(0.5f, 3.0f);
+		std::uniform_real_distribution<float> move(-1.0f, 1.0f);
+
+		std::vector<BoundingAabb> boxes(count);
+		for (BoundingAabb& box : boxes)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				box.center[axis] = position(random);
+				box.extents[axis] = extent(random);
+			}
+		}
+
+		DynamicBvh tree;
+		std::vector<int32_t> leaves(count);
+		const double buildMilliseconds = BearMeasureBestMilliseconds(1, [&]()
+			{
+				for (size_t i = 0; i < count; i++)
+				{
+					leaves[i] = tree.Insert(boxes[i], reinterpret_cast<void*>(i + 1));
+				}
+			});
+
+		FrustumCuller culler;
+		culler.Resize(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			culler.SetBounds(i, boxes[i]);
+		}
+
+		std::vector<void*> visible;
+		const double wideMilliseconds = BearMeasureBestMilliseconds(10, [&]() { tree.QueryFrustum(widePlanes, visible); });
+		const size_t wideVisible = visible.size();
+		const uint32_t wideNodes = tree.GetLastQueryNodes();
+		const double wideFlatMilliseconds = BearMeasureBestMilliseconds(10, [&]() { culler.Cull(widePlanes, nullptr); });
+		const double narrowMilliseconds = BearMeasureBestMilliseconds(10, [&]() { tree.QueryFrustum(narrowPlanes, visible); });
+		const size_t narrowVisible = visible.size();
+		const uint32_t narrowNodes = tree.GetLastQueryNodes();
+		const double narrowFlatMilliseconds = BearMeasureBestMilliseconds(10, [&]() { culler.Cull(narrowPlanes, nullptr); });
+
+		// a small step each, like objects moving between frames
+		const size_t movedCount = count / 100;
+		const double refitMilliseconds = BearMeasureBestMilliseconds(10, [&]()
+			{
+				for (size_t i = 0; i < movedCount; i++)
+				{
+					BoundingAabb& box = boxes[(i * 7919) % count];
+					box.center[0] += move(random);
+					box.center[1] += move(random);
+					tree.Refit(leaves[(i * 7919) % count], box);
+				}
+			});
+
+		std::vector<float> rays(1000 * 6);
+		for (float& value : rays)
+		{
+			value = position(random);
+		}
+		unsigned int hits = 0;
+		const double rayMilliseconds = BearMeasureBestMilliseconds(10, [&]()
+			{
+				hits = 0;
+				for (size_t ray = 0; ray < rays.size(); ray += 6)
+				{
+					// hits on the leaf boxes themselves
+					hits += tree.RayCast(&rays[ray], &rays[ray + 3], 1.0f, [](void*, float) { return 0.0f; }) < 1.0f ? 1 : 0;
+				}
+			});
+
+		std::printf("%7zu boxes: build %.1f ms, height %d\n", count, buildMilliseconds, tree.GetHeight());
+		std::printf("  wide frustum:   %6zu visible, %7u nodes, %.3f ms; every box with FrustumCuller %.3f ms\n",
+			wideVisible, wideNodes, wideMilliseconds, wideFlatMilliseconds);
+		std::printf("  narrow frustum: %6zu visible, %7u nodes, %.3f ms; every box with FrustumCuller %.3f ms\n",
+			narrowVisible, narrowNodes, narrowMilliseconds, narrowFlatMilliseconds);
+		std::printf("  refit %zu moved boxes: %.3f ms, %.0f ns each; 1000 rays: %.3f ms, %u hit\n", movedCount, refitMilliseconds,
+			refitMilliseconds * 1e6 / static_cast<double>(movedCount), rayMilliseconds, hits);
+	}
+	return 0;
+}
@@ -0,0 +1,293 @@
+#include "DynamicBvh.h"
+#include "TestCheck.h"
+#include "TestFrustum.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+struct TestObject
+{
+	BoundingAabb bounds;
+	int32_t leaf = DynamicBvh::NullNode;
+};
+
+static BoundingAabb _randomBox(std::mt19937& p_random)
+{
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> extent(0.5f, 3.0f);
+
+	BoundingAabb box;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		box.center[axis] = position(p_random);
+		box.extents[axis] = extent(p_random);
+	}
+	return box;
+}
+
+// the user data is the object's index plus one, so no object is null
+static void* _userData(size_t p_index)
+{
+	return reinterpret_cast<void*>(p_index + 1);
+}
+
+static size_t _objectIndex(void* p_userData_p)
+{
+	return reinterpret_cast<uintptr_t>(p_userData_p) - 1;
+}
+
+// the query returns each live object once, every one not outside the frustum and none that is,
+// up to boxes within rounding of a plane
+static bool _matchesBruteForce(DynamicBvh& p_tree, const std::vector<TestObject>& p_objects, const FrustumPlanes& p_planes)
+{
+	std::vector<void*> visible;
+	p_tree.QueryFrustum(p_planes, visible);
+
+	std::vector<int> timesFound(p_objects.size(), 0);
+	for (void* userData_p : visible)
+	{
+		const size_t index = _objectIndex(userData_p);
+		if (index >= p_objects.size() || p_objects[index].leaf == DynamicBvh::NullNode)
+		{
+			return false;
+		}
+		timesFound[index]++;
+	}
+
+	for (size_t i = 0; i < p_objects.size(); i++)
+	{
+		if (timesFound[i] > 1)
+		{
+			return false;
+		}
+		if (p_objects[i].leaf == DynamicBvh::NullNode)
+		{
+			continue;
+		}
+
+		const double margin = BearFrustumMargin(p_planes, p_objects[i].bounds);
+		if (std::fabs(margin) > 1e-3 && (timesFound[i] == 1) != (margin >= 0.0))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// random inserts, removes and moves, with the tree checked all the way through
+static void TestChurnKeepsInvariants()
+{
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> move(-10.0f, 10.0f);
+	const FrustumPlanes planes = FrustumCuller::ExtractPlanes(BearTestViewProjection);
+
+	DynamicBvh tree;
+	BEAR_CHECK(tree.IsValid());
+	std::vector<TestObject> objects;
+	uint32_t liveCount = 0;
+	bool isValid = true;
+	bool isMatching = true;
+	for (int step = 0; step < 100000; step++)
+	{
+		const unsigned int operation = random() % 10;
+		if (operation < 4 || liveCount == 0)
+		{
+			TestObject object;
+			object.bounds = _randomBox(random);
+			object.leaf = tree.Insert(object.bounds, _userData(objects.size()));
+			objects.push_back(object);
+			liveCount++;
+		}
+		else
+		{
+			TestObject& object = objects[random() % objects.size()];
+			if (object.leaf == DynamicBvh::NullNode)
+			{
+				continue;
+			}
+
+			if (operation < 6)
+			{
+				tree.Remove(object.leaf);
+				object.leaf = DynamicBvh::NullNode;
+				liveCount--;
+			}
+			else
+			{
+				for (int axis = 0; axis < 3; axis++)
+				{
+					object.bounds.center[axis] += move(random);
+				}
+				tree.Refit(object.leaf, object.bounds);
+			}
+		}
+
+		BEAR_CHECK(tree.GetLeafCount() == liveCount);
+		if (step % 5000 == 0)
+		{
+			isValid = isValid && tree.IsValid();
+			isMatching = isMatching && _matchesBruteForce(tree, objects, planes);
+		}
+	}
+	BEAR_CHECK(isValid && tree.IsValid());
+	BEAR_CHECK(isMatching && _matchesBruteForce(tree, objects, planes));
+	BEAR_CHECK(tree.GetNodeCount() == 2 * liveCount - 1);
+	BEAR_CHECK(tree.GetRotationCount() > 0);
+
+	// every leaf still carries its object
+	bool hasUserData = true;
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		hasUserData = hasUserData && (objects[i].leaf == DynamicBvh::NullNode || tree.GetUserData(objects[i].leaf) == _userData(i));
+	}
+	BEAR_CHECK(hasUserData);
+
+	// removing everything leaves an empty tree whose nodes are all free again
+	for (TestObject& object : objects)
+	{
+		if (object.leaf != DynamicBvh::NullNode)
+		{
+			tree.Remove(object.leaf);
+			object.leaf = DynamicBvh::NullNode;
+		}
+	}
+	BEAR_CHECK(tree.IsValid());
+	BEAR_CHECK(tree.GetLeafCount() == 0 && tree.GetNodeCount() == 0 && tree.GetHeight() == 0);
+}
+
+// inserts and removes rebalance: the height stays logarithmic even when the boxes come in sorted
+static void TestSortedInsertsStayBalanced()
+{
+	DynamicBvh tree;
+	std::vector<int32_t> leaves;
+	for (int i = 0; i < 4096; i++)
+	{
+		BoundingAabb box;
+		box.center[0] = static_cast<float>(i) * 3.0f;
+		box.extents[0] = box.extents[1] = box.extents[2] = 1.0f;
+		leaves.push_back(tree.Insert(box, _userData(i)));
+	}
+	BEAR_CHECK(tree.IsValid());
+	// an AVL tree of n leaves is at most 1.44 log2(n) tall
+	BEAR_CHECK(tree.GetHeight() <= 18);
+
+	for (size_t i = 0; i < leaves.size(); i += 2)
+	{
+		tree.Remove(leaves[i]);
+	}
+	BEAR_CHECK(tree.IsValid());
+	BEAR_CHECK(tree.GetHeight() <= 17);
+}
+
+// a leaf moved far away is found at its new place only, and refitting in place keeps the box exact
+static void TestRefitMovesLeaf()
+{
+	std::mt19937 random(3);
+	const FrustumPlanes planes = FrustumCuller::ExtractPlanes(BearTestViewProjection);
+	DynamicBvh tree;
+	std::vector<TestObject> objects(2000);
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		objects[i].bounds = _randomBox(random);
+		objects[i].bounds.center[2] = -std::fabs(objects[i].bounds.center[2]) - 10.0f; // all behind the camera
+		objects[i].leaf = tree.Insert(objects[i].bounds, _userData(i));
+	}
+
+	std::vector<void*> visible;
+	tree.QueryFrustum(planes, visible);
+	BEAR_CHECK(visible.empty());
+
+	objects[42].bounds.center[0] = 0.0f;
+	objects[42].bounds.center[1] = 0.0f;
+	objects[42].bounds.center[2] = 50.0f;
+	tree.Refit(objects[42].leaf, objects[42].bounds);
+	BEAR_CHECK(tree.IsValid());
+	tree.QueryFrustum(planes, visible);
+	BEAR_CHECK(visible.size() == 1 && visible[0] == _userData(42));
+
+	// a subtree entirely inside is taken without visiting its nodes
+	BEAR_CHECK(_matchesBruteForce(tree, objects, planes));
+	for (TestObject& object : objects)
+	{
+		object.bounds.center[2] = std::fabs(object.bounds.center[2]) * 0.2f + 20.0f;
+		object.bounds.center[0] *= 0.01f;
+		object.bounds.center[1] *= 0.01f;
+		tree.Refit(object.leaf, object.bounds);
+	}
+	BEAR_CHECK(tree.IsValid());
+	tree.QueryFrustum(planes, visible);
+	BEAR_CHECK(visible.size() == objects.size());
+	BEAR_CHECK(tree.GetLastQueryNodes() < tree.GetNodeCount() / 4);
+}
+
+// the nearest hit comes back, as found by testing every box
+static void TestRayCastMatchesBruteForce()
+{
+	std::mt19937 random(11);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	DynamicBvh tree;
+	std::vector<TestObject> objects(5000);
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		objects[i].bounds = _randomBox(random);
+		objects[i].leaf = tree.Insert(objects[i].bounds, _userData(i));
+	}
+
+	auto hitBox = [](const float* p_origin_p, const float* p_direction_p, const BoundingAabb& p_box, float p_maxT)
+		{
+			float entry = 0.0f;
+			float exit = p_maxT;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				const float inverse = 1.0f / (std::fabs(p_direction_p[axis]) < 1e-20f ? std::copysign(1e-20f, p_direction_p[axis]) : p_direction_p[axis]);
+				const float t1 = (p_box.center[axis] - p_box.extents[axis] - p_origin_p[axis]) * inverse;
+				const float t2 = (p_box.center[axis] + p_box.extents[axis] - p_origin_p[axis]) * inverse;
+				entry = std::max<float>(entry, std::min<float>(t1, t2));
+				exit = std::min<float>(exit, std::max<float>(t1, t2));
+			}
+			return entry <= exit ? entry : p_maxT;
+		};
+
+	int mismatches = 0;
+	int hits = 0;
+	for (int ray = 0; ray < 2000; ray++)
+	{
+		// half of them aimed through a box, a tenth parallel to the z slabs
+		const float origin[3] = { position(random), position(random), position(random) };
+		float direction[3] = { position(random), position(random), ray % 10 == 0 ? 0.0f : position(random) };
+		if (ray % 2 == 0)
+		{
+			const BoundingAabb& target = objects[random() % objects.size()].bounds;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				direction[axis] = (target.center[axis] - origin[axis]) * 1.5f;
+			}
+		}
+		const float nearest = tree.RayCast(origin, direction, 1.0f, [&](void* p_userData_p, float p_maxT)
+			{
+				return hitBox(origin, direction, objects[_objectIndex(p_userData_p)].bounds, p_maxT);
+			});
+
+		float expected = 1.0f;
+		for (const TestObject& object : objects)
+		{
+			expected = std::min<float>(expected, hitBox(origin, direction, object.bounds, expected));
+		}
+		mismatches += nearest != expected ? 1 : 0;
+		hits += expected < 1.0f ? 1 : 0;
+	}
+	BEAR_CHECK(mismatches == 0);
+	BEAR_CHECK(hits >= 1000);
+}
+
+int main()
+{
+	BEAR_RUN_TEST(TestChurnKeepsInvariants);
+	BEAR_RUN_TEST(TestSortedInsertsStayBalanced);
+	BEAR_RUN_TEST(TestRefitMovesLeaf);
+	BEAR_RUN_TEST(TestRayCastMatchesBruteForce);
+	return BEAR_TEST_RESULT();
+}
@@ -0,0 +1,50 @@
+#include "FrustumCuller.h"
+#include "WorkerPool.h"
+#include "TestCheck.h"
+
+#include <cstdio>
+#include <random>
+
+// Culls 10k to 1M unit boxes spread around a 90 degree frustum with the scalar and the AVX2 path,
+// on the calling thread and on the default worker pool; prints the fastest of 20 runs.
+int main()
+{
+	const float nearZ = 0.1f;
+	const float farZ = 1000.0f;
+	const float viewProjection[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, farZ / (farZ - nearZ), 1.0f,
+		0.0f, 0.0f, -nearZ * farZ / (farZ - nearZ), 0.0f };
+	const FrustumPlanes planes = FrustumCuller::ExtractPlanes(viewProjection);
+
+	WorkerPool pool(WorkerPool::GetDefaultThreadCount());
+	std::printf("%u worker threads, AVX2 %s\n", pool.GetThreadCount(), FrustumCuller::IsAvx2Supported() ? "supported" : "not supported");
+
+	for (size_t count : { 10000, 100000, 1000000 })
+	{
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+
+		FrustumCuller culler;
+		culler.Resize(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			BoundingAabb box;
+			box.center[0] = position(random);
+			box.center[1] = position(random);
+			box.center[2] = position(random);
+			box.extents[0] = box.extents[1] = box.extents[2] = 1.0f;
+			culler.SetBounds(i, box);
+		}
+
+		for (bool isAvx2Enabled : { false, true })
+		{
+			culler.SetAvx2Enabled(isAvx2Enabled);
+			const double serialMilliseconds = BearMeasureBestMilliseconds(20, [&]() { culler.Cull(planes, nullptr); });
+			const double pooledMilliseconds = BearMeasureBestMilliseconds(20, [&]() { culler.Cull(planes, &pool); });
+			const FrustumCullStats stats = culler.GetStats();
+			std::printf("%7zu boxes, %s: %6u visible; %.3f ms on 1 thread, %.3f ms on %u tasks, %.2f ns per box\n", count,
+				stats.isAvx2 ? "AVX2  " : "scalar", stats.visible, serialMilliseconds, pooledMilliseconds, stats.tasks,
+				serialMilliseconds * 1e6 / static_cast<double>(count));
+		}
+	}
+	return 0;
+}
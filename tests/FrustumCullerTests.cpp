@@ -0,0 +1,177 @@
+#include "FrustumCuller.h"
+#include "WorkerPool.h"
+#include "TestCheck.h"
+#include "TestFrustum.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+static BoundingAabb _box(float p_x, float p_y, float p_z, float p_extent)
+{
+	BoundingAabb box;
+	box.center[0] = p_x;
+	box.center[1] = p_y;
+	box.center[2] = p_z;
+	box.extents[0] = box.extents[1] = box.extents[2] = p_extent;
+	return box;
+}
+
+static std::vector<BoundingAabb> _randomBoxes(size_t p_count, unsigned int p_seed)
+{
+	std::mt19937 random(p_seed);
+	std::uniform_real_distribution<float> position(-600.0f, 600.0f);
+	std::uniform_real_distribution<float> extent(0.01f, 20.0f);
+
+	std::vector<BoundingAabb> boxes(p_count);
+	for (BoundingAabb& box : boxes)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			box.center[axis] = position(random);
+			box.extents[axis] = extent(random);
+		}
+	}
+	return boxes;
+}
+
+static void _setBoxes(FrustumCuller& p_culler, const std::vector<BoundingAabb>& p_boxes)
+{
+	p_culler.Resize(p_boxes.size());
+	for (size_t i = 0; i < p_boxes.size(); i++)
+	{
+		p_culler.SetBounds(i, p_boxes[i]);
+	}
+}
+
+static size_t _countVisible(const FrustumCuller& p_culler)
+{
+	size_t visible = 0;
+	for (size_t i = 0; i < p_culler.GetCount(); i++)
+	{
+		visible += p_culler.IsVisible(i) ? 1 : 0;
+	}
+	return visible;
+}
+
+static void TestKnownBoxes()
+{
+	const FrustumPlanes planes = FrustumCuller::ExtractPlanes(BearTestViewProjection);
+	const std::vector<BoundingAabb> boxes = {
+		_box(0.0f, 0.0f, 10.0f, 1.0f), // straight ahead
+		_box(0.0f, 0.0f, -10.0f, 1.0f), // behind the camera
+		_box(0.0f, 0.0f, 1100.0f, 1.0f), // past the far plane
+		_box(0.0f, 0.0f, 1000.5f, 1.0f), // across the far plane
+		_box(-10.5f, 0.0f, 10.0f, 1.0f), // across the left plane
+		_box(-13.0f, 0.0f, 10.0f, 1.0f), // left of it
+		_box(0.0f, 13.0f, 10.0f, 1.0f), // above the top plane
+		_box(0.0f, 0.0f, 0.0f, 5000.0f), // around the whole frustum
+		_box(-11.6f, 11.6f, 10.0f, 1.0f), // off the top left edge, but not entirely outside either plane: kept
+	};
+	const bool expected[] = { true, false, false, true, true, false, false, true, true };
+
+	FrustumCuller culler;
+	_setBoxes(culler, boxes);
+	for (bool isAvx2Enabled : { false, true })
+	{
+		culler.SetAvx2Enabled(isAvx2Enabled);
+		culler.Cull(planes, nullptr);
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			BEAR_CHECK(culler.IsVisible(i) == expected[i]);
+		}
+		BEAR_CHECK(culler.GetStats().visible == 5);
+		BEAR_CHECK(culler.GetStats().tested == boxes.size());
+	}
+}
+
+// the 8 wide path and the scalar one agree on every box, up to boxes within rounding of a plane
+// (the AVX2 path fuses its multiply-adds), over a count that leaves a scalar tail
+static void TestAvx2MatchesScalar()
+{
+	if (!FrustumCuller::IsAvx2Supported())
+	{
+		std::printf("  no AVX2 on this CPU, the scalar path runs for both\n");
+	}
+
+	const FrustumPlanes planes = FrustumCuller::ExtractPlanes(BearTestViewProjection);
+	const std::vector<BoundingAabb> boxes = _randomBoxes(100003, 11);
+	FrustumCuller culler;
+	_setBoxes(culler, boxes);
+
+	culler.SetAvx2Enabled(false);
+	culler.Cull(planes, nullptr);
+	BEAR_CHECK(!culler.GetStats().isAvx2);
+	std::vector<bool> scalarVisible(boxes.size());
+	for (size_t i = 0; i < boxes.size(); i++)
+	{
+		scalarVisible[i] = culler.IsVisible(i);
+	}
+	const unsigned int scalarCount = culler.GetStats().visible;
+
+	culler.SetAvx2Enabled(true);
+	culler.Cull(planes, nullptr);
+	BEAR_CHECK(culler.GetStats().isAvx2 == FrustumCuller::IsAvx2Supported());
+
+	size_t mismatches = 0;
+	size_t referenceMismatches = 0;
+	for (size_t i = 0; i < boxes.size(); i++)
+	{
+		const double margin = BearFrustumMargin(planes, boxes[i]);
+		const bool isOnPlane = std::fabs(margin) < 1e-3;
+		mismatches += culler.IsVisible(i) != scalarVisible[i] && !isOnPlane ? 1 : 0;
+		referenceMismatches += scalarVisible[i] != (margin >= 0.0) && !isOnPlane ? 1 : 0;
+	}
+	BEAR_CHECK(mismatches == 0);
+	BEAR_CHECK(referenceMismatches == 0);
+	BEAR_CHECK(culler.GetStats().visible == _countVisible(culler));
+	BEAR_CHECK(std::abs(static_cast<int>(culler.GetStats().visible) - static_cast<int>(scalarCount)) <= 2);
+	// neither everything nor nothing, or the comparison says little
+	BEAR_CHECK(scalarCount > boxes.size() / 20 && scalarCount < boxes.size() / 2);
+}
+
+// split across tasks, every box comes out as on one thread, including the tail of the last task
+static void TestPoolMatchesSingleThread()
+{
+	const FrustumPlanes planes = FrustumCuller::ExtractPlanes(BearTestViewProjection);
+	const std::vector<BoundingAabb> boxes = _randomBoxes(FrustumCuller::MinBoundsPerCullTask * 4 + 37, 5);
+	FrustumCuller culler;
+	_setBoxes(culler, boxes);
+
+	culler.Cull(planes, nullptr);
+	BEAR_CHECK(culler.GetStats().tasks == 1);
+	std::vector<bool> singleVisible(boxes.size());
+	for (size_t i = 0; i < boxes.size(); i++)
+	{
+		singleVisible[i] = culler.IsVisible(i);
+	}
+
+	WorkerPool pool(3);
+	culler.Cull(planes, &pool);
+	BEAR_CHECK(culler.GetStats().tasks == 4);
+	bool isSame = true;
+	for (size_t i = 0; i < boxes.size(); i++)
+	{
+		isSame = isSame && culler.IsVisible(i) == singleVisible[i];
+	}
+	BEAR_CHECK(isSame);
+	BEAR_CHECK(culler.GetStats().visible == _countVisible(culler));
+
+	// shrinking keeps the first boxes, and a count below 8 runs on the scalar tail only
+	culler.Resize(5);
+	culler.Cull(planes, &pool);
+	BEAR_CHECK(culler.GetStats().tasks == 1);
+	for (size_t i = 0; i < 5; i++)
+	{
+		BEAR_CHECK(culler.IsVisible(i) == singleVisible[i]);
+	}
+}
+
+int main()
+{
+	BEAR_RUN_TEST(TestKnownBoxes);
+	BEAR_RUN_TEST(TestAvx2MatchesScalar);
+	BEAR_RUN_TEST(TestPoolMatchesSingleThread);
+	return BEAR_TEST_RESULT();
+}
@@ -0,0 +1,166 @@
+#include "GBufferEncoding.h"
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace GBufferEncoding;
+
+static const double Pi = 3.14159265358979323846;
+
+// what EncodeNormal's comment promises for the R16G16_UNORM target
+static const double MaxErrorDegrees = 0.004;
+
+static float3 _normalize(double p_x, double p_y, double p_z)
+{
+	const double length = std::sqrt(p_x * p_x + p_y * p_y + p_z * p_z);
+	return float3(static_cast<float>(p_x / length), static_cast<float>(p_y / length), static_cast<float>(p_z / length));
+}
+
+// through the target and back, as the lighting pass reads it
+static float3 _roundTrip(const float3& p_normal, unsigned int p_bits)
+{
+	const float2 encoded = EncodeNormal(p_normal);
+	return DecodeNormal(float2(QuantizeUnorm(encoded.x, p_bits), QuantizeUnorm(encoded.y, p_bits)));
+}
+
+static double _angleDegrees(const float3& p_a, const float3& p_b)
+{
+	const double cosine = static_cast<double>(p_a.x) * p_b.x + static_cast<double>(p_a.y) * p_b.y + static_cast<double>(p_a.z) * p_b.z;
+	const double sine = std::sqrt(std::pow(static_cast<double>(p_a.y) * p_b.z - static_cast<double>(p_a.z) * p_b.y, 2.0) +
+		std::pow(static_cast<double>(p_a.z) * p_b.x - static_cast<double>(p_a.x) * p_b.z, 2.0) +
+		std::pow(static_cast<double>(p_a.x) * p_b.y - static_cast<double>(p_a.y) * p_b.x, 2.0));
+	return std::atan2(sine, cosine) * 180.0 / Pi;
+}
+
+// a Fibonacci spiral: evenly spread, and it comes as close to both poles as its density allows
+static std::vector<float3> _sphereSamples(int p_count)
+{
+	std::vector<float3> samples;
+	samples.reserve(p_count);
+	const double goldenAngle = Pi * (3.0 - std::sqrt(5.0));
+	for (int i = 0; i < p_count; i++)
+	{
+		const double z = 1.0 - (2.0 * i + 1.0) / p_count;
+		const double radius = std::sqrt(1.0 - z * z);
+		samples.push_back(_normalize(std::cos(goldenAngle * i) * radius, std::sin(goldenAngle * i) * radius, z));
+	}
+	return samples;
+}
+
+// the poles, the equator where the lower half folds over (z = 0 from either side), and the edges
+// of the folded half, |x| + |y| = 1, where the sign of x or y flips
+static std::vector<float3> _edgeSamples()
+{
+	std::vector<float3> samples = { float3(0.0f, 0.0f, 1.0f), float3(0.0f, 0.0f, -1.0f), float3(-0.0f, -0.0f, -1.0f), float3(-0.0f, 0.0f, 1.0f),
+		float3(1.0f, 0.0f, 0.0f), float3(-1.0f, 0.0f, 0.0f), float3(0.0f, 1.0f, 0.0f), float3(0.0f, -1.0f, 0.0f) };
+
+	const double offsets[] = { 0.0, 1e-7, -1e-7, 1e-5, -1e-5, 1e-3, -1e-3 };
+	for (int i = 0; i < 4096; i++)
+	{
+		const double angle = 2.0 * Pi * i / 4096;
+		for (double z : offsets)
+		{
+			samples.push_back(_normalize(std::cos(angle), std::sin(angle), z));
+			// tilted off either pole
+			samples.push_back(_normalize(std::cos(angle) * std::fabs(z), std::sin(angle) * std::fabs(z), 1.0));
+			samples.push_back(_normalize(std::cos(angle) * std::fabs(z), std::sin(angle) * std::fabs(z), -1.0));
+		}
+	}
+	for (int i = 0; i <= 4096; i++)
+	{
+		const double x = static_cast<double>(i) / 4096;
+		for (double xSign : { 1.0, -1.0 })
+		{
+			for (double ySign : { 1.0, -1.0 })
+			{
+				for (double z : { -1e-3, -0.25, -1.0, -4.0 })
+				{
+					samples.push_back(_normalize(xSign * x, ySign * (1.0 - x), z));
+				}
+			}
+		}
+	}
+	return samples;
+}
+
+static void _checkPrecision(const std::vector<float3>& p_samples)
+{
+	double maxError = 0.0;
+	double unquantizedMaxError = 0.0;
+	double maxLengthError = 0.0;
+	bool isInRange = true;
+	for (const float3& normal : p_samples)
+	{
+		const float2 encoded = EncodeNormal(normal);
+		isInRange = isInRange && encoded.x >= 0.0f && encoded.x <= 1.0f && encoded.y >= 0.0f && encoded.y <= 1.0f;
+
+		const float3 decoded = _roundTrip(normal, 16);
+		maxError = std::max<double>(maxError, _angleDegrees(normal, decoded));
+		maxLengthError = std::max<double>(maxLengthError,
+			std::fabs(std::sqrt(decoded.x * decoded.x + decoded.y * decoded.y + decoded.z * decoded.z) - 1.0));
+
+		unquantizedMaxError = std::max<double>(unquantizedMaxError, _angleDegrees(normal, DecodeNormal(encoded)));
+	}
+
+	// a NaN anywhere would make these comparisons fail
+	BEAR_CHECK(isInRange);
+	BEAR_CHECK(maxError <= MaxErrorDegrees);
+	BEAR_CHECK(unquantizedMaxError <= 0.001);
+	BEAR_CHECK(maxLengthError <= 1e-6);
+	std::printf("  %zu normals, at most %.5f degrees off\n", p_samples.size(), maxError);
+}
+
+static void TestDenseSphere()
+{
+	_checkPrecision(_sphereSamples(1000000));
+}
+
+static void TestPolesAndSeams()
+{
+	_checkPrecision(_edgeSamples());
+
+	// the poles come back exactly, whatever the sign of their zero components
+	for (const float3& pole : { float3(0.0f, 0.0f, 1.0f), float3(0.0f, 0.0f, -1.0f), float3(-0.0f, -0.0f, -1.0f) })
+	{
+		const float3 decoded = _roundTrip(pole, 16);
+		BEAR_CHECK(decoded.z == pole.z);
+		BEAR_CHECK(std::fabs(decoded.x) + std::fabs(decoded.y) < 1e-4f);
+	}
+
+	// just either side of the equator decodes on the side it was on, not folded across
+	for (int i = 0; i < 360; i++)
+	{
+		const double angle = 2.0 * Pi * i / 360;
+		BEAR_CHECK(_roundTrip(_normalize(std::cos(angle), std::sin(angle), 0.01), 16).z > 0.0f);
+		BEAR_CHECK(_roundTrip(_normalize(std::cos(angle), std::sin(angle), -0.01), 16).z < 0.0f);
+	}
+}
+
+// the error comes from the quantization: it grows as bits are dropped
+static void TestPrecisionFollowsBits()
+{
+	const std::vector<float3> samples = _sphereSamples(100000);
+	double previousError = 0.0;
+	for (unsigned int bits : { 16u, 12u, 8u })
+	{
+		double maxError = 0.0;
+		for (const float3& normal : samples)
+		{
+			maxError = std::max<double>(maxError, _angleDegrees(normal, _roundTrip(normal, bits)));
+		}
+		BEAR_CHECK(maxError > previousError);
+		previousError = maxError;
+	}
+	// 8 bits would band visibly, which is why the target has 16
+	BEAR_CHECK(previousError > 0.5);
+}
+
+int main()
+{
+	BEAR_RUN_TEST(TestDenseSphere);
+	BEAR_RUN_TEST(TestPolesAndSeams);
+	BEAR_RUN_TEST(TestPrecisionFollowsBits);
+	return BEAR_TEST_RESULT();
+}
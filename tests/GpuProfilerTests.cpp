@@ -0,0 +1,150 @@
+#include "GpuProfiler.h"
+#include "MockGpuTimestampBackend.h"
+#include "TestCheck.h"
+
+#include <memory>
+
+// the mock counts a microsecond per tick
+static const uint64_t Frequency = 1000000;
+
+static void _timePass(GpuProfiler& p_profiler, MockGpuTimestampBackend& p_backend, GpuPass p_pass, uint64_t p_ticks)
+{
+	p_profiler.BeginPass(nullptr, p_pass);
+	p_backend.AdvanceTicks(p_ticks);
+	p_profiler.EndPass(nullptr, p_pass);
+}
+
+// a pass timed inside another counts in both, the outer one keeps its own span
+static void TestNestedPasses()
+{
+	auto backend = std::make_unique<MockGpuTimestampBackend>(Frequency);
+	MockGpuTimestampBackend& mock = *backend;
+	GpuProfiler profiler(std::move(backend), 3);
+
+	for (uint64_t frame = 0; frame <= GpuProfiler::AveragingFrames; frame++)
+	{
+		profiler.BeginFrame(frame, frame);
+		profiler.BeginPass(nullptr, GPU_PASS_LIGHTING);
+		mock.AdvanceTicks(100);
+		_timePass(profiler, mock, GPU_PASS_IMGUI, 300);
+		mock.AdvanceTicks(50);
+		profiler.EndPass(nullptr, GPU_PASS_LIGHTING);
+
+		// ended without a begin: ignored, and not resolved
+		profiler.EndPass(nullptr, GPU_PASS_OVERLAY);
+		// begun without an end: not resolved either
+		profiler.BeginPass(nullptr, GPU_PASS_SHADOW_MAPS);
+		profiler.EndFrame(nullptr);
+		mock.ExecuteSubmitted();
+	}
+
+	const GpuPassStats stats = profiler.GetStats();
+	BEAR_CHECK(stats.collectedFrames == GpuProfiler::AveragingFrames);
+	BEAR_CHECK_NEAR(stats.gpuMilliseconds[GPU_PASS_LIGHTING], 0.45, 1e-9);
+	BEAR_CHECK_NEAR(stats.gpuMilliseconds[GPU_PASS_IMGUI], 0.3, 1e-9);
+	BEAR_CHECK(stats.gpuMilliseconds[GPU_PASS_OVERLAY] == 0.0);
+	BEAR_CHECK(stats.gpuMilliseconds[GPU_PASS_SHADOW_MAPS] == 0.0);
+	BEAR_CHECK(stats.cpuMilliseconds[GPU_PASS_LIGHTING] >= stats.cpuMilliseconds[GPU_PASS_IMGUI]);
+	BEAR_CHECK(mock.GetInvalidResolves() == 0);
+}
+
+// with frames still on the GPU, a frame is read back the first time it is known to be complete and
+// not before; its slot is reused by the frame p_latencyFrames later
+static void TestReadbackLatency()
+{
+	const unsigned int latencyFrames = 3;
+	const uint64_t framesInFlight = 2;
+	auto backend = std::make_unique<MockGpuTimestampBackend>(Frequency);
+	MockGpuTimestampBackend& mock = *backend;
+	GpuProfiler profiler(std::move(backend), latencyFrames);
+	BEAR_CHECK(profiler.GetStats().latencyFrames == latencyFrames);
+
+	for (uint64_t frame = 0; frame < 10; frame++)
+	{
+		const uint64_t completedFrames = frame >= framesInFlight ? frame - framesInFlight : 0;
+		const uint64_t readsBefore = mock.GetReads();
+		profiler.BeginFrame(frame, completedFrames);
+
+		// only the frame that just completed, two queries per timed pass
+		BEAR_CHECK(profiler.GetStats().collectedFrames == completedFrames);
+		BEAR_CHECK(mock.GetReads() - readsBefore == (completedFrames > 0 ? 4u : 0u));
+
+		_timePass(profiler, mock, GPU_PASS_GBUFFER, 200);
+		_timePass(profiler, mock, GPU_PASS_LIGHTING, 100);
+		profiler.EndFrame(nullptr);
+		mock.ExecuteSubmitted();
+	}
+	BEAR_CHECK(profiler.GetStats().droppedFrames == 0);
+
+	// the GPU catching up reads back every frame it finished; a frame without a timed pass has nothing to read
+	const uint64_t reads = mock.GetReads();
+	profiler.BeginFrame(10, 10);
+	BEAR_CHECK(profiler.GetStats().collectedFrames == 10);
+	BEAR_CHECK(mock.GetReads() - reads == 12);
+	profiler.EndFrame(nullptr);
+	profiler.BeginFrame(11, 11);
+	profiler.BeginFrame(12, 12);
+	BEAR_CHECK(profiler.GetStats().collectedFrames == 10);
+	BEAR_CHECK(mock.GetReads() - reads == 12);
+}
+
+// over many turns of the ring every frame's results come from its own slot: each frame takes a
+// different time, so a slot read for the wrong frame would shift the averages
+static void TestRingWraparound()
+{
+	auto backend = std::make_unique<MockGpuTimestampBackend>(Frequency);
+	MockGpuTimestampBackend& mock = *backend;
+	GpuProfiler profiler(std::move(backend), 4);
+
+	const uint64_t frameCount = GpuProfiler::AveragingFrames * 2;
+	for (uint64_t frame = 0; frame <= frameCount + 3; frame++)
+	{
+		profiler.BeginFrame(frame, frame >= 3 ? frame - 3 : 0);
+		if (frame == GpuProfiler::AveragingFrames + 3)
+		{
+			// frames [0, AveragingFrames) make up the first average: 1000 ticks and their number
+			const GpuPassStats stats = profiler.GetStats();
+			BEAR_CHECK(stats.collectedFrames == GpuProfiler::AveragingFrames);
+			BEAR_CHECK_NEAR(stats.gpuMilliseconds[GPU_PASS_GBUFFER], (1000.0 + (GpuProfiler::AveragingFrames - 1) * 0.5) / 1000.0, 1e-9);
+		}
+		_timePass(profiler, mock, GPU_PASS_GBUFFER, 1000 + frame);
+		profiler.EndFrame(nullptr);
+		mock.ExecuteSubmitted();
+	}
+
+	const GpuPassStats stats = profiler.GetStats();
+	BEAR_CHECK(stats.collectedFrames == frameCount);
+	BEAR_CHECK(stats.droppedFrames == 0);
+	BEAR_CHECK_NEAR(stats.gpuMilliseconds[GPU_PASS_GBUFFER], (1000.0 + GpuProfiler::AveragingFrames * 1.5 - 0.5) / 1000.0, 1e-9);
+	BEAR_CHECK(mock.GetInvalidResolves() == 0);
+}
+
+// a ring too short for the frames in flight gives up the frames it has to overwrite, and keeps going
+static void TestRingTooShort()
+{
+	auto backend = std::make_unique<MockGpuTimestampBackend>(Frequency);
+	MockGpuTimestampBackend& mock = *backend;
+	GpuProfiler profiler(std::move(backend), 2);
+
+	for (uint64_t frame = 0; frame < 10; frame++)
+	{
+		// three frames in flight
+		profiler.BeginFrame(frame, frame >= 3 ? frame - 3 : 0);
+		_timePass(profiler, mock, GPU_PASS_GBUFFER, 500);
+		profiler.EndFrame(nullptr);
+		mock.ExecuteSubmitted();
+	}
+
+	const GpuPassStats stats = profiler.GetStats();
+	BEAR_CHECK(stats.droppedFrames == 8);
+	BEAR_CHECK(stats.collectedFrames == 0);
+}
+
+int main()
+{
+	BEAR_RUN_TEST(TestNestedPasses);
+	BEAR_RUN_TEST(TestReadbackLatency);
+	BEAR_RUN_TEST(TestRingWraparound);
+	BEAR_RUN_TEST(TestRingTooShort);
+	return BEAR_TEST_RESULT();
+}
@@ -0,0 +1,255 @@
+#include "LightClusterer.h"
+#include "WorkerPool.h"
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// camera 10 units behind the origin, looking down +z, 16:9 with a vertical field of view of 90 degrees
+static const float View[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 10.0f, 1.0f };
+static const float TanHalfFovY = 1.0f;
+static const float TanHalfFovX = TanHalfFovY * 16.0f / 9.0f;
+static const float NearZ = 0.1f;
+static const float FarZ = 1000.0f;
+
+static std::vector<LightSphere> _randomLights(size_t p_count, unsigned int p_seed)
+{
+	std::mt19937 random(p_seed);
+	std::uniform_real_distribution<float> across(-60.0f, 60.0f);
+	std::uniform_real_distribution<float> along(-10.0f, 150.0f);
+	std::uniform_real_distribution<float> radius(0.5f, 6.0f);
+
+	std::vector<LightSphere> lights(p_count);
+	for (LightSphere& light : lights)
+	{
+		light.center[0] = across(random);
+		light.center[1] = across(random) * 0.5f;
+		light.center[2] = along(random);
+		light.radius = radius(random);
+	}
+	return lights;
+}
+
+static void _bin(LightClusterer& p_clusterer, const std::vector<LightSphere>& p_lights, WorkerPool* p_workerPool_p)
+{
+	p_clusterer.SetFrustum(View, TanHalfFovX, TanHalfFovY, NearZ, FarZ);
+	p_clusterer.Resize(p_lights.size());
+	for (size_t i = 0; i < p_lights.size(); i++)
+	{
+		p_clusterer.SetLight(i, p_lights[i]);
+	}
+	p_clusterer.Bin(p_workerPool_p);
+}
+
+// the cluster a view space point falls in, as the pixel shader finds it; -1 outside the frustum
+static int _findCluster(const LightClusterer& p_clusterer, const float* p_viewPoint)
+{
+	const float z = p_viewPoint[2];
+	if (z < NearZ || z > FarZ)
+	{
+		return -1;
+	}
+
+	const float ndcX = p_viewPoint[0] / (z * TanHalfFovX);
+	const float ndcY = p_viewPoint[1] / (z * TanHalfFovY);
+	if (std::fabs(ndcX) >= 1.0f || std::fabs(ndcY) >= 1.0f)
+	{
+		return -1;
+	}
+
+	const int x = std::min<int>(static_cast<int>((ndcX * 0.5f + 0.5f) * LightClusterer::ClustersX), LightClusterer::ClustersX - 1);
+	const int y = std::min<int>(static_cast<int>((0.5f - ndcY * 0.5f) * LightClusterer::ClustersY), LightClusterer::ClustersY - 1);
+	const int slice = std::clamp<int>(static_cast<int>(std::floor(std::log(z) * p_clusterer.GetDepthSliceScale() + p_clusterer.GetDepthSliceBias())),
+		0, LightClusterer::ClustersZ - 1);
+	return (slice * LightClusterer::ClustersY + y) * LightClusterer::ClustersX + x;
+}
+
+static bool _isInCluster(const LightClusterer& p_clusterer, int p_cluster, uint32_t p_light)
+{
+	const LightCluster& cluster = p_clusterer.GetClusters()[p_cluster];
+	const std::vector<uint32_t>& indices = p_clusterer.GetLightIndices();
+	return std::find(indices.begin() + cluster.offset, indices.begin() + cluster.offset + cluster.count, p_light) !=
+		indices.begin() + cluster.offset + cluster.count;
+}
+
+// every point a light reaches finds the light in its cluster
+static void TestBinningIsConservative()
+{
+	const std::vector<LightSphere> lights = _randomLights(2000, 7);
+	LightClusterer clusterer;
+	_bin(clusterer, lights, nullptr);
+
+	std::mt19937 random(11);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	size_t checked = 0;
+	size_t missed = 0;
+	for (uint32_t i = 0; i < lights.size(); i++)
+	{
+		for (int sample = 0; sample < 64; sample++)
+		{
+			float offset[3] = { unit(random), unit(random), unit(random) };
+			if (offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2] > 1.0f)
+			{
+				continue;
+			}
+
+			// the view matrix only moves the world by 10 along z
+			const float viewPoint[3] = { lights[i].center[0] + offset[0] * lights[i].radius,
+				lights[i].center[1] + offset[1] * lights[i].radius, lights[i].center[2] + offset[2] * lights[i].radius + 10.0f };
+			const int cluster = _findCluster(clusterer, viewPoint);
+			if (cluster < 0)
+			{
+				continue;
+			}
+
+			checked++;
+			missed += _isInCluster(clusterer, cluster, i) ? 0 : 1;
+		}
+	}
+
+	BEAR_CHECK(checked > 10000);
+	BEAR_CHECK(missed == 0);
+}
+
+// a cluster's light list is sorted, holds no light twice, and lists only lights that reach its box's slice
+static void TestClustersAreSortedAndInRange()
+{
+	const std::vector<LightSphere> lights = _randomLights(3000, 3);
+	LightClusterer clusterer;
+	_bin(clusterer, lights, nullptr);
+
+	const std::vector<LightCluster>& clusters = clusterer.GetClusters();
+	const std::vector<uint32_t>& indices = clusterer.GetLightIndices();
+	BEAR_CHECK(clusters.size() == LightClusterer::ClusterCount);
+
+	uint32_t expectedOffset = 0;
+	bool isSorted = true;
+	bool isContiguous = true;
+	for (const LightCluster& cluster : clusters)
+	{
+		isContiguous = isContiguous && cluster.offset == expectedOffset;
+		expectedOffset += cluster.count;
+		for (uint32_t j = 1; j < cluster.count; j++)
+		{
+			isSorted = isSorted && indices[cluster.offset + j - 1] < indices[cluster.offset + j];
+		}
+	}
+	BEAR_CHECK(isContiguous);
+	BEAR_CHECK(isSorted);
+	BEAR_CHECK(expectedOffset == indices.size());
+	BEAR_CHECK(clusterer.GetStats().indices == indices.size());
+
+	// a light only appears in the slices its depth range covers
+	bool isInDepthRange = true;
+	for (unsigned int slice = 0; slice < LightClusterer::ClustersZ; slice++)
+	{
+		const float sliceNear = NearZ * std::pow(FarZ / NearZ, static_cast<float>(slice) / LightClusterer::ClustersZ);
+		const float sliceFar = NearZ * std::pow(FarZ / NearZ, static_cast<float>(slice + 1) / LightClusterer::ClustersZ);
+		for (unsigned int tile = 0; tile < LightClusterer::ClustersX * LightClusterer::ClustersY; tile++)
+		{
+			const LightCluster& cluster = clusters[slice * LightClusterer::ClustersX * LightClusterer::ClustersY + tile];
+			for (uint32_t j = 0; j < cluster.count; j++)
+			{
+				const LightSphere& light = lights[indices[cluster.offset + j]];
+				const float viewZ = light.center[2] + 10.0f;
+				isInDepthRange = isInDepthRange && viewZ + light.radius >= sliceNear * 0.999f && viewZ - light.radius <= sliceFar * 1.001f;
+			}
+		}
+	}
+	BEAR_CHECK(isInDepthRange);
+}
+
+// lights behind the camera, past the far plane or beside the frustum are binned nowhere
+static void TestLightsOutsideTheFrustum()
+{
+	std::vector<LightSphere> lights(4);
+	lights[0].center[2] = -20.0f; // 10 behind the camera
+	lights[0].radius = 5.0f;
+	lights[1].center[2] = FarZ + 50.0f;
+	lights[1].radius = 10.0f;
+	lights[2].center[0] = 500.0f; // far to the right of a frustum only ~36 wide at this depth
+	lights[2].center[2] = 0.0f;
+	lights[2].radius = 2.0f;
+	lights[3].center[2] = 20.0f; // straight ahead, the only one inside
+	lights[3].radius = 1.0f;
+
+	LightClusterer clusterer;
+	_bin(clusterer, lights, nullptr);
+
+	BEAR_CHECK(clusterer.GetStats().lights == 4);
+	BEAR_CHECK(clusterer.GetStats().lightsInFrustum == 1);
+	for (uint32_t index : clusterer.GetLightIndices())
+	{
+		BEAR_CHECK(index == 3);
+	}
+	BEAR_CHECK(!clusterer.GetLightIndices().empty());
+}
+
+// the slice formula the shader uses puts the near plane into the first slice and the far plane into the last
+static void TestDepthSlices()
+{
+	LightClusterer clusterer;
+	clusterer.SetFrustum(View, TanHalfFovX, TanHalfFovY, NearZ, FarZ);
+
+	auto slice = [&](float p_z)
+		{
+			return static_cast<int>(std::floor(std::log(p_z) * clusterer.GetDepthSliceScale() + clusterer.GetDepthSliceBias()));
+		};
+
+	BEAR_CHECK(slice(NearZ * 1.0001f) == 0);
+	BEAR_CHECK(slice(FarZ * 0.9999f) == LightClusterer::ClustersZ - 1);
+	for (unsigned int i = 0; i < LightClusterer::ClustersZ; i++)
+	{
+		// the middle of every slice, in log space
+		const float z = NearZ * std::pow(FarZ / NearZ, (i + 0.5f) / LightClusterer::ClustersZ);
+		BEAR_CHECK(slice(z) == static_cast<int>(i));
+	}
+}
+
+// the result does not depend on how many threads binned it
+static void TestPoolMatchesSingleThread()
+{
+	const std::vector<LightSphere> lights = _randomLights(10000, 5);
+	WorkerPool pool(3);
+
+	LightClusterer serial;
+	LightClusterer pooled;
+	_bin(serial, lights, nullptr);
+	_bin(pooled, lights, &pool);
+
+	BEAR_CHECK(pooled.GetStats().tasks > 1);
+	BEAR_CHECK(serial.GetLightIndices() == pooled.GetLightIndices());
+	bool isSame = true;
+	for (size_t i = 0; i < LightClusterer::ClusterCount; i++)
+	{
+		isSame = isSame && serial.GetClusters()[i].offset == pooled.GetClusters()[i].offset &&
+			serial.GetClusters()[i].count == pooled.GetClusters()[i].count;
+	}
+	BEAR_CHECK(isSame);
+}
+
+static void TestNoLights()
+{
+	LightClusterer clusterer;
+	_bin(clusterer, {}, nullptr);
+
+	BEAR_CHECK(clusterer.GetLightIndices().empty());
+	BEAR_CHECK(clusterer.GetStats().maxPerCluster == 0);
+	for (const LightCluster& cluster : clusterer.GetClusters())
+	{
+		BEAR_CHECK(cluster.count == 0);
+	}
+}
+
+int main()
+{
+	BEAR_RUN_TEST(TestBinningIsConservative);
+	BEAR_RUN_TEST(TestClustersAreSortedAndInRange);
+	BEAR_RUN_TEST(TestLightsOutsideTheFrustum);
+	BEAR_RUN_TEST(TestDepthSlices);
+	BEAR_RUN_TEST(TestPoolMatchesSingleThread);
+	BEAR_RUN_TEST(TestNoLights);
+	return BEAR_TEST_RESULT();
+}
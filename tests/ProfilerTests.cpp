@@ -0,0 +1,170 @@
+#include "Profiler.h"
+#include "TestCheck.h"
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Built with BEAR_PROFILE_ENABLED. The profiler is one per process, so the tests share it;
+// each runs its own capture.
+
+static const char* TracePath = "ProfilerTests.json";
+
+static std::string _readTrace()
+{
+	std::string text;
+	FILE* file_p = std::fopen(TracePath, "r");
+	if (file_p == nullptr)
+	{
+		return text;
+	}
+	char chunk[4096];
+	size_t readBytes = 0;
+	while ((readBytes = std::fread(chunk, 1, sizeof(chunk), file_p)) > 0)
+	{
+		text.append(chunk, readBytes);
+	}
+	std::fclose(file_p);
+	return text;
+}
+
+static size_t _countOccurrences(const std::string& p_text, const std::string& p_pattern)
+{
+	size_t count = 0;
+	for (size_t position = p_text.find(p_pattern); position != std::string::npos; position = p_text.find(p_pattern, position + 1))
+	{
+		count++;
+	}
+	return count;
+}
+
+static void _recordZones(int p_count)
+{
+	for (int i = 0; i < p_count; i++)
+	{
+		BEAR_PROFILE_ZONE("repeated");
+	}
+}
+
+static void TestNestedZones()
+{
+	// zones outside a capture are not kept
+	_recordZones(10);
+
+	Profiler::Get().BeginCapture();
+	BEAR_CHECK(Profiler::Get().IsCapturing());
+	{
+		BEAR_PROFILE_ZONE("outer");
+		{
+			BEAR_PROFILE_ZONE("middle");
+			{
+				BEAR_PROFILE_ZONE("inner");
+			}
+		}
+		BEAR_PROFILE_ZONE("second");
+	}
+	BEAR_CHECK(Profiler::Get().EndCapture(TracePath));
+	BEAR_CHECK(!Profiler::Get().IsCapturing());
+
+	const ProfilerCaptureStats stats = Profiler::Get().GetLastCaptureStats();
+	BEAR_CHECK(stats.events == 4);
+	BEAR_CHECK(stats.droppedEvents == 0);
+	BEAR_CHECK(stats.threads == 1);
+
+	const std::string trace = _readTrace();
+	BEAR_CHECK(trace.find("\"name\":\"outer\",\"pid\":1,\"tid\":1,") != std::string::npos);
+	BEAR_CHECK(_countOccurrences(trace, "\"args\":{\"depth\":0}") == 1);
+	BEAR_CHECK(_countOccurrences(trace, "\"args\":{\"depth\":1}") == 2);
+	BEAR_CHECK(_countOccurrences(trace, "\"args\":{\"depth\":2}") == 1);
+	BEAR_CHECK(trace.find("repeated") == std::string::npos);
+
+	// inner closes first, so it is written first
+	BEAR_CHECK(trace.find("\"inner\"") < trace.find("\"middle\""));
+	BEAR_CHECK(trace.find("\"middle\"") < trace.find("\"outer\""));
+
+	// a capture that is not running cannot end, and an unwritable path fails
+	BEAR_CHECK(!Profiler::Get().EndCapture(TracePath));
+	Profiler::Get().BeginCapture();
+	BEAR_CHECK(!Profiler::Get().EndCapture("no/such/directory/trace.json"));
+}
+
+// the ring keeps the newest events, the overwritten ones are counted as dropped
+static void TestRingOverflow()
+{
+	const int zoneCount = Profiler::EventsPerThread + 1000;
+	Profiler::Get().BeginCapture();
+	_recordZones(zoneCount);
+	BEAR_CHECK(Profiler::Get().EndCapture(TracePath));
+
+	const ProfilerCaptureStats stats = Profiler::Get().GetLastCaptureStats();
+	BEAR_CHECK(stats.events == Profiler::EventsPerThread - Profiler::MaxLateEvents);
+	BEAR_CHECK(stats.events + stats.droppedEvents == static_cast<uint64_t>(zoneCount));
+	BEAR_CHECK(_countOccurrences(_readTrace(), "\"name\":\"repeated\"") == stats.events);
+
+	// the next capture starts empty, nothing of this one is left in the ring
+	Profiler::Get().BeginCapture();
+	_recordZones(3);
+	BEAR_CHECK(Profiler::Get().EndCapture(TracePath));
+	BEAR_CHECK(Profiler::Get().GetLastCaptureStats().events == 3);
+	BEAR_CHECK(Profiler::Get().GetLastCaptureStats().droppedEvents == 0);
+}
+
+// a zone open when its capture ends lands in the next one, starting at its beginning
+static void TestZoneAcrossCaptures()
+{
+	Profiler::Get().BeginCapture();
+	{
+		BEAR_PROFILE_ZONE("across");
+		BEAR_CHECK(Profiler::Get().EndCapture(TracePath));
+		BEAR_CHECK(Profiler::Get().GetLastCaptureStats().events == 0);
+		Profiler::Get().BeginCapture();
+	}
+	BEAR_CHECK(Profiler::Get().EndCapture(TracePath));
+	BEAR_CHECK(Profiler::Get().GetLastCaptureStats().events == 1);
+	BEAR_CHECK(_readTrace().find("\"name\":\"across\",\"pid\":1,\"tid\":1,\"ts\":0.000,") != std::string::npos);
+}
+
+static void TestThreads()
+{
+	const int threadCount = 4;
+	const char* names[threadCount] = { "Worker A", "Worker B", "Worker C", "Worker D" };
+
+	Profiler::Get().BeginCapture();
+	std::vector<std::thread> threads;
+	for (int i = 0; i < threadCount; i++)
+	{
+		threads.emplace_back([&, i]()
+			{
+				BEAR_PROFILE_THREAD(names[i]);
+				_recordZones(100 * (i + 1));
+			});
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	BEAR_CHECK(Profiler::Get().EndCapture(TracePath));
+
+	// the main thread recorded nothing this time
+	const ProfilerCaptureStats stats = Profiler::Get().GetLastCaptureStats();
+	BEAR_CHECK(stats.threads == threadCount);
+	BEAR_CHECK(stats.events == 1000);
+
+	const std::string trace = _readTrace();
+	for (const char* name : names)
+	{
+		BEAR_CHECK(trace.find("\"args\":{\"name\":\"" + std::string(name) + "\"}") != std::string::npos);
+	}
+	BEAR_CHECK(Profiler::GetTicksPerMicrosecond() > 1.0);
+}
+
+int main()
+{
+	BEAR_RUN_TEST(TestNestedZones);
+	BEAR_RUN_TEST(TestRingOverflow);
+	BEAR_RUN_TEST(TestZoneAcrossCaptures);
+	BEAR_RUN_TEST(TestThreads);
+	std::remove(TracePath);
+	return BEAR_TEST_RESULT();
+}
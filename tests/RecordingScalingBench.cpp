@@ -0,0 +1,101 @@
+#include "BatchRecording.h"
+#include "GBufferEncoding.h"
+#include "NullCommandRecorder.h"
+#include "WorkerPool.h"
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Records the G-buffer pass of 50000 to 200000 draws into NullCommandRecorders, split over lists the
+// way D3D12Renderer::_recordFirstPass does it, on 1 to N threads; prints the fastest of 10 runs.
+// The batches, the target binding and the split are the engine's, from BatchRecording.h; only
+// SetGBufferPassState, which takes an XMMATRIX, is repeated here with the same commands.
+
+template <typename T>
+static T* _fakePointer(uintptr_t p_value)
+{
+	return reinterpret_cast<T*>(p_value);
+}
+
+// SetGBufferPassState
+static void _setGBufferPassState(NullCommandRecorder& p_recorder, const GBufferPassBindings& p_bindings)
+{
+	p_recorder.SetPipelineState(p_bindings.pipelineState_p);
+	p_recorder.SetGraphicsRootSignature(p_bindings.rootSignature_p);
+	const float vpMatrix[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+	p_recorder.SetGraphicsRoot32BitConstants(2, 16, vpMatrix, 0);
+	p_recorder.SetGraphicsRootShaderResourceView(3, p_bindings.instanceData);
+}
+
+int main()
+{
+	// the renderer has one recording allocator per pool thread and one for the calling thread
+	const unsigned int maxThreadCount = WorkerPool::GetDefaultThreadCount();
+	std::printf("%u worker threads at most\n", maxThreadCount);
+
+	for (size_t drawCount : { 50000, 100000, 200000 })
+	{
+		// 64 meshes and 256 textures, in render queue order, so neighbouring draws share some state
+		std::mt19937 random(7);
+		std::vector<DrawBatch> batches(drawCount);
+		for (size_t i = 0; i < drawCount; i++)
+		{
+			const UINT mesh = static_cast<UINT>((i * 64) / drawCount);
+			DrawBatch& batch = batches[i];
+			batch.textureHandle.ptr = 0x100000 + (random() % 256) * 32;
+			batch.positionBufferView = { 0x1000000ull + mesh * 0x100000ull, 0x10000, 12 };
+			batch.attributeBufferView = { 0x8000000ull + mesh * 0x100000ull, 0x20000, 20 };
+			batch.indexBufferView = { 0x10000000ull + mesh * 0x100000ull, 0x6000, DXGI_FORMAT_R32_UINT };
+			batch.indexCount = 36 + mesh * 3;
+			batch.firstInstance = static_cast<UINT>(i);
+			batch.instanceCount = 1;
+		}
+
+		GBufferPassBindings bindings;
+		bindings.pipelineState_p = _fakePointer<ID3D12PipelineState>(0x10);
+		bindings.rootSignature_p = _fakePointer<ID3D12RootSignature>(0x20);
+		bindings.srvHeap_p = _fakePointer<ID3D12DescriptorHeap>(0x30);
+		bindings.viewport = { 0.0f, 0.0f, 1920.0f, 1080.0f, 0.0f, 1.0f };
+		bindings.scissorRect = { 0, 0, 1920, 1080 };
+		bindings.renderTargets = { 0x1000 };
+		bindings.renderTargetCount = GBufferEncoding::TargetCount;
+		bindings.depthStencil = { 0x2000 };
+		bindings.instanceData = 0x40000;
+
+		double oneThreadMilliseconds = 0.0;
+		for (unsigned int threadCount = 0; threadCount <= maxThreadCount; threadCount = threadCount == 0 ? 1 : threadCount * 2)
+		{
+			WorkerPool pool(threadCount);
+			const size_t listCount = GetRecordingListCount(drawCount, threadCount + 1);
+			const size_t chunkSize = GetRecordingChunkSize(drawCount, listCount);
+			std::vector<NullCommandRecorder> recorders(listCount);
+
+			const double milliseconds = BearMeasureBestMilliseconds(10, [&]()
+				{
+					pool.Dispatch(static_cast<unsigned int>(listCount), [&](unsigned int p_listIndex)
+						{
+							NullCommandRecorder& recorder = recorders[p_listIndex];
+							recorder.Reset();
+							const size_t firstBatch = p_listIndex * chunkSize;
+							BindGBufferTargets(recorder, bindings);
+							_setGBufferPassState(recorder, bindings);
+							RecordDrawBatches(recorder, batches, firstBatch, std::min<size_t>(firstBatch + chunkSize, drawCount));
+						});
+				});
+			oneThreadMilliseconds = threadCount == 0 ? milliseconds : oneThreadMilliseconds;
+
+			uint64_t invalidCommands = 0;
+			for (const NullCommandRecorder& recorder : recorders)
+			{
+				invalidCommands += recorder.GetStats().invalidCommands;
+			}
+			std::printf("%6zu draws on %2zu lists: %7.3f ms, %5.1f ns per draw, %.2fx the single list%s\n", drawCount, listCount,
+				milliseconds, milliseconds * 1e6 / drawCount, oneThreadMilliseconds / milliseconds, invalidCommands > 0 ? ", INVALID COMMANDS" : "");
+		}
+	}
+	return 0;
+}
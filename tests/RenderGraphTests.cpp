@@ -0,0 +1,370 @@
+#include "RenderGraph.h"
+#include "TestCheck.h"
+
+static const RenderGraphBarrier* _findBarrier(const RenderGraphBarrier* p_barriers_p, size_t p_count, uint32_t p_resource)
+{
+	for (size_t i = 0; i < p_count; i++)
+	{
+		if (p_barriers_p[i].resource == p_resource)
+		{
+			return &p_barriers_p[i];
+		}
+	}
+	return nullptr;
+}
+
+// the renderer's frame: G-buffer on its own lists, lighting, then the UI
+static void TestRendererFrame()
+{
+	RenderGraph graph;
+	for (int hasScene = 0; hasScene < 2; hasScene++)
+	{
+		graph.Reset();
+		const uint32_t albedo = graph.ImportResource("albedo", RENDER_GRAPH_STATE_NON_PIXEL_SHADER_RESOURCE, RENDER_GRAPH_STATE_NON_PIXEL_SHADER_RESOURCE, false);
+		const uint32_t depth = graph.ImportResource("depth", RENDER_GRAPH_STATE_NON_PIXEL_SHADER_RESOURCE, RENDER_GRAPH_STATE_NON_PIXEL_SHADER_RESOURCE, false);
+		const uint32_t backBuffer = graph.ImportResource("back buffer", RENDER_GRAPH_STATE_PRESENT, RENDER_GRAPH_STATE_PRESENT, true);
+
+		const uint32_t gBufferPass = graph.AddPass("G-buffer", RENDER_GRAPH_PASS_OWN_COMMAND_LISTS);
+		graph.Write(gBufferPass, albedo, RENDER_GRAPH_STATE_RENDER_TARGET);
+		graph.Write(gBufferPass, depth, RENDER_GRAPH_STATE_DEPTH_WRITE);
+		const uint32_t lightingPass = graph.AddPass("lighting");
+		if (hasScene)
+		{
+			graph.Read(lightingPass, albedo, RENDER_GRAPH_STATE_PIXEL_SHADER_RESOURCE);
+			graph.Read(lightingPass, depth, RENDER_GRAPH_STATE_PIXEL_SHADER_RESOURCE);
+		}
+		graph.Write(lightingPass, backBuffer, RENDER_GRAPH_STATE_RENDER_TARGET);
+		const uint32_t imGuiPass = graph.AddPass("ImGui");
+		graph.Write(imGuiPass, backBuffer, RENDER_GRAPH_STATE_RENDER_TARGET);
+
+		BEAR_CHECK(graph.Compile());
+		// without a scene nothing reads the G-buffer, so its pass is culled and records no barriers
+		BEAR_CHECK(graph.IsPassCulled(gBufferPass) == !hasScene);
+		BEAR_CHECK(!graph.IsPassCulled(lightingPass));
+		BEAR_CHECK(!graph.IsPassCulled(imGuiPass));
+
+		size_t count = 0;
+		graph.GetBarriersBefore(gBufferPass, count);
+		BEAR_CHECK(count == (hasScene ? 2u : 0u));
+		// the UI draws into the back buffer in the state the lighting left it in, while the G-buffer
+		// starts going back to where the caller expects it
+		const RenderGraphBarrier* barriers_p = graph.GetBarriersBefore(imGuiPass, count);
+		BEAR_CHECK(_findBarrier(barriers_p, count, backBuffer) == nullptr);
+		BEAR_CHECK(count == (hasScene ? 2u : 0u));
+		const RenderGraphBarrier* begin_p = _findBarrier(barriers_p, count, albedo);
+		BEAR_CHECK(!hasScene || (begin_p != nullptr && begin_p->split == RENDER_GRAPH_SPLIT_BEGIN));
+
+		barriers_p = graph.GetFinalBarriers(count);
+		const RenderGraphBarrier* final_p = _findBarrier(barriers_p, count, backBuffer);
+		BEAR_CHECK(final_p != nullptr && final_p->stateAfter == RENDER_GRAPH_STATE_PRESENT);
+		if (hasScene)
+		{
+			final_p = _findBarrier(barriers_p, count, albedo);
+			BEAR_CHECK(final_p != nullptr && final_p->split == RENDER_GRAPH_SPLIT_END &&
+				final_p->stateBefore == RENDER_GRAPH_STATE_PIXEL_SHADER_RESOURCE &&
+				final_p->stateAfter == RENDER_GRAPH_STATE_NON_PIXEL_SHADER_RESOURCE);
+		}
+		BEAR_CHECK(graph.GetStats().splitBarriers == (hasScene ? 2u : 0u));
+		BEAR_CHECK(graph.GetStats().barrierBatches == (hasScene ? 4u : 2u));
+	}
+}
+
+static void TestCulling()
+{
+	RenderGraph graph;
+	const uint32_t output = graph.ImportResource("output", RENDER_GRAPH_STATE_PRESENT, RENDER_GRAPH_STATE_PRESENT, true);
+	const uint32_t unread = graph.ImportResource("unread", RENDER_GRAPH_STATE_RENDER_TARGET, RENDER_GRAPH_STATE_RENDER_TARGET, false);
+	const uint32_t overwritten = graph.ImportResource("overwritten", RENDER_GRAPH_STATE_RENDER_TARGET, RENDER_GRAPH_STATE_RENDER_TARGET, true);
+	const uint32_t chained = graph.CreateTransient("chained", 256, 256);
+	const uint32_t deadChain = graph.CreateTransient("dead chain", 256, 256);
+
+	const uint32_t producer = graph.AddPass("producer");
+	graph.Write(producer, chained, RENDER_GRAPH_STATE_RENDER_TARGET);
+	const uint32_t deadProducer = graph.AddPass("dead producer");
+	graph.Write(deadProducer, deadChain, RENDER_GRAPH_STATE_RENDER_TARGET);
+	const uint32_t deadConsumer = graph.AddPass("dead consumer");
+	graph.Read(deadConsumer, deadChain, RENDER_GRAPH_STATE_PIXEL_SHADER_RESOURCE);
+	graph.Write(deadConsumer, unread, RENDER_GRAPH_STATE_RENDER_TARGET);
+	const uint32_t sideEffects = graph.AddPass("side effects", RENDER_GRAPH_PASS_SIDE_EFFECTS);
+	graph.Read(sideEffects, output, RENDER_GRAPH_STATE_COPY_SOURCE);
+	const uint32_t firstWriter = graph.AddPass("first writer");
+	graph.Write(firstWriter, overwritten, RENDER_GRAPH_STATE_RENDER_TARGET);
+	const uint32_t secondWriter = graph.AddPass("second writer");
+	graph.Write(secondWriter, overwritten, RENDER_GRAPH_STATE_RENDER_TARGET);
+	const uint32_t consumer = graph.AddPass("consumer");
+	graph.Read(consumer, chained, RENDER_GRAPH_STATE_PIXEL_SHADER_RESOURCE);
+	graph.Write(consumer, output, RENDER_GRAPH_STATE_RENDER_TARGET);
+
+	BEAR_CHECK(graph.Compile());
+	// needed through what it writes for a needed pass
+	BEAR_CHECK(!graph.IsPassCulled(producer));
+	BEAR_CHECK(!graph.IsPassCulled(consumer));
+	// a chain that ends in a resource nobody reads goes as a whole
+	BEAR_CHECK(graph.IsPassCulled(deadProducer));
+	BEAR_CHECK(graph.IsPassCulled(deadConsumer));
+	BEAR_CHECK(!graph.IsPassCulled(sideEffects));
+	// a write is not assumed to cover the whole resource, so an earlier writer stays
+	BEAR_CHECK(!graph.IsPassCulled(firstWriter));
+	BEAR_CHECK(!graph.IsPassCulled(secondWriter));
+	BEAR_CHECK(graph.GetStats().culledPasses == 2);
+	BEAR_CHECK(graph.GetStats().passes == 7);
+
+	size_t count = 0;
+	BEAR_CHECK(graph.GetBarriersBefore(deadConsumer, count) == nullptr && count == 0);
+	// a transient only the culled passes used takes no heap memory
+	BEAR_CHECK(graph.GetStats().transientBytes == 256);
+}
+
+// A writes x, B does something else, C and D read x in two states: the transition starts after A,
+// ends before C with both read states, and D needs none
+static void TestSplitBarriers()
+{
+	RenderGraph graph;
+	const uint32_t x = graph.ImportResource("x", RENDER_GRAPH_STATE_RENDER_TARGET, RENDER_GRAPH_STATE_RENDER_TARGET, false);
+	const uint32_t y = graph.ImportResource("y", RENDER_GRAPH_STATE_RENDER_TARGET, RENDER_GRAPH_STATE_RENDER_TARGET, true);
+	const uint32_t a = graph.AddPass("A");
+	const uint32_t b = graph.AddPass("B");
+	const uint32_t c = graph.AddPass("C");
+	const uint32_t d = graph.AddPass("D");
+	graph.Write(a, x, RENDER_GRAPH_STATE_RENDER_TARGET);
+	graph.Write(b, y, RENDER_GRAPH_STATE_RENDER_TARGET);
+	graph.Read(c, x, RENDER_GRAPH_STATE_PIXEL_SHADER_RESOURCE);
+	graph.Write(c, y, RENDER_GRAPH_STATE_RENDER_TARGET);
+	graph.Read(d, x, RENDER_GRAPH_STATE_NON_PIXEL_SHADER_RESOURCE);
+	graph.Write(d, y, RENDER_GRAPH_STATE_RENDER_TARGET);
+	BEAR_CHECK(graph.Compile());
+
+	const uint32_t readStates = RENDER_GRAPH_STATE_PIXEL_SHADER_RESOURCE | RENDER_GRAPH_STATE_NON_PIXEL_SHADER_RESOURCE;
+	size_t count = 0;
+	const RenderGraphBarrier* barriers_p = graph.GetBarriersBefore(b, count);
+	BEAR_CHECK(count == 1);
+	BEAR_CHECK(count == 1 && barriers_p[0].resource == x && barriers_p[0].split == RENDER_GRAPH_SPLIT_BEGIN &&
+		barriers_p[0].stateBefore == RENDER_GRAPH_STATE_RENDER_TARGET && barriers_p[0].stateAfter == readStates);
+
+	barriers_p = graph.GetBarriersBefore(c, count);
+	BEAR_CHECK(count == 1 && barriers_p[0].resource == x && barriers_p[0].split == RENDER_GRAPH_SPLIT_END &&
+		barriers_p[0].stateAfter == readStates);
+
+	graph.GetBarriersBefore(d, count);
+	BEAR_CHECK(count == 0);
+
+	// x goes back to a render target at the end, right after its last reader: nothing to split across
+	barriers_p = graph.GetFinalBarriers(count);
+	BEAR_CHECK(count == 1 && barriers_p[0].resource == x && barriers_p[0].split == RENDER_GRAPH_SPLIT_NONE);
+	BEAR_CHECK(graph.GetStats().splitBarriers == 1);
+	BEAR_CHECK(graph.GetStats().barriers == 2);
+}
+
+// a pass on lists of its own sits between the halves, so the transition is not split
+static void TestOwnCommandListsPreventSplit()
+{
+	RenderGraph graph;
+	const uint32_t x = graph.ImportResource("x", RENDER_GRAPH_STATE_RENDER_TARGET, RENDER_GRAPH_STATE_RENDER_TARGET, false);
+	const uint32_t y = graph.ImportResource("y", RENDER_GRAPH_STATE_RENDER_TARGET, RENDER_GRAPH_STATE_RENDER_TARGET, true);
+	const uint32_t a = graph.AddPass("A");
+	const uint32_t b = graph.AddPass("B", RENDER_GRAPH_PASS_OWN_COMMAND_LISTS);
+	const uint32_t c = graph.AddPass("C");
+	graph.Write(a, x, RENDER_GRAPH_STATE_RENDER_TARGET);
+	graph.Write(b, y, RENDER_GRAPH_STATE_RENDER_TARGET);
+	graph.Read(c, x, RENDER_GRAPH_STATE_PIXEL_SHADER_RESOURCE);
+	graph.Write(c, y, RENDER_GRAPH_STATE_RENDER_TARGET);
+	BEAR_CHECK(graph.Compile());
+
+	size_t count = 0;
+	graph.GetBarriersBefore(b, count);
+	BEAR_CHECK(count == 0);
+	const RenderGraphBarrier* barriers_p = graph.GetBarriersBefore(c, count);
+	BEAR_CHECK(count == 1 && barriers_p[0].split == RENDER_GRAPH_SPLIT_NONE);
+	BEAR_CHECK(graph.GetStats().splitBarriers == 0);
+}
+
+// a culled pass between writer and reader is skipped: the transition would begin and end in the same batch
+static void TestSplitSkipsCulledPasses()
+{
+	RenderGraph graph;
+	const uint32_t x = graph.ImportResource("x", RENDER_GRAPH_STATE_RENDER_TARGET, RENDER_GRAPH_STATE_RENDER_TARGET, false);
+	const uint32_t y = graph.ImportResource("y", RENDER_GRAPH_STATE_RENDER_TARGET, RENDER_GRAPH_STATE_RENDER_TARGET, true);
+	const uint32_t unread = graph.CreateTransient("unread", 64, 64);
+	const uint32_t a = graph.AddPass("A");
+	const uint32_t culled = graph.AddPass("culled", RENDER_GRAPH_PASS_OWN_COMMAND_LISTS);
+	const uint32_t c = graph.AddPass("C");
+	graph.Write(a, x, RENDER_GRAPH_STATE_RENDER_TARGET);
+	graph.Write(culled, unread, RENDER_GRAPH_STATE_RENDER_TARGET);
+	graph.Read(c, x, RENDER_GRAPH_STATE_PIXEL_SHADER_RESOURCE);
+	graph.Write(c, y, RENDER_GRAPH_STATE_RENDER_TARGET);
+	BEAR_CHECK(graph.Compile());
+
+	BEAR_CHECK(graph.IsPassCulled(culled));
+	size_t count = 0;
+	const RenderGraphBarrier* barriers_p = graph.GetBarriersBefore(c, count);
+	BEAR_CHECK(count == 1 && barriers_p[0].split == RENDER_GRAPH_SPLIT_NONE);
+	BEAR_CHECK(graph.GetStats().splitBarriers == 0);
+}
+
+// t0 lives in P0 and P1, t1 from P1 to P3, t2 in P2 and P3: t2 takes over t0's memory, t1 sits behind it
+static void TestTransientAliasing()
+{
+	RenderGraph graph;
+	const uint32_t output = graph.ImportResource("output", RENDER_GRAPH_STATE_PRESENT, RENDER_GRAPH_STATE_PRESENT, true);
+	const uint32_t t0 = graph.CreateTransient("t0", 1000, 256);
+	const uint32_t t1 = graph.CreateTransient("t1", 1000, 256);
+	const uint32_t t2 = graph.CreateTransient("t2", 500, 512);
+	const uint32_t unused = graph.CreateTransient("unused", 4096, 4096);
+
+	const uint32_t p0 = graph.AddPass("P0");
+	const uint32_t p1 = graph.AddPass("P1");
+	const uint32_t p2 = graph.AddPass("P2");
+	const uint32_t p3 = graph.AddPass("P3");
+	const uint32_t dead = graph.AddPass("dead");
+	graph.Write(p0, t0, RENDER_GRAPH_STATE_RENDER_TARGET);
+	graph.Read(p1, t0, RENDER_GRAPH_STATE_PIXEL_SHADER_RESOURCE);
+	graph.Write(p1, t1, RENDER_GRAPH_STATE_UNORDERED_ACCESS);
+	graph.Write(p2, t2, RENDER_GRAPH_STATE_RENDER_TARGET);
+	graph.Read(p2, t1, RENDER_GRAPH_STATE_NON_PIXEL_SHADER_RESOURCE);
+	graph.Read(p3, t2, RENDER_GRAPH_STATE_PIXEL_SHADER_RESOURCE);
+	graph.Read(p3, t1, RENDER_GRAPH_STATE_PIXEL_SHADER_RESOURCE);
+	graph.Write(p3, output, RENDER_GRAPH_STATE_RENDER_TARGET);
+	graph.Write(dead, unused, RENDER_GRAPH_STATE_RENDER_TARGET);
+	BEAR_CHECK(graph.Compile());
+
+	BEAR_CHECK(graph.IsPassCulled(dead));
+	BEAR_CHECK(graph.GetTransientOffset(t0) == 0);
+	BEAR_CHECK(graph.GetTransientOffset(t1) == 1024);
+	BEAR_CHECK(graph.GetTransientOffset(t2) == 0);
+
+	const RenderGraphStats stats = graph.GetStats();
+	BEAR_CHECK(stats.transientBytes == 2500);
+	BEAR_CHECK(stats.transientHeapBytes == 2024);
+	BEAR_CHECK(graph.GetTransientHeapSize() == 2024);
+	BEAR_CHECK(stats.aliasingBarriers == 1);
+
+	// t2 names the one resource it takes the memory from
+	size_t count = 0;
+	const RenderGraphBarrier* barriers_p = graph.GetBarriersBefore(p2, count);
+	bool hasAliasing = false;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (barriers_p[i].type == RENDER_GRAPH_BARRIER_ALIASING)
+		{
+			hasAliasing = barriers_p[i].resource == t2 && barriers_p[i].resourceBefore == t0;
+		}
+	}
+	BEAR_CHECK(hasAliasing);
+
+	// transients start every frame in the state of their first use, and are back in it after their last
+	BEAR_CHECK(graph.GetTransientInitialState(t0) == RENDER_GRAPH_STATE_RENDER_TARGET);
+	BEAR_CHECK(graph.GetTransientInitialState(t1) == RENDER_GRAPH_STATE_UNORDERED_ACCESS);
+	barriers_p = graph.GetBarriersBefore(p2, count);
+	const RenderGraphBarrier* t0Back_p = _findBarrier(barriers_p, count, t0);
+	BEAR_CHECK(t0Back_p != nullptr && t0Back_p->stateAfter == RENDER_GRAPH_STATE_RENDER_TARGET);
+	barriers_p = graph.GetFinalBarriers(count);
+	const RenderGraphBarrier* t1Back_p = _findBarrier(barriers_p, count, t1);
+	BEAR_CHECK(t1Back_p != nullptr && t1Back_p->stateAfter == RENDER_GRAPH_STATE_UNORDERED_ACCESS);
+}
+
+// transients whose lifetimes overlap never share memory
+static void TestOverlappingTransientsDoNotAlias()
+{
+	RenderGraph graph;
+	const uint32_t output = graph.ImportResource("output", RENDER_GRAPH_STATE_PRESENT, RENDER_GRAPH_STATE_PRESENT, true);
+	uint32_t transients[4];
+	const char* names[4] = { "a", "b", "c", "d" };
+	for (int i = 0; i < 4; i++)
+	{
+		transients[i] = graph.CreateTransient(names[i], 300 + i * 100, 256);
+	}
+
+	const uint32_t writer = graph.AddPass("writer");
+	const uint32_t reader = graph.AddPass("reader");
+	for (uint32_t transient : transients)
+	{
+		graph.Write(writer, transient, RENDER_GRAPH_STATE_RENDER_TARGET);
+		graph.Read(reader, transient, RENDER_GRAPH_STATE_PIXEL_SHADER_RESOURCE);
+	}
+	graph.Write(reader, output, RENDER_GRAPH_STATE_RENDER_TARGET);
+	BEAR_CHECK(graph.Compile());
+
+	bool isDisjoint = true;
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = i + 1; j < 4; j++)
+		{
+			const uint64_t startI = graph.GetTransientOffset(transients[i]);
+			const uint64_t startJ = graph.GetTransientOffset(transients[j]);
+			isDisjoint = isDisjoint && (startI + 300 + i * 100 <= startJ || startJ + 300 + j * 100 <= startI);
+		}
+	}
+	BEAR_CHECK(isDisjoint);
+	BEAR_CHECK(graph.GetStats().aliasingBarriers == 0);
+}
+
+static void TestCompileFailures()
+{
+	RenderGraph graph;
+
+	// a transient has no content before its first write
+	const uint32_t transient = graph.CreateTransient("t", 16, 1);
+	uint32_t output = graph.ImportResource("output", RENDER_GRAPH_STATE_PRESENT, RENDER_GRAPH_STATE_PRESENT, true);
+	uint32_t pass = graph.AddPass("reads first");
+	graph.Read(pass, transient, RENDER_GRAPH_STATE_PIXEL_SHADER_RESOURCE);
+	graph.Write(pass, output, RENDER_GRAPH_STATE_RENDER_TARGET);
+	BEAR_CHECK(!graph.Compile());
+
+	// an imported resource may be read first, it comes with its content
+	graph.Reset();
+	const uint32_t imported = graph.ImportResource("imported", RENDER_GRAPH_STATE_NON_PIXEL_SHADER_RESOURCE, RENDER_GRAPH_STATE_NON_PIXEL_SHADER_RESOURCE, false);
+	output = graph.ImportResource("output", RENDER_GRAPH_STATE_PRESENT, RENDER_GRAPH_STATE_PRESENT, true);
+	pass = graph.AddPass("reads an import");
+	graph.Read(pass, imported, RENDER_GRAPH_STATE_PIXEL_SHADER_RESOURCE);
+	graph.Write(pass, output, RENDER_GRAPH_STATE_RENDER_TARGET);
+	BEAR_CHECK(graph.Compile());
+
+	// a write excludes any other access of the same pass
+	graph.Reset();
+	output = graph.ImportResource("output", RENDER_GRAPH_STATE_PRESENT, RENDER_GRAPH_STATE_PRESENT, true);
+	pass = graph.AddPass("writes and reads");
+	graph.Write(pass, output, RENDER_GRAPH_STATE_RENDER_TARGET);
+	graph.Read(pass, output, RENDER_GRAPH_STATE_PIXEL_SHADER_RESOURCE);
+	BEAR_CHECK(!graph.Compile());
+
+	// a write in a read state, and an access without a state
+	graph.Reset();
+	output = graph.ImportResource("output", RENDER_GRAPH_STATE_PRESENT, RENDER_GRAPH_STATE_PRESENT, true);
+	pass = graph.AddPass("writes a read state");
+	graph.Write(pass, output, RENDER_GRAPH_STATE_PIXEL_SHADER_RESOURCE);
+	BEAR_CHECK(!graph.Compile());
+
+	graph.Reset();
+	output = graph.ImportResource("output", RENDER_GRAPH_STATE_PRESENT, RENDER_GRAPH_STATE_PRESENT, true);
+	pass = graph.AddPass("reads nothing");
+	graph.Read(pass, output, RENDER_GRAPH_STATE_COMMON);
+	BEAR_CHECK(!graph.Compile());
+
+	// a pass that reads twice in different states reads in both at once
+	graph.Reset();
+	output = graph.ImportResource("output", RENDER_GRAPH_STATE_PRESENT, RENDER_GRAPH_STATE_PRESENT, true);
+	const uint32_t source = graph.ImportResource("source", RENDER_GRAPH_STATE_RENDER_TARGET, RENDER_GRAPH_STATE_RENDER_TARGET, false);
+	pass = graph.AddPass("reads twice");
+	graph.Read(pass, source, RENDER_GRAPH_STATE_PIXEL_SHADER_RESOURCE);
+	graph.Read(pass, source, RENDER_GRAPH_STATE_COPY_SOURCE);
+	graph.Write(pass, output, RENDER_GRAPH_STATE_COPY_DEST);
+	BEAR_CHECK(graph.Compile());
+	size_t count = 0;
+	const RenderGraphBarrier* barriers_p = graph.GetBarriersBefore(pass, count);
+	const RenderGraphBarrier* sourceBarrier_p = _findBarrier(barriers_p, count, source);
+	BEAR_CHECK(sourceBarrier_p != nullptr &&
+		sourceBarrier_p->stateAfter == (RENDER_GRAPH_STATE_PIXEL_SHADER_RESOURCE | RENDER_GRAPH_STATE_COPY_SOURCE));
+}
+
+int main()
+{
+	BEAR_RUN_TEST(TestRendererFrame);
+	BEAR_RUN_TEST(TestCulling);
+	BEAR_RUN_TEST(TestSplitBarriers);
+	BEAR_RUN_TEST(TestOwnCommandListsPreventSplit);
+	BEAR_RUN_TEST(TestSplitSkipsCulledPasses);
+	BEAR_RUN_TEST(TestTransientAliasing);
+	BEAR_RUN_TEST(TestOverlappingTransientsDoNotAlias);
+	BEAR_RUN_TEST(TestCompileFailures);
+	return BEAR_TEST_RESULT();
+}
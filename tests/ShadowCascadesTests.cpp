@@ -0,0 +1,432 @@
+#include "ShadowCascades.h"
+#include "WorkerPool.h"
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// 45 degrees vertically at 16:9, depth 0.1 to 1000
+static const float TanHalfFovY = 0.41421356f;
+static const float TanHalfFovX = TanHalfFovY * 16.0f / 9.0f;
+static const float NearZ = 0.1f;
+static const float FarZ = 1000.0f;
+static const float LightDirection[3] = { 0.4f, -1.0f, 0.3f };
+
+// world to view for an eye looking along the unit vector p_forward_p, y up; row vectors
+static void _lookTo(const float* p_eye_p, const float* p_forward_p, float* out_view_p)
+{
+	const float up[3] = { 0.0f, 1.0f, 0.0f };
+	float right[3] = { up[1] * p_forward_p[2] - up[2] * p_forward_p[1], up[2] * p_forward_p[0] - up[0] * p_forward_p[2],
+		up[0] * p_forward_p[1] - up[1] * p_forward_p[0] };
+	const float length = std::sqrt(right[0] * right[0] + right[1] * right[1] + right[2] * right[2]);
+	for (float& value : right)
+	{
+		value /= length;
+	}
+	const float viewUp[3] = { p_forward_p[1] * right[2] - p_forward_p[2] * right[1], p_forward_p[2] * right[0] - p_forward_p[0] * right[2],
+		p_forward_p[0] * right[1] - p_forward_p[1] * right[0] };
+
+	for (int j = 0; j < 3; j++)
+	{
+		out_view_p[j * 4] = right[j];
+		out_view_p[j * 4 + 1] = viewUp[j];
+		out_view_p[j * 4 + 2] = p_forward_p[j];
+		out_view_p[j * 4 + 3] = 0.0f;
+	}
+	out_view_p[12] = -(right[0] * p_eye_p[0] + right[1] * p_eye_p[1] + right[2] * p_eye_p[2]);
+	out_view_p[13] = -(viewUp[0] * p_eye_p[0] + viewUp[1] * p_eye_p[1] + viewUp[2] * p_eye_p[2]);
+	out_view_p[14] = -(p_forward_p[0] * p_eye_p[0] + p_forward_p[1] * p_eye_p[1] + p_forward_p[2] * p_eye_p[2]);
+	out_view_p[15] = 1.0f;
+}
+
+// the world position of the view space point, for a view built by _lookTo
+static void _viewToWorld(const float* p_view_p, const float* p_eye_p, float p_x, float p_y, float p_z, float* out_world_p)
+{
+	for (int j = 0; j < 3; j++)
+	{
+		out_world_p[j] = p_eye_p[j] + p_view_p[j * 4] * p_x + p_view_p[j * 4 + 1] * p_y + p_view_p[j * 4 + 2] * p_z;
+	}
+}
+
+static void _transform(const float* p_matrix_p, const float* p_point_p, float* out_clip_p)
+{
+	for (int column = 0; column < 4; column++)
+	{
+		out_clip_p[column] = p_point_p[0] * p_matrix_p[column] + p_point_p[1] * p_matrix_p[4 + column] +
+			p_point_p[2] * p_matrix_p[8 + column] + p_matrix_p[12 + column];
+	}
+}
+
+static void _setUp(ShadowCascades& p_cascades, const float* p_eye_p, const float* p_forward_p)
+{
+	float view[16];
+	_lookTo(p_eye_p, p_forward_p, view);
+	p_cascades.SetCamera(view, TanHalfFovX, TanHalfFovY, NearZ, FarZ);
+	p_cascades.SetLightDirection(LightDirection);
+	p_cascades.Fit();
+}
+
+static void TestSplitDistribution()
+{
+	const float eye[3] = { 0.0f, 2.0f, 0.0f };
+	const float forward[3] = { 0.0f, 0.0f, 1.0f };
+
+	// uniform, logarithmic, and the practical blend of both in between
+	const float distance = 200.0f;
+	for (float lambda : { 0.0f, 1.0f, 0.9f, 0.5f })
+	{
+		ShadowCascades cascades;
+		cascades.SetShadowDistance(distance, lambda);
+		_setUp(cascades, eye, forward);
+
+		float previous = NearZ;
+		for (unsigned int cascade = 0; cascade < ShadowCascades::CascadeCount; cascade++)
+		{
+			const float t = static_cast<float>(cascade + 1) / ShadowCascades::CascadeCount;
+			const float uniform = NearZ + (distance - NearZ) * t;
+			const float logarithmic = NearZ * std::pow(distance / NearZ, t);
+			const float split = cascades.GetCascade(cascade).splitDepth;
+			BEAR_CHECK_NEAR(split, lambda * logarithmic + (1.0f - lambda) * uniform, 1e-3 * split);
+			BEAR_CHECK(split > previous);
+
+			// the map covers the slice's sphere: it grows with the slice, at a fixed texel count
+			BEAR_CHECK(cascades.GetCascade(cascade).texelSize > 0.0f);
+			BEAR_CHECK(cascade == 0 || cascades.GetCascade(cascade).texelSize >= cascades.GetCascade(cascade - 1).texelSize);
+			previous = split;
+		}
+		BEAR_CHECK(cascades.GetCascade(ShadowCascades::CascadeCount - 1).splitDepth == distance);
+	}
+
+	// shadows end at the camera's far plane when that is closer
+	ShadowCascades cascades;
+	cascades.SetShadowDistance(FarZ * 2.0f);
+	_setUp(cascades, eye, forward);
+	BEAR_CHECK(cascades.GetCascade(ShadowCascades::CascadeCount - 1).splitDepth == FarZ);
+}
+
+// Walks the camera through the world without turning: a static point keeps its position within its
+// texel in every cascade, a map only moves when the slice leaves its margin, and the map covers the slice.
+static void TestTexelSnappingUnderTranslation()
+{
+	ShadowCascades cascades;
+	cascades.SetShadowDistance(200.0f);
+
+	float eye[3] = { 0.0f, 2.0f, 0.0f };
+	const float forward[3] = { 0.6f, -0.1f, 0.79372539f };
+	const float point[3] = { 3.3f, 0.7f, 9.1f };
+	double firstPhase[ShadowCascades::CascadeCount][2] = {};
+	double maxPhaseDrift = 0.0;
+	unsigned int refitCascades = 0;
+	unsigned int coverageMisses = 0;
+	bool isKeptUnchanged = true;
+	float lastViewProjection[ShadowCascades::CascadeCount][16] = {};
+
+	const unsigned int frameCount = 2000;
+	for (unsigned int frame = 0; frame < frameCount; frame++)
+	{
+		// uneven steps, never a whole texel
+		eye[0] += 0.0173f;
+		eye[1] += 0.0011f * std::sin(frame * 0.05f);
+		eye[2] += 0.0291f;
+
+		float view[16];
+		_lookTo(eye, forward, view);
+		cascades.SetCamera(view, TanHalfFovX, TanHalfFovY, NearZ, FarZ);
+		cascades.SetLightDirection(LightDirection);
+		cascades.Fit();
+		refitCascades += frame > 0 ? cascades.GetStats().refitCascades : 0;
+
+		float sliceNear = NearZ;
+		for (unsigned int cascade = 0; cascade < ShadowCascades::CascadeCount; cascade++)
+		{
+			const ShadowCascade& shadowCascade = cascades.GetCascade(cascade);
+
+			float clip[4];
+			_transform(shadowCascade.viewProjection, point, clip);
+			const double texels[2] = { (clip[0] * 0.5 + 0.5) * ShadowCascades::Resolution, (clip[1] * 0.5 + 0.5) * ShadowCascades::Resolution };
+			for (int axis = 0; axis < 2; axis++)
+			{
+				const double phase = texels[axis] - std::floor(texels[axis]);
+				if (frame == 0)
+				{
+					firstPhase[cascade][axis] = phase;
+				}
+				const double drift = std::fabs(phase - firstPhase[cascade][axis]);
+				maxPhaseDrift = std::max<double>(maxPhaseDrift, std::min<double>(drift, 1.0 - drift));
+			}
+
+			// every corner of the slice is on the map and inside its depth range
+			for (int corner = 0; corner < 8; corner++)
+			{
+				const float z = (corner & 4) ? shadowCascade.splitDepth : sliceNear;
+				float world[3];
+				_viewToWorld(view, eye, ((corner & 1) ? 1.0f : -1.0f) * TanHalfFovX * z, ((corner & 2) ? 1.0f : -1.0f) * TanHalfFovY * z, z, world);
+				_transform(shadowCascade.viewProjection, world, clip);
+				coverageMisses += std::fabs(clip[0]) > 1.0001f || std::fabs(clip[1]) > 1.0001f || clip[2] < -1e-4f || clip[2] > 1.0001f ? 1 : 0;
+			}
+			sliceNear = shadowCascade.splitDepth;
+
+			// a map that was not refit is exactly the one of the last frame, so the cache can keep it
+			if (frame > 0 && std::equal(shadowCascade.viewProjection, shadowCascade.viewProjection + 16, lastViewProjection[cascade]))
+			{
+				// unchanged
+			}
+			else if (frame > 0 && cascades.GetStats().refitCascades == 0)
+			{
+				isKeptUnchanged = false;
+			}
+			std::copy(shadowCascade.viewProjection, shadowCascade.viewProjection + 16, lastViewProjection[cascade]);
+		}
+	}
+
+	BEAR_CHECK(maxPhaseDrift < 1e-2);
+	BEAR_CHECK(coverageMisses == 0);
+	BEAR_CHECK(isKeptUnchanged);
+	// the near cascades follow the camera every so often, not every frame
+	BEAR_CHECK(refitCascades > 0);
+	BEAR_CHECK(refitCascades < frameCount);
+
+	// standing still moves nothing; a new light direction moves every map, once
+	cascades.Fit();
+	BEAR_CHECK(cascades.GetStats().refitCascades == 0);
+	const float newLight[3] = { 0.41f, -1.0f, 0.3f };
+	cascades.SetLightDirection(newLight);
+	cascades.Fit();
+	BEAR_CHECK(cascades.GetStats().refitCascades == ShadowCascades::CascadeCount);
+	cascades.SetLightDirection(newLight);
+	cascades.Fit();
+	BEAR_CHECK(cascades.GetStats().refitCascades == 0);
+}
+
+// turning in place keeps every map's size, the bounding sphere does not depend on the direction
+static void TestTexelSizeUnderRotation()
+{
+	ShadowCascades cascades;
+	cascades.SetShadowDistance(200.0f);
+	const float eye[3] = { 0.0f, 2.0f, 0.0f };
+	float texelSizes[ShadowCascades::CascadeCount] = {};
+	bool isSameSize = true;
+	for (int degrees = 0; degrees < 360; degrees += 3)
+	{
+		const float angle = degrees * 3.14159265f / 180.0f;
+		const float forward[3] = { std::sin(angle), 0.0f, std::cos(angle) };
+		_setUp(cascades, eye, forward);
+		for (unsigned int cascade = 0; cascade < ShadowCascades::CascadeCount; cascade++)
+		{
+			if (degrees == 0)
+			{
+				texelSizes[cascade] = cascades.GetCascade(cascade).texelSize;
+			}
+			isSameSize = isSameSize && cascades.GetCascade(cascade).texelSize == texelSizes[cascade];
+		}
+	}
+	BEAR_CHECK(isSameSize);
+}
+
+static bool _isListed(const ShadowCascade& p_cascade, uint32_t p_caster)
+{
+	return std::binary_search(p_cascade.casters.begin(), p_cascade.casters.end(), p_caster);
+}
+
+static unsigned int _cascadeAt(const ShadowCascades& p_cascades, float p_depth)
+{
+	unsigned int cascade = 0;
+	while (cascade + 1 < ShadowCascades::CascadeCount && p_cascades.GetCascade(cascade).splitDepth < p_depth)
+	{
+		cascade++;
+	}
+	return cascade;
+}
+
+// Casters the camera cannot see still shadow what it sees: one high above the view, between the light
+// and a visible point on the ground, is kept; one far to the side or entirely past the map's far plane
+// is not. Every caster a ray from a receiver in the slice towards the light meets is listed.
+static void TestCasterCulling()
+{
+	const float eye[3] = { 0.0f, 5.0f, 0.0f };
+	const float forward[3] = { 0.0f, -0.19999f, 0.97980f };
+	float view[16];
+	_lookTo(eye, forward, view);
+
+	ShadowCascades cascades;
+	cascades.SetShadowDistance(200.0f);
+	_setUp(cascades, eye, forward);
+
+	const float lightLength = std::sqrt(LightDirection[0] * LightDirection[0] + LightDirection[1] * LightDirection[1] + LightDirection[2] * LightDirection[2]);
+	const float toLight[3] = { -LightDirection[0] / lightLength, -LightDirection[1] / lightLength, -LightDirection[2] / lightLength };
+
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> across(-400.0f, 400.0f);
+	std::uniform_real_distribution<float> height(-20.0f, 60.0f);
+	std::uniform_real_distribution<float> extent(0.2f, 4.0f);
+	std::vector<BoundingAabb> casters(3000);
+	for (BoundingAabb& caster : casters)
+	{
+		caster.center[0] = across(random);
+		caster.center[1] = height(random);
+		caster.center[2] = across(random);
+		for (float& value : caster.extents)
+		{
+			value = extent(random);
+		}
+	}
+
+	// a visible point on the ground 20 units ahead, and casters placed around it
+	float receiver[3];
+	_viewToWorld(view, eye, 0.0f, 0.0f, 20.0f, receiver);
+	receiver[1] = 0.0f;
+	const size_t aboveView = casters.size();
+	const size_t toTheSide = casters.size() + 1;
+	const size_t belowGround = casters.size() + 2;
+	casters.resize(casters.size() + 3);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		casters[aboveView].center[axis] = receiver[axis] + toLight[axis] * 80.0f;
+		casters[toTheSide].center[axis] = receiver[axis];
+		casters[belowGround].center[axis] = receiver[axis] - toLight[axis] * 600.0f;
+		casters[aboveView].extents[axis] = casters[toTheSide].extents[axis] = casters[belowGround].extents[axis] = 1.0f;
+	}
+	casters[toTheSide].center[0] += 2000.0f;
+
+	// the caster above is outside the view frustum
+	float aboveInView[4];
+	_transform(view, casters[aboveView].center, aboveInView);
+	BEAR_CHECK(std::fabs(aboveInView[1]) - 1.0f > TanHalfFovY * aboveInView[2]);
+
+	ShadowCascades pooled = cascades;
+	cascades.Resize(casters.size());
+	pooled.Resize(casters.size());
+	for (size_t i = 0; i < casters.size(); i++)
+	{
+		cascades.SetCaster(i, casters[i]);
+		pooled.SetCaster(i, casters[i]);
+	}
+	cascades.Cull(nullptr);
+	WorkerPool pool(3);
+	pooled.Cull(&pool);
+
+	const unsigned int receiverCascade = _cascadeAt(cascades, 20.0f);
+	BEAR_CHECK(_isListed(cascades.GetCascade(receiverCascade), static_cast<uint32_t>(aboveView)));
+	bool isListedAnywhere = false;
+	for (unsigned int cascade = 0; cascade < ShadowCascades::CascadeCount; cascade++)
+	{
+		const ShadowCascade& shadowCascade = cascades.GetCascade(cascade);
+		isListedAnywhere = isListedAnywhere || _isListed(shadowCascade, static_cast<uint32_t>(toTheSide)) || _isListed(shadowCascade, static_cast<uint32_t>(belowGround));
+		BEAR_CHECK(std::is_sorted(shadowCascade.casters.begin(), shadowCascade.casters.end()));
+		BEAR_CHECK(shadowCascade.casters == pooled.GetCascade(cascade).casters);
+		// culling does something
+		BEAR_CHECK(shadowCascade.casters.size() < casters.size() / 2);
+	}
+	BEAR_CHECK(!isListedAnywhere);
+
+	// conservative: rays from random receivers in each slice towards the light
+	std::uniform_real_distribution<float> side(-1.0f, 1.0f);
+	unsigned int hits = 0;
+	unsigned int missing = 0;
+	float sliceNear = NearZ;
+	for (unsigned int cascade = 0; cascade < ShadowCascades::CascadeCount; cascade++)
+	{
+		const ShadowCascade& shadowCascade = cascades.GetCascade(cascade);
+		std::uniform_real_distribution<float> depth(sliceNear, shadowCascade.splitDepth);
+		for (int ray = 0; ray < 500; ray++)
+		{
+			const float z = depth(random);
+			float origin[3];
+			_viewToWorld(view, eye, side(random) * TanHalfFovX * z, side(random) * TanHalfFovY * z, z, origin);
+
+			for (size_t i = 0; i < casters.size(); i++)
+			{
+				float entry = 0.0f;
+				float exit = 1e9f;
+				for (int axis = 0; axis < 3 && entry <= exit; axis++)
+				{
+					const float minimum = casters[i].center[axis] - casters[i].extents[axis];
+					const float maximum = casters[i].center[axis] + casters[i].extents[axis];
+					const float t1 = (minimum - origin[axis]) / toLight[axis];
+					const float t2 = (maximum - origin[axis]) / toLight[axis];
+					entry = std::max<float>(entry, std::min<float>(t1, t2));
+					exit = std::min<float>(exit, std::max<float>(t1, t2));
+				}
+				if (entry <= exit)
+				{
+					hits++;
+					missing += _isListed(shadowCascade, static_cast<uint32_t>(i)) ? 0 : 1;
+				}
+			}
+		}
+		sliceNear = shadowCascade.splitDepth;
+	}
+	BEAR_CHECK(hits > 100);
+	BEAR_CHECK(missing == 0);
+}
+
+// a cascade is rendered again only when its matrix or its set of caster revisions changed
+static void TestShadowMapCacheReuse()
+{
+	ShadowMapCache cache(2);
+	float viewProjection[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+	const std::vector<uint64_t> revisions = { 5, 9, 3 };
+
+	BEAR_CHECK(cache.Update(0, 1, viewProjection, revisions));
+	BEAR_CHECK(!cache.Update(0, 1, viewProjection, revisions));
+	// the order the casters come in does not matter
+	BEAR_CHECK(!cache.Update(0, 1, viewProjection, { 9, 3, 5 }));
+
+	// every set and cascade keeps its own entry
+	BEAR_CHECK(cache.Update(1, 1, viewProjection, revisions));
+	BEAR_CHECK(!cache.Update(1, 1, viewProjection, revisions));
+	BEAR_CHECK(cache.Update(0, 2, viewProjection, revisions));
+
+	// a caster that moved gets a new revision, one that left is missing
+	BEAR_CHECK(cache.Update(0, 1, viewProjection, { 9, 3, 6 }));
+	BEAR_CHECK(cache.Update(0, 1, viewProjection, { 9, 3 }));
+	BEAR_CHECK(!cache.Update(0, 1, viewProjection, { 3, 9 }));
+
+	// the map moved
+	viewProjection[12] = 0.5f;
+	BEAR_CHECK(cache.Update(0, 1, viewProjection, { 9, 3 }));
+	BEAR_CHECK(!cache.Update(0, 1, viewProjection, { 9, 3 }));
+
+	// an empty cascade is rendered once, to clear it
+	BEAR_CHECK(cache.Update(0, 3, viewProjection, {}));
+	BEAR_CHECK(!cache.Update(0, 3, viewProjection, {}));
+
+	cache.Invalidate();
+	BEAR_CHECK(cache.Update(0, 1, viewProjection, { 9, 3 }));
+	BEAR_CHECK(cache.Update(0, 3, viewProjection, {}));
+
+	// walking with static casters: the cascades that were not refit are reused, the rest render again
+	ShadowCascades cascades;
+	cascades.SetShadowDistance(200.0f);
+	ShadowMapCache walkCache(1);
+	float eye[3] = { 0.0f, 2.0f, 0.0f };
+	const float forward[3] = { 0.0f, 0.0f, 1.0f };
+	unsigned int rendered = 0;
+	unsigned int refit = 0;
+	bool isRenderedWhenRefit = true;
+	for (int frame = 0; frame < 500; frame++)
+	{
+		eye[2] += 0.05f;
+		_setUp(cascades, eye, forward);
+		refit += cascades.GetStats().refitCascades;
+		for (unsigned int cascade = 0; cascade < ShadowCascades::CascadeCount; cascade++)
+		{
+			rendered += walkCache.Update(0, cascade, cascades.GetCascade(cascade).viewProjection, revisions) ? 1 : 0;
+		}
+		isRenderedWhenRefit = isRenderedWhenRefit && (frame == 0 || rendered == refit);
+	}
+	BEAR_CHECK(isRenderedWhenRefit);
+	BEAR_CHECK(rendered < 500 * ShadowCascades::CascadeCount / 4);
+}
+
+int main()
+{
+	BEAR_RUN_TEST(TestSplitDistribution);
+	BEAR_RUN_TEST(TestTexelSnappingUnderTranslation);
+	BEAR_RUN_TEST(TestTexelSizeUnderRotation);
+	BEAR_RUN_TEST(TestCasterCulling);
+	BEAR_RUN_TEST(TestShadowMapCacheReuse);
+	return BEAR_TEST_RESULT();
+}
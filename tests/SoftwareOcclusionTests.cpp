@@ -0,0 +1,261 @@
+#include "SoftwareOcclusion.h"
+#include "WorkerPool.h"
+#include "TestCheck.h"
+
+#include <cmath>
+#include <vector>
+
+// camera at the origin looking down +z, a vertical field of view of 1 radian at the buffer's aspect,
+// depth 0.1 to 100
+static const float NearZ = 0.1f;
+static const float FarZ = 100.0f;
+
+static void _perspective(float* out_matrix_p)
+{
+	const float yScale = 1.0f / std::tan(0.5f);
+	for (int i = 0; i < 16; i++)
+	{
+		out_matrix_p[i] = 0.0f;
+	}
+	out_matrix_p[0] = yScale * SoftwareOcclusion::Height / SoftwareOcclusion::Width;
+	out_matrix_p[5] = yScale;
+	out_matrix_p[10] = FarZ / (FarZ - NearZ);
+	out_matrix_p[11] = 1.0f;
+	out_matrix_p[14] = -NearZ * FarZ / (FarZ - NearZ);
+}
+
+// p_a then p_b, for row vectors
+static void _multiply(const float* p_a_p, const float* p_b_p, float* out_matrix_p)
+{
+	for (int row = 0; row < 4; row++)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			float sum = 0.0f;
+			for (int i = 0; i < 4; i++)
+			{
+				sum += p_a_p[row * 4 + i] * p_b_p[i * 4 + column];
+			}
+			out_matrix_p[row * 4 + column] = sum;
+		}
+	}
+}
+
+// the depth the buffer stores for a point at view depth p_z
+static float _depthAt(float p_z)
+{
+	return (FarZ / (FarZ - NearZ) * p_z - NearZ * FarZ / (FarZ - NearZ)) / p_z;
+}
+
+static BoundingAabb _box(float p_x, float p_y, float p_z, float p_extentX, float p_extentY, float p_extentZ)
+{
+	BoundingAabb box;
+	box.center[0] = p_x;
+	box.center[1] = p_y;
+	box.center[2] = p_z;
+	box.extents[0] = p_extentX;
+	box.extents[1] = p_extentY;
+	box.extents[2] = p_extentZ;
+	return box;
+}
+
+// a 6 by 6 quad in its model's z = 0 plane, two triangles
+static const float WallCorners[18] = { -3.0f, -3.0f, 0.0f, 3.0f, -3.0f, 0.0f, 3.0f, 3.0f, 0.0f,
+	-3.0f, -3.0f, 0.0f, 3.0f, 3.0f, 0.0f, -3.0f, 3.0f, 0.0f };
+
+// the wall, moved 10 units in front of the camera by its model matrix
+static void _addWall(SoftwareOcclusion& p_occlusion, const float* p_viewProjection_p)
+{
+	const float model[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 10.0f, 1.0f };
+	float modelToClip[16];
+	_multiply(model, p_viewProjection_p, modelToClip);
+	p_occlusion.AddOccluder(modelToClip, WallCorners, 2);
+}
+
+static void _cull(SoftwareOcclusion& p_occlusion, const std::vector<BoundingAabb>& p_boxes, WorkerPool* p_workerPool_p)
+{
+	p_occlusion.Resize(p_boxes.size());
+	for (size_t i = 0; i < p_boxes.size(); i++)
+	{
+		p_occlusion.SetBounds(i, p_boxes[i]);
+	}
+	p_occlusion.Cull(p_workerPool_p);
+}
+
+static void TestBoxesAroundAWall()
+{
+	float viewProjection[16];
+	_perspective(viewProjection);
+
+	const std::vector<BoundingAabb> boxes = {
+		_box(0.0f, 0.0f, 20.0f, 0.5f, 0.5f, 0.5f), // behind the wall
+		_box(1.5f, -1.5f, 30.0f, 2.0f, 2.0f, 2.0f), // behind it, off center
+		_box(0.0f, 0.0f, 5.0f, 0.5f, 0.5f, 0.5f), // in front of it
+		_box(0.0f, 0.0f, 20.0f, 8.0f, 0.5f, 0.5f), // behind it, but wider than it looks from here
+		_box(10.0f, 0.0f, 20.0f, 0.5f, 0.5f, 0.5f), // behind and beside it
+		_box(0.0f, 0.0f, 10.0f, 1.0f, 1.0f, 1.0f), // through it
+		_box(0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f), // around the camera, across the near plane
+		_box(0.0f, 0.0f, -20.0f, 0.5f, 0.5f, 0.5f), // behind the camera
+	};
+	const bool expected[] = { false, false, true, true, true, true, true, true };
+
+	for (bool isAvx2Enabled : { false, true })
+	{
+		SoftwareOcclusion occlusion;
+		occlusion.SetAvx2Enabled(isAvx2Enabled);
+		occlusion.Begin(viewProjection);
+		_addWall(occlusion, viewProjection);
+		occlusion.Rasterize(nullptr);
+		_cull(occlusion, boxes, nullptr);
+
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			BEAR_CHECK(occlusion.IsVisible(i) == expected[i]);
+		}
+		const OcclusionStats stats = occlusion.GetStats();
+		BEAR_CHECK(stats.occluders == 1 && stats.occluderTriangles == 2);
+		BEAR_CHECK(stats.tested == boxes.size() && stats.occluded == 2);
+	}
+
+	// without occluders nothing is hidden
+	SoftwareOcclusion occlusion;
+	occlusion.Begin(viewProjection);
+	occlusion.Rasterize(nullptr);
+	_cull(occlusion, boxes, nullptr);
+	BEAR_CHECK(occlusion.GetStats().occluded == 0);
+}
+
+// the wall's depth where it covers the buffer, the far plane elsewhere, and tiles keep their farthest pixel
+static void TestRasterizedDepth()
+{
+	float viewProjection[16];
+	_perspective(viewProjection);
+
+	SoftwareOcclusion occlusion;
+	occlusion.Begin(viewProjection);
+	_addWall(occlusion, viewProjection);
+	occlusion.Rasterize(nullptr);
+
+	const std::vector<float>& depth = occlusion.GetDepth();
+	const unsigned int centerX = SoftwareOcclusion::Width / 2;
+	const unsigned int centerY = SoftwareOcclusion::Height / 2;
+	BEAR_CHECK_NEAR(depth[centerY * SoftwareOcclusion::Width + centerX], _depthAt(10.0f), 1e-5);
+	BEAR_CHECK(depth[0] == 1.0f);
+	BEAR_CHECK(depth[SoftwareOcclusion::Width * SoftwareOcclusion::Height - 1] == 1.0f);
+
+	// the wall reaches 3 / 10 of the way to the edge of a view whose half height is tan(0.5)
+	const float halfHeight = 3.0f / 10.0f / std::tan(0.5f) * SoftwareOcclusion::Height / 2.0f;
+	unsigned int covered = 0;
+	for (float value : depth)
+	{
+		covered += value < 1.0f ? 1 : 0;
+	}
+	BEAR_CHECK_NEAR(covered, 4.0f * halfHeight * halfHeight, 4.0f * 2.0f * halfHeight + 4.0f);
+
+	const std::vector<float>& tileMaxDepth = occlusion.GetTileMaxDepth();
+	BEAR_CHECK(tileMaxDepth[0] == 1.0f);
+	const unsigned int centerTile = (centerY / SoftwareOcclusion::TileSize) * SoftwareOcclusion::TilesX + centerX / SoftwareOcclusion::TileSize;
+	BEAR_CHECK_NEAR(tileMaxDepth[centerTile], _depthAt(10.0f), 1e-5);
+}
+
+// a triangle with a corner behind the near plane is dropped, the rest of the occluder still counts
+static void TestNearPlaneTrianglesDropped()
+{
+	float viewProjection[16];
+	_perspective(viewProjection);
+
+	const float corners[18] = { -3.0f, -3.0f, 10.0f, 3.0f, -3.0f, 10.0f, 3.0f, 3.0f, 10.0f,
+		-3.0f, -3.0f, 10.0f, 3.0f, 3.0f, 10.0f, 0.0f, 0.0f, -5.0f };
+	SoftwareOcclusion occlusion;
+	occlusion.Begin(viewProjection);
+	occlusion.AddOccluder(viewProjection, corners, 2);
+	occlusion.Rasterize(nullptr);
+	BEAR_CHECK(occlusion.GetStats().occluderTriangles == 1);
+
+	// below the diagonal the first triangle still hides, above it nothing does
+	_cull(occlusion, { _box(1.0f, -1.0f, 30.0f, 0.3f, 0.3f, 0.3f), _box(-1.0f, 1.0f, 30.0f, 0.3f, 0.3f, 0.3f) }, nullptr);
+	BEAR_CHECK(!occlusion.IsVisible(0));
+	BEAR_CHECK(occlusion.IsVisible(1));
+}
+
+// rows split into bands and boxes across tasks give the same depth and the same answers, and the
+// AVX2 rasterizer writes what the scalar one does
+static void TestPoolAndAvx2MatchScalar()
+{
+	float viewProjection[16];
+	_perspective(viewProjection);
+
+	// a few overlapping walls at different depths and angles
+	std::vector<float> corners;
+	for (int wall = 0; wall < 6; wall++)
+	{
+		const float z = 8.0f + wall * 3.0f;
+		const float x = -6.0f + wall * 2.5f;
+		const float slant = 0.3f * wall;
+		const float quad[18] = { x - 2.0f, -2.0f, z, x + 2.0f, -2.0f, z + slant, x + 2.0f, 3.0f, z + slant,
+			x - 2.0f, -2.0f, z, x + 2.0f, 3.0f, z + slant, x - 2.0f, 3.0f, z };
+		corners.insert(corners.end(), quad, quad + 18);
+	}
+
+	std::vector<BoundingAabb> boxes;
+	for (int i = 0; i < 5000; i++)
+	{
+		boxes.push_back(_box((i % 100) * 0.2f - 10.0f, ((i / 100) % 50) * 0.15f - 3.5f, i % 3 == 0 ? 6.0f : 40.0f, 0.2f, 0.2f, 0.2f));
+	}
+
+	WorkerPool pool(3);
+	std::vector<float> depths[3];
+	std::vector<bool> visible[3];
+	for (int run = 0; run < 3; run++)
+	{
+		SoftwareOcclusion occlusion;
+		occlusion.SetAvx2Enabled(run != 0);
+		WorkerPool* pool_p = run == 2 ? &pool : nullptr;
+		occlusion.Begin(viewProjection);
+		for (int wall = 0; wall < 6; wall++)
+		{
+			occlusion.AddOccluder(viewProjection, &corners[wall * 18], 2);
+		}
+		occlusion.Rasterize(pool_p);
+		_cull(occlusion, boxes, pool_p);
+		BEAR_CHECK(occlusion.GetStats().tasks == (run == 2 ? 4u : 1u));
+
+		depths[run] = occlusion.GetDepth();
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			visible[run].push_back(occlusion.IsVisible(i));
+			// nothing in front of every wall is hidden
+			BEAR_CHECK(boxes[i].center[2] > 7.0f || occlusion.IsVisible(i));
+		}
+		BEAR_CHECK(occlusion.GetStats().occluded > 1000);
+	}
+
+	BEAR_CHECK(depths[2] == depths[1]);
+	BEAR_CHECK(visible[2] == visible[1]);
+
+	// the fused multiply-adds may move a pixel on an edge and the last bit of a depth
+	unsigned int differentCoverage = 0;
+	double maxDepthError = 0.0;
+	for (size_t i = 0; i < depths[0].size(); i++)
+	{
+		if ((depths[0][i] < 1.0f) != (depths[1][i] < 1.0f))
+		{
+			differentCoverage++;
+		}
+		else
+		{
+			maxDepthError = std::fmax(maxDepthError, std::fabs(depths[0][i] - depths[1][i]));
+		}
+	}
+	BEAR_CHECK(differentCoverage <= 8);
+	BEAR_CHECK(maxDepthError < 1e-5);
+}
+
+int main()
+{
+	BEAR_RUN_TEST(TestBoxesAroundAWall);
+	BEAR_RUN_TEST(TestRasterizedDepth);
+	BEAR_RUN_TEST(TestNearPlaneTrianglesDropped);
+	BEAR_RUN_TEST(TestPoolAndAvx2MatchScalar);
+	return BEAR_TEST_RESULT();
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+// Checks for the Linux test executables: a failed check prints where it is and is counted,
+// and main returns BEAR_TEST_RESULT(), which is non-zero if any check failed.
+
+inline int& BearTestFailures()
+{
+	static int failures = 0;
+	return failures;
+}
+
+#define BEAR_CHECK(p_condition) \
+	do \
+	{ \
+		if (!(p_condition)) \
+		{ \
+			std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #p_condition); \
+			BearTestFailures()++; \
+		} \
+	} while (0)
+
+#define BEAR_CHECK_NEAR(p_actual, p_expected, p_tolerance) \
+	do \
+	{ \
+		const double actual = static_cast<double>(p_actual); \
+		const double expected = static_cast<double>(p_expected); \
+		if (!(std::fabs(actual - expected) <= static_cast<double>(p_tolerance))) \
+		{ \
+			std::printf("%s:%d: check failed: %s is %g, expected %g within %g\n", __FILE__, __LINE__, #p_actual, \
+				actual, expected, static_cast<double>(p_tolerance)); \
+			BearTestFailures()++; \
+		} \
+	} while (0)
+
+#define BEAR_RUN_TEST(p_test) \
+	do \
+	{ \
+		std::printf("%s\n", #p_test); \
+		p_test(); \
+	} while (0)
+
+#define BEAR_TEST_RESULT() (std::printf(BearTestFailures() == 0 ? "passed\n" : "%d checks failed\n", BearTestFailures()), BearTestFailures() == 0 ? 0 : 1)
+
+// the fastest of p_runs calls, in milliseconds; the benchmarks report this, it is the least noisy
+template <typename Function>
+double BearMeasureBestMilliseconds(int p_runs, Function p_function)
+{
+	double best = 1e30;
+	for (int run = 0; run < p_runs; run++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		p_function();
+		double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		best = milliseconds < best ? milliseconds : best;
+	}
+	return best;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+
+#include "FrustumCuller.h"
+
+// The camera the frustum culling tests look through, and the reference they check the culling against.
+
+// camera at the origin looking down +z, 90 degrees vertically and horizontally, depth 0.1 to 1000
+inline constexpr float BearTestNearZ = 0.1f;
+inline constexpr float BearTestFarZ = 1000.0f;
+inline constexpr float BearTestViewProjection[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+	0.0f, 0.0f, BearTestFarZ / (BearTestFarZ - BearTestNearZ), 1.0f,
+	0.0f, 0.0f, -BearTestNearZ * BearTestFarZ / (BearTestFarZ - BearTestNearZ), 0.0f };
+
+// how far the box reaches past the plane it is most outside of, in double; negative is outside
+inline double BearFrustumMargin(const FrustumPlanes& p_planes, const BoundingAabb& p_box)
+{
+	double margin = 1e30;
+	for (const float* coefficients_p : p_planes.planes)
+	{
+		double reach = coefficients_p[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			reach += static_cast<double>(coefficients_p[axis]) * p_box.center[axis] + std::fabs(static_cast<double>(coefficients_p[axis])) * p_box.extents[axis];
+		}
+		margin = std::min<double>(margin, reach);
+	}
+	return margin;
+}